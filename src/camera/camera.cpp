@@ -174,16 +174,18 @@ void setImageResolution(int framesize) {
   }
 }
 
-camera_fb_t* captureHighRes() {
+// Drain the queue, apply OCR sensor settings and switch to UXGA so that
+// subsequent grabHighResFrame() calls return converged capture frames.
+bool beginHighResCapture() {
   if (!cameraInitialized) {
     Serial.println("[Camera] ERROR: Camera not initialized!");
-    return nullptr;
+    return false;
   }
 
   sensor_t *s = esp_camera_sensor_get();
   if (!s) {
     Serial.println("[Camera] ERROR: Could not get sensor!");
-    return nullptr;
+    return false;
   }
 
   // Step 1: Drain any stale frame sitting in the queue.
@@ -231,8 +233,10 @@ camera_fb_t* captureHighRes() {
     }
     vTaskDelay(pdMS_TO_TICKS(100));
   }
+  return true;
+}
 
-  // Capture the real frame
+camera_fb_t* grabHighResFrame() {
   camera_fb_t *frame = esp_camera_fb_get();
   if (frame) {
     Serial.printf("[Camera] Captured frame: %u bytes, %dx%d\n",
@@ -240,6 +244,12 @@ camera_fb_t* captureHighRes() {
   } else {
     Serial.println("[Camera] ERROR: Capture failed");
   }
+  return frame;
+}
+
+void endHighResCapture() {
+  sensor_t *s = esp_camera_sensor_get();
+  if (!s) return;
 
   // Restore default sensor settings for preview
   s->set_quality(s, 12);
@@ -247,7 +257,12 @@ camera_fb_t* captureHighRes() {
   s->set_saturation(s, 0);
   s->set_brightness(s, 0);
   s->set_sharpness(s, 0);
+}
 
+camera_fb_t* captureHighRes() {
+  if (!beginHighResCapture()) return nullptr;
+  camera_fb_t *frame = grabHighResFrame();
+  endHighResCapture();
   return frame;
 }
 
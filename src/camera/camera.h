@@ -28,6 +28,12 @@ camera_fb_t* captureFrame();
 // Capture at UXGA with proper stabilization (drains queue, switches res, flushes AEC)
 camera_fb_t* captureHighRes();
 
+// Split form of captureHighRes() for callers that need several frames
+// (quality-gate retries, burst scans): begin once, grab N, end once.
+bool beginHighResCapture();
+camera_fb_t* grabHighResFrame();
+void endHighResCapture();
+
 // Return frame
 void returnFrame(camera_fb_t* frame);
 
@@ -0,0 +1,217 @@
+#include "quality_gate.h"
+#include "camera.h"
+#include "../config.h"
+#include "../utils/metrics.h"
+#include "esp32-hal-psram.h"
+#include "esp_jpg_decode.h"
+#include <esp_heap_caps.h>
+
+#define LOG_DEBUG(fmt, ...) Serial.printf(fmt "\n", ##__VA_ARGS__)
+
+static const FrameQualityLimits GATE_LIMITS = {
+    QUALITY_GATE_MIN_MEAN,     QUALITY_GATE_MAX_MEAN,
+    QUALITY_GATE_MAX_CLIP_PCT, QUALITY_GATE_MIN_CONTRAST,
+    QUALITY_GATE_MIN_SHARPNESS, QUALITY_GATE_MIN_DENSITY_MBPP};
+
+// ============================================
+// 1/8-scale luma decode
+// ============================================
+// UXGA at 1/8 is 200x150 = 30KB; the buffer is grown once and reused.
+static uint8_t *lumaBuf = nullptr;
+static size_t lumaCap = 0;
+
+struct LumaDecodeCtx {
+  const uint8_t *src;
+  uint16_t w, h;
+  bool ok;
+};
+
+static size_t lumaRead(void *arg, size_t index, uint8_t *buf, size_t len) {
+  LumaDecodeCtx *ctx = (LumaDecodeCtx *)arg;
+  if (buf) memcpy(buf, ctx->src + index, len);
+  return len;
+}
+
+static bool lumaWrite(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                      uint8_t *data) {
+  LumaDecodeCtx *ctx = (LumaDecodeCtx *)arg;
+  if (!data) {
+    if (x == 0 && y == 0) {
+      // Output start: (w, h) is the scaled frame size
+      size_t need = (size_t)w * h;
+      if (need > lumaCap) {
+        free(lumaBuf);
+        lumaBuf = (uint8_t *)heap_caps_malloc(need, MALLOC_CAP_SPIRAM);
+        if (!lumaBuf) lumaBuf = (uint8_t *)malloc(need);
+        lumaCap = lumaBuf ? need : 0;
+      }
+      ctx->w = w;
+      ctx->h = h;
+      ctx->ok = lumaBuf != nullptr;
+    }
+    return ctx->ok;
+  }
+  if (!ctx->ok) return false; // no buffer: the decoder must not get this far
+
+  // RGB888 block -> BT.601 luma
+  for (uint16_t row = 0; row < h && y + row < ctx->h; row++) {
+    uint8_t *dst = lumaBuf + (uint32_t)(y + row) * ctx->w + x;
+    const uint8_t *src = data + (uint32_t)row * w * 3;
+    for (uint16_t col = 0; col < w && x + col < ctx->w; col++) {
+      dst[col] = (uint8_t)((77 * src[0] + 150 * src[1] + 29 * src[2]) >> 8);
+      src += 3;
+    }
+  }
+  return true;
+}
+
+// ============================================
+// Per-capture history
+// ============================================
+#define GATE_HISTORY_LEN 16
+static CaptureGateReport history[GATE_HISTORY_LEN];
+static size_t historyHead = 0;
+static size_t historyCount = 0;
+
+static const uint32_t CAPTURE_MS_BUCKETS[] = {100, 200, 300, 500, 750, 1000, 1500, 2000, 3000, 5000};
+static MetricHistogram captureSeconds("researchmate_capture_seconds",
+                                      "Gated high-res capture, sensor switch to chosen frame.", CAPTURE_MS_BUCKETS,
+                                      1e-3);
+static MetricCounter captureAttempts("researchmate_capture_attempts_total", "Frames grabbed by gated captures.");
+static MetricCounter capturesAccepted("researchmate_captures_total", "Gated captures by outcome.",
+                                      "result=\"accepted\"");
+static MetricCounter capturesBestEffort("researchmate_captures_total", "Gated captures by outcome.",
+                                        "result=\"best_effort\"");
+static MetricCounter capturesFailed("researchmate_captures_total", "Gated captures by outcome.",
+                                    "result=\"no_frame\"");
+
+static void recordReport(const CaptureGateReport &r) {
+  captureSeconds.observe(r.totalMs);
+  captureAttempts.add(r.attempts);
+  if (r.accepted) {
+    capturesAccepted.add();
+  } else if (r.structure == JPEG_OK) {
+    capturesBestEffort.add();
+  } else {
+    capturesFailed.add();
+  }
+  history[historyHead] = r;
+  historyHead = (historyHead + 1) % GATE_HISTORY_LEN;
+  if (historyCount < GATE_HISTORY_LEN) historyCount++;
+}
+
+size_t getRecentGateReports(CaptureGateReport *out, size_t max) {
+  size_t n = min(max, historyCount);
+  for (size_t i = 0; i < n; i++) {
+    out[i] = history[(historyHead + GATE_HISTORY_LEN - 1 - i) % GATE_HISTORY_LEN];
+  }
+  return n;
+}
+
+static void setReason(CaptureGateReport *r, const char *reason) {
+  strncpy(r->reason, reason ? reason : "", sizeof(r->reason) - 1);
+  r->reason[sizeof(r->reason) - 1] = '\0';
+}
+
+// ============================================
+// Evaluation
+// ============================================
+bool evaluateFrame(const uint8_t *jpg, size_t len, CaptureGateReport *report) {
+  uint32_t t0 = micros();
+  report->structure = jpegScanStructure(jpg, len, nullptr);
+  uint32_t t1 = micros();
+  report->scanUs += t1 - t0;
+  report->frameBytes = len;
+  memset(&report->metrics, 0, sizeof(report->metrics));
+
+  if (report->structure != JPEG_OK) {
+    setReason(report, jpegScanResultName(report->structure));
+    return false;
+  }
+
+  LumaDecodeCtx ctx = {jpg, 0, 0, false};
+  esp_err_t err = esp_jpg_decode(len, JPG_SCALE_8X, lumaRead, lumaWrite, &ctx);
+  if (err != ESP_OK || !ctx.ok) {
+    report->analyzeUs += micros() - t1;
+    setReason(report, "decode");
+    return false;
+  }
+  computeFrameQuality(lumaBuf, ctx.w, ctx.h, &report->metrics);
+  report->metrics.densityMbpp = jpegDensityMbpp(len, ctx.w * 8, ctx.h * 8);
+  report->analyzeUs += micros() - t1;
+
+  const char *reason = checkFrameQuality(report->metrics, GATE_LIMITS);
+  setReason(report, reason);
+  return reason == nullptr;
+}
+
+// ============================================
+// Gated capture
+// ============================================
+camera_fb_t *captureGatedHighRes(CaptureGateReport *report) {
+  memset(report, 0, sizeof(*report));
+  report->timestamp = millis();
+
+  if (!beginHighResCapture()) return nullptr;
+  // The retry budget starts after the sensor switch, which can itself take
+  // most of a second; report->timestamp stays the moment of the request
+  const uint32_t switchedMs = millis();
+
+  // With a single DRAM frame buffer (no PSRAM) we cannot hold a candidate
+  // while grabbing the next one, so only the latest valid frame is kept.
+  const bool keepBest = psramFound();
+  camera_fb_t *best = nullptr;
+  CaptureGateReport bestEval = {};
+
+  while (report->attempts < QUALITY_GATE_MAX_ATTEMPTS) {
+    camera_fb_t *fb = grabHighResFrame();
+    report->attempts++;
+    bool lastChance = report->attempts >= QUALITY_GATE_MAX_ATTEMPTS ||
+                      millis() - switchedMs > QUALITY_GATE_BUDGET_MS;
+    if (fb) {
+      CaptureGateReport eval = {};
+      bool pass = evaluateFrame(fb->buf, fb->len, &eval);
+      report->scanUs += eval.scanUs;
+      report->analyzeUs += eval.analyzeUs;
+      LOG_DEBUG("[Gate] Attempt %u: %s (mean=%u p5=%u p95=%u sharp=%u, scan=%luus analyze=%luus)",
+                report->attempts, pass ? "PASS" : eval.reason,
+                eval.metrics.meanLuma, eval.metrics.p5, eval.metrics.p95,
+                eval.metrics.sharpness, eval.scanUs, eval.analyzeUs);
+
+      bool better = !best || eval.metrics.sharpness > bestEval.metrics.sharpness;
+      if (eval.structure != JPEG_OK) {
+        returnFrame(fb); // truncated / corrupt frames are never kept
+      } else if (pass || (keepBest && better) || (!keepBest && lastChance)) {
+        returnFrame(best);
+        best = fb;
+        bestEval = eval;
+        if (pass) break;
+      } else {
+        returnFrame(fb);
+      }
+    }
+
+    if (lastChance) break;
+    vTaskDelay(pdMS_TO_TICKS(QUALITY_GATE_RETRY_DELAY_MS)); // let hand shake settle
+  }
+
+  endHighResCapture();
+
+  if (best) {
+    report->structure = bestEval.structure;
+    report->metrics = bestEval.metrics;
+    report->frameBytes = bestEval.frameBytes;
+    report->accepted = bestEval.reason[0] == '\0';
+    setReason(report, bestEval.reason);
+  } else {
+    report->structure = JPEG_ERR_EMPTY;
+    setReason(report, "no-frame");
+  }
+  report->totalMs = millis() - report->timestamp;
+  recordReport(*report);
+
+  LOG_DEBUG("[Gate] %s after %u attempt(s), %lums total (%s)",
+            report->accepted ? "Accepted" : "Best effort", report->attempts,
+            report->totalMs, report->accepted ? "ok" : report->reason);
+  return best;
+}
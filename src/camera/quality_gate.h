@@ -0,0 +1,41 @@
+// ============================================
+// Capture Quality Gate - ResearchMate
+// Rejects truncated / blurred / badly exposed UXGA frames before they
+// reach the SD queue, retrying within a fixed time budget.
+// ============================================
+
+#ifndef QUALITY_GATE_H
+#define QUALITY_GATE_H
+
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "../imaging/frame_quality.h"
+#include "../imaging/jpeg_scan.h"
+
+struct CaptureGateReport {
+  uint32_t timestamp;          // millis() when the capture started
+  uint8_t attempts;            // frames grabbed (including rejected ones)
+  bool accepted;               // returned frame passed every check
+  char reason[16];             // why the returned frame failed ("" if accepted)
+  JpegScanResult structure;    // SOI/EOI scan result of the returned frame
+  FrameQualityMetrics metrics; // exposure / sharpness of the returned frame
+  uint32_t frameBytes;
+  uint32_t scanUs;             // cumulative structure-scan cost
+  uint32_t analyzeUs;          // cumulative 1/8 decode + histogram cost
+  uint32_t totalMs;            // wall time including sensor switch + retries
+};
+
+// Scan + analyse a single JPEG frame. Fills structure/metrics/reason and the
+// cost fields, returns true when the frame passes.
+bool evaluateFrame(const uint8_t *jpg, size_t len, CaptureGateReport *report);
+
+// Drop-in replacement for captureHighRes(): grabs UXGA frames until one passes
+// the gate or QUALITY_GATE_BUDGET_MS runs out. Never returns a structurally
+// broken frame; when the budget expires the sharpest valid frame is returned
+// with report->accepted == false. Returns nullptr if no valid frame arrived.
+camera_fb_t *captureGatedHighRes(CaptureGateReport *report);
+
+// Copy up to `max` of the most recent reports (newest first).
+size_t getRecentGateReports(CaptureGateReport *out, size_t max);
+
+#endif // QUALITY_GATE_H
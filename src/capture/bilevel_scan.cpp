@@ -0,0 +1,186 @@
+#include "bilevel_scan.h"
+#include "../config.h"
+#include "../imaging/ccitt_g4.h"
+#include "../imaging/jpeg_scan.h"
+#include "../imaging/sauvola.h"
+#include "../storage/storage.h"
+#include "esp_jpg_decode.h"
+#include <SD.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+
+#define LOG_DEBUG(fmt, ...) Serial.printf(fmt "\n", ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) Serial.printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
+
+// Tallest MCU the decoder emits (4:2:0); the OV2640 produces 16x8 (4:2:2)
+#define BAND_MAX_ROWS 16
+
+static BilevelStats lastStats;
+static bool haveStats = false;
+
+// ============================================
+// Decode -> threshold -> encode pipeline
+// ============================================
+struct BilevelCtx {
+  const uint8_t *src;
+  uint16_t width;
+  uint16_t height;
+  uint8_t *band;        // BAND_MAX_ROWS rows of luma, filled MCU by MCU
+  uint16_t bandRows;    // rows in the current band
+  SauvolaState *sauvola;
+  bool ok;
+};
+
+static size_t jpgRead(void *arg, size_t index, uint8_t *buf, size_t len) {
+  BilevelCtx *ctx = (BilevelCtx *)arg;
+  if (buf) memcpy(buf, ctx->src + index, len);
+  return len;
+}
+
+static bool jpgWrite(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                     uint8_t *data) {
+  BilevelCtx *ctx = (BilevelCtx *)arg;
+  if (!data) {
+    // Start (x = y = 0, w x h = output size) or end-of-image marker
+    if (x == 0 && y == 0) ctx->ok = w == ctx->width && h == ctx->height;
+    return ctx->ok;
+  }
+  if (h > BAND_MAX_ROWS) return ctx->ok = false;
+
+  // RGB888 block -> BT.601 luma into the band
+  for (uint16_t row = 0; row < h; row++) {
+    uint8_t *dst = ctx->band + (uint32_t)row * ctx->width + x;
+    const uint8_t *src = data + (uint32_t)row * w * 3;
+    for (uint16_t col = 0; col < w && x + col < ctx->width; col++) {
+      dst[col] = (uint8_t)((77 * src[0] + 150 * src[1] + 29 * src[2]) >> 8);
+      src += 3;
+    }
+  }
+  ctx->bandRows = h;
+
+  // MCUs arrive in raster order: the right-most block completes the band
+  if (x + w >= ctx->width) {
+    for (uint16_t row = 0; row < ctx->bandRows && y + row < ctx->height; row++) {
+      if (!sauvolaPushRow(ctx->sauvola, ctx->band + (uint32_t)row * ctx->width)) {
+        return ctx->ok = false;
+      }
+    }
+  }
+  return true;
+}
+
+static size_t pdfSink(void *ctx, const uint8_t *data, size_t len) {
+  return pdfWriteImageData((PdfDoc *)ctx, data, len) ? len : 0;
+}
+
+static void *allocWork(size_t bytes) {
+  void *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+  return p ? p : malloc(bytes);
+}
+
+bool bilevelAppendPage(PdfDoc *doc, const uint8_t *jpg, size_t len) {
+  uint32_t t0 = millis();
+  BilevelStats st = {};
+  st.timestamp = t0;
+  st.jpegBytes = len;
+
+  JpegInfo info;
+  if (jpegReadHeader(jpg, len, &info) != JPEG_OK || info.width == 0) {
+    LOG_ERROR("[Bilevel] Unreadable JPEG header");
+    lastStats = st;
+    haveStats = true;
+    return false;
+  }
+  st.width = info.width;
+  st.height = info.height;
+
+  const SauvolaConfig cfg = {BILEVEL_RADIUS, BILEVEL_K100, BILEVEL_RANGE};
+  size_t sauvolaBytes = sauvolaWorkBytes(info.width, cfg.radius);
+  size_t g4Bytes = g4WorkBytes(info.width);
+  size_t bandBytes = (size_t)BAND_MAX_ROWS * info.width;
+  uint8_t *work = (uint8_t *)allocWork(sauvolaBytes + g4Bytes + bandBytes);
+  if (!work) {
+    LOG_ERROR("[Bilevel] Out of memory for %u-wide page", info.width);
+    lastStats = st;
+    haveStats = true;
+    return false;
+  }
+
+  G4Encoder enc = {};
+  SauvolaState sauvola;
+  bool ok = pdfBeginCcittPage(doc, info.width, info.height);
+  ok = ok && g4Init(&enc, info.width, work + sauvolaBytes, pdfSink, doc);
+  ok = ok && sauvolaInit(&sauvola, info.width, cfg, work, g4EncodeRow, &enc);
+
+  if (ok) {
+    BilevelCtx ctx = {jpg, info.width, info.height, work + sauvolaBytes + g4Bytes, 0,
+                      &sauvola, false};
+    esp_err_t err = esp_jpg_decode(len, JPG_SCALE_NONE, jpgRead, jpgWrite, &ctx);
+    ok = err == ESP_OK && ctx.ok && sauvolaFinish(&sauvola) && g4Finish(&enc);
+    ok = ok && sauvola.rowsOut == info.height;
+  }
+  // Only a whole page is committed: a failed one leaves the doc at its last
+  // complete update, for the caller to cut the file back to
+  ok = ok && pdfEndImagePage(doc);
+  if (!ok) pdfAbortPage(doc);
+  free(work);
+
+  st.g4Bytes = enc.bytesOut;
+  st.totalMs = millis() - t0;
+  st.ok = ok;
+  lastStats = st;
+  haveStats = true;
+
+  if (ok) {
+    LOG_DEBUG("[Bilevel] %ux%u page: %u -> %u bytes in %lums", info.width, info.height,
+              (unsigned)len, (unsigned)enc.bytesOut, (unsigned long)st.totalMs);
+  } else {
+    LOG_ERROR("[Bilevel] Page encode failed after %lums", (unsigned long)st.totalMs);
+  }
+  return ok;
+}
+
+// ============================================
+// Single-page scans
+// ============================================
+// Hashed on the way out, for the scan index
+struct FileSink {
+  File *file;
+  uint32_t crc;
+};
+
+static size_t fileSink(void *ctx, const uint8_t *data, size_t len) {
+  FileSink *sink = (FileSink *)ctx;
+  size_t n = sink->file->write(data, len);
+  sink->crc = esp_rom_crc32_le(sink->crc, data, n);
+  return n;
+}
+
+String saveBilevelScanToSD(const uint8_t *jpg, size_t len) {
+  if (!SD.exists("/queue")) SD.mkdir("/queue");
+  char path[64];
+  snprintf(path, sizeof(path), "/queue/scan_%lu_%ld.pdf", millis(), random(1000, 9999));
+
+  File file = SD.open(path, FILE_WRITE);
+  if (!file) {
+    LOG_ERROR("[Bilevel] Failed to create %s", path);
+    return "";
+  }
+  PdfDoc doc;
+  FileSink sink = {&file, 0};
+  bool ok = pdfBegin(&doc, fileSink, &sink, PDF_PAGE_DPI) && bilevelAppendPage(&doc, jpg, len);
+  file.close();
+
+  if (!ok) {
+    SD.remove(path);
+    return "";
+  }
+  queueFileAdded(path, doc.offset, sink.crc);
+  return String(path);
+}
+
+bool getLastBilevelStats(BilevelStats *out) {
+  if (!haveStats) return false;
+  *out = lastStats;
+  return true;
+}
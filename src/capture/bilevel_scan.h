@@ -0,0 +1,35 @@
+// ============================================
+// Bilevel Scan - ResearchMate
+// Text-page output path: full-resolution luma decode of the captured JPEG,
+// Sauvola thresholding and CCITT G4 coding, all streamed one MCU band at a
+// time straight into a PDF page. A UXGA page comes out at ~20-50KB instead
+// of ~300KB, with ~60KB of working memory.
+// ============================================
+
+#ifndef BILEVEL_SCAN_H
+#define BILEVEL_SCAN_H
+
+#include "../storage/pdf_writer.h"
+#include <Arduino.h>
+
+struct BilevelStats {
+  uint32_t timestamp;   // millis() when the page was encoded
+  uint16_t width;
+  uint16_t height;
+  uint32_t jpegBytes;   // source frame
+  uint32_t g4Bytes;     // encoded page data
+  uint32_t totalMs;     // decode + threshold + encode + write
+  bool ok;
+};
+
+// Append one page to an open PDF (the caller owns the sink).
+bool bilevelAppendPage(PdfDoc *doc, const uint8_t *jpg, size_t len);
+
+// Single-page scan: write a one-page PDF into the upload queue.
+// Returns the queued path, or "" on failure.
+String saveBilevelScanToSD(const uint8_t *jpg, size_t len);
+
+// Stats for the most recent page; false until a page has been attempted.
+bool getLastBilevelStats(BilevelStats *out);
+
+#endif // BILEVEL_SCAN_H
@@ -0,0 +1,264 @@
+#include "burst_session.h"
+#include "frame_ring.h"
+#include "../camera/camera.h"
+#include "../config.h"
+#include "../imaging/jpeg_scan.h"
+#include "../storage/storage.h"
+#include <esp_heap_caps.h>
+
+#define LOG_DEBUG(fmt, ...) Serial.printf(fmt "\n", ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) Serial.printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
+
+// ============================================
+// Session state
+// ============================================
+static FrameRing ring;
+static uint8_t *ringBuffer = nullptr;
+static SemaphoreHandle_t ringMutex = nullptr; // guards ring + stats
+static TaskHandle_t writerTaskHandle = nullptr;
+static volatile bool writerStopRequested = false;
+static volatile bool writerExited = false;
+
+static volatile BurstState state = BURST_IDLE;
+static BurstTrigger activeTrigger = BURST_TRIGGER_CADENCE;
+static BurstStats stats = {};
+static uint32_t sessionStart = 0;
+static uint32_t nextCaptureAt = 0;
+static uint32_t frameSeq = 0;
+
+// Page-change trigger: JPEG size tracks scene content closely, so a jump
+// followed by two similar-sized frames means "new page, hand is off it".
+static uint32_t lastFrameSize = 0;
+static uint32_t lastStoredSize = 0;
+static uint8_t settledFrames = 0;
+
+static uint32_t pctDiff(uint32_t a, uint32_t b) {
+  uint32_t hi = max(a, b), lo = min(a, b);
+  return hi ? (hi - lo) * 100 / hi : 0;
+}
+
+// ============================================
+// SD writer task
+// ============================================
+static void writerLoop(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(200));
+
+    FrameSlot slot;
+    for (;;) {
+      xSemaphoreTake(ringMutex, portMAX_DELAY);
+      bool have = ring.peek(&slot);
+      xSemaphoreGive(ringMutex);
+      if (!have) break;
+
+      // The slot stays reserved until pop(), so write straight from PSRAM.
+      uint32_t t0 = millis();
+      String filename = saveImageToSD(ring.data() + slot.offset, slot.len);
+      uint32_t dt = millis() - t0;
+
+      xSemaphoreTake(ringMutex, portMAX_DELAY);
+      ring.pop();
+      if (filename.length() > 0) {
+        stats.pagesWritten++;
+        stats.bytesWritten += slot.len;
+      } else {
+        stats.writeErrors++;
+      }
+      if (dt > stats.maxWriteMs) stats.maxWriteMs = dt;
+      xSemaphoreGive(ringMutex);
+
+      LOG_DEBUG("[Burst] Page %lu -> SD in %lums (%s)", (unsigned long)slot.seq,
+                (unsigned long)dt, filename.length() ? filename.c_str() : "FAILED");
+    }
+
+    if (writerStopRequested) break;
+  }
+
+  writerExited = true;
+  writerTaskHandle = nullptr;
+  vTaskDelete(NULL);
+}
+
+// ============================================
+// Capture side
+// ============================================
+static void storeFrame(camera_fb_t *fb) {
+  if (jpegScanStructure(fb->buf, fb->len, nullptr) != JPEG_OK) {
+    stats.rejected++;
+    return;
+  }
+
+  xSemaphoreTake(ringMutex, portMAX_DELAY);
+  uint8_t *dst = ring.reserve(fb->len);
+  if (!dst) stats.dropped++;
+  xSemaphoreGive(ringMutex);
+
+  if (!dst) {
+    LOG_ERROR("[Burst] Ring full, dropped frame (%u bytes)", fb->len);
+    return;
+  }
+
+  // Copy outside the lock: the writer never touches reserved space.
+  memcpy(dst, fb->buf, fb->len);
+
+  xSemaphoreTake(ringMutex, portMAX_DELAY);
+  ring.commit(fb->len, ++frameSeq);
+  stats.pagesCaptured++;
+  xSemaphoreGive(ringMutex);
+
+  lastStoredSize = fb->len;
+  if (writerTaskHandle) xTaskNotifyGive(writerTaskHandle);
+}
+
+static void captureTick() {
+  uint32_t now = millis();
+  if (activeTrigger == BURST_TRIGGER_CADENCE && (int32_t)(now - nextCaptureAt) < 0)
+    return;
+
+  camera_fb_t *fb = grabHighResFrame();
+  if (!fb) return;
+  stats.framesGrabbed++;
+
+  if (activeTrigger == BURST_TRIGGER_CADENCE) {
+    storeFrame(fb);
+    nextCaptureAt += BURST_INTERVAL_MS;
+    if ((int32_t)(now - nextCaptureAt) >= 0) nextCaptureAt = now + BURST_INTERVAL_MS;
+  } else {
+    settledFrames = (lastFrameSize && pctDiff(fb->len, lastFrameSize) < BURST_SETTLE_PCT)
+                        ? settledFrames + 1 : 0;
+    lastFrameSize = fb->len;
+    bool changed = lastStoredSize == 0 ||
+                   pctDiff(fb->len, lastStoredSize) >= BURST_CHANGE_PCT;
+    if (changed && settledFrames >= 2) storeFrame(fb);
+  }
+
+  returnFrame(fb);
+}
+
+// ============================================
+// Public API
+// ============================================
+bool burstStart(BurstTrigger trigger) {
+  if (state != BURST_IDLE) return false;
+
+  // Size the ring from whatever PSRAM is left after the camera frame buffers.
+  size_t freePsram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+  size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+  size_t want = freePsram * BURST_RING_PSRAM_PCT / 100;
+  if (want > BURST_RING_MAX_BYTES) want = BURST_RING_MAX_BYTES;
+  if (want > largest) want = largest;
+  if (want < BURST_RING_MIN_BYTES) {
+    LOG_ERROR("[Burst] Not enough PSRAM for ring (free=%u, largest=%u)",
+              (unsigned)freePsram, (unsigned)largest);
+    return false;
+  }
+
+  ringBuffer = (uint8_t *)heap_caps_malloc(want, MALLOC_CAP_SPIRAM);
+  if (!ringBuffer) {
+    LOG_ERROR("[Burst] Ring allocation failed (%u bytes)", (unsigned)want);
+    return false;
+  }
+  if (!ringMutex) ringMutex = xSemaphoreCreateMutex();
+  ring.attach(ringBuffer, want);
+
+  if (!beginHighResCapture()) {
+    ring.attach(nullptr, 0);
+    free(ringBuffer);
+    ringBuffer = nullptr;
+    return false;
+  }
+
+  memset(&stats, 0, sizeof(stats));
+  stats.ringCapacity = want;
+  activeTrigger = trigger;
+  frameSeq = 0;
+  lastFrameSize = lastStoredSize = 0;
+  settledFrames = 0;
+  sessionStart = millis();
+  nextCaptureAt = sessionStart;
+
+  writerStopRequested = false;
+  writerExited = false;
+  // Core 0: SD writes overlap the capture loop running on core 1.
+  if (xTaskCreatePinnedToCore(writerLoop, "burstWriter", 4096, NULL, 1,
+                              &writerTaskHandle, 0) != pdPASS) {
+    // Nothing would ever drain the ring: back out as burstRequestStop() does
+    LOG_ERROR("[Burst] Writer task create failed");
+    writerTaskHandle = NULL;
+    endHighResCapture();
+    setImageResolution(FRAMESIZE_QVGA);
+    ring.attach(nullptr, 0);
+    free(ringBuffer);
+    ringBuffer = nullptr;
+    return false;
+  }
+
+  state = BURST_RUNNING;
+  LOG_DEBUG("[Burst] Session started (%s, ring=%u KB of %u KB free PSRAM)",
+            trigger == BURST_TRIGGER_CADENCE ? "cadence" : "page-change",
+            (unsigned)(want / 1024), (unsigned)(freePsram / 1024));
+  return true;
+}
+
+void burstRequestStop() {
+  if (state != BURST_RUNNING) return;
+  endHighResCapture();
+  setImageResolution(FRAMESIZE_QVGA);
+  state = BURST_DRAINING;
+  LOG_DEBUG("[Burst] Capture stopped, draining %u page(s)", (unsigned)ring.count());
+  if (writerTaskHandle) xTaskNotifyGive(writerTaskHandle);
+}
+
+BurstState burstTick() {
+  switch (state) {
+  case BURST_RUNNING:
+    captureTick();
+    break;
+
+  case BURST_DRAINING: {
+    xSemaphoreTake(ringMutex, portMAX_DELAY);
+    bool empty = ring.count() == 0;
+    xSemaphoreGive(ringMutex);
+    if (!empty) break;
+
+    if (!writerStopRequested) {
+      writerStopRequested = true;
+      if (writerTaskHandle) xTaskNotifyGive(writerTaskHandle);
+    }
+    if (!writerExited) break;
+
+    stats.elapsedMs = millis() - sessionStart;
+    free(ringBuffer);
+    ringBuffer = nullptr;
+    ring.attach(nullptr, 0);
+    state = BURST_FINISHED;
+    LOG_DEBUG("[Burst] Session done: %lu written, %lu dropped, %lu rejected in %lums",
+              (unsigned long)stats.pagesWritten, (unsigned long)stats.dropped,
+              (unsigned long)stats.rejected, (unsigned long)stats.elapsedMs);
+    return BURST_FINISHED;
+  }
+
+  case BURST_FINISHED:
+    state = BURST_IDLE;
+    break;
+
+  default:
+    break;
+  }
+  return state;
+}
+
+BurstState burstState() { return state; }
+
+void getBurstStats(BurstStats *out) {
+  if (ringMutex) xSemaphoreTake(ringMutex, portMAX_DELAY);
+  *out = stats;
+  out->ringUsed = ring.usedBytes();
+  out->ringPending = ring.count();
+  if (ringMutex) xSemaphoreGive(ringMutex);
+
+  if (state == BURST_RUNNING || state == BURST_DRAINING)
+    out->elapsedMs = millis() - sessionStart;
+  out->pagesPerMinute =
+      out->elapsedMs ? (uint32_t)((uint64_t)out->pagesWritten * 60000 / out->elapsedMs) : 0;
+}
@@ -0,0 +1,52 @@
+// ============================================
+// Burst Scan Session - ResearchMate
+// One press starts a UXGA capture stream into a PSRAM ring; a writer task
+// drains it to the SD queue in the background. Next press ends the session.
+// ============================================
+
+#ifndef BURST_SESSION_H
+#define BURST_SESSION_H
+
+#include <Arduino.h>
+
+enum BurstTrigger {
+  BURST_TRIGGER_CADENCE = 0, // fixed interval (BURST_INTERVAL_MS)
+  BURST_TRIGGER_CHANGE = 1   // capture when the page changes, then settles
+};
+
+enum BurstState {
+  BURST_IDLE = 0,
+  BURST_RUNNING,
+  BURST_DRAINING,  // capture stopped, writer still flushing the ring
+  BURST_FINISHED   // returned once by burstTick() when the drain completes
+};
+
+struct BurstStats {
+  uint32_t framesGrabbed;   // frames pulled from the sensor
+  uint32_t pagesCaptured;   // frames accepted into the ring
+  uint32_t pagesWritten;    // frames saved to SD
+  uint32_t dropped;         // ring full / slot table full
+  uint32_t rejected;        // failed the JPEG structure scan
+  uint32_t writeErrors;
+  uint32_t bytesWritten;
+  uint32_t ringCapacity;
+  uint32_t ringUsed;
+  uint32_t ringPending;     // frames waiting for the writer
+  uint32_t maxWriteMs;      // slowest single SD write
+  uint32_t elapsedMs;       // session time so far
+  uint32_t pagesPerMinute;  // pagesWritten normalised to elapsedMs
+};
+
+// Allocates the ring from free PSRAM and starts the writer task.
+bool burstStart(BurstTrigger trigger);
+
+// Stop capturing; the ring keeps draining until burstTick() reports FINISHED.
+void burstRequestStop();
+
+// Drive the session from loop(): grabs a frame when one is due.
+BurstState burstTick();
+
+BurstState burstState();
+void getBurstStats(BurstStats *out);
+
+#endif // BURST_SESSION_H
@@ -0,0 +1,163 @@
+#include "document_session.h"
+#include "../config.h"
+#include "../storage/pdf_writer.h"
+#include "../storage/storage.h"
+#include "bilevel_scan.h"
+#include <SD.h>
+#include <errno.h>
+#include <esp_rom_crc.h>
+#include <unistd.h>
+
+#define LOG_DEBUG(fmt, ...) Serial.printf(fmt "\n", ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) Serial.printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
+
+#define DOCS_DIR "/docs"
+
+static PdfDoc pdf;
+static bool active = false;
+static char path[64] = {0};
+static uint32_t crc = 0; // of everything written so far, for the scan index
+static uint32_t committedCrc = 0; // ...up to the last complete page
+
+static size_t fileSink(void *ctx, const uint8_t *data, size_t len) {
+  size_t n = ((File *)ctx)->write(data, len);
+  crc = esp_rom_crc32_le(crc, data, n);
+  return n;
+}
+
+static size_t fileSource(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+  File *file = (File *)ctx;
+  return file->seek(offset) ? file->read(buf, len) : 0;
+}
+
+void docRecoverOrphans() {
+  if (!SD.exists(DOCS_DIR)) {
+    SD.mkdir(DOCS_DIR);
+    return;
+  }
+
+  File dir = SD.open(DOCS_DIR);
+  if (!dir || !dir.isDirectory()) return;
+
+  File file = dir.openNextFile();
+  while (file) {
+    String name = String(file.name());
+    bool isDir = file.isDirectory();
+    bool pages = false;
+    uint32_t size = file.size();
+    uint32_t end = isDir ? 0 : pdfLastCommitted(fileSource, &file, size, &pages);
+    file.close();
+    if (!isDir) {
+      int slash = name.lastIndexOf('/');
+      if (slash >= 0) name = name.substring(slash + 1);
+      String from = String(DOCS_DIR "/") + name;
+      String to = String("/queue/") + name;
+      if (!end || !pages) {
+        // Never got a page in (or not even the header): nothing to upload
+        SD.remove(from.c_str());
+        LOG_DEBUG("[Doc] Dropped unfinished document with no pages: %s", from.c_str());
+      } else if (end < size && truncate((String(SD_MOUNT) + from).c_str(), end) != 0) {
+        LOG_ERROR("[Doc] Could not cut %s back to its last page (%d)", from.c_str(), errno);
+      } else if (SD.rename(from.c_str(), to.c_str())) {
+        if (end < size) {
+          LOG_DEBUG("[Doc] Dropped %lu bytes of a half-written page from %s",
+                    (unsigned long)(size - end), from.c_str());
+        }
+        LOG_DEBUG("[Doc] Recovered unfinished document -> %s", to.c_str());
+        queueFileAdded(to); // written before the reboot: read back to hash it
+      }
+    }
+    file = dir.openNextFile();
+  }
+  dir.close();
+}
+
+bool docBegin() {
+  if (active) return true;
+
+  if (!SD.exists(DOCS_DIR)) SD.mkdir(DOCS_DIR);
+  snprintf(path, sizeof(path), DOCS_DIR "/doc_%lu_%ld.pdf", millis(), random(1000, 9999));
+
+  File file = SD.open(path, FILE_WRITE);
+  if (!file) {
+    LOG_ERROR("[Doc] Failed to create %s", path);
+    return false;
+  }
+  crc = 0;
+  bool ok = pdfBegin(&pdf, fileSink, &file, PDF_PAGE_DPI);
+  file.close();
+  committedCrc = crc;
+
+  if (!ok) {
+    LOG_ERROR("[Doc] Failed to write PDF header");
+    SD.remove(path);
+    return false;
+  }
+
+  active = true;
+  LOG_DEBUG("[Doc] Started document %s", path);
+  return true;
+}
+
+bool docAddPage(const uint8_t *jpg, size_t len, bool bilevel) {
+  if (!active && !docBegin()) return false;
+
+  // Append-only: earlier pages are never rewritten, so a page costs the same
+  // to add whether it is the 2nd or the 50th.
+  File file = SD.open(path, FILE_APPEND);
+  if (!file) {
+    LOG_ERROR("[Doc] Failed to open %s for append", path);
+    return false;
+  }
+  uint32_t t0 = millis();
+  pdf.ctx = &file;
+  bool ok = bilevel ? bilevelAppendPage(&pdf, jpg, len) : pdfAppendJpegPage(&pdf, jpg, len);
+  file.close();
+
+  if (!ok) {
+    LOG_ERROR("[Doc] Page append failed (%u bytes)", (unsigned)len);
+    // Cut the half-written page off, so the file ends at the last complete
+    // update and a retake is not added after a broken copy
+    pdfAbortPage(&pdf);
+    crc = committedCrc;
+    char vfsPath[80];
+    snprintf(vfsPath, sizeof(vfsPath), SD_MOUNT "%s", path);
+    if (truncate(vfsPath, pdf.offset) != 0) {
+      LOG_ERROR("[Doc] Could not cut %s back to %lu bytes (%d)", path,
+                (unsigned long)pdf.offset, errno);
+      pdf.failed = true; // the tail is unknown: no more pages on top of it
+    }
+    return false;
+  }
+  committedCrc = crc;
+  LOG_DEBUG("[Doc] Page %lu added (%u bytes, %lums, doc %lu bytes)",
+            (unsigned long)pdf.pageCount, (unsigned)len, millis() - t0,
+            (unsigned long)pdf.offset);
+  return true;
+}
+
+String docEnd() {
+  if (!active) return "";
+  active = false;
+
+  if (pdf.pageCount == 0) {
+    SD.remove(path);
+    return "";
+  }
+
+  String name = String(path).substring(strlen(DOCS_DIR) + 1);
+  String queued = String("/queue/") + name;
+  if (!SD.rename(path, queued.c_str())) {
+    LOG_ERROR("[Doc] Failed to move %s into queue", path);
+    return "";
+  }
+  LOG_DEBUG("[Doc] Queued %s (%lu pages, %lu bytes)", queued.c_str(),
+            (unsigned long)pdf.pageCount, (unsigned long)pdf.offset);
+  queueFileAdded(queued, pdf.offset, crc);
+  return queued;
+}
+
+bool docActive() { return active; }
+uint32_t docPageCount() { return active ? pdf.pageCount : 0; }
+uint32_t docSizeBytes() { return active ? pdf.offset : 0; }
+const char *docPath() { return active ? path : ""; }
@@ -0,0 +1,31 @@
+// ============================================
+// Document Session - ResearchMate
+// Groups consecutive scans into one multi-page PDF on SD. The open document
+// lives in /docs and is moved into the upload queue when the session ends.
+// ============================================
+
+#ifndef DOCUMENT_SESSION_H
+#define DOCUMENT_SESSION_H
+
+#include <Arduino.h>
+
+// Call after initSDCard(): documents left open by a reboot are cut back to
+// their last complete page (each page ends in a full PDF update) and moved
+// into the queue; one that never got a page is deleted.
+void docRecoverOrphans();
+
+bool docBegin();
+
+// Append one JPEG as a new page: embedded as-is (no re-encode), or
+// binarised and G4-coded when `bilevel` is set.
+bool docAddPage(const uint8_t *jpg, size_t len, bool bilevel = false);
+
+// Close the session and queue the PDF; returns the queued path or "".
+String docEnd();
+
+bool docActive();
+uint32_t docPageCount();
+uint32_t docSizeBytes();
+const char *docPath();
+
+#endif // DOCUMENT_SESSION_H
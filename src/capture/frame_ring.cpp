@@ -0,0 +1,71 @@
+#include "frame_ring.h"
+
+void FrameRing::attach(uint8_t *buffer, size_t capacity) {
+  _buf = buffer;
+  _cap = capacity;
+  reset();
+}
+
+void FrameRing::reset() {
+  _rd = 0;
+  _count = 0;
+  _reservedOff = 0;
+}
+
+uint8_t *FrameRing::reserve(uint32_t len) {
+  if (!_buf || len == 0 || len > _cap || _count >= FRAME_RING_MAX_SLOTS)
+    return nullptr;
+
+  if (_count == 0) {
+    _reservedOff = 0; // empty ring: restart at the front, no fragmentation
+    return _buf;
+  }
+
+  const FrameSlot &oldest = _slots[_rd];
+  const FrameSlot &newest = _slots[(_rd + _count - 1) % FRAME_RING_MAX_SLOTS];
+  uint32_t tail = oldest.offset;
+  uint32_t head = newest.offset + newest.len;
+
+  if (head > tail) {
+    // Free space is [head, cap) followed by [0, tail)
+    if (_cap - head >= len) {
+      _reservedOff = head;
+    } else if (tail >= len) {
+      _reservedOff = 0; // wrap; the gap at the end is skipped
+    } else {
+      return nullptr;
+    }
+  } else {
+    // Wrapped (head <= tail): only [head, tail) is free
+    if (tail - head < len) return nullptr;
+    _reservedOff = head;
+  }
+  return _buf + _reservedOff;
+}
+
+void FrameRing::commit(uint32_t len, uint32_t seq) {
+  FrameSlot &s = _slots[(_rd + _count) % FRAME_RING_MAX_SLOTS];
+  s.offset = _reservedOff;
+  s.len = len;
+  s.seq = seq;
+  _count++;
+}
+
+bool FrameRing::peek(FrameSlot *slot) const {
+  if (_count == 0) return false;
+  *slot = _slots[_rd];
+  return true;
+}
+
+void FrameRing::pop() {
+  if (_count == 0) return;
+  _rd = (_rd + 1) % FRAME_RING_MAX_SLOTS;
+  _count--;
+}
+
+size_t FrameRing::usedBytes() const {
+  size_t used = 0;
+  for (size_t i = 0; i < _count; i++)
+    used += _slots[(_rd + i) % FRAME_RING_MAX_SLOTS].len;
+  return used;
+}
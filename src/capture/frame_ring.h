@@ -0,0 +1,51 @@
+// ============================================
+// Frame Ring - ResearchMate
+// FIFO of variable-length JPEG frames packed into one contiguous buffer.
+// Single producer / single consumer; the caller provides the locking.
+// ============================================
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define FRAME_RING_MAX_SLOTS 32
+
+struct FrameSlot {
+  uint32_t offset;
+  uint32_t len;
+  uint32_t seq;       // capture sequence number (1-based)
+};
+
+class FrameRing {
+public:
+  void attach(uint8_t *buffer, size_t capacity);
+  void reset();
+
+  // Reserve space for `len` bytes at the head. Returns nullptr when the
+  // buffer or the slot table is full (caller drops the frame).
+  uint8_t *reserve(uint32_t len);
+  // Publish the last reserve()d region as a readable frame.
+  void commit(uint32_t len, uint32_t seq);
+
+  // Oldest committed frame, or false when empty. The slot stays owned by the
+  // ring until pop() so the consumer can write straight from the buffer.
+  bool peek(FrameSlot *slot) const;
+  void pop();
+
+  size_t count() const { return _count; }
+  size_t capacity() const { return _cap; }
+  size_t usedBytes() const;
+  uint8_t *data() const { return _buf; }
+
+private:
+  uint8_t *_buf = nullptr;
+  size_t _cap = 0;
+  FrameSlot _slots[FRAME_RING_MAX_SLOTS];
+  size_t _rd = 0;
+  size_t _count = 0;
+  uint32_t _reservedOff = 0;
+};
+
+#endif // FRAME_RING_H
@@ -1,6 +1,8 @@
 #include "cloud.h"
 #include "../storage/storage.h"
 #include "config.h"
+#include "../utils/metrics.h"
+#include "cloud_timing.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <HTTPClient.h>
@@ -26,6 +28,34 @@ static unsigned long g_pairingExpiryMs = 5UL * 60UL * 1000UL; // default 5 min,
 // Response buffer (reusable for JSON responses)
 static char g_responseBuffer[8192] = {0};
 
+// Upload in flight (cloud task), read by loop() for /api/events
+static volatile bool g_uploadActive = false;
+static volatile uint32_t g_uploadSent = 0;
+static volatile uint32_t g_uploadTotal = 0;
+
+// Cloud round trips, for /metrics (phases as in cloud_timing.h)
+static const uint32_t CLOUD_MS_BUCKETS[] = {100, 250, 500, 1000, 2000, 4000, 8000, 15000, 30000};
+static MetricHistogram cloudDnsSeconds("researchmate_cloud_dns_seconds", "Cloud host name lookup.",
+                                       METRIC_LATENCY_US, 1e-6);
+static MetricHistogram cloudConnectSeconds("researchmate_cloud_connect_seconds",
+                                           "TCP connect and TLS handshake to the cloud.",
+                                           CLOUD_MS_BUCKETS, 1e-3);
+static MetricHistogram cloudTtfbSeconds("researchmate_cloud_ttfb_seconds",
+                                        "Last request byte sent to first response byte: server time plus a round trip.",
+                                        CLOUD_MS_BUCKETS, 1e-3);
+static MetricCounter cloudUploadBytes("researchmate_cloud_upload_bytes_total",
+                                      "Request body bytes sent to the cloud.");
+static MetricGauge cloudUploadRate("researchmate_cloud_upload_bytes_per_second",
+                                   "Last image or document upload, body bytes over the time to send them.");
+static MetricCounter cloudOk("researchmate_cloud_requests_total", "Cloud requests by outcome.", "result=\"ok\"");
+static MetricCounter cloudRejected("researchmate_cloud_requests_total", "Cloud requests by outcome.",
+                                   "result=\"http_error\"");
+static MetricCounter cloudFailed("researchmate_cloud_requests_total", "Cloud requests by outcome.",
+                                 "result=\"failed\"");
+
+// Phase timings of recent requests, for /api/cloud-timing
+static CloudTimingLog g_timing;
+
 // ============================================
 // Helper Functions
 // ============================================
@@ -41,6 +71,23 @@ const char *getUniquePenID() {
   return uniqueId;
 }
 
+static void uploadBegin(uint32_t total) {
+  g_uploadSent = 0;
+  g_uploadTotal = total;
+  g_uploadActive = true;
+}
+
+static void uploadEnd(bool sent) {
+  if (sent) g_uploadSent = g_uploadTotal;
+  g_uploadActive = false;
+}
+
+void getUploadProgress(UploadProgress *out) {
+  out->active = g_uploadActive;
+  out->sent = g_uploadSent;
+  out->total = g_uploadTotal;
+}
+
 // Generate random 6-digit code - [LEGACY / LOCAL ONLY]
 static void generatePairingCode() {
   uint32_t code = 100000 + (esp_random() % 900000);
@@ -48,9 +95,159 @@ static void generatePairingCode() {
   LOG_DEBUG("[Pairing] Generated code: %s", g_pairingCode);
 }
 
+const CloudTimingLog &getCloudTiming() { return g_timing; }
+
+// WiFiClientSecure that notes when the request's last byte was handed over
+// and when the response's first byte showed up. HTTPClient writes the
+// headers and each body chunk through write(), and polls available() for
+// the status line every 10 ms, which is as fine as ttfb gets. write()
+// returns once lwIP has the bytes, so the last send buffer's worth (a few
+// KB) is still in flight when send ends and counts toward ttfb.
+class TimedClient : public WiFiClientSecure {
+public:
+  // WiFiClientSecure::connect(host, port, timeout) with the lookup done:
+  // `host` still goes out as the TLS server name
+  bool connectTo(IPAddress ip, uint16_t port, const char *host, int32_t timeoutMs) {
+    _timeout = timeoutMs;
+    return connect(ip, port, host, NULL, NULL, NULL);
+  }
+
+  void sending() {
+    sendUs = micros();
+    wrote = false;
+    answered = false;
+  }
+
+  size_t write(const uint8_t *buf, size_t size) override {
+    size_t n = WiFiClientSecure::write(buf, size);
+    if (n) {
+      lastWriteUs = micros();
+      wrote = true;
+    }
+    return n;
+  }
+
+  int available() override {
+    int n = WiFiClientSecure::available();
+    if (n > 0 && wrote && !answered) {
+      firstByteUs = micros();
+      answered = true;
+    }
+    return n;
+  }
+
+  uint32_t sendUs = 0;
+  uint32_t lastWriteUs = 0;
+  uint32_t firstByteUs = 0;
+  bool wrote = false;
+  bool answered = false;
+};
+
+// Host and port of SUPABASE_URL
+static uint16_t cloudHost(char *host, size_t size) {
+  const char *p = SUPABASE_URL;
+  uint16_t port = 443;
+  if (strncmp(p, "http://", 7) == 0) {
+    port = 80;
+    p += 7;
+  } else if (strncmp(p, "https://", 8) == 0) {
+    p += 8;
+  }
+  size_t n = strcspn(p, ":/");
+  if (n >= size) n = size - 1;
+  memcpy(host, p, n);
+  host[n] = '\0';
+  if (p[n] == ':') port = (uint16_t)atoi(p + n + 1);
+  return port;
+}
+
+// Resolves the cloud host, then opens TCP and TLS to it on `client`, each
+// timed into `t`. HTTPClient finds the connection up and sends on it.
+static bool connectTimed(TimedClient &client, CloudTiming &t, uint16_t timeoutMs) {
+  char host[64];
+  uint16_t port = cloudHost(host, sizeof(host));
+
+  uint32_t t0 = micros();
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    LOG_ERROR("[HTTP] Cannot resolve %s", host);
+    return false;
+  }
+  uint32_t t1 = micros();
+  t.us[CLOUD_DNS] = t1 - t0;
+  t.reached |= 1 << CLOUD_DNS;
+  cloudDnsSeconds.observe(t.us[CLOUD_DNS]);
+
+  if (!client.connectTo(ip, port, host, HTTPCLIENT_DEFAULT_TCP_TIMEOUT)) {
+    LOG_ERROR("[HTTP] Cannot connect to %s:%u", host, port);
+    return false;
+  }
+  t.us[CLOUD_CONNECT] = micros() - t1;
+  t.reached |= 1 << CLOUD_CONNECT;
+  cloudConnectSeconds.observe(t.us[CLOUD_CONNECT] / 1000);
+  // As HTTPClient::connect() would have on a connection of its own
+  client.setTimeout((timeoutMs + 500) / 1000);
+  return true;
+}
+
+// Closes one request's record: the phases `client` saw, the outcome (`code`
+// from POST()/GET()/sendRequest()) and total since `t0`, into the log,
+// the metrics and the serial log
+static void noteCloudRequest(CloudTiming &t, const TimedClient &client, int code, size_t sent,
+                             size_t received, uint32_t t0) {
+  uint32_t end = micros();
+  t.code = (int16_t)code;
+  t.sentBytes = client.wrote ? sent : 0;
+  t.recvBytes = received;
+  if (client.wrote) {
+    t.us[CLOUD_SEND] = client.lastWriteUs - client.sendUs;
+    t.reached |= 1 << CLOUD_SEND;
+  }
+  if (client.answered) {
+    t.us[CLOUD_TTFB] = client.firstByteUs - client.lastWriteUs;
+    t.reached |= 1 << CLOUD_TTFB;
+    if (code > 0) {
+      t.us[CLOUD_RECV] = end - client.firstByteUs;
+      t.reached |= 1 << CLOUD_RECV;
+    }
+  }
+  t.us[CLOUD_TOTAL] = end - t0;
+  t.reached |= 1 << CLOUD_TOTAL;
+
+  if (code <= 0) {
+    cloudFailed.add();
+  } else if (code == HTTP_CODE_OK) {
+    cloudOk.add();
+  } else {
+    cloudRejected.add();
+  }
+  if (t.reached & (1 << CLOUD_TTFB)) cloudTtfbSeconds.observe(t.us[CLOUD_TTFB] / 1000);
+  cloudUploadBytes.add(t.sentBytes);
+  // Small JSON bodies go out in one write and would only time that
+  if (sent >= CLOUD_TIMING_RATE_MIN && t.us[CLOUD_SEND] > 0) {
+    cloudUploadRate.set((int32_t)((uint64_t)sent * 1000000 / t.us[CLOUD_SEND]));
+  }
+
+  g_timing.add(t);
+  char line[200];
+  formatCloudTiming(t, line, sizeof(line));
+  LOG_DEBUG("[Timing] %s", line);
+
+  static uint16_t sinceSummary = 0;
+  if (++sinceSummary >= CLOUD_TIMING_SUMMARY_EVERY) {
+    sinceSummary = 0;
+    CloudTimingSummary summary;
+    g_timing.summarize(&summary);
+    char text[320];
+    formatCloudSummary(summary, text, sizeof(text));
+    LOG_DEBUG("[Timing] %s", text);
+  }
+}
+
 // Make HTTP request to Supabase Edge Function
+// what: short name for the timing log ("pair", "upload", ...)
 // contentType: "application/json" for JSON, "image/bmp" for binary
-static bool httpRequest(const char *method, const char *endpoint,
+static bool httpRequest(const char *what, const char *method, const char *endpoint,
                         const char *contentType, const uint8_t *body,
                         size_t bodySize, char *responseOut,
                         size_t responseMaxSize) {
@@ -59,7 +256,12 @@ static bool httpRequest(const char *method, const char *endpoint,
     return false;
   }
 
-  WiFiClientSecure secureClient;
+  CloudTiming timing = {};
+  timing.what = what;
+  timing.atMs = millis();
+  uint32_t t0 = micros();
+
+  TimedClient secureClient;
   secureClient.setInsecure(); // Skip CA verification — Supabase has a valid cert
                               // but bundling root CAs wastes flash and breaks on rotation
 
@@ -73,30 +275,33 @@ static bool httpRequest(const char *method, const char *endpoint,
 
   // Dynamic timeout: 30s for large image uploads, 10s for pairing/status checks.
   // This prevents the background task from hanging indefinitely if the server is slow.
-  if (strstr(contentType, "image")) {
-    http.setTimeout(30000);
-  } else {
-    http.setTimeout(10000);
-  }
+  uint16_t timeoutMs = strstr(contentType, "image") ? 30000 : 10000;
+  http.setTimeout(timeoutMs);
 
   http.addHeader("Content-Type", contentType);
   http.addHeader("Authorization", String("Bearer ") + SUPABASE_ANON_KEY);
   http.addHeader("apikey", SUPABASE_ANON_KEY);
 
-  int httpCode = -1;
+  int httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+  if (strcmp(method, "GET") == 0) bodySize = 0;
 
-  if (strcmp(method, "POST") == 0) {
-    httpCode = http.POST((uint8_t *)body, bodySize);
-  } else if (strcmp(method, "GET") == 0) {
-    httpCode = http.GET();
+  if (connectTimed(secureClient, timing, timeoutMs)) {
+    secureClient.sending();
+    if (strcmp(method, "POST") == 0) {
+      httpCode = http.POST((uint8_t *)body, bodySize);
+    } else if (strcmp(method, "GET") == 0) {
+      httpCode = http.GET();
+    }
   }
+  String payload;
+  if (httpCode > 0) payload = http.getString();
+  noteCloudRequest(timing, secureClient, httpCode, bodySize, payload.length(), t0);
 
   bool success = false;
   if (httpCode > 0) {
     LOG_DEBUG("[HTTP] Response code: %d", httpCode);
 
     if (httpCode == HTTP_CODE_OK || httpCode == 200) {
-      String payload = http.getString();
       size_t copySize = min(payload.length(), responseMaxSize - 1);
       payload.toCharArray(responseOut, copySize + 1);
       responseOut[copySize] = '\0';
@@ -104,7 +309,6 @@ static bool httpRequest(const char *method, const char *endpoint,
       LOG_DEBUG("[HTTP] Response: %s", responseOut);
     } else {
       LOG_ERROR("[HTTP] Unexpected response code: %d", httpCode);
-      String payload = http.getString();
       LOG_ERROR("[HTTP] Error body: %s", payload.c_str());
     }
   } else {
@@ -170,7 +374,7 @@ char *startPairing(unsigned long *expiresInMs) {
   serializeJson(doc, jsonStr);
 
   char response[2048] = {0};
-  bool ok = httpRequest("POST", "/functions/v1/smart-pen", "application/json",
+  bool ok = httpRequest("pair", "POST", "/functions/v1/smart-pen", "application/json",
                         (uint8_t *)jsonStr.c_str(), jsonStr.length(), response,
                         sizeof(response));
 
@@ -221,7 +425,7 @@ char *checkPairingStatus(const char *code) {
   serializeJson(doc, jsonStr);
 
   char response[1024] = {0};
-  bool ok = httpRequest("POST", "/functions/v1/smart-pen", "application/json",
+  bool ok = httpRequest("status", "POST", "/functions/v1/smart-pen", "application/json",
                         (uint8_t *)jsonStr.c_str(), jsonStr.length(), response,
                         sizeof(response));
 
@@ -307,8 +511,10 @@ char *uploadImage(const uint8_t *imageData, size_t imageSize) {
 
   // Send image as binary data - use global buffer to avoid stack overflow
   memset(g_responseBuffer, 0, sizeof(g_responseBuffer));
-  bool ok = httpRequest("POST", endpoint.c_str(), "image/jpeg", imageData,
+  uploadBegin(imageSize);
+  bool ok = httpRequest("upload", "POST", endpoint.c_str(), "image/jpeg", imageData,
                         imageSize, g_responseBuffer, sizeof(g_responseBuffer));
+  uploadEnd(ok);
 
   if (ok) {
     // Parse response
@@ -343,11 +549,39 @@ char *uploadImage(const uint8_t *imageData, size_t imageSize) {
 }
 
 
+// Request body for sendRequest(): the file, counting what HTTPClient has
+// read of it so far
+class CountingStream : public Stream {
+public:
+  explicit CountingStream(Stream &in) : _in(in) {}
+  int available() override { return _in.available(); }
+  int peek() override { return _in.peek(); }
+  int read() override {
+    int c = _in.read();
+    if (c >= 0) g_uploadSent = g_uploadSent + 1;
+    return c;
+  }
+  size_t readBytes(char *buffer, size_t length) override {
+    size_t n = _in.readBytes(buffer, length);
+    g_uploadSent = g_uploadSent + n;
+    return n;
+  }
+  size_t write(uint8_t) override { return 0; }
+
+private:
+  Stream &_in;
+};
+
 // Make HTTP request from a file stream to save memory during SD sync
-static bool httpRequestStream(const char *endpoint, File &file, size_t fileSize, char *responseOut, size_t responseMaxSize) {
+static bool httpRequestStream(const char *what, const char *endpoint, const char *contentType, File &file, size_t fileSize, char *responseOut, size_t responseMaxSize) {
   if (!WiFi.isConnected()) return false;
 
-  WiFiClientSecure secureClient;
+  CloudTiming timing = {};
+  timing.what = what;
+  timing.atMs = millis();
+  uint32_t t0 = micros();
+
+  TimedClient secureClient;
   secureClient.setInsecure();
 
   HTTPClient http;
@@ -359,24 +593,31 @@ static bool httpRequestStream(const char *endpoint, File &file, size_t fileSize,
   http.setTimeout(30000);
   http.begin(secureClient, url);
   
-  http.addHeader("Content-Type", "image/jpeg");
+  http.addHeader("Content-Type", contentType);
   http.addHeader("Authorization", String("Bearer ") + SUPABASE_ANON_KEY);
   http.addHeader("apikey", SUPABASE_ANON_KEY);
 
   // Send the file stream directly without buffering it all into RAM
-  int httpCode = http.sendRequest("POST", &file, fileSize);
+  CountingStream body(file);
+  int httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+  if (connectTimed(secureClient, timing, 30000)) {
+    secureClient.sending();
+    httpCode = http.sendRequest("POST", &body, fileSize);
+  }
+  String payload;
+  if (httpCode > 0) payload = http.getString();
+  noteCloudRequest(timing, secureClient, httpCode, fileSize, payload.length(), t0);
 
   bool success = false;
   if (httpCode > 0) {
     LOG_DEBUG("[HTTP] Response code: %d", httpCode);
     if (httpCode == HTTP_CODE_OK || httpCode == 200) {
-      String payload = http.getString();
       size_t copySize = min(payload.length(), responseMaxSize - 1);
       payload.toCharArray(responseOut, copySize + 1);
       responseOut[copySize] = '\0';
       success = true;
     } else {
-      LOG_ERROR("[HTTP] Server Rejected File: %s", http.getString().c_str());
+      LOG_ERROR("[HTTP] Server Rejected File: %s", payload.c_str());
     }
   } else {
     LOG_ERROR("[HTTP] Stream Connection failed: %s", http.errorToString(httpCode).c_str());
@@ -396,28 +637,48 @@ void syncPendingQueue() {
 
   LOG_DEBUG("[Sync] Found pending offline upload: %s", filename.c_str());
 
-  // Use the safe buffer read that allocates into SRAM/PSRAM, 
-  // ensuring the SD card is closed immediately after and the SPI bus is freed.
-  size_t imageSize = 0;
-  uint8_t *imageBuffer = readImageFromSD(filename, &imageSize);
-  
-  if (!imageBuffer || imageSize == 0) {
-    LOG_ERROR("[Sync] Corrupt SD file or out of memory, deleting: %s", filename.c_str());
-    deleteImageFromSD(filename);
-    if (imageBuffer) free(imageBuffer);
-    return;
-  }
-
   // Build endpoint with auth token
   String endpoint = String("/functions/v1/smart-pen?token=") + token;
   memset(g_responseBuffer, 0, sizeof(g_responseBuffer));
 
-  // Dispatch the HTTP request 
-  bool ok = httpRequest("POST", endpoint.c_str(), "image/jpeg", imageBuffer,
-                        imageSize, g_responseBuffer, sizeof(g_responseBuffer));
-                        
-  // Free the buffer immediately after sending to recover memory
-  free(imageBuffer);
+  bool ok;
+  if (filename.endsWith(".pdf")) {
+    // Multi-page documents can run to several MB, so stream them from SD
+    // rather than buffering the whole file.
+    File file = SD.open(filename, FILE_READ);
+    if (!file || file.size() == 0) {
+      LOG_ERROR("[Sync] Unreadable document, deleting: %s", filename.c_str());
+      if (file) file.close();
+      deleteImageFromSD(filename);
+      return;
+    }
+    uploadBegin(file.size());
+    ok = httpRequestStream("document", endpoint.c_str(), "application/pdf", file, file.size(),
+                           g_responseBuffer, sizeof(g_responseBuffer));
+    uploadEnd(ok);
+    file.close();
+  } else {
+    // Use the safe buffer read that allocates into SRAM/PSRAM,
+    // ensuring the SD card is closed immediately after and the SPI bus is freed.
+    size_t imageSize = 0;
+    uint8_t *imageBuffer = readImageFromSD(filename, &imageSize);
+
+    if (!imageBuffer || imageSize == 0) {
+      LOG_ERROR("[Sync] Corrupt SD file or out of memory, deleting: %s", filename.c_str());
+      deleteImageFromSD(filename);
+      if (imageBuffer) free(imageBuffer);
+      return;
+    }
+
+    // Dispatch the HTTP request
+    uploadBegin(imageSize);
+    ok = httpRequest("sync", "POST", endpoint.c_str(), "image/jpeg", imageBuffer,
+                     imageSize, g_responseBuffer, sizeof(g_responseBuffer));
+    uploadEnd(ok);
+
+    // Free the buffer immediately after sending to recover memory
+    free(imageBuffer);
+  }
 
   if (ok) {
     JsonDocument doc;
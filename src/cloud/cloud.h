@@ -26,6 +26,20 @@ char* uploadImage(const uint8_t* imageData, size_t imageSize);
 // Retry failed uploads from queue
 void syncPendingQueue();
 
+// Upload the cloud task is running now, for the web page's live status.
+// Streamed documents count up as they are read from SD; a buffered JPEG
+// only reports its size until it is sent.
+struct UploadProgress {
+  bool active;
+  uint32_t sent;          // body bytes handed to the connection so far
+  uint32_t total;
+};
+void getUploadProgress(UploadProgress *out);
+
+// Phase timings of recent cloud requests (see cloud_timing.h)
+class CloudTimingLog;
+const CloudTimingLog& getCloudTiming();
+
 // Get current auth token (returns NULL if not paired)
 const char* getAuthToken();
 
@@ -35,4 +49,7 @@ void setAuthToken(const char* token);
 // Clear auth token (unpair from current account)
 void clearAuthToken();
 
+// This pen's ID ("<DEVICE_NAME>-A1B2C3", from the MAC), as sent at pairing
+const char* getUniquePenID();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "cloud_timing.h"
+#include <algorithm>
+
+void CloudTimingLog::add(const CloudTiming &t) {
+  portENTER_CRITICAL(&_mux);
+  _ring[_head] = t;
+  _head = (_head + 1) % CLOUD_TIMING_RING;
+  if (_count < CLOUD_TIMING_RING) _count++;
+  _total++;
+  if (t.code <= 0) _failed++;
+  portEXIT_CRITICAL(&_mux);
+}
+
+uint16_t CloudTimingLog::recent(CloudTiming *out, uint16_t max) const {
+  portENTER_CRITICAL(&_mux);
+  uint16_t n = std::min(max, _count);
+  for (uint16_t i = 0; i < n; i++) {
+    out[i] = _ring[(_head + CLOUD_TIMING_RING - 1 - i) % CLOUD_TIMING_RING];
+  }
+  portEXIT_CRITICAL(&_mux);
+  return n;
+}
+
+uint32_t CloudTimingLog::sendRate(const CloudTiming &t) {
+  if (!(t.reached & (1 << CLOUD_SEND)) || t.sentBytes < CLOUD_TIMING_RATE_MIN || t.us[CLOUD_SEND] == 0)
+    return 0;
+  return (uint32_t)((uint64_t)t.sentBytes * 1000000 / t.us[CLOUD_SEND]);
+}
+
+uint16_t CloudTimingLog::gather(uint8_t phase, uint32_t *out) const {
+  uint16_t n = 0;
+  portENTER_CRITICAL(&_mux);
+  for (uint16_t i = 0; i < _count; i++) {
+    const CloudTiming &t = _ring[i];
+    if (phase == CLOUD_PHASES) {
+      uint32_t rate = sendRate(t);
+      if (rate) out[n++] = rate;
+    } else if (t.reached & (1 << phase)) {
+      out[n++] = t.us[phase];
+    }
+  }
+  portEXIT_CRITICAL(&_mux);
+  return n;
+}
+
+// Nearest rank: the smallest value with at least p% of them at or below it
+static uint32_t percentile(const uint32_t *sorted, uint16_t n, uint8_t p) {
+  uint16_t rank = (uint16_t)((n * p + 99) / 100);
+  return sorted[rank ? rank - 1 : 0];
+}
+
+static void rank(uint32_t *v, uint16_t n, CloudPhaseStats *out) {
+  *out = {};
+  if (!n) return;
+  std::sort(v, v + n);
+  out->n = n;
+  out->p50 = percentile(v, n, 50);
+  out->p90 = percentile(v, n, 90);
+  out->p99 = percentile(v, n, 99);
+  out->max = v[n - 1];
+}
+
+void CloudTimingLog::summarize(CloudTimingSummary *out) const {
+  uint32_t v[CLOUD_TIMING_RING];
+  for (uint8_t p = 0; p < CLOUD_PHASES; p++) rank(v, gather(p, v), &out->phase[p]);
+  rank(v, gather(CLOUD_PHASES, v), &out->sendRate);
+  portENTER_CRITICAL(&_mux);
+  out->requests = _count;
+  out->total = _total;
+  out->failed = _failed;
+  portEXIT_CRITICAL(&_mux);
+}
+
+const char *CloudTimingLog::phaseName(CloudPhase p) {
+  switch (p) {
+  case CLOUD_DNS: return "dns";
+  case CLOUD_CONNECT: return "connect";
+  case CLOUD_SEND: return "send";
+  case CLOUD_TTFB: return "ttfb";
+  case CLOUD_RECV: return "recv";
+  case CLOUD_TOTAL: return "total";
+  default: return "?";
+  }
+}
+
+// ============================================
+// Serial log lines
+// ============================================
+void formatCloudTiming(const CloudTiming &t, char *out, size_t size) {
+  size_t n = snprintf(out, size, "%s %d:", t.what, t.code);
+  const char *sep = "";
+  for (uint8_t p = 0; p < CLOUD_TOTAL && n < size; p++) {
+    if (!(t.reached & (1 << p))) continue;
+    n += snprintf(out + n, size - n, "%s %s %lu", sep, CloudTimingLog::phaseName((CloudPhase)p),
+                  (unsigned long)((t.us[p] + 500) / 1000));
+    if (p == CLOUD_SEND && t.sentBytes >= CLOUD_TIMING_RATE_MIN && t.us[p] && n < size) {
+      n += snprintf(out + n, size - n, " (%lu KB/s)",
+                    (unsigned long)((uint64_t)t.sentBytes * 1000000 / t.us[p] / 1024));
+    }
+    sep = ",";
+  }
+  if (n < size) {
+    snprintf(out + n, size - n, " ms; %lu ms total, %lu B up, %lu B down",
+             (unsigned long)((t.us[CLOUD_TOTAL] + 500) / 1000), (unsigned long)t.sentBytes,
+             (unsigned long)t.recvBytes);
+  }
+}
+
+void formatCloudSummary(const CloudTimingSummary &s, char *out, size_t size) {
+  size_t n = snprintf(out, size, "last %u of %lu (%lu failed), p50/p90/p99 ms:", s.requests,
+                      (unsigned long)s.total, (unsigned long)s.failed);
+  for (uint8_t p = 0; p < CLOUD_PHASES && n < size; p++) {
+    const CloudPhaseStats &ph = s.phase[p];
+    if (!ph.n) continue;
+    n += snprintf(out + n, size - n, " %s %lu/%lu/%lu", CloudTimingLog::phaseName((CloudPhase)p),
+                  (unsigned long)((ph.p50 + 500) / 1000), (unsigned long)((ph.p90 + 500) / 1000),
+                  (unsigned long)((ph.p99 + 500) / 1000));
+  }
+  if (s.sendRate.n && n < size) {
+    snprintf(out + n, size - n, "; upload p50 %lu KB/s (n=%u)", (unsigned long)(s.sendRate.p50 / 1024),
+             s.sendRate.n);
+  }
+}
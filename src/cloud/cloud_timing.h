@@ -0,0 +1,92 @@
+// ============================================
+// Cloud Request Timing - ResearchMate
+// Where each cloud round trip spent its time, phase by phase, for the last
+// CLOUD_TIMING_RING requests, with rolling percentiles over them:
+//   dns      host name lookup (near 0 while lwIP has it cached)
+//   connect  TCP connect and TLS handshake (WiFiClientSecure does both in
+//            one call, so they are one phase here)
+//   send     request line, headers and body handed to the connection
+//   ttfb     last byte sent to first byte back: the server's time (OCR
+//            for an upload) plus one round trip
+//   recv     first response byte to the end of the body
+// A phase the request never reached (DNS failed, timed out waiting for
+// the response) is left out of that phase's percentiles.
+//
+// cloud.cpp times each request and adds it here; /api/cloud-timing and the
+// cloud task's serial log read it back. One spinlock; summarize() sorts a
+// phase at a time in a small local copy, so readers need little stack.
+// ============================================
+
+#ifndef CLOUD_TIMING_H
+#define CLOUD_TIMING_H
+
+#include "../config.h"
+#include <Arduino.h>
+
+enum CloudPhase : uint8_t {
+  CLOUD_DNS,
+  CLOUD_CONNECT,
+  CLOUD_SEND,
+  CLOUD_TTFB,
+  CLOUD_RECV,
+  CLOUD_TOTAL,          // start to end, whatever was reached
+  CLOUD_PHASES,
+};
+
+struct CloudTiming {
+  uint32_t atMs;        // millis() when the request started
+  const char *what;     // caller's name for it ("upload", "pair", ...): a literal
+  int16_t code;         // HTTP status; <= 0: it failed before one came back
+  uint8_t reached;      // bit per CloudPhase that was timed
+  uint32_t us[CLOUD_PHASES];
+  uint32_t sentBytes;   // request body
+  uint32_t recvBytes;   // response body
+};
+
+struct CloudPhaseStats {
+  uint16_t n;           // requests in the ring that reached the phase
+  uint32_t p50;
+  uint32_t p90;
+  uint32_t p99;
+  uint32_t max;
+};
+
+struct CloudTimingSummary {
+  uint16_t requests;    // in the ring
+  uint32_t total;       // since boot
+  uint32_t failed;      // ...of which never got a status back
+  CloudPhaseStats phase[CLOUD_PHASES];   // microseconds
+  CloudPhaseStats sendRate;              // bytes/s, bodies of CLOUD_TIMING_RATE_MIN or more
+};
+
+class CloudTimingLog {
+public:
+  void add(const CloudTiming &t);
+
+  // Up to `max` records, newest first
+  uint16_t recent(CloudTiming *out, uint16_t max) const;
+
+  void summarize(CloudTimingSummary *out) const;
+
+  static const char *phaseName(CloudPhase p);
+
+private:
+  // Body bytes/s over the send phase; 0 if too small to tell
+  static uint32_t sendRate(const CloudTiming &t);
+  uint16_t gather(uint8_t phase, uint32_t *out) const; // phase == CLOUD_PHASES: send rates
+
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+  CloudTiming _ring[CLOUD_TIMING_RING] = {};
+  uint16_t _head = 0;       // next slot written
+  uint16_t _count = 0;
+  uint32_t _total = 0;
+  uint32_t _failed = 0;
+};
+
+// One record as a serial log line, e.g.
+//   upload 200: dns 1, connect 812, send 340 (272 KB/s), ttfb 2210, recv 12 ms; 92 KB up, 1 KB down
+void formatCloudTiming(const CloudTiming &t, char *out, size_t size);
+// Percentiles as a serial log line
+void formatCloudSummary(const CloudTimingSummary &s, char *out, size_t size);
+
+#endif // CLOUD_TIMING_H
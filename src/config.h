@@ -71,6 +71,131 @@
 #define IMAGE_QUALITY 12         // JPEG quality (0=best, 63=worst)
 #define IMAGE_SIZE FRAMESIZE_VGA  // 640x480
 
+// Capture quality gate (see camera/quality_gate.cpp)
+// Metrics come from a 1/8-scale decode (200x150 for UXGA).
+#define QUALITY_GATE_BUDGET_MS      2500 // max time spent retrying after the sensor switch
+#define QUALITY_GATE_MAX_ATTEMPTS   5
+#define QUALITY_GATE_RETRY_DELAY_MS 150
+#define QUALITY_GATE_MIN_MEAN       40   // mean luma below this = underexposed
+#define QUALITY_GATE_MAX_MEAN       225  // mean luma above this = overexposed
+#define QUALITY_GATE_MAX_CLIP_PCT   35   // % of pixels crushed or blown
+#define QUALITY_GATE_MIN_CONTRAST   24   // p95 - p5 (sparse text pages sit around 40)
+#define QUALITY_GATE_MIN_SHARPNESS  1000 // contrast-normalised Laplacian x100 (1/8 scale)
+#define QUALITY_GATE_MIN_DENSITY_MBPP 350 // JPEG milli-bits per pixel at quality 4
+
+// Burst scan sessions (see capture/burst_session.cpp)
+#define BURST_INTERVAL_MS       1500             // cadence trigger: one page every 1.5s
+#define BURST_CHANGE_PCT        8                // page-change trigger: JPEG size jump vs last page
+#define BURST_SETTLE_PCT        3                // ...and consecutive frames within this of each other
+#define BURST_RING_PSRAM_PCT    60               // share of free PSRAM given to the frame ring
+#define BURST_RING_MIN_BYTES    (1024UL * 1024UL)
+#define BURST_RING_MAX_BYTES    (8UL * 1024UL * 1024UL)
+
+// Hands-free auto-capture (see imaging/stability_detector.cpp)
+// Luma values are on the 16x12 preview grid (0-255).
+#define AUTO_MAX_MOTION          4    // mean cell change between frames
+#define AUTO_REARM_DELTA         12   // mean cell change vs last shot = new page
+#define AUTO_MAX_SIZE_DELTA_PCT  4    // preview JPEG size drift between frames
+#define AUTO_MIN_PAPER_PCT       35   // bright "paper" cells needed in view
+#define AUTO_MAX_CENTRE_OFF_PCT  20   // paper centroid offset from centre
+#define AUTO_MIN_CONTRAST        30   // max-min cell luma (lens covered / blank)
+#define AUTO_STABLE_MS           700  // hold still this long before firing
+#define AUTO_COOLDOWN_MS         2500 // minimum gap between shots
+
+// Multi-page documents (see capture/document_session.cpp)
+#define PDF_PAGE_DPI             200  // UXGA 1600x1200 -> 8x6in page
+
+// Bilevel (CCITT G4) text output (see capture/bilevel_scan.cpp)
+#define BILEVEL_RADIUS           12   // Sauvola window 25x25 px (~3mm at 200dpi)
+#define BILEVEL_K100             34   // Sauvola k x100
+#define BILEVEL_RANGE            128  // Sauvola R (std-dev dynamic range)
+
+// Live preview pipeline (see display/display.cpp)
+#define PREVIEW_DECODE_CORE      0    // grab + JPEG decode
+#define PREVIEW_PUSH_CORE        1    // DMA push, shares the core with loop()
+#define PREVIEW_LETTERBOX        0    // 1: whole frame with bars, 0: centre-crop to fill
+#define PREVIEW_PEAKING          0    // 1: focus peaking on at boot
+#define PREVIEW_PEAK_THRESHOLD   48   // luma gradient tinted as a sharp edge
+#define PREVIEW_PEAK_COLOR       0xF800 // RGB565 tint (red)
+
+// Static-scene skip (see imaging/change_detector.h)
+#define PREVIEW_SKIP_STATIC      1    // drop preview frames that match the panel
+#define PREVIEW_BLOCK_DELTA      4    // per-MCU DC luma change that counts
+#define PREVIEW_MAX_CHANGED      2    // changed MCUs still treated as noise
+#define PREVIEW_SIZE_DELTA_PCT   3    // JPEG size drift decoded without checking
+#define PREVIEW_MAX_REFRESH_MS   1000 // redraw at least this often
+
+// Preview pacing (see display/preview_governor.h)
+#define PREVIEW_TARGET_FPS       15   // preview rate while the device is otherwise idle
+#define PREVIEW_MIN_FPS          4    // floor while the web server / cloud task is busy
+#define PREVIEW_BUSY_HOLD_MS     500  // one rate cut per this long; quiet time before recovering
+#define PREVIEW_RECOVER_MS       250  // +1 fps per this long once quiet
+#define PREVIEW_BUSY_LOOP_US     2000 // web handlers + portal longer than this = busy
+#define PREVIEW_OVERLAY          0    // 1: fps / decode ms / push ms in the top bar
+
+// Scan review (see display/tile_view.h)
+#define REVIEW_AFTER_CAPTURE     1    // show each saved scan until a long press / timeout
+#define REVIEW_TILE_CACHE        32   // 64x64 decoded tiles in PSRAM (8KB each)
+#define REVIEW_TIMEOUT_MS        20000 // back to the preview after this long untouched
+
+// Scan gallery (see ui/gallery.h, storage/thumbnail.h)
+#define GALLERY_MAX_ENTRIES      512  // newest queued scans listed (48 bytes each, PSRAM)
+#define GALLERY_THUMB_CACHE      24   // decoded 48x36 thumbnails in PSRAM (3.4KB each)
+#define GALLERY_TIMEOUT_MS       30000 // back to the preview after this long untouched
+#define THUMB_QUALITY            80   // sidecar JPEG quality (0-100)
+
+// Scan API and LAN sync (see storage/scan_index.h, net/file_stream.h)
+#define SCAN_INDEX_MAX           4096 // queued files /api/scans lists (64 bytes each, PSRAM)
+#define SCANS_PAGE_DEFAULT       20   // entries per /api/scans page...
+#define SCANS_PAGE_MAX           100  // ...and the most a client may ask for
+#define FILE_STREAM_MAX          2    // downloads at once, one read block each
+#define FILE_STREAM_BLOCK        8192 // SD read per step, internal RAM (whole sectors)
+#define SCAN_TOMBSTONES          256  // removals /api/sync remembers; older clients start over
+#define SYNC_PAGE_DEFAULT        200  // changes per /api/sync response...
+#define SYNC_PAGE_MAX            500  // ...and the most a client may ask for (PSRAM)
+
+// Local web server (see net/http_server.h)
+#define HTTP_PORT                8080
+#define HTTP_MAX_CLIENTS         6    // connections served at once; more wait in the backlog
+#define HTTP_BACKLOG             8    // connections the stack holds until a client slot frees
+#define HTTP_REQUEST_SLOTS       2    // slots streams (live view, events, downloads, export) never take
+#define HTTP_RX_BYTES            2048 // request line + headers + form body, per connection
+#define HTTP_TX_MAX_BYTES        (512UL * 1024UL) // largest response body (PSRAM)
+#define HTTP_CLIENT_TIMEOUT_MS   5000 // drop a client that stalls reading or writing
+#define HTTP_TASK_CORE           0    // socket I/O, next to the WiFi stack
+#define HTTP_TASK_PRIORITY       2
+
+// MJPEG live view (see net/mjpeg_stream.h)
+#define STREAM_MAX_CLIENTS       3    // /stream viewers, within the HTTP_REQUEST_SLOTS stream cap
+#define STREAM_LEND_MS           50   // camera buffer left with slow viewers before they get a copy
+#define STREAM_IDLE_FPS          8    // grabbed for viewers while the TFT preview is off
+
+// Live status push to the web page (see net/event_stream.h)
+#define EVENTS_MAX_CLIENTS       2    // /api/events subscribers (open pages)
+#define EVENTS_MIN_INTERVAL_MS   250  // changes within this go out as one event
+#define EVENTS_KEEPALIVE_MS      15000 // comment on an idle stream, so dead clients get noticed
+#define EVENTS_RETRY_MS          2000 // browser reconnect delay after a dropped stream
+#define EVENTS_POLL_MS           50   // server task's look for a new event while all are sent
+#define EVENTS_RING              4    // events kept for subscribers still writing older ones
+#define EVENTS_MSG_BYTES         320  // one serialized event (two per slot)
+
+// Prometheus metrics (see utils/metrics.h)
+#define METRICS_MAX_BUCKETS      12   // histogram bounds, +Inf aside
+#define METRICS_MAX_COLLECTORS   8    // scrape-time gauge setters
+#define METRICS_TEXT_BYTES       8192 // /metrics render buffer to start with (PSRAM); grown if short
+
+// StatsD push of the same metrics (see net/statsd_exporter.h)
+#define STATSD_HOST              ""   // collector IPv4 address, e.g. "192.168.1.20"; empty: off
+#define STATSD_PORT              8125
+#define STATSD_DOGSTATSD         1    // 1: pen and labels as DogStatsD tags; 0: folded into names
+#define STATSD_FLUSH_MS          10000 // one batch of packets per this long
+#define STATSD_PACKET_BYTES      1432 // one UDP datagram, inside a 1500-byte MTU
+
+// Cloud request timing (see cloud/cloud_timing.h)
+#define CLOUD_TIMING_RING        32   // recent requests kept for /api/cloud-timing and percentiles
+#define CLOUD_TIMING_SUMMARY_EVERY 16 // serial percentile line after this many requests
+#define CLOUD_TIMING_RATE_MIN    4096 // smallest body whose send time counts as a throughput sample
+
 // LVGL configuration
 #define LVGL_H_RES TFT_WIDTH
 #define LVGL_V_RES TFT_HEIGHT
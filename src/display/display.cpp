@@ -3,11 +3,25 @@
 // ILI9163 1.8" — 128x160 portrait
 // ============================================
 
+#include "display.h"
 #include "../config.h"
+#include "../imaging/change_detector.h"
+#include "../imaging/focus_peaking.h"
+#include "../imaging/jpeg_decoder.h"
+#include "../imaging/jpeg_scan.h"
+#include "../imaging/resampler.h"
+#include "../imaging/stability_detector.h"
+#include "../ui/gallery.h"
+#include "../ui/ui.h"
+#include "frame_assembler.h"
+#include "preview_governor.h"
+#include "strip_ring.h"
+#include "tile_view.h"
 #include <SPI.h>
+#include <atomic>
+#include <esp_heap_caps.h>
 #define LGFX_USE_V1
 #include <LovyanGFX.hpp>
-#include <TJpg_Decoder.h>
 #include <WiFi.h>
 #include <qrcode.h>
 
@@ -77,14 +91,91 @@ public:
 static LGFX tft;
 static bool displayInitialized = false;
 
+// The preview push task and the UI drawing in loop() share the panel; every
+// public drawing entry point holds this (recursive) lock.
+static SemaphoreHandle_t displayMutex = nullptr;
+
+struct DisplayLock {
+  DisplayLock() { if (displayMutex) xSemaphoreTakeRecursive(displayMutex, portMAX_DELAY); }
+  ~DisplayLock() { if (displayMutex) xSemaphoreGiveRecursive(displayMutex); }
+};
+
+// Frame results shared between the preview decoder task and loop()
+static portMUX_TYPE previewMux = portMUX_INITIALIZER_UNLOCKED;
+static PreviewStats previewStats = {};
+
+// Preview pacing: the decode task (or loop() on the inline path) asks it
+// before each grab; loop() and the cloud task report load. Also previewMux.
+static PreviewGovernor governor;
+static volatile bool perfOverlay = PREVIEW_OVERLAY;
+static uint32_t inlineFrameMs = 0;
+
 // ============================================
-// JPEG decoder callback
+// Luma probe — coarse grid of the preview for the stability detector, built
+// from MCU DC means (exact block averages). Those come from the entropy
+// pass alone, so cropped edges and frames skipped as unchanged are measured
+// the same way as decoded ones.
 // ============================================
-bool tft_output(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *bitmap) {
-  if (y >= tft.height() || x >= tft.width()) return 1;
-  if (x < 0) return 1; // skip blocks that start left of screen (right edge clips automatically)
-  tft.pushImage(x, y, w, h, (lgfx::swap565_t*)bitmap);
-  return 1;
+static bool     lumaProbeEnabled = false;
+static bool     lumaGridValid    = false;
+static uint16_t probeCellW = 1, probeCellH = 1;
+static uint32_t probeSum[STABILITY_GRID_CELLS];
+static uint16_t probeCount[STABILITY_GRID_CELLS];
+static uint8_t  lumaGrid[STABILITY_GRID_CELLS];
+static uint32_t probeCostUs = 0;
+
+// Inline (non-pipelined) decode: per-MCU push accounting
+static uint32_t inlineTx = 0;
+static uint32_t inlineBytes = 0;
+
+// Frame size in decoder output pixels
+static void probeBegin(uint16_t frameW, uint16_t frameH) {
+  probeCellW = max(1, frameW / STABILITY_GRID_W);
+  probeCellH = max(1, frameH / STABILITY_GRID_H);
+  memset(probeSum, 0, sizeof(probeSum));
+  memset(probeCount, 0, sizeof(probeCount));
+  probeCostUs = 0;
+}
+
+static void probeEnd() {
+  portENTER_CRITICAL(&previewMux);
+  for (int i = 0; i < STABILITY_GRID_CELLS; i++)
+    lumaGrid[i] = probeCount[i] ? (uint8_t)(probeSum[i] / probeCount[i]) : 0;
+  lumaGridValid = true;
+  portEXIT_CRITICAL(&previewMux);
+}
+
+// Weighted by every other pixel in both directions, plenty for a 16x12 grid
+static void probeDc(int16_t x, int16_t y, uint16_t w, uint16_t h, uint8_t luma) {
+  uint32_t t0 = micros();
+  for (uint16_t j = 0; j < h; j += 2) {
+    int cy = (y + j) / probeCellH;
+    if (y + j < 0 || cy >= STABILITY_GRID_H) continue;
+    for (uint16_t i = 0; i < w; i += 2) {
+      int cx = (x + i) / probeCellW;
+      if (x + i < 0 || cx >= STABILITY_GRID_W) continue;
+      probeSum[cy * STABILITY_GRID_W + cx] += luma;
+      probeCount[cy * STABILITY_GRID_W + cx]++;
+    }
+  }
+  probeCostUs += micros() - t0;
+}
+
+void displaySetLumaProbe(bool enabled) {
+  lumaProbeEnabled = enabled;
+  if (!enabled) lumaGridValid = false;
+}
+
+bool displayGetLumaGrid(uint8_t *out, uint32_t *costUs) {
+  portENTER_CRITICAL(&previewMux);
+  bool valid = lumaGridValid;
+  if (valid) {
+    memcpy(out, lumaGrid, STABILITY_GRID_CELLS);
+    if (costUs) *costUs = probeCostUs;
+    lumaGridValid = false; // one read per decoded frame
+  }
+  portEXIT_CRITICAL(&previewMux);
+  return valid;
 }
 
 // ============================================
@@ -144,8 +235,15 @@ void setLastAction(const char *a, bool isError)     { lastActionText = a; lastAc
 // ============================================
 // Helpers
 // ============================================
+static void separatorsOverwritten();
+static void viewfinderOverwritten();
+static bool perfOverlayText(char *buf, size_t size);
+static void overlayTick();
+
 static void clearContent() {
   tft.fillRect(0, CONTENT_Y, W, CONTENT_H, BG_DARK);
+  separatorsOverwritten();
+  viewfinderOverwritten();
 }
 
 static void drawProgressBar(int y, int pct, uint16_t color) {
@@ -159,73 +257,124 @@ static void drawProgressBar(int y, int pct, uint16_t color) {
 }
 
 // ============================================
-// Top bar  (y=0, h=16)
+// Status bars — retained widgets (ui/ui.h). The setters above only change
+// state; drawTopBar()/drawBottomPanel() push the widgets that changed, so a
+// mode or action update costs one text span instead of the whole bar.
 // ============================================
-void drawTopBar() {
-  if (!displayInitialized) return;
+class TftUiBackend : public UiBackend {
+public:
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    tft.fillRect(x, y, w, h, color);
+  }
+  void drawText(const char *s, int16_t x, int16_t y, uint16_t fg, uint16_t bg,
+                const UiRect &clip) override {
+    tft.setClipRect(clip.x, clip.y, clip.w, clip.h);
+    tft.setTextSize(1);
+    tft.setTextDatum(TL_DATUM);
+    tft.setTextColor(fg, bg);
+    tft.drawString(s, x, y);
+    tft.clearClipRect();
+  }
+  int16_t textWidth(const char *s) override {
+    tft.setTextSize(1);
+    return tft.textWidth(s);
+  }
+  int16_t fontHeight() override {
+    tft.setTextSize(1);
+    return tft.fontHeight();
+  }
+};
 
-  tft.fillRect(0, 0, W, TOP_H, BG_PANEL);
-  tft.setTextSize(1);
+#define UI_BOT_Y  (TFT_HEIGHT - BOT_H)
 
-  tft.setTextDatum(ML_DATUM);
-  tft.setTextColor(wifiConnected ? GREEN : RED);
-  tft.drawString(wifiConnected ? "W+" : "W-", 2, TOP_H / 2);
+static TftUiBackend uiBackend;
 
-  tft.setTextDatum(MC_DATUM);
-  tft.setTextColor(WHITE);
-  tft.drawString(currentUIMode.c_str(), W / 2, TOP_H / 2);
+// Top bar  (y=0, h=16)
+static UiFill  topBg({0, 0, TFT_WIDTH, TOP_H}, BG_PANEL);
+static UiFill  topLine({0, TOP_H, TFT_WIDTH, 1}, CYAN);
+static UiLabel wifiLabel({0, 0, 24, TOP_H}, UI_ALIGN_LEFT, BG_PANEL);
+static UiLabel modeLabel({24, 0, TFT_WIDTH - 48, TOP_H}, UI_ALIGN_CENTER, BG_PANEL, 0);
+static UiLabel pairLabel({TFT_WIDTH - 24, 0, 24, TOP_H}, UI_ALIGN_RIGHT, BG_PANEL);
+static UiLayer topBar;
 
-  tft.setTextDatum(MR_DATUM);
-  tft.setTextColor(devicePaired ? CYAN : GRAY);
-  tft.drawString(devicePaired ? "P+" : "P-", W - 2, TOP_H / 2);
+// Bottom bar  (y=BOT_Y, h=24)
+static UiFill  botLine({0, UI_BOT_Y - 1, TFT_WIDTH, 1}, CYAN);
+static UiFill  botBg({0, UI_BOT_Y, TFT_WIDTH, BOT_H}, BG_PANEL);
+static UiLabel actionLabel({0, UI_BOT_Y, TFT_WIDTH - 40, BOT_H}, UI_ALIGN_LEFT, BG_PANEL);
+static UiLabel queueLabel({TFT_WIDTH - 40, UI_BOT_Y, 40, BOT_H}, UI_ALIGN_RIGHT, BG_PANEL);
+static UiLayer bottomBar;
 
-  tft.fillRect(0, TOP_H, W, 1, CYAN);
+static void initStatusBars() {
+  topBar.add(&topBg);
+  topBar.add(&topLine);
+  topBar.add(&wifiLabel);
+  topBar.add(&modeLabel);
+  topBar.add(&pairLabel);
+  bottomBar.add(&botLine);
+  bottomBar.add(&botBg);
+  bottomBar.add(&actionLabel);
+  bottomBar.add(&queueLabel);
 }
 
-// ============================================
-// Bottom bar  (y=BOT_Y, h=24)
-// ============================================
-void drawBottomPanel() {
+// Something else painted over the bars; repaint them in full next time
+static void invalidateStatusBars() {
+  topBar.invalidate();
+  bottomBar.invalidate();
+}
+
+// The separator lines sit on the content zone's first and last rows, which
+// full-zone fills and preview frames overwrite.
+static void separatorsOverwritten() {
+  topLine.invalidate();
+  botLine.invalidate();
+}
+
+void drawTopBar() {
   if (!displayInitialized) return;
+  DisplayLock lock;
 
-  tft.fillRect(0, BOT_Y - 1, W, 1, CYAN);
-  tft.fillRect(0, BOT_Y, W, BOT_H, BG_PANEL);
+  wifiLabel.set(wifiConnected ? "W+" : "W-", wifiConnected ? GREEN : RED);
+  char perf[24];
+  if (perfOverlayText(perf, sizeof(perf))) modeLabel.set(perf, GOLD);
+  else modeLabel.set(currentUIMode.c_str(), WHITE);
+  pairLabel.set(devicePaired ? "P+" : "P-", devicePaired ? CYAN : GRAY);
+  topBar.flush(uiBackend);
+}
 
-  tft.setTextSize(1);
+void drawBottomPanel() {
+  if (!displayInitialized) return;
+  DisplayLock lock;
 
   // Last action — left-aligned, max ~13 chars at size 1
   String action = lastActionText.length() > 0 ? lastActionText : "Ready";
   if (action.length() > 13) action = action.substring(0, 12) + "~";
-  tft.setTextDatum(ML_DATUM);
-  tft.setTextColor(lastActionIsError ? RED : GREEN);
-  tft.drawString(action.c_str(), 2, BOT_Y + BOT_H / 2);
+  actionLabel.set(action.c_str(), lastActionIsError ? RED : GREEN);
 
   // Queue count — right-aligned
   char qBuf[8];
-  sprintf(qBuf, "Q:%d", offlineQueueCount);
-  tft.setTextDatum(MR_DATUM);
-  tft.setTextColor(offlineQueueCount > 0 ? GOLD : GRAY);
-  tft.drawString(qBuf, W - 2, BOT_Y + BOT_H / 2);
+  snprintf(qBuf, sizeof(qBuf), "Q:%d", offlineQueueCount);
+  queueLabel.set(qBuf, offlineQueueCount > 0 ? GOLD : GRAY);
+  bottomBar.flush(uiBackend);
 }
 
 // ============================================
 // Init + boot splash
 // ============================================
+static void initChangeDetection();
+static void initPreviewPacing();
+
 bool initDisplay() {
   if (displayInitialized) return true;
 
   Serial.println("[Display] Initializing 128x160 (ILI9163)...");
 
+  displayMutex = xSemaphoreCreateRecursiveMutex();
   tft.init();
   tft.setRotation(0);       // Portrait: 128 wide x 160 tall
   tft.setBrightness(255);
   tft.fillScreen(BG_DARK);
   tft.setTextWrap(false);
 
-  TJpgDec.setJpgScale(1);
-  TJpgDec.setSwapBytes(true); // TJpgDec will swap high/low bytes so memory is big-endian (swap565_t friendly)
-  TJpgDec.setCallback(tft_output);
-
   // Boot splash
   tft.setTextDatum(MC_DATUM);
   tft.setTextColor(CYAN);
@@ -237,16 +386,24 @@ bool initDisplay() {
   tft.drawString("Smart Pen v1.0", W / 2, H / 2 + 22);
   tft.fillRect(W / 2 - 30, H / 2 + 32, 60, 1, CYAN);
 
+  initStatusBars();
+  initChangeDetection();
+  initPreviewPacing();
   displayInitialized = true;
   Serial.println("[Display] Ready.");
   return true;
 }
 
-void clearScreen()     { tft.fillScreen(BG_DARK); }
-void clearViewfinder() { if (displayInitialized) clearContent(); }
+void clearScreen() {
+  DisplayLock lock;
+  tft.fillScreen(BG_DARK);
+  invalidateStatusBars();
+}
+void clearViewfinder() { DisplayLock lock; if (displayInitialized) clearContent(); }
 
 void displayReady() {
   if (!displayInitialized) return;
+  DisplayLock lock;
   setUIMode("READY");
   setLastAction("Camera Active", false);
   clearContent();
@@ -262,6 +419,7 @@ void displayReady() {
 // ============================================
 void displayWiFiSetupQR(const char *ssid) {
   if (!displayInitialized) return;
+  DisplayLock lock;
 
   clearContent();
   setUIMode("SETUP");
@@ -302,6 +460,7 @@ void displayWiFiSetupQR(const char *ssid) {
 // ============================================
 void displayPairingCode(const char *code) {
   if (!displayInitialized) return;
+  DisplayLock lock;
 
   clearContent();
   setUIMode("PAIRING");
@@ -326,21 +485,654 @@ void displayPairingCode(const char *code) {
 
 // ============================================
 // Camera frame
-// Input: 320x240 JPEG. Scale 1/2 → 160x120.
-// Draw at x=0, y=CONTENT_Y. Right 32px clip naturally at screen edge (128px wide).
+// Input: 320x240 JPEG. Scale 1/2 → 160x120, then resampled into the
+// 128x119 viewfinder below the separator line: centre-cropped to fill it
+// (default) or letterboxed to show the whole frame. The resampler consumes
+// decoder blocks as they arrive, so there is no second pass over the frame,
+// and the decoder skips the MCUs a crop never samples.
 // ============================================
+#define PREVIEW_TOP          (CONTENT_Y + 1)  // keep the cyan separator line
+#define PREVIEW_ROWS         (CONTENT_H - 1)
+#define PREVIEW_BLOCK_ROWS   4   // resampler output; divides PREVIEW_STRIP_ROWS
+
+// Decoder + resampler + change detector for one decoding context (inline
+// or pipeline)
+struct FrameScaler {
+  JpegDecoder decoder;
+  ResampleState rs;
+  uint8_t *work;
+  size_t workSize;
+  bool probe;
+  uint32_t scaleUs;   // this frame: resampler time, excluding its output sink
+  uint32_t sinkUs;
+
+  ChangeDetector change;
+  uint8_t dc[CHANGE_MAX_BLOCKS]; // this frame's MCU DC luma, raster order
+  uint16_t dcBlocks;
+  uint32_t detectUs;  // this frame: entropy-only pre-pass, 0 if none
+
+  bool peaking;       // this frame is tinted on its way to the sink
+  PeakingState peak;
+  uint32_t peakUs;
+
+  volatile bool panelLost; // set from loop(): the last shown frame was drawn over
+};
+
+static FrameScaler inlineScaler;
+static FrameScaler pipelineScaler;
+static volatile uint8_t previewFit = PREVIEW_LETTERBOX ? RESAMPLE_FIT_LETTERBOX : RESAMPLE_FIT_CROP;
+
+void displaySetPreviewFit(bool letterbox) {
+  previewFit = letterbox ? RESAMPLE_FIT_LETTERBOX : RESAMPLE_FIT_CROP;
+}
+
+bool displayPreviewLetterbox() { return previewFit == RESAMPLE_FIT_LETTERBOX; }
+
+static volatile bool focusPeaking = PREVIEW_PEAKING;
+
+void displaySetFocusPeaking(bool on) { focusPeaking = on; }
+bool displayFocusPeaking() { return focusPeaking; }
+
+// Something else was drawn in the viewfinder; the next preview frame must
+// not be dropped as matching it. Taken up by each scaler's own task.
+static void viewfinderOverwritten() {
+  inlineScaler.panelLost = true;
+  pipelineScaler.panelLost = true;
+}
+
+static void initChangeDetection() {
+  ChangeConfig cfg = {};
+  cfg.blockDelta = PREVIEW_BLOCK_DELTA;
+  cfg.maxChangedBlocks = PREVIEW_MAX_CHANGED;
+  cfg.maxSizeDeltaPct = PREVIEW_SIZE_DELTA_PCT;
+  cfg.maxAgeMs = PREVIEW_MAX_REFRESH_MS;
+  changeInit(&inlineScaler.change, cfg);
+  changeInit(&pipelineScaler.change, cfg);
+}
+
+static void dc_input(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h, uint8_t luma) {
+  FrameScaler *fs = (FrameScaler *)ctx;
+  if (fs->dcBlocks < CHANGE_MAX_BLOCKS) fs->dc[fs->dcBlocks] = luma;
+  fs->dcBlocks++;
+  if (fs->probe) probeDc(x, y, w, h, luma);
+}
+
+static bool scaler_input(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                         uint16_t *bitmap) {
+  FrameScaler *fs = (FrameScaler *)ctx;
+  uint32_t t0 = micros();
+  bool ok = resamplePushBlock(&fs->rs, x, y, w, h, bitmap);
+  fs->scaleUs += micros() - t0;
+  return ok;
+}
+
+// Focus peaking, in place, before a block reaches the panel or a buffer
+static void peakOutput(FrameScaler *fs, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                       uint16_t *bitmap) {
+  if (!fs->peaking) return;
+  uint32_t t0 = micros();
+  peakBlock(&fs->peak, x, y, w, h, bitmap);
+  fs->peakUs += micros() - t0;
+}
+
+// Resampler output for the inline path: full-width rows straight to the panel
+static bool tft_output(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *bitmap) {
+  peakOutput((FrameScaler *)ctx, x, y, w, h, bitmap);
+  uint32_t t0 = micros();
+  tft.pushImage(x, y, w, h, (lgfx::swap565_t*)bitmap);
+  inlineTx++;
+  inlineBytes += (uint32_t)w * h * 2;
+  ((FrameScaler *)ctx)->sinkUs += micros() - t0;
+  return 1;
+}
+
+// While the scene is settled, an entropy-only pass (~1/4 of a full decode)
+// compares the frame's MCU DC map with the one on the panel. True = the
+// frame can be dropped; its DC values still fed the luma probe.
+static bool frameUnchanged(FrameScaler *fs, const uint8_t *jpg, size_t len) {
+  fs->detectUs = 0;
+  if (fs->panelLost) {
+    fs->panelLost = false;
+    changeForget(&fs->change);
+  }
+  if (!PREVIEW_SKIP_STATIC || !changePrecheck(&fs->change, len, millis())) return false;
+
+  uint32_t t0 = micros();
+  JpegInfo info;
+  if (jpegReadHeader(jpg, len, &info) != JPEG_OK) return false;
+  if (fs->probe) probeBegin(info.width >> 1, info.height >> 1);
+  JpegDecodeOptions opt = {};
+  opt.scale = 1;
+  opt.dcOnly = true;
+  opt.onDc = dc_input;
+  fs->dcBlocks = 0;
+  bool same = jpegDecode(&fs->decoder, jpg, len, opt, scaler_input, fs, nullptr) == JPEG_DEC_OK &&
+              changeUnchanged(&fs->change, fs->dc, fs->dcBlocks);
+  fs->detectUs = micros() - t0;
+  return same;
+}
+
+// Grow the resampler work buffer (internal RAM; it is touched per pixel)
+static bool reserveWork(FrameScaler *fs, size_t need) {
+  if (need <= fs->workSize) return true;
+  heap_caps_free(fs->work);
+  fs->work = (uint8_t *)heap_caps_malloc(need, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  fs->workSize = fs->work ? need : 0;
+  if (!fs->work) Serial.printf("[Display] Resampler: no %u byte buffer\n", (unsigned)need);
+  return fs->work != nullptr;
+}
+
+// Decode one frame at 1/2 scale and resample it into the viewfinder; `sink`
+// receives PREVIEW_BLOCK_ROWS-high full-width blocks, top to bottom.
+static bool scaleFrame(FrameScaler *fs, const uint8_t *jpg, size_t len, ResampleEmitFn sink,
+                       JpegDecodeStats *st) {
+  JpegInfo info;
+  if (jpegReadHeader(jpg, len, &info) != JPEG_OK || !info.width) return false;
+
+  ResampleConfig cfg = {};
+  cfg.srcW = info.width >> 1;
+  cfg.srcH = info.height >> 1;
+  cfg.dstX = 0;
+  cfg.dstY = PREVIEW_TOP;
+  cfg.dstW = W;
+  cfg.dstH = PREVIEW_ROWS;
+  cfg.fit = previewFit;
+  cfg.bandRows = max<uint8_t>(1, info.vSamp) * 4; // MCU height at 1/2 scale
+  cfg.blockRows = PREVIEW_BLOCK_ROWS;
+  cfg.swapOut = true;
+
+  if (!reserveWork(fs, resampleWorkBytes(cfg)) || !resampleInit(&fs->rs, cfg, fs->work, sink, fs))
+    return false;
+
+  // Peak the image only; edges against letterbox bars are not focus
+  fs->peaking = focusPeaking;
+  fs->peakUs = 0;
+  if (fs->peaking) {
+    peakInit(&fs->peak, PREVIEW_PEAK_THRESHOLD, PREVIEW_PEAK_COLOR, cfg.swapOut);
+    peakFrameStart(&fs->peak, cfg.dstX + fs->rs.imgX, cfg.dstY + fs->rs.imgY, fs->rs.imgW,
+                   fs->rs.imgH);
+  }
+
+  uint16_t sx, sy, sw, sh;
+  resampleSourceRect(&fs->rs, &sx, &sy, &sw, &sh);
+  JpegDecodeOptions opt = {};
+  opt.scale = 1;
+  opt.clipX = sx;
+  opt.clipY = sy;
+  opt.clipW = sw;
+  opt.clipH = sh;
+  opt.onDc = dc_input;
+
+  if (fs->probe) probeBegin(cfg.srcW, cfg.srcH);
+  fs->dcBlocks = 0;
+  fs->scaleUs = fs->sinkUs = 0;
+  bool ok = jpegDecode(&fs->decoder, jpg, len, opt, scaler_input, fs, st) == JPEG_DEC_OK;
+  uint32_t t0 = micros();
+  if (ok) ok = resampleFinish(&fs->rs);
+  fs->scaleUs += micros() - t0;
+  fs->scaleUs -= min(fs->scaleUs, fs->sinkUs + fs->peakUs);
+  if (ok) changeShown(&fs->change, fs->dc, fs->dcBlocks, len, millis());
+  return ok;
+}
+
+// Share of the image tinted: a rough sharpness reading
+static uint8_t peakShare(const FrameScaler *fs) {
+  if (!fs->peaking || !fs->peak.pixels) return 0;
+  return (uint8_t)(fs->peak.tinted * 100 / fs->peak.pixels);
+}
+
 void displayDrawFrame(const uint8_t *jpg_data, size_t jpg_len) {
   if (!displayInitialized || !jpg_data) return;
+  DisplayLock lock;
 
-  TJpgDec.setJpgScale(2);
-  TJpgDec.drawJpg(0, CONTENT_Y, jpg_data, jpg_len);
-  TJpgDec.setJpgScale(1);
+  bool probe = lumaProbeEnabled;
+  inlineScaler.probe = probe;
+  if (frameUnchanged(&inlineScaler, jpg_data, jpg_len)) {
+    if (probe) probeEnd();
+    portENTER_CRITICAL(&previewMux);
+    previewStats.framesSkipped++;
+    previewStats.detectUs = inlineScaler.detectUs;
+    portEXIT_CRITICAL(&previewMux);
+    inlineFrameMs = millis();
+    overlayTick();
+    return;
+  }
+
+  inlineTx = inlineBytes = 0;
+  separatorsOverwritten();
+  JpegDecodeStats st = {};
+  uint32_t t0 = micros();
+  tft.startWrite();
+  bool drawn = scaleFrame(&inlineScaler, jpg_data, jpg_len, tft_output, &st);
   tft.endWrite();
+  uint32_t totalUs = micros() - t0;
+
+  if (probe) probeEnd();
+  portENTER_CRITICAL(&previewMux);
+  // Decode and push interleave here; the panel writes are the push share
+  if (drawn) previewStats.frames++;
+  previewStats.decodeUs = totalUs - min(totalUs, inlineScaler.sinkUs);
+  previewStats.pushUs = inlineScaler.sinkUs;
+  previewStats.txPerFrame = (uint16_t)inlineTx;
+  previewStats.bytesPerFrame = inlineBytes;
+  previewStats.mcusDecoded = st.decoded;
+  previewStats.mcusSkipped = st.skipped + st.notReached;
+  previewStats.scaleUs = inlineScaler.scaleUs;
+  previewStats.peakUs = inlineScaler.peakUs;
+  previewStats.peakPct = peakShare(&inlineScaler);
+  if (inlineScaler.detectUs) previewStats.detectUs = inlineScaler.detectUs;
+  portEXIT_CRITICAL(&previewMux);
+  inlineFrameMs = millis();
+  overlayTick();
+}
+
+// ============================================
+// Preview pipeline
+// Decoder task: grab -> jpegDecode into off-screen RGB565 buffers (internal
+// DMA RAM). Push task: flush each finished buffer with one DMA transfer
+// while the decoder fills the other.
+// Preferred layout is two full viewfinder frames (128x119, ~30KB each), so
+// a frame reaches the panel as a single window-set + transfer instead of
+// hundreds of per-MCU pushImage calls. If that much DMA RAM is not free,
+// three 16-row strips are used instead.
+// A buffer is released only after the following DMA has been queued (which
+// waits for the previous transfer) or the frame's final waitDMA().
+// ============================================
+#define PREVIEW_STRIPS       3
+#define PREVIEW_STRIP_ROWS   16  // multiple of PREVIEW_BLOCK_ROWS
+#define PREVIEW_WINDOW_MS    1000
+#define PREVIEW_SPI_MHZ      27  // matches the bus freq_write
+
+static PreviewGrabFn previewGrab = nullptr;
+static PreviewReleaseFn previewRelease = nullptr;
+static StripRing strips;
+static FrameAssembler assembler;
+static TaskHandle_t decodeTaskHandle = nullptr;
+static TaskHandle_t pushTaskHandle = nullptr;
+static std::atomic<bool> previewWanted{false};
+static std::atomic<bool> decoderBusy{false};
+static std::atomic<bool> pushFrameOpen{false};
+static uint32_t frameSeq = 0;
+static uint32_t frameStallUs = 0;
+
+// Last frame for loop()
+static uint32_t lastFrameLen = 0;
+static uint32_t lastFrameSeq = 0;
+static uint32_t polledFrameSeq = 0;
+
+static void assemblerWaitFree(void *arg) {
+  uint32_t t0 = micros();
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+  frameStallUs += micros() - t0;
+}
+
+static void assemblerCommitted(void *arg) { xTaskNotifyGive(pushTaskHandle); }
+
+static bool buffer_output(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                          uint16_t *bitmap) {
+  peakOutput((FrameScaler *)ctx, x, y, w, h, bitmap);
+  uint32_t t0 = micros();
+  assembler.addBlock(x, y, w, h, bitmap);
+  ((FrameScaler *)ctx)->sinkUs += micros() - t0;
+  return 1;
+}
+
+// False when the frame matched the panel and was dropped before decoding
+static bool decodeFrame(const uint8_t *jpg, size_t len, uint32_t grabUs) {
+  bool probe = lumaProbeEnabled;
+  pipelineScaler.probe = probe;
+  if (frameUnchanged(&pipelineScaler, jpg, len)) {
+    if (probe) probeEnd();
+    return false;
+  }
+
+  // The resampler always emits the whole box (bars included) in full-width rows
+  assembler.beginFrame(++frameSeq, grabUs, PREVIEW_TOP, PREVIEW_TOP + PREVIEW_ROWS, W);
+  JpegDecodeStats st = {};
+  scaleFrame(&pipelineScaler, jpg, len, buffer_output, &st);
+  if (probe) probeEnd();
+  portENTER_CRITICAL(&previewMux);
+  previewStats.mcusDecoded = st.decoded;
+  previewStats.mcusSkipped = st.skipped + st.notReached;
+  previewStats.scaleUs = pipelineScaler.scaleUs;
+  previewStats.peakUs = pipelineScaler.peakUs;
+  previewStats.peakPct = peakShare(&pipelineScaler);
+  portEXIT_CRITICAL(&previewMux);
+
+  // Truncated/corrupt frames still close the push task's frame
+  assembler.endFrame();
+  return true;
+}
+
+static void previewDecodeTask(void *arg) {
+  uint32_t winStart = millis();
+  uint32_t winFrames = 0, winGrab = 0, winDecode = 0, winStall = 0;
+  uint32_t winSkipped = 0, winChecked = 0, winDetect = 0, winSkipCost = 0;
+
+  for (;;) {
+    // Busy is raised before checking the request so a concurrent suspend
+    // either sees us busy or we see its request (both are seq_cst).
+    decoderBusy = true;
+    if (!previewWanted) {
+      decoderBusy = false;
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+      winStart = millis();
+      winFrames = winGrab = winDecode = winStall = 0;
+      winSkipped = winChecked = winDetect = winSkipCost = 0;
+      continue;
+    }
+
+    // Sleep out the rest of the frame period; the camera keeps only the
+    // latest frame, so nothing queues up meanwhile.
+    portENTER_CRITICAL(&previewMux);
+    uint32_t waitUs = governorWaitUs(&governor, micros());
+    portEXIT_CRITICAL(&previewMux);
+    if (waitUs) {
+      decoderBusy = false;
+      vTaskDelay(pdMS_TO_TICKS((waitUs + 999) / 1000));
+      continue;
+    }
+
+    const uint8_t *jpg;
+    size_t len;
+    void *token;
+    uint32_t t0 = micros();
+    if (!previewGrab(&jpg, &len, &token)) {
+      decoderBusy = false;
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+    uint32_t t1 = micros();
+    portENTER_CRITICAL(&previewMux);
+    governorFrameStarted(&governor, t0);
+    portEXIT_CRITICAL(&previewMux);
+    frameStallUs = 0;
+    bool drawn = decodeFrame(jpg, len, t0);
+    uint32_t t2 = micros();
+    previewRelease(token);
+    decoderBusy = false;
+
+    winGrab += t1 - t0;
+    if (pipelineScaler.detectUs) {
+      winChecked++;
+      winDetect += pipelineScaler.detectUs;
+    }
+    if (drawn) {
+      winFrames++;
+      winDecode += (t2 - t1) - frameStallUs;
+      winStall += frameStallUs;
+    } else {
+      winSkipped++;
+      winSkipCost += pipelineScaler.detectUs;
+    }
+
+    portENTER_CRITICAL(&previewMux);
+    // Skipped frames count too: loop() still feeds them to auto-capture
+    lastFrameLen = len;
+    lastFrameSeq++;
+    if (!drawn) previewStats.framesSkipped++;
+    uint32_t winMs = millis() - winStart;
+    if (winMs >= PREVIEW_WINDOW_MS) {
+      uint32_t seen = winFrames + winSkipped;
+      previewStats.grabUs = winGrab / seen;
+      previewStats.decodeUs = winFrames ? winDecode / winFrames : 0;
+      previewStats.stallUs = winFrames ? winStall / winFrames : 0;
+      previewStats.detectUs = winChecked ? winDetect / winChecked : 0;
+      previewStats.skipPct = (uint8_t)(winSkipped * 100 / seen);
+      // Saved vs decoding every frame: each dropped frame avoided a full
+      // decode, and every pre-pass (dropped or not) was paid for
+      uint32_t fullUs = winFrames ? (winDecode - (winDetect - winSkipCost)) / winFrames : 0;
+      uint32_t avoided = winSkipped * fullUs;
+      previewStats.savedCorePct =
+          (uint8_t)min<uint32_t>(100, (avoided - min(avoided, winDetect)) / (winMs * 10));
+      // Grab time is mostly blocked in the driver; count decode as busy
+      previewStats.decodeCorePct =
+          (uint8_t)min<uint32_t>(100, (winDecode + winSkipCost) / (winMs * 10));
+      winStart = millis();
+      winFrames = winGrab = winDecode = winStall = 0;
+      winSkipped = winChecked = winDetect = winSkipCost = 0;
+    }
+    portEXIT_CRITICAL(&previewMux);
+  }
+}
+
+static void previewPushTask(void *arg) {
+  uint32_t winStart = millis();
+  uint32_t winFrames = 0, winPush = 0, winLatency = 0, winTx = 0, winBytes = 0;
+
+  for (;;) {
+    StripInfo s;
+    uint16_t *px;
+    if (!strips.take(&s, &px)) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+      continue;
+    }
+
+    uint32_t t0 = micros();
+    if (!pushFrameOpen) {
+      xSemaphoreTakeRecursive(displayMutex, portMAX_DELAY);
+      tft.startWrite();
+      pushFrameOpen = true;
+    }
+    uint32_t bytes = (uint32_t)s.w * s.h * sizeof(uint16_t);
+    if (s.h) {
+      tft.pushImageDMA(s.x, s.y, s.w, s.h, (lgfx::swap565_t *)px);
+      winTx++;
+      winBytes += bytes;
+    }
+
+    // Queuing this DMA waited for the previous one, so older buffers are free
+    while (strips.taken() > 1) {
+      strips.release();
+      xTaskNotifyGive(decodeTaskHandle);
+    }
+    if (s.endOfFrame) {
+      // Sleep through most of the transfer instead of spinning in waitDMA()
+      // so loop() keeps this core while a full frame is on the wire.
+      uint32_t wireMs = bytes * 8 / (PREVIEW_SPI_MHZ * 1000);
+      uint32_t busyUs = micros() - t0;
+      if (wireMs > 1) vTaskDelay(pdMS_TO_TICKS(wireMs - 1));
+      uint32_t t1 = micros();
+      tft.waitDMA();
+      strips.release();
+      xTaskNotifyGive(decodeTaskHandle);
+      tft.endWrite();
+      pushFrameOpen = false;
+      xSemaphoreGiveRecursive(displayMutex);
+      winFrames++;
+      winLatency += micros() - s.grabUs;
+      winPush += busyUs + (micros() - t1);
+    } else {
+      winPush += micros() - t0;
+    }
+
+    uint32_t winMs = millis() - winStart;
+    if (s.endOfFrame && winMs >= PREVIEW_WINDOW_MS) {
+      portENTER_CRITICAL(&previewMux);
+      previewStats.frames += winFrames;
+      previewStats.fpsX10 = (uint16_t)(winFrames * 10000 / winMs);
+      previewStats.pushUs = winPush / winFrames;
+      previewStats.latencyUs = winLatency / winFrames;
+      previewStats.txPerFrame = (uint16_t)(winTx / winFrames);
+      previewStats.bytesPerFrame = winBytes / winFrames;
+      previewStats.pushCorePct = (uint8_t)min<uint32_t>(100, winPush / (winMs * 10));
+      portEXIT_CRITICAL(&previewMux);
+      winStart = millis();
+      winFrames = winPush = winLatency = winTx = winBytes = 0;
+    }
+  }
+}
+
+static bool allocPreviewBuffers(uint16_t **bufs, int count, size_t bytes) {
+  for (int i = 0; i < count; i++) {
+    bufs[i] = (uint16_t *)heap_caps_malloc(bytes, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (!bufs[i]) {
+      while (i-- > 0) heap_caps_free(bufs[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool displayPreviewBegin(PreviewGrabFn grab, PreviewReleaseFn release) {
+  if (decodeTaskHandle) return true;
+  if (!displayInitialized || !grab || !release) return false;
+
+  uint16_t *bufs[PREVIEW_STRIPS];
+  const char *layout;
+  if (allocPreviewBuffers(bufs, 2, (size_t)W * PREVIEW_ROWS * sizeof(uint16_t))) {
+    strips.attach(bufs, 2, W, PREVIEW_ROWS);
+    layout = "2 full frames";
+  } else if (allocPreviewBuffers(bufs, PREVIEW_STRIPS, (size_t)W * PREVIEW_STRIP_ROWS * sizeof(uint16_t))) {
+    strips.attach(bufs, PREVIEW_STRIPS, W, PREVIEW_STRIP_ROWS);
+    layout = "3 strips";
+  } else {
+    Serial.println("[Display] Preview pipeline: no DMA memory, using inline decode");
+    return false;
+  }
+  assembler.attach(&strips, assemblerWaitFree, assemblerCommitted, nullptr);
+  previewGrab = grab;
+  previewRelease = release;
+
+  xTaskCreatePinnedToCore(previewPushTask, "PreviewPush", 3072, NULL, 2, &pushTaskHandle,
+                          PREVIEW_PUSH_CORE);
+  xTaskCreatePinnedToCore(previewDecodeTask, "PreviewDecode", 6144, NULL, 1, &decodeTaskHandle,
+                          PREVIEW_DECODE_CORE);
+  previewStats.decodeCore = PREVIEW_DECODE_CORE;
+  previewStats.pushCore = PREVIEW_PUSH_CORE;
+  previewStats.bufferRows = strips.rows();
+  Serial.printf("[Display] Preview pipeline: %s (%ux%u), decode core %d, push core %d\n", layout,
+                strips.width(), strips.rows(), PREVIEW_DECODE_CORE, PREVIEW_PUSH_CORE);
+  return true;
+}
+
+void displayPreviewResume() {
+  if (!decodeTaskHandle || previewWanted) return;
+  portENTER_CRITICAL(&previewMux);
+  governorRestart(&governor, micros());
+  portEXIT_CRITICAL(&previewMux);
+  previewWanted = true;
+  xTaskNotifyGive(decodeTaskHandle);
+}
+
+void displayPreviewSuspend() {
+  if (!decodeTaskHandle || !previewWanted) return;
+  previewWanted = false;
+  // Wait for the in-flight frame: camera buffer returned, last strip on the
+  // glass and the panel lock dropped.
+  uint32_t t0 = millis();
+  while ((decoderBusy || strips.inFlight() > 0 || pushFrameOpen) && millis() - t0 < 1000) {
+    vTaskDelay(1);
+  }
+  if (perfOverlay) drawTopBar(); // mode text back in place of the numbers
+}
+
+bool displayPreviewPoll(uint32_t *jpegLen) {
+  portENTER_CRITICAL(&previewMux);
+  bool fresh = lastFrameSeq != polledFrameSeq;
+  polledFrameSeq = lastFrameSeq;
+  if (jpegLen) *jpegLen = lastFrameLen;
+  portEXIT_CRITICAL(&previewMux);
+  if (fresh) {
+    separatorsOverwritten(); // on loop()'s task, like the bar flushes
+    overlayTick();
+  }
+  return fresh;
+}
+
+// Pipeline resumed, or inline frames still arriving
+static bool previewShowing() {
+  return previewWanted || (inlineFrameMs && millis() - inlineFrameMs < PREVIEW_WINDOW_MS);
+}
+
+void displayGetPreviewStats(PreviewStats *out) {
+  portENTER_CRITICAL(&previewMux);
+  *out = previewStats;
+  out->inputFpsX10 = governor.fpsX10;
+  out->targetFps = governor.cfg.targetFps;
+  out->capFps = governor.capFps;
+  out->yieldPct = governor.yieldPct;
+  out->busyEvents = governor.busyEvents;
+  out->rateCuts = governor.cuts;
+  portEXIT_CRITICAL(&previewMux);
+  out->running = previewShowing();
+}
+
+// ============================================
+// Preview pacing + perf overlay
+// ============================================
+static void initPreviewPacing() {
+  GovernorConfig cfg = {};
+  cfg.targetFps = PREVIEW_TARGET_FPS;
+  cfg.minFps = PREVIEW_MIN_FPS;
+  cfg.busyHoldMs = PREVIEW_BUSY_HOLD_MS;
+  cfg.recoverMs = PREVIEW_RECOVER_MS;
+  governorInit(&governor, cfg);
+}
+
+void displaySetPreviewFps(uint8_t fps) {
+  portENTER_CRITICAL(&previewMux);
+  governorSetTarget(&governor, fps);
+  portEXIT_CRITICAL(&previewMux);
+}
+
+void displayPreviewNoteBusy() {
+  portENTER_CRITICAL(&previewMux);
+  governorBusy(&governor, micros());
+  portEXIT_CRITICAL(&previewMux);
+}
+
+void displayPreviewHoldBusy(bool busy) {
+  portENTER_CRITICAL(&previewMux);
+  governorHold(&governor, busy, micros());
+  portEXIT_CRITICAL(&previewMux);
+}
+
+bool displayPreviewFrameDue() {
+  portENTER_CRITICAL(&previewMux);
+  uint32_t now = micros();
+  bool due = governorWaitUs(&governor, now) == 0;
+  if (due) governorFrameStarted(&governor, now);
+  portEXIT_CRITICAL(&previewMux);
+  return due;
+}
+
+void displaySetPerfOverlay(bool on) {
+  if (perfOverlay == on) return;
+  perfOverlay = on;
+  drawTopBar();
+}
+
+bool displayPerfOverlay() { return perfOverlay; }
+
+// "14.8f d12 p8": preview rate, decode and push ms per frame
+static bool perfOverlayText(char *buf, size_t size) {
+  if (!perfOverlay || !previewShowing()) return false;
+  portENTER_CRITICAL(&previewMux);
+  uint16_t fpsX10 = governor.fpsX10;
+  uint32_t decodeMs = (previewStats.decodeUs + 500) / 1000;
+  uint32_t pushMs = (previewStats.pushUs + 500) / 1000;
+  portEXIT_CRITICAL(&previewMux);
+  snprintf(buf, size, "%u.%uf d%lu p%lu", (unsigned)(fpsX10 / 10), (unsigned)(fpsX10 % 10),
+           (unsigned long)min<uint32_t>(decodeMs, 99), (unsigned long)min<uint32_t>(pushMs, 99));
+  return true;
+}
+
+// Refresh the numbers once per stats window; the label only repaints the
+// characters that changed.
+static void overlayTick() {
+  static uint32_t drawnMs = 0;
+  if (!perfOverlay || millis() - drawnMs < PREVIEW_WINDOW_MS) return;
+  drawnMs = millis();
+  drawTopBar();
 }
 
 void displayCaptureFlash() {
   if (!displayInitialized) return;
+  DisplayLock lock;
   tft.fillRect(0, CONTENT_Y, W, CONTENT_H, CYAN);
+  separatorsOverwritten();
+  viewfinderOverwritten();
   delay(40);
   tft.setTextColor(BG_DARK);
   tft.setTextSize(1);
@@ -349,11 +1141,446 @@ void displayCaptureFlash() {
   delay(40);
 }
 
+// ============================================
+// Review screen
+// The last capture, fitted into the viewfinder (1/8 decode, resampled) or
+// zoomed to 1/4, 1/2 or 1/1 through a TileView. The JPEG copy, the fitted
+// view and the tile cache live in PSRAM; a view change decodes only the
+// tiles the cache has not seen. Runs on loop()'s task with the preview
+// stopped, so it borrows the inline decoder and resampler.
+// ============================================
+static const uint8_t REVIEW_SCALE[] = {3, 2, 1, 0}; // by zoom; 3 = fitted view
+static const char *const REVIEW_ZOOM_NAME[] = {"Fit", "1:4", "1:2", "1:1"};
+
+static TileView review;
+static uint8_t reviewTiles = 0;      // cache capacity, 0 = not allocated
+static uint16_t *reviewFit = nullptr; // fitted view, panel byte order
+static uint8_t *reviewJpg = nullptr;
+static size_t reviewCap = 0, reviewLen = 0;
+static uint16_t reviewRows[TFT_WIDTH * PREVIEW_BLOCK_ROWS];
+static uint32_t reviewDecodeUs = 0;
+static ReviewStats reviewStats = {};
+
+static bool review_decode(void *ctx, uint8_t scale, int16_t clipX, int16_t clipY, uint16_t clipW,
+                          uint16_t clipH, TileBlockFn out, void *outCtx) {
+  JpegDecodeOptions opt = {};
+  opt.scale = scale;
+  opt.clipX = clipX;
+  opt.clipY = clipY;
+  opt.clipW = clipW;
+  opt.clipH = clipH;
+  opt.swapBytes = true;
+  uint32_t t0 = micros();
+  bool ok = jpegDecode(&inlineScaler.decoder, reviewJpg, reviewLen, opt, out, outCtx, nullptr) ==
+            JPEG_DEC_OK;
+  reviewDecodeUs += micros() - t0;
+  return ok;
+}
+
+static bool review_output(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                          uint16_t *bitmap) {
+  tft.pushImage(x, PREVIEW_TOP + y, w, h, (lgfx::swap565_t *)bitmap);
+  return 1;
+}
+
+static bool fit_output(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *bitmap) {
+  memcpy(reviewFit + (size_t)(y - PREVIEW_TOP) * W, bitmap, sizeof(uint16_t) * w * h);
+  return 1;
+}
+
+static bool reviewAlloc() {
+  if (reviewTiles) return true;
+  reviewFit = (uint16_t *)heap_caps_malloc((size_t)W * PREVIEW_ROWS * sizeof(uint16_t),
+                                           MALLOC_CAP_SPIRAM);
+  if (!reviewFit) return false;
+  const size_t tileBytes = TILE_SIZE * TILE_SIZE * sizeof(uint16_t);
+  uint8_t tiles = REVIEW_TILE_CACHE;
+  uint16_t *pool = (uint16_t *)heap_caps_malloc(tiles * tileBytes, MALLOC_CAP_SPIRAM);
+  if (!pool) {
+    tiles = TILE_VIEW_MAX;
+    pool = (uint16_t *)heap_caps_malloc(tiles * tileBytes, MALLOC_CAP_SPIRAM);
+  }
+  if (!pool || !tileViewInit(&review, W, PREVIEW_ROWS, pool, tiles, review_decode, nullptr)) {
+    heap_caps_free(pool);
+    heap_caps_free(reviewFit);
+    reviewFit = nullptr;
+    Serial.println("[Display] Review: no PSRAM for the tile cache");
+    return false;
+  }
+  reviewTiles = tiles;
+  Serial.printf("[Display] Review: %u tile cache (%u KB PSRAM)\n", tiles,
+                (unsigned)(tiles * tileBytes / 1024));
+  return true;
+}
+
+// 1/8 decode resampled into reviewFit, letterboxed
+static bool reviewBuildFit(const JpegInfo &info) {
+  ResampleConfig cfg = {};
+  cfg.srcW = tileScaled(info.width, 3);
+  cfg.srcH = tileScaled(info.height, 3);
+  cfg.dstX = 0;
+  cfg.dstY = PREVIEW_TOP;
+  cfg.dstW = W;
+  cfg.dstH = PREVIEW_ROWS;
+  cfg.fit = RESAMPLE_FIT_LETTERBOX;
+  cfg.bandRows = max<uint8_t>(1, info.vSamp); // MCU height at 1/8 scale
+  cfg.blockRows = PREVIEW_BLOCK_ROWS;
+  cfg.swapOut = true;
+  FrameScaler *fs = &inlineScaler;
+  if (!reserveWork(fs, resampleWorkBytes(cfg)) || !resampleInit(&fs->rs, cfg, fs->work, fit_output, fs))
+    return false;
+
+  uint16_t sx, sy, sw, sh;
+  resampleSourceRect(&fs->rs, &sx, &sy, &sw, &sh);
+  JpegDecodeOptions opt = {};
+  opt.scale = 3;
+  opt.clipX = sx;
+  opt.clipY = sy;
+  opt.clipW = sw;
+  opt.clipH = sh;
+  return jpegDecode(&fs->decoder, reviewJpg, reviewLen, opt, scaler_input, fs, nullptr) ==
+             JPEG_DEC_OK &&
+         resampleFinish(&fs->rs);
+}
+
+static void reviewRender() {
+  ReviewStats &st = reviewStats;
+  uint32_t t0 = micros();
+  reviewDecodeUs = 0;
+  separatorsOverwritten();
+  viewfinderOverwritten();
+  tft.startWrite();
+  if (st.zoom == 0) {
+    tft.pushImage(0, PREVIEW_TOP, W, PREVIEW_ROWS, (lgfx::swap565_t *)reviewFit);
+    st.tilesNeeded = st.tilesHit = 0;
+  } else {
+    int32_t ox, oy;
+    uint8_t scale = REVIEW_SCALE[st.zoom];
+    tileViewOrigin(&review, scale, st.cx, st.cy, &ox, &oy);
+    if (!tileViewRender(&review, scale, ox, oy, reviewRows, PREVIEW_BLOCK_ROWS, review_output,
+                        nullptr))
+      Serial.printf("[Display] Review: %s view decoded with errors\n", REVIEW_ZOOM_NAME[st.zoom]);
+    st.tilesNeeded = review.stats.lastNeeded;
+    st.tilesHit = review.stats.lastHits;
+  }
+  tft.endWrite();
+  st.views++;
+  st.viewUs = micros() - t0;
+  st.decodeUs = reviewDecodeUs;
+
+  char msg[24];
+  snprintf(msg, sizeof(msg), "%s %lums", REVIEW_ZOOM_NAME[st.zoom],
+           (unsigned long)((st.viewUs + 500) / 1000));
+  setLastAction(msg, false);
+  drawTopBar();
+  drawBottomPanel();
+}
+
+bool displayReviewBegin(const uint8_t *jpg, size_t len) {
+  if (!displayInitialized || !jpg) return false;
+  DisplayLock lock;
+
+  JpegInfo info;
+  if (jpegReadHeader(jpg, len, &info) != JPEG_OK || !info.width) return false;
+  if (!reviewAlloc()) return false;
+  if (len > reviewCap) {
+    heap_caps_free(reviewJpg);
+    reviewJpg = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+    reviewCap = reviewJpg ? len : 0;
+    if (!reviewJpg) {
+      Serial.printf("[Display] Review: no %u bytes PSRAM for the scan\n", (unsigned)len);
+      return false;
+    }
+  }
+  memcpy(reviewJpg, jpg, len);
+  reviewLen = len;
+  tileViewSetImage(&review, info.width, info.height);
+
+  uint32_t t0 = micros();
+  if (!reviewBuildFit(info)) {
+    Serial.println("[Display] Review: could not decode the scan");
+    return false;
+  }
+  ReviewStats &st = reviewStats;
+  st.fitUs = micros() - t0;
+  st.active = true;
+  st.imageW = info.width;
+  st.imageH = info.height;
+  st.zoom = 0;
+  st.cx = info.width / 2;
+  st.cy = info.height / 2;
+  setUIMode("REVIEW");
+  reviewRender();
+  return true;
+}
+
+bool displayReviewView(uint8_t zoom, int32_t cx, int32_t cy) {
+  if (!displayInitialized || !reviewStats.active) return false;
+  DisplayLock lock;
+  ReviewStats &st = reviewStats;
+  st.zoom = zoom < 4 ? zoom : 3;
+  st.cx = constrain(cx, 0, (int32_t)st.imageW - 1);
+  st.cy = constrain(cy, 0, (int32_t)st.imageH - 1);
+  reviewRender();
+  return true;
+}
+
+void displayReviewEnd() { reviewStats.active = false; }
+
+bool displayReviewActive() { return reviewStats.active; }
+
+void displayGetReviewStats(ReviewStats *out) {
+  *out = reviewStats;
+  out->cacheTiles = reviewTiles;
+  out->evictions = review.stats.evictions;
+  out->hitPct = review.stats.lookups ? (uint8_t)(review.stats.hits * 100 / review.stats.lookups) : 0;
+}
+
+// ============================================
+// Gallery
+// Queued scans, newest first, GALLERY_ROWS to a screen: sidecar thumbnail,
+// position, file type and name. Only the rows on screen touch the card,
+// and thumbnails already decoded come from the PSRAM cache. Runs on
+// loop()'s task with the preview stopped, so it borrows the inline decoder.
+// ============================================
+#define GALLERY_ROWS  3
+#define GALLERY_ROW_H (PREVIEW_ROWS / GALLERY_ROWS)
+
+static Gallery gallery;
+static uint8_t galleryThumbs = 0; // cache capacity, 0 = not allocated
+static GalleryStore *galleryStore = nullptr;
+static GalleryViewStats galleryStats = {};
+
+static bool gallery_output(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                           uint16_t *bitmap) {
+  uint16_t *px = (uint16_t *)ctx;
+  int16_t cw = min<int16_t>(w, GALLERY_THUMB_W - x), ch = min<int16_t>(h, GALLERY_THUMB_H - y);
+  for (int16_t r = 0; r < ch; r++) {
+    memcpy(px + (size_t)(y + r) * GALLERY_THUMB_W + x, bitmap + (size_t)r * w,
+           sizeof(uint16_t) * cw);
+  }
+  return 1;
+}
+
+static bool gallery_decode(void *ctx, const uint8_t *jpg, size_t len, uint16_t *px) {
+  JpegInfo info;
+  if (jpegReadHeader(jpg, len, &info) != JPEG_OK || info.width != GALLERY_THUMB_W ||
+      info.height != GALLERY_THUMB_H)
+    return false;
+  JpegDecodeOptions opt = {};
+  opt.swapBytes = true;
+  return jpegDecode(&inlineScaler.decoder, jpg, len, opt, gallery_output, px, nullptr) ==
+         JPEG_DEC_OK;
+}
+
+static bool galleryAlloc() {
+  if (galleryThumbs) return true;
+  const size_t thumbBytes = GALLERY_THUMB_W * GALLERY_THUMB_H * sizeof(uint16_t);
+  const uint8_t slots = constrain(GALLERY_THUMB_CACHE, GALLERY_ROWS, GALLERY_THUMB_MAX);
+  GalleryEntry *entries = (GalleryEntry *)heap_caps_malloc(
+      GALLERY_MAX_ENTRIES * sizeof(GalleryEntry), MALLOC_CAP_SPIRAM);
+  uint16_t *thumbs = (uint16_t *)heap_caps_malloc(slots * thumbBytes, MALLOC_CAP_SPIRAM);
+  uint8_t *file = (uint8_t *)heap_caps_malloc(GALLERY_FILE_MAX, MALLOC_CAP_SPIRAM);
+  if (!entries || !thumbs || !file ||
+      !gallery.attach(entries, GALLERY_MAX_ENTRIES, thumbs, slots, file)) {
+    heap_caps_free(entries);
+    heap_caps_free(thumbs);
+    heap_caps_free(file);
+    Serial.println("[Display] Gallery: no PSRAM for the index");
+    return false;
+  }
+  galleryThumbs = slots;
+  Serial.printf("[Display] Gallery: %u entries, %u thumbnail cache (%u KB PSRAM)\n",
+                GALLERY_MAX_ENTRIES, slots,
+                (unsigned)((GALLERY_MAX_ENTRIES * sizeof(GalleryEntry) +
+                            slots * thumbBytes + GALLERY_FILE_MAX) / 1024));
+  return true;
+}
+
+static const char *galleryType(const char *name) {
+  const char *dot = strrchr(name, '.');
+  if (!dot) return "?";
+  if (strcasecmp(dot, ".jpg") == 0) return "JPG";
+  if (strcasecmp(dot, ".pdf") == 0) return "PDF";
+  return dot + 1;
+}
+
+static void galleryRow(uint8_t row) {
+  const int16_t y = PREVIEW_TOP + row * GALLERY_ROW_H;
+  const uint16_t i = galleryStats.first + row;
+  const bool sel = i == galleryStats.selected;
+  tft.fillRect(0, y, W, GALLERY_ROW_H, sel ? BG_STATUS : BG_DARK);
+  if (i >= gallery.count()) return;
+
+  const GalleryEntry &e = gallery.entry(i);
+  const uint32_t loads = gallery.stats().loads;
+  const uint16_t *px = gallery.thumb(i, *galleryStore, gallery_decode, nullptr);
+  galleryStats.thumbsLoaded += gallery.stats().loads - loads;
+  const int16_t ty = y + (GALLERY_ROW_H - GALLERY_THUMB_H) / 2;
+  const char *type = galleryType(e.name);
+  if (px) {
+    tft.pushImage(2, ty, GALLERY_THUMB_W, GALLERY_THUMB_H, (lgfx::swap565_t *)px);
+  } else {
+    // Burst pages, documents and failed sidecars
+    tft.drawRect(2, ty, GALLERY_THUMB_W, GALLERY_THUMB_H, GRAY);
+    tft.setTextDatum(MC_DATUM);
+    tft.setTextColor(GRAY);
+    tft.drawString(type, 2 + GALLERY_THUMB_W / 2, ty + GALLERY_THUMB_H / 2);
+  }
+  if (sel) tft.drawRect(0, y, W, GALLERY_ROW_H, CYAN);
+
+  // Name without the "scan_" prefix and extension: the capture stamp
+  char stem[12];
+  const char *n = strncmp(e.name, "scan_", 5) == 0 ? e.name + 5 : e.name;
+  const char *dot = strrchr(n, '.');
+  size_t len = min<size_t>(dot ? (size_t)(dot - n) : strlen(n), sizeof(stem) - 1);
+  memcpy(stem, n, len);
+  stem[len] = '\0';
+
+  char line[24];
+  const int16_t tx = GALLERY_THUMB_W + 6;
+  tft.setTextDatum(TL_DATUM);
+  tft.setTextColor(sel ? WHITE : GRAY);
+  snprintf(line, sizeof(line), "%u/%u", i + 1, gallery.count());
+  tft.drawString(line, tx, y + 4);
+  tft.drawString(type, tx, y + 15);
+  tft.drawString(stem, tx, y + 26);
+}
+
+static void galleryPaint() {
+  GalleryViewStats &st = galleryStats;
+  uint32_t t0 = micros();
+  st.thumbsLoaded = 0;
+  separatorsOverwritten();
+  viewfinderOverwritten();
+  tft.setTextSize(1);
+  tft.startWrite();
+  if (gallery.count() == 0) {
+    tft.fillRect(0, PREVIEW_TOP, W, PREVIEW_ROWS, BG_DARK);
+    tft.setTextDatum(MC_DATUM);
+    tft.setTextColor(GRAY);
+    tft.drawString("Queue empty", W / 2, PREVIEW_TOP + PREVIEW_ROWS / 2);
+  } else {
+    for (uint8_t r = 0; r < GALLERY_ROWS; r++) galleryRow(r);
+  }
+  tft.fillRect(0, PREVIEW_TOP + GALLERY_ROWS * GALLERY_ROW_H, W,
+               PREVIEW_ROWS - GALLERY_ROWS * GALLERY_ROW_H, BG_DARK);
+  tft.endWrite();
+  st.paintUs = micros() - t0;
+  st.paints++;
+}
+
+bool displayGalleryOpen(ScanIndex &index, GalleryStore &store) {
+  if (!displayInitialized) return false;
+  DisplayLock lock;
+  if (!galleryAlloc()) return false;
+
+  GalleryViewStats &st = galleryStats;
+  uint32_t t0 = micros();
+  galleryStore = &store;
+  if (!gallery.open(index)) {
+    Serial.println("[Display] Gallery: queue not readable");
+    return false;
+  }
+  st.indexUs = micros() - t0;
+  st.active = true;
+  st.selected = st.first = 0;
+  setUIMode("GALLERY");
+  galleryPaint();
+  st.openUs = micros() - t0;
+
+  char msg[24];
+  snprintf(msg, sizeof(msg), "%u scans %lums", gallery.count(),
+           (unsigned long)((st.openUs + 500) / 1000));
+  setLastAction(msg, false);
+  drawTopBar();
+  drawBottomPanel();
+  return true;
+}
+
+bool displayGallerySelect(uint16_t index) {
+  if (!displayInitialized || !galleryStats.active) return false;
+  DisplayLock lock;
+  GalleryViewStats &st = galleryStats;
+  if (gallery.count()) st.selected = min<uint16_t>(index, gallery.count() - 1);
+  // Keep the selection on screen, moving the window as little as possible
+  if (st.selected < st.first) st.first = st.selected;
+  else if (st.selected >= st.first + GALLERY_ROWS) st.first = st.selected - GALLERY_ROWS + 1;
+  galleryPaint();
+  return true;
+}
+
+void displayGalleryScroll(int step) {
+  uint16_t n = gallery.count();
+  if (!n) return;
+  int32_t i = ((int32_t)galleryStats.selected + step) % n;
+  displayGallerySelect((uint16_t)(i < 0 ? i + n : i));
+}
+
+void displayGalleryEnd() { galleryStats.active = false; }
+
+bool displayGalleryActive() { return galleryStats.active; }
+
+void displayGetGalleryStats(GalleryViewStats *out) {
+  const GalleryStats &g = gallery.stats();
+  *out = galleryStats;
+  out->entries = gallery.count();
+  out->withThumb = g.withThumb;
+  out->dropped = g.dropped;
+  out->lookups = g.lookups;
+  out->loads = g.loads;
+  out->failures = g.failures;
+  out->evictions = g.evictions;
+  out->bytesRead = g.bytesRead;
+  out->hitPct = g.lookups ? (uint8_t)(g.hits * 100 / g.lookups) : 0;
+  out->cacheThumbs = galleryThumbs;
+  out->selectedName[0] = '\0';
+  if (out->selected < gallery.count()) {
+    strncpy(out->selectedName, gallery.entry(out->selected).name, sizeof(out->selectedName) - 1);
+    out->selectedName[sizeof(out->selectedName) - 1] = '\0';
+  }
+}
+
+// ============================================
+// Burst session
+// ============================================
+void displayBurstStatus(uint32_t written, uint32_t pending, uint32_t dropped, int ringPct) {
+  if (!displayInitialized) return;
+  DisplayLock lock;
+
+  clearContent();
+  int cy = CONTENT_Y + CONTENT_H / 2;
+  char buf[24];
+
+  tft.setTextDatum(MC_DATUM);
+  tft.setTextColor(CYAN);
+  tft.setTextSize(2);
+  snprintf(buf, sizeof(buf), "%lu", (unsigned long)(written + pending));
+  tft.drawString(buf, W / 2, cy - 30);
+
+  tft.setTextSize(1);
+  tft.setTextColor(GRAY);
+  tft.drawString("pages", W / 2, cy - 12);
+
+  snprintf(buf, sizeof(buf), "SD %lu  buf %lu", (unsigned long)written, (unsigned long)pending);
+  tft.setTextColor(WHITE);
+  tft.drawString(buf, W / 2, cy + 4);
+
+  if (dropped > 0) {
+    snprintf(buf, sizeof(buf), "dropped %lu", (unsigned long)dropped);
+    tft.setTextColor(RED);
+    tft.drawString(buf, W / 2, cy + 16);
+  }
+
+  drawProgressBar(cy + 28, ringPct, ringPct > 80 ? ORANGE : GREEN);
+}
+
 // ============================================
 // Factory reset
 // ============================================
 void displayWipeStart() {
   if (!displayInitialized) return;
+  DisplayLock lock;
   clearContent();
   tft.setTextDatum(MC_DATUM);
   tft.setTextColor(RED);
@@ -366,11 +1593,13 @@ void displayWipeStart() {
 
 void displayWipeProgress(int pct) {
   if (!displayInitialized) return;
+  DisplayLock lock;
   drawProgressBar(CONTENT_Y + CONTENT_H / 2 + 20, pct, RED);
 }
 
 void displayWipeCancelled() {
   if (!displayInitialized) return;
+  DisplayLock lock;
   tft.fillRect(0, CONTENT_Y + CONTENT_H / 2, W, 20, BG_DARK);
   tft.setTextColor(GREEN);
   tft.setTextDatum(MC_DATUM);
@@ -379,6 +1608,7 @@ void displayWipeCancelled() {
 
 void displayWipeComplete() {
   if (!displayInitialized) return;
+  DisplayLock lock;
   clearContent();
   tft.setTextDatum(MC_DATUM);
   tft.setTextColor(GREEN);
@@ -388,6 +1618,7 @@ void displayWipeComplete() {
 
 void displayFactoryResetProgress(int pct) {
   if (!displayInitialized) return;
+  DisplayLock lock;
 
   if (pct < 0) { displayReady(); return; }
 
@@ -412,7 +1643,9 @@ void displayFactoryResetProgress(int pct) {
 // ============================================
 void displaySleep() {
   if (!displayInitialized) return;
+  DisplayLock lock;
   tft.fillScreen(BLACK);
+  invalidateStatusBars();
   tft.waitDisplay();
   tft.setBrightness(0);
   tft.sleep();
@@ -420,6 +1653,7 @@ void displaySleep() {
 
 void displaySyncing() {
   if (!displayInitialized) return;
+  DisplayLock lock;
   clearContent();
   tft.fillRect(0, CONTENT_Y, W, CONTENT_H, 0x031A);
   tft.setTextColor(WHITE);
@@ -432,10 +1666,12 @@ void displaySyncing() {
 // Legacy compat
 // ============================================
 void drawHeader() {
+  DisplayLock lock;
   tft.fillRect(0, 0, W, TOP_H, BG_PANEL);
   tft.setTextDatum(MC_DATUM);
   tft.setTextColor(CYAN);
   tft.setTextSize(1);
   tft.drawString("ResearchMate", W / 2, TOP_H / 2);
   tft.fillRect(0, TOP_H, W, 1, CYAN);
+  topBar.invalidate();
 }
@@ -60,12 +60,175 @@ void displayPairingCode(const char *code);
 // Draw a raw JPEG frame (320x240 camera output) scaled into the content zone
 void displayDrawFrame(const uint8_t *jpg_data, size_t jpg_len);
 
+// Preview fit: centre-crop to fill the viewfinder, or letterbox the whole
+// frame. Applies to the next decoded frame on either path.
+void displaySetPreviewFit(bool letterbox);
+bool displayPreviewLetterbox();
+
+// Focus peaking: tint sharp edges of the preview so focus can be judged
+// before scanning. Applies to the next decoded frame on either path.
+void displaySetFocusPeaking(bool on);
+bool displayFocusPeaking();
+
+// Coarse luma grid (STABILITY_GRID_W x STABILITY_GRID_H) sampled from each
+// preview frame while decoding, for hands-free auto-capture. costUs reports
+// the probe's share of the decode time.
+void displaySetLumaProbe(bool enabled);
+bool displayGetLumaGrid(uint8_t *out, uint32_t *costUs);
+
+// ============================================
+// Pipelined live preview
+// A decoder task grabs and decodes frames into off-screen RGB565 buffers
+// (two full frames, or strips when DMA RAM is short); a push task flushes
+// each finished buffer with one DMA while the other fills. Frames that
+// match what is on the panel are dropped before decoding. loop() only
+// resumes/suspends it and polls for finished frames.
+// ============================================
+typedef bool (*PreviewGrabFn)(const uint8_t **jpg, size_t *len, void **token);
+typedef void (*PreviewReleaseFn)(void *token);
+
+struct PreviewStats {
+  bool running;
+  uint32_t frames;        // frames fully on the panel
+  uint16_t fpsX10;        // over the last ~1s window
+  uint32_t grabUs;        // per frame: waiting on the camera driver
+  uint32_t decodeUs;      // per drawn frame: decode + strip copies (excl. stalls)
+  uint32_t stallUs;       // per frame: decoder waiting for a free strip
+  uint32_t pushUs;        // per frame: push task time incl. final DMA wait
+  uint32_t latencyUs;     // grab start -> last strip on the panel
+  uint16_t txPerFrame;    // panel write transactions per frame
+  uint32_t bytesPerFrame; // pixel bytes sent per frame
+  uint16_t bufferRows;    // off-screen buffer height (full frame or strip)
+  uint16_t mcusDecoded;   // last frame: MCUs inside the viewfinder
+  uint16_t mcusSkipped;   // last frame: unsampled MCUs, entropy-decoded only
+  uint32_t scaleUs;       // last frame: resampler time (part of decodeUs)
+  uint32_t peakUs;        // last frame: focus peaking (part of decodeUs)
+  uint8_t peakPct;        // last frame: share of the image tinted as in focus
+  uint32_t framesSkipped; // unchanged frames dropped before decode (total)
+  uint8_t skipPct;        // share of frames dropped, last window
+  uint32_t detectUs;      // per pre-checked frame: entropy-only pass
+  uint8_t savedCorePct;   // decoder core time saved vs decoding every frame
+  uint8_t decodeCorePct;  // decoder task share of its core
+  uint8_t pushCorePct;    // push task share of its core
+  uint8_t decodeCore;
+  uint8_t pushCore;
+  uint16_t inputFpsX10;   // frames taken from the camera (drawn or dropped)
+  uint8_t targetFps;
+  uint8_t capFps;         // governed rate, below target while busy
+  uint8_t yieldPct;       // frame budget handed back to other tasks, last window
+  uint32_t busyEvents;    // busy reports from the web server / cloud task
+  uint32_t rateCuts;
+};
+
+// Start the tasks (paused). Returns false when strip memory is unavailable;
+// displayDrawFrame() remains the inline fallback.
+bool displayPreviewBegin(PreviewGrabFn grab, PreviewReleaseFn release);
+void displayPreviewResume();
+// Blocks until the in-flight frame is finished and its camera buffer is
+// returned. Call before anything else touches the camera.
+void displayPreviewSuspend();
+// True once per new preview frame, drawn or dropped as unchanged (its luma
+// grid is still produced); jpegLen is that frame's size.
+bool displayPreviewPoll(uint32_t *jpegLen);
+void displayGetPreviewStats(PreviewStats *out);
+
+// Pacing: the preview runs at up to the target fps and sleeps out the rest
+// of each frame period. Busy reports lower the rate (not below
+// PREVIEW_MIN_FPS) until things have been quiet for a while; a hold keeps
+// it down for the length of a long job such as an upload.
+void displaySetPreviewFps(uint8_t fps);
+void displayPreviewNoteBusy();
+void displayPreviewHoldBusy(bool busy);
+// Inline path: true when the next frame may be grabbed (counted as started)
+bool displayPreviewFrameDue();
+
+// Preview fps, decode ms and push ms in the top bar in place of the mode
+void displaySetPerfOverlay(bool on);
+bool displayPerfOverlay();
+
+// ============================================
+// Review screen
+// The just-captured scan in the viewfinder: fitted (1/8 decode) or zoomed
+// to 1/4, 1/2 or 1/1 around a centre point. Zoomed views are built from
+// decoded tiles kept in a PSRAM cache, so only unseen tiles are decoded.
+// ============================================
+struct ReviewStats {
+  bool active;
+  uint8_t zoom;           // 0 = fit, 1..3 = 1/4, 1/2, 1/1
+  int32_t cx, cy;         // view centre, full-resolution pixels
+  uint16_t imageW, imageH;
+  uint32_t fitUs;         // fitted view: 1/8 decode + resample
+  uint32_t views;         // view changes
+  uint32_t viewUs;        // last view change: decode + compose + push
+  uint32_t decodeUs;      // last view change: tile decode pass (0 = all cached)
+  uint8_t tilesNeeded;    // last view
+  uint8_t tilesHit;
+  uint8_t hitPct;         // tile cache, all views
+  uint8_t cacheTiles;     // tile cache capacity
+  uint32_t evictions;
+};
+
+// Copies the JPEG and shows it fitted. False if it cannot be decoded or
+// PSRAM is short; the screen is untouched then.
+bool displayReviewBegin(const uint8_t *jpg, size_t len);
+bool displayReviewView(uint8_t zoom, int32_t cx, int32_t cy);
+// Leaves the screen as it is; the caller redraws (e.g. displayReady()).
+void displayReviewEnd();
+bool displayReviewActive();
+void displayGetReviewStats(ReviewStats *out);
+
+// ============================================
+// Gallery
+// Queued scans listed newest first with their sidecar thumbnails
+// (storage/thumbnail.h). Opening pages the scan index, which lists them in
+// the order they were queued; scrolling only reads and decodes thumbnails
+// not already in the PSRAM cache.
+// ============================================
+class GalleryStore;
+class ScanIndex;
+
+struct GalleryViewStats {
+  bool active;
+  uint16_t entries;
+  uint16_t withThumb;     // entries that have a sidecar
+  uint16_t dropped;       // queued files beyond GALLERY_MAX_ENTRIES (oldest)
+  uint16_t selected;
+  uint16_t first;         // top row on screen
+  char selectedName[48];
+  uint32_t indexUs;       // scan index pages (and its first build)
+  uint32_t openUs;        // index + first screen
+  uint32_t paints;
+  uint32_t paintUs;       // last screen, incl. thumbnail loads
+  uint8_t thumbsLoaded;   // last screen: sidecars read + decoded (rest cached)
+  uint32_t lookups;       // thumbnail cache, all screens
+  uint32_t loads;
+  uint32_t failures;
+  uint32_t evictions;
+  uint32_t bytesRead;
+  uint8_t hitPct;
+  uint8_t cacheThumbs;    // cache capacity
+};
+
+// Entries from `index`, thumbnails from `store`. False if the queue cannot
+// be read or PSRAM is short; screen untouched then.
+bool displayGalleryOpen(ScanIndex &index, GalleryStore &store);
+bool displayGallerySelect(uint16_t index);
+// Move the selection by `step` entries, wrapping at either end
+void displayGalleryScroll(int step);
+// Leaves the screen as it is; the caller redraws (e.g. displayReady()).
+void displayGalleryEnd();
+bool displayGalleryActive();
+void displayGetGalleryStats(GalleryViewStats *out);
+
 // Flash screen when capturing (visual feedback) - restricted to viewfinder
 void displayCaptureFlash();
 
 // Clear only the viewfinder zone (between top bar and bottom panel)
 void clearViewfinder();
 
+// Burst session progress in the viewfinder zone (pages saved / pending / dropped)
+void displayBurstStatus(uint32_t written, uint32_t pending, uint32_t dropped, int ringPct);
+
 // Restore the screen back to a ready/idle visual state
 void displayReady();
 
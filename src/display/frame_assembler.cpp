@@ -0,0 +1,74 @@
+#include "frame_assembler.h"
+#include <cstring>
+
+void FrameAssembler::attach(StripRing *ring, AssemblerHook waitFree, AssemblerHook committed,
+                            void *arg) {
+  _ring = ring;
+  _waitFree = waitFree;
+  _committed = committed;
+  _arg = arg;
+}
+
+void FrameAssembler::beginFrame(uint32_t seq, uint32_t grabUs, int16_t top, int16_t bottom,
+                                uint16_t decodedW) {
+  _seq = seq;
+  _grabUs = grabUs;
+  _top = top;
+  _bottom = bottom;
+  _decodedW = decodedW;
+  _cur = nullptr;
+  _ended = false;
+}
+
+void FrameAssembler::acquire() {
+  while (!(_cur = _ring->acquire())) {
+    if (_waitFree) _waitFree(_arg);
+  }
+}
+
+void FrameAssembler::commit(uint16_t rows, bool end) {
+  StripInfo info = {0, _curY, _ring->width(), rows, _seq, _grabUs, end};
+  _ring->commit(info);
+  _cur = nullptr;
+  _ended = end;
+  if (_committed) _committed(_arg);
+}
+
+void FrameAssembler::addBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint16_t *px) {
+  if (_ended || y >= _bottom) return;
+
+  // Rows above the window (e.g. the separator line) are dropped
+  int16_t y0 = y < _top ? _top : y;
+  int16_t y1 = y + h < _bottom ? y + h : _bottom;
+  if (y1 > y0) {
+    if (!_cur) {
+      acquire();
+      _curY = y0;
+    }
+    const uint16_t stripW = _ring->width();
+    if (x >= 0 && x < stripW) {
+      uint16_t cols = w < stripW - x ? w : stripW - x;
+      for (int16_t row = y0; row < y1; row++) {
+        memcpy(_cur + (uint32_t)(row - _curY) * stripW + x, px + (uint32_t)(row - y) * w,
+               cols * sizeof(uint16_t));
+      }
+    }
+  }
+
+  // Last block of an MCU row: commit when the next row would not fit
+  if (_cur && x + w >= _decodedW) {
+    int16_t filled = y1 - _curY;
+    bool end = y + h >= _bottom;
+    if (end || filled + h > _ring->rows()) commit(filled, end);
+  }
+}
+
+void FrameAssembler::endFrame() {
+  if (_ended) return;
+  // A partially filled buffer from a truncated decode is dropped
+  if (!_cur) {
+    acquire();
+    _curY = _top;
+  }
+  commit(0, true);
+}
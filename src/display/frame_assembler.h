@@ -0,0 +1,51 @@
+// ============================================
+// Frame Assembler - ResearchMate
+// Collects decoder MCU blocks into StripRing buffers and commits a buffer
+// when it is full or the frame ends. With a buffer as tall as the viewfinder
+// this is a full-frame double buffer (one DMA per frame); with short buffers
+// it degrades to strip streaming.
+// ============================================
+
+#ifndef FRAME_ASSEMBLER_H
+#define FRAME_ASSEMBLER_H
+
+#include "strip_ring.h"
+
+typedef void (*AssemblerHook)(void *arg);
+
+class FrameAssembler {
+public:
+  // waitFree: called while no buffer is free (block briefly, then return).
+  // committed: called after each commit (wake the consumer).
+  void attach(StripRing *ring, AssemblerHook waitFree, AssemblerHook committed, void *arg);
+
+  // Visible window is screen rows [top, bottom) and columns [0, ring width);
+  // decodedW is the full decoded width, used to spot the end of an MCU row.
+  void beginFrame(uint32_t seq, uint32_t grabUs, int16_t top, int16_t bottom, uint16_t decodedW);
+  void addBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint16_t *px);
+  // Close the frame even if the decode stopped early (commits an empty end
+  // marker when nothing is pending) so the consumer always sees endOfFrame.
+  void endFrame();
+
+  bool ended() const { return _ended; }
+
+private:
+  void acquire();
+  void commit(uint16_t rows, bool end);
+
+  StripRing *_ring = nullptr;
+  AssemblerHook _waitFree = nullptr;
+  AssemblerHook _committed = nullptr;
+  void *_arg = nullptr;
+
+  uint16_t *_cur = nullptr;
+  int16_t _curY = 0;
+  int16_t _top = 0;
+  int16_t _bottom = 0;
+  uint16_t _decodedW = 0;
+  uint32_t _seq = 0;
+  uint32_t _grabUs = 0;
+  bool _ended = true;
+};
+
+#endif // FRAME_ASSEMBLER_H
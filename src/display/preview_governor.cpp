@@ -0,0 +1,118 @@
+#include "preview_governor.h"
+#include <cstring>
+
+#define GOVERNOR_WINDOW_US 1000000u
+
+static uint32_t periodUs(const PreviewGovernor *g) { return 1000000u / g->capFps; }
+
+void governorInit(PreviewGovernor *g, const GovernorConfig &cfg) {
+  memset(g, 0, sizeof(*g));
+  g->cfg = cfg;
+  if (!g->cfg.targetFps) g->cfg.targetFps = 1;
+  if (!g->cfg.minFps || g->cfg.minFps > g->cfg.targetFps) g->cfg.minFps = g->cfg.targetFps;
+  g->capFps = g->cfg.targetFps;
+}
+
+void governorSetTarget(PreviewGovernor *g, uint8_t fps) {
+  if (!fps) fps = 1;
+  g->cfg.targetFps = fps;
+  if (g->cfg.minFps > fps) g->cfg.minFps = fps;
+  if (g->capFps > fps) g->capFps = fps;
+}
+
+void governorRestart(PreviewGovernor *g, uint32_t nowUs) {
+  g->paced = false;
+  g->waiting = false;
+  g->winStartUs = nowUs;
+  g->winFrames = 0;
+  g->winYieldUs = 0;
+}
+
+// Cut by a quarter (at least 1 fps). While below target, cuts are spaced
+// by the hold time so one burst of load does not slam the rate to the floor.
+static void cut(PreviewGovernor *g, uint32_t nowUs) {
+  const uint32_t holdUs = (uint32_t)g->cfg.busyHoldMs * 1000;
+  if (g->capFps < g->cfg.targetFps && nowUs - g->lastCutUs < holdUs) return;
+  if (g->capFps <= g->cfg.minFps) return;
+  uint8_t drop = g->capFps / 4 ? g->capFps / 4 : 1;
+  g->capFps = g->capFps - drop > g->cfg.minFps ? g->capFps - drop : g->cfg.minFps;
+  g->lastCutUs = g->lastStepUs = nowUs;
+  g->cuts++;
+}
+
+void governorBusy(PreviewGovernor *g, uint32_t nowUs) {
+  g->lastBusyUs = nowUs;
+  g->busyEvents++;
+  cut(g, nowUs);
+}
+
+void governorHold(PreviewGovernor *g, bool held, uint32_t nowUs) {
+  if (held == g->held) return;
+  g->held = held;
+  if (held) governorBusy(g, nowUs);
+  else g->lastBusyUs = nowUs; // quiet time counts from the release
+}
+
+static void adjust(PreviewGovernor *g, uint32_t nowUs) {
+  if (g->held) {
+    g->lastBusyUs = nowUs;
+    cut(g, nowUs);
+    return;
+  }
+  if (g->capFps >= g->cfg.targetFps) return;
+  const uint32_t holdUs = (uint32_t)g->cfg.busyHoldMs * 1000;
+  const uint32_t stepUs = (uint32_t)g->cfg.recoverMs * 1000;
+  if (nowUs - g->lastBusyUs >= holdUs && nowUs - g->lastStepUs >= stepUs) {
+    g->capFps++;
+    g->lastStepUs = nowUs;
+  }
+}
+
+uint32_t governorWaitUs(PreviewGovernor *g, uint32_t nowUs) {
+  adjust(g, nowUs);
+  if (!g->paced) return 0;
+  int32_t wait = (int32_t)(g->nextUs - nowUs);
+  if (wait <= 0) return 0;
+  // A cut can leave nextUs closer than one (new) period; a raise further
+  // than one. Never wait longer than the current period.
+  if ((uint32_t)wait > periodUs(g)) {
+    g->nextUs = nowUs + periodUs(g);
+    wait = (int32_t)periodUs(g);
+  }
+  if (!g->waiting) {
+    g->waiting = true;
+    g->waitFromUs = nowUs;
+  }
+  return (uint32_t)wait;
+}
+
+void governorFrameStarted(PreviewGovernor *g, uint32_t nowUs) {
+  adjust(g, nowUs);
+  const uint32_t period = periodUs(g);
+
+  // Keep the cadence across scheduler jitter; a frame more than a period
+  // late restarts it rather than bursting to catch up.
+  if (g->paced && nowUs - g->nextUs < period) g->nextUs += period;
+  else g->nextUs = nowUs + period;
+  g->paced = true;
+
+  if (g->waiting) {
+    g->winYieldUs += nowUs - g->waitFromUs;
+    g->waiting = false;
+  }
+  g->frames++;
+  g->winFrames++;
+
+  uint32_t winUs = nowUs - g->winStartUs;
+  if (winUs >= GOVERNOR_WINDOW_US) {
+    // A window spanning a long pause says nothing about the current rate
+    if (winUs < 2 * GOVERNOR_WINDOW_US) {
+      g->fpsX10 = (uint16_t)((uint64_t)g->winFrames * 10000000u / winUs);
+      uint32_t y = (uint32_t)((uint64_t)g->winYieldUs * 100 / winUs);
+      g->yieldPct = (uint8_t)(y > 100 ? 100 : y);
+    }
+    g->winStartUs = nowUs;
+    g->winFrames = 0;
+    g->winYieldUs = 0;
+  }
+}
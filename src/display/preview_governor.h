@@ -0,0 +1,66 @@
+// ============================================
+// Preview Frame-Rate Governor - ResearchMate
+// Paces the live preview at a target rate and hands the rest of each frame
+// period back to the scheduler. While the web server or cloud task reports
+// load, the rate is cut (at most once per hold period, down to a floor) and
+// then climbs back one fps at a time once things are quiet. All times are
+// passed in by the caller, so a simulated clock drives it on a host.
+// ============================================
+
+#ifndef PREVIEW_GOVERNOR_H
+#define PREVIEW_GOVERNOR_H
+
+#include <cstdint>
+
+struct GovernorConfig {
+  uint8_t targetFps;    // rate while nothing else is busy
+  uint8_t minFps;       // floor under load
+  uint16_t busyHoldMs;  // min gap between cuts; quiet time before recovering
+  uint16_t recoverMs;   // +1 fps per this long once quiet
+};
+
+struct PreviewGovernor {
+  GovernorConfig cfg;
+  uint8_t capFps;       // current governed rate
+  bool held;            // a long job (upload) is running: busy until released
+  bool paced;           // nextUs is valid
+  uint32_t nextUs;      // earliest start of the next frame
+  uint32_t lastBusyUs;
+  uint32_t lastCutUs;
+  uint32_t lastStepUs;  // last cut or recovery step
+  bool waiting;         // caller asked and was told to wait
+  uint32_t waitFromUs;
+
+  // Achieved rate, last window
+  uint32_t winStartUs;
+  uint16_t winFrames;
+  uint32_t winYieldUs;
+  uint16_t fpsX10;
+  uint8_t yieldPct;     // share of the window handed back while paced
+
+  // Counters
+  uint32_t frames;
+  uint32_t busyEvents;
+  uint32_t cuts;
+};
+
+void governorInit(PreviewGovernor *g, const GovernorConfig &cfg);
+
+// Change the target; the current rate is clamped to it.
+void governorSetTarget(PreviewGovernor *g, uint8_t fps);
+
+// Forget pacing and the rate window (preview restarted). The rate is kept.
+void governorRestart(PreviewGovernor *g, uint32_t nowUs);
+
+// Other work just took a noticeable slice of time.
+void governorBusy(PreviewGovernor *g, uint32_t nowUs);
+// Busy for as long as `held` stays set.
+void governorHold(PreviewGovernor *g, bool held, uint32_t nowUs);
+
+// Microseconds until the next frame may start; 0 = start now.
+uint32_t governorWaitUs(PreviewGovernor *g, uint32_t nowUs);
+
+// A frame was started (grabbed) at nowUs.
+void governorFrameStarted(PreviewGovernor *g, uint32_t nowUs);
+
+#endif // PREVIEW_GOVERNOR_H
@@ -0,0 +1,47 @@
+#include "strip_ring.h"
+
+bool StripRing::attach(uint16_t *const *buffers, uint8_t count, uint16_t width, uint16_t rows) {
+  if (!buffers || count == 0 || count > STRIP_RING_MAX) return false;
+  for (uint8_t i = 0; i < count; i++) {
+    if (!buffers[i]) return false;
+    _bufs[i] = buffers[i];
+  }
+  _count = count;
+  _width = width;
+  _rows = rows;
+  reset();
+  return true;
+}
+
+void StripRing::reset() {
+  _written.store(0);
+  _read.store(0);
+  _released.store(0);
+}
+
+uint16_t *StripRing::acquire() {
+  uint32_t w = _written.load(std::memory_order_relaxed);
+  if (w - _released.load(std::memory_order_acquire) >= _count) return nullptr;
+  return _bufs[w % _count];
+}
+
+void StripRing::commit(const StripInfo &info) {
+  uint32_t w = _written.load(std::memory_order_relaxed);
+  _info[w % _count] = info;
+  _written.store(w + 1, std::memory_order_release);
+}
+
+bool StripRing::take(StripInfo *info, uint16_t **pixels) {
+  uint32_t r = _read.load(std::memory_order_relaxed);
+  if (r == _written.load(std::memory_order_acquire)) return false;
+  *info = _info[r % _count];
+  *pixels = _bufs[r % _count];
+  _read.store(r + 1, std::memory_order_relaxed);
+  return true;
+}
+
+void StripRing::release() {
+  uint32_t f = _released.load(std::memory_order_relaxed);
+  if (f == _read.load(std::memory_order_relaxed)) return;
+  _released.store(f + 1, std::memory_order_release);
+}
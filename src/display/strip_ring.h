@@ -0,0 +1,58 @@
+// ============================================
+// Strip Ring - ResearchMate
+// Hand-off of decoded RGB565 strips from the preview decoder to the DMA
+// push. Single producer / single consumer, safe across cores. A strip is
+// "taken" when its DMA is queued and only "released" once the transfer is
+// known to be finished, so the decoder never overwrites pixels on the wire.
+// ============================================
+
+#ifndef STRIP_RING_H
+#define STRIP_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define STRIP_RING_MAX 4
+
+struct StripInfo {
+  int16_t x, y;       // screen position
+  uint16_t w, h;      // h == 0: empty end marker (decode aborted)
+  uint32_t frame;     // frame sequence number
+  uint32_t grabUs;    // micros() when the source frame was grabbed
+  bool endOfFrame;
+};
+
+class StripRing {
+public:
+  // `buffers` are `count` strips of width*rows pixels each.
+  bool attach(uint16_t *const *buffers, uint8_t count, uint16_t width, uint16_t rows);
+  void reset();
+
+  // Producer: next free strip buffer, or nullptr while all are in use.
+  uint16_t *acquire();
+  void commit(const StripInfo &info);
+
+  // Consumer: oldest committed strip not yet taken.
+  bool take(StripInfo *info, uint16_t **pixels);
+  // Consumer: free the oldest taken strip.
+  void release();
+
+  uint8_t inFlight() const { return (uint8_t)(_written.load() - _released.load()); }
+  uint8_t taken() const { return (uint8_t)(_read.load() - _released.load()); }
+  uint16_t width() const { return _width; }
+  uint16_t rows() const { return _rows; }
+
+private:
+  uint16_t *_bufs[STRIP_RING_MAX] = {};
+  StripInfo _info[STRIP_RING_MAX] = {};
+  uint8_t _count = 0;
+  uint16_t _width = 0;
+  uint16_t _rows = 0;
+  // Monotonic counters; slot = counter % count
+  std::atomic<uint32_t> _written{0};
+  std::atomic<uint32_t> _read{0};
+  std::atomic<uint32_t> _released{0};
+};
+
+#endif // STRIP_RING_H
@@ -0,0 +1,178 @@
+#include "tile_view.h"
+#include <cstring>
+
+static inline int32_t minI(int32_t a, int32_t b) { return a < b ? a : b; }
+static inline int32_t maxI(int32_t a, int32_t b) { return a > b ? a : b; }
+
+bool tileViewInit(TileView *v, uint16_t viewW, uint16_t viewH, uint16_t *pool, uint8_t tiles,
+                  TileDecodeFn decode, void *ctx) {
+  if (!pool || !decode || tiles < TILE_VIEW_MAX || !viewW || !viewH ||
+      viewW > 2 * TILE_SIZE || viewH > 2 * TILE_SIZE)
+    return false;
+  memset(v, 0, sizeof(*v));
+  v->viewW = viewW;
+  v->viewH = viewH;
+  v->slotCount = tiles < TILE_CACHE_MAX ? tiles : TILE_CACHE_MAX;
+  for (uint8_t i = 0; i < v->slotCount; i++) {
+    v->slots[i].px = pool + (size_t)i * TILE_SIZE * TILE_SIZE;
+  }
+  v->decode = decode;
+  v->decodeCtx = ctx;
+  return true;
+}
+
+void tileViewSetImage(TileView *v, uint16_t imgW, uint16_t imgH) {
+  v->imgW = imgW;
+  v->imgH = imgH;
+  for (uint8_t i = 0; i < v->slotCount; i++) v->slots[i].lastUse = 0;
+}
+
+uint16_t tileScaled(uint16_t full, uint8_t scale) {
+  return (uint16_t)((full + (1u << scale) - 1) >> scale);
+}
+
+static int32_t originAxis(int32_t c, uint8_t scale, uint16_t full, uint16_t view) {
+  int32_t size = tileScaled(full, scale);
+  if (size <= view) return -(int32_t)(view - size) / 2;
+  int32_t o = (c >> scale) - view / 2;
+  return maxI(0, minI(o, size - view));
+}
+
+void tileViewOrigin(const TileView *v, uint8_t scale, int32_t cx, int32_t cy, int32_t *ox,
+                    int32_t *oy) {
+  *ox = originAxis(cx, scale, v->imgW, v->viewW);
+  *oy = originAxis(cy, scale, v->imgH, v->viewH);
+}
+
+// ============================================
+// Cache
+// ============================================
+static TileSlot *lookup(TileView *v, uint8_t scale, uint16_t tx, uint16_t ty) {
+  for (uint8_t i = 0; i < v->slotCount; i++) {
+    TileSlot *s = &v->slots[i];
+    if (s->lastUse && s->scale == scale && s->tx == tx && s->ty == ty) return s;
+  }
+  return nullptr;
+}
+
+// Empty slot, else the least recently used one not needed by this view
+static TileSlot *claim(TileView *v) {
+  TileSlot *best = nullptr;
+  for (uint8_t i = 0; i < v->slotCount; i++) {
+    TileSlot *s = &v->slots[i];
+    if (!s->lastUse) return s;
+    if (s->lastUse != v->stamp && (!best || s->lastUse < best->lastUse)) best = s;
+  }
+  if (best) v->stats.evictions++;
+  return best;
+}
+
+// Decoder output: copy each block into the pending tiles it overlaps
+static bool scatter(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *px) {
+  TileView *v = (TileView *)ctx;
+  for (uint8_t i = 0; i < v->pendingCount; i++) {
+    TileSlot *s = v->pending[i];
+    int32_t tx0 = (int32_t)s->tx * TILE_SIZE, ty0 = (int32_t)s->ty * TILE_SIZE;
+    int32_t x0 = maxI(x, tx0), x1 = minI(x + w, tx0 + TILE_SIZE);
+    int32_t y0 = maxI(y, ty0), y1 = minI(y + h, ty0 + TILE_SIZE);
+    if (x1 <= x0 || y1 <= y0) continue;
+    for (int32_t r = y0; r < y1; r++) {
+      memcpy(s->px + (r - ty0) * TILE_SIZE + (x0 - tx0), px + (r - y) * w + (x0 - x),
+             sizeof(uint16_t) * (x1 - x0));
+    }
+  }
+  return true;
+}
+
+// ============================================
+// Render
+// ============================================
+bool tileViewRender(TileView *v, uint8_t scale, int32_t ox, int32_t oy, uint16_t *buf,
+                    uint8_t rows, TileBlockFn emit, void *ctx) {
+  const int32_t sw = tileScaled(v->imgW, scale), sh = tileScaled(v->imgH, scale);
+  TileViewStats &st = v->stats;
+  v->stamp++;
+  st.views++;
+  st.lastNeeded = st.lastHits = 0;
+
+  // Tiles under the view
+  TileSlot *grid[3][3] = {};
+  int32_t tx0 = maxI(0, ox) / TILE_SIZE, ty0 = maxI(0, oy) / TILE_SIZE;
+  int32_t tx1 = (minI(sw, ox + v->viewW) - 1) / TILE_SIZE;
+  int32_t ty1 = (minI(sh, oy + v->viewH) - 1) / TILE_SIZE;
+  int32_t cx0 = 0, cy0 = 0, cx1 = 0, cy1 = 0; // union of missing tiles, pixels
+  v->pendingCount = 0;
+
+  for (int32_t ty = ty0; ty <= ty1 && ty - ty0 < 3; ty++) {
+    for (int32_t tx = tx0; tx <= tx1 && tx - tx0 < 3; tx++) {
+      TileSlot *s = lookup(v, scale, (uint16_t)tx, (uint16_t)ty);
+      st.lookups++;
+      st.lastNeeded++;
+      if (s) {
+        st.hits++;
+        st.lastHits++;
+      } else {
+        s = claim(v);
+        s->scale = scale;
+        s->tx = (uint16_t)tx;
+        s->ty = (uint16_t)ty;
+        memset(s->px, 0, sizeof(uint16_t) * TILE_SIZE * TILE_SIZE);
+        int32_t x0 = tx * TILE_SIZE, y0 = ty * TILE_SIZE;
+        int32_t x1 = minI(x0 + TILE_SIZE, sw), y1 = minI(y0 + TILE_SIZE, sh);
+        if (!v->pendingCount) {
+          cx0 = x0, cy0 = y0, cx1 = x1, cy1 = y1;
+        } else {
+          cx0 = minI(cx0, x0), cy0 = minI(cy0, y0);
+          cx1 = maxI(cx1, x1), cy1 = maxI(cy1, y1);
+        }
+        v->pending[v->pendingCount++] = s;
+      }
+      s->lastUse = v->stamp;
+      grid[ty - ty0][tx - tx0] = s;
+    }
+  }
+
+  bool ok = true;
+  if (v->pendingCount) {
+    st.decodes++;
+    ok = v->decode(v->decodeCtx, scale, (int16_t)cx0, (int16_t)cy0, (uint16_t)(cx1 - cx0),
+                   (uint16_t)(cy1 - cy0), scatter, v);
+  }
+
+  // Compose rows from the tiles
+  bool emitted = true;
+  for (int32_t r0 = 0; r0 < v->viewH && emitted; r0 += rows) {
+    int32_t h = minI(rows, v->viewH - r0);
+    for (int32_t i = 0; i < h; i++) {
+      uint16_t *dst = buf + i * v->viewW;
+      int32_t sy = oy + r0 + i;
+      int32_t dx = 0;
+      while (dx < v->viewW) {
+        int32_t sx = ox + dx;
+        int32_t run;
+        if (sy < 0 || sy >= sh || sx >= sw) {
+          run = v->viewW - dx;
+          memset(dst + dx, 0, sizeof(uint16_t) * run);
+        } else if (sx < 0) {
+          run = minI(-sx, v->viewW - dx);
+          memset(dst + dx, 0, sizeof(uint16_t) * run);
+        } else {
+          TileSlot *s = grid[sy / TILE_SIZE - ty0][sx / TILE_SIZE - tx0];
+          int32_t tx = sx % TILE_SIZE, ty = sy % TILE_SIZE;
+          run = minI(minI(TILE_SIZE - tx, sw - sx), v->viewW - dx);
+          memcpy(dst + dx, s->px + ty * TILE_SIZE + tx, sizeof(uint16_t) * run);
+        }
+        dx += run;
+      }
+    }
+    emitted = emit(ctx, 0, (int16_t)r0, v->viewW, (uint16_t)h, buf);
+  }
+
+  // A failed pass leaves the tiles partial: show them, never reuse them
+  if (!ok) {
+    for (uint8_t i = 0; i < v->pendingCount; i++) v->pending[i]->lastUse = 0;
+  }
+  v->pendingCount = 0;
+  st.lastOk = ok;
+  return ok && emitted;
+}
@@ -0,0 +1,86 @@
+// ============================================
+// Tiled Image View - ResearchMate
+// Shows a window of a large JPEG at 1/4, 1/2 or 1/1 scale without ever
+// decoding the whole image at that scale. The decoded image is cut into
+// TILE_SIZE squares; a view needs at most 3x3 of them. Missing tiles are
+// filled by one clipped decode pass (the entropy stream is read once, only
+// their MCUs are reconstructed), and tiles stay in an LRU cache so panning
+// back costs only the copy. Decoding goes through a callback, so the
+// engine runs on a host against synthetic images.
+// ============================================
+
+#ifndef TILE_VIEW_H
+#define TILE_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define TILE_SIZE       64
+#define TILE_VIEW_MAX   9   // tiles one view can touch (view <= 2 tiles per axis)
+#define TILE_CACHE_MAX  64
+
+// Same shape as the JPEG decoder's block callback.
+typedef bool (*TileBlockFn)(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                            uint16_t *pixels);
+// Decode the image at 1/(1 << scale), output clipped to the rectangle
+// (scaled-image coordinates), blocks to `out` in scaled-image coordinates.
+typedef bool (*TileDecodeFn)(void *ctx, uint8_t scale, int16_t clipX, int16_t clipY,
+                             uint16_t clipW, uint16_t clipH, TileBlockFn out, void *outCtx);
+
+struct TileSlot {
+  uint16_t *px;        // TILE_SIZE x TILE_SIZE, row stride TILE_SIZE
+  uint32_t lastUse;    // view stamp, 0 = empty
+  uint8_t scale;
+  uint16_t tx, ty;
+};
+
+struct TileViewStats {
+  uint32_t views;
+  uint32_t lookups;    // tiles needed, all views
+  uint32_t hits;
+  uint32_t decodes;    // decode passes
+  uint32_t evictions;
+  uint8_t lastNeeded;  // last view
+  uint8_t lastHits;
+  bool lastOk;
+};
+
+struct TileView {
+  uint16_t imgW, imgH; // full resolution
+  uint16_t viewW, viewH;
+  TileSlot slots[TILE_CACHE_MAX];
+  uint8_t slotCount;
+  uint32_t stamp;
+
+  TileDecodeFn decode;
+  void *decodeCtx;
+  TileSlot *pending[TILE_VIEW_MAX]; // being filled by the current decode pass
+  uint8_t pendingCount;
+
+  TileViewStats stats;
+};
+
+// `pool` holds `tiles` x TILE_SIZE x TILE_SIZE pixels; tiles >= TILE_VIEW_MAX.
+bool tileViewInit(TileView *v, uint16_t viewW, uint16_t viewH, uint16_t *pool, uint8_t tiles,
+                  TileDecodeFn decode, void *ctx);
+
+// New image: every cached tile is dropped. Stats are kept.
+void tileViewSetImage(TileView *v, uint16_t imgW, uint16_t imgH);
+
+// Image size at 1/(1 << scale), as the decoder produces it.
+uint16_t tileScaled(uint16_t full, uint8_t scale);
+
+// Top-left of a view centred on (cx, cy) (full-resolution pixels), in
+// scaled coordinates. Clamped to the image; centred when the image is
+// smaller than the view.
+void tileViewOrigin(const TileView *v, uint8_t scale, int32_t cx, int32_t cy, int32_t *ox,
+                    int32_t *oy);
+
+// Render the view at (ox, oy) as viewW x `rows` blocks (the last may be
+// shorter) into `buf`, handed to `emit` with view-relative coordinates.
+// Area outside the image is black. False if the decode failed (what could
+// be decoded is still shown, but not cached) or `emit` aborted.
+bool tileViewRender(TileView *v, uint8_t scale, int32_t ox, int32_t oy, uint16_t *buf,
+                    uint8_t rows, TileBlockFn emit, void *ctx);
+
+#endif // TILE_VIEW_H
@@ -0,0 +1,202 @@
+#include "ccitt_g4.h"
+#include <cstring>
+
+struct G4Code {
+  uint16_t code;
+  uint8_t len;
+};
+
+// ============================================
+// Code tables (T.4 section 4.1, shared by T.6)
+// ============================================
+// Terminating codes, run lengths 0-63
+static const G4Code WHITE_TERM[64] = {
+    {0x035, 8}, {0x007, 6}, {0x007, 4}, {0x008, 4}, {0x00B, 4}, {0x00C, 4},
+    {0x00E, 4}, {0x00F, 4}, {0x013, 5}, {0x014, 5}, {0x007, 5}, {0x008, 5},
+    {0x008, 6}, {0x003, 6}, {0x034, 6}, {0x035, 6}, {0x02A, 6}, {0x02B, 6},
+    {0x027, 7}, {0x00C, 7}, {0x008, 7}, {0x017, 7}, {0x003, 7}, {0x004, 7},
+    {0x028, 7}, {0x02B, 7}, {0x013, 7}, {0x024, 7}, {0x018, 7}, {0x002, 8},
+    {0x003, 8}, {0x01A, 8}, {0x01B, 8}, {0x012, 8}, {0x013, 8}, {0x014, 8},
+    {0x015, 8}, {0x016, 8}, {0x017, 8}, {0x028, 8}, {0x029, 8}, {0x02A, 8},
+    {0x02B, 8}, {0x02C, 8}, {0x02D, 8}, {0x004, 8}, {0x005, 8}, {0x00A, 8},
+    {0x00B, 8}, {0x052, 8}, {0x053, 8}, {0x054, 8}, {0x055, 8}, {0x024, 8},
+    {0x025, 8}, {0x058, 8}, {0x059, 8}, {0x05A, 8}, {0x05B, 8}, {0x04A, 8},
+    {0x04B, 8}, {0x032, 8}, {0x033, 8}, {0x034, 8},
+};
+// Make-up codes, run lengths 64-1728 in steps of 64
+static const G4Code WHITE_MAKEUP[27] = {
+    {0x01B, 5}, {0x012, 5}, {0x017, 6}, {0x037, 7}, {0x036, 8}, {0x037, 8},
+    {0x064, 8}, {0x065, 8}, {0x068, 8}, {0x067, 8}, {0x0CC, 9}, {0x0CD, 9},
+    {0x0D2, 9}, {0x0D3, 9}, {0x0D4, 9}, {0x0D5, 9}, {0x0D6, 9}, {0x0D7, 9},
+    {0x0D8, 9}, {0x0D9, 9}, {0x0DA, 9}, {0x0DB, 9}, {0x098, 9}, {0x099, 9},
+    {0x09A, 9}, {0x018, 6}, {0x09B, 9},
+};
+// Terminating codes, run lengths 0-63
+static const G4Code BLACK_TERM[64] = {
+    {0x037, 10}, {0x002, 3}, {0x003, 2}, {0x002, 2}, {0x003, 3}, {0x003, 4},
+    {0x002, 4}, {0x003, 5}, {0x005, 6}, {0x004, 6}, {0x004, 7}, {0x005, 7},
+    {0x007, 7}, {0x004, 8}, {0x007, 8}, {0x018, 9}, {0x017, 10}, {0x018, 10},
+    {0x008, 10}, {0x067, 11}, {0x068, 11}, {0x06C, 11}, {0x037, 11}, {0x028, 11},
+    {0x017, 11}, {0x018, 11}, {0x0CA, 12}, {0x0CB, 12}, {0x0CC, 12}, {0x0CD, 12},
+    {0x068, 12}, {0x069, 12}, {0x06A, 12}, {0x06B, 12}, {0x0D2, 12}, {0x0D3, 12},
+    {0x0D4, 12}, {0x0D5, 12}, {0x0D6, 12}, {0x0D7, 12}, {0x06C, 12}, {0x06D, 12},
+    {0x0DA, 12}, {0x0DB, 12}, {0x054, 12}, {0x055, 12}, {0x056, 12}, {0x057, 12},
+    {0x064, 12}, {0x065, 12}, {0x052, 12}, {0x053, 12}, {0x024, 12}, {0x037, 12},
+    {0x038, 12}, {0x027, 12}, {0x028, 12}, {0x058, 12}, {0x059, 12}, {0x02B, 12},
+    {0x02C, 12}, {0x05A, 12}, {0x066, 12}, {0x067, 12},
+};
+// Make-up codes, run lengths 64-1728 in steps of 64
+static const G4Code BLACK_MAKEUP[27] = {
+    {0x00F, 10}, {0x0C8, 12}, {0x0C9, 12}, {0x05B, 12}, {0x033, 12}, {0x034, 12},
+    {0x035, 12}, {0x06C, 13}, {0x06D, 13}, {0x04A, 13}, {0x04B, 13}, {0x04C, 13},
+    {0x04D, 13}, {0x072, 13}, {0x073, 13}, {0x074, 13}, {0x075, 13}, {0x076, 13},
+    {0x077, 13}, {0x052, 13}, {0x053, 13}, {0x054, 13}, {0x055, 13}, {0x05A, 13},
+    {0x05B, 13}, {0x064, 13}, {0x065, 13},
+};
+// Shared extended make-up codes, run lengths 1792-2560
+static const G4Code EXT_MAKEUP[13] = {
+    {0x008, 11}, {0x00C, 11}, {0x00D, 11}, {0x012, 12}, {0x013, 12}, {0x014, 12},
+    {0x015, 12}, {0x016, 12}, {0x017, 12}, {0x01C, 12}, {0x01D, 12}, {0x01E, 12},
+    {0x01F, 12},
+};
+
+// Two-dimensional mode codes
+static const G4Code PASS_CODE = {0x1, 4};  // 0001
+static const G4Code HORIZ_CODE = {0x1, 3}; // 001
+// Vertical modes indexed by (a1 - b1) + 3: VL3 .. V0 .. VR3
+static const G4Code VERT_CODES[7] = {
+    {0x02, 7}, {0x02, 6}, {0x2, 3}, {0x1, 1}, {0x3, 3}, {0x03, 6}, {0x03, 7},
+};
+
+// ============================================
+// Bit output
+// ============================================
+static void flushOut(G4Encoder *e) {
+  if (e->outLen == 0 || e->failed) return;
+  if (!e->write || e->write(e->ctx, e->out, e->outLen) != e->outLen) e->failed = true;
+  e->bytesOut += e->outLen;
+  e->outLen = 0;
+}
+
+static inline void putBits(G4Encoder *e, uint32_t code, uint8_t len) {
+  e->bitBuf = (e->bitBuf << len) | code;
+  e->bitCount += len;
+  while (e->bitCount >= 8) {
+    e->bitCount -= 8;
+    e->out[e->outLen++] = (uint8_t)(e->bitBuf >> e->bitCount);
+    if (e->outLen == G4_OUT_BLOCK) flushOut(e);
+  }
+}
+
+static inline void putCode(G4Encoder *e, const G4Code &c) { putBits(e, c.code, c.len); }
+
+static void putRun(G4Encoder *e, uint32_t run, bool black) {
+  const G4Code *term = black ? BLACK_TERM : WHITE_TERM;
+  const G4Code *makeup = black ? BLACK_MAKEUP : WHITE_MAKEUP;
+  while (run >= 2624) { // 2560 + 64: keep the remainder codable
+    putCode(e, EXT_MAKEUP[12]);
+    run -= 2560;
+  }
+  if (run >= 64) {
+    uint32_t m = run >> 6; // multiples of 64, 1..40
+    putCode(e, m <= 27 ? makeup[m - 1] : EXT_MAKEUP[m - 28]);
+    run &= 63;
+  }
+  putCode(e, term[run]);
+}
+
+// ============================================
+// Row coding
+// ============================================
+size_t g4WorkBytes(uint16_t width) { return 2 * sizeof(uint16_t) * ((size_t)width + 4); }
+
+// Packed row -> changing elements (positions where the colour flips,
+// starting from white), terminated by width sentinels.
+static void findChanges(const uint8_t *bits, uint16_t width, uint16_t *out) {
+  size_t n = 0;
+  bool black = false;
+  const size_t bytes = (width + 7) / 8;
+  for (size_t i = 0; i < bytes; i++) {
+    uint8_t b = bits[i];
+    // Whole bytes matching the current colour carry no changes
+    if (b == (black ? 0xFF : 0x00)) continue;
+    for (int bit = 0; bit < 8; bit++) {
+      uint32_t x = i * 8 + bit;
+      if (x >= width) break;
+      bool px = (b & (0x80 >> bit)) != 0;
+      if (px != black) {
+        out[n++] = (uint16_t)x;
+        black = px;
+      }
+    }
+  }
+  out[n] = out[n + 1] = out[n + 2] = width;
+}
+
+bool g4Init(G4Encoder *e, uint16_t width, void *work, G4WriteFn write, void *ctx) {
+  if (!work || width == 0) return false;
+  memset(e, 0, sizeof(*e));
+  e->width = width;
+  e->ref = (uint16_t *)work;
+  e->cur = e->ref + width + 4;
+  e->write = write;
+  e->ctx = ctx;
+  // Imaginary all-white row above the page
+  e->ref[0] = e->ref[1] = e->ref[2] = width;
+  return true;
+}
+
+bool g4EncodeRow(void *encoder, const uint8_t *bits) {
+  G4Encoder *e = (G4Encoder *)encoder;
+  if (e->failed) return false;
+  const int w = e->width;
+  findChanges(bits, e->width, e->cur);
+  const uint16_t *cur = e->cur;
+  const uint16_t *ref = e->ref;
+
+  int a0 = -1;      // imaginary white element before the row
+  int colour = 0;   // colour of the run starting at a0 (0 = white)
+  size_t i = 0, j = 0;
+  while (a0 < w) {
+    // a1: next change on the coding line; b1: next change on the reference
+    // line to the opposite colour of a0 (even indices flip to black).
+    while ((int)cur[i] <= a0) i++;
+    while ((int)ref[j] <= a0) j++;
+    size_t jb = j;
+    if ((int)(jb & 1) != colour) jb++;
+    const int a1 = cur[i];
+    const int b1 = ref[jb];
+    const int b2 = ref[jb + 1];
+
+    if (b2 < a1) {
+      putCode(e, PASS_CODE);
+      a0 = b2;
+    } else if (a1 - b1 >= -3 && a1 - b1 <= 3) {
+      putCode(e, VERT_CODES[a1 - b1 + 3]);
+      a0 = a1;
+      colour ^= 1;
+    } else {
+      const int a2 = cur[i + 1];
+      putCode(e, HORIZ_CODE);
+      putRun(e, a1 - (a0 < 0 ? 0 : a0), colour != 0);
+      putRun(e, a2 - a1, colour == 0);
+      a0 = a2;
+    }
+  }
+
+  // Coding line becomes the next reference line
+  uint16_t *t = e->ref;
+  e->ref = e->cur;
+  e->cur = t;
+  e->rows++;
+  return !e->failed;
+}
+
+bool g4Finish(G4Encoder *e) {
+  // EOFB: two EOL codes (000000000001 x2)
+  putBits(e, 0x001, 12);
+  putBits(e, 0x001, 12);
+  if (e->bitCount) putBits(e, 0, 8 - e->bitCount);
+  flushOut(e);
+  return !e->failed;
+}
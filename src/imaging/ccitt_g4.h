@@ -0,0 +1,47 @@
+// ============================================
+// CCITT Group 4 Encoder - ResearchMate
+// ITU-T T.6 (MMR) coder for bilevel rows. Each row is coded against the
+// previous one, so the encoder only ever holds two rows of changing
+// elements; output bytes go straight to a sink in small blocks.
+// ============================================
+
+#ifndef CCITT_G4_H
+#define CCITT_G4_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Sink: consume `len` bytes, return the number accepted.
+typedef size_t (*G4WriteFn)(void *ctx, const uint8_t *data, size_t len);
+
+#define G4_OUT_BLOCK 256
+
+struct G4Encoder {
+  uint16_t width;
+  uint16_t *ref;        // changing elements of the reference (previous) row
+  uint16_t *cur;        // changing elements of the row being coded
+  uint32_t bitBuf;
+  uint8_t bitCount;
+  uint8_t out[G4_OUT_BLOCK];
+  size_t outLen;
+  uint32_t bytesOut;
+  uint32_t rows;
+  G4WriteFn write;
+  void *ctx;
+  bool failed;          // sticky: the sink refused bytes
+};
+
+// Work buffer size for a given row width.
+size_t g4WorkBytes(uint16_t width);
+
+// `work` must hold g4WorkBytes() bytes and be 2-byte aligned.
+bool g4Init(G4Encoder *e, uint16_t width, void *work, G4WriteFn write, void *ctx);
+
+// Code one row: packed MSB first, 1 = black, (width+7)/8 bytes. Signature
+// matches BilevelRowFn so the thresholder can feed the encoder directly.
+bool g4EncodeRow(void *encoder, const uint8_t *bits);
+
+// Write the end-of-facsimile-block marker and flush to a byte boundary.
+bool g4Finish(G4Encoder *e);
+
+#endif // CCITT_G4_H
@@ -0,0 +1,80 @@
+#include "change_detector.h"
+#include <cstring>
+
+void changeInit(ChangeDetector *d, const ChangeConfig &cfg) {
+  memset(d, 0, sizeof(*d));
+  d->cfg = cfg;
+}
+
+static uint16_t countChanged(const ChangeDetector *d, const uint8_t *dc, uint16_t blocks) {
+  if (blocks != d->shownBlocks) return blocks;
+  uint16_t n = 0;
+  for (uint16_t i = 0; i < blocks; i++) {
+    int v = (int)dc[i] - (int)d->shown[i];
+    if ((v < 0 ? -v : v) > d->cfg.blockDelta) n++;
+  }
+  return n;
+}
+
+bool changePrecheck(ChangeDetector *d, uint32_t jpegLen, uint32_t nowMs) {
+  d->frames++;
+  d->changedBlocks = 0;
+  if (!d->shownBlocks || !d->settled) {
+    d->verdict = CHANGE_SETTLING;
+    return false;
+  }
+  if (nowMs - d->shownAt >= d->cfg.maxAgeMs) {
+    d->verdict = CHANGE_REFRESH;
+    d->refreshes++;
+    return false;
+  }
+
+  uint32_t hi = jpegLen > d->shownLen ? jpegLen : d->shownLen;
+  uint32_t lo = jpegLen > d->shownLen ? d->shownLen : jpegLen;
+  if (!hi || (hi - lo) * 100 / hi > d->cfg.maxSizeDeltaPct) {
+    d->verdict = CHANGE_SIZE;
+    return false;
+  }
+  d->checked++;
+  return true;
+}
+
+bool changeUnchanged(ChangeDetector *d, const uint8_t *dc, uint16_t blocks) {
+  d->changedBlocks = countChanged(d, dc, blocks);
+  if (d->changedBlocks > d->cfg.maxChangedBlocks) {
+    d->verdict = CHANGE_SCENE;
+    return false;
+  }
+  d->verdict = CHANGE_NONE;
+  d->skipped++;
+  return true;
+}
+
+void changeShown(ChangeDetector *d, const uint8_t *dc, uint16_t blocks, uint32_t jpegLen,
+                 uint32_t nowMs) {
+  if (blocks > CHANGE_MAX_BLOCKS) blocks = 0; // too large to track: always decode
+  // Pre-checks only pay off once two shown frames in a row agree; while the
+  // pen moves they would just add an entropy pass to every frame.
+  d->settled = d->shownBlocks && blocks &&
+               countChanged(d, dc, blocks) <= d->cfg.maxChangedBlocks;
+  memcpy(d->shown, dc, blocks);
+  d->shownBlocks = blocks;
+  d->shownLen = jpegLen;
+  d->shownAt = nowMs;
+}
+
+void changeForget(ChangeDetector *d) {
+  d->shownBlocks = 0;
+  d->settled = false;
+}
+
+const char *changeVerdictName(ChangeVerdict v) {
+  switch (v) {
+  case CHANGE_NONE:     return "unchanged";
+  case CHANGE_SCENE:    return "scene";
+  case CHANGE_SIZE:     return "size";
+  case CHANGE_SETTLING: return "settling";
+  case CHANGE_REFRESH:  return "refresh";
+  }
+  return "unknown";
+}
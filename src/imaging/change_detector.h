@@ -0,0 +1,76 @@
+// ============================================
+// Preview Change Detector - ResearchMate
+// Decides whether a preview frame differs enough from the one on the panel
+// to be worth decoding and pushing. Works on the per-MCU DC luma map (what
+// an entropy-only pass yields, ~1/4 of a full decode) plus the JPEG size,
+// compared against the last frame actually shown so slow drift still adds
+// up to a refresh. Pure logic: recorded streams replay on a host.
+//
+// MCU resolution matters: a page creeping by a pixel or two per frame moves
+// text edges across MCUs long before coarse cell means notice.
+// ============================================
+
+#ifndef CHANGE_DETECTOR_H
+#define CHANGE_DETECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define CHANGE_MAX_BLOCKS 1200 // 320x240 with 8x8 MCUs (4:4:4)
+
+struct ChangeConfig {
+  uint8_t blockDelta;       // |dLuma| for an MCU to count as changed
+  uint8_t maxChangedBlocks; // changed MCUs still treated as noise
+  uint8_t maxSizeDeltaPct;  // JPEG size drift beyond which a frame is decoded unchecked
+  uint16_t maxAgeMs;        // refresh the panel at least this often
+};
+
+enum ChangeVerdict {
+  CHANGE_NONE = 0,    // matches the panel: skip decode and push
+  CHANGE_SCENE,       // DC map differs
+  CHANGE_SIZE,        // JPEG size moved too far to bother checking
+  CHANGE_SETTLING,    // scene was still moving at the last shown frame
+  CHANGE_REFRESH,     // maxAgeMs reached
+};
+
+struct ChangeDetector {
+  ChangeConfig cfg;
+  uint8_t shown[CHANGE_MAX_BLOCKS]; // DC map of the frame on the panel
+  uint16_t shownBlocks;
+  bool settled;             // last shown frame matched the one before it
+  uint32_t shownLen;
+  uint32_t shownAt;
+
+  // Last-frame diagnostics
+  ChangeVerdict verdict;
+  uint16_t changedBlocks;
+
+  // Counters
+  uint32_t frames;
+  uint32_t checked;         // entropy-only pre-passes run
+  uint32_t skipped;
+  uint32_t refreshes;
+};
+
+void changeInit(ChangeDetector *d, const ChangeConfig &cfg);
+
+// Before decoding: is an entropy-only pre-pass worth it? Only while the
+// scene is settled, the size is close to the shown frame's and no refresh
+// is due; otherwise the frame is decoded straight away.
+bool changePrecheck(ChangeDetector *d, uint32_t jpegLen, uint32_t nowMs);
+
+// After the pre-pass. True when the frame can be dropped.
+// `dc` is one mean luma per MCU in raster order.
+bool changeUnchanged(ChangeDetector *d, const uint8_t *dc, uint16_t blocks);
+
+// The frame was decoded and displayed; it becomes the reference.
+void changeShown(ChangeDetector *d, const uint8_t *dc, uint16_t blocks, uint32_t jpegLen,
+                 uint32_t nowMs);
+
+// The panel no longer shows the reference (something was drawn over it);
+// the next frame is decoded unchecked.
+void changeForget(ChangeDetector *d);
+
+const char *changeVerdictName(ChangeVerdict v);
+
+#endif // CHANGE_DETECTOR_H
@@ -0,0 +1,109 @@
+#include "focus_peaking.h"
+#include <cstring>
+
+// BT.601 weights folded into the 5/6/5-bit channels: max 254
+static inline uint32_t luma565(uint32_t p) {
+  return ((p >> 11) * 630 + ((p >> 5) & 0x3F) * 608 + (p & 0x1F) * 240) >> 8;
+}
+
+static inline uint16_t swap16(uint16_t p) { return (uint16_t)((p >> 8) | (p << 8)); }
+
+static inline int absDiff(int a, int b) { return a > b ? a - b : b - a; }
+
+// ============================================
+// Kernels
+// ============================================
+void peakLumaRow(const uint16_t *px, uint8_t *luma, int n, bool swapped) {
+  if (swapped) {
+    for (int i = 0; i < n; i++) luma[i] = (uint8_t)luma565(swap16(px[i]));
+  } else {
+    for (int i = 0; i < n; i++) luma[i] = (uint8_t)luma565(px[i]);
+  }
+}
+
+static inline int tintAt(uint16_t *px, int i, int gx, int gy, uint8_t threshold, uint16_t tint) {
+  // All-ones mask where the gradient reaches the threshold: no branch
+  uint16_t m = (uint16_t)-(uint16_t)(gx + gy >= threshold);
+  px[i] = (uint16_t)((px[i] & ~m) | (tint & m));
+  return m & 1;
+}
+
+int peakTintRow(uint16_t *px, const uint8_t *luma, const uint8_t *above, int n, uint8_t threshold,
+                uint16_t tint) {
+  if (n <= 0) return 0;
+  if (n == 1) return tintAt(px, 0, 0, absDiff(luma[0], above[0]), threshold, tint);
+
+  int tinted = tintAt(px, 0, absDiff(luma[1], luma[0]), absDiff(luma[0], above[0]), threshold, tint);
+  for (int i = 1; i < n - 1; i++) {
+    tinted += tintAt(px, i, absDiff(luma[i + 1], luma[i - 1]), absDiff(luma[i], above[i]),
+                     threshold, tint);
+  }
+  tinted += tintAt(px, n - 1, absDiff(luma[n - 1], luma[n - 2]),
+                   absDiff(luma[n - 1], above[n - 1]), threshold, tint);
+  return tinted;
+}
+
+void peakLumaRowRef(const uint16_t *px, uint8_t *luma, int n, bool swapped) {
+  for (int i = 0; i < n; i++) {
+    uint16_t p = swapped ? swap16(px[i]) : px[i];
+    uint32_t r = p >> 11, g = (p >> 5) & 0x3F, b = p & 0x1F;
+    luma[i] = (uint8_t)((r * 630 + g * 608 + b * 240) >> 8);
+  }
+}
+
+int peakTintRowRef(uint16_t *px, const uint8_t *luma, const uint8_t *above, int n,
+                   uint8_t threshold, uint16_t tint) {
+  int tinted = 0;
+  for (int i = 0; i < n; i++) {
+    int left = i > 0 ? i - 1 : i;
+    int right = i < n - 1 ? i + 1 : i;
+    int gx = absDiff(luma[right], luma[left]);
+    int gy = absDiff(luma[i], above[i]);
+    if (gx + gy >= threshold) {
+      px[i] = tint;
+      tinted++;
+    }
+  }
+  return tinted;
+}
+
+// ============================================
+// Streaming
+// ============================================
+void peakInit(PeakingState *s, uint8_t threshold, uint16_t tint, bool swapped) {
+  memset(s, 0, sizeof(*s));
+  s->threshold = threshold;
+  s->tintPx = swapped ? swap16(tint) : tint;
+  s->swapped = swapped;
+}
+
+void peakFrameStart(PeakingState *s, int16_t x, int16_t y, uint16_t w, uint16_t h) {
+  s->areaX = x;
+  s->areaY = y;
+  s->areaW = w < PEAK_MAX_WIDTH ? w : PEAK_MAX_WIDTH;
+  s->areaH = h;
+  s->haveAbove = false;
+  s->pixels = s->tinted = 0;
+}
+
+void peakBlock(PeakingState *s, int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *px) {
+  int32_t x0 = s->areaX > x ? s->areaX : x;
+  int32_t x1 = s->areaX + s->areaW < x + w ? s->areaX + s->areaW : x + w;
+  if (x1 <= x0) return;
+  int n = (int)(x1 - x0);
+
+  for (uint16_t r = 0; r < h; r++) {
+    int32_t row = y + r;
+    if (row < s->areaY) continue;
+    if (row >= s->areaY + s->areaH) break;
+    uint16_t *p = px + (uint32_t)r * w + (x0 - x);
+    peakLumaRow(p, s->luma, n, s->swapped);
+    if (!s->haveAbove) {
+      memcpy(s->above, s->luma, n); // first row: horizontal gradient only
+      s->haveAbove = true;
+    }
+    s->tinted += peakTintRow(p, s->luma, s->above, n, s->threshold, s->tintPx);
+    s->pixels += n;
+    memcpy(s->above, s->luma, n);
+  }
+}
@@ -0,0 +1,59 @@
+// ============================================
+// Focus Peaking - ResearchMate
+// Tints high-gradient pixels of the preview so the user can see whether
+// text is sharp before scanning. Runs on the resampled RGB565 blocks on
+// their way to the panel: gradient = |L(x+1) - L(x-1)| + |L(y) - L(y-1)|,
+// so only the row above is needed and blocks are tinted in place as they
+// stream, with no row held back. Luma of the previous block's last row is
+// carried across blocks.
+//
+// The row kernels are branch-free over plain arrays (the compiler
+// unrolls/vectorises them); scalar per-pixel references with identical
+// results are kept for host tests.
+// ============================================
+
+#ifndef FOCUS_PEAKING_H
+#define FOCUS_PEAKING_H
+
+#include <cstdint>
+
+#define PEAK_MAX_WIDTH 160
+
+struct PeakingState {
+  uint8_t threshold;        // gradient that counts as an edge (luma 0..255 units)
+  uint16_t tintPx;          // tint in the pixels' byte order
+  bool swapped;             // pixels are big-endian RGB565 (panel order)
+
+  // Area to peak this frame, in block coordinates (letterbox bars excluded)
+  int16_t areaX, areaY;
+  uint16_t areaW, areaH;
+
+  uint8_t above[PEAK_MAX_WIDTH]; // luma of the row above the next one
+  bool haveAbove;
+  uint8_t luma[PEAK_MAX_WIDTH];
+
+  // This frame
+  uint32_t pixels;
+  uint32_t tinted;
+};
+
+// `tint` is native RGB565.
+void peakInit(PeakingState *s, uint8_t threshold, uint16_t tint, bool swapped);
+
+// New frame; only pixels inside the area are examined or tinted.
+void peakFrameStart(PeakingState *s, int16_t x, int16_t y, uint16_t w, uint16_t h);
+
+// Tint one block in place. Blocks must arrive top to bottom, full area width.
+void peakBlock(PeakingState *s, int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *px);
+
+// Kernels. Luma: RGB565 -> 0..255. Tint: n pixels, gradient from luma and
+// the row above; returns the number of pixels tinted. px[-1]/px[n] and
+// luma[-1]/luma[n] are not read (edge columns use a one-sided difference).
+void peakLumaRow(const uint16_t *px, uint8_t *luma, int n, bool swapped);
+int peakTintRow(uint16_t *px, const uint8_t *luma, const uint8_t *above, int n, uint8_t threshold,
+                uint16_t tint);
+void peakLumaRowRef(const uint16_t *px, uint8_t *luma, int n, bool swapped);
+int peakTintRowRef(uint16_t *px, const uint8_t *luma, const uint8_t *above, int n,
+                   uint8_t threshold, uint16_t tint);
+
+#endif // FOCUS_PEAKING_H
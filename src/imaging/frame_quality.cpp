@@ -0,0 +1,76 @@
+#include "frame_quality.h"
+#include <cstring>
+
+static uint8_t percentile(const uint32_t *hist, uint32_t total, uint32_t pct) {
+  uint32_t target = (total * pct) / 100;
+  uint32_t acc = 0;
+  for (int i = 0; i < 256; i++) {
+    acc += hist[i];
+    if (acc > target) return (uint8_t)i;
+  }
+  return 255;
+}
+
+void computeFrameQuality(const uint8_t *luma, uint16_t w, uint16_t h,
+                         FrameQualityMetrics *out) {
+  memset(out, 0, sizeof(*out));
+  if (!luma || w < 3 || h < 3) return;
+
+  uint32_t hist[256];
+  memset(hist, 0, sizeof(hist));
+  uint32_t total = (uint32_t)w * h;
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < total; i++) {
+    hist[luma[i]]++;
+    sum += luma[i];
+  }
+
+  uint32_t dark = 0, bright = 0;
+  for (int i = 0; i <= 16; i++) dark += hist[i];
+  for (int i = 240; i < 256; i++) bright += hist[i];
+
+  out->meanLuma = (uint8_t)(sum / total);
+  out->p5 = percentile(hist, total, 5);
+  out->p95 = percentile(hist, total, 95);
+  out->darkPct = (uint8_t)(dark * 100 / total);
+  out->brightPct = (uint8_t)(bright * 100 / total);
+
+  // 4-neighbour Laplacian magnitude. At 1/8 scale each pixel is a block DC
+  // value, so hand-motion blur of a few dozen sensor pixels still shows up
+  // as a collapse in block-to-block edges.
+  uint64_t lap = 0;
+  for (uint16_t y = 1; y < h - 1; y++) {
+    const uint8_t *row = luma + (uint32_t)y * w;
+    const uint8_t *up = row - w;
+    const uint8_t *dn = row + w;
+    for (uint16_t x = 1; x < w - 1; x++) {
+      int v = 4 * row[x] - row[x - 1] - row[x + 1] - up[x] - dn[x];
+      lap += (uint32_t)(v < 0 ? -v : v);
+    }
+  }
+  uint32_t interior = (uint32_t)(w - 2) * (h - 2);
+  // Floor the divisor so sensor noise on a flat frame is not amplified.
+  uint32_t contrast = out->p95 > out->p5 + 32 ? out->p95 - out->p5 : 32;
+  uint64_t score = lap * 100 * 100 / ((uint64_t)interior * contrast);
+  out->sharpness = score > 0xFFFF ? 0xFFFF : (uint16_t)score;
+}
+
+uint16_t jpegDensityMbpp(size_t jpegBytes, uint16_t width, uint16_t height) {
+  uint32_t pixels = (uint32_t)width * height;
+  if (pixels == 0) return 0;
+  uint64_t mbpp = (uint64_t)jpegBytes * 8000 / pixels;
+  return mbpp > 0xFFFF ? 0xFFFF : (uint16_t)mbpp;
+}
+
+const char *checkFrameQuality(const FrameQualityMetrics &m,
+                              const FrameQualityLimits &limits) {
+  if (m.meanLuma < limits.minMean || m.darkPct > limits.maxClipPct)
+    return "underexposed";
+  if (m.meanLuma > limits.maxMean || m.brightPct > limits.maxClipPct)
+    return "overexposed";
+  if ((uint8_t)(m.p95 - m.p5) < limits.minContrast)
+    return "low-contrast";
+  if (m.sharpness < limits.minSharpness || m.densityMbpp < limits.minDensityMbpp)
+    return "blurred";
+  return nullptr;
+}
@@ -0,0 +1,45 @@
+// ============================================
+// Frame Quality Metrics - ResearchMate
+// Exposure + sharpness estimates on a small luma plane
+// ============================================
+
+#ifndef FRAME_QUALITY_H
+#define FRAME_QUALITY_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct FrameQualityMetrics {
+  uint8_t meanLuma;      // 0-255
+  uint8_t p5;            // 5th percentile luma
+  uint8_t p95;           // 95th percentile luma
+  uint8_t darkPct;       // % of pixels <= 16 (crushed shadows)
+  uint8_t brightPct;     // % of pixels >= 240 (blown highlights)
+  uint16_t sharpness;    // mean |Laplacian| normalised to contrast, x100
+  uint16_t densityMbpp;  // compressed size in milli-bits per full-res pixel
+};
+
+struct FrameQualityLimits {
+  uint8_t minMean;
+  uint8_t maxMean;
+  uint8_t maxClipPct;    // dark or bright clipping limit
+  uint8_t minContrast;   // p95 - p5
+  uint16_t minSharpness;
+  uint16_t minDensityMbpp; // blur strips AC energy, so blurred JPEGs shrink
+};
+
+// Compute histogram-based exposure statistics and a contrast-normalised
+// Laplacian sharpness score. Intended for the 1/8-scale decode (DC image),
+// e.g. 200x150 for a UXGA frame — cost is a single pass over w*h bytes.
+void computeFrameQuality(const uint8_t *luma, uint16_t w, uint16_t h,
+                         FrameQualityMetrics *out);
+
+// Bits-per-pixel of the compressed frame. Cheap high-frequency energy proxy
+// that catches fine blur invisible at 1/8 scale.
+uint16_t jpegDensityMbpp(size_t jpegBytes, uint16_t width, uint16_t height);
+
+// Returns nullptr when the frame passes, or a short reason string.
+const char *checkFrameQuality(const FrameQualityMetrics &m,
+                              const FrameQualityLimits &limits);
+
+#endif // FRAME_QUALITY_H
@@ -0,0 +1,539 @@
+#include "jpeg_decoder.h"
+#include <cstring>
+
+// ============================================
+// Tables
+// ============================================
+static const uint8_t zigzag[64] = {
+   0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// AAN scale factors, 14-bit: 16384 * s(row) * s(col), s(0) = 1,
+// s(k) = cos(k*pi/16) * sqrt(2). Folded into the dequantiser.
+static const uint16_t aanScale[64] = {
+  16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+  22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
+  21407, 29692, 27969, 25172, 21407, 16819, 11585,  5906,
+  19266, 26722, 25172, 22654, 19266, 15137, 10426,  5315,
+  16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+  12873, 17855, 16819, 15137, 12873, 10114,  6967,  3552,
+   8867, 12299, 11585, 10426,  8867,  6967,  4799,  2446,
+   4520,  6270,  5906,  5315,  4520,  3552,  2446,  1247};
+
+static inline uint16_t be16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+static inline uint8_t clamp8(int32_t v) { return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v; }
+
+// ============================================
+// Header
+// ============================================
+// Tables defined by this image's header: bits 0-3 quant, 4-5 DC, 6-7 AC.
+// The decoder is reused across frames, so stale tables must not count.
+#define TABLE_QUANT(t) (1u << (t))
+#define TABLE_DC(t)    (1u << (4 + (t)))
+#define TABLE_AC(t)    (1u << (6 + (t)))
+
+static bool parseDqt(JpegDecoder *d, const uint8_t *seg, size_t n, uint8_t *defined) {
+  while (n >= 65) {
+    if (seg[0] >> 4) return false; // 16-bit tables are 12-bit JPEG only
+    uint8_t t = seg[0] & 3;
+    *defined |= TABLE_QUANT(t);
+    for (int k = 0; k < 64; k++) {
+      d->quant[t][k] = ((int32_t)seg[1 + k] * aanScale[zigzag[k]] + (1 << 11)) >> 12;
+    }
+    d->quantDc[t] = seg[1];
+    seg += 65;
+    n -= 65;
+  }
+  return n == 0;
+}
+
+static bool buildHuff(JpegHuffTable *t, const uint8_t *counts, const uint8_t *vals, int total) {
+  memset(t->fast, 0, sizeof(t->fast));
+  memcpy(t->vals, vals, total);
+
+  int32_t code = 0;
+  int k = 0;
+  for (int len = 1; len <= 16; len++) {
+    int n = counts[len - 1];
+    // Over-subscribed: checked before the fill, which indexes by code
+    if (code + n > (1 << len)) return false;
+    t->valPtr[len] = k - code;
+    t->maxCode[len] = n ? code + n - 1 : -1;
+    for (int i = 0; i < n; i++, k++, code++) {
+      if (len <= 8) {
+        int shift = 8 - len;
+        for (int j = 0; j < (1 << shift); j++) {
+          t->fast[(code << shift) | j] = (uint16_t)((len << 8) | vals[k]);
+        }
+      }
+    }
+    code <<= 1;
+  }
+  t->maxCode[17] = 0x7FFFFFFF;
+  return true;
+}
+
+static bool parseDht(JpegDecoder *d, const uint8_t *seg, size_t n, uint8_t *defined) {
+  while (n >= 17) {
+    uint8_t tc = seg[0] >> 4, th = seg[0] & 0x0F;
+    if (tc > 1 || th > 1) return false;
+    int total = 0;
+    for (int i = 0; i < 16; i++) total += seg[1 + i];
+    if (total > 256 || n < 17u + total) return false;
+    if (!buildHuff(tc ? &d->ac[th] : &d->dc[th], seg + 1, seg + 17, total)) return false;
+    *defined |= tc ? TABLE_AC(th) : TABLE_DC(th);
+    seg += 17 + total;
+    n -= 17 + total;
+  }
+  return n == 0;
+}
+
+static JpegDecodeResult parseSof(JpegDecoder *d, const uint8_t *seg, size_t n) {
+  if (n < 6) return JPEG_DEC_ERR_HEADER;
+  if (seg[0] != 8) return JPEG_DEC_ERR_UNSUPPORTED;
+  d->height = be16(seg + 1);
+  d->width = be16(seg + 3);
+  d->numComp = seg[5];
+  if (d->width == 0 || d->height == 0) return JPEG_DEC_ERR_UNSUPPORTED; // DNL
+  if (d->numComp != 1 && d->numComp != 3) return JPEG_DEC_ERR_UNSUPPORTED;
+  if (n < 6u + 3 * d->numComp) return JPEG_DEC_ERR_HEADER;
+
+  for (int i = 0; i < d->numComp; i++) {
+    JpegComponent *c = &d->comp[i];
+    c->id = seg[6 + 3 * i];
+    c->h = seg[7 + 3 * i] >> 4;
+    c->v = seg[7 + 3 * i] & 0x0F;
+    c->tq = seg[8 + 3 * i] & 3;
+  }
+  // A single-component scan is non-interleaved: one block per MCU
+  if (d->numComp == 1) d->comp[0].h = d->comp[0].v = 1;
+  JpegComponent *y = &d->comp[0];
+  if (y->h < 1 || y->h > 2 || y->v < 1 || y->v > 2) return JPEG_DEC_ERR_UNSUPPORTED;
+  for (int i = 1; i < d->numComp; i++) {
+    if (d->comp[i].h != 1 || d->comp[i].v != 1) return JPEG_DEC_ERR_UNSUPPORTED;
+  }
+  return JPEG_DEC_OK;
+}
+
+static bool parseSos(JpegDecoder *d, const uint8_t *seg, size_t n, uint8_t defined) {
+  if (n < 1 || seg[0] != d->numComp || n < 4u + 2 * d->numComp) return false;
+  for (int i = 0; i < d->numComp; i++) {
+    JpegComponent *c = &d->comp[i];
+    if (seg[1 + 2 * i] != c->id) return false;
+    c->td = (seg[2 + 2 * i] >> 4) & 1;
+    c->ta = seg[2 + 2 * i] & 1;
+    uint8_t needed = TABLE_QUANT(c->tq) | TABLE_DC(c->td) | TABLE_AC(c->ta);
+    if ((defined & needed) != needed) return false;
+  }
+  return true;
+}
+
+static JpegDecodeResult parseHeader(JpegDecoder *d, const uint8_t *data, size_t len) {
+  if (!data || len < 4 || data[0] != 0xFF || data[1] != 0xD8) return JPEG_DEC_ERR_HEADER;
+  d->restartInterval = 0;
+  bool haveSof = false;
+  uint8_t defined = 0;
+
+  size_t pos = 2;
+  while (pos + 4 <= len) {
+    if (data[pos] != 0xFF) return JPEG_DEC_ERR_HEADER;
+    uint8_t m = data[pos + 1];
+    if (m == 0xFF) { pos++; continue; }
+    size_t segLen = be16(data + pos + 2);
+    if (segLen < 2 || pos + 2 + segLen > len) return JPEG_DEC_ERR_HEADER;
+    const uint8_t *seg = data + pos + 4;
+    size_t n = segLen - 2;
+
+    if (m == 0xC0 || m == 0xC1) {
+      JpegDecodeResult r = parseSof(d, seg, n);
+      if (r != JPEG_DEC_OK) return r;
+      haveSof = true;
+    } else if (m >= 0xC2 && m <= 0xCF && m != 0xC4 && m != 0xCC) {
+      return JPEG_DEC_ERR_UNSUPPORTED; // progressive, lossless, arithmetic
+    } else if (m == 0xC4) {
+      if (!parseDht(d, seg, n, &defined)) return JPEG_DEC_ERR_HEADER;
+    } else if (m == 0xDB) {
+      if (!parseDqt(d, seg, n, &defined)) return JPEG_DEC_ERR_UNSUPPORTED;
+    } else if (m == 0xDD) {
+      if (n < 2) return JPEG_DEC_ERR_HEADER;
+      d->restartInterval = be16(seg);
+    } else if (m == 0xDA) {
+      if (!haveSof || !parseSos(d, seg, n, defined)) return JPEG_DEC_ERR_HEADER;
+      d->p = data + pos + 2 + segLen;
+      d->end = data + len;
+      return JPEG_DEC_OK;
+    } else if (m == 0xD9) {
+      return JPEG_DEC_ERR_HEADER;
+    }
+    pos += 2 + segLen;
+  }
+  return JPEG_DEC_ERR_HEADER;
+}
+
+// ============================================
+// Entropy decoding
+// ============================================
+static inline void fill(JpegDecoder *d) {
+  while (d->nbits <= 24) {
+    uint32_t b = 0;
+    if (!d->hitMarker && d->p < d->end) {
+      b = *d->p;
+      if (b == 0xFF) {
+        uint8_t next = d->p + 1 < d->end ? d->p[1] : 0xD9;
+        if (next == 0xFF) {
+          d->p++; // fill byte
+          continue;
+        }
+        if (next == 0x00) {
+          d->p += 2;
+          d->realBits += 8;
+        } else {
+          d->hitMarker = true; // leave p on the marker for restart handling
+          b = 0;
+        }
+      } else {
+        d->p++;
+        d->realBits += 8;
+      }
+    }
+    // Past a marker or the end the decoder reads zeros
+    d->bits |= b << (24 - d->nbits);
+    d->nbits += 8;
+  }
+}
+
+static inline void consume(JpegDecoder *d, int n) {
+  d->bits <<= n;
+  d->nbits -= n;
+  d->realBits -= n;
+}
+
+static inline int huffDecode(JpegDecoder *d, const JpegHuffTable *t) {
+  if (d->nbits < 16) fill(d);
+  uint16_t e = t->fast[d->bits >> 24];
+  if (e) {
+    consume(d, e >> 8);
+    return e & 0xFF;
+  }
+  for (int len = 9; len <= 16; len++) {
+    int32_t code = (int32_t)(d->bits >> (32 - len));
+    if (code <= t->maxCode[len]) {
+      consume(d, len);
+      return t->vals[(t->valPtr[len] + code) & 0xFF];
+    }
+  }
+  return -1;
+}
+
+static inline int32_t receiveExtend(JpegDecoder *d, int s) {
+  if (d->nbits < s) fill(d);
+  int32_t v = (int32_t)(d->bits >> (32 - s));
+  consume(d, s);
+  return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+}
+
+// Decode one block. With coef == nullptr the AC terms are only walked.
+// Returns 1 if any AC term is present, 0 for a DC-only block, -1 on error.
+static int decodeBlock(JpegDecoder *d, JpegComponent *c, int32_t *coef) {
+  int s = huffDecode(d, &d->dc[c->td]);
+  if (s < 0 || s > 11) return -1;
+  if (s) c->dcPred += receiveExtend(d, s);
+
+  const JpegHuffTable *ac = &d->ac[c->ta];
+  if (!coef) {
+    for (int k = 1; k < 64;) {
+      int rs = huffDecode(d, ac);
+      if (rs < 0) return -1;
+      s = rs & 15;
+      if (s) {
+        if (d->nbits < s) fill(d);
+        consume(d, s);
+        k += (rs >> 4) + 1;
+      } else if (rs == 0xF0) {
+        k += 16;
+      } else {
+        break;
+      }
+    }
+    return 0;
+  }
+
+  const int32_t *q = d->quant[c->tq];
+  memset(coef, 0, 64 * sizeof(int32_t));
+  coef[0] = c->dcPred * q[0];
+  int any = 0;
+  for (int k = 1; k < 64;) {
+    int rs = huffDecode(d, ac);
+    if (rs < 0) return -1;
+    s = rs & 15;
+    if (s) {
+      k += rs >> 4;
+      if (k > 63) return -1;
+      coef[zigzag[k]] = receiveExtend(d, s) * q[k];
+      any = 1;
+      k++;
+    } else if (rs == 0xF0) {
+      k += 16;
+    } else {
+      break;
+    }
+  }
+  return any;
+}
+
+static bool restart(JpegDecoder *d) {
+  d->bits = 0;
+  d->nbits = 0;
+  d->realBits = 0;
+  d->hitMarker = false;
+  while (d->p + 1 < d->end && !(d->p[0] == 0xFF && d->p[1] >= 0xD0 && d->p[1] <= 0xD7)) d->p++;
+  if (d->p + 1 >= d->end) return false;
+  d->p += 2;
+  for (int i = 0; i < d->numComp; i++) d->comp[i].dcPred = 0;
+  return true;
+}
+
+// ============================================
+// IDCT (AAN, 8-bit fixed point; the scale factors live in the dequantiser)
+// ============================================
+#define FIX_1_082392200 277
+#define FIX_1_414213562 362
+#define FIX_1_847759065 473
+#define FIX_2_613125930 669
+#define MUL(v, c) (((v) * (c)) >> 8)
+#define PASS1_BITS 2
+
+static void idct8x8(const int32_t *in, uint8_t *out, int stride) {
+  int32_t ws[64];
+
+  // Columns
+  for (int c = 0; c < 8; c++) {
+    const int32_t *s = in + c;
+    int32_t *w = ws + c;
+    if (!(s[8] | s[16] | s[24] | s[32] | s[40] | s[48] | s[56])) {
+      w[0] = w[8] = w[16] = w[24] = w[32] = w[40] = w[48] = w[56] = s[0];
+      continue;
+    }
+    int32_t tmp10 = s[0] + s[32], tmp11 = s[0] - s[32];
+    int32_t tmp13 = s[16] + s[48];
+    int32_t tmp12 = MUL(s[16] - s[48], FIX_1_414213562) - tmp13;
+    int32_t tmp0 = tmp10 + tmp13, tmp3 = tmp10 - tmp13;
+    int32_t tmp1 = tmp11 + tmp12, tmp2 = tmp11 - tmp12;
+
+    int32_t z13 = s[40] + s[24], z10 = s[40] - s[24];
+    int32_t z11 = s[8] + s[56], z12 = s[8] - s[56];
+    int32_t tmp7 = z11 + z13;
+    tmp11 = MUL(z11 - z13, FIX_1_414213562);
+    int32_t z5 = MUL(z10 + z12, FIX_1_847759065);
+    tmp10 = MUL(z12, FIX_1_082392200) - z5;
+    tmp12 = MUL(z10, -FIX_2_613125930) + z5;
+    int32_t tmp6 = tmp12 - tmp7;
+    int32_t tmp5 = tmp11 - tmp6;
+    int32_t tmp4 = tmp10 + tmp5;
+
+    w[0] = tmp0 + tmp7;  w[56] = tmp0 - tmp7;
+    w[8] = tmp1 + tmp6;  w[48] = tmp1 - tmp6;
+    w[16] = tmp2 + tmp5; w[40] = tmp2 - tmp5;
+    w[32] = tmp3 + tmp4; w[24] = tmp3 - tmp4;
+  }
+
+  // Rows; outputs carry PASS1_BITS + 3 extra bits
+  const int32_t round = 1 << (PASS1_BITS + 2);
+  for (int r = 0; r < 8; r++, out += stride) {
+    const int32_t *w = ws + r * 8;
+    int32_t tmp10 = w[0] + w[4], tmp11 = w[0] - w[4];
+    int32_t tmp13 = w[2] + w[6];
+    int32_t tmp12 = MUL(w[2] - w[6], FIX_1_414213562) - tmp13;
+    int32_t tmp0 = tmp10 + tmp13, tmp3 = tmp10 - tmp13;
+    int32_t tmp1 = tmp11 + tmp12, tmp2 = tmp11 - tmp12;
+
+    int32_t z13 = w[5] + w[3], z10 = w[5] - w[3];
+    int32_t z11 = w[1] + w[7], z12 = w[1] - w[7];
+    int32_t tmp7 = z11 + z13;
+    tmp11 = MUL(z11 - z13, FIX_1_414213562);
+    int32_t z5 = MUL(z10 + z12, FIX_1_847759065);
+    tmp10 = MUL(z12, FIX_1_082392200) - z5;
+    tmp12 = MUL(z10, -FIX_2_613125930) + z5;
+    int32_t tmp6 = tmp12 - tmp7;
+    int32_t tmp5 = tmp11 - tmp6;
+    int32_t tmp4 = tmp10 + tmp5;
+
+    out[0] = clamp8(((tmp0 + tmp7 + round) >> (PASS1_BITS + 3)) + 128);
+    out[7] = clamp8(((tmp0 - tmp7 + round) >> (PASS1_BITS + 3)) + 128);
+    out[1] = clamp8(((tmp1 + tmp6 + round) >> (PASS1_BITS + 3)) + 128);
+    out[6] = clamp8(((tmp1 - tmp6 + round) >> (PASS1_BITS + 3)) + 128);
+    out[2] = clamp8(((tmp2 + tmp5 + round) >> (PASS1_BITS + 3)) + 128);
+    out[5] = clamp8(((tmp2 - tmp5 + round) >> (PASS1_BITS + 3)) + 128);
+    out[4] = clamp8(((tmp3 + tmp4 + round) >> (PASS1_BITS + 3)) + 128);
+    out[3] = clamp8(((tmp3 - tmp4 + round) >> (PASS1_BITS + 3)) + 128);
+  }
+}
+
+// Block -> samples: a full IDCT, or a flat fill when only DC is present
+// (or the output is 1/8 scale, where only the block mean survives).
+static void blockToSamples(const int32_t *coef, int acPresent, uint8_t scale, uint8_t *out,
+                           int stride) {
+  if (acPresent && scale < 3) {
+    idct8x8(coef, out, stride);
+    return;
+  }
+  uint8_t v = clamp8(((coef[0] + (1 << (PASS1_BITS + 2))) >> (PASS1_BITS + 3)) + 128);
+  for (int r = 0; r < 8; r++, out += stride) memset(out, v, 8);
+}
+
+// ============================================
+// Colour conversion with box downscale
+// ============================================
+static void mcuToRgb565(JpegDecoder *d, uint8_t scale, bool swap, uint16_t w, uint16_t h) {
+  const int mcuW = d->comp[0].h * 8;
+  const int hsh = d->comp[0].h - 1, vsh = d->comp[0].v - 1;
+  const int n = 1 << scale, avgShift = 2 * scale;
+  const bool gray = d->numComp == 1;
+
+  uint16_t *o = d->out;
+  for (int oy = 0; oy < h; oy++) {
+    for (int ox = 0; ox < w; ox++) {
+      int32_t y = 0, cb = 0, cr = 0;
+      for (int j = 0; j < n; j++) {
+        int sy = (oy << scale) + j;
+        const uint8_t *yRow = d->yPlane + sy * mcuW;
+        int cRow = (sy >> vsh) * 8;
+        for (int i = 0; i < n; i++) {
+          int sx = (ox << scale) + i;
+          y += yRow[sx];
+          if (!gray) {
+            cb += d->cb[cRow + (sx >> hsh)];
+            cr += d->cr[cRow + (sx >> hsh)];
+          }
+        }
+      }
+      y >>= avgShift;
+      uint8_t r, g, b;
+      if (gray) {
+        r = g = b = (uint8_t)y;
+      } else {
+        cb = (cb >> avgShift) - 128;
+        cr = (cr >> avgShift) - 128;
+        r = clamp8(y + ((91881 * cr + 32768) >> 16));
+        g = clamp8(y - ((22554 * cb + 46802 * cr - 32768) >> 16));
+        b = clamp8(y + ((116130 * cb + 32768) >> 16));
+      }
+      uint16_t px = (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+      *o++ = swap ? (uint16_t)((px >> 8) | (px << 8)) : px;
+    }
+  }
+}
+
+// ============================================
+// Public API
+// ============================================
+JpegDecodeResult jpegDecode(JpegDecoder *d, const uint8_t *jpg, size_t len,
+                            const JpegDecodeOptions &opt, JpegBlockFn out, void *ctx,
+                            JpegDecodeStats *stats) {
+  JpegDecodeStats local;
+  if (!stats) stats = &local;
+  memset(stats, 0, sizeof(*stats));
+  if (opt.scale > 3) return JPEG_DEC_ERR_UNSUPPORTED;
+
+  JpegDecodeResult r = parseHeader(d, jpg, len);
+  if (r != JPEG_DEC_OK) return r;
+
+  d->bits = 0;
+  d->nbits = 0;
+  d->realBits = 0;
+  d->hitMarker = false;
+  for (int i = 0; i < d->numComp; i++) d->comp[i].dcPred = 0;
+
+  const uint8_t s = opt.scale;
+  const int hs = d->comp[0].h, vs = d->comp[0].v;
+  const int mcuW = 8 * hs, mcuH = 8 * vs;
+  const int mcusX = (d->width + mcuW - 1) / mcuW;
+  const int mcusY = (d->height + mcuH - 1) / mcuH;
+  const int32_t clipL = opt.clipX, clipT = opt.clipY;
+  const int32_t clipR = opt.clipW ? clipL + opt.clipW : INT32_MAX;
+  const int32_t clipB = opt.clipH ? clipT + opt.clipH : INT32_MAX;
+  stats->mcus = (uint16_t)(mcusX * mcusY);
+
+  uint16_t untilRestart = d->restartInterval;
+  for (int my = 0; my < mcusY; my++) {
+    int32_t oy = opt.y + ((my * mcuH) >> s);
+    uint16_t bh = (uint16_t)(((d->height - my * mcuH < mcuH) ? d->height - my * mcuH : mcuH) >> s);
+    // Everything from here down is below the clip
+    if (oy >= clipB) {
+      stats->notReached = (uint16_t)((mcusY - my) * mcusX);
+      break;
+    }
+    bool rowVisible = bh && oy + bh > clipT;
+
+    for (int mx = 0; mx < mcusX; mx++) {
+      if (d->restartInterval) {
+        if (untilRestart == 0) {
+          if (!restart(d)) return JPEG_DEC_ERR_DATA;
+          untilRestart = d->restartInterval;
+        }
+        untilRestart--;
+      }
+      // Truncated stream: the previous MCU already ran into padding
+      if (d->realBits < 0) return JPEG_DEC_ERR_DATA;
+
+      int32_t ox = opt.x + ((mx * mcuW) >> s);
+      uint16_t bw = (uint16_t)(((d->width - mx * mcuW < mcuW) ? d->width - mx * mcuW : mcuW) >> s);
+      bool visible = !opt.dcOnly && rowVisible && bw && ox < clipR && ox + bw > clipL;
+
+      int32_t dcSum = 0;
+      if (!visible) {
+        for (int b = 0; b < hs * vs; b++) {
+          if (decodeBlock(d, &d->comp[0], nullptr) < 0) return JPEG_DEC_ERR_DATA;
+          dcSum += d->comp[0].dcPred;
+        }
+        for (int i = 1; i < d->numComp; i++) {
+          if (decodeBlock(d, &d->comp[i], nullptr) < 0) return JPEG_DEC_ERR_DATA;
+        }
+        stats->skipped++;
+        if (opt.onDc && bw && bh) {
+          int32_t mean = dcSum * d->quantDc[d->comp[0].tq] / (8 * hs * vs) + 128;
+          opt.onDc(ctx, (int16_t)ox, (int16_t)oy, bw, bh, clamp8(mean));
+        }
+        continue;
+      }
+
+      for (int b = 0; b < hs * vs; b++) {
+        int ac = decodeBlock(d, &d->comp[0], d->coef);
+        if (ac < 0) return JPEG_DEC_ERR_DATA;
+        dcSum += d->comp[0].dcPred;
+        blockToSamples(d->coef, ac, s, d->yPlane + (b / hs) * 8 * mcuW + (b % hs) * 8, mcuW);
+      }
+      if (d->numComp == 3) {
+        int ac = decodeBlock(d, &d->comp[1], d->coef);
+        if (ac < 0) return JPEG_DEC_ERR_DATA;
+        blockToSamples(d->coef, ac, s, d->cb, 8);
+        ac = decodeBlock(d, &d->comp[2], d->coef);
+        if (ac < 0) return JPEG_DEC_ERR_DATA;
+        blockToSamples(d->coef, ac, s, d->cr, 8);
+      }
+
+      mcuToRgb565(d, s, opt.swapBytes, bw, bh);
+      stats->decoded++;
+      if (opt.onDc) {
+        int32_t mean = dcSum * d->quantDc[d->comp[0].tq] / (8 * hs * vs) + 128;
+        opt.onDc(ctx, (int16_t)ox, (int16_t)oy, bw, bh, clamp8(mean));
+      }
+      if (!out(ctx, (int16_t)ox, (int16_t)oy, bw, bh, d->out)) return JPEG_DEC_ABORTED;
+    }
+  }
+  if (!stats->notReached && d->realBits < 0) return JPEG_DEC_ERR_DATA;
+  return JPEG_DEC_OK;
+}
+
+const char *jpegDecodeResultName(JpegDecodeResult r) {
+  switch (r) {
+  case JPEG_DEC_OK:              return "ok";
+  case JPEG_DEC_ERR_HEADER:      return "bad-header";
+  case JPEG_DEC_ERR_UNSUPPORTED: return "unsupported";
+  case JPEG_DEC_ERR_DATA:        return "bad-data";
+  case JPEG_DEC_ABORTED:         return "aborted";
+  }
+  return "unknown";
+}
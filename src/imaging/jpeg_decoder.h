@@ -0,0 +1,88 @@
+// ============================================
+// JPEG Decoder - ResearchMate
+// Baseline JPEG to RGB565 in MCU-sized blocks, with a clip rectangle. MCUs
+// entirely outside the rectangle are still entropy-decoded (the Huffman
+// stream has no random access) but skip dequantisation, IDCT and colour
+// conversion, and decoding stops after the last MCU row that reaches it.
+// ============================================
+
+#ifndef JPEG_DECODER_H
+#define JPEG_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum JpegDecodeResult {
+  JPEG_DEC_OK = 0,
+  JPEG_DEC_ERR_HEADER,       // missing/short SOI, SOF, DQT, DHT or SOS
+  JPEG_DEC_ERR_UNSUPPORTED,  // progressive, 12-bit, or unusual sampling
+  JPEG_DEC_ERR_DATA,         // corrupt entropy-coded data
+  JPEG_DEC_ABORTED           // output callback returned false
+};
+
+// Receives w x h RGB565 pixels (row stride w) at screen position (x, y).
+typedef bool (*JpegBlockFn)(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                            uint16_t *pixels);
+// Receives the mean luma of an MCU, from its DC terms alone.
+typedef void (*JpegDcFn)(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                         uint8_t luma);
+
+struct JpegDecodeOptions {
+  uint8_t scale;              // output is 1/(1 << scale) of the image, 0..3
+  int16_t x, y;               // screen position of the top-left output pixel
+  int16_t clipX, clipY;       // visible rectangle, screen coordinates;
+  uint16_t clipW, clipH;      // 0 = unbounded in that direction
+  bool swapBytes;             // big-endian RGB565 (what pushImage(swap565_t) wants)
+  bool dcOnly;                // treat every MCU as clipped: entropy-decode only
+  JpegDcFn onDc;              // optional, every MCU (decoded or skipped) in the clip rows
+};
+
+struct JpegDecodeStats {
+  uint16_t mcus;              // MCUs in the image
+  uint16_t decoded;           // went through IDCT + colour conversion
+  uint16_t skipped;           // entropy-decoded only
+  uint16_t notReached;        // below the clip: decoding stopped before them
+};
+
+struct JpegHuffTable {
+  uint16_t fast[256];         // 8-bit lookahead: (length << 8) | symbol, 0 = longer code
+  int32_t maxCode[18];        // per length, -1 = none
+  int32_t valPtr[17];         // vals index = valPtr[len] + code
+  uint8_t vals[256];
+};
+
+struct JpegComponent {
+  uint8_t id, h, v, tq, td, ta;
+  int16_t dcPred;
+};
+
+// ~5KB of tables and MCU scratch; keep one per decoding task.
+struct JpegDecoder {
+  int32_t quant[4][64];       // zigzag order, pre-scaled for the AAN IDCT
+  uint8_t quantDc[4];         // raw DC quantiser, for skip luma
+  JpegHuffTable dc[2], ac[2];
+  JpegComponent comp[3];
+  uint8_t numComp;
+  uint16_t width, height, restartInterval;
+
+  // Bit reader
+  const uint8_t *p, *end;
+  uint32_t bits;              // MSB-aligned
+  int8_t nbits;
+  int32_t realBits;           // bits of actual data left; < 0 once padding is consumed
+  bool hitMarker;
+
+  // MCU scratch
+  int32_t coef[64];
+  uint8_t yPlane[16 * 16];
+  uint8_t cb[64], cr[64];
+  uint16_t out[16 * 16];
+};
+
+JpegDecodeResult jpegDecode(JpegDecoder *d, const uint8_t *jpg, size_t len,
+                            const JpegDecodeOptions &opt, JpegBlockFn out, void *ctx,
+                            JpegDecodeStats *stats);
+
+const char *jpegDecodeResultName(JpegDecodeResult r);
+
+#endif // JPEG_DECODER_H
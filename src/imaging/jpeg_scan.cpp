@@ -0,0 +1,110 @@
+#include "jpeg_scan.h"
+#include <cstring>
+
+// ============================================
+// Helpers
+// ============================================
+static inline uint16_t be16(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+// Markers that carry a 16-bit length field and may legally appear between
+// scans (multi-scan / progressive files).
+static bool isInterScanSegment(uint8_t m) {
+  return m == 0xC4 || m == 0xDA || m == 0xDB || m == 0xDD || m == 0xFE ||
+         (m >= 0xE0 && m <= 0xEF);
+}
+
+static JpegScanResult parseHeader(const uint8_t *data, size_t len, JpegInfo *info) {
+  if (!data || len < 4) return JPEG_ERR_EMPTY;
+  if (data[0] != 0xFF || data[1] != 0xD8) return JPEG_ERR_NO_SOI;
+
+  bool haveSof = false;
+  size_t pos = 2;
+  while (pos + 4 <= len) {
+    if (data[pos] != 0xFF) return JPEG_ERR_BAD_SEGMENT;
+    uint8_t marker = data[pos + 1];
+    if (marker == 0xFF) { pos++; continue; } // fill byte
+    if (marker == 0xD9) return JPEG_ERR_NO_SOS;
+
+    size_t segLen = be16(data + pos + 2);
+    if (segLen < 2 || pos + 2 + segLen > len) return JPEG_ERR_BAD_SEGMENT;
+    const uint8_t *seg = data + pos + 4;
+
+    // SOF0..SOF2 (baseline, extended, progressive Huffman)
+    if (marker >= 0xC0 && marker <= 0xC2) {
+      if (segLen < 8) return JPEG_ERR_BAD_SEGMENT;
+      info->height = be16(seg + 1);
+      info->width = be16(seg + 3);
+      info->components = seg[5];
+      if (segLen >= 8 + 3u * info->components && info->components > 0) {
+        info->hSamp = seg[7] >> 4;
+        info->vSamp = seg[7] & 0x0F;
+      }
+      haveSof = true;
+    } else if (marker == 0xDA) {
+      if (!haveSof) return JPEG_ERR_NO_SOF;
+      info->scanOffset = pos + 2 + segLen;
+      return JPEG_OK;
+    }
+    pos += 2 + segLen;
+  }
+  return haveSof ? JPEG_ERR_NO_SOS : JPEG_ERR_NO_SOF;
+}
+
+// ============================================
+// Public API
+// ============================================
+JpegScanResult jpegReadHeader(const uint8_t *data, size_t len, JpegInfo *info) {
+  JpegInfo local;
+  if (!info) info = &local;
+  memset(info, 0, sizeof(*info));
+  info->hSamp = info->vSamp = 1;
+  return parseHeader(data, len, info);
+}
+
+JpegScanResult jpegScanStructure(const uint8_t *data, size_t len, JpegInfo *info) {
+  JpegInfo local;
+  if (!info) info = &local;
+  JpegScanResult r = jpegReadHeader(data, len, info);
+  if (r != JPEG_OK) return r;
+
+  // Entropy-coded data: every 0xFF must be stuffed (FF 00), a restart marker
+  // (FF D0-D7), fill (FF FF) or the final EOI. memchr does the heavy lifting,
+  // so a 300KB UXGA frame scans in well under a millisecond.
+  size_t pos = info->scanOffset;
+  while (pos < len) {
+    const uint8_t *ff = (const uint8_t *)memchr(data + pos, 0xFF, len - pos);
+    if (!ff) break;
+    pos = (size_t)(ff - data);
+    if (pos + 1 >= len) break;
+
+    uint8_t m = data[pos + 1];
+    if (m == 0x00 || m == 0xFF || (m >= 0xD0 && m <= 0xD7)) {
+      pos += (m == 0xFF) ? 1 : 2;
+    } else if (m == 0xD9) {
+      info->eoiOffset = pos;
+      return JPEG_OK;
+    } else if (isInterScanSegment(m)) {
+      if (pos + 4 > len) break;
+      size_t segLen = be16(data + pos + 2);
+      if (segLen < 2 || pos + 2 + segLen > len) return JPEG_ERR_BAD_SEGMENT;
+      pos += 2 + segLen;
+    } else {
+      return JPEG_ERR_BAD_MARKER;
+    }
+  }
+  return JPEG_ERR_NO_EOI;
+}
+
+const char *jpegScanResultName(JpegScanResult r) {
+  switch (r) {
+  case JPEG_OK:              return "ok";
+  case JPEG_ERR_EMPTY:       return "empty";
+  case JPEG_ERR_NO_SOI:      return "no-soi";
+  case JPEG_ERR_BAD_SEGMENT: return "bad-segment";
+  case JPEG_ERR_NO_SOF:      return "no-sof";
+  case JPEG_ERR_NO_SOS:      return "no-sos";
+  case JPEG_ERR_BAD_MARKER:  return "bad-marker";
+  case JPEG_ERR_NO_EOI:      return "no-eoi";
+  }
+  return "unknown";
+}
@@ -0,0 +1,42 @@
+// ============================================
+// JPEG Structure Scanner - ResearchMate
+// Marker-level validation without decoding
+// ============================================
+
+#ifndef JPEG_SCAN_H
+#define JPEG_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum JpegScanResult {
+  JPEG_OK = 0,
+  JPEG_ERR_EMPTY,        // null buffer or shorter than SOI + EOI
+  JPEG_ERR_NO_SOI,       // does not start with FF D8
+  JPEG_ERR_BAD_SEGMENT,  // marker segment length runs past the buffer
+  JPEG_ERR_NO_SOF,       // no baseline/progressive frame header before SOS
+  JPEG_ERR_NO_SOS,       // header ended without a scan
+  JPEG_ERR_BAD_MARKER,   // illegal marker inside entropy-coded data
+  JPEG_ERR_NO_EOI        // entropy data truncated (missing FF D9)
+};
+
+struct JpegInfo {
+  uint16_t width;
+  uint16_t height;
+  uint8_t components;
+  uint8_t hSamp;           // luma horizontal sampling factor (MCU = 8*hSamp wide)
+  uint8_t vSamp;           // luma vertical sampling factor
+  size_t scanOffset;       // first byte of entropy-coded data
+  size_t eoiOffset;        // offset of the FF D9 marker
+};
+
+// Walk the marker segments up to SOS, then verify the entropy-coded segment
+// runs cleanly into an EOI. `info` may be null when only validity matters.
+JpegScanResult jpegScanStructure(const uint8_t *data, size_t len, JpegInfo *info);
+
+// Header-only variant: stops at SOS, so it is cheap enough for every frame.
+JpegScanResult jpegReadHeader(const uint8_t *data, size_t len, JpegInfo *info);
+
+const char *jpegScanResultName(JpegScanResult r);
+
+#endif // JPEG_SCAN_H
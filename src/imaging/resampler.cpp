@@ -0,0 +1,221 @@
+#include "resampler.h"
+#include <cstring>
+
+#define EXP_MASK  0x07E0F81Fu
+#define EXP_ROUND 0x02008010u  // +16 in each channel before the >> 5
+
+static inline size_t align4(size_t n) { return (n + 3) & ~(size_t)3; }
+static inline uint32_t expand(uint16_t p) { return ((uint32_t)p | ((uint32_t)p << 16)) & EXP_MASK; }
+
+// ============================================
+// Kernels
+// ============================================
+void resampleRowH(const uint16_t *src, const uint16_t *idx, const uint8_t *wt, uint32_t *dst,
+                  int n) {
+  for (int i = 0; i < n; i++) {
+    const uint16_t *p = src + idx[i];
+    uint32_t w = wt[i];
+    dst[i] = ((expand(p[0]) * (32 - w) + expand(p[1]) * w + EXP_ROUND) >> 5) & EXP_MASK;
+  }
+}
+
+void resampleRowV(const uint32_t *a, const uint32_t *b, uint8_t w, uint16_t *dst, int n,
+                  bool swap) {
+  const uint32_t wa = 32 - w, wb = w;
+  for (int i = 0; i < n; i++) {
+    uint32_t e = ((a[i] * wa + b[i] * wb + EXP_ROUND) >> 5) & EXP_MASK;
+    uint16_t p = (uint16_t)((e & 0xF81F) | ((e >> 16) & 0x07E0));
+    dst[i] = swap ? (uint16_t)((p >> 8) | (p << 8)) : p;
+  }
+}
+
+static inline uint32_t lerp(uint32_t a, uint32_t b, uint32_t w) {
+  return (a * (32 - w) + b * w + 16) >> 5;
+}
+
+void resampleRowHRef(const uint16_t *src, const uint16_t *idx, const uint8_t *wt, uint32_t *dst,
+                     int n) {
+  for (int i = 0; i < n; i++) {
+    uint16_t a = src[idx[i]], b = src[idx[i] + 1];
+    uint32_t r = lerp(a >> 11, b >> 11, wt[i]);
+    uint32_t g = lerp((a >> 5) & 0x3F, (b >> 5) & 0x3F, wt[i]);
+    uint32_t bl = lerp(a & 0x1F, b & 0x1F, wt[i]);
+    dst[i] = (g << 21) | (r << 11) | bl;
+  }
+}
+
+void resampleRowVRef(const uint32_t *a, const uint32_t *b, uint8_t w, uint16_t *dst, int n,
+                     bool swap) {
+  for (int i = 0; i < n; i++) {
+    uint32_t r = lerp((a[i] >> 11) & 0x1F, (b[i] >> 11) & 0x1F, w);
+    uint32_t g = lerp((a[i] >> 21) & 0x3F, (b[i] >> 21) & 0x3F, w);
+    uint32_t bl = lerp(a[i] & 0x1F, b[i] & 0x1F, w);
+    uint16_t p = (uint16_t)((r << 11) | (g << 5) | bl);
+    dst[i] = swap ? (uint16_t)((p >> 8) | (p << 8)) : p;
+  }
+}
+
+// ============================================
+// Geometry
+// ============================================
+
+// Source position (Q16, pixel centres) -> left sample and right weight/32
+static void sampleAt(int32_t q, uint16_t n, uint16_t *idx, uint8_t *w) {
+  if (q < 0) q = 0;
+  int32_t i = q >> 16;
+  uint32_t f = ((q & 0xFFFF) + 1024) >> 11;
+  if (f == 32) {
+    i++;
+    f = 0;
+  }
+  if (i >= n - 1) {
+    i = n - 2;
+    f = 32;
+  }
+  *idx = (uint16_t)i;
+  *w = (uint8_t)f;
+}
+
+size_t resampleWorkBytes(const ResampleConfig &cfg) {
+  return 2 * sizeof(uint32_t) * cfg.dstW + align4(sizeof(uint16_t) * cfg.dstW) +
+         align4(cfg.dstW) + align4(sizeof(uint16_t) * cfg.srcW * cfg.bandRows) +
+         align4(sizeof(uint16_t) * cfg.dstW * cfg.blockRows);
+}
+
+bool resampleInit(ResampleState *s, const ResampleConfig &cfg, void *work, ResampleEmitFn emit,
+                  void *ctx) {
+  if (!work || !emit || cfg.srcW < 2 || cfg.srcH < 2 || !cfg.dstW || !cfg.dstH ||
+      !cfg.bandRows || !cfg.blockRows)
+    return false;
+  memset(s, 0, sizeof(*s));
+  s->cfg = cfg;
+  s->emit = emit;
+  s->ctx = ctx;
+
+  // One step for both axes keeps the aspect ratio
+  uint32_t stepW = ((uint32_t)cfg.srcW << 16) / cfg.dstW;
+  uint32_t stepH = ((uint32_t)cfg.srcH << 16) / cfg.dstH;
+  uint32_t step = cfg.fit == RESAMPLE_FIT_LETTERBOX ? (stepW > stepH ? stepW : stepH)
+                                                    : (stepW < stepH ? stepW : stepH);
+  uint32_t fitW = (((uint32_t)cfg.srcW << 16) + step / 2) / step;
+  uint32_t fitH = (((uint32_t)cfg.srcH << 16) + step / 2) / step;
+  s->stepQ16 = step;
+  s->imgW = (uint16_t)(fitW < cfg.dstW ? fitW : cfg.dstW);
+  s->imgH = (uint16_t)(fitH < cfg.dstH ? fitH : cfg.dstH);
+  s->imgX = (uint16_t)((cfg.dstW - s->imgW) / 2);
+  s->imgY = (uint16_t)((cfg.dstH - s->imgH) / 2);
+
+  // Centre the sampled window on the frame (a crop trims both sides)
+  int32_t sx = (((int32_t)cfg.srcW << 16) - (int32_t)(s->imgW * step)) / 2 + (int32_t)step / 2 - 32768;
+  s->syQ16 = (((int32_t)cfg.srcH << 16) - (int32_t)(s->imgH * step)) / 2 + (int32_t)step / 2 - 32768;
+
+  uint8_t *p = (uint8_t *)work;
+  s->lines[0] = (uint32_t *)p;
+  p += sizeof(uint32_t) * cfg.dstW;
+  s->lines[1] = (uint32_t *)p;
+  p += sizeof(uint32_t) * cfg.dstW;
+  s->hIdx = (uint16_t *)p;
+  p += align4(sizeof(uint16_t) * cfg.dstW);
+  s->hWt = p;
+  p += align4(cfg.dstW);
+  s->band = (uint16_t *)p;
+  p += align4(sizeof(uint16_t) * cfg.srcW * cfg.bandRows);
+  s->out = (uint16_t *)p;
+
+  for (uint16_t i = 0; i < s->imgW; i++) {
+    sampleAt(sx + (int32_t)(i * step), cfg.srcW, &s->hIdx[i], &s->hWt[i]);
+  }
+  s->srcX0 = s->hIdx[0];
+  s->srcX1 = (uint16_t)(s->hIdx[s->imgW - 1] + 2);
+
+  uint16_t r;
+  uint8_t w;
+  sampleAt(s->syQ16, cfg.srcH, &r, &w);
+  s->srcY0 = r;
+  sampleAt(s->syQ16 + (int32_t)((s->imgH - 1) * step), cfg.srcH, &r, &w);
+  s->srcY1 = (uint16_t)(r + 2);
+
+  s->lastSrcRow = -1;
+  s->doneBandY = -1;
+  return true;
+}
+
+void resampleSourceRect(const ResampleState *s, uint16_t *x, uint16_t *y, uint16_t *w,
+                        uint16_t *h) {
+  *x = s->srcX0;
+  *y = s->srcY0;
+  *w = (uint16_t)(s->srcX1 - s->srcX0);
+  *h = (uint16_t)(s->srcY1 - s->srcY0);
+}
+
+// ============================================
+// Streaming
+// ============================================
+static bool flush(ResampleState *s) {
+  if (!s->outRows) return true;
+  const ResampleConfig &c = s->cfg;
+  uint16_t first = (uint16_t)(s->nextDst - s->outRows);
+  bool ok = s->emit(s->ctx, c.dstX, (int16_t)(c.dstY + first), c.dstW, s->outRows, s->out);
+  s->outRows = 0;
+  return ok;
+}
+
+// Produce box rows until one needs a source row that has not arrived
+static bool produceRows(ResampleState *s) {
+  const ResampleConfig &c = s->cfg;
+  while (s->nextDst < c.dstH) {
+    uint16_t j = s->nextDst;
+    uint16_t *row = s->out + (uint32_t)s->outRows * c.dstW;
+
+    if (j < s->imgY || j >= s->imgY + s->imgH) {
+      memset(row, 0, sizeof(uint16_t) * c.dstW);
+    } else {
+      uint16_t r0;
+      uint8_t w;
+      sampleAt(s->syQ16 + (int32_t)((j - s->imgY) * s->stepQ16), c.srcH, &r0, &w);
+      uint16_t r1 = w ? r0 + 1 : r0;
+      if ((int32_t)r1 > s->lastSrcRow) return true;
+
+      if (s->imgX) memset(row, 0, sizeof(uint16_t) * s->imgX);
+      resampleRowV(s->lines[r0 & 1], s->lines[r1 & 1], w, row + s->imgX, s->imgW, c.swapOut);
+      uint16_t right = (uint16_t)(c.dstW - s->imgX - s->imgW);
+      if (right) memset(row + s->imgX + s->imgW, 0, sizeof(uint16_t) * right);
+    }
+
+    s->nextDst++;
+    if (++s->outRows == c.blockRows && !flush(s)) return false;
+  }
+  return true;
+}
+
+bool resamplePushBlock(ResampleState *s, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                       const uint16_t *px) {
+  const ResampleConfig &c = s->cfg;
+  if (x < 0 || y < 0 || h > c.bandRows) return false;
+  if (y == s->doneBandY || y >= s->srcY1) return true;
+
+  int32_t x0 = x > s->srcX0 ? x : s->srcX0;
+  int32_t x1 = x + w < s->srcX1 ? x + w : s->srcX1;
+  for (uint16_t r = 0; x1 > x0 && r < h; r++) {
+    memcpy(s->band + (uint32_t)r * c.srcW + x0, px + (uint32_t)r * w + (x0 - x),
+           sizeof(uint16_t) * (x1 - x0));
+  }
+  if (x + w < s->srcX1) return true; // band still has blocks to come
+
+  // Band complete: resample its rows horizontally, then emit what they unlock
+  s->doneBandY = y;
+  for (uint16_t r = 0; r < h; r++) {
+    int32_t sr = y + r;
+    if (sr < s->srcY0) continue;
+    if (sr >= s->srcY1) break;
+    resampleRowH(s->band + (uint32_t)r * c.srcW, s->hIdx, s->hWt, s->lines[sr & 1], s->imgW);
+    s->lastSrcRow = sr;
+    if (!produceRows(s)) return false;
+  }
+  return true;
+}
+
+bool resampleFinish(ResampleState *s) {
+  if (!produceRows(s)) return false;
+  return flush(s);
+}
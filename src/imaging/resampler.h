@@ -0,0 +1,91 @@
+// ============================================
+// Streaming RGB565 Resampler - ResearchMate
+// Aspect-correct bilinear scaling of a decoded frame into a target box,
+// fed with the decoder's MCU blocks as they arrive. Memory is one MCU band
+// plus two resampled lines; the frame is never held. Rows come out as
+// full-width blocks of a fixed height.
+//
+// The kernels work on "expanded" pixels, (p | p << 16) & 0x07E0F81F, so
+// one 32-bit multiply-add blends all three channels. Scalar per-channel
+// references with bit-identical results are kept for host tests.
+// ============================================
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum ResampleFit {
+  RESAMPLE_FIT_CROP = 0,     // fill the box, trim the long axis evenly
+  RESAMPLE_FIT_LETTERBOX     // whole frame visible, black bars
+};
+
+// Same shape as the JPEG decoder's block callback.
+typedef bool (*ResampleEmitFn)(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                               uint16_t *pixels);
+
+struct ResampleConfig {
+  uint16_t srcW, srcH;     // decoded frame
+  int16_t dstX, dstY;      // target box, screen coordinates
+  uint16_t dstW, dstH;
+  uint8_t fit;             // ResampleFit
+  uint8_t bandRows;        // tallest input block (MCU height at the decode scale)
+  uint8_t blockRows;       // rows per emitted block; only the last may be shorter
+  bool swapOut;            // emit big-endian RGB565
+};
+
+struct ResampleState {
+  ResampleConfig cfg;
+  uint32_t stepQ16;        // source pixels per output pixel
+  int32_t syQ16;           // source y of the first image row
+  uint16_t imgX, imgY;     // image area inside the box (rest is bars)
+  uint16_t imgW, imgH;
+  uint16_t srcX0, srcX1;   // source columns actually sampled, [x0, x1)
+  uint16_t srcY0, srcY1;   // source rows actually sampled, [y0, y1)
+
+  uint16_t *hIdx;          // per output column: left source column
+  uint8_t *hWt;            // per output column: right weight, 0..32
+  uint16_t *band;          // srcW x bandRows input
+  uint32_t *lines[2];      // horizontally resampled rows (by parity), expanded
+  int32_t lastSrcRow;
+  int32_t doneBandY;       // input band already resampled
+  uint16_t *out;           // dstW x blockRows output block
+  uint16_t outRows;
+  uint16_t nextDst;        // next box row to produce
+
+  ResampleEmitFn emit;
+  void *ctx;
+};
+
+size_t resampleWorkBytes(const ResampleConfig &cfg);
+
+// `work` must hold resampleWorkBytes() bytes and be 4-byte aligned.
+bool resampleInit(ResampleState *s, const ResampleConfig &cfg, void *work, ResampleEmitFn emit,
+                  void *ctx);
+
+// Source rectangle the output depends on, for clipping the decoder.
+void resampleSourceRect(const ResampleState *s, uint16_t *x, uint16_t *y, uint16_t *w,
+                        uint16_t *h);
+
+// Feed one decoded block (native RGB565, frame coordinates). Blocks must
+// arrive in raster order of MCUs; blocks outside the source rect may be
+// omitted.
+bool resamplePushBlock(ResampleState *s, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                       const uint16_t *px);
+
+// Emit what remains (trailing rows, bottom bar, partial block).
+bool resampleFinish(ResampleState *s);
+
+// Kernels. H: n output pixels from src[idx[i]] and src[idx[i] + 1].
+// V: blend two expanded rows with weight w/32 towards b and pack.
+void resampleRowH(const uint16_t *src, const uint16_t *idx, const uint8_t *wt, uint32_t *dst,
+                  int n);
+void resampleRowV(const uint32_t *a, const uint32_t *b, uint8_t w, uint16_t *dst, int n,
+                  bool swap);
+void resampleRowHRef(const uint16_t *src, const uint16_t *idx, const uint8_t *wt, uint32_t *dst,
+                     int n);
+void resampleRowVRef(const uint32_t *a, const uint32_t *b, uint8_t w, uint16_t *dst, int n,
+                     bool swap);
+
+#endif // RESAMPLER_H
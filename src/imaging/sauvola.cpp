@@ -0,0 +1,126 @@
+#include "sauvola.h"
+#include <cstring>
+
+static inline size_t align4(size_t n) { return (n + 3) & ~(size_t)3; }
+
+size_t sauvolaWorkBytes(uint16_t width, uint8_t radius) {
+  size_t window = 2 * (size_t)radius + 1;
+  return 2 * sizeof(uint32_t) * width + align4(window * width) + align4((width + 7) / 8);
+}
+
+bool sauvolaInit(SauvolaState *s, uint16_t width, const SauvolaConfig &cfg,
+                 void *work, BilevelRowFn emit, void *ctx) {
+  if (!work || width == 0 || cfg.range == 0) return false;
+  memset(s, 0, sizeof(*s));
+  s->cfg = cfg;
+  s->width = width;
+  s->window = (uint16_t)(2 * cfg.radius + 1);
+
+  uint8_t *p = (uint8_t *)work;
+  s->colSum = (uint32_t *)p;
+  p += sizeof(uint32_t) * width;
+  s->colSq = (uint32_t *)p;
+  p += sizeof(uint32_t) * width;
+  s->rows = p;
+  p += align4((size_t)s->window * width);
+  s->bits = p;
+
+  memset(s->colSum, 0, sizeof(uint32_t) * width);
+  memset(s->colSq, 0, sizeof(uint32_t) * width);
+  s->emit = emit;
+  s->ctx = ctx;
+  return true;
+}
+
+static inline uint8_t *ringRow(SauvolaState *s, uint32_t y) {
+  return s->rows + (size_t)(y % s->window) * s->width;
+}
+
+static void dropTopRow(SauvolaState *s) {
+  const uint8_t *old = ringRow(s, s->winTop);
+  for (uint16_t x = 0; x < s->width; x++) {
+    s->colSum[x] -= old[x];
+    s->colSq[x] -= (uint32_t)old[x] * old[x];
+  }
+  s->winTop++;
+}
+
+// Threshold row y against the vertical window currently in the column sums.
+// The horizontal window slides across the column sums, so each pixel costs a
+// constant number of adds regardless of radius (an integral image computed
+// one strip at a time).
+static bool emitRow(SauvolaState *s, uint32_t y) {
+  const int r = s->cfg.radius;
+  const int w = s->width;
+  const uint32_t winRows = s->rowsIn - s->winTop;
+  const float k = s->cfg.k100 / 100.0f;
+  const float invR = 1.0f / s->cfg.range;
+  const uint8_t *src = ringRow(s, y);
+
+  uint32_t sum = 0, sq = 0;
+  int lo = 0, hi = -1; // current horizontal span [lo, hi]
+  for (int x = 0; x < r && x < w; x++) {
+    sum += s->colSum[x];
+    sq += s->colSq[x];
+    hi = x;
+  }
+
+  memset(s->bits, 0, (s->width + 7) / 8);
+  for (int x = 0; x < w; x++) {
+    int newHi = x + r < w ? x + r : w - 1;
+    while (hi < newHi) {
+      hi++;
+      sum += s->colSum[hi];
+      sq += s->colSq[hi];
+    }
+    int newLo = x - r > 0 ? x - r : 0;
+    while (lo < newLo) {
+      sum -= s->colSum[lo];
+      sq -= s->colSq[lo];
+      lo++;
+    }
+
+    // T = m * (1 + k * (sd / R - 1)). Rearranged to avoid the sqrt:
+    // ink when p - m(1-k) < (m k / R) * sd.
+    const float n = (float)((hi - lo + 1) * winRows);
+    const float m = sum / n;
+    const float var = sq / n - m * m;
+    const float lhs = src[x] - m * (1.0f - k);
+    const float c = m * k * invR;
+    if (lhs < 0.0f || lhs * lhs < c * c * (var > 0.0f ? var : 0.0f)) {
+      s->bits[x >> 3] |= (uint8_t)(0x80 >> (x & 7));
+    }
+  }
+
+  s->rowsOut++;
+  return s->emit ? s->emit(s->ctx, s->bits) : true;
+}
+
+bool sauvolaPushRow(SauvolaState *s, const uint8_t *luma) {
+  // The slot about to be overwritten holds the row leaving the window
+  if (s->rowsIn - s->winTop == s->window) dropTopRow(s);
+
+  uint8_t *dst = ringRow(s, s->rowsIn);
+  memcpy(dst, luma, s->width);
+  for (uint16_t x = 0; x < s->width; x++) {
+    s->colSum[x] += dst[x];
+    s->colSq[x] += (uint32_t)dst[x] * dst[x];
+  }
+  s->rowsIn++;
+
+  // Row y is final once rows up to y + r are in
+  if (s->rowsIn > s->cfg.radius) {
+    return emitRow(s, s->rowsIn - 1 - s->cfg.radius);
+  }
+  return true;
+}
+
+bool sauvolaFinish(SauvolaState *s) {
+  while (s->rowsOut < s->rowsIn) {
+    uint32_t y = s->rowsOut;
+    // Window for the bottom rows is [y - r, last row]
+    while (s->winTop + s->cfg.radius < y) dropTopRow(s);
+    if (!emitRow(s, y)) return false;
+  }
+  return true;
+}
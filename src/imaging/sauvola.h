@@ -0,0 +1,51 @@
+// ============================================
+// Sauvola Thresholding - ResearchMate
+// Streaming adaptive binarisation for text pages. Rows go in one at a time
+// and come out as packed 1-bit rows `radius` rows later, so memory is a
+// (2*radius+1)-row window plus per-column running sums — never the page.
+// ============================================
+
+#ifndef SAUVOLA_H
+#define SAUVOLA_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Receives one packed row: MSB first, 1 = black (ink), (width+7)/8 bytes.
+typedef bool (*BilevelRowFn)(void *ctx, const uint8_t *bits);
+
+struct SauvolaConfig {
+  uint8_t radius;     // window is (2r+1)^2 pixels, clamped at the borders
+  uint8_t k100;       // Sauvola k x100 (higher = thinner strokes, cleaner paper)
+  uint8_t range;      // R: dynamic range of the local standard deviation
+};
+
+struct SauvolaState {
+  SauvolaConfig cfg;
+  uint16_t width;
+  uint16_t window;     // 2r+1 rows held in the ring
+  uint8_t *rows;       // ring of `window` luma rows
+  uint32_t *colSum;    // per column: sum of luma over the rows in the window
+  uint32_t *colSq;     // per column: sum of luma^2
+  uint8_t *bits;       // output row staging
+  uint32_t rowsIn;
+  uint32_t rowsOut;
+  uint32_t winTop;     // first row index still counted in the column sums
+  BilevelRowFn emit;
+  void *ctx;
+};
+
+// Work buffer size for a given row width and radius.
+size_t sauvolaWorkBytes(uint16_t width, uint8_t radius);
+
+// `work` must hold sauvolaWorkBytes() bytes and be 4-byte aligned.
+bool sauvolaInit(SauvolaState *s, uint16_t width, const SauvolaConfig &cfg,
+                 void *work, BilevelRowFn emit, void *ctx);
+
+// Feed the next luma row (width bytes). May emit one output row.
+bool sauvolaPushRow(SauvolaState *s, const uint8_t *luma);
+
+// Emit the trailing `radius` rows once the last input row is in.
+bool sauvolaFinish(SauvolaState *s);
+
+#endif // SAUVOLA_H
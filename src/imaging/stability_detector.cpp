@@ -0,0 +1,134 @@
+#include "stability_detector.h"
+#include <cstring>
+
+void stabilityInit(StabilityDetector *d, const StabilityConfig &cfg) {
+  memset(d, 0, sizeof(*d));
+  d->cfg = cfg;
+  d->armed = true;
+}
+
+// Page presence + centring: cells brighter than the min/max midpoint are
+// "paper"; their centroid must sit near the middle of the frame.
+static bool pageInView(StabilityDetector *d, const uint8_t *grid) {
+  uint8_t lo = 255, hi = 0;
+  for (int i = 0; i < STABILITY_GRID_CELLS; i++) {
+    if (grid[i] < lo) lo = grid[i];
+    if (grid[i] > hi) hi = grid[i];
+  }
+  if (hi - lo < d->cfg.minContrast) {
+    d->paperPct = 0;
+    d->centreOffPct = 100;
+    return false;
+  }
+
+  uint8_t mid = (uint8_t)((lo + hi) / 2);
+  uint32_t n = 0, sx = 0, sy = 0;
+  for (int y = 0; y < STABILITY_GRID_H; y++) {
+    for (int x = 0; x < STABILITY_GRID_W; x++) {
+      if (grid[y * STABILITY_GRID_W + x] > mid) {
+        n++;
+        sx += x;
+        sy += y;
+      }
+    }
+  }
+  d->paperPct = (uint8_t)(n * 100 / STABILITY_GRID_CELLS);
+  if (n == 0) {
+    d->centreOffPct = 100;
+    return false;
+  }
+
+  // Centroid offset in % of frame size (x2 keeps integer precision)
+  int cx2 = (int)(2 * sx / n) - (STABILITY_GRID_W - 1);
+  int cy2 = (int)(2 * sy / n) - (STABILITY_GRID_H - 1);
+  int offX = (cx2 < 0 ? -cx2 : cx2) * 50 / STABILITY_GRID_W;
+  int offY = (cy2 < 0 ? -cy2 : cy2) * 50 / STABILITY_GRID_H;
+  d->centreOffPct = (uint8_t)(offX > offY ? offX : offY);
+
+  return d->paperPct >= d->cfg.minPaperPct &&
+         d->centreOffPct <= d->cfg.maxCentreOffPct;
+}
+
+bool stabilityUpdate(StabilityDetector *d, const uint8_t *grid,
+                     uint32_t jpegLen, uint32_t nowMs) {
+  d->frames++;
+
+  // Motion: mean absolute cell difference + JPEG size drift
+  uint32_t diff = 0;
+  if (d->havePrev) {
+    for (int i = 0; i < STABILITY_GRID_CELLS; i++) {
+      int v = (int)grid[i] - (int)d->prev[i];
+      diff += (uint32_t)(v < 0 ? -v : v);
+    }
+    diff /= STABILITY_GRID_CELLS;
+  } else {
+    diff = 255;
+  }
+  d->motion = (uint8_t)(diff > 255 ? 255 : diff);
+
+  uint32_t sizeDelta = 100;
+  if (d->prevJpegLen && jpegLen) {
+    uint32_t hi = jpegLen > d->prevJpegLen ? jpegLen : d->prevJpegLen;
+    uint32_t lo = jpegLen > d->prevJpegLen ? d->prevJpegLen : jpegLen;
+    sizeDelta = (hi - lo) * 100 / hi;
+  }
+
+  memcpy(d->prev, grid, STABILITY_GRID_CELLS);
+  d->havePrev = true;
+  d->prevJpegLen = jpegLen;
+
+  bool page = pageInView(d, grid);
+  bool still = d->motion <= d->cfg.maxMotion && sizeDelta <= d->cfg.maxSizeDeltaPct;
+
+  // After a shot, re-arm only once the page leaves or the view differs from
+  // the shot itself. Comparing against the fired scene (not the previous
+  // frame) keeps exposure blips after the UXGA switch from re-triggering on a
+  // page left under the pen.
+  if (!d->armed) {
+    uint32_t sinceShot = 0;
+    for (int i = 0; i < STABILITY_GRID_CELLS; i++) {
+      int v = (int)grid[i] - (int)d->firedGrid[i];
+      sinceShot += (uint32_t)(v < 0 ? -v : v);
+    }
+    sinceShot /= STABILITY_GRID_CELLS;
+    if (!page || sinceShot > d->cfg.rearmDelta) {
+      d->armed = true;
+    } else {
+      d->phase = STAB_FIRED;
+      return false;
+    }
+  }
+
+  if (!page) {
+    d->phase = STAB_NO_PAGE;
+    return false;
+  }
+  if (!still) {
+    d->phase = STAB_MOVING;
+    return false;
+  }
+
+  if (d->phase != STAB_SETTLING) {
+    d->phase = STAB_SETTLING;
+    d->stableSince = nowMs;
+  }
+  if (nowMs - d->stableSince < d->cfg.stableMs) return false;
+  if (d->fires > 0 && nowMs - d->lastFireAt < d->cfg.cooldownMs) return false;
+
+  d->phase = STAB_FIRED;
+  d->armed = false;
+  memcpy(d->firedGrid, grid, STABILITY_GRID_CELLS);
+  d->lastFireAt = nowMs;
+  d->fires++;
+  return true;
+}
+
+const char *stabilityPhaseName(StabilityPhase p) {
+  switch (p) {
+  case STAB_NO_PAGE:  return "no-page";
+  case STAB_MOVING:   return "moving";
+  case STAB_SETTLING: return "settling";
+  case STAB_FIRED:    return "fired";
+  }
+  return "unknown";
+}
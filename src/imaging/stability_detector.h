@@ -0,0 +1,65 @@
+// ============================================
+// Page Stability Detector - ResearchMate
+// Decides when a page is in frame, centred and held still long enough to
+// scan, from the preview stream only. Pure logic: feed it a downsampled
+// luma grid + JPEG size per frame, so recorded streams replay on a host.
+// ============================================
+
+#ifndef STABILITY_DETECTOR_H
+#define STABILITY_DETECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define STABILITY_GRID_W 16
+#define STABILITY_GRID_H 12
+#define STABILITY_GRID_CELLS (STABILITY_GRID_W * STABILITY_GRID_H)
+
+struct StabilityConfig {
+  uint8_t maxMotion;        // mean |dLuma| per cell still counted as "still"
+  uint8_t rearmDelta;       // mean |dLuma| vs the last shot that counts as a new page
+  uint8_t maxSizeDeltaPct;  // JPEG size change still counted as "still"
+  uint8_t minPaperPct;      // share of bright cells needed for "page present"
+  uint8_t maxCentreOffPct;  // paper centroid distance from centre, % of frame
+  uint8_t minContrast;      // max - min cell luma (rejects blank / covered lens)
+  uint16_t stableMs;        // how long the page must be held still
+  uint16_t cooldownMs;      // minimum gap between two shots
+};
+
+enum StabilityPhase {
+  STAB_NO_PAGE = 0,   // nothing page-like in view
+  STAB_MOVING,        // page present but moving / off-centre
+  STAB_SETTLING,      // still, waiting for stableMs
+  STAB_FIRED,         // shot taken; waiting for the scene to change
+};
+
+struct StabilityDetector {
+  StabilityConfig cfg;
+  uint8_t prev[STABILITY_GRID_CELLS];
+  uint8_t firedGrid[STABILITY_GRID_CELLS]; // scene at the last shot
+  bool havePrev;
+  uint32_t prevJpegLen;
+  uint32_t stableSince;
+  uint32_t lastFireAt;
+  bool armed;               // re-armed once the scene differs from firedGrid
+  StabilityPhase phase;
+
+  // Last-frame diagnostics
+  uint8_t motion;
+  uint8_t paperPct;
+  uint8_t centreOffPct;
+
+  // Counters
+  uint32_t frames;
+  uint32_t fires;
+};
+
+void stabilityInit(StabilityDetector *d, const StabilityConfig &cfg);
+
+// Feed one preview frame. Returns true exactly when a capture should fire.
+bool stabilityUpdate(StabilityDetector *d, const uint8_t *grid,
+                     uint32_t jpegLen, uint32_t nowMs);
+
+const char *stabilityPhaseName(StabilityPhase p);
+
+#endif // STABILITY_DETECTOR_H
@@ -4,18 +4,36 @@
 // ============================================
 
 #include "camera/camera.h"
+#include "camera/quality_gate.h"
+#include "capture/bilevel_scan.h"
+#include "capture/burst_session.h"
+#include "capture/document_session.h"
 #include "cloud/cloud.h"
+#include "cloud/cloud_timing.h"
 #include "config.h"
 #include "display/display.h"
+#include "imaging/stability_detector.h"
+#include "net/event_stream.h"
+#include "net/file_stream.h"
+#include "net/http_server.h"
+#include "net/mjpeg_stream.h"
+#include "net/statsd_exporter.h"
+#include "net/tar_export.h"
+#include "net/web_assets.h"
+#include "net/web_jobs.h"
+#include "storage/file_pins.h"
+#include "storage/scan_index.h"
 #include "storage/storage.h"
+#include "storage/thumbnail.h"
+#include "utils/metrics.h"
 #include <Adafruit_NeoPixel.h>
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <WebServer.h>
 #include <WiFi.h>
 #include <WiFiManager.h>
+#include <esp_heap_caps.h>
 
-WebServer server(8080);
+HttpServer server;
 Adafruit_NeoPixel led(1, LED_PIN, NEO_GRB + NEO_KHZ800);
 
 // Global state
@@ -43,166 +61,102 @@ static unsigned long captureButtonPressStart = 0;
 static TaskHandle_t cloudTaskHandle = NULL;
 static bool forceSyncNext = false; // Flag to trigger immediate sync from web app
 static volatile bool pairingJustSucceeded = false; // Set by background task, consumed by main loop
+static volatile bool pairingCodeChanged = false;   // New code from a web job, shown by main loop
+
+// Cloud round trips requested from the web page, run by cloudTask
+enum WebJobKind : uint8_t {
+  WEB_JOB_PAIRING_START = 1,
+  WEB_JOB_UNPAIR = 2,
+};
+static WebJobs webJobs;
+
+// /stream viewers share the preview's camera buffers
+static void streamGiveBack(void *token) { returnFrame((camera_fb_t *)token); }
+static MjpegStream mjpegStream(streamGiveBack);
+
+// Live status for open web pages (/api/events), published from loop()
+static EventStream liveEvents;
+
+// /api/scans/<id> downloads and /api/export, read from SD by the server task
+static FileStream fileStream(&queueFilePins());
+static TarExport queueExport(SD_MOUNT "/queue", &queueFilePins());
+
+// Metrics pushed to a fleet collector, when STATSD_HOST names one
+static StatsdExporter statsd;
+
+// Scan mode: what a short press does
+enum ScanMode {
+  SCAN_MODE_SINGLE = 0, // one gated UXGA capture per press
+  SCAN_MODE_BURST = 1,  // press starts a burst session, next press ends it
+  SCAN_MODE_AUTO = 2,   // hands-free: fire when a page is held still in view
+  SCAN_MODE_DOCUMENT = 3, // each press adds a page to one PDF; long press ends it
+};
+static ScanMode scanMode = SCAN_MODE_SINGLE;
+static bool bilevelOutput = false; // text pages: G4 PDF instead of JPEG
+static BurstTrigger burstTrigger = BURST_TRIGGER_CADENCE;
+static unsigned long lastBurstDisplay = 0;
+
+// Hands-free auto-capture (SCAN_MODE_AUTO)
+static StabilityDetector stability;
+static uint32_t autoProbeUsTotal = 0;   // luma-grid sampling inside the decode
+static uint32_t autoDetectUsTotal = 0;  // detector update
+
+// Pipelined preview (decode + DMA push tasks); false = inline decode in loop()
+static bool previewPipelineOk = false;
+
+static bool previewGrab(const uint8_t **jpg, size_t *len, void **token) {
+  camera_fb_t *fb = captureFrame();
+  if (!fb) return false;
+  mjpegStream.offer(fb->buf, fb->len, fb);
+  *jpg = fb->buf;
+  *len = fb->len;
+  *token = fb;
+  return true;
+}
+
+// Back to the camera once /stream viewers are done with it too
+static void previewRelease(void *token) { mjpegStream.release(token); }
 
 // ============================================
 // Web Handlers (from original project)
 // ============================================
 
+// Web UI (web/index.html): gzipped at build time and sent straight from
+// flash. Browsers revalidate with the ETag, so a reload is usually a 304.
+// Only the gzip copy is in flash; it goes to every client (a few proxies
+// and tools leave Accept-Encoding out but all of them inflate gzip).
 void handleRoot() {
-  String pairingStatus =
-      isPaired
-          ? "<span style='color: #00ff41;'>[OK] Paired</span>"
-          : "<span style='color: #ffd700;'>[!] Waiting for pairing...</span>";
-
-  String pairingCodeHtml = "";
-  if (!isPaired && pairingCode[0]) {
-    pairingCodeHtml =
-        String("<div style='background: #0f3460; padding: 20px; border: 2px "
-               "solid #ffd700; margin: 20px 0; border-radius: 10px;'>") +
-        "<p style='text-align: center; color: #999; font-size: 12px;'>PAIRING "
-        "CODE</p>" +
-        "<p id='pairingCode' style='text-align: center; font-size: 32px; "
-        "font-weight: bold; color: #ffd700; letter-spacing: 10px;'>" +
-        pairingCode + "</p>" +
-        "<p style='text-align: center; color: #999; font-size: 11px;'>Enter "
-        "this code on your ResearchMate website</p>" +
-        "<button class='btn-dark' style='width: 100%; margin-top: 15px;' "
-        "onclick='refreshCode()'>REFRESH CODE</button>" +
-        "</div>";
-  }
-
-  String html = "<!DOCTYPE html><html><head>";
-  html += "<title>ResearchMate Smart Pen</title>";
-  html +=
-      "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-  html += "<style>";
-  html += "body { font-family: Arial, sans-serif; background: #1a1a2e; color: "
-          "#eee; margin: 0; padding: 20px; }";
-  html += ".container { background: #16213e; padding: 30px; border-radius: "
-          "15px; max-width: 700px; margin: 0 auto; }";
-  html += "h1 { color: #00d4ff; text-align: center; }";
-  html += ".subtitle { text-align: center; color: #999; font-size: 12px; }";
-  html += "#camera { width: 100%; border: 2px solid #00d4ff; border-radius: "
-          "10px; margin: 20px 0; background: #000; }";
-  html += ".buttons { display: grid; grid-template-columns: 1fr 1fr; gap: "
-          "10px; margin: 20px 0; }";
-  html += "button { padding: 12px; font-weight: bold; cursor: pointer; border: "
-          "none; border-radius: 5px; font-size: 14px; }";
-  html += ".btn-cyan { background: #00d4ff; color: #000; }";
-  html += ".btn-green { background: #00ff41; color: #000; }";
-  html += ".btn-dark { background: #0f3460; color: #fff; border: 2px solid "
-          "#00d4ff; }";
-  html += ".btn-red { background: #ff6b6b; color: #fff; }";
-  html += ".btn-orange { background: #ffd700; color: #000; }";
-  html +=
-      ".btn-purple { background: #9d4edd; color: #fff; grid-column: 1 / -1; }";
-  html +=
-      ".status { background: #0f3460; padding: 15px; border-left: 4px solid "
-      "#00ff41; border-radius: 5px; margin: 20px 0; text-align: center; }";
-  html += ".status.unpaired { border-left: 4px solid #ffd700; }";
-  html += "#uploadStatus { margin-top: 20px; padding: 15px; border-radius: "
-          "5px; background: #0f3460; color: #999; text-align: center; "
-          "font-size: 12px; display: none; }";
-  html += "</style></head><body>";
-
-  html += "<div class='container'>";
-  html += "<h1>ResearchMate Smart Pen</h1>";
-  html += "<p class='subtitle'>OV2640 Camera + TFT Display</p>";
-
-  if (isPaired) {
-    html += "<div class='status'>[OK] Connected - " + pairingStatus +
-            " <button class='btn-dark' style='padding: 5px 15px; margin-left: "
-            "10px; font-size: 11px;' onclick='unpair()'>UNPAIR</button></div>";
-  } else {
-    html +=
-        "<div class='status unpaired'>[PAIRING] " + pairingStatus + "</div>";
-  }
-
-  html += pairingCodeHtml;
-  html += "<img id='camera' src='/capture' alt='Camera Feed'>";
-
-  html += "<div class='buttons'>";
-  html +=
-      "<button class='btn-cyan' onclick='capture()'>CAPTURE PREVIEW</button>";
-  html += "<button class='btn-purple' id='uploadBtn' onclick='upload()'>UPLOAD "
-          "TO CLOUD</button>";
-  html += "</div>";
-
-  html += "<div id='uploadStatus'></div>";
-
-  // --- [TO BE REMOVED LATER] VIRTUAL LCD START ---
-  html += "<div id='virtualLcd' style='background: #111; border: 2px solid "
-          "#333; padding: 15px; border-radius: 8px; font-family: monospace; "
-          "color: #00d4ff; margin-top: 20px;'>";
-  html += "<div>STATUS: <span id='lcdStatus' style='font-weight:bold; color: "
-          "#fff;'>Ready</span></div>";
-  html += "<div>UPLOADS: <span id='lcdCount'>0</span></div>";
-  html += "<div>LAST CAPTURE: <span id='lcdTime'>Never</span></div>";
-  html += "</div>";
-  // --- [TO BE REMOVED LATER] VIRTUAL LCD END ---
-
-  html += "<script>";
-  html += "var isPaired = " + String(isPaired ? "true" : "false") + ";";
-
-  html += "function capture() { document.getElementById('camera').src = "
-          "'/capture?t=' + Date.now(); }";
-
-  html += "function upload() {";
-  html +=
-      "  if (!isPaired) { showStatus('Not paired yet!', 'error'); return; }";
-  html += "  document.getElementById('uploadBtn').disabled = true;";
-  html += "  showStatus('Uploading...', 'pending');";
-  html += "  fetch('/api/upload', { method: 'POST' })";
-  html += "    .then(r => r.json())";
-  html += "    .then(data => {";
-  html +=
-      "      if (data.success) { showStatus('[OK] Uploaded!', 'success'); }";
-  html += "      else { showStatus('[X] Failed: ' + data.error, 'error'); }";
-  html += "      document.getElementById('uploadBtn').disabled = false;";
-  html += "    });";
-  html += "}";
-
-  html += "function showStatus(msg, type) {";
-  html += "  var el = document.getElementById('uploadStatus');";
-  html += "  el.textContent = msg;";
-  html += "  el.style.display = 'block';";
-  html += "  setTimeout(() => { el.style.display = 'none'; }, 5000);";
-  html += "}";
-
-  html += "function checkPairing() { if (!isPaired) { "
-          "fetch('/api/pairing-status').then(r => r.json()).then(data => { if "
-          "(data.paired) { location.reload(); } }); } }";
-  html +=
-      "function refreshCode() { fetch('/api/pairing-start', { method: 'POST' "
-      "}).then(r => r.json()).then(data => { if (data.success) { "
-      "document.getElementById('pairingCode').textContent = data.code; } }); }";
-  html +=
-      "function unpair() { if (!confirm('Unpair?')) return; "
-      "fetch('/api/unpair', { method: 'POST' }).then(r => r.json()).then(data "
-      "=> { if (data.success) { location.reload(); } }); }";
-
-  html += "capture();";
-  html += "if (!isPaired) setInterval(checkPairing, 5000);";
-
-  // --- [TO BE REMOVED LATER] VIRTUAL LCD JS START ---
-  html += "function updateVirtualLcd() {";
-  html += "  fetch('/api/status').then(r => r.json()).then(data => {";
-  html +=
-      "    document.getElementById('lcdStatus').textContent = data.lastStatus;";
-  html +=
-      "    document.getElementById('lcdCount').textContent = data.totalItems;";
-  html += "    if(data.secondsSinceLastCapture > 0) {";
-  html += "       document.getElementById('lcdTime').textContent = "
-          "data.secondsSinceLastCapture + ' sec ago';";
-  html += "    }";
-  html += "  }).catch(e => console.error(e));";
-  html += "}";
-  html += "setInterval(updateVirtualLcd, 2000);"; // Poll every 2 seconds
-  // --- [TO BE REMOVED LATER] VIRTUAL LCD JS END ---
-
-  html += "</script></body></html>";
-
-  server.send(200, "text/html", html);
+  const WebAsset *page = findWebAsset("/");
+  if (!page) {
+    server.send(404, "text/plain", "Web UI not built in");
+    return;
+  }
+  server.sendHeader("ETag", page->etag);
+  server.sendHeader("Vary", "Accept-Encoding");
+  server.sendHeader("Cache-Control", "no-cache");
+  if (strstr(server.header("If-None-Match").c_str(), page->etag)) {
+    server.send(304, page->contentType, "");
+    return;
+  }
+  server.sendHeader("Content-Encoding", "gzip");
+  server.sendStatic(200, page->contentType, page->gz, page->gzLen);
+}
+
+// Everything on the page that changes at run time. The page is told of
+// changes on /api/events; it polls this every 2s only when that is refused.
+void handleState() {
+  JsonDocument doc;
+  doc["paired"] = isPaired;
+  if (!isPaired && pairingCode[0]) doc["pairingCode"] = pairingCode;
+  doc["totalItems"] = totalItemsUploaded;
+  doc["lastStatus"] = lastCaptureStatus;
+  doc["secondsSinceLastCapture"] =
+      lastCaptureTimestamp > 0 ? (millis() - lastCaptureTimestamp) / 1000 : 0;
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Cache-Control", "no-store");
+  server.send(200, "application/json", response);
 }
 
 void handleCapture() {
@@ -223,21 +177,91 @@ void handleCapture() {
     return;
   }
 
-  WiFiClient client = server.client();
-  String response = "HTTP/1.1 200 OK\r\n";
-  response += "Content-Type: image/jpeg\r\n";
-  response += "Content-Length: " + String(fb->len) + "\r\n";
-  response += "Access-Control-Allow-Origin: *\r\n";
-  response += "Connection: close\r\n";
-  response += "\r\n";
-
-  client.print(response);
-  client.write(fb->buf, fb->len);
+  // Copied into the response, so the frame goes back to the camera now
+  // rather than after the client has read it
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "image/jpeg", fb->buf, fb->len);
 
   returnFrame(fb);
   Serial.println("[Web] Served /capture successfully");
 }
 
+// Document mode: append the captured frame to the open PDF instead of
+// queueing it as a standalone JPEG.
+static void handleDocumentPage(camera_fb_t *fb, bool accepted) {
+  setLastAction("Adding page...", false);
+  drawBottomPanel();
+  bool ok = docAddPage(fb->buf, fb->len, bilevelOutput);
+  returnFrame(fb);
+
+  setImageResolution(FRAMESIZE_QVGA);
+  setImageQuality(12);
+
+  char msg[32];
+  if (ok) {
+    snprintf(msg, sizeof(msg), accepted ? "Page %lu added" : "Page %lu (retake?)",
+             (unsigned long)docPageCount());
+    setLastAction(msg, !accepted);
+    led.setPixelColor(0, accepted ? led.Color(0, 255, 0) : led.Color(255, 165, 0));
+  } else {
+    setLastAction("PDF Write Error", true);
+    led.setPixelColor(0, led.Color(255, 0, 0));
+  }
+  drawBottomPanel();
+  led.show();
+  vTaskDelay(pdMS_TO_TICKS(500));
+  displayReady();
+}
+
+// Close the open document and hand it to the upload queue
+static void finishDocument() {
+  uint32_t pages = docPageCount();
+  String queued = docEnd();
+  char msg[32];
+  if (queued.length() > 0) {
+    Serial.printf("[Doc] Queued offline: %s\n", queued.c_str());
+    snprintf(msg, sizeof(msg), "Doc queued (%lu p)", (unsigned long)pages);
+    setLastAction(msg, false);
+    totalItemsUploaded++; // one queue item per document
+    setQueueCount(totalItemsUploaded);
+  } else {
+    setLastAction(pages ? "Doc Save Error" : "Doc Empty", true);
+  }
+  drawBottomPanel();
+}
+
+// Review screen: the scan stays up until a long press, /api/review or the
+// timeout sends the user back to the live preview
+static unsigned long reviewTouchedMs = 0;
+
+static void closeReview() {
+  displayReviewEnd();
+  displayReady();
+  livePreviewActive = true;
+  Serial.println("[Display] Resumed Live Preview");
+}
+
+// Gallery of queued scans: opened from /api/gallery, closed by a long
+// press, /api/gallery or the timeout
+static unsigned long galleryTouchedMs = 0;
+
+static bool openGallery() {
+  displayPreviewSuspend();
+  if (displayReviewActive()) closeReview();
+  if (!initSDCard() || !displayGalleryOpen(queueScanIndex(), queueGalleryStore())) return false;
+  livePreviewActive = false;
+  galleryTouchedMs = millis();
+  Serial.println("[Gallery] Press: next scan, hold: back to preview");
+  return true;
+}
+
+static void closeGallery() {
+  displayGalleryEnd();
+  displayReady();
+  livePreviewActive = true;
+  Serial.println("[Display] Resumed Live Preview");
+}
+
 void handleSDCapture() {
   Serial.println("[Capture] Acquiring frame for SD Card...");
 
@@ -245,10 +269,12 @@ void handleSDCapture() {
   setLastAction("Scanning...", false);
   drawBottomPanel();
 
-  // Capture at UXGA with proper stabilization (drains queue, waits for AEC/AWB)
-  camera_fb_t *fb = captureHighRes();
+  // Capture at UXGA with proper stabilization (drains queue, waits for AEC/AWB),
+  // retrying until the frame passes the quality gate or the budget runs out.
+  CaptureGateReport gate;
+  camera_fb_t *fb = captureGatedHighRes(&gate);
   if (!fb) {
-    Serial.println("[ERROR] SD Capture Failed: No frame available.");
+    Serial.printf("[ERROR] SD Capture Failed: no valid frame (%s).\n", gate.reason);
     setLastAction("Capture Error", true);
     drawBottomPanel();
     setImageResolution(FRAMESIZE_QVGA);
@@ -269,10 +295,22 @@ void handleSDCapture() {
     return;
   }
 
+  if (scanMode == SCAN_MODE_DOCUMENT) {
+    handleDocumentPage(fb, gate.accepted);
+    return;
+  }
+
   setLastAction("Saving...", false);
   drawBottomPanel();
   Serial.printf("[Capture] Saving %u bytes to SD...\n", fb->len);
-  String filename = saveImageToSD(fb->buf, fb->len);
+  String filename = bilevelOutput ? saveBilevelScanToSD(fb->buf, fb->len)
+                                  : saveImageToSD(fb->buf, fb->len);
+  // Gallery thumbnail from the frame in hand, so the gallery never decodes a scan
+  if (filename.length() > 0) saveThumbnailToSD(filename, fb->buf, fb->len);
+  // Show the scan for checking before the frame goes back (the display copies it)
+  if (REVIEW_AFTER_CAPTURE && filename.length() > 0 && displayReviewBegin(fb->buf, fb->len)) {
+    reviewTouchedMs = millis();
+  }
   returnFrame(fb);
 
   // Restore preview state after capture
@@ -281,12 +319,14 @@ void handleSDCapture() {
 
   if (filename.length() > 0) {
     Serial.printf("[Upload] Queued offline: %s\n", filename.c_str());
-    setLastAction("Saved to SD", false);
+    // Best-effort frames are still saved, but tell the user to re-scan.
+    setLastAction(gate.accepted ? "Saved to SD" : "Saved (retake?)", !gate.accepted);
     totalItemsUploaded++; // Count as handled
     setQueueCount(totalItemsUploaded);
     drawBottomPanel();
 
-    led.setPixelColor(0, led.Color(0, 255, 0)); // Green blink
+    // Green blink, orange when the gate gave up on a clean frame
+    led.setPixelColor(0, gate.accepted ? led.Color(0, 255, 0) : led.Color(255, 165, 0));
     led.show();
     // Non-blocking wait for LED feedback
     vTaskDelay(pdMS_TO_TICKS(500)); 
@@ -302,7 +342,8 @@ void handleSDCapture() {
   }
 
   // CRITICAL: Always return display to READY state to clear "Capturing..."
-  displayReady();
+  // (the review screen already replaced it)
+  if (!displayReviewActive()) displayReady();
 }
 
 void handleUpload() {
@@ -327,7 +368,6 @@ void handleUpload() {
       
       led.setPixelColor(0, led.Color(255, 0, 0));
       led.show();
-      delay(1000);
       return;
   }
   
@@ -337,6 +377,7 @@ void handleUpload() {
 
   // Call the core sync logic - via flag to background task!
   forceSyncNext = true;
+  if (cloudTaskHandle) xTaskNotifyGive(cloudTaskHandle);
 
   // We have no immediate return value from syncPendingQueue() to send a specific HTTP response
   // so we'll just return a generic OK. The device UI handles the true status natively.
@@ -348,7 +389,6 @@ void handleUpload() {
   server.send(200, "application/json", responseStr);
 
   // The LED reset is handled in syncPendingQueue upon success, or falling back inside loop()
-  delay(500);
 }
 
 // --- [TO BE REMOVED LATER] VIRTUAL LCD ENDPOINT START ---
@@ -371,44 +411,382 @@ void handleStatus() {
 }
 // --- [TO BE REMOVED LATER] VIRTUAL LCD ENDPOINT END ---
 
-void handlePairingStart() {
-  char *code = startPairing(&pairingCodeExpiry);
+static const char *scanModeName(ScanMode m) {
+  switch (m) {
+  case SCAN_MODE_BURST: return "burst";
+  case SCAN_MODE_AUTO:  return "auto";
+  case SCAN_MODE_DOCUMENT: return "document";
+  default:              return "single";
+  }
+}
+
+static void resetAutoCapture() {
+  StabilityConfig cfg = {AUTO_MAX_MOTION,    AUTO_REARM_DELTA,  AUTO_MAX_SIZE_DELTA_PCT,
+                         AUTO_MIN_PAPER_PCT, AUTO_MAX_CENTRE_OFF_PCT, AUTO_MIN_CONTRAST,
+                         AUTO_STABLE_MS,     AUTO_COOLDOWN_MS};
+  stabilityInit(&stability, cfg);
+  autoProbeUsTotal = autoDetectUsTotal = 0;
+  displaySetLumaProbe(scanMode == SCAN_MODE_AUTO);
+}
+
+// GET: current mode. POST ?mode=single|burst|auto|document
+//   [&trigger=cadence|change][&format=jpeg|bilevel]
+void handleScanMode() {
+  if (server.method() == HTTP_POST) {
+    String mode = server.arg("mode");
+    if (burstState() != BURST_IDLE) {
+      server.send(409, "application/json", "{\"error\":\"burst session active\"}");
+      return;
+    }
+    if (mode == "single") scanMode = SCAN_MODE_SINGLE;
+    else if (mode == "burst") scanMode = SCAN_MODE_BURST;
+    else if (mode == "auto") scanMode = SCAN_MODE_AUTO;
+    else if (mode == "document") scanMode = SCAN_MODE_DOCUMENT;
+    else {
+      server.send(400, "application/json", "{\"error\":\"unknown mode\"}");
+      return;
+    }
+    // Leaving document mode closes the open document rather than losing it
+    if (scanMode != SCAN_MODE_DOCUMENT && docActive()) finishDocument();
+    if (server.hasArg("format")) bilevelOutput = server.arg("format") == "bilevel";
+    if (server.hasArg("trigger")) {
+      burstTrigger = server.arg("trigger") == "change" ? BURST_TRIGGER_CHANGE
+                                                       : BURST_TRIGGER_CADENCE;
+    }
+    resetAutoCapture();
+    Serial.printf("[Mode] Scan mode -> %s\n", scanModeName(scanMode));
+  }
 
   JsonDocument doc;
-  if (code) {
-    doc["success"] = true;
-    doc["code"] = code;
-    strncpy(pairingCode, code, sizeof(pairingCode) - 1);
-    pairingCodeTimestamp = millis();
-    doc["expires_in"] = pairingCodeExpiry / 1000;
-    displayPairingCode(pairingCode);
-  } else {
-    doc["success"] = false;
-    doc["error"] = "Failed to generate code";
+  doc["mode"] = scanModeName(scanMode);
+  doc["trigger"] = burstTrigger == BURST_TRIGGER_CHANGE ? "change" : "cadence";
+  doc["format"] = bilevelOutput ? "bilevel" : "jpeg";
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Live / last burst session counters
+void handleBurstStats() {
+  BurstStats st;
+  getBurstStats(&st);
+
+  JsonDocument doc;
+  doc["active"] = burstState() != BURST_IDLE;
+  doc["framesGrabbed"] = st.framesGrabbed;
+  doc["pagesCaptured"] = st.pagesCaptured;
+  doc["pagesWritten"] = st.pagesWritten;
+  doc["dropped"] = st.dropped;
+  doc["rejected"] = st.rejected;
+  doc["writeErrors"] = st.writeErrors;
+  doc["bytesWritten"] = st.bytesWritten;
+  doc["ringCapacity"] = st.ringCapacity;
+  doc["ringUsed"] = st.ringUsed;
+  doc["ringPending"] = st.ringPending;
+  doc["maxWriteMs"] = st.maxWriteMs;
+  doc["elapsedMs"] = st.elapsedMs;
+  doc["pagesPerMinute"] = st.pagesPerMinute;
+  doc["dropRatePct"] = st.framesGrabbed ? st.dropped * 100 / st.framesGrabbed : 0;
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "application/json", response);
+}
+
+// GET: open document status. POST ?action=end closes and queues it.
+void handleDocument() {
+  if (server.method() == HTTP_POST) {
+    if (server.arg("action") != "end") {
+      server.send(400, "application/json", "{\"error\":\"unknown action\"}");
+      return;
+    }
+    if (!docActive()) {
+      server.send(409, "application/json", "{\"error\":\"no open document\"}");
+      return;
+    }
+    finishDocument();
   }
 
+  JsonDocument doc;
+  doc["enabled"] = scanMode == SCAN_MODE_DOCUMENT;
+  doc["active"] = docActive();
+  doc["pages"] = docPageCount();
+  doc["bytes"] = docSizeBytes();
+  doc["path"] = docPath();
+
   String response;
   serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
   server.send(200, "application/json", response);
 }
 
-void handlePairingStatus() {
+// Auto-capture detector state and cost per preview frame
+void handleAutoCaptureStats() {
   JsonDocument doc;
-  if (pairingCode[0] != '\0') {
-    char *token = checkPairingStatus(pairingCode);
-    if (token) {
-      isPaired = true;
-      doc["paired"] = true;
-      displayReady();
-      led.setPixelColor(0, led.Color(0, 255, 0));
-      led.show();
+  doc["enabled"] = scanMode == SCAN_MODE_AUTO;
+  doc["phase"] = stabilityPhaseName(stability.phase);
+  doc["frames"] = stability.frames;
+  doc["fires"] = stability.fires;
+  doc["motion"] = stability.motion;
+  doc["paperPct"] = stability.paperPct;
+  doc["centreOffPct"] = stability.centreOffPct;
+  doc["avgProbeUs"] = stability.frames ? autoProbeUsTotal / stability.frames : 0;
+  doc["avgDetectUs"] = stability.frames ? autoDetectUsTotal / stability.frames : 0;
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "application/json", response);
+}
+
+// Preview pipeline throughput and per-stage cost
+// POST fit=crop|letterbox, fps=1..30, overlay=0|1, peaking=0|1
+void handlePreviewStats() {
+  if (server.method() == HTTP_POST && server.hasArg("fit")) {
+    String fit = server.arg("fit");
+    if (fit != "crop" && fit != "letterbox") {
+      server.send(400, "application/json", "{\"error\":\"unknown fit\"}");
+      return;
+    }
+    displaySetPreviewFit(fit == "letterbox");
+  }
+  if (server.method() == HTTP_POST && server.hasArg("fps")) {
+    int fps = server.arg("fps").toInt();
+    if (fps < 1 || fps > 30) {
+      server.send(400, "application/json", "{\"error\":\"fps must be 1-30\"}");
+      return;
+    }
+    displaySetPreviewFps((uint8_t)fps);
+  }
+  if (server.method() == HTTP_POST && server.hasArg("overlay")) {
+    displaySetPerfOverlay(server.arg("overlay") == "1");
+  }
+  if (server.method() == HTTP_POST && server.hasArg("peaking")) {
+    displaySetFocusPeaking(server.arg("peaking") == "1");
+  }
+
+  PreviewStats st;
+  displayGetPreviewStats(&st);
+
+  JsonDocument doc;
+  doc["pipelined"] = previewPipelineOk;
+  doc["running"] = st.running;
+  doc["frames"] = st.frames;
+  doc["fps"] = st.fpsX10 / 10.0f;
+  doc["grabUs"] = st.grabUs;
+  doc["decodeUs"] = st.decodeUs;
+  doc["stallUs"] = st.stallUs;
+  doc["pushUs"] = st.pushUs;
+  doc["latencyUs"] = st.latencyUs;
+  doc["txPerFrame"] = st.txPerFrame;
+  doc["bytesPerFrame"] = st.bytesPerFrame;
+  doc["bufferRows"] = st.bufferRows;
+  doc["mcusDecoded"] = st.mcusDecoded;
+  doc["mcusSkipped"] = st.mcusSkipped;
+  doc["scaleUs"] = st.scaleUs;
+  doc["peaking"] = displayFocusPeaking();
+  doc["peakUs"] = st.peakUs;
+  doc["peakPct"] = st.peakPct;
+  doc["framesSkipped"] = st.framesSkipped;
+  doc["skipPct"] = st.skipPct;
+  doc["detectUs"] = st.detectUs;
+  doc["savedCorePct"] = st.savedCorePct;
+  doc["fit"] = displayPreviewLetterbox() ? "letterbox" : "crop";
+  doc["inputFps"] = st.inputFpsX10 / 10.0f;
+  doc["targetFps"] = st.targetFps;
+  doc["capFps"] = st.capFps;
+  doc["yieldPct"] = st.yieldPct;
+  doc["busyEvents"] = st.busyEvents;
+  doc["rateCuts"] = st.rateCuts;
+  doc["overlay"] = displayPerfOverlay();
+  JsonObject cpu = doc["cpuPct"].to<JsonObject>();
+  cpu[String("core") + st.decodeCore + "_decode"] = st.decodeCorePct;
+  cpu[String("core") + st.pushCore + "_push"] = st.pushCorePct;
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "application/json", response);
+}
+
+// Scan review view + tile cache; POST zoom=0..3, x, y (view centre,
+// full-resolution pixels), close=1
+void handleReview() {
+  if (server.method() == HTTP_POST) {
+    if (!displayReviewActive()) {
+      server.send(409, "application/json", "{\"error\":\"no review open\"}");
+      return;
+    }
+    if (server.hasArg("close")) {
+      closeReview();
     } else {
-      doc["paired"] = false;
+      ReviewStats cur;
+      displayGetReviewStats(&cur);
+      int zoom = server.hasArg("zoom") ? server.arg("zoom").toInt() : cur.zoom;
+      if (zoom < 0 || zoom > 3) {
+        server.send(400, "application/json", "{\"error\":\"zoom must be 0-3\"}");
+        return;
+      }
+      int32_t x = server.hasArg("x") ? server.arg("x").toInt() : cur.cx;
+      int32_t y = server.hasArg("y") ? server.arg("y").toInt() : cur.cy;
+      displayReviewView((uint8_t)zoom, x, y);
+      reviewTouchedMs = millis();
+    }
+  }
+
+  ReviewStats st;
+  displayGetReviewStats(&st);
+  static const char *const scaleNames[] = {"fit", "1/4", "1/2", "1/1"};
+
+  JsonDocument doc;
+  doc["active"] = st.active;
+  doc["zoom"] = st.zoom;
+  doc["scale"] = scaleNames[st.zoom];
+  doc["x"] = st.cx;
+  doc["y"] = st.cy;
+  doc["width"] = st.imageW;
+  doc["height"] = st.imageH;
+  doc["fitUs"] = st.fitUs;
+  doc["views"] = st.views;
+  doc["viewUs"] = st.viewUs;
+  doc["decodeUs"] = st.decodeUs;
+  doc["tilesNeeded"] = st.tilesNeeded;
+  doc["tilesHit"] = st.tilesHit;
+  doc["hitPct"] = st.hitPct;
+  doc["cacheTiles"] = st.cacheTiles;
+  doc["evictions"] = st.evictions;
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "application/json", response);
+}
+
+// Gallery of queued scans; POST open=1, scroll=N (entries, +/-), select=i,
+// close=1
+void handleGallery() {
+  if (server.method() == HTTP_POST) {
+    if (server.hasArg("open")) {
+      if (burstState() != BURST_IDLE) {
+        server.send(409, "application/json", "{\"error\":\"burst session active\"}");
+        return;
+      }
+      if (!openGallery()) {
+        server.send(503, "application/json", "{\"error\":\"queue not readable\"}");
+        return;
+      }
+    } else if (!displayGalleryActive()) {
+      server.send(409, "application/json", "{\"error\":\"no gallery open\"}");
+      return;
+    } else if (server.hasArg("close")) {
+      closeGallery();
+    } else {
+      if (server.hasArg("select")) displayGallerySelect((uint16_t)server.arg("select").toInt());
+      if (server.hasArg("scroll")) displayGalleryScroll(server.arg("scroll").toInt());
+      galleryTouchedMs = millis();
     }
-  } else {
-    doc["paired"] = false;
   }
 
+  GalleryViewStats st;
+  displayGetGalleryStats(&st);
+
+  JsonDocument doc;
+  doc["active"] = st.active;
+  doc["entries"] = st.entries;
+  doc["withThumb"] = st.withThumb;
+  doc["dropped"] = st.dropped;
+  doc["selected"] = st.selected;
+  doc["name"] = st.selectedName;
+  doc["indexUs"] = st.indexUs;
+  doc["openUs"] = st.openUs;
+  doc["paints"] = st.paints;
+  doc["paintUs"] = st.paintUs;
+  doc["thumbsLoaded"] = st.thumbsLoaded;
+  doc["lookups"] = st.lookups;
+  doc["loads"] = st.loads;
+  doc["failures"] = st.failures;
+  doc["hitPct"] = st.hitPct;
+  doc["cacheThumbs"] = st.cacheThumbs;
+  doc["evictions"] = st.evictions;
+  doc["bytesRead"] = st.bytesRead;
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "application/json", response);
+}
+
+// Quality gate decisions + cost for the most recent captures (newest first)
+void handleCaptureStats() {
+  CaptureGateReport reports[8];
+  size_t n = getRecentGateReports(reports, 8);
+
+  JsonDocument doc;
+  JsonArray arr = doc["captures"].to<JsonArray>();
+  for (size_t i = 0; i < n; i++) {
+    const CaptureGateReport &r = reports[i];
+    JsonObject o = arr.add<JsonObject>();
+    o["ageSec"] = (millis() - r.timestamp) / 1000;
+    o["accepted"] = r.accepted;
+    o["reason"] = r.reason;
+    o["attempts"] = r.attempts;
+    o["structure"] = jpegScanResultName(r.structure);
+    o["bytes"] = r.frameBytes;
+    o["meanLuma"] = r.metrics.meanLuma;
+    o["p5"] = r.metrics.p5;
+    o["p95"] = r.metrics.p95;
+    o["darkPct"] = r.metrics.darkPct;
+    o["brightPct"] = r.metrics.brightPct;
+    o["sharpness"] = r.metrics.sharpness;
+    o["densityMbpp"] = r.metrics.densityMbpp;
+    o["scanUs"] = r.scanUs;
+    o["analyzeUs"] = r.analyzeUs;
+    o["totalMs"] = r.totalMs;
+  }
+
+  BilevelStats bl;
+  if (getLastBilevelStats(&bl)) {
+    JsonObject o = doc["bilevel"].to<JsonObject>();
+    o["ageSec"] = (millis() - bl.timestamp) / 1000;
+    o["ok"] = bl.ok;
+    o["width"] = bl.width;
+    o["height"] = bl.height;
+    o["jpegBytes"] = bl.jpegBytes;
+    o["g4Bytes"] = bl.g4Bytes;
+    o["totalMs"] = bl.totalMs;
+  }
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "application/json", response);
+}
+
+// Answer a cloud round trip with 202 and the job that runs it on cloudTask
+static void sendJobAccepted(uint32_t id) {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  if (!id) {
+    server.send(503, "application/json", "{\"error\":\"too many jobs\"}");
+    return;
+  }
+  if (cloudTaskHandle) xTaskNotifyGive(cloudTaskHandle);
+  server.sendHeader("Location", String("/api/jobs?id=") + String((unsigned long)id));
+  JsonDocument doc;
+  doc["job"] = id;
+  doc["state"] = "pending";
+  String response;
+  serializeJson(doc, response);
+  server.send(202, "application/json", response);
+}
+
+void handlePairingStart() { sendJobAccepted(webJobs.submit(WEB_JOB_PAIRING_START, millis())); }
+
+// cloudTask polls the pairing state every round; report what it last saw
+void handlePairingStatus() {
+  JsonDocument doc;
+  doc["paired"] = isPaired;
+
   String response;
   serializeJson(doc, response);
   server.send(200, "application/json", response);
@@ -420,22 +798,544 @@ void handleUnpair() {
   pairingCode[0] = '\0';
   pairingCodeTimestamp = 0;
 
-  char *code = startPairing(&pairingCodeExpiry);
+  led.setPixelColor(0, led.Color(255, 165, 0));
+  led.show();
 
+  // The new code comes from the server: fetched by the job
+  sendJobAccepted(webJobs.submit(WEB_JOB_UNPAIR, millis()));
+}
+
+void handleJobs() {
+  WebJobInfo job;
+  if (!server.hasArg("id") ||
+      !webJobs.get((uint32_t)server.arg("id").toInt(), millis(), &job)) {
+    server.send(404, "application/json", "{\"error\":\"unknown job\"}");
+    return;
+  }
   JsonDocument doc;
-  doc["success"] = true;
-  if (code) {
-    strncpy(pairingCode, code, sizeof(pairingCode) - 1);
-    doc["new_code"] = code;
-    displayPairingCode(pairingCode);
+  doc["id"] = job.id;
+  doc["state"] = webJobStateName(job.state);
+  doc["waitMs"] = job.waitMs;
+  doc["runMs"] = job.runMs;
+  if (job.result[0]) doc["result"] = serialized(job.result);
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "application/json", response);
+}
+
+// cloudTask: request a pairing code for a web job. Unpair keeps a code the
+// task already fetched on its own since the unpair.
+static void runWebJob(uint32_t id, uint8_t kind) {
+  char *code = nullptr;
+  if (kind == WEB_JOB_UNPAIR && pairingCode[0] != '\0') {
+    code = pairingCode;
+  } else {
+    code = startPairing(&pairingCodeExpiry);
   }
+  bool ok = code && code[0] != '\0';
+
+  JsonDocument doc;
+  if (ok) {
+    if (code != pairingCode) strncpy(pairingCode, code, sizeof(pairingCode) - 1);
+    pairingCodeTimestamp = millis();
+    pairingCodeChanged = true; // shown by the main loop
+    doc["success"] = true;
+    doc[kind == WEB_JOB_UNPAIR ? "new_code" : "code"] = pairingCode;
+    doc["expires_in"] = pairingCodeExpiry / 1000;
+  } else if (kind == WEB_JOB_UNPAIR) {
+    doc["success"] = true; // unpaired; a code follows from the next round
+  } else {
+    doc["success"] = false;
+    doc["error"] = "Failed to generate code";
+  }
+  char result[WEB_JOB_RESULT_MAX];
+  serializeJson(doc, result, sizeof(result));
+  webJobs.finish(id, ok || kind == WEB_JOB_UNPAIR, result, millis());
+}
+
+void handleServerStats() {
+  HttpServerStats st;
+  server.getStats(&st);
+  JsonDocument doc;
+  doc["requests"] = st.requests;
+  doc["notFound"] = st.notFound;
+  doc["rejected"] = st.rejected;
+  doc["timeouts"] = st.timeouts;
+  doc["noMemory"] = st.noMemory;
+  doc["streamsFull"] = st.streamsFull;
+  doc["active"] = st.active;
+  doc["streaming"] = st.streaming;
+  doc["peakActive"] = st.peakActive;
+  doc["maxClients"] = HTTP_MAX_CLIENTS;
+  doc["queueUs"] = st.queueUs;
+  doc["queueUsMax"] = st.queueUsMax;
+  doc["handlerUs"] = st.handlerUs;
+  doc["handlerUsMax"] = st.handlerUsMax;
+  doc["totalUs"] = st.totalUs;
+  doc["totalUsAvg"] = st.totalUsAvg;
+  doc["totalUsMax"] = st.totalUsMax;
+  doc["bytesOut"] = st.bytesOut;
+
+  FileStreamStats fs;
+  fileStream.getStats(&fs);
+  JsonObject dl = doc["downloads"].to<JsonObject>();
+  dl["active"] = fs.active;
+  dl["served"] = fs.served;
+  dl["aborted"] = fs.aborted;
+  dl["busy"] = fs.busy;
+  dl["bytes"] = fs.bytes;
+  dl["readUsMax"] = fs.readUsMax;
+
+  TarExportStats ex;
+  queueExport.getStats(&ex);
+  JsonObject exp = doc["export"].to<JsonObject>();
+  exp["active"] = ex.active;
+  exp["exports"] = ex.exports;
+  exp["aborted"] = ex.aborted;
+  exp["files"] = ex.files;
+  exp["skipped"] = ex.skipped;
+  exp["bytes"] = ex.bytes;
+  exp["lastMs"] = ex.lastMs;
+  exp["lastKBps"] = ex.lastKBps;
+
+  FilePinStats pins;
+  queueFilePins().getStats(&pins);
+  JsonObject pn = doc["filePins"].to<JsonObject>();
+  pn["pinned"] = pins.pinned;
+  pn["refused"] = pins.refused;
+  pn["deferredDeletes"] = pins.deferred;
+
+  EventStreamStats ev;
+  liveEvents.getStats(&ev);
+  JsonObject events = doc["events"].to<JsonObject>();
+  events["subscribers"] = ev.subscribers;
+  events["connects"] = ev.connects;
+  events["refused"] = ev.refused;
+  events["published"] = ev.published;
+  events["keepalives"] = ev.keepalives;
+  events["resyncs"] = ev.resyncs;
+  events["dropped"] = ev.dropped;
+  events["events"] = ev.events;
+  events["bytes"] = ev.bytes;
+  events["lastDeltaLen"] = ev.lastDeltaLen;
+  events["lastFullLen"] = ev.lastFullLen;
+
+  ScanIndexStats ix;
+  queueScanIndex().getStats(&ix);
+  JsonObject idx = doc["scanIndex"].to<JsonObject>();
+  idx["built"] = ix.built;
+  idx["builds"] = ix.builds;
+  idx["buildMs"] = ix.buildMs;
+  idx["entries"] = ix.entries;
+  idx["dropped"] = ix.dropped;
+  idx["added"] = ix.added;
+  idx["removed"] = ix.removed;
+  idx["adopted"] = ix.adopted;
+  idx["ghosts"] = ix.ghosts;
+  idx["generation"] = ix.generation;
+  idx["floor"] = ix.floor;
+  idx["journalRecords"] = ix.journalRecords;
+  idx["journalErrors"] = ix.journalErrors;
+  idx["compactions"] = ix.compactions;
+  idx["pages"] = ix.pages;
+
+  StatsdExporterStats sd;
+  statsd.getStats(&sd);
+  JsonObject push = doc["statsd"].to<JsonObject>();
+  push["running"] = sd.running;
+  push["flushes"] = sd.flushes;
+  push["packets"] = sd.packets;
+  push["lines"] = sd.lines;
+  push["bytes"] = sd.bytes;
+  push["dropped"] = sd.dropped;
+  push["lastError"] = sd.lastError;
+  push["flushUs"] = sd.flushUs;
+  push["flushUsMax"] = sd.flushUsMax;
 
   String response;
   serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
   server.send(200, "application/json", response);
+}
 
-  led.setPixelColor(0, led.Color(255, 165, 0));
-  led.show();
+// Live status: an event with all of it at connect, then at most one per
+// EVENTS_MIN_INTERVAL_MS with just what changed (publishLiveStatus()), as
+// text/event-stream until the page goes away
+void handleEvents() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Cache-Control", "no-cache, no-store");
+  if (!server.sendStream("text/event-stream", &liveEvents)) {
+    server.send(503, "text/plain", "Too many subscribers");
+  }
+}
+
+// Live view: one multipart JPEG part per preview frame, until the client
+// disconnects
+void handleStream() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Cache-Control", "no-cache, no-store");
+  if (!server.sendStream("multipart/x-mixed-replace; boundary=" MJPEG_BOUNDARY, &mjpegStream)) {
+    server.send(503, "text/plain", "Too many viewers");
+  }
+}
+
+void handleStreamStats() {
+  MjpegStreamStats st;
+  mjpegStream.getStats(&st);
+  JsonDocument doc;
+  doc["viewers"] = st.viewers;
+  doc["maxViewers"] = STREAM_MAX_CLIENTS;
+  doc["offered"] = st.offered;
+  doc["lent"] = st.lent;
+  doc["refused"] = st.refused;
+  doc["spills"] = st.spills;
+  doc["spillFailed"] = st.spillFailed;
+  doc["copiesInUse"] = st.copiesInUse;
+  doc["lendMsMax"] = st.lendMsMax;
+  JsonArray arr = doc["clients"].to<JsonArray>();
+  for (uint8_t i = 0; i < st.viewers; i++) {
+    const MjpegViewerStats &v = st.viewer[i];
+    JsonObject o = arr.add<JsonObject>();
+    o["slot"] = v.slot;
+    o["connectedMs"] = v.connectedMs;
+    o["frames"] = v.frames;
+    o["dropped"] = v.dropped;
+    o["bytes"] = v.bytes;
+    o["fps"] = v.fpsX10 / 10.0f;
+    o["kbps"] = v.kbps;
+  }
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "application/json", response);
+}
+
+// Cloud round trips by phase: percentiles over the last CLOUD_TIMING_RING
+// and each of them, newest first (all in ms)
+void handleCloudTiming() {
+  const CloudTimingLog &log = getCloudTiming();
+  CloudTimingSummary sum;
+  log.summarize(&sum);
+  static CloudTiming recent[CLOUD_TIMING_RING]; // off the server task's stack
+  uint16_t n = log.recent(recent, CLOUD_TIMING_RING);
+
+  JsonDocument doc;
+  doc["requests"] = sum.total;
+  doc["failed"] = sum.failed;
+  doc["window"] = sum.requests;
+  JsonObject phases = doc["phases"].to<JsonObject>();
+  for (uint8_t p = 0; p < CLOUD_PHASES; p++) {
+    const CloudPhaseStats &ph = sum.phase[p];
+    JsonObject o = phases[CloudTimingLog::phaseName((CloudPhase)p)].to<JsonObject>();
+    o["n"] = ph.n;
+    o["p50"] = ph.p50 / 1000.0f;
+    o["p90"] = ph.p90 / 1000.0f;
+    o["p99"] = ph.p99 / 1000.0f;
+    o["max"] = ph.max / 1000.0f;
+  }
+  JsonObject rate = doc["uploadKBps"].to<JsonObject>();
+  rate["n"] = sum.sendRate.n;
+  rate["p50"] = sum.sendRate.p50 / 1024;
+  rate["p90"] = sum.sendRate.p90 / 1024;
+
+  JsonArray arr = doc["recent"].to<JsonArray>();
+  for (uint16_t i = 0; i < n; i++) {
+    const CloudTiming &t = recent[i];
+    JsonObject o = arr.add<JsonObject>();
+    o["agoMs"] = millis() - t.atMs;
+    o["what"] = t.what;
+    o["code"] = t.code;
+    o["sent"] = t.sentBytes;
+    o["received"] = t.recvBytes;
+    for (uint8_t p = 0; p < CLOUD_PHASES; p++) {
+      if (t.reached & (1 << p)) o[CloudTimingLog::phaseName((CloudPhase)p)] = t.us[p] / 1000.0f;
+    }
+  }
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.send(200, "application/json", response);
+}
+
+static const char *scanContentType(const char *name) {
+  const char *dot = strrchr(name, '.');
+  if (dot && strcasecmp(dot, ".jpg") == 0) return "image/jpeg";
+  if (dot && strcasecmp(dot, ".pdf") == 0) return "application/pdf";
+  return "application/octet-stream";
+}
+
+// Queued scans, newest first: GET /api/scans?cursor=&limit=. `next` is the
+// cursor for the following page, absent after the last. Pages come from the
+// scan index, so only the first one after boot reads the queue directory.
+void handleScans() {
+  static ScanEntry page[SCANS_PAGE_MAX]; // off loop()'s stack
+  long limit = server.hasArg("limit") ? server.arg("limit").toInt() : SCANS_PAGE_DEFAULT;
+  if (limit < 1) limit = 1;
+  if (limit > SCANS_PAGE_MAX) limit = SCANS_PAGE_MAX;
+  uint32_t cursor = strtoul(server.arg("cursor").c_str(), nullptr, 10);
+
+  uint32_t next;
+  uint16_t total;
+  int32_t n = queueScanIndex().page(cursor, page, (uint16_t)limit, &next, &total);
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  if (n < 0) {
+    server.send(503, "application/json", "{\"error\":\"SD card not available\"}");
+    return;
+  }
+
+  JsonDocument doc;
+  doc["total"] = total;
+  JsonArray arr = doc["scans"].to<JsonArray>();
+  for (int32_t i = 0; i < n; i++) {
+    const ScanEntry &e = page[i];
+    char id[9];
+    snprintf(id, sizeof(id), "%08lx", (unsigned long)e.key);
+    JsonObject o = arr.add<JsonObject>();
+    o["id"] = id;
+    o["name"] = e.name;
+    o["type"] = scanContentType(e.name);
+    if (e.size) o["size"] = e.size;
+    o["thumb"] = e.hasThumb;
+  }
+  if (next) {
+    char cursorText[11];
+    snprintf(cursorText, sizeof(cursorText), "%lu", (unsigned long)next);
+    doc["next"] = cursorText; // opaque to the client
+  }
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Cache-Control", "no-store");
+  server.send(200, "application/json", response);
+}
+
+// What changed in the queue since generation N: GET /api/sync?since=N
+// &cursor=&limit=. Oldest first, each an add (id, name, size, crc32; the
+// last two absent for files older firmware queued) or a del (id), paged by
+// `next` like /api/scans. `reset` means the client is
+// too far behind (or new): the pages list the whole queue, and whatever
+// they do not name is gone. A client keeps `generation` from the first
+// page and asks from it next time, then fetches the adds from
+// /api/scans/<id>, a few at once, with Range to resume.
+void handleSync() {
+  static ScanChange *changes = (ScanChange *)heap_caps_malloc(
+      sizeof(ScanChange) * SYNC_PAGE_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  long limit = server.hasArg("limit") ? server.arg("limit").toInt() : SYNC_PAGE_DEFAULT;
+  if (limit < 1) limit = 1;
+  if (limit > SYNC_PAGE_MAX) limit = SYNC_PAGE_MAX;
+  uint32_t since = strtoul(server.arg("since").c_str(), nullptr, 10);
+  uint32_t cursor = strtoul(server.arg("cursor").c_str(), nullptr, 10);
+
+  bool reset;
+  uint32_t next, generation;
+  int32_t n = changes ? queueScanIndex().changes(since, cursor, changes, (uint16_t)limit, &reset,
+                                                 &next, &generation)
+                      : -1;
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  if (n < 0) {
+    server.send(503, "application/json", "{\"error\":\"SD card not available\"}");
+    return;
+  }
+
+  JsonDocument doc;
+  doc["generation"] = generation;
+  doc["reset"] = reset;
+  JsonArray arr = doc["changes"].to<JsonArray>();
+  for (int32_t i = 0; i < n; i++) {
+    const ScanChange &c = changes[i];
+    char id[9];
+    snprintf(id, sizeof(id), "%08lx", (unsigned long)c.entry.key);
+    JsonObject o = arr.add<JsonObject>();
+    o["gen"] = c.entry.gen;
+    o["op"] = c.removed ? "del" : "add";
+    o["id"] = id;
+    if (c.removed) continue;
+    o["name"] = c.entry.name;
+    o["type"] = scanContentType(c.entry.name);
+    if (!c.entry.size && !c.entry.crc) continue; // queued before the journal
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08lx", (unsigned long)c.entry.crc);
+    o["size"] = c.entry.size;
+    o["crc32"] = crc;
+  }
+  if (next) {
+    char cursorText[11];
+    snprintf(cursorText, sizeof(cursorText), "%lu", (unsigned long)next);
+    doc["next"] = cursorText;
+  }
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Cache-Control", "no-store");
+  server.send(200, "application/json", response);
+}
+
+// One queued scan: GET /api/scans/<id> (the file, with Range) or
+// /api/scans/<id>/thumb (its gallery sidecar). The handler only opens the
+// file; the server task reads it a block at a time as the socket drains.
+void handleScanFile() {
+  String uri = server.uri();
+  const char *rest = uri.c_str() + strlen("/api/scans/");
+  char *end;
+  uint32_t key = strtoul(rest, &end, 16);
+  bool thumb = strcmp(end, "/thumb") == 0;
+  ScanEntry e;
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  if (end != rest + 8 || (*end && !thumb) || !queueScanIndex().find(key, &e) ||
+      (thumb && !e.hasThumb)) {
+    server.send(404, "text/plain", "No such scan");
+    return;
+  }
+
+  char path[80];
+  if (thumb) {
+    char name[13];
+    galleryThumbName(key, name);
+    snprintf(path, sizeof(path), SD_MOUNT "/queue/" GALLERY_THUMB_DIR "/%s", name);
+  } else {
+    snprintf(path, sizeof(path), SD_MOUNT "/queue/%s", e.name);
+  }
+  const char *type = thumb ? "image/jpeg" : scanContentType(e.name);
+  uint32_t size;
+  if (!fileStream.prepare(path, &size)) {
+    server.send(404, "text/plain", "No such scan");
+    return;
+  }
+
+  // Queue files are never rewritten in place: name and size pin the bytes
+  char etag[32];
+  snprintf(etag, sizeof(etag), "\"%08lx%s-%lx\"", (unsigned long)key, thumb ? "t" : "",
+           (unsigned long)size);
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "no-cache");
+  server.sendHeader("Accept-Ranges", "bytes");
+  if (strstr(server.header("If-None-Match").c_str(), etag)) {
+    fileStream.cancel();
+    server.send(304, type, "");
+    return;
+  }
+
+  uint32_t from = 0, len = size;
+  String rangeHeader = server.header("Range");
+  int code = rangeHeader.length() ? parseByteRange(rangeHeader.c_str(), size, &from, &len) : 200;
+  char contentRange[48];
+  if (code == 416) {
+    fileStream.cancel();
+    snprintf(contentRange, sizeof(contentRange), "bytes */%lu", (unsigned long)size);
+    server.sendHeader("Content-Range", contentRange);
+    server.send(416, "text/plain", "");
+    return;
+  }
+  if (code == 206) {
+    snprintf(contentRange, sizeof(contentRange), "bytes %lu-%lu/%lu", (unsigned long)from,
+             (unsigned long)(from + len - 1), (unsigned long)size);
+    server.sendHeader("Content-Range", contentRange);
+    fileStream.range(from, len);
+  }
+  if (server.method() == HTTP_HEAD) fileStream.cancel(); // headers only
+  if (!server.sendStream(code, type, len, &fileStream)) {
+    // Refused before the stream took the file, or by it: either way the
+    // file is closed and the ETag / range headers are not this answer's
+    fileStream.cancel();
+    server.clearHeaders();
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.sendHeader("Retry-After", "1");
+    server.send(503, "text/plain", "Too many downloads");
+  }
+}
+
+// The whole queue as one tar archive (queue/<name> members, newest first),
+// built while it is sent: the server task reads each file from SD as the
+// socket drains. Ends when the archive does; no Content-Length.
+void handleExport() {
+  ScanIndex &index = queueScanIndex();
+  ScanEntry probe;
+  uint32_t next;
+  uint16_t total;
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  if (index.page(0, &probe, 1, &next, &total) < 0) {
+    server.send(503, "text/plain", "SD card not available");
+    return;
+  }
+  queueExport.prepare(&index);
+  server.sendHeader("Content-Disposition", "attachment; filename=\"researchmate-queue.tar\"");
+  server.sendHeader("Cache-Control", "no-store");
+  if (!server.sendStream("application/x-tar", &queueExport)) {
+    server.clearHeaders(); // not an attachment
+    server.sendHeader("Access-Control-Allow-Origin", "*");
+    server.sendHeader("Retry-After", "5");
+    server.send(503, "text/plain", "Export already running");
+  }
+}
+
+// ============================================
+// Prometheus metrics. Modules keep their own (utils/metrics.h); what is
+// cheaper to read than to keep current is read here, at each scrape.
+// ============================================
+static MetricGauge heapFree("researchmate_heap_free_bytes", "Free heap.", "region=\"internal\"");
+static MetricGauge heapMinFree("researchmate_heap_min_free_bytes", "Lowest free heap since boot.",
+                               "region=\"internal\"");
+static MetricGauge psramFree("researchmate_heap_free_bytes", "Free heap.", "region=\"psram\"");
+static MetricGauge psramMinFree("researchmate_heap_min_free_bytes", "Lowest free heap since boot.",
+                                "region=\"psram\"");
+static MetricGauge uptime("researchmate_uptime_seconds", "Time since boot.");
+static MetricGauge previewFps("researchmate_preview_fps", "TFT preview frame rate.", nullptr, 0.1);
+
+// Task stacks, by FreeRTOS task name. One not running keeps the value it
+// had when it last was.
+static const char *const STACK_TASKS[] = {"loopTask",    "HttpServer",  "cloudTask", "PreviewDecode",
+                                          "PreviewPush", "burstWriter", "statsd"};
+static MetricGauge stackFree[] = {
+    {"researchmate_task_stack_min_free_bytes", "Task stack never used since it started.", "task=\"loopTask\""},
+    {"researchmate_task_stack_min_free_bytes", "Task stack never used since it started.", "task=\"HttpServer\""},
+    {"researchmate_task_stack_min_free_bytes", "Task stack never used since it started.", "task=\"cloudTask\""},
+    {"researchmate_task_stack_min_free_bytes", "Task stack never used since it started.", "task=\"PreviewDecode\""},
+    {"researchmate_task_stack_min_free_bytes", "Task stack never used since it started.", "task=\"PreviewPush\""},
+    {"researchmate_task_stack_min_free_bytes", "Task stack never used since it started.", "task=\"burstWriter\""},
+    {"researchmate_task_stack_min_free_bytes", "Task stack never used since it started.", "task=\"statsd\""},
+};
+static_assert(sizeof(stackFree) / sizeof(stackFree[0]) == sizeof(STACK_TASKS) / sizeof(STACK_TASKS[0]),
+              "one gauge per task");
+
+static void collectSystemMetrics() {
+  heapFree.set(heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+  heapMinFree.set(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+  psramFree.set(heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+  psramMinFree.set(heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+  uptime.set(millis() / 1000);
+
+  PreviewStats ps;
+  displayGetPreviewStats(&ps);
+  previewFps.set(ps.running ? ps.fpsX10 : 0);
+
+  for (size_t i = 0; i < sizeof(STACK_TASKS) / sizeof(STACK_TASKS[0]); i++) {
+    TaskHandle_t task = xTaskGetHandle(STACK_TASKS[i]);
+    if (task) stackFree[i].set(uxTaskGetStackHighWaterMark(task)); // bytes on ESP-IDF
+  }
+}
+
+// Prometheus scrape (text format 0.0.4), rendered into a PSRAM buffer kept
+// between scrapes and grown when the registry outgrows it
+void handleMetrics() {
+  static char *text = nullptr;
+  static size_t cap = 0;
+  size_t len = metricsRender(text, cap);
+  if (len >= cap) {
+    size_t want = max(len + 1024, (size_t)METRICS_TEXT_BYTES);
+    char *grown = (char *)heap_caps_realloc(text, want, MALLOC_CAP_SPIRAM);
+    if (!grown) {
+      server.send(503, "text/plain", "Out of memory");
+      return;
+    }
+    text = grown;
+    cap = want;
+    len = metricsRender(text, cap);
+  }
+  server.send(200, "text/plain; version=0.0.4; charset=utf-8", (const uint8_t *)text, min(len, cap - 1));
 }
 
 void triggerFactoryReset() {
@@ -514,16 +1414,22 @@ void onWiFiConnected() {
   }
 
   Serial.println("\n=== READY ===");
-  Serial.printf("Open: http://%s:8080\n", WiFi.localIP().toString().c_str());
+  Serial.printf("Open: http://%s:%d\n", WiFi.localIP().toString().c_str(), HTTP_PORT);
 
   // LAZY INIT: Start server and camera ONLY once WiFi is solid.
   // This saves ~200KB DRAM for WiFiManager portal strings and DHCP buffers.
   Serial.println("[LazyInit] Starting Web Server...");
-  server.begin();
+  if (!server.begin(HTTP_PORT)) Serial.println("      [X] Web server failed to start");
+  if (STATSD_HOST[0]) {
+    Serial.println("[LazyInit] Starting StatsD export...");
+    if (!statsd.begin(STATSD_HOST, STATSD_PORT, getUniquePenID()))
+      Serial.println("      [X] StatsD export failed to start");
+  }
   
   Serial.println("[LazyInit] Initializing Camera...");
   if (initCamera()) {
     Serial.println("      [OK] Camera ready (Post-WiFi)");
+    previewPipelineOk = displayPreviewBegin(previewGrab, previewRelease);
   } else {
     Serial.println("      [X] Camera failed to initialize (Post-WiFi)");
   }
@@ -595,7 +1501,7 @@ void setup() {
   Serial.println("[2/4] Initializing cloud & SD storage...");
   setLastAction("Storage init...", false);
   drawBottomPanel();
-  initSDCard();
+  if (initSDCard()) docRecoverOrphans();
   initCloud();
 
   // WiFi
@@ -636,7 +1542,10 @@ void setup() {
 
 
   // Web server endpoints registered but begin() deferred until WiFi is ready
+  static const char *const collected[] = {"If-None-Match", "Range"};
+  server.collectHeaders(collected, 2);
   server.on("/", handleRoot);
+  server.on("/api/state", HTTP_GET, handleState);
   server.on("/capture", handleCapture);
   server.on("/api/upload", HTTP_POST, handleUpload);
   server.on("/api/pairing-start", HTTP_POST, handlePairingStart);
@@ -644,9 +1553,29 @@ void setup() {
   server.on("/api/unpair", HTTP_POST, handleUnpair);
   server.on("/api/factory-reset", HTTP_POST, handleFactoryReset);
   server.on("/api/status", HTTP_GET, handleStatus);
+  server.on("/api/capture-stats", HTTP_GET, handleCaptureStats);
+  server.on("/api/scan-mode", handleScanMode);
+  server.on("/api/burst", HTTP_GET, handleBurstStats);
+  server.on("/api/autocapture", HTTP_GET, handleAutoCaptureStats);
+  server.on("/api/document", handleDocument);
+  server.on("/api/preview", handlePreviewStats);
+  server.on("/api/review", handleReview);
+  server.on("/api/gallery", handleGallery);
+  server.on("/api/jobs", HTTP_GET, handleJobs);
+  server.on("/api/server", HTTP_GET, handleServerStats);
+  server.on("/stream", HTTP_GET, handleStream);
+  server.on("/api/stream", HTTP_GET, handleStreamStats);
+  server.on("/api/scans", HTTP_GET, handleScans);
+  server.on("/api/scans/*", HTTP_GET, handleScanFile);
+  server.on("/api/export", HTTP_GET, handleExport);
+  server.on("/api/sync", HTTP_GET, handleSync);
+  server.on("/api/events", HTTP_GET, handleEvents);
+  server.on("/api/cloud-timing", HTTP_GET, handleCloudTiming);
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  metricsOnCollect(collectSystemMetrics);
 
   Serial.println("\n=== READY ===");
-  Serial.printf("Open: http://%s:8080\n", WiFi.localIP().toString().c_str());
+  Serial.printf("Open: http://%s:%d\n", WiFi.localIP().toString().c_str(), HTTP_PORT);
 
   // Create the background cloud task (lower priority than main loop)
   xTaskCreate(
@@ -659,7 +1588,12 @@ void setup() {
             continue;
           }
 
-          // 2. Handle Pairing (Check/Request)
+          // 2. Cloud round trips queued by the web page (pairing code, unpair)
+          uint32_t jobId;
+          uint8_t jobKind;
+          while (webJobs.next(&jobId, &jobKind, millis())) runWebJob(jobId, jobKind);
+
+          // 3. Handle Pairing (Check/Request)
           if (!isPaired && pairingCode[0] != '\0') {
              // Auto-expire
              if (millis() - pairingCodeTimestamp > pairingCodeExpiry) {
@@ -683,15 +1617,18 @@ void setup() {
              }
           }
 
-          // 3. Handle SD Queue Sync (Only when explicitly triggered by double press)
+          // 4. Handle SD Queue Sync (Only when explicitly triggered by double press)
           // NOTE: Periodic auto-sync intentionally removed. Single press = SD only.
           // Double press = user-initiated upload. Background task must not steal photos.
           if (isPaired && forceSyncNext) {
             forceSyncNext = false;
+            displayPreviewHoldBusy(true); // slow the preview for the upload
             syncPendingQueue();
+            displayPreviewHoldBusy(false);
           }
 
-          vTaskDelay(pdMS_TO_TICKS(500)); // Sleep 500ms between rounds
+          // Sleep 500ms between rounds; a new web job or sync request wakes it early
+          ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(500));
         }
       },
       "cloudTask", 
@@ -850,6 +1787,46 @@ void updateButtonState() {
   }
 }
 
+// Hands-free mode: the preview decode also sampled a luma grid
+static void feedAutoCapture(uint32_t jpegLen) {
+  uint8_t grid[STABILITY_GRID_CELLS];
+  uint32_t probeUs = 0;
+  if (scanMode != SCAN_MODE_AUTO || !displayGetLumaGrid(grid, &probeUs)) return;
+
+  uint32_t t0 = micros();
+  bool fire = stabilityUpdate(&stability, grid, jpegLen, millis());
+  autoDetectUsTotal += micros() - t0;
+  autoProbeUsTotal += probeUs;
+  if (fire && pendingButtonAction == 0) {
+    Serial.println("[Auto] Page stable — capturing");
+    pendingButtonAction = 1; // same path as a short press
+  }
+}
+
+// Review screen: short press zooms in a step (1:1 wraps back to fit),
+// long press returns to the live preview
+static void handleReviewPress(int action) {
+  if (action == 2) {
+    closeReview();
+    return;
+  }
+  ReviewStats st;
+  displayGetReviewStats(&st);
+  displayReviewView((st.zoom + 1) % 4, st.cx, st.cy);
+  reviewTouchedMs = millis();
+}
+
+// Gallery: short press selects the next (older) scan, wrapping; long
+// press returns to the live preview
+static void handleGalleryPress(int action) {
+  if (action == 2) {
+    closeGallery();
+    return;
+  }
+  displayGalleryScroll(1);
+  galleryTouchedMs = millis();
+}
+
 void evaluateButtonActions() {
   // Actions are set on button release — consume immediately when button is up
   if (pendingButtonAction == 0 || isButtonPressed) return;
@@ -857,7 +1834,50 @@ void evaluateButtonActions() {
   int action = pendingButtonAction;
   pendingButtonAction = 0;
 
-  if (action == 1) {
+  // Every action below may drive the camera; park the preview tasks first
+  // and get back the buffer lent to /stream viewers
+  displayPreviewSuspend();
+  mjpegStream.reclaim(STREAM_LEND_MS * 4);
+
+  if (displayReviewActive()) {
+    handleReviewPress(action);
+    return;
+  }
+  if (displayGalleryActive()) {
+    handleGalleryPress(action);
+    return;
+  }
+
+  // Any press while a burst session is capturing ends it
+  if (burstState() == BURST_RUNNING) {
+    Serial.println("[Button] Ending burst session");
+    burstRequestStop();
+    setUIMode("FLUSHING");
+    setLastAction("Writing to SD...", false);
+    drawTopBar();
+    drawBottomPanel();
+    return;
+  }
+  if (burstState() != BURST_IDLE) return; // still draining, ignore presses
+
+  if (action == 1 && scanMode == SCAN_MODE_BURST) {
+    livePreviewActive = false;
+    Serial.println("[Button] SHORT PRESS: Starting burst session");
+    if (!initSDCard()) {
+      setLastAction("No SD Card", true);
+      livePreviewActive = true;
+    } else if (burstStart(burstTrigger)) {
+      setUIMode("BURST");
+      setLastAction("Press to stop", false);
+      lastBurstDisplay = 0;
+    } else {
+      setLastAction("Burst Error", true);
+      livePreviewActive = true;
+    }
+    drawTopBar();
+    drawBottomPanel();
+
+  } else if (action == 1) {
     // Short press: capture and save to SD card only
     livePreviewActive = false;
     Serial.println("[Button] SHORT PRESS: Saving to SD Card!");
@@ -866,9 +1886,22 @@ void evaluateButtonActions() {
     drawTopBar();
     drawBottomPanel();
     handleSDCapture();
+    if (displayReviewActive()) {
+      Serial.println("[Review] Press: zoom, hold: back to preview");
+    } else {
+      displayReady();
+      livePreviewActive = true;
+      Serial.println("[Display] Resumed Live Preview");
+    }
+
+  } else if (action == 2 && scanMode == SCAN_MODE_DOCUMENT && docActive()) {
+    // Long press in document mode: close the PDF and queue it
+    Serial.println("[Button] LONG PRESS: Finishing document");
+    finishDocument();
+    led.setPixelColor(0, led.Color(0, 255, 0));
+    led.show();
+    vTaskDelay(pdMS_TO_TICKS(500));
     displayReady();
-    livePreviewActive = true;
-    Serial.println("[Display] Resumed Live Preview");
 
   } else if (action == 2) {
     // Long press: upload existing SD photo to cloud
@@ -919,6 +1952,102 @@ void evaluateButtonActions() {
   }
 }
 
+// ============================================
+// Live status push (/api/events)
+// ============================================
+
+// What the web page shows, as last pushed to it
+struct LiveStatus {
+  bool paired;
+  char pairingCode[16];
+  int totalItems;
+  char lastStatus[32];
+  unsigned long lastCaptureMs;
+  int32_t queued;         // -1: scan index not built yet
+  uint32_t burstPages;
+  uint32_t burstPending;
+  uint32_t docPages;
+  bool uploading;
+  uint8_t uploadPct;
+  uint16_t fps;           // TFT preview, rounded (tenths would change every pass)
+};
+
+static void readLiveStatus(LiveStatus *s) {
+  memset(s, 0, sizeof(*s)); // compared with memcmp(), padding included
+  s->paired = isPaired;
+  if (!isPaired) strncpy(s->pairingCode, pairingCode, sizeof(s->pairingCode) - 1);
+  s->totalItems = totalItemsUploaded;
+  strncpy(s->lastStatus, lastCaptureStatus, sizeof(s->lastStatus) - 1);
+  s->lastCaptureMs = lastCaptureTimestamp;
+
+  ScanIndexStats ix;
+  queueScanIndex().getStats(&ix);
+  s->queued = ix.built ? (int32_t)ix.entries : -1;
+
+  if (burstState() != BURST_IDLE) {
+    BurstStats bs;
+    getBurstStats(&bs);
+    s->burstPages = bs.pagesWritten;
+    s->burstPending = bs.ringPending;
+  }
+  if (docActive()) s->docPages = docPageCount();
+
+  UploadProgress up;
+  getUploadProgress(&up);
+  s->uploading = up.active;
+  if (up.active && up.total) s->uploadPct = (uint8_t)((uint64_t)up.sent * 100 / up.total);
+
+  PreviewStats ps;
+  displayGetPreviewStats(&ps);
+  s->fps = ps.running ? (uint16_t)((ps.fpsX10 + 5) / 10) : 0;
+}
+
+// Fields of `s` that differ from `prev` (all of them without one), as a
+// JSON object; empty when nothing does
+static void liveStatusJson(const LiveStatus &s, const LiveStatus *prev, char *out, size_t size) {
+  JsonDocument doc;
+  if (!prev || s.paired != prev->paired) doc["paired"] = s.paired;
+  if (!prev || strcmp(s.pairingCode, prev->pairingCode)) doc["pairingCode"] = s.pairingCode;
+  if (!prev || s.totalItems != prev->totalItems) doc["totalItems"] = s.totalItems;
+  if (!prev || strcmp(s.lastStatus, prev->lastStatus)) doc["lastStatus"] = s.lastStatus;
+  if (!prev || s.lastCaptureMs != prev->lastCaptureMs) {
+    // The page counts on from here by itself
+    doc["secondsSinceLastCapture"] = s.lastCaptureMs ? (millis() - s.lastCaptureMs) / 1000 : 0;
+  }
+  if (s.queued >= 0 && (!prev || s.queued != prev->queued)) doc["queued"] = s.queued;
+  if (!prev || s.burstPages != prev->burstPages) doc["burstPages"] = s.burstPages;
+  if (!prev || s.burstPending != prev->burstPending) doc["burstPending"] = s.burstPending;
+  if (!prev || s.docPages != prev->docPages) doc["docPages"] = s.docPages;
+  if (!prev || s.uploading != prev->uploading) doc["uploading"] = s.uploading;
+  if (!prev || s.uploadPct != prev->uploadPct) doc["uploadPct"] = s.uploadPct;
+  if (!prev || s.fps != prev->fps) doc["fps"] = s.fps;
+  out[0] = '\0';
+  if (doc.size() > 0) serializeJson(doc, out, size);
+}
+
+// Called every loop pass; costs a flag check while no page is open. One
+// event per EVENTS_MIN_INTERVAL_MS at most, carrying the latest value of
+// whatever changed in between; a new subscriber gets its first at once.
+static void publishLiveStatus() {
+  static LiveStatus sent; // as of the last event
+  static unsigned long sentMs = 0;
+  static char delta[EVENTS_MSG_BYTES], full[EVENTS_MSG_BYTES];
+  if (!liveEvents.subscribed()) return;
+  bool waiting = liveEvents.waiting();
+  unsigned long now = millis();
+  if (!waiting && now - sentMs < EVENTS_MIN_INTERVAL_MS) return;
+
+  LiveStatus cur;
+  readLiveStatus(&cur);
+  bool changed = memcmp(&cur, &sent, sizeof(cur)) != 0;
+  if (!changed && !waiting && now - sentMs < EVENTS_KEEPALIVE_MS) return;
+  liveStatusJson(cur, &sent, delta, sizeof(delta)); // empty: a keepalive
+  liveStatusJson(cur, nullptr, full, sizeof(full));
+  liveEvents.publish(delta, full);
+  sent = cur;
+  sentMs = now;
+}
+
 void loop() {
   // Handle factory reset: wipe WiFi creds and re-enter AP config portal
   if (needsFactoryReset) {
@@ -940,12 +2069,18 @@ void loop() {
     ESP.restart();
   }
 
-  server.handleClient();
+  // Requests the server task has read in full: run their handlers here, where
+  // the camera and display are safe to touch
+  uint32_t serveStart = micros();
+  server.dispatch();
 
   // CRITICAL: Process the background non-blocking WiFi Setup portal.
   // If we don't call this continuously, the portal buttons won't work!
   wifiManager.process();
 
+  // A request was served: let the preview back off while clients are active
+  if (micros() - serveStart > PREVIEW_BUSY_LOOP_US) displayPreviewNoteBusy();
+
   // Asynchronous WiFi Connection Handler
   if (WiFi.status() == WL_CONNECTED) {
     onWiFiConnected();
@@ -955,6 +2090,33 @@ void loop() {
   updateButtonState();
   evaluateButtonActions();
 
+  // Burst session: grab due frames and keep the progress view fresh
+  if (burstState() != BURST_IDLE) {
+    BurstState bs = burstTick();
+    if (bs == BURST_FINISHED) {
+      BurstStats st;
+      getBurstStats(&st);
+      totalItemsUploaded += st.pagesWritten;
+      setQueueCount(totalItemsUploaded);
+      char msg[24];
+      snprintf(msg, sizeof(msg), "Saved %lu pages", (unsigned long)st.pagesWritten);
+      displayReady();
+      setLastAction(msg, st.dropped > 0 || st.writeErrors > 0);
+      drawBottomPanel();
+      livePreviewActive = true;
+    } else if (millis() - lastBurstDisplay > 500) {
+      lastBurstDisplay = millis();
+      BurstStats st;
+      getBurstStats(&st);
+      int ringPct = st.ringCapacity ? (int)((uint64_t)st.ringUsed * 100 / st.ringCapacity) : 0;
+      displayBurstStatus(st.pagesWritten, st.ringPending, st.dropped, ringPct);
+    }
+  }
+
+  // Scan review left alone: back to the live preview
+  if (displayReviewActive() && millis() - reviewTouchedMs > REVIEW_TIMEOUT_MS) closeReview();
+  if (displayGalleryActive() && millis() - galleryTouchedMs > GALLERY_TIMEOUT_MS) closeGallery();
+
   // Periodic redraw of Top Bar for clock/status updates if needed, though we don't have a clock.
   // We can just omit drawing here unless state changes.
   // Removed old displayCameraDebug.
@@ -973,27 +2135,66 @@ void loop() {
     led.show();
   }
 
+  // New pairing code fetched for the web page (refresh / unpair)
+  if (pairingCodeChanged) {
+    pairingCodeChanged = false;
+    if (!isPaired) displayPairingCode(pairingCode);
+  }
+
+  // Open web pages: push what changed since the last event
+  publishLiveStatus();
+
   // --- LIVE CAMERA PREVIEW ---
   // Suspend camera pulling during double-press gap to allow fast polling of button.
   // QVGA (320x240) for preview: fast decode, correct scale. UXGA is restored before SD/upload capture.
   static bool previewResSet = false;
+  bool inlineFrame = false;
   if (isPaired && livePreviewActive && !isButtonPressed) {
     if (!previewResSet) {
       setImageResolution(FRAMESIZE_QVGA); // 320x240 for live preview
       previewResSet = true;
     }
-    camera_fb_t *fb = captureFrame();
-    if (fb) {
-      displayDrawFrame(fb->buf, fb->len);
-      returnFrame(fb);
+    if (previewPipelineOk) {
+      // Decode and push run on their own tasks; just pick up finished frames
+      displayPreviewResume();
+      uint32_t jpegLen;
+      if (displayPreviewPoll(&jpegLen)) feedAutoCapture(jpegLen);
+    } else if (displayPreviewFrameDue()) {
+      inlineFrame = true;
+      camera_fb_t *fb = captureFrame();
+      if (fb) {
+        mjpegStream.offer(fb->buf, fb->len, fb);
+        displayDrawFrame(fb->buf, fb->len);
+        feedAutoCapture(fb->len);
+        mjpegStream.release(fb);
+      }
     }
   } else {
-    previewResSet = false; // reset so UXGA is restored on next capture
+    displayPreviewSuspend();
+    if (!mjpegStream.wanted()) previewResSet = false; // reset so UXGA is restored on next capture
+
+    // No preview to share frames from: grab for /stream viewers here, at a
+    // lower rate (not while the button is down, see above)
+    static unsigned long lastStreamGrab = 0;
+    if (mjpegStream.wanted() && !isButtonPressed &&
+        millis() - lastStreamGrab >= 1000 / STREAM_IDLE_FPS) {
+      lastStreamGrab = millis();
+      if (!previewResSet) {
+        setImageResolution(FRAMESIZE_QVGA);
+        previewResSet = true;
+      }
+      camera_fb_t *fb = captureFrame();
+      if (fb) {
+        mjpegStream.offer(fb->buf, fb->len, fb);
+        mjpegStream.release(fb);
+      }
+    }
   }
 
-  // Only yield briefly when idle (not paired/previewing) so wifiManager.process()
-  // and server.handleClient() can serve HTTP as fast as possible.
-  if (!isPaired || !livePreviewActive) {
+  // Only skip the yield right after an inline preview frame, so wifiManager.process()
+  // and server.dispatch() get polled again as soon as possible. Between
+  // paced frames, and with the pipelined preview, the loop always yields.
+  if (!inlineFrame) {
     vTaskDelay(pdMS_TO_TICKS(1));
   }
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "event_stream.h"
+
+// ============================================
+// Publisher side
+// ============================================
+void EventStream::publish(const char *delta, const char *full) {
+  portENTER_CRITICAL(&_mux);
+  uint32_t seq = _head + 1;
+  // Subscribers still on the event this slot held start over from this one
+  for (Subscriber &s : _subs) {
+    if (!s.open || s.broken || s.seq + EVENTS_RING > seq) continue;
+    if (s.off > 0) {
+      s.broken = true; // half an event on the wire: no clean way back in
+      _stats.dropped++;
+      continue;
+    }
+    s.seq = seq;
+    s.full = true;
+    _stats.resyncs++;
+  }
+  Slot &sl = _slots[seq % EVENTS_RING];
+  sl.seq = 0;
+  portEXIT_CRITICAL(&_mux);
+
+  // Nothing reads this slot until _head reaches it; a peek() from before
+  // shows up in consume() as a changed seq
+  int d = delta[0] ? snprintf(sl.delta, sizeof(sl.delta), "id: %lu\ndata: %s\n\n",
+                              (unsigned long)seq, delta)
+                   : snprintf(sl.delta, sizeof(sl.delta), ": keepalive\n\n");
+  int f = snprintf(sl.full, sizeof(sl.full), "retry: %u\nid: %lu\ndata: %s\n\n",
+                   (unsigned)EVENTS_RETRY_MS, (unsigned long)seq, full);
+  // Cut short, the JSON would not parse: send a comment in its place
+  if (d >= (int)sizeof(sl.delta)) d = snprintf(sl.delta, sizeof(sl.delta), ": overflow\n\n");
+  if (f >= (int)sizeof(sl.full)) f = snprintf(sl.full, sizeof(sl.full), ": overflow\n\n");
+
+  portENTER_CRITICAL(&_mux);
+  sl.deltaLen = (uint16_t)d;
+  sl.fullLen = (uint16_t)f;
+  sl.seq = seq;
+  _head = seq;
+  _stats.published++;
+  if (!delta[0]) _stats.keepalives++;
+  _stats.lastDeltaLen = sl.deltaLen;
+  _stats.lastFullLen = sl.fullLen;
+  portEXIT_CRITICAL(&_mux);
+}
+
+bool EventStream::subscribed() const {
+  for (const Subscriber &s : _subs) {
+    if (s.open) return true;
+  }
+  return false;
+}
+
+bool EventStream::waiting() const {
+  portENTER_CRITICAL(&_mux);
+  bool any = false;
+  for (const Subscriber &s : _subs) {
+    if (s.open && s.full && s.seq > _head) any = true;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return any;
+}
+
+// ============================================
+// Subscriber side (server task; open() from the /api/events handler on loop())
+// ============================================
+bool EventStream::open(uint8_t client) {
+  if (client >= HTTP_MAX_CLIENTS) return false;
+  portENTER_CRITICAL(&_mux);
+  uint8_t open = 0;
+  for (const Subscriber &s : _subs) {
+    if (s.open) open++;
+  }
+  bool ok = open < EVENTS_MAX_CLIENTS && !_subs[client].open;
+  if (ok) {
+    Subscriber &s = _subs[client];
+    s = {};
+    s.open = true;
+    s.full = true;
+    s.seq = _head + 1; // the next event, which loop() publishes right away
+    _stats.connects++;
+  } else {
+    _stats.refused++;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return ok;
+}
+
+void EventStream::close(uint8_t client) {
+  portENTER_CRITICAL(&_mux);
+  _subs[client].open = false;
+  portEXIT_CRITICAL(&_mux);
+}
+
+size_t EventStream::peek(uint8_t client, const uint8_t **data) {
+  Subscriber &s = _subs[client];
+  size_t len = 0;
+  portENTER_CRITICAL(&_mux);
+  if (s.open && !s.broken && s.seq <= _head) {
+    const Slot &sl = slot(s.seq);
+    const char *text = s.full ? sl.full : sl.delta;
+    uint16_t total = s.full ? sl.fullLen : sl.deltaLen;
+    *data = (const uint8_t *)text + s.off;
+    len = total - s.off;
+    s.peekSeq = s.seq;
+    s.peekFull = s.full;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return len;
+}
+
+void EventStream::consume(uint8_t client, size_t n) {
+  Subscriber &s = _subs[client];
+  portENTER_CRITICAL(&_mux);
+  _stats.bytes += n;
+  if (s.peekSeq != s.seq || s.peekFull != s.full || slot(s.peekSeq).seq != s.peekSeq) {
+    // publish() reused the slot while it was being sent: the bytes that
+    // went out may be torn
+    if (!s.broken) _stats.dropped++;
+    s.broken = true;
+  } else {
+    s.off += (uint16_t)n;
+    const Slot &sl = slot(s.seq);
+    if (s.off >= (s.full ? sl.fullLen : sl.deltaLen)) {
+      s.seq++;
+      s.full = false;
+      s.off = 0;
+      _stats.events++;
+    }
+  }
+  portEXIT_CRITICAL(&_mux);
+}
+
+bool EventStream::done(uint8_t client) { return _subs[client].broken; }
+
+void EventStream::getStats(EventStreamStats *out) const {
+  portENTER_CRITICAL(&_mux);
+  *out = _stats;
+  out->subscribers = 0;
+  for (const Subscriber &s : _subs) {
+    if (s.open) out->subscribers++;
+  }
+  portEXIT_CRITICAL(&_mux);
+}
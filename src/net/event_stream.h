@@ -0,0 +1,96 @@
+// ============================================
+// Live Status Events - ResearchMate
+// text/event-stream body for /api/events: the web page keeps one
+// connection open and is told what changed, instead of asking every two
+// seconds. Each event is serialized once, into a small ring, and every
+// subscriber writes it from there.
+//
+// An event carries two forms of the same state: the changes since the
+// previous event, for subscribers that have seen that one, and the whole
+// of it, for one that has just connected or fallen behind. Both are JSON
+// objects the page merges into what it has, so it never needs to tell
+// them apart.
+//
+// loop() decides what to publish and how often (coalescing happens there:
+// only the last value of a field within EVENTS_MIN_INTERVAL_MS goes out).
+// publish() never waits on a subscriber. It reuses the oldest slot; one
+// still on the event that slot held starts over from the new event's full
+// form. If the server task was partway through writing that slot to it,
+// the connection is closed instead, and the browser reconnects by itself
+// (EventSource, after the "retry:" delay). A subscriber that stops reading
+// altogether is dropped by the server (HTTP_CLIENT_TIMEOUT_MS).
+//
+// Publisher side: loop(). Subscriber side: HttpStream calls from the server
+// task. Shared state is under one spinlock.
+// ============================================
+
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include "http_server.h"
+
+struct EventStreamStats {
+  uint8_t subscribers;
+  uint32_t connects;
+  uint32_t refused;       // turned away: EVENTS_MAX_CLIENTS already open
+  uint32_t published;
+  uint32_t keepalives;    // of those, comments sent on an idle stream
+  uint32_t resyncs;       // subscribers moved to a full event after falling behind
+  uint32_t dropped;       // ...closed instead: their slot was reused mid-write
+  uint32_t events;        // events written, all subscribers
+  uint32_t bytes;
+  uint16_t lastDeltaLen;  // serialized sizes of the newest event
+  uint16_t lastFullLen;
+};
+
+class EventStream : public HttpStream {
+public:
+  // loop(): publish one event. `delta` and `full` are JSON objects; an
+  // empty `delta` only keeps the connections alive.
+  void publish(const char *delta, const char *full);
+
+  // Anyone connected (nothing needs building while not)
+  bool subscribed() const;
+  // Someone connected since the last publish and is waiting for its first
+  // event: publish now rather than at the next interval
+  bool waiting() const;
+
+  void getStats(EventStreamStats *out) const;
+
+  // HttpStream (server task)
+  bool open(uint8_t client) override;
+  void close(uint8_t client) override;
+  size_t peek(uint8_t client, const uint8_t **data) override;
+  void consume(uint8_t client, size_t n) override;
+  bool done(uint8_t client) override;
+  uint32_t idleWaitMs(uint8_t client) override { return EVENTS_POLL_MS; }
+
+private:
+  struct Slot {
+    uint32_t seq;           // event it holds; 0 while being rewritten
+    char delta[EVENTS_MSG_BYTES];   // "id:", "data:" lines, blank line
+    char full[EVENTS_MSG_BYTES + 16]; // same, after a "retry:" line
+    uint16_t deltaLen;
+    uint16_t fullLen;
+  };
+
+  struct Subscriber {
+    bool open;
+    bool full;              // writing the full form of `seq`
+    bool broken;            // slot reused under it: close the connection
+    uint32_t seq;           // event being written, or waited for
+    uint16_t off;
+    uint32_t peekSeq;       // what the last peek() handed out
+    bool peekFull;
+  };
+
+  const Slot &slot(uint32_t seq) const { return _slots[seq % EVENTS_RING]; }
+
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+  Slot _slots[EVENTS_RING] = {};
+  uint32_t _head = 0;       // newest published, 0 before the first
+  Subscriber _subs[HTTP_MAX_CLIENTS] = {};
+  EventStreamStats _stats = {};
+};
+
+#endif // EVENT_STREAM_H
@@ -0,0 +1,204 @@
+#include "file_stream.h"
+#include "../utils/metrics.h"
+#include <esp_heap_caps.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SECTOR_BYTES 512
+
+static MetricCounter sdReadBytes("researchmate_sd_read_bytes_total", "Bytes read from the SD card.",
+                                 "caller=\"download\"");
+static MetricHistogram sdReadSeconds("researchmate_sd_read_seconds",
+                                     "SD read time per file read back or block streamed.", METRIC_LATENCY_US,
+                                     1e-6, "caller=\"download\"");
+
+// Decimal digits only (strtoul would take a sign or spaces); false if none
+static bool parseUint(const char **s, uint32_t *out) {
+  const char *p = *s;
+  uint64_t v = 0;
+  while (*p >= '0' && *p <= '9') {
+    v = v * 10 + (uint32_t)(*p - '0');
+    if (v > 0xFFFFFFFFULL) return false;
+    p++;
+  }
+  if (p == *s) return false;
+  *out = (uint32_t)v;
+  *s = p;
+  return true;
+}
+
+int parseByteRange(const char *header, uint32_t size, uint32_t *from, uint32_t *len) {
+  if (!header) return 200;
+  while (*header == ' ') header++;
+  if (strncmp(header, "bytes=", 6) != 0 || strchr(header, ',')) return 200;
+  const char *p = header + 6;
+
+  uint32_t first, last;
+  if (*p == '-') {
+    // Suffix: the last N bytes
+    p++;
+    if (!parseUint(&p, &last) || *p) return 200;
+    if (last == 0 || size == 0) return 416;
+    *len = last < size ? last : size;
+    *from = size - *len;
+    return 206;
+  }
+  if (!parseUint(&p, &first) || *p++ != '-') return 200;
+  if (*p == '\0') {
+    last = size ? size - 1 : 0;
+  } else if (!parseUint(&p, &last) || *p || last < first) {
+    return 200; // malformed: ignored, as RFC 9110 allows
+  }
+  if (first >= size) return 416;
+  if (last >= size) last = size - 1;
+  *from = first;
+  *len = last - first + 1;
+  return 206;
+}
+
+FileStream::FileStream(FilePins *pins) : _pins(pins) {}
+
+// A delete that waited for this reader is done here
+void FileStream::release(int fd, const char *path) {
+  if (fd >= 0) ::close(fd);
+  if (_pins->unpin(path)) {
+    ::unlink(path);
+    _pins->deleted(path);
+  }
+}
+
+// ============================================
+// loop(): the file for the next download
+// ============================================
+bool FileStream::prepare(const char *path, uint32_t *size) {
+  cancel();
+  if (strlen(path) >= sizeof(_path) || !_pins->pin(path)) return false;
+  int fd = ::open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    release(fd, path);
+    return false;
+  }
+  strcpy(_path, path);
+  _fd = fd;
+  _from = 0;
+  _len = (uint32_t)st.st_size;
+  *size = _len;
+  return true;
+}
+
+void FileStream::range(uint32_t from, uint32_t len) {
+  _from = from;
+  _len = len;
+}
+
+void FileStream::cancel() {
+  if (_fd >= 0) release(_fd, _path);
+  _fd = -1;
+}
+
+// ============================================
+// HttpStream
+// ============================================
+bool FileStream::open(uint8_t client) {
+  int fd = _fd;
+  _fd = -1;
+  if (fd < 0 || client >= HTTP_MAX_CLIENTS) {
+    if (fd >= 0) release(fd, _path);
+    return false;
+  }
+
+  uint8_t running = 0;
+  for (const Download &d : _downloads) {
+    if (d.block) running++;
+  }
+  uint8_t *block = nullptr;
+  if (running < FILE_STREAM_MAX) {
+    block = (uint8_t *)heap_caps_malloc(FILE_STREAM_BLOCK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  bool seeked = block && (!_from || lseek(fd, _from, SEEK_SET) == (off_t)_from);
+  if (!seeked) {
+    heap_caps_free(block);
+    release(fd, _path);
+    portENTER_CRITICAL(&_mux);
+    if (block) _stats.aborted++;
+    else _stats.busy++;
+    portEXIT_CRITICAL(&_mux);
+    return false;
+  }
+
+  Download &d = _downloads[client];
+  d.fd = fd;
+  strcpy(d.path, _path);
+  d.at = _from;
+  d.left = _len;
+  d.fill = d.pos = 0;
+  d.failed = false;
+  portENTER_CRITICAL(&_mux);
+  d.block = block;
+  _stats.active++;
+  portEXIT_CRITICAL(&_mux);
+  return true;
+}
+
+void FileStream::close(uint8_t client) {
+  Download &d = _downloads[client];
+  if (!d.block) return;
+  release(d.fd, d.path);
+  heap_caps_free(d.block);
+  portENTER_CRITICAL(&_mux);
+  d.block = nullptr;
+  _stats.active--;
+  if (d.left == 0 && d.pos == d.fill && !d.failed) _stats.served++;
+  else _stats.aborted++;
+  portEXIT_CRITICAL(&_mux);
+}
+
+size_t FileStream::peek(uint8_t client, const uint8_t **data) {
+  Download &d = _downloads[client];
+  if (!d.block || d.failed) return 0;
+  if (d.pos == d.fill) {
+    if (d.left == 0) return 0;
+    // Size this read so the next one starts on a sector boundary
+    uint32_t want = FILE_STREAM_BLOCK - d.at % SECTOR_BYTES;
+    if (want > d.left) want = d.left;
+    uint32_t t0 = micros();
+    ssize_t n = read(d.fd, d.block, want);
+    uint32_t us = micros() - t0;
+    sdReadSeconds.observe(us);
+    if (n <= 0) {
+      d.failed = true; // done(): closing early tells the client it is short
+      return 0;
+    }
+    d.fill = (uint16_t)n;
+    d.pos = 0;
+    d.at += (uint32_t)n;
+    d.left -= (uint32_t)n;
+    sdReadBytes.add((uint32_t)n);
+    portENTER_CRITICAL(&_mux);
+    if (us > _stats.readUsMax) _stats.readUsMax = us;
+    portEXIT_CRITICAL(&_mux);
+  }
+  *data = d.block + d.pos;
+  return d.fill - d.pos;
+}
+
+void FileStream::consume(uint8_t client, size_t n) {
+  Download &d = _downloads[client];
+  d.pos += (uint16_t)n;
+  portENTER_CRITICAL(&_mux);
+  _stats.bytes += n;
+  portEXIT_CRITICAL(&_mux);
+}
+
+bool FileStream::done(uint8_t client) {
+  const Download &d = _downloads[client];
+  return !d.block || d.failed || (d.left == 0 && d.pos == d.fill);
+}
+
+void FileStream::getStats(FileStreamStats *out) const {
+  portENTER_CRITICAL(&_mux);
+  *out = _stats;
+  portEXIT_CRITICAL(&_mux);
+}
@@ -0,0 +1,80 @@
+// ============================================
+// File Download Stream - ResearchMate
+// HttpStream body read straight from a file on the card (POSIX calls on
+// the SD mount), FILE_STREAM_BLOCK bytes at a time into one internal RAM
+// block per download: a scan is never staged whole in PSRAM, and the SD
+// driver gets large multi-sector reads instead of 1KB ones. After the first
+// block, reads start on a sector boundary, so FAT can read into the block
+// directly rather than through its one-sector window.
+//
+// The handler opens the file on loop() (prepare(): one directory search,
+// and the size from the open file), then hands it to sendStream(); every
+// read after that happens on the server task, a block per peek(). The file
+// is pinned (storage/file_pins.h) from prepare() until it is closed, so a
+// delete meanwhile waits for the download and is done by it.
+// ============================================
+
+#ifndef FILE_STREAM_H
+#define FILE_STREAM_H
+
+#include "../storage/file_pins.h"
+#include "http_server.h"
+
+struct FileStreamStats {
+  uint8_t active;         // downloads being written now
+  uint32_t served;        // bodies written to the end
+  uint32_t aborted;       // client left, or a read failed, before that
+  uint32_t busy;          // turned away: FILE_STREAM_MAX already running
+  uint32_t bytes;
+  uint32_t readUsMax;     // slowest single block read
+};
+
+// Range header against a body of `size` bytes. 200: none, or one this
+// ignores (several ranges); 206: *from / *len set; 416: not satisfiable.
+int parseByteRange(const char *header, uint32_t size, uint32_t *from, uint32_t *len);
+
+class FileStream : public HttpStream {
+public:
+  explicit FileStream(FilePins *pins);
+
+  // loop(): open `path` for the next sendStream(). False if it cannot be
+  // opened, or is about to be deleted; *size is its length. The whole file is served unless range()
+  // narrows it; cancel() when answering something else instead.
+  bool prepare(const char *path, uint32_t *size);
+  void range(uint32_t from, uint32_t len);
+  void cancel();
+
+  void getStats(FileStreamStats *out) const;
+
+  // HttpStream (server task; open() on loop() inside sendStream())
+  bool open(uint8_t client) override;
+  void close(uint8_t client) override;
+  size_t peek(uint8_t client, const uint8_t **data) override;
+  void consume(uint8_t client, size_t n) override;
+  bool done(uint8_t client) override;
+
+private:
+  struct Download {
+    int fd;
+    uint8_t *block;         // nullptr: slot unused
+    uint32_t at;            // file offset of the next read
+    uint32_t left;          // bytes still to read from the file
+    uint16_t fill;          // bytes in block
+    uint16_t pos;           // ...already written
+    bool failed;
+    char path[FILE_PIN_PATH];
+  };
+
+  void release(int fd, const char *path); // close and unpin
+
+  FilePins *_pins;
+  int _fd = -1;             // prepared, not yet opened by a client
+  char _path[FILE_PIN_PATH] = {};
+  uint32_t _from = 0;
+  uint32_t _len = 0;
+  Download _downloads[HTTP_MAX_CLIENTS] = {};
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED; // guards _stats
+  FileStreamStats _stats = {};
+};
+
+#endif // FILE_STREAM_H
@@ -0,0 +1,692 @@
+#include "http_server.h"
+#include "../utils/metrics.h"
+#include <ctype.h>
+#include <errno.h>
+#include <esp_heap_caps.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <new>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define LOG_DEBUG(fmt, ...) Serial.printf(fmt "\n", ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) Serial.printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
+
+// select() timeout while a request waits for dispatch(): how soon its
+// response starts going out once loop() has built it
+#define HTTP_QUEUED_POLL_MS  2
+#define HTTP_IDLE_POLL_MS    100
+// ...and while a stream is open: how soon new stream data is noticed,
+// unless the stream allows longer (HttpStream::idleWaitMs())
+#define HTTP_STREAM_POLL_MS  5
+// Most one stream writes per pass, so a download to a fast client cannot
+// keep the task from other connections until it ends
+#define HTTP_STREAM_SLICE    16384
+
+// A stream counts when it ends (a long live view lands in +Inf)
+static MetricHistogram requestSeconds("researchmate_http_request_seconds",
+                                      "Local web requests, accepted to last byte written.", METRIC_LATENCY_US, 1e-6);
+static MetricHistogram handlerSeconds("researchmate_http_handler_seconds",
+                                      "Time loop() spent building a local web response.", METRIC_LATENCY_US, 1e-6);
+
+static const char *statusText(int code) {
+  switch (code) {
+  case 200: return "OK";
+  case 202: return "Accepted";
+  case 204: return "No Content";
+  case 206: return "Partial Content";
+  case 304: return "Not Modified";
+  case 400: return "Bad Request";
+  case 404: return "Not Found";
+  case 409: return "Conflict";
+  case 413: return "Payload Too Large";
+  case 416: return "Range Not Satisfiable";
+  case 431: return "Request Header Fields Too Large";
+  case 500: return "Internal Server Error";
+  case 503: return "Service Unavailable";
+  default: return "";
+  }
+}
+
+static bool setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Form / query decoding in place: '+' and %XX
+static void urlDecode(char *s) {
+  char *out = s;
+  for (; *s; s++) {
+    if (*s == '+') {
+      *out++ = ' ';
+    } else if (*s == '%' && hexValue(s[1]) >= 0 && hexValue(s[2]) >= 0) {
+      *out++ = (char)(hexValue(s[1]) << 4 | hexValue(s[2]));
+      s += 2;
+    } else {
+      *out++ = *s;
+    }
+  }
+  *out = '\0';
+}
+
+static bool parseMethod(const char *m, HTTPMethod *out) {
+  static const struct {
+    const char *name;
+    HTTPMethod method;
+  } methods[] = {
+      {"GET", HTTP_GET},       {"POST", HTTP_POST},     {"HEAD", HTTP_HEAD},
+      {"PUT", HTTP_PUT},       {"DELETE", HTTP_DELETE}, {"OPTIONS", HTTP_OPTIONS},
+      {"PATCH", HTTP_PATCH},
+  };
+  for (const auto &e : methods) {
+    if (strcmp(m, e.name) == 0) {
+      *out = e.method;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ============================================
+// Setup
+// ============================================
+void HttpServer::on(const char *path, HttpHandlerFn fn) { on(path, HTTP_ANY, fn); }
+
+void HttpServer::on(const char *path, HTTPMethod method, HttpHandlerFn fn) {
+  if (_routeCount >= HTTP_MAX_HANDLERS) {
+    LOG_ERROR("[HTTP] No room to register %s", path);
+    return;
+  }
+  _routes[_routeCount++] = {path, method, fn};
+}
+
+void HttpServer::collectHeaders(const char *const names[], size_t count) {
+  _collectCount = 0;
+  for (size_t i = 0; i < count && i < HTTP_MAX_COLLECT; i++) _collect[_collectCount++] = names[i];
+}
+
+bool HttpServer::begin(uint16_t port) {
+  if (_listenFd >= 0) return true; // already serving (WiFi reconnect)
+
+  if (!_conns) {
+    void *mem = heap_caps_malloc(sizeof(Conn) * HTTP_MAX_CLIENTS,
+                                 MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!mem) {
+      LOG_ERROR("[HTTP] No memory for %d connections", HTTP_MAX_CLIENTS);
+      return false;
+    }
+    _conns = (Conn *)mem;
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+      new (&_conns[i]) Conn();
+      _conns[i].fd = -1;
+      _conns[i].body = nullptr;
+      _conns[i].bodyOwned = false;
+      _conns[i].stream = nullptr;
+      _conns[i].state.store(CONN_FREE);
+    }
+  }
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    LOG_ERROR("[HTTP] socket() failed (%d)", errno);
+    return false;
+  }
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, HTTP_BACKLOG) != 0 ||
+      !setNonBlocking(fd)) {
+    LOG_ERROR("[HTTP] Cannot listen on port %u (%d)", port, errno);
+    close(fd);
+    return false;
+  }
+  _listenFd = fd;
+
+  if (xTaskCreatePinnedToCore(task, "HttpServer", 4096, this, HTTP_TASK_PRIORITY, NULL,
+                              HTTP_TASK_CORE) != pdPASS) {
+    LOG_ERROR("[HTTP] Could not start the server task");
+    close(fd);
+    _listenFd = -1;
+    return false;
+  }
+  LOG_DEBUG("[HTTP] Listening on port %u (%d clients, %d byte requests)", port, HTTP_MAX_CLIENTS,
+            HTTP_RX_BYTES);
+  return true;
+}
+
+void HttpServer::task(void *arg) {
+  HttpServer *self = (HttpServer *)arg;
+  for (;;) self->poll(HTTP_IDLE_POLL_MS);
+}
+
+// ============================================
+// Server task: socket I/O
+// ============================================
+void HttpServer::poll(uint32_t maxWaitMs) {
+  fd_set rd, wr;
+  FD_ZERO(&rd);
+  FD_ZERO(&wr);
+  int maxFd = -1;
+  bool freeSlot = false, queued = false;
+  uint32_t streamWaitMs = maxWaitMs;
+
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    Conn &c = _conns[i];
+    uint8_t st = c.state.load(std::memory_order_acquire);
+    if (st == CONN_FREE) {
+      freeSlot = true;
+      continue;
+    }
+    if (st == CONN_QUEUED) {
+      queued = true;
+      continue;
+    }
+    bool wantWrite = st == CONN_WRITING;
+    if (st == CONN_STREAMING) {
+      // Waiting on the stream is not a stall: until it has data, only
+      // watch for the client going away
+      const uint8_t *p;
+      wantWrite = c.stream->peek(i, &p) > 0;
+      if (!wantWrite && c.stream->done(i)) {
+        finishClient(c); // e.g. an empty file: nothing after the head
+        freeSlot = true;
+        continue;
+      }
+      uint32_t idleMs = wantWrite ? 0 : c.stream->idleWaitMs(i);
+      if (idleMs == 0) idleMs = HTTP_STREAM_POLL_MS;
+      if (idleMs < streamWaitMs) streamWaitMs = idleMs;
+      if (!wantWrite) c.lastIoMs = millis();
+    }
+    // Read after the state: loop() stamps lastIoMs just before handing over
+    if (millis() - c.lastIoMs > HTTP_CLIENT_TIMEOUT_MS) {
+      _stats.timeouts++;
+      closeClient(c);
+      freeSlot = true;
+      continue;
+    }
+    FD_SET(c.fd, wantWrite ? &wr : &rd);
+    if (c.fd > maxFd) maxFd = c.fd;
+  }
+  // With every slot taken, new clients wait in the listen backlog
+  if (freeSlot) {
+    FD_SET(_listenFd, &rd);
+    if (_listenFd > maxFd) maxFd = _listenFd;
+  }
+
+  uint32_t waitMs = queued ? HTTP_QUEUED_POLL_MS : streamWaitMs;
+  struct timeval tv;
+  tv.tv_sec = waitMs / 1000;
+  tv.tv_usec = (waitMs % 1000) * 1000;
+  if (maxFd < 0) {
+    // Every slot queued for loop(): nothing to select on, so sleep rather
+    // than spin on this core until dispatch() frees one
+    vTaskDelay(pdMS_TO_TICKS(waitMs));
+    return;
+  }
+  if (select(maxFd + 1, &rd, &wr, NULL, &tv) <= 0) return;
+
+  if (freeSlot && FD_ISSET(_listenFd, &rd)) acceptClients();
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    Conn &c = _conns[i];
+    if (c.fd < 0) continue;
+    uint8_t st = c.state.load(std::memory_order_acquire);
+    if (st == CONN_READING && FD_ISSET(c.fd, &rd)) readClient(c);
+    else if (st == CONN_WRITING && FD_ISSET(c.fd, &wr)) writeClient(c);
+    else if (st == CONN_STREAMING && (FD_ISSET(c.fd, &wr) || FD_ISSET(c.fd, &rd))) streamClient(c);
+  }
+}
+
+void HttpServer::acceptClients() {
+  for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    Conn &c = _conns[i];
+    if (c.state.load(std::memory_order_acquire) != CONN_FREE) continue;
+    int fd = accept(_listenFd, NULL, NULL);
+    if (fd < 0) return; // backlog empty
+    if (!setNonBlocking(fd)) {
+      close(fd);
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    c.fd = fd;
+    c.acceptUs = micros();
+    c.lastIoMs = millis();
+    c.rxLen = 0;
+    c.rx[0] = '\0';
+    c.bodyAt = -1;
+    c.contentLength = 0;
+    c.formBody = false;
+    c.method = HTTP_GET;
+    c.argc = 0;
+    memset(c.headerValue, 0, sizeof(c.headerValue));
+    c.path = "";
+    c.headLen = 0;
+    c.bodyLen = 0;
+    c.sent = 0;
+    c.stream = nullptr;
+    c.state.store(CONN_READING, std::memory_order_relaxed);
+
+    uint8_t active = 0;
+    for (int j = 0; j < HTTP_MAX_CLIENTS; j++) {
+      if (_conns[j].state.load(std::memory_order_relaxed) != CONN_FREE) active++;
+    }
+    if (active > _stats.peakActive) _stats.peakActive = active;
+  }
+}
+
+void HttpServer::readClient(Conn &c) {
+  if (c.rxLen >= HTTP_RX_BYTES) {
+    // Buffer full before the request is: headers or body too large
+    _stats.rejected++;
+    reply(c, c.bodyAt < 0 ? 431 : 413, "text/plain", NULL, 0, "", 0);
+    c.state.store(CONN_WRITING, std::memory_order_relaxed);
+    return;
+  }
+  int n = recv(c.fd, c.rx + c.rxLen, HTTP_RX_BYTES - c.rxLen, 0);
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+  if (n <= 0) {
+    closeClient(c); // peer gone before finishing its request
+    return;
+  }
+  uint16_t prevLen = c.rxLen;
+  c.rxLen += n;
+  c.rx[c.rxLen] = '\0';
+  c.lastIoMs = millis();
+
+  if (c.bodyAt < 0) {
+    const char *end = strstr(c.rx + (prevLen > 3 ? prevLen - 3 : 0), "\r\n\r\n");
+    if (!end) return;
+    c.bodyAt = (int32_t)(end + 4 - c.rx);
+    if (!parseRequest(c)) {
+      _stats.rejected++;
+      reply(c, 400, "text/plain", NULL, 0, "", 0);
+      c.state.store(CONN_WRITING, std::memory_order_relaxed);
+      return;
+    }
+    // Compared as room left, so a huge Content-Length cannot wrap the sum
+    if (c.contentLength > (uint32_t)(HTTP_RX_BYTES - c.bodyAt)) {
+      _stats.rejected++;
+      reply(c, 413, "text/plain", NULL, 0, "", 0);
+      c.state.store(CONN_WRITING, std::memory_order_relaxed);
+      return;
+    }
+  }
+  if ((uint32_t)c.rxLen < c.bodyAt + c.contentLength) return;
+
+  // Whole request in: form fields from the body, then hand it to loop()
+  char *body = c.rx + c.bodyAt;
+  body[c.contentLength] = '\0';
+  if (c.formBody) parseArgs(c, body);
+  c.seq = ++_seq;
+  c.queuedUs = micros();
+  c.state.store(CONN_QUEUED, std::memory_order_release);
+}
+
+// Request line and the headers used here, split in place; query fields
+// become args.
+bool HttpServer::parseRequest(Conn &c) {
+  char *line = c.rx;
+  char *eol = strstr(line, "\r\n");
+  if (!eol) return false;
+  *eol = '\0';
+  char *sp1 = strchr(line, ' ');
+  char *sp2 = sp1 ? strchr(sp1 + 1, ' ') : NULL;
+  if (!sp1 || !sp2) return false;
+  *sp1 = *sp2 = '\0';
+  if (!parseMethod(line, &c.method)) return false;
+
+  char *target = sp1 + 1;
+  char *query = strchr(target, '?');
+  if (query) *query++ = '\0';
+  c.path = target;
+  if (query) parseArgs(c, query);
+
+  c.rx[c.bodyAt - 2] = '\0'; // end of the header block
+  for (char *h = eol + 2; *h; ) {
+    char *next = strstr(h, "\r\n");
+    if (next) *next = '\0';
+    if (strncasecmp(h, "Content-Length:", 15) == 0) {
+      const char *v = h + 15;
+      while (*v == ' ' || *v == '\t') v++;
+      char *end;
+      errno = 0;
+      unsigned long len = strtoul(v, &end, 10);
+      while (*end == ' ' || *end == '\t') end++;
+      if (!isdigit((unsigned char)*v) || *end || errno == ERANGE || len > UINT32_MAX) return false;
+      c.contentLength = (uint32_t)len;
+    } else if (strncasecmp(h, "Content-Type:", 13) == 0) {
+      c.formBody = strstr(h + 13, "x-www-form-urlencoded") != NULL;
+    }
+    for (uint8_t i = 0; i < _collectCount; i++) {
+      size_t n = strlen(_collect[i]);
+      if (strncasecmp(h, _collect[i], n) != 0 || h[n] != ':') continue;
+      const char *v = h + n + 1;
+      while (*v == ' ') v++;
+      c.headerValue[i] = v;
+    }
+    if (!next) break;
+    h = next + 2;
+  }
+  return true;
+}
+
+void HttpServer::parseArgs(Conn &c, char *s) {
+  while (s && *s && c.argc < HTTP_MAX_ARGS) {
+    char *amp = strchr(s, '&');
+    if (amp) *amp = '\0';
+    char *eq = strchr(s, '=');
+    if (eq) *eq = '\0';
+    urlDecode(s);
+    if (eq) urlDecode(eq + 1);
+    if (*s) {
+      c.argName[c.argc] = s;
+      c.argValue[c.argc] = eq ? eq + 1 : "";
+      c.argc++;
+    }
+    s = amp ? amp + 1 : NULL;
+  }
+}
+
+void HttpServer::writeClient(Conn &c) {
+  size_t total = c.headLen + c.bodyLen;
+  while (c.sent < total) {
+    const uint8_t *p;
+    size_t len;
+    if (c.sent < c.headLen) {
+      p = (const uint8_t *)c.head + c.sent;
+      len = c.headLen - c.sent;
+    } else {
+      p = c.body + (c.sent - c.headLen);
+      len = total - c.sent;
+    }
+    int n = ::send(c.fd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (n <= 0) {
+      closeClient(c);
+      return;
+    }
+    c.sent += n;
+    c.lastIoMs = millis();
+    _stats.bytesOut += n;
+  }
+  if (c.stream) {
+    // Headers out: the stream takes over the connection
+    c.state.store(CONN_STREAMING, std::memory_order_relaxed);
+    return;
+  }
+  finishClient(c);
+}
+
+// Response fully written
+void HttpServer::finishClient(Conn &c) {
+  uint32_t us = micros() - c.acceptUs;
+  requestSeconds.observe(us);
+  _stats.totalUs = us;
+  if (us > _stats.totalUsMax) _stats.totalUsMax = us;
+  // Smoothed over the last ~8 responses
+  _stats.totalUsAvg = _stats.totalUsAvg ? _stats.totalUsAvg - _stats.totalUsAvg / 8 + us / 8 : us;
+  closeClient(c);
+}
+
+// Stream body: write until the socket is full, the stream has nothing more
+// or this pass's slice is used. Anything the client sends is drained; EOF
+// means it has gone.
+void HttpServer::streamClient(Conn &c) {
+  uint8_t id = (uint8_t)(&c - _conns);
+  char scrap[64];
+  int r = recv(c.fd, scrap, sizeof(scrap), MSG_DONTWAIT);
+  if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    closeClient(c);
+    return;
+  }
+  for (size_t slice = 0; slice < HTTP_STREAM_SLICE;) {
+    const uint8_t *p;
+    size_t len = c.stream->peek(id, &p);
+    if (len == 0) {
+      if (c.stream->done(id)) finishClient(c);
+      return;
+    }
+    int n = ::send(c.fd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (n <= 0) {
+      closeClient(c);
+      return;
+    }
+    c.stream->consume(id, n);
+    c.lastIoMs = millis();
+    _stats.bytesOut += n;
+    slice += n;
+  }
+}
+
+void HttpServer::closeClient(Conn &c) {
+  if (c.stream) c.stream->close((uint8_t)(&c - _conns));
+  c.stream = nullptr;
+  if (c.fd >= 0) close(c.fd);
+  c.fd = -1;
+  if (c.bodyOwned) heap_caps_free((void *)c.body);
+  c.body = nullptr;
+  c.bodyOwned = false;
+  c.bodyLen = 0;
+  c.state.store(CONN_FREE, std::memory_order_release);
+}
+
+// Status line + headers into c.head, body copied to the heap (or, for
+// sendStatic(), pointed at). Used by the task for its own errors and by
+// send() on loop().
+void HttpServer::reply(Conn &c, int code, const char *contentType, const uint8_t *data, size_t len,
+                       const char *extra, uint16_t extraLen, bool copy) {
+  c.body = nullptr;
+  c.bodyLen = 0;
+  c.bodyOwned = false;
+  if (len > 0 && c.method != HTTP_HEAD && !copy) {
+    c.body = data;
+    c.bodyLen = len;
+  } else if (len > 0 && c.method != HTTP_HEAD) {
+    uint8_t *body = nullptr;
+    if (len <= HTTP_TX_MAX_BYTES) {
+      body = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      if (!body) body = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_8BIT);
+    }
+    if (!body) {
+      _stats.noMemory++;
+      code = 503;
+      contentType = "text/plain";
+      len = 0;
+      extraLen = 0;
+    } else {
+      memcpy(body, data, len);
+      c.body = body;
+      c.bodyLen = len;
+      c.bodyOwned = true;
+    }
+  }
+
+  int n = snprintf(c.head, sizeof(c.head),
+                   "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n%.*s"
+                   "Connection: close\r\n\r\n",
+                   code, statusText(code), contentType, (unsigned)len, extraLen, extra);
+  c.headLen = (uint16_t)(n < (int)sizeof(c.head) ? n : sizeof(c.head) - 1);
+  c.sent = 0;
+  c.lastIoMs = millis();
+}
+
+// ============================================
+// loop(): handlers
+// ============================================
+const HttpServer::Route *HttpServer::route(const Conn &c, bool *pathKnown) const {
+  *pathKnown = false;
+  for (uint8_t i = 0; i < _routeCount; i++) {
+    const Route &r = _routes[i];
+    size_t n = strlen(r.path);
+    bool match = n > 0 && r.path[n - 1] == '*' ? strncmp(r.path, c.path, n - 1) == 0
+                                               : strcmp(r.path, c.path) == 0;
+    if (!match) continue;
+    *pathKnown = true;
+    if (r.method == HTTP_ANY || r.method == c.method) return &r;
+    if (r.method == HTTP_GET && c.method == HTTP_HEAD) return &r; // body dropped by reply()
+  }
+  return nullptr;
+}
+
+uint8_t HttpServer::dispatch() {
+  if (!_conns) return 0;
+  uint8_t handled = 0;
+  // At most one pass over the slots, so a stream of new requests cannot keep
+  // loop() here
+  for (int n = 0; n < HTTP_MAX_CLIENTS; n++) {
+    Conn *c = nullptr;
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+      Conn &q = _conns[i];
+      if (q.state.load(std::memory_order_acquire) == CONN_QUEUED && (!c || q.seq < c->seq)) c = &q;
+    }
+    if (!c) break;
+
+    uint32_t t0 = micros();
+    _stats.queueUs = t0 - c->queuedUs;
+    if (_stats.queueUs > _stats.queueUsMax) _stats.queueUsMax = _stats.queueUs;
+    _cur = c;
+    _replied = false;
+    _extraLen = 0;
+
+    bool pathKnown;
+    const Route *r = route(*c, &pathKnown);
+    if (r) {
+      _stats.requests++;
+      r->fn();
+      if (!_replied) send(500, "text/plain", String("Handler sent no response"));
+    } else {
+      _stats.notFound++;
+      send(404, "text/plain", String("Not found"));
+    }
+
+    _cur = nullptr;
+    _stats.handlerUs = micros() - t0;
+    handlerSeconds.observe(_stats.handlerUs);
+    if (_stats.handlerUs > _stats.handlerUsMax) _stats.handlerUsMax = _stats.handlerUs;
+    c->state.store(CONN_WRITING, std::memory_order_release);
+    handled++;
+  }
+  return handled;
+}
+
+HTTPMethod HttpServer::method() const { return _cur ? _cur->method : HTTP_GET; }
+
+String HttpServer::uri() const { return String(_cur ? _cur->path : ""); }
+
+bool HttpServer::hasArg(const char *name) const {
+  if (!_cur) return false;
+  for (uint8_t i = 0; i < _cur->argc; i++) {
+    if (strcmp(_cur->argName[i], name) == 0) return true;
+  }
+  return false;
+}
+
+String HttpServer::arg(const char *name) const {
+  if (!_cur) return String();
+  for (uint8_t i = 0; i < _cur->argc; i++) {
+    if (strcmp(_cur->argName[i], name) == 0) return String(_cur->argValue[i]);
+  }
+  return String();
+}
+
+String HttpServer::header(const char *name) const {
+  if (!_cur) return String();
+  for (uint8_t i = 0; i < _collectCount; i++) {
+    if (strcasecmp(_collect[i], name) == 0 && _cur->headerValue[i]) return String(_cur->headerValue[i]);
+  }
+  return String();
+}
+
+void HttpServer::sendHeader(const char *name, const char *value) {
+  int room = (int)sizeof(_extra) - _extraLen;
+  int n = snprintf(_extra + _extraLen, room, "%s: %s\r\n", name, value);
+  if (n > 0 && n < room) _extraLen += n;
+  else _extra[_extraLen] = '\0'; // dropped: does not fit
+}
+
+void HttpServer::send(int code, const char *contentType, const String &body) {
+  send(code, contentType, (const uint8_t *)body.c_str(), body.length());
+}
+
+void HttpServer::send(int code, const char *contentType, const uint8_t *data, size_t len) {
+  if (!_cur || _replied) return;
+  _replied = true;
+  reply(*_cur, code, contentType, data, len, _extra, _extraLen);
+}
+
+void HttpServer::sendStatic(int code, const char *contentType, const uint8_t *data, size_t len) {
+  if (!_cur || _replied) return;
+  _replied = true;
+  reply(*_cur, code, contentType, data, len, _extra, _extraLen, false);
+}
+
+bool HttpServer::sendStream(const char *contentType, HttpStream *stream) {
+  return startStream(200, contentType, -1, stream);
+}
+
+bool HttpServer::sendStream(int code, const char *contentType, uint32_t contentLength,
+                            HttpStream *stream) {
+  return startStream(code, contentType, contentLength, stream);
+}
+
+// contentLength < 0: open-ended, the body runs until the client leaves
+bool HttpServer::startStream(int code, const char *contentType, int64_t contentLength,
+                             HttpStream *stream) {
+  if (!_cur || _replied) return false;
+  Conn &c = *_cur;
+  char length[32] = "";
+  if (contentLength >= 0) {
+    snprintf(length, sizeof(length), "Content-Length: %lu\r\n", (unsigned long)contentLength);
+  }
+  bool headOnly = c.method == HTTP_HEAD;
+  if (!headOnly) {
+    // Connections already given to streams (set here, cleared by the task
+    // as they close, so a stale read only errs towards refusing)
+    uint8_t streams = 0;
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+      if (_conns[i].stream) streams++;
+    }
+    if (streams >= HTTP_MAX_CLIENTS - HTTP_REQUEST_SLOTS) {
+      _stats.streamsFull++;
+      return false;
+    }
+    if (!stream->open((uint8_t)(&c - _conns))) return false;
+  }
+  _replied = true;
+  int n = snprintf(c.head, sizeof(c.head),
+                   "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n%s%.*sConnection: close\r\n\r\n",
+                   code, statusText(code), contentType, length, _extraLen, _extra);
+  c.headLen = (uint16_t)(n < (int)sizeof(c.head) ? n : sizeof(c.head) - 1);
+  c.body = nullptr;
+  c.bodyLen = 0;
+  c.bodyOwned = false;
+  c.sent = 0;
+  c.stream = headOnly ? nullptr : stream;
+  c.lastIoMs = millis();
+  return true;
+}
+
+void HttpServer::getStats(HttpServerStats *out) const {
+  *out = _stats;
+  out->active = 0;
+  out->streaming = 0;
+  for (int i = 0; _conns && i < HTTP_MAX_CLIENTS; i++) {
+    uint8_t st = _conns[i].state.load(std::memory_order_relaxed);
+    if (st != CONN_FREE) out->active++;
+    if (st == CONN_STREAMING) out->streaming++;
+  }
+}
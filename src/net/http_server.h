@@ -0,0 +1,200 @@
+// ============================================
+// Local HTTP Server - ResearchMate
+// Socket I/O runs on its own task: non-blocking sockets behind one
+// select(), up to HTTP_MAX_CLIENTS connections at once, each with a fixed
+// HTTP_RX_BYTES request buffer. A slow or stalled client only ever holds its
+// own slot (and is dropped after HTTP_CLIENT_TIMEOUT_MS), never loop().
+//
+// Handlers still run on loop()'s task, from dispatch(), so they can touch
+// the camera and display as before; a finished request waits there only
+// for the current loop pass. The response is copied out (PSRAM for large
+// bodies) and written back by the server task, so a handler returns as soon
+// as it has called send(). Anything slower than that (cloud round trips)
+// belongs in a job (net/web_jobs.h) answered with 202.
+//
+// The handler API mirrors WebServer's: on(), arg(), hasArg(), method(),
+// sendHeader(), send(). A path ending in '*' matches every path that starts
+// with the rest of it; the handler reads uri() for the remainder. Every
+// response closes its connection once written. A stream (sendStream()) has
+// its body fed by an HttpStream, still written by the server task: for as
+// long as the client stays connected, or, given a length, until the stream
+// says it is done (a file from SD).
+// ============================================
+
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include "../config.h"
+#include <Arduino.h>
+#include <HTTP_Method.h>
+#include <atomic>
+
+#define HTTP_MAX_HANDLERS  32
+#define HTTP_MAX_ARGS      12
+#define HTTP_HEADER_BYTES  384   // status line + headers of one response
+#define HTTP_MAX_COLLECT   4     // request headers kept for handlers
+
+typedef void (*HttpHandlerFn)();
+
+// Body source of a long-lived response (MJPEG, events). Called by the
+// server task, except open(), which runs on loop() inside the handler.
+class HttpStream {
+public:
+  virtual ~HttpStream() {}
+  // Connection slot `client` joins; false when the source is full
+  virtual bool open(uint8_t client) = 0;
+  virtual void close(uint8_t client) = 0;
+  // Next bytes for `client` (0: nothing yet). `data` stays valid until
+  // consume(); `n` of them were written.
+  virtual size_t peek(uint8_t client, const uint8_t **data) = 0;
+  virtual void consume(uint8_t client, size_t n) = 0;
+  // Whole body written (or it cannot be finished): the connection closes
+  // once peek() has nothing more
+  virtual bool done(uint8_t client) { return false; }
+  // How long the server task may sleep while peek() has nothing for
+  // `client`; 0: its own short stream poll. A source that fills slowly
+  // (events) saves the task most of its wakeups.
+  virtual uint32_t idleWaitMs(uint8_t client) { return 0; }
+};
+
+struct HttpServerStats {
+  uint32_t requests;      // handed to a handler
+  uint32_t notFound;
+  uint32_t rejected;      // malformed or larger than HTTP_RX_BYTES (answered by the task)
+  uint32_t timeouts;      // clients dropped for stalling
+  uint32_t noMemory;      // response body could not be buffered (503)
+  uint32_t streamsFull;   // streams refused: all but HTTP_REQUEST_SLOTS held by streams
+  uint8_t active;         // connections open now
+  uint8_t peakActive;
+  uint8_t streaming;      // of those, held by a stream
+  uint32_t queueUs;       // last request: parsed -> handler started (loop pass wait)
+  uint32_t queueUsMax;
+  uint32_t handlerUs;     // last request: handler run time on loop()
+  uint32_t handlerUsMax;
+  uint32_t totalUs;       // last response: accepted -> last byte written
+  uint32_t totalUsMax;
+  uint32_t totalUsAvg;
+  uint32_t bytesOut;
+};
+
+class HttpServer {
+public:
+  // Handlers are registered before begin(); an unmatched path gets a 404.
+  void on(const char *path, HttpHandlerFn fn);
+  void on(const char *path, HTTPMethod method, HttpHandlerFn fn);
+  // Request headers handlers may read with header(); others are skipped
+  void collectHeaders(const char *const names[], size_t count);
+
+  // Opens the listening socket and starts the server task. False when the
+  // socket or connection memory cannot be had.
+  bool begin(uint16_t port);
+
+  // loop(): run the handler of every request the task has finished reading.
+  // Returns the number handled.
+  uint8_t dispatch();
+
+  // Server task body: one select() pass of at most maxWaitMs.
+  void poll(uint32_t maxWaitMs);
+
+  // Request being handled (valid inside a handler only)
+  HTTPMethod method() const;
+  String uri() const;
+  bool hasArg(const char *name) const;
+  String arg(const char *name) const;
+  String header(const char *name) const;
+
+  // Response (first send() wins; later calls are ignored)
+  void sendHeader(const char *name, const char *value);
+  void sendHeader(const char *name, const String &value) { sendHeader(name, value.c_str()); }
+  // Drop the headers queued so far: the answer turned out to be another one
+  void clearHeaders() { _extraLen = 0; }
+  void send(int code, const char *contentType, const String &body);
+  // Binary body, copied: the caller may free `data` as soon as this returns
+  void send(int code, const char *contentType, const uint8_t *data, size_t len);
+  // Body that outlives the connection (flash constants): written as is
+  void sendStatic(int code, const char *contentType, const uint8_t *data, size_t len);
+  // Headers now, then whatever `stream` produces until the client leaves.
+  // False (nothing sent) when the stream turns the client away, or when
+  // streams already hold all but HTTP_REQUEST_SLOTS connections (every
+  // open page keeps a live view and an event stream, so without a shared
+  // cap a few tabs would leave ordinary requests waiting in the backlog).
+  bool sendStream(const char *contentType, HttpStream *stream);
+  // Same with a known body length, closed when the stream is done(). HEAD
+  // gets the headers only, without opening the stream.
+  bool sendStream(int code, const char *contentType, uint32_t contentLength, HttpStream *stream);
+
+  void getStats(HttpServerStats *out) const;
+
+private:
+  enum ConnState : uint8_t {
+    CONN_FREE,      // no socket                       (server task)
+    CONN_READING,   // receiving the request           (server task)
+    CONN_QUEUED,    // complete, waiting for dispatch() (loop)
+    CONN_WRITING,   // response being written          (server task)
+    CONN_STREAMING, // body fed by an HttpStream        (server task)
+  };
+
+  struct Conn {
+    std::atomic<uint8_t> state;
+    int fd;
+    uint32_t acceptUs;
+    uint32_t lastIoMs;
+    uint32_t queuedUs;
+    uint32_t seq;           // parse order, so dispatch() is first come first served
+    uint16_t rxLen;
+    int32_t bodyAt;         // offset of the body, -1 until the headers are in
+    uint32_t contentLength;
+    bool formBody;
+    HTTPMethod method;
+    const char *path;
+    uint8_t argc;
+    const char *argName[HTTP_MAX_ARGS];
+    const char *argValue[HTTP_MAX_ARGS];
+    const char *headerValue[HTTP_MAX_COLLECT];
+    char head[HTTP_HEADER_BYTES];
+    uint16_t headLen;
+    const uint8_t *body;
+    size_t bodyLen;
+    bool bodyOwned;         // heap copy, freed on close
+    size_t sent;            // head + body bytes written
+    HttpStream *stream;     // set by sendStream(): stays open after the head
+    char rx[HTTP_RX_BYTES + 1];
+  };
+
+  struct Route {
+    const char *path;
+    HTTPMethod method;
+    HttpHandlerFn fn;
+  };
+
+  static void task(void *arg);
+  void acceptClients();
+  void readClient(Conn &c);
+  void writeClient(Conn &c);
+  void streamClient(Conn &c);
+  void finishClient(Conn &c);
+  void closeClient(Conn &c);
+  bool parseRequest(Conn &c);
+  void parseArgs(Conn &c, char *s);
+  void reply(Conn &c, int code, const char *contentType, const uint8_t *data, size_t len,
+             const char *extra, uint16_t extraLen, bool copy = true);
+  const Route *route(const Conn &c, bool *pathKnown) const;
+  bool startStream(int code, const char *contentType, int64_t contentLength, HttpStream *stream);
+
+  Route _routes[HTTP_MAX_HANDLERS];
+  uint8_t _routeCount = 0;
+  const char *_collect[HTTP_MAX_COLLECT] = {};
+  uint8_t _collectCount = 0;
+  int _listenFd = -1;
+  Conn *_conns = nullptr;
+  uint32_t _seq = 0;
+
+  Conn *_cur = nullptr;       // request being handled by dispatch()
+  bool _replied = false;
+  char _extra[HTTP_HEADER_BYTES / 2]; // sendHeader() lines for the current response
+  uint16_t _extraLen = 0;
+
+  HttpServerStats _stats = {};
+};
+
+#endif // HTTP_SERVER_H
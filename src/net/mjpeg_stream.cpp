@@ -0,0 +1,255 @@
+#include "mjpeg_stream.h"
+#include <esp_heap_caps.h>
+
+MjpegStream::MjpegStream(ReturnFn giveBack) : _giveBack(giveBack) {}
+
+// ============================================
+// Grabber side
+// ============================================
+void MjpegStream::offer(const uint8_t *jpg, size_t len, void *token) {
+  char part[sizeof(_lent.part)];
+  int partLen = snprintf(part, sizeof(part),
+                         "--" MJPEG_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
+                         (unsigned)len);
+  uint32_t now = millis();
+
+  portENTER_CRITICAL(&_mux);
+  uint8_t viewers = 0, idle = 0;
+  for (const Viewer &v : _viewers) {
+    if (!v.open) continue;
+    viewers++;
+    if (!v.frame) idle++;
+  }
+  if (viewers == 0) {
+    portEXIT_CRITICAL(&_mux);
+    return;
+  }
+  _stats.offered++;
+  // One camera buffer out at a time, so the driver always has one to fill
+  bool lend = idle > 0 && _lent.refs == 0;
+  if (idle > 0 && !lend) _stats.refused++;
+  if (lend) {
+    _lent.jpg = jpg;
+    _lent.len = len;
+    _lent.token = token;
+    _lent.refs = 1 + idle;
+    _lent.grabberRef = true;
+    _lent.copyFailed = false;
+    _lent.lentMs = now;
+    memcpy(_lent.part, part, partLen);
+    _lent.partLen = (uint8_t)partLen;
+    _stats.lent++;
+  }
+  for (Viewer &v : _viewers) {
+    if (!v.open) continue;
+    if (lend && !v.frame) {
+      v.frame = &_lent;
+      v.off = 0;
+    } else {
+      v.dropped++;
+    }
+  }
+  portEXIT_CRITICAL(&_mux);
+}
+
+void MjpegStream::release(void *token) {
+  void *back = token;
+  portENTER_CRITICAL(&_mux);
+  if (_lent.token == token && _lent.grabberRef) {
+    _lent.grabberRef = false;
+    back = unref(&_lent);
+  }
+  portEXIT_CRITICAL(&_mux);
+  if (back) _giveBack(back);
+}
+
+bool MjpegStream::wanted() const {
+  for (const Viewer &v : _viewers) {
+    if (v.open) return true;
+  }
+  return false;
+}
+
+bool MjpegStream::reclaim(uint32_t timeoutMs) {
+  uint32_t start = millis();
+  for (;;) {
+    portENTER_CRITICAL(&_mux);
+    bool out = _lent.refs != 0;
+    portEXIT_CRITICAL(&_mux);
+    if (!out) return true;
+    if (millis() - start >= timeoutMs) return false;
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+}
+
+void *MjpegStream::unref(Frame *f) {
+  if (--f->refs > 0) return nullptr;
+  if (f == &_lent) {
+    uint32_t ms = millis() - f->lentMs;
+    if (ms > _stats.lendMsMax) _stats.lendMsMax = ms;
+  }
+  void *token = f->token;
+  f->token = nullptr;
+  f->jpg = nullptr;
+  return token;
+}
+
+// Viewers still on the lent buffer after STREAM_LEND_MS move to a PSRAM
+// copy of it. Server task only: the copy buffers are never touched
+// elsewhere, and the lent frame cannot go away while the calling viewer
+// holds it.
+void MjpegStream::spill() {
+  int slot = -1;
+  portENTER_CRITICAL(&_mux);
+  for (int i = 0; i < STREAM_MAX_CLIENTS && !_lent.copyFailed; i++) {
+    if (_copy[i].refs == 0) {
+      slot = i;
+      break;
+    }
+  }
+  size_t len = _lent.len;
+  portEXIT_CRITICAL(&_mux);
+  if (slot < 0) return;
+
+  if (len > _copyCap[slot]) {
+    heap_caps_free(_copyBuf[slot]);
+    _copyBuf[slot] = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    _copyCap[slot] = _copyBuf[slot] ? len : 0;
+  }
+  if (!_copyBuf[slot]) {
+    portENTER_CRITICAL(&_mux);
+    _lent.copyFailed = true;
+    _stats.spillFailed++;
+    portEXIT_CRITICAL(&_mux);
+    return;
+  }
+  memcpy(_copyBuf[slot], _lent.jpg, len);
+
+  Frame &copy = _copy[slot];
+  void *back = nullptr;
+  portENTER_CRITICAL(&_mux);
+  copy.jpg = _copyBuf[slot];
+  copy.len = len;
+  copy.token = nullptr;
+  copy.refs = 0;
+  copy.grabberRef = false;
+  memcpy(copy.part, _lent.part, _lent.partLen);
+  copy.partLen = _lent.partLen;
+  for (Viewer &v : _viewers) {
+    if (v.frame != &_lent) continue;
+    v.frame = &copy; // same bytes, so v.off carries over
+    copy.refs++;
+    void *t = unref(&_lent);
+    if (t) back = t;
+  }
+  _stats.spills++;
+  portEXIT_CRITICAL(&_mux);
+  if (back) _giveBack(back);
+}
+
+// ============================================
+// Viewer side (server task; open() from the /stream handler on loop())
+// ============================================
+bool MjpegStream::open(uint8_t client) {
+  if (client >= HTTP_MAX_CLIENTS) return false;
+  uint32_t now = millis();
+  portENTER_CRITICAL(&_mux);
+  uint8_t viewers = 0;
+  for (const Viewer &v : _viewers) {
+    if (v.open) viewers++;
+  }
+  bool ok = viewers < STREAM_MAX_CLIENTS && !_viewers[client].open;
+  if (ok) {
+    _viewers[client] = {};
+    _viewers[client].open = true;
+    _viewers[client].openMs = now;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return ok;
+}
+
+void MjpegStream::close(uint8_t client) {
+  Viewer &v = _viewers[client];
+  void *back = nullptr;
+  portENTER_CRITICAL(&_mux);
+  if (v.frame) back = unref(v.frame);
+  v.frame = nullptr;
+  v.open = false;
+  portEXIT_CRITICAL(&_mux);
+  if (back) _giveBack(back);
+}
+
+size_t MjpegStream::peek(uint8_t client, const uint8_t **data) {
+  Viewer &v = _viewers[client];
+  uint32_t now = millis();
+  portENTER_CRITICAL(&_mux);
+  Frame *f = v.frame;
+  bool slow = f == &_lent && now - _lent.lentMs > STREAM_LEND_MS;
+  portEXIT_CRITICAL(&_mux);
+  if (!f) return 0;
+  if (slow) {
+    spill();
+    f = v.frame;
+  }
+
+  // Stable while this viewer holds it: offer() only refills a free frame
+  size_t off = v.off;
+  if (off < f->partLen) {
+    *data = (const uint8_t *)f->part + off;
+    return f->partLen - off;
+  }
+  off -= f->partLen;
+  if (off < f->len) {
+    *data = f->jpg + off;
+    return f->len - off;
+  }
+  off -= f->len;
+  *data = (const uint8_t *)"\r\n" + off;
+  return 2 - off;
+}
+
+void MjpegStream::consume(uint8_t client, size_t n) {
+  Viewer &v = _viewers[client];
+  void *back = nullptr;
+  portENTER_CRITICAL(&_mux);
+  Frame *f = v.frame;
+  v.off += n;
+  v.bytes += n;
+  if (f && v.off >= f->partLen + f->len + 2) {
+    back = unref(f);
+    v.frame = nullptr;
+    v.frames++;
+  }
+  portEXIT_CRITICAL(&_mux);
+  if (back) _giveBack(back);
+}
+
+void MjpegStream::getStats(MjpegStreamStats *out) const {
+  uint32_t now = millis();
+  portENTER_CRITICAL(&_mux);
+  *out = _stats;
+  out->viewers = 0;
+  out->copiesInUse = 0;
+  for (const Frame &f : _copy) {
+    if (f.refs) out->copiesInUse++;
+  }
+  for (uint8_t i = 0; i < HTTP_MAX_CLIENTS; i++) {
+    const Viewer &v = _viewers[i];
+    if (!v.open) continue;
+    MjpegViewerStats &s = out->viewer[out->viewers++];
+    s.open = true;
+    s.slot = i;
+    s.connectedMs = now - v.openMs;
+    s.frames = v.frames;
+    s.dropped = v.dropped;
+    s.bytes = v.bytes;
+  }
+  portEXIT_CRITICAL(&_mux);
+
+  for (uint8_t i = 0; i < out->viewers; i++) {
+    MjpegViewerStats &s = out->viewer[i];
+    uint32_t ms = s.connectedMs ? s.connectedMs : 1;
+    s.fpsX10 = (uint16_t)((uint64_t)s.frames * 10000 / ms);
+    s.kbps = (uint32_t)((uint64_t)s.bytes * 8 / ms);
+  }
+}
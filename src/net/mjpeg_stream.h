@@ -0,0 +1,113 @@
+// ============================================
+// MJPEG Live Stream - ResearchMate
+// multipart/x-mixed-replace body for /stream, fanned out to every viewer
+// from the camera buffer the TFT preview grabbed: no per-viewer copies, and
+// no extra grabs while the preview is running.
+//
+// A grabbed frame is offered to the stream and lent to every viewer that
+// is between frames; it goes back to the camera once the grabber and all
+// of those viewers are done with it (reference count). A viewer still
+// writing when the next frame is offered skips that one. Only one camera
+// buffer is ever lent, and only for STREAM_LEND_MS: viewers still on it
+// then are moved to a PSRAM copy so the buffer returns to the driver. There
+// is a copy slot per possible viewer, so one is always free for that.
+//
+// Grabber side: offer()/release() from the preview decode task (or loop()
+// while the preview is off). Viewer side: HttpStream calls from the server
+// task. Shared state is under one spinlock.
+// ============================================
+
+#ifndef MJPEG_STREAM_H
+#define MJPEG_STREAM_H
+
+#include "http_server.h"
+
+#define MJPEG_BOUNDARY "researchmate-frame"
+
+struct MjpegViewerStats {
+  bool open;
+  uint8_t slot;           // HTTP connection slot
+  uint32_t connectedMs;
+  uint32_t frames;        // frames fully written
+  uint32_t dropped;       // frames offered while this viewer was still busy
+  uint32_t bytes;
+  uint16_t fpsX10;        // since connecting
+  uint32_t kbps;
+};
+
+struct MjpegStreamStats {
+  uint8_t viewers;
+  uint32_t offered;       // frames grabbed while someone was watching
+  uint32_t lent;          // ...handed to at least one viewer
+  uint32_t refused;       // ...not lent: the previous buffer was still out
+  uint32_t spills;        // lent buffers copied out for slow viewers
+  uint32_t spillFailed;   // no PSRAM for the copy: buffer kept until they finish
+  uint8_t copiesInUse;
+  uint32_t lendMsMax;     // longest a camera buffer stayed out
+  MjpegViewerStats viewer[HTTP_MAX_CLIENTS];
+};
+
+class MjpegStream : public HttpStream {
+public:
+  typedef void (*ReturnFn)(void *token);
+
+  // `giveBack` returns a grabbed frame to the camera (any task)
+  explicit MjpegStream(ReturnFn giveBack);
+
+  // Grabber: share a just-grabbed JPEG; then call release() with the same
+  // token instead of returning the frame, whether or not it was taken.
+  void offer(const uint8_t *jpg, size_t len, void *token);
+  void release(void *token);
+
+  // Any viewer connected (loop() grabs for them while the preview is off)
+  bool wanted() const;
+
+  // loop(), before driving the camera itself (preview suspended): wait up
+  // to timeoutMs for the lent buffer to come back.
+  bool reclaim(uint32_t timeoutMs);
+
+  void getStats(MjpegStreamStats *out) const;
+
+  // HttpStream (server task)
+  bool open(uint8_t client) override;
+  void close(uint8_t client) override;
+  size_t peek(uint8_t client, const uint8_t **data) override;
+  void consume(uint8_t client, size_t n) override;
+
+private:
+  struct Frame {
+    const uint8_t *jpg;
+    size_t len;
+    void *token;            // camera frame; nullptr for the PSRAM copy
+    uint8_t refs;           // viewers on it, + the grabber until release()
+    bool grabberRef;
+    bool copyFailed;        // no PSRAM for a copy of this one: not retried
+    uint32_t lentMs;
+    char part[96];          // boundary + part headers
+    uint8_t partLen;
+  };
+
+  struct Viewer {
+    bool open;
+    Frame *frame;           // being written; nullptr between frames
+    size_t off;             // into part + jpg + "\r\n"
+    uint32_t openMs;
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t bytes;
+  };
+
+  void *unref(Frame *f);    // under the lock; token to give back, if any
+  void spill();
+
+  ReturnFn _giveBack;
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+  Frame _lent = {};                      // camera buffer
+  Frame _copy[STREAM_MAX_CLIENTS] = {};  // slow viewers of earlier frames
+  uint8_t *_copyBuf[STREAM_MAX_CLIENTS] = {}; // server task only
+  size_t _copyCap[STREAM_MAX_CLIENTS] = {};
+  Viewer _viewers[HTTP_MAX_CLIENTS] = {};
+  MjpegStreamStats _stats = {};
+};
+
+#endif // MJPEG_STREAM_H
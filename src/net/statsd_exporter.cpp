@@ -0,0 +1,251 @@
+#include "statsd_exporter.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <esp_heap_caps.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define LOG_DEBUG(fmt, ...) Serial.printf(fmt "\n", ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) Serial.printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
+
+// Totals kept per metric: a counter's value; a histogram's cumulative
+// bucket counts (the last one, +Inf, is its count), then its sum. Each line
+// sent reports one of them, so any datagram can go out or be dropped on
+// its own.
+static uint16_t slotsOf(const Metric &m) {
+  switch (m.type) {
+  case METRIC_COUNTER: return 1;
+  case METRIC_HISTOGRAM: return static_cast<const MetricHistogram &>(m).bucketCount + 2;
+  default: return 0;
+  }
+}
+
+bool StatsdExporter::begin(const char *host, uint16_t port, const char *pen) {
+  if (_fd >= 0) return true;
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+    LOG_ERROR("[StatsD] Not an IPv4 address: %s", host);
+    return false;
+  }
+
+  uint32_t slots = 0;
+  for (const Metric *m = metricsFirst(); m; m = m->next()) slots += slotsOf(*m);
+  if (slots > UINT16_MAX) slots = UINT16_MAX;
+  _sent = (uint64_t *)heap_caps_malloc(2 * slots * sizeof(uint64_t) + 1, MALLOC_CAP_8BIT);
+  if (!_sent) {
+    LOG_ERROR("[StatsD] No memory for %lu totals", (unsigned long)slots);
+    return false;
+  }
+  memset(_sent, 0, 2 * slots * sizeof(uint64_t));
+  _now = _sent + slots;
+  _slots = (uint16_t)slots;
+  _pen = pen;
+
+  // Connected, so a collector that is known to be gone (ICMP unreachable)
+  // shows up as an error on the next send; non-blocking, so a full buffer
+  // does too
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  int flags = fd >= 0 ? fcntl(fd, F_GETFL, 0) : -1;
+  if (fd < 0 || flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0 ||
+      connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    LOG_ERROR("[StatsD] Cannot open a socket to %s:%u (%d)", host, port, errno);
+    if (fd >= 0) close(fd);
+    heap_caps_free(_sent);
+    _sent = _now = nullptr;
+    return false;
+  }
+  _fd = fd;
+
+  if (xTaskCreatePinnedToCore(task, "statsd", 4096, this, 1, NULL, 0) != pdPASS) {
+    LOG_ERROR("[StatsD] Could not start the flush task");
+    close(fd);
+    _fd = -1;
+    heap_caps_free(_sent);
+    _sent = _now = nullptr;
+    return false;
+  }
+  portENTER_CRITICAL(&_mux);
+  _stats.running = true;
+  portEXIT_CRITICAL(&_mux);
+  LOG_DEBUG("[StatsD] Pushing %u totals to %s:%u every %u ms", _slots, host, port,
+            (unsigned)STATSD_FLUSH_MS);
+  return true;
+}
+
+void StatsdExporter::task(void *arg) {
+  StatsdExporter *self = (StatsdExporter *)arg;
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(STATSD_FLUSH_MS));
+    self->flush();
+  }
+}
+
+// ============================================
+// Flush
+// ============================================
+void StatsdExporter::flush() {
+  if (_fd < 0) return;
+  uint32_t t0 = micros();
+  metricsCollect();
+
+  _len = 0;
+  _lines = 0;
+  _packetFrom = 0;
+  _cursor = 0;
+  _dropped = false;
+  for (const Metric *m = metricsFirst(); m && !_dropped; m = m->next()) {
+    uint16_t n = slotsOf(*m);
+    if (_cursor + n > _slots) break; // registered after begin(): not tracked
+    addMetric(*m);
+  }
+  if (!_dropped) {
+    _cursor = _slots;
+    if (_len) sendPacket();
+  }
+
+  uint32_t us = micros() - t0;
+  portENTER_CRITICAL(&_mux);
+  _stats.flushes++;
+  _stats.flushUs = us;
+  if (us > _stats.flushUsMax) _stats.flushUsMax = us;
+  portEXIT_CRITICAL(&_mux);
+}
+
+void StatsdExporter::addMetric(const Metric &m) {
+  char value[24];
+  switch (m.type) {
+  case METRIC_COUNTER: {
+    uint64_t v = static_cast<const MetricCounter &>(m).value();
+    _now[_cursor] = v;
+    if (v != _sent[_cursor]) {
+      snprintf(value, sizeof(value), "%llu", (unsigned long long)(v - _sent[_cursor]));
+      line(m, "", value, "c", nullptr);
+    }
+    _cursor++;
+    break;
+  }
+  case METRIC_GAUGE: {
+    const MetricGauge &g = static_cast<const MetricGauge &>(m);
+    if (g.scale == 1) {
+      snprintf(value, sizeof(value), "%ld", (long)g.value());
+    } else {
+      snprintf(value, sizeof(value), "%.9g", g.value() * g.scale);
+    }
+    line(m, "", value, "g", nullptr);
+    break;
+  }
+  case METRIC_HISTOGRAM: {
+    const MetricHistogram &h = static_cast<const MetricHistogram &>(m);
+    uint16_t first = _cursor;
+    uint64_t total = 0;
+    for (uint8_t i = 0; i <= h.bucketCount; i++) {
+      total += h.bucket(i);
+      _now[first + i] = total;
+    }
+    _now[first + h.bucketCount + 1] = h.sum();
+
+    char le[24];
+    for (uint8_t i = 0; i < h.bucketCount && !_dropped; i++, _cursor++) {
+      if (_now[_cursor] == _sent[_cursor]) continue;
+      snprintf(value, sizeof(value), "%llu", (unsigned long long)(_now[_cursor] - _sent[_cursor]));
+      snprintf(le, sizeof(le), "le:%g", h.bounds[i] * h.scale);
+      line(m, ".bucket", value, "c", le);
+    }
+    if (!_dropped && _now[_cursor] != _sent[_cursor]) {
+      snprintf(value, sizeof(value), "%llu", (unsigned long long)(_now[_cursor] - _sent[_cursor]));
+      line(m, ".count", value, "c", nullptr);
+    }
+    _cursor++;
+    if (!_dropped && _now[_cursor] != _sent[_cursor]) {
+      snprintf(value, sizeof(value), "%.9g", (double)(_now[_cursor] - _sent[_cursor]) * h.scale);
+      line(m, ".sum", value, "c", nullptr);
+    }
+    _cursor++;
+    break;
+  }
+  }
+}
+
+// Tags: `k="v",k2="v2"` labels become `k:v,k2:v2` (DogStatsD) or
+// `.k_v.k2_v2` name segments, with any dots in them made underscores
+static size_t appendLabels(char *out, size_t size, const char *labels, bool dog) {
+  size_t n = 0;
+  bool start = true;
+  for (const char *p = labels; *p && n + 2 < size; p++) {
+    if (start) {
+      out[n++] = dog ? ',' : '.';
+      start = false;
+    }
+    if (*p == '"') continue;
+    if (*p == ',') {
+      start = true;
+    } else if (*p == '=' || *p == ':') {
+      out[n++] = dog ? ':' : '_';
+    } else {
+      out[n++] = !dog && *p == '.' ? '_' : *p;
+    }
+  }
+  out[n] = '\0';
+  return n;
+}
+
+void StatsdExporter::line(const Metric &m, const char *suffix, const char *value, const char *type,
+                          const char *extraTag) {
+  char text[256];
+  int n;
+  char tags[128];
+  size_t t = 0;
+  if (m.labels) t += appendLabels(tags + t, sizeof(tags) - t, m.labels, STATSD_DOGSTATSD);
+  if (extraTag) t += appendLabels(tags + t, sizeof(tags) - t, extraTag, STATSD_DOGSTATSD);
+  tags[t] = '\0';
+  if (STATSD_DOGSTATSD) {
+    n = snprintf(text, sizeof(text), "%s%s:%s|%s|#pen:%s%s\n", m.name, suffix, value, type, _pen, tags);
+  } else {
+    n = snprintf(text, sizeof(text), "%s.%s%s%s:%s|%s\n", _pen, m.name, suffix, tags, value, type);
+  }
+  if (n <= 0 || n >= (int)sizeof(text)) return; // cannot be a valid line
+
+  if (_len + n > sizeof(_packet)) {
+    if (!sendPacket()) return;
+  }
+  memcpy(_packet + _len, text, n);
+  _len += n;
+  _lines++;
+}
+
+// Send what is built; the totals it reported count as sent only if it went.
+// Everything before _cursor is in this datagram or an earlier one.
+bool StatsdExporter::sendPacket() {
+  ssize_t n = send(_fd, _packet, _len, 0);
+  bool ok = n == (ssize_t)_len;
+  int err = errno;
+  if (ok) {
+    memcpy(_sent + _packetFrom, _now + _packetFrom, (_cursor - _packetFrom) * sizeof(uint64_t));
+    _packetFrom = _cursor;
+  }
+  portENTER_CRITICAL(&_mux);
+  if (ok) {
+    _stats.packets++;
+    _stats.lines += _lines;
+    _stats.bytes += _len;
+  } else {
+    _stats.dropped++;
+    _stats.lastError = err;
+  }
+  portEXIT_CRITICAL(&_mux);
+  _len = 0;
+  _lines = 0;
+  _dropped = !ok;
+  return ok;
+}
+
+void StatsdExporter::getStats(StatsdExporterStats *out) const {
+  portENTER_CRITICAL(&_mux);
+  *out = _stats;
+  portEXIT_CRITICAL(&_mux);
+}
@@ -0,0 +1,77 @@
+// ============================================
+// StatsD Exporter - ResearchMate
+// Pushes the metrics registry (utils/metrics.h) to a StatsD / DogStatsD
+// collector over UDP, for a fleet of pens behind a NAT that nothing can
+// scrape. Off unless STATSD_HOST is set.
+//
+// Every STATSD_FLUSH_MS its task walks the registry and sends what changed
+// since the last flush, batched into datagrams of up to STATSD_PACKET_BYTES:
+//   counter     name:<increase>|c
+//   gauge       name:<value>|g
+//   histogram   name.count:<n>|c, name.sum:<s>|c and one name.bucket:<n>|c
+//               per bound that gained any (cumulative, tagged le:<bound>)
+// Every line carries the pen (getUniquePenID()) and the metric's labels, as
+// DogStatsD tags or, for plain StatsD, as leading / trailing name segments.
+//
+// The registry already holds the running totals, so the exporter keeps
+// nothing but what it last sent of each. A datagram that cannot go out
+// (network down, socket buffer full) is dropped without waiting, the flush
+// ends there, and the increases it carried stay unsent: the next flush
+// reports them along with what came after. Memory stays at one datagram
+// and two totals per counter however long the collector is away.
+// ============================================
+
+#ifndef STATSD_EXPORTER_H
+#define STATSD_EXPORTER_H
+
+#include "../config.h"
+#include "../utils/metrics.h"
+#include <Arduino.h>
+
+struct StatsdExporterStats {
+  bool running;
+  uint32_t flushes;
+  uint32_t packets;       // datagrams sent
+  uint32_t lines;
+  uint32_t bytes;
+  uint32_t dropped;       // datagrams the socket refused (flush cut short there)
+  int lastError;          // errno of the last refusal
+  uint32_t flushUs;       // last flush, registry walk to last send
+  uint32_t flushUsMax;
+};
+
+class StatsdExporter {
+public:
+  // Resolve `host` (dotted IPv4), take a snapshot buffer for the registry
+  // as it stands and start the flush task. `pen` tags every line and must
+  // outlive the exporter. Once only; false if the address or socket is bad.
+  bool begin(const char *host, uint16_t port, const char *pen);
+
+  // One flush now (the task's body; callable directly where there is none)
+  void flush();
+
+  void getStats(StatsdExporterStats *out) const;
+
+private:
+  static void task(void *arg);
+  void addMetric(const Metric &m);
+  void line(const Metric &m, const char *suffix, const char *value, const char *type,
+            const char *extraTag);
+  bool sendPacket();
+
+  int _fd = -1;
+  const char *_pen = nullptr;
+  uint64_t *_sent = nullptr;     // per slot: total as of the last datagram that went out
+  uint64_t *_now = nullptr;      // ...and as read this flush
+  uint16_t _slots = 0;
+  uint16_t _cursor = 0;          // slot of the line being added
+  uint16_t _packetFrom = 0;      // first slot the datagram being built covers
+  char _packet[STATSD_PACKET_BYTES];
+  size_t _len = 0;
+  uint16_t _lines = 0;
+  bool _dropped = false;         // a datagram did not go: this flush is over
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+  StatsdExporterStats _stats = {};
+};
+
+#endif // STATSD_EXPORTER_H
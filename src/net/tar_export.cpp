@@ -0,0 +1,219 @@
+#include "tar_export.h"
+#include "../utils/metrics.h"
+#include <esp_heap_caps.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_DEBUG(fmt, ...) Serial.printf(fmt "\n", ##__VA_ARGS__)
+
+// Member padding and the end-of-archive marker (two zero blocks)
+static const uint8_t zeros[2 * TAR_BLOCK] = {};
+
+static MetricCounter sdReadBytes("researchmate_sd_read_bytes_total", "Bytes read from the SD card.",
+                                 "caller=\"export\"");
+static MetricHistogram sdReadSeconds("researchmate_sd_read_seconds",
+                                     "SD read time per file read back or block streamed.", METRIC_LATENCY_US,
+                                     1e-6, "caller=\"export\"");
+
+TarExport::TarExport(const char *dir, FilePins *pins) : _dir(dir), _pins(pins) {}
+
+void TarExport::prepare(ScanIndex *index) { _index = index; }
+
+// ============================================
+// Members
+// ============================================
+
+// ustar header: octal numeric fields, checksum over the block with its own
+// field taken as spaces
+void TarExport::buildHeader(const char *name, uint32_t size, uint32_t mtime) {
+  memset(_header, 0, sizeof(_header));
+  snprintf((char *)_header, 100, "queue/%s", name);
+  memcpy(_header + 100, "0000644", 8);
+  memcpy(_header + 108, "0000000", 8);
+  memcpy(_header + 116, "0000000", 8);
+  snprintf((char *)_header + 124, 12, "%011lo", (unsigned long)size);
+  snprintf((char *)_header + 136, 12, "%011lo", (unsigned long)mtime);
+  memset(_header + 148, ' ', 8);
+  _header[156] = '0';
+  memcpy(_header + 257, "ustar", 6);
+  memcpy(_header + 263, "00", 2);
+  uint32_t sum = 0;
+  for (uint8_t b : _header) sum += b;
+  snprintf((char *)_header + 148, 8, "%06lo", (unsigned long)sum);
+  _header[155] = ' ';
+}
+
+bool TarExport::nextMember() {
+  for (;;) {
+    if (_batchPos == _batchLen) {
+      if (_lastBatch) return false;
+      uint32_t next;
+      uint16_t total;
+      int32_t n = _index->page(_cursor, _batch, TAR_BATCH, &next, &total);
+      if (n <= 0) return false;
+      _batchLen = (uint8_t)n;
+      _batchPos = 0;
+      _cursor = next;
+      _lastBatch = next == 0;
+    }
+    const ScanEntry &e = _batch[_batchPos++];
+    snprintf(_path, sizeof(_path), "%s/%s", _dir, e.name);
+    bool pinned = _pins->pin(_path);
+    int fd = pinned ? ::open(_path, O_RDONLY) : -1;
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      _fd = fd;
+      if (pinned) closeMember();
+      portENTER_CRITICAL(&_mux);
+      _stats.skipped++; // uploaded since it was listed
+      portEXIT_CRITICAL(&_mux);
+      continue;
+    }
+    _fd = fd;
+    _left = (uint32_t)st.st_size;
+    _pad = (TAR_BLOCK - _left % TAR_BLOCK) % TAR_BLOCK;
+    buildHeader(e.name, _left, (uint32_t)st.st_mtime);
+    return true;
+  }
+}
+
+// Closed and unpinned; a delete that waited for the export is done here
+void TarExport::closeMember() {
+  if (_fd >= 0) ::close(_fd);
+  _fd = -1;
+  if (_pins->unpin(_path)) {
+    ::unlink(_path);
+    _pins->deleted(_path);
+  }
+}
+
+// ============================================
+// HttpStream
+// ============================================
+bool TarExport::open(uint8_t client) {
+  if (!_index || _busy.exchange(true)) return false;
+  _block = (uint8_t *)heap_caps_malloc(FILE_STREAM_BLOCK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if (!_block) {
+    _busy = false;
+    return false;
+  }
+  _client = client;
+  _phase = TAR_NEXT;
+  _failed = false;
+  _batchLen = _batchPos = 0;
+  _cursor = 0;
+  _lastBatch = false;
+  _fd = -1;
+  _pos = _fill = 0;
+  _bytes = 0;
+  _startMs = millis();
+  portENTER_CRITICAL(&_mux);
+  _stats.active = true;
+  portEXIT_CRITICAL(&_mux);
+  return true;
+}
+
+void TarExport::close(uint8_t client) {
+  if (client != _client || !_block) return;
+  if (_fd >= 0) closeMember();
+  heap_caps_free(_block);
+  _block = nullptr;
+
+  uint32_t ms = millis() - _startMs;
+  bool complete = _phase == TAR_DONE && !_failed;
+  portENTER_CRITICAL(&_mux);
+  _stats.active = false;
+  if (complete) {
+    _stats.exports++;
+    _stats.lastMs = ms;
+    _stats.lastKBps = (uint32_t)((uint64_t)_bytes * 1000 / 1024 / (ms ? ms : 1));
+  } else {
+    _stats.aborted++;
+  }
+  portEXIT_CRITICAL(&_mux);
+  LOG_DEBUG("[Export] %s: %lu bytes in %lums", complete ? "Done" : "Stopped",
+            (unsigned long)_bytes, (unsigned long)ms);
+  _busy = false;
+}
+
+size_t TarExport::peek(uint8_t client, const uint8_t **data) {
+  for (;;) {
+    switch (_phase) {
+    case TAR_NEXT:
+      _pos = 0;
+      _phase = nextMember() ? TAR_HEADER : TAR_END;
+      break;
+    case TAR_HEADER:
+      *data = _header + _pos;
+      return TAR_BLOCK - _pos;
+    case TAR_DATA:
+      if (_pos < _fill) {
+        *data = _block + _pos;
+        return _fill - _pos;
+      }
+      if (_left == 0) {
+        _pos = 0;
+        _phase = TAR_PAD;
+        break;
+      }
+      {
+        // Members start at offset 0, so every read is whole sectors
+        uint32_t want = _left < FILE_STREAM_BLOCK ? _left : FILE_STREAM_BLOCK;
+        uint32_t t0 = micros();
+        ssize_t n = read(_fd, _block, want);
+        sdReadSeconds.observe(micros() - t0);
+        if (n <= 0) {
+          _failed = true; // the header promised more: end here, short
+          _phase = TAR_DONE;
+          return 0;
+        }
+        _fill = (uint16_t)n;
+        _pos = 0;
+        _left -= (uint32_t)n;
+        sdReadBytes.add((uint32_t)n);
+      }
+      break;
+    case TAR_PAD:
+      if (_pos < _pad) {
+        *data = zeros + _pos;
+        return _pad - _pos;
+      }
+      closeMember();
+      portENTER_CRITICAL(&_mux);
+      _stats.files++;
+      portEXIT_CRITICAL(&_mux);
+      _phase = TAR_NEXT;
+      break;
+    case TAR_END:
+      if (_pos < sizeof(zeros)) {
+        *data = zeros + _pos;
+        return sizeof(zeros) - _pos;
+      }
+      _phase = TAR_DONE;
+      break;
+    case TAR_DONE:
+      return 0;
+    }
+  }
+}
+
+void TarExport::consume(uint8_t client, size_t n) {
+  _pos += (uint16_t)n;
+  _bytes += n;
+  if (_phase == TAR_HEADER && _pos == TAR_BLOCK) {
+    _phase = TAR_DATA;
+    _pos = _fill = 0;
+  }
+  portENTER_CRITICAL(&_mux);
+  _stats.bytes += n;
+  portEXIT_CRITICAL(&_mux);
+}
+
+bool TarExport::done(uint8_t client) { return _phase == TAR_DONE; }
+
+void TarExport::getStats(TarExportStats *out) const {
+  portENTER_CRITICAL(&_mux);
+  *out = _stats;
+  portEXIT_CRITICAL(&_mux);
+}
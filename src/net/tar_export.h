@@ -0,0 +1,95 @@
+// ============================================
+// Queue Export - ResearchMate
+// /api/export body: every queued file as one ustar archive, produced while
+// it is sent. Each member's 512-byte header is built in memory from the
+// open file's size; its data is read from SD FILE_STREAM_BLOCK bytes at a
+// time into one internal RAM block, as FileStream does. No temp file, no
+// file held whole anywhere, and no Content-Length: the archive ends with
+// its two zero blocks and the connection closing.
+//
+// Members come from the scan index, newest first, a few entries at a time
+// by cursor, so scans saved or uploaded meanwhile are simply in or out. A
+// file gone before it is opened is skipped, as is one waiting to be
+// deleted; the one being read is pinned (storage/file_pins.h), so an
+// upload finishing meanwhile leaves its delete to the export. One that
+// cannot be read to the end after its header is out ends the export early
+// (a tar reader then reports it truncated). One export at a time.
+// ============================================
+
+#ifndef TAR_EXPORT_H
+#define TAR_EXPORT_H
+
+#include "../storage/file_pins.h"
+#include "../storage/scan_index.h"
+#include "http_server.h"
+#include <atomic>
+
+#define TAR_BLOCK        512
+#define TAR_BATCH        8     // index entries fetched per cursor step
+
+struct TarExportStats {
+  bool active;
+  uint32_t exports;       // archives written to the end
+  uint32_t aborted;
+  uint32_t files;         // members written, all exports
+  uint32_t skipped;       // listed but gone or unreadable when reached
+  uint32_t bytes;
+  uint32_t lastMs;        // last complete export
+  uint32_t lastKBps;
+};
+
+class TarExport : public HttpStream {
+public:
+  // `dir`: the queue's path on the SD mount; its entries' names are
+  // relative to it
+  TarExport(const char *dir, FilePins *pins);
+
+  // loop(), before sendStream(): the index to list the archive from
+  void prepare(ScanIndex *index);
+
+  void getStats(TarExportStats *out) const;
+
+  // HttpStream (server task; open() on loop() inside sendStream())
+  bool open(uint8_t client) override;
+  void close(uint8_t client) override;
+  size_t peek(uint8_t client, const uint8_t **data) override;
+  void consume(uint8_t client, size_t n) override;
+  bool done(uint8_t client) override;
+
+private:
+  enum Phase : uint8_t { TAR_NEXT, TAR_HEADER, TAR_DATA, TAR_PAD, TAR_END, TAR_DONE };
+
+  bool nextMember();          // opens the next file and builds its header
+  void buildHeader(const char *name, uint32_t size, uint32_t mtime);
+  void closeMember();
+
+  const char *_dir;
+  FilePins *_pins;
+  ScanIndex *_index = nullptr;
+  std::atomic<bool> _busy{false};
+  uint8_t _client = 0;
+
+  Phase _phase = TAR_DONE;
+  bool _failed = false;
+  ScanEntry _batch[TAR_BATCH];
+  uint8_t _batchLen = 0;
+  uint8_t _batchPos = 0;
+  uint32_t _cursor = 0;
+  bool _lastBatch = false;
+
+  int _fd = -1;
+  char _path[FILE_PIN_PATH];
+  uint32_t _left = 0;         // member data still to read
+  uint32_t _pad = 0;          // zeros after the data, to a whole block
+  uint8_t *_block = nullptr;  // FILE_STREAM_BLOCK, internal RAM
+  uint16_t _fill = 0;
+  uint16_t _pos = 0;
+  uint8_t _header[TAR_BLOCK];
+  uint32_t _startMs = 0;
+  uint32_t _bytes = 0;        // this export
+
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED; // guards _stats
+  TarExportStats _stats = {};
+};
+
+#endif // TAR_EXPORT_H
@@ -0,0 +1,11 @@
+#include "web_assets.h"
+#include <cstring>
+
+#include "web_assets_data.h" // generated: WEB_ASSETS[]
+
+const WebAsset *findWebAsset(const char *path) {
+  for (const WebAsset &a : WEB_ASSETS) {
+    if (strcmp(a.path, path) == 0) return &a;
+  }
+  return nullptr;
+}
@@ -0,0 +1,25 @@
+// ============================================
+// Web UI Assets - ResearchMate
+// The files in web/, gzipped at build time by tools/embed_web.py and
+// compiled in as const arrays, so they are served straight from flash: no
+// page building, no heap, one ETag per file for browser revalidation.
+// ============================================
+
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct WebAsset {
+  const char *path;        // URL ("/" for index.html)
+  const char *contentType;
+  const uint8_t *gz;       // gzip body, in flash
+  size_t gzLen;
+  const char *etag;        // quoted, from the uncompressed contents
+};
+
+// nullptr when `path` is not one of the embedded files
+const WebAsset *findWebAsset(const char *path);
+
+#endif // WEB_ASSETS_H
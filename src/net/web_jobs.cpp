@@ -0,0 +1,78 @@
+#include "web_jobs.h"
+#include <cstring>
+
+const char *webJobStateName(WebJobState s) {
+  switch (s) {
+  case WEB_JOB_PENDING: return "pending";
+  case WEB_JOB_RUNNING: return "running";
+  case WEB_JOB_DONE: return "done";
+  case WEB_JOB_FAILED: return "failed";
+  default: return "unknown";
+  }
+}
+
+uint32_t WebJobs::submit(uint8_t kind, uint32_t nowMs) {
+  Slot *use = nullptr;
+  for (Slot &s : _slots) {
+    uint8_t st = s.state.load(std::memory_order_acquire);
+    if ((st == WEB_JOB_PENDING || st == WEB_JOB_RUNNING) && s.kind == kind) return s.id;
+    if (st == WEB_JOB_FREE) {
+      if (!use || use->state.load(std::memory_order_relaxed) != WEB_JOB_FREE) use = &s;
+    } else if (st == WEB_JOB_DONE || st == WEB_JOB_FAILED) {
+      // Reuse the oldest finished slot when none is free
+      if (!use || (use->state.load(std::memory_order_relaxed) != WEB_JOB_FREE && s.id < use->id))
+        use = &s;
+    }
+  }
+  if (!use) return 0;
+  use->id = _nextId++;
+  use->kind = kind;
+  use->submitMs = nowMs;
+  use->result[0] = '\0';
+  use->state.store(WEB_JOB_PENDING, std::memory_order_release);
+  return use->id;
+}
+
+bool WebJobs::get(uint32_t id, uint32_t nowMs, WebJobInfo *out) const {
+  for (const Slot &s : _slots) {
+    uint8_t st = s.state.load(std::memory_order_acquire);
+    if (st == WEB_JOB_FREE || s.id != id) continue;
+    out->id = id;
+    out->kind = s.kind;
+    out->state = (WebJobState)st;
+    out->waitMs = (st == WEB_JOB_PENDING ? nowMs : s.startMs) - s.submitMs;
+    out->runMs = st == WEB_JOB_DONE || st == WEB_JOB_FAILED ? s.endMs - s.startMs : 0;
+    if (st == WEB_JOB_DONE || st == WEB_JOB_FAILED) {
+      memcpy(out->result, s.result, sizeof(out->result));
+    } else {
+      out->result[0] = '\0';
+    }
+    return true;
+  }
+  return false;
+}
+
+bool WebJobs::next(uint32_t *id, uint8_t *kind, uint32_t nowMs) {
+  Slot *oldest = nullptr;
+  for (Slot &s : _slots) {
+    if (s.state.load(std::memory_order_acquire) == WEB_JOB_PENDING && (!oldest || s.id < oldest->id))
+      oldest = &s;
+  }
+  if (!oldest) return false;
+  oldest->startMs = nowMs;
+  *id = oldest->id;
+  *kind = oldest->kind;
+  oldest->state.store(WEB_JOB_RUNNING, std::memory_order_release);
+  return true;
+}
+
+void WebJobs::finish(uint32_t id, bool ok, const char *resultJson, uint32_t nowMs) {
+  for (Slot &s : _slots) {
+    if (s.state.load(std::memory_order_acquire) != WEB_JOB_RUNNING || s.id != id) continue;
+    strncpy(s.result, resultJson ? resultJson : "", sizeof(s.result) - 1);
+    s.result[sizeof(s.result) - 1] = '\0';
+    s.endMs = nowMs;
+    s.state.store(ok ? WEB_JOB_DONE : WEB_JOB_FAILED, std::memory_order_release);
+    return;
+  }
+}
@@ -0,0 +1,68 @@
+// ============================================
+// Web Jobs - ResearchMate
+// Requests that need a cloud round trip (new pairing code, unpair) are not
+// run inside their HTTP handler: the handler submits a job and answers 202
+// with its id, the cloud task runs it, and the page polls /api/jobs?id=N
+// for the result. Finished jobs keep their result until their slot is
+// reused by a later submit.
+//
+// One submitter (loop) and one worker (cloud task); a slot's state says
+// which side owns it, so no locks are needed.
+// ============================================
+
+#ifndef WEB_JOBS_H
+#define WEB_JOBS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define WEB_JOB_SLOTS       4
+#define WEB_JOB_RESULT_MAX  160   // JSON result, NUL included
+
+enum WebJobState : uint8_t {
+  WEB_JOB_FREE,
+  WEB_JOB_PENDING,
+  WEB_JOB_RUNNING,
+  WEB_JOB_DONE,
+  WEB_JOB_FAILED,
+};
+
+struct WebJobInfo {
+  uint32_t id;
+  uint8_t kind;
+  WebJobState state;
+  uint32_t waitMs;     // submitted -> started (so far, while pending)
+  uint32_t runMs;      // started -> finished
+  char result[WEB_JOB_RESULT_MAX];
+};
+
+const char *webJobStateName(WebJobState s);
+
+class WebJobs {
+public:
+  // Loop: queue a job of `kind`, or join the one of that kind not yet
+  // finished. 0 when every slot holds an unfinished job.
+  uint32_t submit(uint8_t kind, uint32_t nowMs);
+  // Loop: copy of job `id`; false once its slot has been reused.
+  bool get(uint32_t id, uint32_t nowMs, WebJobInfo *out) const;
+
+  // Worker: oldest pending job, now running.
+  bool next(uint32_t *id, uint8_t *kind, uint32_t nowMs);
+  void finish(uint32_t id, bool ok, const char *resultJson, uint32_t nowMs);
+
+private:
+  struct Slot {
+    std::atomic<uint8_t> state{WEB_JOB_FREE};
+    uint32_t id;
+    uint8_t kind;
+    uint32_t submitMs;
+    uint32_t startMs;
+    uint32_t endMs;
+    char result[WEB_JOB_RESULT_MAX];
+  };
+  Slot _slots[WEB_JOB_SLOTS];
+  uint32_t _nextId = 1;
+};
+
+#endif // WEB_JOBS_H
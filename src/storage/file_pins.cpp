@@ -0,0 +1,112 @@
+#include "file_pins.h"
+#include <cstring>
+
+FilePins::FilePins(const char *mount) : _mount(mount), _mountLen(strlen(mount)) {}
+
+const char *FilePins::strip(const char *path) const {
+  if (strncmp(path, _mount, _mountLen) == 0 && path[_mountLen] == '/') return path + _mountLen;
+  return path;
+}
+
+// Under the lock
+FilePins::Pin *FilePins::lookup(const char *path) {
+  for (Pin &p : _pins) {
+    if (p.path[0] && strcmp(p.path, path) == 0) return &p;
+  }
+  return nullptr;
+}
+
+// A free slot for `path`, leaving `reserve` free ones behind (the one a
+// delete may need)
+FilePins::Pin *FilePins::take(const char *path, uint8_t reserve) {
+  if (strlen(path) >= FILE_PIN_PATH) return nullptr;
+  Pin *slot = nullptr;
+  uint8_t free = 0;
+  for (Pin &p : _pins) {
+    if (p.path[0]) continue;
+    if (!slot) slot = &p;
+    free++;
+  }
+  if (free <= reserve) return nullptr;
+  strcpy(slot->path, path);
+  slot->readers = 0;
+  slot->doomed = false;
+  return slot;
+}
+
+// ============================================
+// Readers
+// ============================================
+bool FilePins::pin(const char *path) {
+  path = strip(path);
+  portENTER_CRITICAL(&_mux);
+  Pin *p = lookup(path);
+  if (!p) p = take(path, 1);
+  bool ok = p && !p->doomed;
+  if (ok) {
+    if (p->readers++ == 0) _stats.pinned++;
+  } else {
+    _stats.refused++;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return ok;
+}
+
+bool FilePins::unpin(const char *path) {
+  path = strip(path);
+  bool remove = false;
+  portENTER_CRITICAL(&_mux);
+  Pin *p = lookup(path);
+  if (p && p->readers > 0 && --p->readers == 0) {
+    _stats.pinned--;
+    if (p->doomed) remove = true; // the slot stays until deleted()
+    else p->path[0] = 0;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return remove;
+}
+
+// ============================================
+// Deleter
+// ============================================
+bool FilePins::claim(const char *path) {
+  path = strip(path);
+  bool now = true;
+  portENTER_CRITICAL(&_mux);
+  Pin *p = lookup(path);
+  if (p) {
+    // Readers have it, or the last one is removing it now
+    if (p->readers > 0 && !p->doomed) _stats.deferred++;
+    now = false;
+  } else {
+    p = take(path, 0); // readers leave this one free
+  }
+  if (p) p->doomed = true;
+  portEXIT_CRITICAL(&_mux);
+  return now;
+}
+
+void FilePins::deleted(const char *path) {
+  path = strip(path);
+  portENTER_CRITICAL(&_mux);
+  Pin *p = lookup(path);
+  if (p && p->readers == 0) p->path[0] = 0;
+  portEXIT_CRITICAL(&_mux);
+}
+
+bool FilePins::doomed(const char *path) const {
+  path = strip(path);
+  bool doomed = false;
+  portENTER_CRITICAL(&_mux);
+  for (const Pin &p : _pins) {
+    if (p.path[0] && strcmp(p.path, path) == 0) doomed = p.doomed;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return doomed;
+}
+
+void FilePins::getStats(FilePinStats *out) const {
+  portENTER_CRITICAL(&_mux);
+  *out = _stats;
+  portEXIT_CRITICAL(&_mux);
+}
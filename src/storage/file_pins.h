@@ -0,0 +1,68 @@
+// ============================================
+// Queue File Pins - ResearchMate
+// Which queue files a download or the export has open, so that the
+// uploader's delete does not pull a file out from under them. FAT frees a
+// removed file's clusters at once, and a reader still holding it would go
+// on sending whatever gets written there next.
+//
+// Readers pin() a file before opening it and unpin() it once closed. The
+// deleter claim()s a file first: if nothing has it open, it removes the
+// file itself and then calls deleted(). If readers do, the delete waits and
+// the last unpin() says so: that reader removes the file and calls
+// deleted(). Either way the slot stays taken until deleted(), so no reader
+// can open the file while it is being removed, and none can pin one that
+// waits to be (doomed(): the uploader skips those too).
+//
+// One deleter at a time (the cloud task); readers on loop() and the server
+// task. Paths may start with the mount point or not: both name the same
+// file.
+// ============================================
+
+#ifndef FILE_PINS_H
+#define FILE_PINS_H
+
+#include "../config.h"
+#include <Arduino.h>
+
+#define FILE_PIN_PATH    64
+#define FILE_PINS_MAX    (FILE_STREAM_MAX + 3) // downloads, one prepared, the export, a delete
+
+struct FilePinStats {
+  uint8_t pinned;         // files open now
+  uint32_t refused;       // pin()s turned away: doomed, or no slot
+  uint32_t deferred;      // deletes left to a reader
+};
+
+class FilePins {
+public:
+  // `mount`: the prefix POSIX paths carry and SD library ones do not
+  explicit FilePins(const char *mount);
+
+  bool pin(const char *path);
+  bool unpin(const char *path);   // true: remove it now, then deleted()
+
+  bool claim(const char *path);   // true: remove it now, then deleted()
+  void deleted(const char *path);
+  bool doomed(const char *path) const;
+
+  void getStats(FilePinStats *out) const;
+
+private:
+  struct Pin {
+    char path[FILE_PIN_PATH]; // "" when free
+    uint8_t readers;
+    bool doomed;
+  };
+
+  const char *strip(const char *path) const;
+  Pin *lookup(const char *path);
+  Pin *take(const char *path, uint8_t reserve);
+
+  const char *_mount;
+  size_t _mountLen;
+  Pin _pins[FILE_PINS_MAX] = {};
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+  FilePinStats _stats = {};
+};
+
+#endif // FILE_PINS_H
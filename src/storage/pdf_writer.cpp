@@ -0,0 +1,289 @@
+#include "pdf_writer.h"
+#include "../imaging/jpeg_scan.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Object layout: 1 = catalog, 2 = page tree root, then per group of
+// PDF_TREE_FANOUT pages an intermediate /Pages node followed by four
+// objects per page: image, image /Length, content stream, page. The length
+// is indirect so streamed images can be written before their size is
+// known. A page update rewrites its group's node and the root, whose /Kids
+// only lists the groups, so it never costs more than one group's worth of
+// references plus one per PDF_TREE_FANOUT pages.
+#define OBJ_CATALOG   1
+#define OBJ_PAGES     2
+#define OBJ_FIRST_PAGE 3
+#define OBJS_PER_PAGE 4
+#define PDF_TREE_FANOUT 32
+#define OBJS_PER_GROUP (1 + OBJS_PER_PAGE * PDF_TREE_FANOUT)
+
+static inline uint32_t groupObj(uint32_t g) { return OBJ_FIRST_PAGE + OBJS_PER_GROUP * g; }
+static inline uint32_t imageObj(uint32_t i) {
+  return groupObj(i / PDF_TREE_FANOUT) + 1 + OBJS_PER_PAGE * (i % PDF_TREE_FANOUT);
+}
+static inline uint32_t pageObj(uint32_t i) { return imageObj(i) + 3; }
+
+// ============================================
+// Output helpers
+// ============================================
+static bool emit(PdfDoc *doc, const void *data, size_t len) {
+  if (doc->failed) return false;
+  if (doc->write(doc->ctx, (const uint8_t *)data, len) != len) {
+    doc->failed = true;
+    return false;
+  }
+  doc->offset += len;
+  return true;
+}
+
+static bool emitf(PdfDoc *doc, const char *fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (n < 0 || n >= (int)sizeof(buf)) {
+    doc->failed = true;
+    return false;
+  }
+  return emit(doc, buf, (size_t)n);
+}
+
+// Xref entries are fixed at 20 bytes: "oooooooooo ggggg n \n"
+static bool emitXrefEntry(PdfDoc *doc, uint32_t off) {
+  return emitf(doc, "%010lu 00000 n \n", (unsigned long)off);
+}
+
+// "<obj> 0 R " for each of `count` objects, batched so a long /Kids array
+// is a handful of writes
+static bool emitRefs(PdfDoc *doc, uint32_t count, uint32_t (*objOf)(uint32_t), uint32_t first) {
+  char buf[192];
+  size_t used = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    used += snprintf(buf + used, sizeof(buf) - used, "%lu 0 R ", (unsigned long)objOf(first + i));
+    if (used > sizeof(buf) - 16) {
+      if (!emit(doc, buf, used)) return false;
+      used = 0;
+    }
+  }
+  return !used || emit(doc, buf, used);
+}
+
+// Root: one kid per group started
+static bool emitPageRoot(PdfDoc *doc, uint32_t pages) {
+  uint32_t groups = (pages + PDF_TREE_FANOUT - 1) / PDF_TREE_FANOUT;
+  return emitf(doc, "%d 0 obj\n<< /Type /Pages /Count %lu /Kids [", OBJ_PAGES, (unsigned long)pages) &&
+         emitRefs(doc, groups, groupObj, 0) && emitf(doc, "] >>\nendobj\n");
+}
+
+// Group g's node, holding pages up to `pages`
+static bool emitPageGroup(PdfDoc *doc, uint32_t g, uint32_t pages) {
+  uint32_t first = g * PDF_TREE_FANOUT;
+  uint32_t count = pages - first < PDF_TREE_FANOUT ? pages - first : PDF_TREE_FANOUT;
+  return emitf(doc, "%lu 0 obj\n<< /Type /Pages /Parent %d 0 R /Count %lu /Kids [",
+               (unsigned long)groupObj(g), OBJ_PAGES, (unsigned long)count) &&
+         emitRefs(doc, count, pageObj, first) && emitf(doc, "] >>\nendobj\n");
+}
+
+// ============================================
+// Public API
+// ============================================
+bool pdfBegin(PdfDoc *doc, PdfWriteFn write, void *ctx, uint16_t dpi) {
+  doc->write = write;
+  doc->ctx = ctx;
+  doc->offset = 0;
+  doc->lastXref = 0;
+  doc->nextObj = OBJ_FIRST_PAGE;
+  doc->pageCount = 0;
+  doc->dpi = dpi ? dpi : 200;
+  doc->failed = false;
+  doc->imageOpen = false;
+
+  // Binary comment marks the file as binary for transfer tools
+  static const char header[] = "%PDF-1.4\n%\xE2\xE3\xCF\xD3\n";
+  emit(doc, header, sizeof(header) - 1);
+
+  uint32_t catalogOff = doc->offset;
+  emitf(doc, "%d 0 obj\n<< /Type /Catalog /Pages %d 0 R >>\nendobj\n", OBJ_CATALOG, OBJ_PAGES);
+  uint32_t pagesOff = doc->offset;
+  emitPageRoot(doc, 0);
+
+  uint32_t xrefOff = doc->offset;
+  emitf(doc, "xref\n0 3\n0000000000 65535 f \n");
+  emitXrefEntry(doc, catalogOff);
+  emitXrefEntry(doc, pagesOff);
+  emitf(doc, "trailer\n<< /Size 3 /Root %d 0 R >>\nstartxref\n%lu\n%%%%EOF\n",
+        OBJ_CATALOG, (unsigned long)xrefOff);
+  doc->lastXref = xrefOff;
+  doc->committed = doc->offset;
+  return !doc->failed;
+}
+
+// Image XObject header; the data follows via pdfWriteImageData().
+static bool beginImage(PdfDoc *doc, uint16_t width, uint16_t height, const char *format) {
+  if (doc->failed || doc->imageOpen || width == 0 || height == 0) return false;
+  doc->imageOpen = true;
+  doc->imgWidth = width;
+  doc->imgHeight = height;
+  doc->imgOff = doc->offset;
+  uint32_t imgObj = imageObj(doc->pageCount);
+  emitf(doc, "%lu 0 obj\n<< /Type /XObject /Subtype /Image /Width %u /Height %u %s "
+             "/Length %lu 0 R >>\nstream\n",
+        (unsigned long)imgObj, width, height, format, (unsigned long)(imgObj + 1));
+  doc->imgDataStart = doc->offset;
+  return !doc->failed;
+}
+
+bool pdfWriteImageData(PdfDoc *doc, const uint8_t *data, size_t len) {
+  if (!doc->imageOpen) return false;
+  return emit(doc, data, len);
+}
+
+bool pdfEndImagePage(PdfDoc *doc) {
+  if (!doc->imageOpen) return false;
+  doc->imageOpen = false;
+  if (doc->failed) return false;
+
+  uint32_t group = doc->pageCount / PDF_TREE_FANOUT;
+  uint32_t groupNode = groupObj(group);
+  uint32_t imgObj = imageObj(doc->pageCount);
+  uint32_t lenObj = imgObj + 1;
+  uint32_t contentObj = imgObj + 2;
+  uint32_t pgObj = imgObj + 3;
+  uint32_t dataLen = doc->offset - doc->imgDataStart;
+  uint32_t ptW = (uint32_t)doc->imgWidth * 72 / doc->dpi;
+  uint32_t ptH = (uint32_t)doc->imgHeight * 72 / doc->dpi;
+  if (ptW == 0) ptW = 1;
+  if (ptH == 0) ptH = 1;
+
+  emitf(doc, "\nendstream\nendobj\n");
+  uint32_t lenOff = doc->offset;
+  emitf(doc, "%lu 0 obj\n%lu\nendobj\n", (unsigned long)lenObj, (unsigned long)dataLen);
+
+  // Content stream: scale the unit image square to the full page
+  char content[64];
+  int contentLen = snprintf(content, sizeof(content), "q %lu 0 0 %lu 0 0 cm /Im0 Do Q\n",
+                            (unsigned long)ptW, (unsigned long)ptH);
+  uint32_t contentOff = doc->offset;
+  emitf(doc, "%lu 0 obj\n<< /Length %d >>\nstream\n", (unsigned long)contentObj, contentLen);
+  emit(doc, content, contentLen);
+  emitf(doc, "endstream\nendobj\n");
+
+  uint32_t pageOff = doc->offset;
+  emitf(doc,
+        "%lu 0 obj\n<< /Type /Page /Parent %lu 0 R /MediaBox [0 0 %lu %lu] "
+        "/Resources << /XObject << /Im0 %lu 0 R >> >> /Contents %lu 0 R >>\nendobj\n",
+        (unsigned long)pgObj, (unsigned long)groupNode, (unsigned long)ptW, (unsigned long)ptH,
+        (unsigned long)imgObj, (unsigned long)contentObj);
+
+  // New revisions of this page's group node and of the root
+  uint32_t pages = doc->pageCount + 1;
+  uint32_t groupOff = doc->offset;
+  emitPageGroup(doc, group, pages);
+  uint32_t pagesOff = doc->offset;
+  emitPageRoot(doc, pages);
+
+  // Incremental xref: only the objects this update touched
+  uint32_t xrefOff = doc->offset;
+  // Leading free-list head keeps strict readers from treating the section as
+  // mis-indexed (each update is its own zero-based table).
+  emitf(doc, "xref\n0 1\n0000000000 65535 f \n%d 1\n", OBJ_PAGES);
+  emitXrefEntry(doc, pagesOff);
+  // A group's first page follows its node: one run of five
+  if (groupNode + 1 == imgObj) {
+    emitf(doc, "%lu %d\n", (unsigned long)groupNode, 1 + OBJS_PER_PAGE);
+    emitXrefEntry(doc, groupOff);
+  } else {
+    emitf(doc, "%lu 1\n", (unsigned long)groupNode);
+    emitXrefEntry(doc, groupOff);
+    emitf(doc, "%lu %d\n", (unsigned long)imgObj, OBJS_PER_PAGE);
+  }
+  emitXrefEntry(doc, doc->imgOff);
+  emitXrefEntry(doc, lenOff);
+  emitXrefEntry(doc, contentOff);
+  emitXrefEntry(doc, pageOff);
+  emitf(doc, "trailer\n<< /Size %lu /Root %d 0 R /Prev %lu >>\nstartxref\n%lu\n%%%%EOF\n",
+        (unsigned long)(pgObj + 1), OBJ_CATALOG, (unsigned long)doc->lastXref,
+        (unsigned long)xrefOff);
+
+  if (doc->failed) return false;
+  doc->pageCount = pages;
+  doc->nextObj = pgObj + 1;
+  doc->lastXref = xrefOff;
+  doc->committed = doc->offset;
+  return true;
+}
+
+void pdfAbortPage(PdfDoc *doc) {
+  doc->imageOpen = false;
+  doc->offset = doc->committed;
+  doc->failed = false;
+}
+
+bool pdfAppendJpegPage(PdfDoc *doc, const uint8_t *jpg, size_t len) {
+  JpegInfo info;
+  if (jpegReadHeader(jpg, len, &info) != JPEG_OK || info.width == 0 || info.height == 0)
+    return false;
+  const char *format = info.components == 1 ? "/ColorSpace /DeviceGray /BitsPerComponent 8 /Filter /DCTDecode"
+                     : info.components == 3 ? "/ColorSpace /DeviceRGB /BitsPerComponent 8 /Filter /DCTDecode"
+                     : nullptr;
+  if (!format) return false;
+
+  // The JPEG bytes go in untouched
+  if (!beginImage(doc, info.width, info.height, format)) return false;
+  pdfWriteImageData(doc, jpg, len);
+  return pdfEndImagePage(doc);
+}
+
+bool pdfBeginCcittPage(PdfDoc *doc, uint16_t width, uint16_t height) {
+  // T.6 data with 1 = white after decoding (BlackIs1 false), matching the
+  // encoder's white-is-zero coding.
+  char format[160];
+  snprintf(format, sizeof(format),
+           "/ColorSpace /DeviceGray /BitsPerComponent 1 /Filter /CCITTFaxDecode "
+           "/DecodeParms << /K -1 /Columns %u /Rows %u >>",
+           width, height);
+  return beginImage(doc, width, height, format);
+}
+
+// ============================================
+// Recovery
+// ============================================
+uint32_t pdfLastCommitted(PdfReadFn read, void *ctx, uint32_t size, bool *pages) {
+  static const char EOF_MARK[] = "%%EOF\n";
+  const size_t markLen = sizeof(EOF_MARK) - 1;
+  uint8_t buf[512];
+  uint32_t end = size;
+
+  while (end >= markLen) {
+    uint32_t from = end > sizeof(buf) ? end - sizeof(buf) : 0;
+    size_t n = end - from;
+    if (read(ctx, from, buf, n) != n) return 0;
+    for (size_t i = n - markLen + 1; i-- > 0;) {
+      if (memcmp(buf + i, EOF_MARK, markLen) != 0) continue;
+      uint32_t eofAt = from + i;
+
+      // Trailer before it: "... >>\nstartxref\n<n>\n"
+      char tail[160];
+      uint32_t tailFrom = eofAt > sizeof(tail) - 1 ? eofAt - (sizeof(tail) - 1) : 0;
+      size_t tailLen = eofAt - tailFrom;
+      if (read(ctx, tailFrom, (uint8_t *)tail, tailLen) != tailLen) return 0;
+      tail[tailLen] = '\0';
+      char *sx = NULL;
+      for (char *p = strstr(tail, "startxref\n"); p; p = strstr(p + 1, "startxref\n")) sx = p;
+      char xref[5];
+      unsigned long xrefOff = sx ? strtoul(sx + 10, NULL, 10) : 0;
+      if (sx && xrefOff < eofAt && read(ctx, xrefOff, (uint8_t *)xref, 5) == 5 &&
+          memcmp(xref, "xref\n", 5) == 0) {
+        *sx = '\0';
+        *pages = strstr(tail, "/Prev") != NULL;
+        return eofAt + markLen;
+      }
+    }
+    if (from == 0) break;
+    end = from + markLen - 1; // a mark straddling the block edge is seen next time
+  }
+  return 0;
+}
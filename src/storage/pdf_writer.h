@@ -0,0 +1,68 @@
+// ============================================
+// Incremental PDF Writer - ResearchMate
+// Builds a multi-page PDF by appending one incremental update per page.
+// Every append leaves a complete, valid file on disk, and never rewrites
+// earlier bytes: the cost of page N is the page itself plus new revisions
+// of its group's /Pages node (at most 32 pages) and of the root (one kid
+// per group).
+// ============================================
+
+#ifndef PDF_WRITER_H
+#define PDF_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Sink: append `len` bytes, return the number written. The writer tracks the
+// file offset itself, so a plain append-only file handle is enough.
+typedef size_t (*PdfWriteFn)(void *ctx, const uint8_t *data, size_t len);
+// Source for reading a written file back: `len` bytes at `offset`, return
+// the number read.
+typedef size_t (*PdfReadFn)(void *ctx, uint32_t offset, uint8_t *buf, size_t len);
+
+struct PdfDoc {
+  PdfWriteFn write;
+  void *ctx;
+  uint32_t offset;      // current end-of-file offset
+  uint32_t lastXref;    // offset of the newest xref section (for /Prev)
+  uint32_t committed;   // end of the newest complete update (its %%EOF)
+  uint32_t nextObj;     // next free object number
+  uint32_t pageCount;
+  uint16_t dpi;         // pixels per inch used to size pages
+  bool failed;          // sticky: a short write leaves the doc unusable
+  // Image being streamed by the current page
+  bool imageOpen;
+  uint16_t imgWidth, imgHeight;
+  uint32_t imgOff;      // offset of the image object
+  uint32_t imgDataStart;
+};
+
+// Write the header, catalog and an empty page tree.
+bool pdfBegin(PdfDoc *doc, PdfWriteFn write, void *ctx, uint16_t dpi);
+
+// Append a page holding one baseline JPEG, embedded verbatim as a
+// /DCTDecode image XObject (no re-encode). Dimensions and colour space come
+// from the JPEG's SOF header.
+bool pdfAppendJpegPage(PdfDoc *doc, const uint8_t *jpg, size_t len);
+
+// Streamed bilevel page: open a /CCITTFaxDecode (Group 4) image, feed the
+// encoded bytes as they are produced, then close the page. The stream
+// length is written afterwards as an indirect object, so the encoder output
+// never has to be buffered.
+bool pdfBeginCcittPage(PdfDoc *doc, uint16_t width, uint16_t height);
+bool pdfWriteImageData(PdfDoc *doc, const uint8_t *data, size_t len);
+bool pdfEndImagePage(PdfDoc *doc);
+
+// Give up on the page being written (open, or failed part way through
+// pdfEndImagePage()): the doc goes back to its last complete update, and
+// doc->offset to where that ends. The sink only appends, so cutting the
+// bytes already written past it is up to the caller.
+void pdfAbortPage(PdfDoc *doc);
+
+// Where the newest complete update in a file of `size` bytes ends: just
+// past a "startxref\n<n>\n%%EOF\n" whose <n> points at an xref section, so
+// bytes in a half-written image cannot pass for one. 0 if there is none.
+// *pages: whether that update is a page's (pdfBegin()'s has no /Prev).
+uint32_t pdfLastCommitted(PdfReadFn read, void *ctx, uint32_t size, bool *pages);
+
+#endif // PDF_WRITER_H
@@ -0,0 +1,435 @@
+#include "scan_index.h"
+#include <algorithm>
+
+bool ScanIndex::attach(GalleryStore *store, ScanJournal *journal, ScanEntry *entries,
+                       uint32_t *keys, uint16_t maxEntries) {
+  if (!store || !journal || !entries || !keys || !maxEntries) return false;
+  if (!_lock) _lock = xSemaphoreCreateMutex();
+  if (!_lock) return false;
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  _store = store;
+  _journal = journal;
+  _entries = entries;
+  _keys = keys;
+  _max = maxEntries;
+  _count = _keyCount = 0;
+  _built = false;
+  xSemaphoreGive(_lock);
+  return true;
+}
+
+// ============================================
+// Entries and tombstones
+// ============================================
+static const char *baseName(const char *path) {
+  const char *slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+int32_t ScanIndex::indexOf(uint32_t key, const char *name) const {
+  for (uint32_t i = _live; i < _count; i++) {
+    const ScanEntry &e = _entries[i];
+    if (e.key == key && e.name[0] && (!name || strcmp(e.name, name) == 0)) return (int32_t)i;
+  }
+  return -1;
+}
+
+// Newest last; when full, the oldest goes to make room
+bool ScanIndex::push(const char *name, uint32_t gen, uint32_t size, uint32_t crc) {
+  if (strlen(name) >= GALLERY_NAME_MAX) {
+    _stats.dropped++;
+    return false;
+  }
+  if (_count == _max) sweep();
+  if (_count == _max) {
+    memmove(_entries, _entries + 1, sizeof(ScanEntry) * (_max - 1));
+    _count--;
+    _stats.dropped++;
+  }
+  ScanEntry &e = _entries[_count++];
+  strcpy(e.name, name);
+  e.key = galleryKey(name);
+  e.gen = gen;
+  e.size = size;
+  e.crc = crc;
+  e.hasThumb = false;
+  return true;
+}
+
+void ScanIndex::sweep() {
+  ScanEntry *end = std::remove_if(_entries, _entries + _count,
+                                  [](const ScanEntry &e) { return e.name[0] == '\0'; });
+  _count = (uint32_t)(end - _entries);
+  _live = 0;
+}
+
+// Removals are made in generation order, so the ring is too. The oldest is
+// forgotten when it is full: a client that had not seen it starts over.
+void ScanIndex::bury(uint32_t key, uint32_t gen) {
+  if (_tombCount == SCAN_TOMBSTONES) {
+    _floor = _tombs[_tombHead].gen;
+    _tombHead = (_tombHead + 1) % SCAN_TOMBSTONES;
+    _tombCount--;
+  }
+  Tomb &t = _tombs[(_tombHead + _tombCount) % SCAN_TOMBSTONES];
+  t.key = key;
+  t.gen = gen;
+  _tombCount++;
+}
+
+bool ScanIndex::journal(bool removed, uint32_t key, const char *name, uint32_t size,
+                        uint32_t crc) {
+  ScanRecord r = {};
+  r.op = removed ? SCAN_REMOVED : SCAN_ADDED;
+  r.key = key;
+  r.name = name;
+  r.size = size;
+  r.crc = crc;
+  if (!_journal->append(r)) {
+    // Kept in memory all the same; the next build squares the card with it
+    _stats.journalErrors++;
+    return false;
+  }
+  _records++;
+  return true;
+}
+
+// ============================================
+// Build: the journal, then one pass over each directory
+// ============================================
+void ScanIndex::replayed(void *ctx, const ScanRecord &r) {
+  ScanIndex *x = (ScanIndex *)ctx;
+  x->_records++;
+  if (r.op == SCAN_BASE) {
+    x->_gen = r.gen;
+    if (r.floor > x->_floor) x->_floor = r.floor;
+    return;
+  }
+  x->_gen = r.gen ? r.gen : x->_gen + 1;
+  if (r.op == SCAN_ADDED) {
+    // Written over under the same name: deduplicated once sorted
+    x->push(r.name, x->_gen, r.size, r.crc);
+    return;
+  }
+  // The queue uploads oldest first, so the entry is nearly always at the
+  // front of what is still live
+  int32_t i = x->indexOf(r.key, nullptr);
+  if (i >= 0) x->_entries[i].name[0] = '\0';
+  while (x->_live < x->_count && !x->_entries[x->_live].name[0]) x->_live++;
+  x->bury(r.key, x->_gen);
+}
+
+// Sorted by key here; anything the directory has that the journal does not
+// goes after them. hasThumb stands for "on the card" until the sidecars are
+// matched.
+void ScanIndex::listed(void *ctx, const char *name) {
+  ScanIndex *x = (ScanIndex *)ctx;
+  uint32_t key = galleryKey(name);
+  ScanEntry *end = x->_entries + x->_known;
+  ScanEntry *e = std::lower_bound(x->_entries, end, key,
+                                  [](const ScanEntry &a, uint32_t k) { return a.key < k; });
+  for (; e < end && e->key == key; e++) {
+    if (strcmp(e->name, name) == 0) {
+      e->hasThumb = true;
+      return;
+    }
+  }
+  if (strlen(name) >= GALLERY_NAME_MAX || x->_count == x->_max) {
+    x->_stats.dropped++;
+    return;
+  }
+  ScanEntry &n = x->_entries[x->_count++];
+  strcpy(n.name, name);
+  n.key = key;
+  n.gen = 0;
+  n.size = n.crc = 0;
+  n.hasThumb = true;
+}
+
+void ScanIndex::collectKey(void *ctx, uint32_t key) {
+  ScanIndex *x = (ScanIndex *)ctx;
+  x->_keys[x->_keyCount % x->_max] = key;
+  x->_keyCount++;
+}
+
+bool ScanIndex::build() {
+  uint32_t t0 = millis();
+  _count = _keyCount = _live = 0;
+  _gen = _floor = _records = 0;
+  _tombHead = _tombCount = 0;
+  _stats.dropped = 0;
+  if (!_journal->replay(replayed, this)) {
+    _count = 0;
+    return false;
+  }
+  sweep();
+
+  // A name journalled twice was written over: its newest record stands
+  std::sort(_entries, _entries + _count, [](const ScanEntry &a, const ScanEntry &b) {
+    return a.key != b.key ? a.key < b.key : a.gen < b.gen;
+  });
+  for (uint32_t i = 1; i < _count; i++) {
+    if (_entries[i].key == _entries[i - 1].key && strcmp(_entries[i].name, _entries[i - 1].name) == 0) {
+      _entries[i - 1].name[0] = '\0';
+    }
+  }
+  for (uint32_t i = 0; i < _count; i++) _entries[i].hasThumb = false;
+  _known = _count;
+  if (!_store->list(listed, this)) {
+    _count = 0;
+    return false;
+  }
+
+  // Journalled but gone: deleted behind the firmware's back, or while the
+  // journal could not be written
+  uint32_t fixed = _count - _known;
+  for (uint32_t i = 0; i < _known; i++) {
+    ScanEntry &e = _entries[i];
+    if (!e.name[0] || e.hasThumb) continue;
+    bury(e.key, ++_gen);
+    e.name[0] = '\0';
+    _stats.ghosts++;
+    fixed++;
+  }
+  // On the card but never journalled: queued by older firmware
+  for (uint32_t i = _known; i < _count; i++) {
+    _entries[i].gen = ++_gen;
+    _stats.adopted++;
+  }
+  sweep();
+  std::sort(_entries, _entries + _count,
+            [](const ScanEntry &a, const ScanEntry &b) { return a.gen < b.gen; });
+
+  if (!_store->listThumbs(collectKey, this)) _keyCount = 0;
+  if (_keyCount > _max) _keyCount = _max;
+  std::sort(_keys, _keys + _keyCount);
+  for (uint32_t i = 0; i < _count; i++) {
+    ScanEntry &e = _entries[i];
+    e.hasThumb = std::binary_search(_keys, _keys + _keyCount, e.key);
+  }
+  _built = true;
+  _stats.builds++;
+  _stats.buildMs = millis() - t0;
+  _stats.added = _stats.removed = 0;
+  // Whatever the pass above found goes in as one rewrite, not a record each
+  compact(fixed > 0);
+  return true;
+}
+
+bool ScanIndex::ready() { return _built || build(); }
+
+// ============================================
+// Compaction: live entries and tombstones, merged in generation order
+// ============================================
+bool ScanIndex::compacted(void *ctx, ScanRecord *r) {
+  ScanIndex *x = (ScanIndex *)ctx;
+  memset(r, 0, sizeof(*r));
+  if (!x->_emitBase) {
+    x->_emitBase = true;
+    r->op = SCAN_BASE;
+    r->gen = x->_gen;
+    r->floor = x->_floor;
+    return true;
+  }
+  bool entry = x->_emitEntry < x->_count;
+  bool tomb = x->_emitTomb < x->_tombCount;
+  const Tomb &t = x->_tombs[(x->_tombHead + x->_emitTomb) % SCAN_TOMBSTONES];
+  if (entry && (!tomb || x->_entries[x->_emitEntry].gen < t.gen)) {
+    const ScanEntry &e = x->_entries[x->_emitEntry++];
+    r->op = SCAN_ADDED;
+    r->gen = e.gen;
+    r->name = e.name;
+    r->size = e.size;
+    r->crc = e.crc;
+    return true;
+  }
+  if (!tomb) return false;
+  x->_emitTomb++;
+  r->op = SCAN_REMOVED;
+  r->gen = t.gen;
+  r->key = t.key;
+  return true;
+}
+
+// Once most of the journal is history, so that replaying it stays about as
+// cheap as listing the queue
+void ScanIndex::compact(bool force) {
+  uint32_t keep = _count + _tombCount + 1;
+  if (!force && _records <= 2 * keep + 64) return;
+  _emitBase = false;
+  _emitEntry = _emitTomb = 0;
+  if (!_journal->rewrite(compacted, this)) {
+    _stats.journalErrors++;
+    return;
+  }
+  _records = keep;
+  _stats.compactions++;
+}
+
+// ============================================
+// Keeping it current
+// ============================================
+void ScanIndex::add(const char *path, uint32_t size, uint32_t crc) {
+  if (!_lock || !path) return;
+  const char *name = baseName(path);
+  if (strlen(name) >= GALLERY_NAME_MAX) return;
+  uint32_t key = galleryKey(name);
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  journal(false, key, name, size, crc);
+  if (_built) {
+    // Written over: listed again at its new generation
+    int32_t i = indexOf(key, name);
+    if (i >= 0) {
+      memmove(_entries + i, _entries + i + 1, sizeof(ScanEntry) * (_count - i - 1));
+      _count--;
+    }
+    push(name, ++_gen, size, crc);
+    _stats.added++;
+    compact(false);
+  }
+  xSemaphoreGive(_lock);
+}
+
+void ScanIndex::remove(const char *path) {
+  if (!_lock || !path) return;
+  const char *name = baseName(path);
+  uint32_t key = galleryKey(name);
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  int32_t i = _built ? indexOf(key, name) : -1;
+  if (!_built) {
+    journal(true, key, nullptr, 0, 0);
+  } else if (i >= 0) {
+    journal(true, key, nullptr, 0, 0);
+    memmove(_entries + i, _entries + i + 1, sizeof(ScanEntry) * (_count - i - 1));
+    _count--;
+    bury(key, ++_gen);
+    _stats.removed++;
+    compact(false);
+  }
+  xSemaphoreGive(_lock);
+}
+
+// The sidecar is named by key, so any entry with it has a thumbnail now
+void ScanIndex::setThumb(const char *path) {
+  if (!_lock || !path) return;
+  uint32_t key = galleryKey(path);
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  int32_t i = _built ? indexOf(key, nullptr) : -1;
+  if (i >= 0) _entries[i].hasThumb = true;
+  xSemaphoreGive(_lock);
+}
+
+void ScanIndex::lastGen(void *ctx, const ScanRecord &r) {
+  ScanIndex *x = (ScanIndex *)ctx;
+  x->_gen = r.gen ? r.gen : x->_gen + 1;
+}
+
+// Every generation so far is below the new floor, so clients get a full
+// (empty) listing instead of a removal per file
+void ScanIndex::wiped() {
+  if (!_lock) return;
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  if (!_built) {
+    _gen = 0;
+    _journal->replay(lastGen, this);
+  }
+  _count = _live = 0;
+  _tombHead = _tombCount = 0;
+  _floor = ++_gen;
+  _emitBase = false;
+  _emitEntry = _emitTomb = 0;
+  if (_journal->rewrite(compacted, this)) _records = 1;
+  else _stats.journalErrors++;
+  xSemaphoreGive(_lock);
+}
+
+// ============================================
+// Reading
+// ============================================
+int32_t ScanIndex::page(uint32_t cursor, ScanEntry *out, uint16_t max, uint32_t *next,
+                        uint16_t *total) {
+  *next = 0;
+  *total = 0;
+  if (!_lock) return -1;
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  if (!ready()) {
+    xSemaphoreGive(_lock);
+    return -1;
+  }
+  // Entries are in generation order: the page ends just below the cursor
+  uint32_t end = _count;
+  if (cursor) {
+    end = (uint32_t)(std::lower_bound(_entries, _entries + _count, cursor,
+                                      [](const ScanEntry &e, uint32_t g) { return e.gen < g; }) -
+                     _entries);
+  }
+  uint16_t n = 0;
+  while (n < max && end > 0) out[n++] = _entries[--end];
+  if (end > 0 && n > 0) *next = out[n - 1].gen;
+  *total = (uint16_t)_count;
+  _stats.pages++;
+  xSemaphoreGive(_lock);
+  return n;
+}
+
+int32_t ScanIndex::changes(uint32_t since, uint32_t cursor, ScanChange *out, uint16_t max,
+                           bool *reset, uint32_t *next, uint32_t *generation) {
+  *reset = false;
+  *next = *generation = 0;
+  if (!_lock) return -1;
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  if (!ready()) {
+    xSemaphoreGive(_lock);
+    return -1;
+  }
+  *reset = since == 0 || since < _floor || since > _gen;
+  *generation = _gen;
+  uint32_t after = *reset ? cursor : std::max(since, cursor);
+
+  uint32_t e = (uint32_t)(std::upper_bound(_entries, _entries + _count, after,
+                                           [](uint32_t g, const ScanEntry &x) { return g < x.gen; }) -
+                          _entries);
+  uint16_t t = 0;
+  if (*reset) t = _tombCount; // a full listing names only what is there
+  while (t < _tombCount && _tombs[(_tombHead + t) % SCAN_TOMBSTONES].gen <= after) t++;
+
+  uint16_t n = 0;
+  while (n < max && (e < _count || t < _tombCount)) {
+    ScanChange &c = out[n++];
+    const Tomb &tomb = _tombs[(_tombHead + t) % SCAN_TOMBSTONES];
+    if (e < _count && (t == _tombCount || _entries[e].gen < tomb.gen)) {
+      c.removed = false;
+      c.entry = _entries[e++];
+    } else {
+      c.removed = true;
+      memset(&c.entry, 0, sizeof(c.entry));
+      c.entry.key = tomb.key;
+      c.entry.gen = tomb.gen;
+      t++;
+    }
+  }
+  if (n > 0 && (e < _count || t < _tombCount)) *next = out[n - 1].entry.gen;
+  _stats.pages++;
+  xSemaphoreGive(_lock);
+  return n;
+}
+
+bool ScanIndex::find(uint32_t key, ScanEntry *out) {
+  if (!_lock) return false;
+  xSemaphoreTake(_lock, portMAX_DELAY);
+  int32_t i = ready() ? indexOf(key, nullptr) : -1;
+  if (i >= 0) *out = _entries[i];
+  xSemaphoreGive(_lock);
+  return i >= 0;
+}
+
+void ScanIndex::getStats(ScanIndexStats *out) const {
+  if (_lock) xSemaphoreTake(_lock, portMAX_DELAY);
+  *out = _stats;
+  out->built = _built;
+  out->entries = (uint16_t)_count;
+  out->generation = _gen;
+  out->floor = _floor;
+  out->journalRecords = _records;
+  if (_lock) xSemaphoreGive(_lock);
+}
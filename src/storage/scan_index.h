@@ -0,0 +1,178 @@
+// ============================================
+// Scan Index - ResearchMate
+// The upload queue as the LAN API lists it (/api/scans, /api/sync), with
+// each file's size and CRC-32 and the generation it was added in.
+//
+// Generations come from a change journal on the card (ScanJournal): one
+// record per file queued or removed, numbered in order, kept across
+// reboots. Files are hashed as they are written, so the journal has their
+// CRC without reading them back. A desktop agent that remembers the last
+// generation it saw asks only for what came after it (changes()); removals
+// are kept as tombstones for the last SCAN_TOMBSTONES of them, and an agent
+// further behind than that (or than the last compaction) is told to start
+// over from a full listing.
+//
+// Built the first time it is asked for: the journal is replayed, then
+// checked against one pass over the queue directory. Files the journal does
+// not know (queued by older firmware) go in without a size or CRC: reading
+// a backlog back in full would hold the caller for minutes. Journalled
+// files no longer on the card are taken as removed.
+// After that, the code that saves, queues and deletes files keeps both
+// current (add() / remove()), and nothing reads the directory again. Reads
+// go through GalleryStore / ScanJournal, so the index runs on a host
+// against a fake card.
+//
+// Any task may call it (saves come from loop(), the burst writer and cloud
+// jobs); one mutex guards the entries and the journal.
+// ============================================
+
+#ifndef SCAN_INDEX_H
+#define SCAN_INDEX_H
+
+#include "../config.h"
+#include "../ui/gallery.h"
+#include <Arduino.h>
+
+struct ScanEntry {
+  char name[GALLERY_NAME_MAX]; // file name inside the queue directory
+  uint32_t key;                // galleryKey(name): the scan's id in the API
+  uint32_t gen;                // generation it was added in
+  uint32_t size;               // 0 with crc: not known (queued by older firmware)
+  uint32_t crc;                // CRC-32 (IEEE) of the whole file
+  bool hasThumb;
+};
+
+// One journal record. gen 0: the one after the previous record, so an
+// append need not know the count; compaction writes them out in full.
+enum ScanOp : uint8_t {
+  SCAN_ADDED,
+  SCAN_REMOVED,
+  SCAN_BASE,            // compacted journal's first record: gen and floor
+};
+
+struct ScanRecord {
+  ScanOp op;
+  uint32_t gen;
+  uint32_t key;         // removed: which scan (its name may be long gone)
+  const char *name;     // added
+  uint32_t size;        // added
+  uint32_t crc;         // added
+  uint32_t floor;       // base
+};
+
+class ScanJournal {
+public:
+  virtual ~ScanJournal() {}
+  // Every record in order. False if the journal cannot be read; an absent
+  // one is empty.
+  virtual bool replay(void (*fn)(void *ctx, const ScanRecord &r), void *ctx) = 0;
+  virtual bool append(const ScanRecord &r) = 0;
+  // Replace the journal with the records `next` hands out until it
+  // returns false; the old one stays if this fails
+  virtual bool rewrite(bool (*next)(void *ctx, ScanRecord *r), void *ctx) = 0;
+};
+
+// One change for a syncing client, in generation order
+struct ScanChange {
+  bool removed;
+  ScanEntry entry;        // removed: only key and gen are set
+};
+
+struct ScanIndexStats {
+  bool built;
+  uint32_t builds;      // journal replays + directory passes
+  uint32_t buildMs;     // last one
+  uint16_t entries;
+  uint16_t dropped;     // oldest files left out: more than the index holds
+  uint32_t added;       // kept current since the last build
+  uint32_t removed;
+  uint32_t adopted;     // files found on the card that the journal did not know
+  uint32_t ghosts;      // journalled files found missing from the card
+  uint32_t generation;
+  uint32_t floor;       // oldest generation changes() can still answer from
+  uint32_t journalRecords;
+  uint32_t journalErrors;
+  uint32_t compactions;
+  uint32_t pages;
+};
+
+class ScanIndex {
+public:
+  // Caller-owned memory (PSRAM on the device): the entries and as many
+  // sidecar keys, the latter only used while building. Nothing is read
+  // until the first page(), changes() or find(), but add() and remove()
+  // are journalled from here on.
+  bool attach(GalleryStore *store, ScanJournal *journal, ScanEntry *entries, uint32_t *keys,
+              uint16_t maxEntries);
+
+  // Queue changes; `path` may be a full path or a bare name. add() with
+  // the size and CRC of what was written.
+  void add(const char *path, uint32_t size, uint32_t crc);
+  void remove(const char *path);
+  void setThumb(const char *path);
+  // Whole queue wiped: the journal starts over, and so does every client
+  void wiped();
+
+  // Up to `max` entries older than `cursor` (0: from the newest), newest
+  // first. *next is the cursor for the following page, 0 after the last.
+  // -1 if the queue cannot be read.
+  int32_t page(uint32_t cursor, ScanEntry *out, uint16_t max, uint32_t *next, uint16_t *total);
+
+  // Changes after generation `since`, oldest first, `max` at a time:
+  // `cursor` is 0 for the first page and *next for each one after (0 after
+  // the last). *reset when `since` is 0, or older than the index can answer
+  // for, or from another card: the pages are then a full listing and the
+  // client drops whatever they do not name. *generation is the newest one
+  // now; a client that keeps the one from its first page sees everything
+  // after it next time. -1 if the queue cannot be read.
+  int32_t changes(uint32_t since, uint32_t cursor, ScanChange *out, uint16_t max, bool *reset,
+                  uint32_t *next, uint32_t *generation);
+
+  bool find(uint32_t key, ScanEntry *out);
+
+  void getStats(ScanIndexStats *out) const;
+
+private:
+  struct Tomb {
+    uint32_t key;
+    uint32_t gen;
+  };
+
+  bool build();             // under the lock
+  bool ready();             // built, or built now
+  bool journal(bool removed, uint32_t key, const char *name, uint32_t size, uint32_t crc);
+  void compact(bool force);
+  int32_t indexOf(uint32_t key, const char *name) const;
+  bool push(const char *name, uint32_t gen, uint32_t size, uint32_t crc);
+  void bury(uint32_t key, uint32_t gen);
+  void sweep();             // drops entries marked dead (name[0] == 0)
+  static void replayed(void *ctx, const ScanRecord &r);
+  static void lastGen(void *ctx, const ScanRecord &r);
+  static void listed(void *ctx, const char *name);
+  static void collectKey(void *ctx, uint32_t key);
+  static bool compacted(void *ctx, ScanRecord *r);
+
+  GalleryStore *_store = nullptr;
+  ScanJournal *_journal = nullptr;
+  ScanEntry *_entries = nullptr;
+  uint16_t _max = 0;
+  uint32_t _count = 0;
+  uint32_t _gen = 0;        // newest generation
+  uint32_t _floor = 0;
+  uint32_t _records = 0;    // in the journal file
+  bool _built = false;
+  Tomb _tombs[SCAN_TOMBSTONES] = {}; // ring, oldest at _tombHead
+  uint16_t _tombHead = 0;
+  uint16_t _tombCount = 0;
+  uint32_t *_keys = nullptr;
+  uint32_t _keyCount = 0;
+  uint32_t _known = 0;      // build(): entries the journal accounted for
+  uint32_t _live = 0;       // replay: entries below this are all dead
+  bool _emitBase = false;   // compact(): merge position
+  uint32_t _emitEntry = 0;
+  uint16_t _emitTomb = 0;
+  SemaphoreHandle_t _lock = nullptr;
+  ScanIndexStats _stats = {};
+};
+
+#endif // SCAN_INDEX_H
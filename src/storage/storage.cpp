@@ -1,6 +1,15 @@
 #include "storage.h"
 #include "../config.h"
+#include "../ui/gallery.h"
+#include "file_pins.h"
+#include "scan_index.h"
+#include "thumbnail.h"
+#include "../utils/metrics.h"
+#include <dirent.h>
 #include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 // Define a custom SPI class instance for the SD card
 SPIClass sdSPI(HSPI);
@@ -8,7 +17,23 @@ SPIClass sdSPI(HSPI);
 #define LOG_DEBUG(fmt, ...) Serial.printf(fmt "\n", ##__VA_ARGS__)
 #define LOG_ERROR(fmt, ...) Serial.printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
 
+// Scan index change journal (8.3 names, outside the queue directory)
+#define JOURNAL_PATH     SD_MOUNT "/scanlog.txt"
+#define JOURNAL_NEW_PATH SD_MOUNT "/scanlog.new"
+
 static bool sdCardInitialized = false;
+static ScanIndex scanIndex;
+static FilePins filePins(SD_MOUNT);
+
+// Queue saves (captures, burst pages) and reads back for upload
+static MetricCounter sdWriteBytes("researchmate_sd_write_bytes_total", "Bytes written to the SD card.",
+                                  "caller=\"queue\"");
+static MetricHistogram sdWriteSeconds("researchmate_sd_write_seconds", "Time to write one file to the SD card.",
+                                      METRIC_LATENCY_US, 1e-6, "caller=\"queue\"");
+static MetricCounter sdReadBytes("researchmate_sd_read_bytes_total", "Bytes read from the SD card.",
+                                 "caller=\"upload\"");
+static MetricHistogram sdReadSeconds("researchmate_sd_read_seconds",
+                                     "SD read time per file read back or block streamed.", METRIC_LATENCY_US, 1e-6, "caller=\"upload\"");
 
 bool initSDCard() {
   // Explicitly pull CS HIGH before SPI init to prevent floating state failures
@@ -46,6 +71,8 @@ bool initSDCard() {
     SD.mkdir("/queue");
   }
 
+  // Journal queue changes from here on, for /api/sync
+  queueScanIndex();
   return true;
 }
 
@@ -64,8 +91,11 @@ String saveImageToSD(const uint8_t *data, size_t size) {
     return "";
   }
 
+  uint32_t t0 = micros();
   size_t written = file.write(data, size);
   file.close();
+  sdWriteSeconds.observe(micros() - t0);
+  sdWriteBytes.add(written);
 
   if (written != size) {
     LOG_ERROR("[SD] Write failed. Expected %d bytes, wrote %d bytes", size,
@@ -75,6 +105,7 @@ String saveImageToSD(const uint8_t *data, size_t size) {
   }
 
   LOG_DEBUG("[SD] Saved offline image: %s (%d bytes)", filename.c_str(), size);
+  scanIndex.add(filename.c_str(), size, esp_rom_crc32_le(0, data, size));
   return filename;
 }
 
@@ -100,7 +131,9 @@ String getNextPendingUpload() {
         result = "/queue" + result;
       }
 
-      break;
+      // Already uploaded, its delete waiting for a download to finish
+      if (!filePins.doomed(result.c_str())) break;
+      result = "";
     }
     file = root.openNextFile();
   }
@@ -108,10 +141,27 @@ String getNextPendingUpload() {
   return result;
 }
 
+// A file a download or the export has open is removed by them once they
+// close it (storage/file_pins.h); as far as the queue goes it is gone now
+static bool removeQueued(const char *path) {
+  if (!filePins.claim(path)) {
+    LOG_DEBUG("[SD] %s is being downloaded, deleting it after", path);
+    return true;
+  }
+  bool ok = SD.remove(path);
+  filePins.deleted(path);
+  return ok;
+}
+
 bool deleteImageFromSD(const String &filename) {
+  String thumb = thumbnailPath(filename);
+  if (SD.exists(thumb.c_str())) {
+    removeQueued(thumb.c_str());
+  }
   if (SD.exists(filename.c_str())) {
-    if (SD.remove(filename.c_str())) {
+    if (removeQueued(filename.c_str())) {
       LOG_DEBUG("[SD] Deleted file: %s", filename.c_str());
+      scanIndex.remove(filename.c_str());
       return true;
     } else {
       LOG_ERROR("[SD] Failed to delete file: %s", filename.c_str());
@@ -153,12 +203,15 @@ uint8_t *readImageFromSD(const String &filename, size_t *outSize) {
   // The ESP32 will crash/hang the SPI bus if we do a blocking multi-kilobyte read
   size_t totalRead = 0;
   const size_t CHUNK_SIZE = 1024; // Read 1KB at a time
+  uint32_t readUs = 0;            // the reads alone, not the yields
 
   while (totalRead < size) {
     size_t toRead = size - totalRead;
     if (toRead > CHUNK_SIZE) toRead = CHUNK_SIZE;
     
+    uint32_t t0 = micros();
     size_t bytesRead = file.read(buffer + totalRead, toRead);
+    readUs += micros() - t0;
     if (bytesRead == 0) break; // End of file or error
     
     totalRead += bytesRead;
@@ -166,6 +219,8 @@ uint8_t *readImageFromSD(const String &filename, size_t *outSize) {
   }
 
   file.close();
+  sdReadSeconds.observe(readUs);
+  sdReadBytes.add(totalRead);
 
   if (totalRead != size) {
     LOG_ERROR("[SD] Read failed. Expected %d bytes, read %d bytes", size, totalRead);
@@ -178,22 +233,252 @@ uint8_t *readImageFromSD(const String &filename, size_t *outSize) {
   return buffer;
 }
 
-void wipeOfflineQueue() {
-  File dir = SD.open("/queue");
+// ============================================
+// Gallery access to the queue
+// ============================================
+class SdQueueStore : public GalleryStore {
+public:
+  // readdir rather than openNextFile(): the latter stats and opens every
+  // entry, each a search of the directory from its start
+  bool list(void (*fn)(void *ctx, const char *name), void *ctx) override {
+    if (!sdCardInitialized)
+      return false;
+    DIR *dir = opendir(SD_MOUNT "/queue");
+    if (!dir)
+      return false;
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != nullptr) {
+      if (de->d_type != DT_DIR) fn(ctx, de->d_name);
+    }
+    closedir(dir);
+    return true;
+  }
+
+  bool listThumbs(void (*fn)(void *ctx, uint32_t key), void *ctx) override {
+    DIR *dir = opendir(SD_MOUNT "/queue/" GALLERY_THUMB_DIR);
+    if (!dir)
+      return false;
+
+    struct dirent *de;
+    uint32_t key;
+    while ((de = readdir(dir)) != nullptr) {
+      if (de->d_type != DT_DIR && galleryThumbKey(de->d_name, &key)) fn(ctx, key);
+    }
+    closedir(dir);
+    return true;
+  }
+
+  int32_t readThumb(uint32_t key, uint8_t *buf, size_t cap) override {
+    char name[13], path[40];
+    galleryThumbName(key, name);
+    snprintf(path, sizeof(path), "/queue/" GALLERY_THUMB_DIR "/%s", name);
+    File file = SD.open(path, FILE_READ);
+    if (!file)
+      return -1;
+    size_t size = file.size();
+    if (size == 0 || size > cap) {
+      file.close();
+      return -1;
+    }
+    // Same 1KB chunks as readImageFromSD; a sidecar is only a few of them
+    size_t totalRead = 0;
+    while (totalRead < size) {
+      size_t toRead = size - totalRead;
+      if (toRead > 1024) toRead = 1024;
+      size_t bytesRead = file.read(buf + totalRead, toRead);
+      if (bytesRead == 0) break;
+      totalRead += bytesRead;
+    }
+    file.close();
+    return totalRead == size ? (int32_t)size : -1;
+  }
+};
+
+GalleryStore &queueGalleryStore() {
+  static SdQueueStore store;
+  return store;
+}
+
+// Size and CRC-32 of a file in the queue, for a writer that could not hash
+// it on the way out
+static bool hashQueueFile(const char *name, uint32_t *size, uint32_t *crc) {
+  char path[24 + GALLERY_NAME_MAX];
+  snprintf(path, sizeof(path), SD_MOUNT "/queue/%s", name);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  uint8_t *buf = (uint8_t *)heap_caps_malloc(FILE_STREAM_BLOCK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  ssize_t n = 0;
+  uint32_t total = 0, c = 0;
+  while (buf && (n = read(fd, buf, FILE_STREAM_BLOCK)) > 0) {
+    c = esp_rom_crc32_le(c, buf, n);
+    total += (uint32_t)n;
+  }
+  close(fd);
+  heap_caps_free(buf);
+  if (!buf || n < 0)
+    return false;
+  *size = total;
+  *crc = c;
+  return true;
+}
+
+// ============================================
+// Scan index journal: one text line per record
+//   = <gen> <floor>              compacted journal's first line
+//   + <name> <size> <crc>[ <gen>]
+//   - <key>[ <gen>]
+// Appends are a line each; a torn last line is skipped on replay.
+// ============================================
+class SdScanJournal : public ScanJournal {
+public:
+  bool replay(void (*fn)(void *ctx, const ScanRecord &r), void *ctx) override {
+    if (!sdCardInitialized)
+      return false;
+    FILE *f = fopen(JOURNAL_PATH, "r");
+    if (!f) {
+      // A compaction that stopped between its remove and rename left the
+      // new journal complete
+      if (rename(JOURNAL_NEW_PATH, JOURNAL_PATH) == 0) f = fopen(JOURNAL_PATH, "r");
+      if (!f) return true;
+    }
+    char line[GALLERY_NAME_MAX + 48], name[GALLERY_NAME_MAX];
+    while (fgets(line, sizeof(line), f)) {
+      if (!strchr(line, '\n'))
+        break; // torn by a power cut mid-append
+      ScanRecord r = {};
+      unsigned long a = 0, b = 0, c = 0;
+      int n;
+      if (line[0] == '=' && sscanf(line + 1, "%lu %lu", &a, &b) == 2) {
+        r.op = SCAN_BASE;
+        r.gen = a;
+        r.floor = b;
+      } else if (line[0] == '+' &&
+                 (n = sscanf(line + 1, "%39s %lu %lx %lu", name, &a, &b, &c)) >= 3) { // GALLERY_NAME_MAX - 1
+        r.op = SCAN_ADDED;
+        r.name = name;
+        r.size = a;
+        r.crc = b;
+        r.gen = n == 4 ? c : 0;
+      } else if (line[0] == '-' && (n = sscanf(line + 1, "%lx %lu", &a, &c)) >= 1) {
+        r.op = SCAN_REMOVED;
+        r.key = a;
+        r.gen = n == 2 ? c : 0;
+      } else {
+        continue;
+      }
+      fn(ctx, r);
+    }
+    fclose(f);
+    return true;
+  }
+
+  bool append(const ScanRecord &r) override {
+    if (!sdCardInitialized)
+      return false;
+    FILE *f = fopen(JOURNAL_PATH, "a");
+    if (!f)
+      return false;
+    bool ok = writeRecord(f, r);
+    return fclose(f) == 0 && ok;
+  }
+
+  bool rewrite(bool (*next)(void *ctx, ScanRecord *r), void *ctx) override {
+    if (!sdCardInitialized)
+      return false;
+    FILE *f = fopen(JOURNAL_NEW_PATH, "w");
+    if (!f)
+      return false;
+    bool ok = true;
+    ScanRecord r;
+    while (ok && next(ctx, &r)) ok = writeRecord(f, r);
+    if (fclose(f) != 0 || !ok) {
+      remove(JOURNAL_NEW_PATH);
+      return false;
+    }
+    // FAT will not rename over a file
+    remove(JOURNAL_PATH);
+    return rename(JOURNAL_NEW_PATH, JOURNAL_PATH) == 0;
+  }
+
+private:
+  static bool writeRecord(FILE *f, const ScanRecord &r) {
+    int n;
+    if (r.op == SCAN_BASE) {
+      n = fprintf(f, "= %lu %lu\n", (unsigned long)r.gen, (unsigned long)r.floor);
+    } else if (r.op == SCAN_ADDED) {
+      n = r.gen ? fprintf(f, "+ %s %lu %08lx %lu\n", r.name, (unsigned long)r.size,
+                          (unsigned long)r.crc, (unsigned long)r.gen)
+                : fprintf(f, "+ %s %lu %08lx\n", r.name, (unsigned long)r.size,
+                          (unsigned long)r.crc);
+    } else {
+      n = r.gen ? fprintf(f, "- %08lx %lu\n", (unsigned long)r.key, (unsigned long)r.gen)
+                : fprintf(f, "- %08lx\n", (unsigned long)r.key);
+    }
+    return n > 0;
+  }
+};
+
+ScanIndex &queueScanIndex() {
+  static SdScanJournal journal;
+  static bool attached = false;
+  if (!attached) {
+    ScanEntry *entries = (ScanEntry *)heap_caps_malloc(sizeof(ScanEntry) * SCAN_INDEX_MAX,
+                                                       MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint32_t *keys = (uint32_t *)heap_caps_malloc(sizeof(uint32_t) * SCAN_INDEX_MAX,
+                                                  MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    attached = scanIndex.attach(&queueGalleryStore(), &journal, entries, keys, SCAN_INDEX_MAX);
+    if (!attached) {
+      LOG_ERROR("[SD] No memory for the scan index (%d entries)", SCAN_INDEX_MAX);
+      heap_caps_free(entries);
+      heap_caps_free(keys);
+    }
+  }
+  return scanIndex; // unattached: every page() fails
+}
+
+void queueFileAdded(const String &path, uint32_t size, uint32_t crc) {
+  scanIndex.add(path.c_str(), size, crc);
+}
+
+void queueFileAdded(const String &path) {
+  uint32_t size, crc;
+  int slash = path.lastIndexOf('/');
+  String name = slash >= 0 ? path.substring(slash + 1) : path;
+  if (hashQueueFile(name.c_str(), &size, &crc)) scanIndex.add(path.c_str(), size, crc);
+}
+
+void queueThumbAdded(const String &scanPath) { scanIndex.setThumb(scanPath.c_str()); }
+
+FilePins &queueFilePins() { return filePins; }
+
+// Remove every file in a directory; returns how many went
+static int wipeDirectory(const char *path) {
+  File dir = SD.open(path);
   if (!dir || !dir.isDirectory()) {
-    return;
+    return 0;
   }
 
   File file = dir.openNextFile();
   int count = 0;
   while (file) {
-    String filename = String("/queue/") + file.name();
+    String filename = String(path) + "/" + file.name();
+    bool isDir = file.isDirectory();
     file.close(); // Close before deleting
-    if (SD.remove(filename.c_str())) {
+    if (!isDir && SD.remove(filename.c_str())) {
       count++;
       LOG_DEBUG("[SD WIPE] Deleted %s", filename.c_str());
     }
     file = dir.openNextFile();
   }
+  dir.close();
+  return count;
+}
+
+void wipeOfflineQueue() {
+  int count = wipeDirectory("/queue/" GALLERY_THUMB_DIR);
+  count += wipeDirectory("/queue");
+  scanIndex.wiped();
   LOG_DEBUG("[SD WIPE] Wiped %d total files from queue.", count);
 }
\ No newline at end of file
@@ -6,6 +6,9 @@
 #include <SD.h>
 #include <FS.h>
 
+// VFS path of the card (SD.begin()'s default mount point), for POSIX calls
+#define SD_MOUNT "/sd"
+
 bool initSDCard();
 String saveImageToSD(const uint8_t* data, size_t size);
 String getNextPendingUpload();
@@ -13,4 +16,24 @@ bool deleteImageFromSD(const String& filename);
 void wipeOfflineQueue();
 uint8_t* readImageFromSD(const String& filename, size_t* outSize);
 
+// The upload queue as seen by the on-device gallery (ui/gallery.h)
+class GalleryStore;
+GalleryStore& queueGalleryStore();
+
+// The queue as the LAN API lists and syncs it (storage/scan_index.h). Its
+// memory is taken once the card is mounted, and from then on every change
+// to the queue is journalled.
+class ScanIndex;
+ScanIndex& queueScanIndex();
+// Files and sidecars written into the queue outside this module: with the
+// size and CRC-32 of what was written, or read back to get them
+void queueFileAdded(const String& path, uint32_t size, uint32_t crc);
+void queueFileAdded(const String& path);
+void queueThumbAdded(const String& scanPath);
+
+// Queue files downloads and the export have open; deleteImageFromSD()
+// leaves those to be removed when they close (storage/file_pins.h)
+class FilePins;
+FilePins& queueFilePins();
+
 #endif
\ No newline at end of file
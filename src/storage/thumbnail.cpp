@@ -0,0 +1,155 @@
+#include "thumbnail.h"
+#include "../config.h"
+#include "../imaging/jpeg_decoder.h"
+#include "../imaging/jpeg_scan.h"
+#include "../imaging/resampler.h"
+#include "../ui/gallery.h"
+#include "img_converters.h"
+#include "storage.h"
+#include <SD.h>
+#include <esp_heap_caps.h>
+
+#define LOG_DEBUG(fmt, ...) Serial.printf(fmt "\n", ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) Serial.printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
+
+// The 1/8 decode is averaged over BOX x BOX pixels before the bilinear
+// resample: straight from 1/8 a UXGA page shrinks ~4:1 more and its text
+// lines alias into stripes.
+#define BOX        4
+#define BOX_MAX_W  64   // box columns: scans up to 2048 px wide
+
+// Decoder tables/scratch, kept after the first scan (only loop() saves scans)
+static JpegDecoder *decoder = nullptr;
+
+struct ThumbCtx {
+  ResampleState rs;
+  uint16_t boxW;
+  int16_t boxRow;                 // box row being summed, -1 = none yet
+  uint16_t sum[3][BOX_MAX_W];     // R5, G6, B5 sums
+  uint8_t n[BOX_MAX_W];
+  uint16_t row[BOX_MAX_W];
+  uint16_t px[GALLERY_THUMB_W * GALLERY_THUMB_H]; // big-endian, as fmt2jpg reads RGB565
+};
+
+static bool flushBoxRow(ThumbCtx *t) {
+  if (t->boxRow < 0) return true;
+  for (uint16_t c = 0; c < t->boxW; c++) {
+    uint8_t n = t->n[c] ? t->n[c] : 1;
+    t->row[c] = (uint16_t)((t->sum[0][c] / n) << 11 | (t->sum[1][c] / n) << 5 | t->sum[2][c] / n);
+  }
+  memset(t->sum, 0, sizeof(t->sum));
+  memset(t->n, 0, sizeof(t->n));
+  return resamplePushBlock(&t->rs, 0, t->boxRow, t->boxW, 1, t->row);
+}
+
+static bool thumb_input(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                        uint16_t *bitmap) {
+  ThumbCtx *t = (ThumbCtx *)ctx;
+  if (y / BOX != t->boxRow) {
+    if (!flushBoxRow(t)) return false;
+    t->boxRow = y / BOX;
+  }
+  // MCU heights at 1/8 (1 or 2 rows) divide BOX: a block never spans box rows
+  for (uint16_t r = 0; r < h; r++) {
+    for (uint16_t i = 0; i < w; i++) {
+      uint16_t p = bitmap[r * w + i];
+      uint16_t c = (x + i) / BOX;
+      t->sum[0][c] += p >> 11;
+      t->sum[1][c] += (p >> 5) & 0x3F;
+      t->sum[2][c] += p & 0x1F;
+      t->n[c]++;
+    }
+  }
+  return true;
+}
+
+static bool thumb_output(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h,
+                         uint16_t *bitmap) {
+  memcpy(((ThumbCtx *)ctx)->px + (size_t)y * GALLERY_THUMB_W, bitmap, sizeof(uint16_t) * w * h);
+  return true;
+}
+
+String thumbnailPath(const String &scanPath) {
+  char name[13];
+  galleryThumbName(galleryKey(scanPath.c_str()), name);
+  return String("/queue/" GALLERY_THUMB_DIR "/") + name;
+}
+
+// 1/8 decode, box-averaged, centre-cropped to the thumbnail's 4:3
+static bool buildThumb(ThumbCtx *t, const uint8_t *jpg, size_t len, uint8_t **work) {
+  JpegInfo info;
+  if (jpegReadHeader(jpg, len, &info) != JPEG_OK || !info.width) return false;
+  uint16_t decW = (info.width + 7) >> 3, decH = (info.height + 7) >> 3;
+  t->boxW = (decW + BOX - 1) / BOX;
+  t->boxRow = -1;
+  if (t->boxW > BOX_MAX_W) return false;
+  memset(t->sum, 0, sizeof(t->sum));
+  memset(t->n, 0, sizeof(t->n));
+
+  ResampleConfig cfg = {};
+  cfg.srcW = t->boxW;
+  cfg.srcH = (decH + BOX - 1) / BOX;
+  cfg.dstW = GALLERY_THUMB_W;
+  cfg.dstH = GALLERY_THUMB_H;
+  cfg.fit = RESAMPLE_FIT_CROP;
+  cfg.bandRows = 1;
+  cfg.blockRows = GALLERY_THUMB_H;
+  cfg.swapOut = true;
+  *work = (uint8_t *)heap_caps_malloc(resampleWorkBytes(cfg), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if (!*work || !resampleInit(&t->rs, cfg, *work, thumb_output, t)) return false;
+
+  JpegDecodeOptions opt = {};
+  opt.scale = 3;
+  return jpegDecode(decoder, jpg, len, opt, thumb_input, t, nullptr) == JPEG_DEC_OK &&
+         flushBoxRow(t) && resampleFinish(&t->rs);
+}
+
+bool saveThumbnailToSD(const String &scanPath, const uint8_t *jpg, size_t len) {
+  if (!jpg) return false;
+  String path = thumbnailPath(scanPath);
+  uint32_t t0 = millis();
+
+  if (!decoder) {
+    decoder = (JpegDecoder *)heap_caps_malloc(sizeof(JpegDecoder),
+                                              MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!decoder) {
+      LOG_ERROR("[Thumb] No memory for the decoder");
+      return false;
+    }
+  }
+  ThumbCtx *t = (ThumbCtx *)heap_caps_malloc(sizeof(ThumbCtx), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  if (!t) {
+    LOG_ERROR("[Thumb] No memory for %s", path.c_str());
+    return false;
+  }
+  uint8_t *work = nullptr;
+  bool ok = buildThumb(t, jpg, len, &work);
+  heap_caps_free(work);
+
+  uint8_t *out = nullptr;
+  size_t outLen = 0;
+  if (ok) {
+    ok = fmt2jpg((uint8_t *)t->px, sizeof(t->px), GALLERY_THUMB_W, GALLERY_THUMB_H,
+                 PIXFORMAT_RGB565, THUMB_QUALITY, &out, &outLen) &&
+         outLen <= GALLERY_FILE_MAX;
+  }
+  heap_caps_free(t);
+
+  if (ok) {
+    if (!SD.exists("/queue/" GALLERY_THUMB_DIR)) SD.mkdir("/queue/" GALLERY_THUMB_DIR);
+    File file = SD.open(path.c_str(), FILE_WRITE);
+    ok = file && file.write(out, outLen) == outLen;
+    if (file) file.close();
+    if (!ok) SD.remove(path.c_str());
+  }
+  free(out);
+
+  if (!ok) {
+    LOG_ERROR("[Thumb] Could not write %s for %s", path.c_str(), scanPath.c_str());
+    return false;
+  }
+  LOG_DEBUG("[Thumb] %s for %s (%u bytes, %lums)", path.c_str(), scanPath.c_str(),
+            (unsigned)outLen, (unsigned long)(millis() - t0));
+  queueThumbAdded(scanPath);
+  return true;
+}
@@ -0,0 +1,21 @@
+// ============================================
+// Scan Thumbnails - ResearchMate
+// A small JPEG sidecar written for each queued scan when it is saved
+// (/queue/thumbs/<hash of the scan's name>.thm, see ui/gallery.h): 1/8
+// decode of the capture, averaged and resampled to the gallery's thumbnail
+// size, re-encoded. The gallery only ever reads these, never the scans.
+// ============================================
+
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+#include <Arduino.h>
+
+// Sidecar path for a queued scan.
+String thumbnailPath(const String &scanPath);
+
+// Build the thumbnail from the captured JPEG and write it beside scanPath.
+// A failure only costs the gallery its picture; the scan is unaffected.
+bool saveThumbnailToSD(const String &scanPath, const uint8_t *jpg, size_t len);
+
+#endif // THUMBNAIL_H
@@ -0,0 +1,117 @@
+#include "gallery.h"
+#include "../storage/scan_index.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+uint32_t galleryKey(const char *name) {
+  const char *slash = strrchr(name, '/');
+  if (slash) name = slash + 1;
+  const char *dot = strrchr(name, '.');
+  size_t n = dot ? (size_t)(dot - name) : strlen(name);
+  uint32_t h = 2166136261u; // FNV-1a
+  for (size_t i = 0; i < n; i++) {
+    h ^= (uint8_t)name[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+void galleryThumbName(uint32_t key, char *out) {
+  snprintf(out, 13, "%08lx.thm", (unsigned long)key);
+}
+
+bool galleryThumbKey(const char *name, uint32_t *key) {
+  char *end;
+  unsigned long k = strtoul(name, &end, 16);
+  if (end != name + 8 || strcasecmp(end, ".thm") != 0) return false;
+  *key = (uint32_t)k;
+  return true;
+}
+
+bool Gallery::attach(GalleryEntry *entries, uint16_t maxEntries, uint16_t *thumbs, uint8_t slots,
+                     uint8_t *fileBuf) {
+  if (!entries || !maxEntries || !thumbs || !slots || !fileBuf) return false;
+  _entries = entries;
+  _max = maxEntries;
+  _thumbs = thumbs;
+  _slotCount = slots < GALLERY_THUMB_MAX ? slots : GALLERY_THUMB_MAX;
+  _file = fileBuf;
+  _count = 0;
+  memset(_slots, 0, sizeof(_slots));
+  return true;
+}
+
+// ============================================
+// Index
+// ============================================
+#define GALLERY_PAGE 16 // scan index entries copied at a time (64 bytes each, stack)
+
+bool Gallery::open(ScanIndex &index) {
+  ScanEntry page[GALLERY_PAGE];
+  uint32_t cursor = 0;
+  uint16_t total = 0, withThumb = 0;
+  _count = 0;
+  do {
+    uint16_t want = _max - _count < GALLERY_PAGE ? _max - _count : GALLERY_PAGE;
+    int32_t n = index.page(cursor, page, want, &cursor, &total);
+    if (n < 0) {
+      _count = 0;
+      return false;
+    }
+    for (int32_t i = 0; i < n; i++) {
+      GalleryEntry &e = _entries[_count++];
+      strcpy(e.name, page[i].name);
+      e.key = page[i].key;
+      e.hasThumb = page[i].hasThumb;
+      if (e.hasThumb) withThumb++;
+    }
+  } while (cursor && _count < _max);
+
+  _stats.opens++;
+  _stats.entries = _count;
+  _stats.withThumb = withThumb;
+  _stats.dropped = total > _count ? total - _count : 0;
+  return true;
+}
+
+// ============================================
+// Thumbnail cache
+// ============================================
+const uint16_t *Gallery::thumb(uint16_t i, GalleryStore &store, GalleryDecodeFn decode,
+                               void *ctx) {
+  if (i >= _count) return nullptr;
+  GalleryEntry &e = _entries[i];
+  if (!e.hasThumb) return nullptr;
+  const size_t px = (size_t)GALLERY_THUMB_W * GALLERY_THUMB_H;
+  _stats.lookups++;
+  _clock++;
+
+  Slot *victim = nullptr;
+  for (uint8_t s = 0; s < _slotCount; s++) {
+    Slot &sl = _slots[s];
+    if (sl.lastUse && sl.key == e.key) {
+      sl.lastUse = _clock;
+      _stats.hits++;
+      return _thumbs + s * px;
+    }
+    if (!victim || sl.lastUse < victim->lastUse) victim = &sl;
+  }
+  if (victim->lastUse) _stats.evictions++;
+  victim->lastUse = 0;
+  uint16_t *dst = _thumbs + (victim - _slots) * px;
+
+  int32_t len = store.readThumb(e.key, _file, GALLERY_FILE_MAX);
+  if (len <= 0 || !decode(ctx, _file, (size_t)len, dst)) {
+    // Shown as having none from now on; no retry on every repaint
+    e.hasThumb = false;
+    _stats.failures++;
+    return nullptr;
+  }
+  _stats.loads++;
+  _stats.bytesRead += (uint32_t)len;
+  victim->key = e.key;
+  victim->lastUse = _clock;
+  return dst;
+}
@@ -0,0 +1,114 @@
+// ============================================
+// Scan Gallery - ResearchMate
+// Index of the upload queue plus an LRU of decoded thumbnails. Opening the
+// gallery pages the newest entries out of the scan index
+// (storage/scan_index.h), which keeps them in the order they were queued
+// and knows which have sidecars. Directory order is not that order: FAT
+// puts a new file in the first free slot, wherever a deleted one was.
+// Thumbnails are the small JPEGs written at save time and are only loaded
+// for rows on screen, so a full scan is never decoded here. Storage and
+// decoding go through GalleryStore / GalleryDecodeFn, so the gallery runs
+// on a host against a fake card.
+//
+// Sidecars live in GALLERY_THUMB_DIR under the queue, named by the hash of
+// their scan's name without extension ("1a2b3c4d.thm"). 8.3 names take one
+// directory entry instead of three long-name ones, and FAT finds a file by
+// reading its directory from the start, so each open stays cheap however
+// long the queue gets.
+// ============================================
+
+#ifndef GALLERY_H
+#define GALLERY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define GALLERY_NAME_MAX   40
+#define GALLERY_THUMB_W    48
+#define GALLERY_THUMB_H    36
+#define GALLERY_THUMB_DIR  "thumbs"
+#define GALLERY_THUMB_MAX  64    // cache slots
+#define GALLERY_FILE_MAX   4096  // largest sidecar read
+
+struct GalleryEntry {
+  char name[GALLERY_NAME_MAX]; // file name inside the queue directory
+  uint32_t key;                // galleryKey(name)
+  bool hasThumb;
+};
+
+class GalleryStore {
+public:
+  virtual ~GalleryStore() {}
+  // Every file in the queue directory (not its subdirectories), in
+  // directory order. False if the directory cannot be read.
+  virtual bool list(void (*fn)(void *ctx, const char *name), void *ctx) = 0;
+  // Key of every sidecar present. False if there are none to list.
+  virtual bool listThumbs(void (*fn)(void *ctx, uint32_t key), void *ctx) = 0;
+  // Whole sidecar into buf; bytes read, or -1.
+  virtual int32_t readThumb(uint32_t key, uint8_t *buf, size_t cap) = 0;
+};
+
+// Sidecar JPEG -> GALLERY_THUMB_W x GALLERY_THUMB_H pixels (panel order).
+typedef bool (*GalleryDecodeFn)(void *ctx, const uint8_t *jpg, size_t len, uint16_t *px);
+
+struct GalleryStats {
+  uint32_t opens;
+  uint16_t entries;
+  uint16_t withThumb;
+  uint16_t dropped;     // older queued files beyond the index capacity
+  uint32_t lookups;     // thumbnails asked for
+  uint32_t hits;
+  uint32_t loads;       // sidecars read + decoded
+  uint32_t failures;    // unreadable / undecodable sidecars
+  uint32_t evictions;
+  uint32_t bytesRead;
+};
+
+// Hash of a scan's file name without directory or extension, so that
+// scan_X.jpg and its sidecar agree.
+uint32_t galleryKey(const char *name);
+// Sidecar file name for a key ("1a2b3c4d.thm"); out holds 13 bytes.
+void galleryThumbName(uint32_t key, char *out);
+// Key back from a sidecar file name; false if it is not one.
+bool galleryThumbKey(const char *name, uint32_t *key);
+
+class ScanIndex;
+
+class Gallery {
+public:
+  // Caller-owned memory (PSRAM on the device): the index, the thumbnail
+  // cache (slots x GALLERY_THUMB_W x GALLERY_THUMB_H pixels) and a
+  // GALLERY_FILE_MAX byte read buffer.
+  bool attach(GalleryEntry *entries, uint16_t maxEntries, uint16_t *thumbs, uint8_t slots,
+              uint8_t *fileBuf);
+
+  // Rebuild the index: the newest `maxEntries` scans, newest first. False
+  // if the queue cannot be read. Cached thumbnails stay valid.
+  bool open(ScanIndex &index);
+  uint16_t count() const { return _count; }
+  const GalleryEntry &entry(uint16_t i) const { return _entries[i]; }
+
+  // Thumbnail of entry i, loaded on a miss; nullptr when it has none.
+  const uint16_t *thumb(uint16_t i, GalleryStore &store, GalleryDecodeFn decode, void *ctx);
+
+  const GalleryStats &stats() const { return _stats; }
+
+private:
+  GalleryEntry *_entries = nullptr;
+  uint16_t _max = 0;
+  uint16_t _count = 0;
+
+  struct Slot {
+    uint32_t key;
+    uint32_t lastUse;   // 0 = empty
+  };
+  uint16_t *_thumbs = nullptr;
+  Slot _slots[GALLERY_THUMB_MAX];
+  uint8_t _slotCount = 0;
+  uint32_t _clock = 0;
+  uint8_t *_file = nullptr;
+
+  GalleryStats _stats = {};
+};
+
+#endif // GALLERY_H
@@ -0,0 +1,154 @@
+#include "ui.h"
+#include <cstring>
+
+static bool intersects(const UiRect &a, const UiRect &b) {
+  return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+static void fill(UiBackend &b, UiFlushStats &st, int16_t x, int16_t y, int16_t w, int16_t h,
+                 uint16_t color) {
+  if (w <= 0 || h <= 0) return;
+  b.fillRect(x, y, w, h, color);
+  st.rects++;
+  st.pixels += (uint32_t)w * h;
+}
+
+// ============================================
+// UiFill
+// ============================================
+void UiFill::setColor(uint16_t color) {
+  if (color == _color) return;
+  _color = color;
+  _dirty = true;
+}
+
+void UiFill::paint(UiBackend &b, UiFlushStats &st) {
+  fill(b, st, _box.x, _box.y, _box.w, _box.h, _color);
+  _dirty = false;
+}
+
+// ============================================
+// UiLabel
+// ============================================
+void UiLabel::set(const char *text, uint16_t fg) {
+  if (fg == _fg && strncmp(text, _text, sizeof(_text) - 1) == 0) return;
+  strncpy(_text, text, sizeof(_text) - 1);
+  _text[sizeof(_text) - 1] = '\0';
+  _fg = fg;
+  _dirty = true;
+}
+
+void UiLabel::invalidate() {
+  _full = true;
+  _dirty = true;
+}
+
+// Where `text` lands (unclipped)
+UiRect UiLabel::textRect(UiBackend &b, const char *text) const {
+  int16_t tw = text[0] ? b.textWidth(text) : 0;
+  int16_t fh = b.fontHeight();
+  int16_t x;
+  if (_align == UI_ALIGN_LEFT) x = _box.x + _pad;
+  else if (_align == UI_ALIGN_RIGHT) x = _box.x + _box.w - _pad - tw;
+  else x = _box.x + (_box.w - tw) / 2;
+  UiRect r = {x, (int16_t)(_box.y + (_box.h - fh) / 2), tw, fh};
+  return r;
+}
+
+static int16_t clampTo(int16_t v, const UiRect &box) {
+  return v < box.x ? box.x : v > box.x + box.w ? box.x + box.w : v;
+}
+
+void UiLabel::paint(UiBackend &b, UiFlushStats &st) {
+  UiRect text = textRect(b, _text);
+  size_t n = strlen(_text), m = strlen(_shown);
+  size_t head = 0, tail = 0;
+  int16_t headW = 0;
+
+  // Spans on the text band: [from, to) to draw, [oldFrom, oldTo) on the panel
+  int16_t from = text.x, to = text.x + text.w;
+  int16_t oldFrom = _shownRect.x, oldTo = _shownRect.x + _shownRect.w;
+  char part[sizeof(_text)];
+
+  if (_full) {
+    fill(b, st, _box.x, _box.y, _box.w, _box.h, _bg);
+    oldFrom = oldTo = from;
+  } else if (_fg == _shownFg && m > 0) {
+    // Same anchor: the shared prefix (or suffix) is already there
+    if (text.x == _shownRect.x) {
+      while (head < n && head < m && _text[head] == _shown[head]) head++;
+      memcpy(part, _text, head);
+      part[head] = '\0';
+      headW = head ? b.textWidth(part) : 0;
+      from += headW;
+      oldFrom += headW;
+    } else if (to == oldTo) {
+      while (tail < n && tail < m && _text[n - 1 - tail] == _shown[m - 1 - tail]) tail++;
+      int16_t w = tail ? b.textWidth(_text + n - tail) : 0;
+      to -= w;
+      oldTo -= w;
+    }
+  }
+
+  from = clampTo(from, _box);
+  to = clampTo(to, _box);
+  oldFrom = clampTo(oldFrom, _box);
+  oldTo = clampTo(oldTo, _box);
+
+  // Clear whatever of the old span the new one does not paint over
+  if (oldTo > oldFrom) {
+    if (to <= from) {
+      fill(b, st, oldFrom, text.y, oldTo - oldFrom, text.h, _bg);
+    } else {
+      if (oldFrom < from)
+        fill(b, st, oldFrom, text.y, (oldTo < from ? oldTo : from) - oldFrom, text.h, _bg);
+      if (oldTo > to) {
+        int16_t x = oldFrom > to ? oldFrom : to;
+        fill(b, st, x, text.y, oldTo - x, text.h, _bg);
+      }
+    }
+  }
+
+  if (to > from) {
+    size_t len = n - head - tail;
+    memcpy(part, _text + head, len);
+    part[len] = '\0';
+    UiRect clip = {from, text.y, (int16_t)(to - from), text.h};
+    b.drawText(part, text.x + headW, text.y, _fg, _bg, clip);
+    st.rects++;
+    st.pixels += (uint32_t)clip.w * clip.h;
+  }
+
+  memcpy(_shown, _text, sizeof(_shown));
+  _shownFg = _fg;
+  _shownRect = text;
+  _full = false;
+  _dirty = false;
+}
+
+// ============================================
+// UiLayer
+// ============================================
+bool UiLayer::add(UiWidget *w) {
+  if (_count >= MAX_WIDGETS) return false;
+  _widgets[_count++] = w;
+  return true;
+}
+
+void UiLayer::invalidate() {
+  for (int i = 0; i < _count; i++) _widgets[i]->invalidate();
+}
+
+UiFlushStats UiLayer::flush(UiBackend &b) {
+  UiFlushStats st = {0, 0};
+  for (int i = 0; i < _count; i++) {
+    UiWidget *w = _widgets[i];
+    if (!w->dirty()) continue;
+    w->paint(b, st);
+    if (!w->opaque()) continue;
+    for (int j = i + 1; j < _count; j++) {
+      if (intersects(w->bounds(), _widgets[j]->bounds())) _widgets[j]->invalidate();
+    }
+  }
+  return st;
+}
@@ -0,0 +1,105 @@
+// ============================================
+// UI Widgets - ResearchMate
+// Retained-mode widgets for the status bars. Each widget keeps what it last
+// put on the panel and repaints only when its state actually changes; a
+// label repaints just the span covered by its old and new text. Drawing goes
+// through UiBackend, so the layer runs on the host with a recording backend.
+// ============================================
+
+#ifndef UI_H
+#define UI_H
+
+#include <cstdint>
+
+struct UiRect {
+  int16_t x, y, w, h;
+};
+
+enum UiAlign { UI_ALIGN_LEFT = 0, UI_ALIGN_CENTER, UI_ALIGN_RIGHT };
+
+class UiBackend {
+public:
+  virtual ~UiBackend() {}
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) = 0;
+  // Single-line text, top-left at (x, y), glyph cells painted with `bg`.
+  // Nothing outside `clip` may be touched.
+  virtual void drawText(const char *s, int16_t x, int16_t y, uint16_t fg, uint16_t bg,
+                        const UiRect &clip) = 0;
+  virtual int16_t textWidth(const char *s) = 0;
+  virtual int16_t fontHeight() = 0;
+};
+
+struct UiFlushStats {
+  uint16_t rects;   // backend calls
+  uint32_t pixels;  // pixels written
+};
+
+class UiWidget {
+public:
+  virtual ~UiWidget() {}
+  // Forget what is on the panel; the next flush repaints the whole widget.
+  virtual void invalidate() { _dirty = true; }
+  bool dirty() const { return _dirty; }
+  const UiRect &bounds() const { return _box; }
+  // Covers its whole box when repainted (widgets on top must repaint too)
+  virtual bool opaque() const { return false; }
+  virtual void paint(UiBackend &b, UiFlushStats &st) = 0;
+
+protected:
+  explicit UiWidget(const UiRect &box) : _box(box) {}
+  UiRect _box;
+  bool _dirty = true;
+};
+
+// Solid rectangle: bar backgrounds and separator lines
+class UiFill : public UiWidget {
+public:
+  UiFill(const UiRect &box, uint16_t color) : UiWidget(box), _color(color) {}
+  void setColor(uint16_t color);
+  bool opaque() const override { return true; }
+  void paint(UiBackend &b, UiFlushStats &st) override;
+
+private:
+  uint16_t _color;
+};
+
+// One line of text aligned inside a fixed box (vertically centred). Text
+// past the box edge is clipped. When the text keeps its anchor edge, the
+// characters it shares with what is on the panel are not redrawn.
+class UiLabel : public UiWidget {
+public:
+  UiLabel(const UiRect &box, UiAlign align, uint16_t bg, int16_t pad = 2)
+      : UiWidget(box), _align(align), _bg(bg), _pad(pad) {}
+  void set(const char *text, uint16_t fg);
+  void invalidate() override;
+  void paint(UiBackend &b, UiFlushStats &st) override;
+
+private:
+  UiRect textRect(UiBackend &b, const char *text) const;
+
+  UiAlign _align;
+  uint16_t _bg;
+  int16_t _pad;
+  char _text[24] = "";
+  uint16_t _fg = 0;
+  bool _full = true;              // box background not painted yet
+  char _shown[24] = "";           // what is on the panel
+  uint16_t _shownFg = 0;
+  UiRect _shownRect = {0, 0, 0, 0}; // its unclipped extent
+};
+
+// Widgets painted in the order they were added; later ones sit on top.
+class UiLayer {
+public:
+  static const int MAX_WIDGETS = 8;
+
+  bool add(UiWidget *w);
+  void invalidate();
+  UiFlushStats flush(UiBackend &b);
+
+private:
+  UiWidget *_widgets[MAX_WIDGETS];
+  int _count = 0;
+};
+
+#endif // UI_H
@@ -0,0 +1,139 @@
+#include "metrics.h"
+#include <stdarg.h>
+
+// Constant-initialized: metrics in other files register during their own
+// static construction, in no particular order
+static std::atomic<Metric *> s_head{nullptr};
+static void (*s_collectors[METRICS_MAX_COLLECTORS])() = {};
+static uint8_t s_collectorCount = 0;
+
+uint64_t MetricTotal::load() const {
+  uint32_t h, l;
+  do {
+    h = hi.load(std::memory_order_relaxed);
+    l = lo.load(std::memory_order_relaxed);
+  } while (h != hi.load(std::memory_order_relaxed));
+  return (uint64_t)h << 32 | l;
+}
+
+Metric::Metric(MetricType type, const char *name, const char *help, const char *labels)
+    : type(type), name(name), help(help), labels(labels && labels[0] ? labels : nullptr) {
+  Metric *head = s_head.load(std::memory_order_relaxed);
+  do {
+    _next = head;
+  } while (!s_head.compare_exchange_weak(head, this, std::memory_order_release,
+                                         std::memory_order_relaxed));
+}
+
+bool metricsOnCollect(void (*fn)()) {
+  if (s_collectorCount >= METRICS_MAX_COLLECTORS) return false;
+  s_collectors[s_collectorCount++] = fn;
+  return true;
+}
+
+void metricsCollect() {
+  for (uint8_t i = 0; i < s_collectorCount; i++) s_collectors[i]();
+}
+
+const Metric *metricsFirst() { return s_head.load(std::memory_order_acquire); }
+
+// ============================================
+// Text format
+// ============================================
+
+// Appends to a fixed buffer; counts on past the end so the caller learns
+// how much it needed
+struct TextOut {
+  char *buf;
+  size_t size;
+  size_t len;
+
+  void printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list ap;
+    va_start(ap, fmt);
+    size_t room = len < size ? size - len : 0;
+    int n = vsnprintf(room ? buf + len : nullptr, room, fmt, ap);
+    va_end(ap);
+    if (n > 0) len += (size_t)n;
+  }
+};
+
+// name{labels} or name{labels,extra}, then the value
+static void sampleName(TextOut &out, const Metric &m, const char *suffix, const char *extra) {
+  out.printf("%s%s", m.name, suffix);
+  if (m.labels && extra) {
+    out.printf("{%s,%s}", m.labels, extra);
+  } else if (m.labels || extra) {
+    out.printf("{%s}", m.labels ? m.labels : extra);
+  }
+}
+
+static void renderSamples(TextOut &out, const Metric &m) {
+  switch (m.type) {
+  case METRIC_COUNTER:
+    sampleName(out, m, "", nullptr);
+    out.printf(" %llu\n", (unsigned long long)static_cast<const MetricCounter &>(m).value());
+    break;
+  case METRIC_GAUGE: {
+    const MetricGauge &g = static_cast<const MetricGauge &>(m);
+    sampleName(out, m, "", nullptr);
+    if (g.scale == 1) {
+      out.printf(" %ld\n", (long)g.value());
+    } else {
+      out.printf(" %.9g\n", g.value() * g.scale);
+    }
+    break;
+  }
+  case METRIC_HISTOGRAM: {
+    const MetricHistogram &h = static_cast<const MetricHistogram &>(m);
+    // Buckets are exported cumulative; the count is their total, so the
+    // three agree even with observations landing mid-scrape
+    uint32_t total = 0;
+    char le[24];
+    for (uint8_t i = 0; i <= h.bucketCount; i++) {
+      total += h.bucket(i);
+      if (i < h.bucketCount) {
+        snprintf(le, sizeof(le), "le=\"%g\"", h.bounds[i] * h.scale);
+      } else {
+        snprintf(le, sizeof(le), "le=\"+Inf\"");
+      }
+      sampleName(out, m, "_bucket", le);
+      out.printf(" %lu\n", (unsigned long)total);
+    }
+    sampleName(out, m, "_sum", nullptr);
+    out.printf(" %.9g\n", (double)h.sum() * h.scale);
+    sampleName(out, m, "_count", nullptr);
+    out.printf(" %lu\n", (unsigned long)total);
+    break;
+  }
+  }
+}
+
+static const char *typeName(MetricType t) {
+  switch (t) {
+  case METRIC_COUNTER: return "counter";
+  case METRIC_GAUGE: return "gauge";
+  case METRIC_HISTOGRAM: return "histogram";
+  }
+  return "untyped";
+}
+
+size_t metricsRender(char *out, size_t size) {
+  metricsCollect();
+
+  TextOut text = {out, size, 0};
+  if (size) out[0] = '\0';
+  const Metric *head = metricsFirst();
+  for (const Metric *m = head; m; m = m->next()) {
+    // A family goes out in one piece, at its first member in the list
+    bool seen = false;
+    for (const Metric *p = head; p != m && !seen; p = p->next()) seen = strcmp(p->name, m->name) == 0;
+    if (seen) continue;
+
+    text.printf("# HELP %s %s\n# TYPE %s %s\n", m->name, m->help, m->name, typeName(m->type));
+    for (const Metric *f = m; f; f = f->next()) {
+      if (f == m || strcmp(f->name, m->name) == 0) renderSamples(text, *f);
+    }
+  }
+  return text.len;
+}
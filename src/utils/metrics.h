@@ -0,0 +1,152 @@
+// ============================================
+// Metrics - ResearchMate
+// Counters, gauges and fixed-bucket histograms any module can declare,
+// served at /metrics in the Prometheus text format (0.0.4).
+//
+// A metric is a static object at file scope in the module that updates it;
+// constructing it links it into the registry, so there is no central list
+// to keep. Metrics that share a name, each with its own labels, are one
+// family.
+//
+// Updates are relaxed atomic adds on 32-bit words, lock-free on the S3: no
+// lock, no allocation, a few cycles, safe from any task. Counters and
+// histogram sums carry into a second word so they do not wrap (64-bit
+// atomics take a lock here). A scrape that lands between the two adds reads
+// that one value 2^32 short, once every 4G units. Histogram bounds are
+// fixed at declaration; an observation is a short linear search over them.
+//
+// Values that are cheaper to read at scrape time than to keep current (free
+// heap, stack high-water marks) are set by collectors, which
+// metricsRender() runs before reading anything. Readers other than
+// /metrics (the StatsD exporter) walk the registry with metricsFirst() /
+// next() from their own task; collectors only set gauges, so two readers
+// running them at once is harmless.
+// ============================================
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "../config.h"
+#include <Arduino.h>
+#include <atomic>
+
+enum MetricType : uint8_t {
+  METRIC_COUNTER,
+  METRIC_GAUGE,
+  METRIC_HISTOGRAM,
+};
+
+// Common histogram bounds: 0.1 ms to 1 s, observed in microseconds
+// (scale 1e-6: exported in seconds)
+static const uint32_t METRIC_LATENCY_US[] = {100,   250,   500,    1000,   2500,   5000,
+                                             10000, 25000, 50000, 100000, 250000, 1000000};
+
+// 64-bit total kept in two 32-bit atomics
+struct MetricTotal {
+  std::atomic<uint32_t> lo{0};
+  std::atomic<uint32_t> hi{0};
+
+  void add(uint32_t n) {
+    if (lo.fetch_add(n, std::memory_order_relaxed) + n < n) hi.fetch_add(1, std::memory_order_relaxed);
+  }
+  uint64_t load() const;
+};
+
+class Metric {
+public:
+  // `name` and `help` as exported; `labels` what goes inside the braces
+  // (`caller="export"`), or nullptr. All three must outlive the metric
+  // (string literals).
+  Metric(MetricType type, const char *name, const char *help, const char *labels);
+  Metric(const Metric &) = delete;
+  Metric &operator=(const Metric &) = delete;
+
+  const MetricType type;
+  const char *const name;
+  const char *const help;
+  const char *const labels;
+
+  // Registry order; nullptr after the last
+  const Metric *next() const { return _next; }
+
+private:
+  Metric *_next = nullptr;
+};
+
+class MetricCounter : public Metric {
+public:
+  MetricCounter(const char *name, const char *help, const char *labels = nullptr)
+      : Metric(METRIC_COUNTER, name, help, labels) {}
+
+  void add(uint32_t n = 1) { _total.add(n); }
+  uint64_t value() const { return _total.load(); }
+
+private:
+  MetricTotal _total;
+};
+
+class MetricGauge : public Metric {
+public:
+  // `scale`: exported value of one unit set() (0.1 for a value kept in tenths)
+  MetricGauge(const char *name, const char *help, const char *labels = nullptr, double scale = 1)
+      : Metric(METRIC_GAUGE, name, help, labels), scale(scale) {}
+
+  void set(int32_t v) { _value.store(v, std::memory_order_relaxed); }
+  void add(int32_t n) { _value.fetch_add(n, std::memory_order_relaxed); }
+  int32_t value() const { return _value.load(std::memory_order_relaxed); }
+
+  const double scale;
+
+private:
+  std::atomic<int32_t> _value{0};
+};
+
+class MetricHistogram : public Metric {
+public:
+  // `bounds`: ascending upper bounds of the buckets in the units observe()
+  // is given, at most METRICS_MAX_BUCKETS (+Inf is added). `scale` turns
+  // them and the sum into exported units: 1e-6 observes microseconds and
+  // exports seconds.
+  template <size_t N>
+  MetricHistogram(const char *name, const char *help, const uint32_t (&bounds)[N], double scale,
+                  const char *labels = nullptr)
+      : Metric(METRIC_HISTOGRAM, name, help, labels), scale(scale), bounds(bounds), bucketCount(N) {
+    static_assert(N > 0 && N <= METRICS_MAX_BUCKETS, "METRICS_MAX_BUCKETS bounds at most");
+  }
+
+  void observe(uint32_t v) {
+    uint8_t i = 0;
+    while (i < bucketCount && v > bounds[i]) i++;
+    _counts[i].fetch_add(1, std::memory_order_relaxed);
+    _sum.add(v);
+  }
+
+  // Observations in bucket `i` alone (bucketCount: above the last bound)
+  uint32_t bucket(uint8_t i) const { return _counts[i].load(std::memory_order_relaxed); }
+  uint64_t sum() const { return _sum.load(); }
+
+  const double scale;
+  const uint32_t *const bounds;
+  const uint8_t bucketCount;
+
+private:
+  std::atomic<uint32_t> _counts[METRICS_MAX_BUCKETS + 1] = {};
+  MetricTotal _sum;
+};
+
+// Run `fn` at the start of every metricsRender(), to set gauges from their
+// sources. False once METRICS_MAX_COLLECTORS are in. setup() only.
+bool metricsOnCollect(void (*fn)());
+
+// Run the collectors (metricsRender() does so itself)
+void metricsCollect();
+
+// First metric in the registry, or nullptr
+const Metric *metricsFirst();
+
+// The whole registry as Prometheus text into `out`, `size` bytes with the
+// terminator. Returns the length it needed: at or above `size` the text was
+// cut short, and the caller tries again with a larger buffer.
+size_t metricsRender(char *out, size_t size);
+
+#endif // METRICS_H
@@ -0,0 +1,153 @@
+// ============================================
+// Host Arduino Stand-in - ResearchMate
+// Just enough of the Arduino core and FreeRTOS for the hardware-free
+// modules to build and run on the host ([env:native], `pio test -e
+// native`). Nothing here is compiled into the firmware.
+//
+// The clock is the host's steady clock until a test sets hostClock.ms (or
+// calls hostClockAdvance()); from then on millis() / micros() only move
+// when the test moves them, and vTaskDelay() moves them instead of
+// sleeping. Tasks are never started: xTaskCreate*() report success and the
+// test calls the task's body itself. Every critical section shares one
+// recursive lock, which is all the spinlocks here are for.
+// ============================================
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using std::max;
+using std::min;
+
+// ============================================
+// Clock
+// ============================================
+struct HostClock {
+  bool simulated = false;
+  uint64_t us = 0;
+};
+inline HostClock hostClock;
+
+inline void hostClockSet(uint32_t ms) {
+  hostClock.simulated = true;
+  hostClock.us = (uint64_t)ms * 1000;
+}
+inline void hostClockAdvance(uint32_t ms) {
+  hostClock.simulated = true;
+  hostClock.us += (uint64_t)ms * 1000;
+}
+
+inline unsigned long micros() {
+  if (hostClock.simulated) return (unsigned long)(uint32_t)hostClock.us;
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start).count();
+}
+inline unsigned long millis() {
+  if (hostClock.simulated) return (unsigned long)(uint32_t)(hostClock.us / 1000);
+  return micros() / 1000;
+}
+inline void delay(unsigned long ms) {
+  if (hostClock.simulated) {
+    hostClock.us += (uint64_t)ms * 1000;
+  } else {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+// ============================================
+// FreeRTOS
+// ============================================
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdPASS              1
+#define pdFAIL              0
+#define pdTRUE              1
+#define pdFALSE             0
+#define portMAX_DELAY       0xFFFFFFFFUL
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, int,
+                                          TaskHandle_t *handle, int) {
+  if (handle) *handle = nullptr;
+  return pdPASS;
+}
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                              int priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, priority, handle, 0);
+}
+
+struct portMUX_TYPE {
+  int owner;
+};
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+inline std::recursive_mutex &hostCriticalLock() {
+  static std::recursive_mutex lock;
+  return lock;
+}
+#define portENTER_CRITICAL(mux) ((void)(mux), hostCriticalLock().lock())
+#define portEXIT_CRITICAL(mux)  ((void)(mux), hostCriticalLock().unlock())
+
+// Mutexes are real ones, for the tests that run a module from threads
+typedef std::timed_mutex *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::timed_mutex; }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t ticks) {
+  if (ticks == portMAX_DELAY) {
+    m->lock();
+    return pdTRUE;
+  }
+  return m->try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t m) {
+  m->unlock();
+  return pdTRUE;
+}
+inline void vSemaphoreDelete(SemaphoreHandle_t m) { delete m; }
+
+#define IRAM_ATTR
+
+// ============================================
+// Serial (quiet: tests report through Unity)
+// ============================================
+struct HostSerial {
+  void begin(unsigned long) {}
+  void printf(const char *, ...) {}
+  void print(const char *) {}
+  void println(const char * = "") {}
+};
+inline HostSerial Serial;
+
+// ============================================
+// String (what the modules' headers declare with)
+// ============================================
+class String {
+public:
+  String(const char *s = "") : _s(s ? s : "") {}
+  const char *c_str() const { return _s.c_str(); }
+  unsigned int length() const { return (unsigned int)_s.size(); }
+  bool operator==(const char *s) const { return _s == s; }
+
+private:
+  std::string _s;
+};
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,23 @@
+// ============================================
+// Host HTTP_Method Stand-in - ResearchMate
+// The method enum net/http_server.h is declared with (the Arduino core
+// takes it from http_parser). Sized as an int, so that HTTP_ANY, which
+// lies outside the named methods, is a value the enum can hold.
+// ============================================
+
+#ifndef HOST_HTTP_METHOD_H
+#define HOST_HTTP_METHOD_H
+
+enum http_method : int {
+  HTTP_DELETE = 0,
+  HTTP_GET = 1,
+  HTTP_HEAD = 2,
+  HTTP_POST = 3,
+  HTTP_PUT = 4,
+  HTTP_OPTIONS = 6,
+  HTTP_PATCH = 28,
+};
+typedef enum http_method HTTPMethod;
+#define HTTP_ANY (HTTPMethod)(255)
+
+#endif // HOST_HTTP_METHOD_H
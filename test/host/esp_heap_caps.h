@@ -0,0 +1,45 @@
+// ============================================
+// Host heap_caps Stand-in - ResearchMate
+// Every capability is plain malloc(). hostAllocFail makes that many of the
+// next heap_caps_malloc() calls fail, for the out-of-memory paths;
+// hostAllocs / hostAllocBytes count the ones that succeed, for the tests
+// that measure heap traffic.
+// ============================================
+
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT      (1 << 2)
+#define MALLOC_CAP_DMA       (1 << 3)
+#define MALLOC_CAP_SPIRAM    (1 << 10)
+#define MALLOC_CAP_INTERNAL  (1 << 11)
+
+inline int hostAllocFail = 0;
+inline uint32_t hostAllocs = 0;
+inline uint64_t hostAllocBytes = 0;
+
+inline void *heap_caps_malloc(size_t size, uint32_t) {
+  if (hostAllocFail > 0) {
+    hostAllocFail--;
+    return nullptr;
+  }
+  hostAllocs++;
+  hostAllocBytes += size;
+  return malloc(size);
+}
+inline void *heap_caps_realloc(void *p, size_t size, uint32_t) {
+  if (hostAllocFail > 0) {
+    hostAllocFail--;
+    return nullptr;
+  }
+  hostAllocs++;
+  hostAllocBytes += size;
+  return realloc(p, size);
+}
+inline void heap_caps_free(void *p) { free(p); }
+
+#endif // HOST_ESP_HEAP_CAPS_H
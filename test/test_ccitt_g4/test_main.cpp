@@ -0,0 +1,414 @@
+// ============================================
+// CCITT G4 tests (pio test -e native -f test_ccitt_g4 -v)
+// Random, blocky and text bitmaps encoded and read back with a reference
+// T.6 decoder kept in this file: its code tables are the T.4 bit strings
+// typed in independently of the encoder's, and it decodes a bit at a time.
+// Odd widths, runs past the extended make-up codes, the EOFB/padding tail
+// and a failing sink.
+// ============================================
+
+#include "imaging/ccitt_g4.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+// ============================================
+// Reference decoder (T.4 tables 2/3 and 4, T.6 section 2.2)
+// ============================================
+// Terminating codes 0-63, then make-up codes 64-1728
+static const char *const T6_WHITE[] = {
+    "00110101", "000111", "0111", "1000", "1011", "1100", "1110", "1111", "10011", "10100", "00111",
+    "01000", "001000", "000011", "110100", "110101", "101010", "101011", "0100111", "0001100", "0001000",
+    "0010111", "0000011", "0000100", "0101000", "0101011", "0010011", "0100100", "0011000", "00000010",
+    "00000011", "00011010", "00011011", "00010010", "00010011", "00010100", "00010101", "00010110",
+    "00010111", "00101000", "00101001", "00101010", "00101011", "00101100", "00101101", "00000100",
+    "00000101", "00001010", "00001011", "01010010", "01010011", "01010100", "01010101", "00100100",
+    "00100101", "01011000", "01011001", "01011010", "01011011", "01001010", "01001011", "00110010",
+    "00110011", "00110100",
+    "11011", "10010", "010111", "0110111", "00110110", "00110111", "01100100", "01100101", "01101000",
+    "01100111", "011001100", "011001101", "011010010", "011010011", "011010100", "011010101", "011010110",
+    "011010111", "011011000", "011011001", "011011010", "011011011", "010011000", "010011001", "010011010",
+    "011000", "010011011",
+};
+static const char *const T6_BLACK[] = {
+    "0000110111", "010", "11", "10", "011", "0011", "0010", "00011", "000101", "000100", "0000100",
+    "0000101", "0000111", "00000100", "00000111", "000011000", "0000010111", "0000011000", "0000001000",
+    "00001100111", "00001101000", "00001101100", "00000110111", "00000101000", "00000010111",
+    "00000011000", "000011001010", "000011001011", "000011001100", "000011001101", "000001101000",
+    "000001101001", "000001101010", "000001101011", "000011010010", "000011010011", "000011010100",
+    "000011010101", "000011010110", "000011010111", "000001101100", "000001101101", "000011011010",
+    "000011011011", "000001010100", "000001010101", "000001010110", "000001010111", "000001100100",
+    "000001100101", "000001010010", "000001010011", "000000100100", "000000110111", "000000111000",
+    "000000100111", "000000101000", "000001011000", "000001011001", "000000101011", "000000101100",
+    "000001011010", "000001100110", "000001100111",
+    "0000001111", "000011001000", "000011001001", "000001011011", "000000110011", "000000110100",
+    "000000110101", "0000001101100", "0000001101101", "0000001001010", "0000001001011", "0000001001100",
+    "0000001001101", "0000001110010", "0000001110011", "0000001110100", "0000001110101", "0000001110110",
+    "0000001110111", "0000001010010", "0000001010011", "0000001010100", "0000001010101", "0000001011010",
+    "0000001011011", "0000001100100", "0000001100101",
+};
+// Make-up codes 1792-2560, either colour
+static const char *const T6_EXTENDED[] = {
+    "00000001000", "00000001100", "00000001101", "000000010010", "000000010011", "000000010100",
+    "000000010101", "000000010110", "000000010111", "000000011100", "000000011101", "000000011110",
+    "000000011111",
+};
+
+enum T6Mode { PASS, HORIZ, V0, VR1, VR2, VR3, VL1, VL2, VL3, EOL };
+
+struct T6Decoder {
+  const uint8_t *data;
+  size_t len;
+  size_t bit = 0;
+  std::map<std::string, int> white, black;
+  std::map<std::string, T6Mode> modes;
+  std::string error;
+
+  T6Decoder(const uint8_t *d, size_t n) : data(d), len(n) {
+    for (int i = 0; i < 64 + 27; i++) {
+      int run = i < 64 ? i : (i - 63) * 64;
+      white[T6_WHITE[i]] = run;
+      black[T6_BLACK[i]] = run;
+    }
+    for (int i = 0; i < 13; i++) white[T6_EXTENDED[i]] = black[T6_EXTENDED[i]] = 1792 + 64 * i;
+    modes = {{"0001", PASS},   {"001", HORIZ},   {"1", V0},        {"011", VR1},          {"000011", VR2},
+             {"0000011", VR3}, {"010", VL1},     {"000010", VL2},  {"0000010", VL3},     {"000000000001", EOL}};
+  }
+
+  int readBit() {
+    if (bit >= len * 8) return -1;
+    int b = (data[bit >> 3] >> (7 - (bit & 7))) & 1;
+    bit++;
+    return b;
+  }
+
+  template <typename T> bool readCode(const std::map<std::string, T> &table, T *out) {
+    std::string code;
+    while (code.size() < 14) {
+      int b = readBit();
+      if (b < 0) return false;
+      code += (char)('0' + b);
+      auto it = table.find(code);
+      if (it != table.end()) {
+        *out = it->second;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // One run: make-up codes until a terminating code
+  bool readRun(bool isBlack, int *run) {
+    *run = 0;
+    for (;;) {
+      int part;
+      if (!readCode(isBlack ? black : white, &part)) return false;
+      *run += part;
+      if (part < 64) return true;
+    }
+  }
+
+  // Rows until EOFB; false (with `error`) on anything malformed
+  bool decode(int width, std::vector<std::vector<int>> *rows) {
+    std::vector<int> ref; // changes of the previous row (none: all white)
+    for (;;) {
+      std::vector<int> cur;
+      int a0 = -1, colour = 0;
+      bool first = true;
+      while (a0 < width) {
+        // b1: first change on the reference line right of a0 to the colour
+        // opposite a0's; b2: the one after it
+        size_t j = 0;
+        while (j < ref.size() && (ref[j] <= a0 || (int)(j & 1) != colour)) j++;
+        int b1 = j < ref.size() ? ref[j] : width;
+        int b2 = j + 1 < ref.size() ? ref[j + 1] : width;
+
+        T6Mode m;
+        if (!readCode(modes, &m)) return fail("bad mode code");
+        if (m == EOL) {
+          if (!first) return fail("EOL inside a row");
+          T6Mode m2;
+          if (!readCode(modes, &m2) || m2 != EOL) return fail("single EOL");
+          // Padding to a byte boundary, then nothing
+          while (bit % 8) {
+            if (readBit() != 0) return fail("non-zero padding");
+          }
+          if (bit != len * 8) return fail("bytes after EOFB");
+          return true;
+        }
+        first = false;
+        if (m == PASS) {
+          a0 = b2;
+        } else if (m == HORIZ) {
+          int r1, r2;
+          if (!readRun(colour != 0, &r1) || !readRun(colour == 0, &r2)) return fail("bad run");
+          int a1 = (a0 < 0 ? 0 : a0) + r1, a2 = a1 + r2;
+          if (a2 > width) return fail("run past the row");
+          cur.push_back(a1);
+          cur.push_back(a2);
+          a0 = a2;
+        } else {
+          static const int DELTA[] = {0, 0, 0, 1, 2, 3, -1, -2, -3};
+          int a1 = b1 + DELTA[m];
+          if (a1 < 0 || a1 > width || a1 <= a0) return fail("vertical code out of range");
+          cur.push_back(a1);
+          a0 = a1;
+          colour ^= 1;
+        }
+      }
+      // Changes at the row end mark nothing
+      while (!cur.empty() && cur.back() >= width) cur.pop_back();
+      rows->push_back(cur);
+      ref = cur;
+      if (rows->size() > 100000) return fail("no EOFB");
+    }
+  }
+
+  bool fail(const char *why) {
+    error = why;
+    error += " at bit " + std::to_string(bit);
+    return false;
+  }
+};
+
+
+// ============================================
+// Helpers
+// ============================================
+typedef std::vector<uint8_t> Bitmap; // packed rows, MSB first, 1 = black
+
+struct Page {
+  int w, h;
+  Bitmap bits;
+  Page(int w_, int h_) : w(w_), h(h_), bits((size_t)h_ * stride(w_)) {}
+  static size_t stride(int w) { return (w + 7) / 8; }
+  uint8_t *row(int y) { return &bits[(size_t)y * stride(w)]; }
+  bool get(int x, int y) const { return bits[(size_t)y * stride(w) + x / 8] & (0x80 >> (x & 7)); }
+  void set(int x, int y, bool black) {
+    uint8_t &b = bits[(size_t)y * stride(w) + x / 8];
+    b = black ? (b | (0x80 >> (x & 7))) : (b & ~(0x80 >> (x & 7)));
+  }
+  void fill(int x0, int y0, int x1, int y1, bool black) {
+    for (int y = y0; y < y1 && y < h; y++)
+      for (int x = x0; x < x1 && x < w; x++) set(x, y, black);
+  }
+};
+
+static size_t collect(void *ctx, const uint8_t *data, size_t len) {
+  std::vector<uint8_t> *out = (std::vector<uint8_t> *)ctx;
+  out->insert(out->end(), data, data + len);
+  return len;
+}
+
+static std::vector<uint8_t> encode(Page &p) {
+  std::vector<uint16_t> work((g4WorkBytes(p.w) + 1) / 2);
+  std::vector<uint8_t> out;
+  G4Encoder e;
+  TEST_ASSERT_TRUE(g4Init(&e, p.w, work.data(), collect, &out));
+  for (int y = 0; y < p.h; y++) TEST_ASSERT_TRUE(g4EncodeRow(&e, p.row(y)));
+  TEST_ASSERT_TRUE(g4Finish(&e));
+  TEST_ASSERT_EQUAL_UINT32(p.h, e.rows);
+  TEST_ASSERT_EQUAL_UINT32(out.size(), e.bytesOut);
+  return out;
+}
+
+// Encode, decode with the reference, compare every pixel
+static void roundTrip(Page &p, const char *what) {
+  std::vector<uint8_t> data = encode(p);
+  T6Decoder d(data.data(), data.size());
+  std::vector<std::vector<int>> rows;
+  char msg[160];
+  bool ok = d.decode(p.w, &rows);
+  snprintf(msg, sizeof(msg), "%s %dx%d: %s", what, p.w, p.h, d.error.c_str());
+  TEST_ASSERT_TRUE_MESSAGE(ok, msg);
+  TEST_ASSERT_EQUAL_MESSAGE(p.h, (int)rows.size(), msg);
+  for (int y = 0; y < p.h; y++) {
+    bool black = false;
+    size_t c = 0;
+    for (int x = 0; x < p.w; x++) {
+      while (c < rows[y].size() && rows[y][c] == x) black = !black, c++;
+      if (black != p.get(x, y)) {
+        snprintf(msg, sizeof(msg), "%s %dx%d: pixel (%d,%d)", what, p.w, p.h, x, y);
+        TEST_FAIL_MESSAGE(msg);
+      }
+    }
+  }
+}
+
+static void randomPage(Page &p, uint32_t blackPer256) {
+  for (int y = 0; y < p.h; y++)
+    for (int x = 0; x < p.w; x++) p.set(x, y, (next() & 255) < blackPer256);
+}
+
+static void blockyPage(Page &p, int blocks) {
+  for (int i = 0; i < blocks; i++) {
+    int x = next() % p.w, y = next() % p.h;
+    p.fill(x, y, x + 1 + next() % (p.w / 2 + 1), y + 1 + next() % (p.h / 4 + 1), next() & 1);
+  }
+}
+
+// Lines of seven-segment "glyphs" (2 px strokes) with word gaps, plus a rule
+static void textPage(Page &p) {
+  const int cell = 12, line = 22;
+  for (int top = 4; top + 16 < p.h; top += line) {
+    for (int x = 6; x + cell < p.w; x += cell) {
+      if (next() % 7 == 0) continue; // space
+      uint32_t seg = next() | 1;
+      if (seg & 1) p.fill(x, top, x + 8, top + 2, true);            // top bar
+      if (seg & 2) p.fill(x, top + 7, x + 8, top + 9, true);        // middle bar
+      if (seg & 4) p.fill(x, top + 14, x + 8, top + 16, true);      // bottom bar
+      if (seg & 8) p.fill(x, top, x + 2, top + 9, true);            // upper left
+      if (seg & 16) p.fill(x + 6, top, x + 8, top + 9, true);       // upper right
+      if (seg & 32) p.fill(x, top + 7, x + 2, top + 16, true);      // lower left
+      if (seg & 64) p.fill(x + 6, top + 7, x + 8, top + 16, true);  // lower right
+    }
+  }
+  if (p.h > 2) p.fill(0, p.h - 2, p.w, p.h - 1, true);
+}
+
+// ============================================
+// Round trips
+// ============================================
+static void test_blank_page_is_one_bit_per_row() {
+  Page p(1600, 1200);
+  std::vector<uint8_t> data = encode(p);
+  // V0 per row, then EOFB (24 bits): 1200 / 8 + 3 bytes, no padding
+  TEST_ASSERT_EQUAL(153, (int)data.size());
+  TEST_ASSERT_EQUAL_HEX8(0x00, data[150]);
+  TEST_ASSERT_EQUAL_HEX8(0x10, data[151]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, data[152]);
+  roundTrip(p, "blank");
+}
+
+static void test_random_pages() {
+  const int widths[] = {1, 2, 7, 8, 9, 63, 64, 65, 127, 200, 333};
+  const uint32_t densities[] = {0, 3, 40, 128, 216, 256};
+  for (int w : widths) {
+    for (uint32_t d : densities) {
+      Page p(w, 37);
+      randomPage(p, d);
+      // Bits past the width in the last byte are not pixels
+      if (w & 7)
+        for (int y = 0; y < p.h; y++) p.row(y)[w / 8] |= (uint8_t)(next() & (0xFF >> (w & 7)));
+      roundTrip(p, "random");
+    }
+  }
+}
+
+static void test_blocky_pages() {
+  for (int round = 0; round < 30; round++) {
+    Page p(50 + next() % 900, 20 + next() % 200);
+    blockyPage(p, 1 + round);
+    roundTrip(p, "blocky");
+  }
+}
+
+static void test_text_pages() {
+  const int widths[] = {100, 1599, 1600, 1728};
+  for (int w : widths) {
+    Page p(w, 300);
+    textPage(p);
+    roundTrip(p, "text");
+  }
+}
+
+// Runs past 1728 use the shared extended make-up codes, and past 2623 the
+// 2560 code repeats
+static void test_long_runs() {
+  const int widths[] = {1727, 1728, 1729, 1791, 1792, 2560, 2561, 2623, 2624, 2625, 5184, 9000};
+  for (int w : widths) {
+    Page p(w, 12);
+    p.fill(0, 1, w, 2, true);                    // all black under all white
+    p.fill(w / 3, 3, w / 3 + 1, 4, true);        // one dot, long runs either side
+    p.fill(0, 5, w - 1, 6, true);                // black to the last pixel but one
+    p.fill(1, 7, w, 8, true);                    // white first pixel, then black
+    p.fill(0, 9, w, 10, true);                   // black again under white: horizontal
+    p.fill(0, 10, w, 11, true);                  // then vertical under black
+    roundTrip(p, "long runs");
+  }
+}
+
+// ============================================
+// Sink
+// ============================================
+struct Budget {
+  std::vector<uint8_t> data;
+  size_t left;
+};
+
+static size_t budgeted(void *ctx, const uint8_t *data, size_t len) {
+  Budget *b = (Budget *)ctx;
+  size_t n = len < b->left ? len : b->left;
+  b->data.insert(b->data.end(), data, data + n);
+  b->left -= n;
+  return n;
+}
+
+static void test_sink_failure_is_sticky() {
+  Page p(640, 200);
+  randomPage(p, 100);
+  std::vector<uint16_t> work((g4WorkBytes(p.w) + 1) / 2);
+  Budget b;
+  b.left = 1000;
+  G4Encoder e;
+  TEST_ASSERT_TRUE(g4Init(&e, p.w, work.data(), budgeted, &b));
+  int y = 0;
+  while (y < p.h && g4EncodeRow(&e, p.row(y))) y++;
+  TEST_ASSERT_LESS_THAN(p.h, y);
+  TEST_ASSERT_TRUE(e.failed);
+  size_t written = b.data.size();
+  TEST_ASSERT_EQUAL(1000, (int)written);
+  // Nothing more goes to the sink, rows and the trailer included
+  b.left = 1 << 20;
+  TEST_ASSERT_FALSE(g4EncodeRow(&e, p.row(0)));
+  TEST_ASSERT_FALSE(g4Finish(&e));
+  TEST_ASSERT_EQUAL(written, b.data.size());
+
+  // No sink at all fails the first flush
+  TEST_ASSERT_TRUE(g4Init(&e, p.w, work.data(), nullptr, nullptr));
+  y = 0;
+  while (y < p.h && g4EncodeRow(&e, p.row(y))) y++;
+  TEST_ASSERT_LESS_THAN(p.h, y);
+
+  TEST_ASSERT_FALSE(g4Init(&e, 0, work.data(), collect, &b));
+  TEST_ASSERT_FALSE(g4Init(&e, 64, nullptr, collect, &b));
+}
+
+// A UXGA text page: size against raw 1 bpp, and encode time
+static void test_text_page_cost() {
+  Page p(1600, 1200);
+  textPage(p);
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<uint8_t> data = encode(p);
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  TEST_ASSERT_LESS_THAN(p.bits.size() / 4, data.size());
+  char line[120];
+  snprintf(line, sizeof(line), "1600x1200 text: %u bytes (raw %u), %.1f ms", (unsigned)data.size(),
+           (unsigned)p.bits.size(), ms);
+  TEST_MESSAGE(line);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_blank_page_is_one_bit_per_row);
+  RUN_TEST(test_random_pages);
+  RUN_TEST(test_blocky_pages);
+  RUN_TEST(test_text_pages);
+  RUN_TEST(test_long_runs);
+  RUN_TEST(test_sink_failure_is_sticky);
+  RUN_TEST(test_text_page_cost);
+  return UNITY_END();
+}
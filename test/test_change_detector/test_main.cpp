@@ -0,0 +1,277 @@
+// ============================================
+// Change detector tests (pio test -e native -f test_change_detector -v)
+// Verdicts one at a time, then the evaluation: a synthetic 320x240 4:2:2
+// preview stream (600 MCU DC means with sensor noise, AEC flicker and DC
+// quantisation, plus a JPEG size that follows the ink on screen) replayed
+// through the same precheck -> DC compare -> shown sequence display.cpp
+// runs. Resting, sliding, a pen tip entering, a light drift, a slow creep
+// and a lift-off, with the drop rate each should get and an independent
+// check that no dropped frame differed from the panel.
+// ============================================
+
+#include "imaging/change_detector.h"
+#include "config.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static ChangeConfig config() {
+  ChangeConfig cfg = {};
+  cfg.blockDelta = PREVIEW_BLOCK_DELTA;
+  cfg.maxChangedBlocks = PREVIEW_MAX_CHANGED;
+  cfg.maxSizeDeltaPct = PREVIEW_SIZE_DELTA_PCT;
+  cfg.maxAgeMs = PREVIEW_MAX_REFRESH_MS;
+  return cfg;
+}
+
+static ChangeDetector det;
+
+void setUp() {
+  rng = 1;
+  changeInit(&det, config());
+}
+void tearDown() {}
+
+// ============================================
+// Verdicts
+// ============================================
+static uint8_t flat[CHANGE_MAX_BLOCKS];
+
+static void test_needs_two_matching_shown_frames() {
+  memset(flat, 100, sizeof(flat));
+  TEST_ASSERT_FALSE(changePrecheck(&det, 10000, 0));
+  TEST_ASSERT_EQUAL(CHANGE_SETTLING, det.verdict);
+  changeShown(&det, flat, 600, 10000, 0);
+  TEST_ASSERT_FALSE(changePrecheck(&det, 10000, 66));
+  TEST_ASSERT_EQUAL(CHANGE_SETTLING, det.verdict);
+  changeShown(&det, flat, 600, 10000, 66);
+  TEST_ASSERT_TRUE(changePrecheck(&det, 10000, 133));
+  TEST_ASSERT_TRUE(changeUnchanged(&det, flat, 600));
+  TEST_ASSERT_EQUAL(CHANGE_NONE, det.verdict);
+  TEST_ASSERT_EQUAL_STRING("unchanged", changeVerdictName(det.verdict));
+
+  // maxChanged blocks of difference still counts as agreeing...
+  for (int i = 0; i < PREVIEW_MAX_CHANGED; i++) flat[i] = 200;
+  changeShown(&det, flat, 600, 10000, 100);
+  TEST_ASSERT_TRUE(changePrecheck(&det, 10000, 133));
+  // ...one more and the scene is moving again
+  for (int i = 0; i <= PREVIEW_MAX_CHANGED; i++) flat[i] = 50;
+  changeShown(&det, flat, 600, 10000, 200);
+  TEST_ASSERT_FALSE(changePrecheck(&det, 10000, 266));
+  TEST_ASSERT_EQUAL(CHANGE_SETTLING, det.verdict);
+}
+
+static void settle(uint32_t len, uint32_t at) {
+  changeShown(&det, flat, 600, len, at);
+  changeShown(&det, flat, 600, len, at);
+}
+
+static void test_block_threshold_and_count() {
+  memset(flat, 100, sizeof(flat));
+  settle(10000, 0);
+  uint8_t dc[CHANGE_MAX_BLOCKS];
+  memcpy(dc, flat, sizeof(dc));
+  // Exactly blockDelta is noise; one more counts
+  for (int i = 0; i < 50; i++) dc[i] = (uint8_t)(i % 2 ? 100 + PREVIEW_BLOCK_DELTA : 100 - PREVIEW_BLOCK_DELTA);
+  TEST_ASSERT_TRUE(changeUnchanged(&det, dc, 600));
+  for (int i = 0; i < PREVIEW_MAX_CHANGED; i++) dc[i * 7] = 100 + PREVIEW_BLOCK_DELTA + 1;
+  TEST_ASSERT_TRUE(changeUnchanged(&det, dc, 600));
+  TEST_ASSERT_EQUAL(PREVIEW_MAX_CHANGED, det.changedBlocks);
+  dc[599] = 0;
+  TEST_ASSERT_FALSE(changeUnchanged(&det, dc, 600));
+  TEST_ASSERT_EQUAL(CHANGE_SCENE, det.verdict);
+  // A different MCU count (new resolution) is a whole new scene
+  TEST_ASSERT_FALSE(changeUnchanged(&det, flat, 300));
+  TEST_ASSERT_EQUAL(300, det.changedBlocks);
+}
+
+static void test_size_gate_and_refresh() {
+  memset(flat, 100, sizeof(flat));
+  settle(10000, 0);
+  TEST_ASSERT_TRUE(changePrecheck(&det, 10000 + 100 * PREVIEW_SIZE_DELTA_PCT, 10));
+  TEST_ASSERT_TRUE(changePrecheck(&det, 10000 - 100 * PREVIEW_SIZE_DELTA_PCT, 10));
+  TEST_ASSERT_FALSE(changePrecheck(&det, 10000 + 100 * (PREVIEW_SIZE_DELTA_PCT + 1) + 200, 10));
+  TEST_ASSERT_EQUAL(CHANGE_SIZE, det.verdict);
+  TEST_ASSERT_FALSE(changePrecheck(&det, 0, 10));
+  changeInit(&det, config());
+  settle(0, 0);
+  TEST_ASSERT_FALSE(changePrecheck(&det, 0, 10));
+  TEST_ASSERT_EQUAL(CHANGE_SIZE, det.verdict);
+  changeInit(&det, config());
+  settle(10000, 0);
+
+  TEST_ASSERT_TRUE(changePrecheck(&det, 10000, PREVIEW_MAX_REFRESH_MS - 1));
+  TEST_ASSERT_FALSE(changePrecheck(&det, 10000, PREVIEW_MAX_REFRESH_MS));
+  TEST_ASSERT_EQUAL(CHANGE_REFRESH, det.verdict);
+  TEST_ASSERT_EQUAL_UINT32(1, det.refreshes);
+  // millis() wrap
+  changeInit(&det, config());
+  settle(10000, 0xFFFFFF00u);
+  TEST_ASSERT_TRUE(changePrecheck(&det, 10000, 0x10));
+}
+
+static void test_forget_and_oversized_maps() {
+  memset(flat, 100, sizeof(flat));
+  settle(10000, 0);
+  changeForget(&det);
+  TEST_ASSERT_FALSE(changePrecheck(&det, 10000, 10));
+  TEST_ASSERT_EQUAL(CHANGE_SETTLING, det.verdict);
+
+  // Too many MCUs to track: never settles, always decoded
+  static uint8_t big[CHANGE_MAX_BLOCKS + 1];
+  changeShown(&det, big, CHANGE_MAX_BLOCKS + 1, 10000, 20);
+  changeShown(&det, big, CHANGE_MAX_BLOCKS + 1, 10000, 30);
+  TEST_ASSERT_FALSE(changePrecheck(&det, 10000, 40));
+  TEST_ASSERT_EQUAL(0, det.shownBlocks);
+}
+
+// ============================================
+// Evaluation: synthetic preview stream
+// ============================================
+static const int FW = 320, FH = 240, MW = 16, MH = 8, MX = FW / MW, MY = FH / MH, BLOCKS = MX * MY;
+static const uint32_t FRAME_MS = 66;
+static const int DC_STEP = 2; // DC quantiser / 8
+
+struct Scene {
+  int offX = 0, offY = 0;   // page position
+  int light = 0;            // exposure drift, luma levels
+  int penY = FH + 20;       // pen tip centre row (off screen below)
+  bool lifted = false;
+};
+
+// A text page: 24 px lines, 8 px glyph cells of 2 px strokes
+static int ink(int x, int y) {
+  int line = y / 24, ly = y % 24;
+  if (ly < 6 || ly >= 18) return 0;
+  int cell = x / 8, cx = x % 8, gy = ly - 6;
+  uint32_t h = (uint32_t)(cell * 7919 + line * 104729) * 2654435761u;
+  if ((h >> 28) == 0) return 0; // word gap
+  return ((h & 1) && cx < 2) || ((h & 2) && cx >= 5 && cx < 7) || ((h & 4) && gy < 2) ||
+         ((h & 8) && gy >= 5 && gy < 7) || ((h & 16) && gy >= 10);
+}
+
+// DC map of one frame, and the JPEG size that goes with it
+static uint32_t render(const Scene &s, uint8_t *dc) {
+  uint32_t inkPx = 0;
+  int flicker = next() % 7 == 0 ? (int)(next() % 3) - 1 : 0; // AEC hunting
+  for (int my = 0; my < MY; my++) {
+    for (int mx = 0; mx < MX; mx++) {
+      int sum = 0;
+      for (int y = my * MH; y < my * MH + MH; y++) {
+        for (int x = mx * MW; x < mx * MW + MW; x++) {
+          int v;
+          int dx = x - FW / 2, dy = y - s.penY;
+          if (dx * dx / 4 + dy * dy < 400 && y >= s.penY - 60) {
+            v = 30; // pen tip
+            inkPx++;
+          } else if (s.lifted) {
+            v = 150 + x / 40;
+          } else if (ink(x + s.offX, y + s.offY)) {
+            v = 50;
+            inkPx++;
+          } else {
+            v = 190 + x / 32 - y / 48;
+          }
+          sum += v;
+        }
+      }
+      int mean = sum / (MW * MH) + s.light + flicker + (int)(next() % 3) - 1;
+      mean = (mean + DC_STEP / 2) / DC_STEP * DC_STEP;
+      dc[my * MX + mx] = (uint8_t)(mean < 0 ? 0 : mean > 255 ? 255 : mean);
+    }
+  }
+  uint32_t size = 6000 + inkPx / 2;
+  return size + size * (next() % 11) / 2000; // +-0.25%
+}
+
+struct Tally {
+  int frames = 0, dropped = 0;
+};
+
+struct Replay {
+  uint8_t panel[BLOCKS];    // what the panel shows, as DC
+  uint32_t now = 0, shownAt = 0;
+  uint32_t maxAge = 0;
+  int badDrops = 0;         // dropped while really different from the panel
+
+  void frame(const Scene &s, Tally *t) {
+    uint8_t dc[BLOCKS];
+    uint32_t len = render(s, dc);
+    now += FRAME_MS;
+    t->frames++;
+    if (changePrecheck(&det, len, now) && changeUnchanged(&det, dc, BLOCKS)) {
+      t->dropped++;
+      int differs = 0;
+      for (int i = 0; i < BLOCKS; i++) differs += abs(dc[i] - panel[i]) > PREVIEW_BLOCK_DELTA;
+      if (differs > PREVIEW_MAX_CHANGED) badDrops++;
+    } else {
+      changeShown(&det, dc, BLOCKS, len, now);
+      memcpy(panel, dc, BLOCKS);
+      shownAt = now;
+    }
+    if (now - shownAt > maxAge) maxAge = now - shownAt;
+  }
+};
+
+static void report(const char *name, const Tally &t) {
+  char line[80];
+  snprintf(line, sizeof(line), "%-8s dropped %3d/%3d", name, t.dropped, t.frames);
+  TEST_MESSAGE(line);
+}
+
+static void test_evaluation_stream() {
+  Replay r;
+  Scene s;
+  Tally resting, sliding, pen, drift, creep, lift;
+
+  for (int i = 0; i < 60; i++) r.frame(s, &resting);
+  for (int i = 0; i < 40; i++) s.offX += 3, r.frame(s, &sliding);
+  for (int i = 0; i < 40; i++) r.frame(s, &resting);
+  for (int i = 0; i < 20; i++) s.penY -= 5, r.frame(s, &pen);
+  s.penY = FH + 20;
+  for (int i = 0; i < 40; i++) r.frame(s, &resting);
+  for (int i = 0; i < 40; i++) s.light += i % 3 == 0, r.frame(s, &drift);
+  for (int i = 0; i < 30; i++) s.offY += 1, r.frame(s, &creep);
+  for (int i = 0; i < 20; i++) r.frame(s, &resting);
+  s.lifted = true;
+  r.frame(s, &lift);
+  TEST_ASSERT_EQUAL(CHANGE_SIZE, det.verdict);
+  for (int i = 0; i < 20; i++) r.frame(s, &resting);
+
+  report("resting", resting);
+  report("sliding", sliding);
+  report("pen tip", pen);
+  report("drift", drift);
+  report("creep", creep);
+  report("lift", lift);
+
+  TEST_ASSERT_EQUAL(0, r.badDrops);
+  // Settled scenes are mostly dropped; the panel still refreshes each second
+  TEST_ASSERT_GREATER_THAN(resting.frames * 8 / 10, resting.dropped);
+  TEST_ASSERT_GREATER_THAN(drift.frames / 2, drift.dropped);
+  TEST_ASSERT_LESS_OR_EQUAL(PREVIEW_MAX_REFRESH_MS + FRAME_MS, r.maxAge);
+  // Anything moving is drawn
+  TEST_ASSERT_LESS_OR_EQUAL(1, sliding.dropped);
+  TEST_ASSERT_LESS_OR_EQUAL(1, pen.dropped);
+  TEST_ASSERT_LESS_OR_EQUAL(1, creep.dropped);
+  TEST_ASSERT_EQUAL(0, lift.dropped);
+  TEST_ASSERT_EQUAL_UINT32(resting.frames + sliding.frames + pen.frames + drift.frames + creep.frames + lift.frames,
+                           det.frames);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_needs_two_matching_shown_frames);
+  RUN_TEST(test_block_threshold_and_count);
+  RUN_TEST(test_size_gate_and_refresh);
+  RUN_TEST(test_forget_and_oversized_maps);
+  RUN_TEST(test_evaluation_stream);
+  return UNITY_END();
+}
@@ -0,0 +1,269 @@
+// ============================================
+// Cloud request timing tests (pio test -e native -f test_cloud_timing -v)
+// CloudTimingLog's percentiles against a brute-force nearest-rank
+// reference, the ring keeping only the last CLOUD_TIMING_RING requests,
+// phases a request never reached, the send-rate samples and their
+// CLOUD_TIMING_RATE_MIN threshold, and the serial lines cut to any size.
+// ============================================
+
+#include "cloud/cloud_timing.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+// ============================================
+// Helpers
+// ============================================
+
+// Every phase reached, each taking `us`
+static CloudTiming request(uint32_t atMs, uint32_t us, int16_t code = 200) {
+  CloudTiming t = {};
+  t.atMs = atMs;
+  t.what = "upload";
+  t.code = code;
+  t.reached = (1 << CLOUD_PHASES) - 1;
+  for (uint8_t p = 0; p < CLOUD_PHASES; p++) t.us[p] = us;
+  return t;
+}
+
+// Smallest value with at least p% of them at or below it, by counting
+static uint32_t nearestRank(const std::vector<uint32_t> &v, uint8_t p) {
+  uint32_t best = UINT32_MAX;
+  for (uint32_t x : v) {
+    size_t atOrBelow = 0;
+    for (uint32_t y : v) atOrBelow += y <= x;
+    if (atOrBelow * 100 >= (size_t)p * v.size() && x < best) best = x;
+  }
+  return best;
+}
+
+static void assertRanks(const std::vector<uint32_t> &v, const CloudPhaseStats &st) {
+  TEST_ASSERT_EQUAL(v.size(), st.n);
+  TEST_ASSERT_EQUAL_UINT32(nearestRank(v, 50), st.p50);
+  TEST_ASSERT_EQUAL_UINT32(nearestRank(v, 90), st.p90);
+  TEST_ASSERT_EQUAL_UINT32(nearestRank(v, 99), st.p99);
+  TEST_ASSERT_EQUAL_UINT32(*std::max_element(v.begin(), v.end()), st.max);
+}
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+// ============================================
+// Percentiles
+// ============================================
+static void test_nearest_rank_percentiles() {
+  CloudTimingLog log;
+  CloudTimingSummary s;
+  log.summarize(&s);
+  TEST_ASSERT_EQUAL(0, s.requests);
+  TEST_ASSERT_EQUAL(0, s.phase[CLOUD_TOTAL].n);
+  TEST_ASSERT_EQUAL_UINT32(0, s.phase[CLOUD_TOTAL].max);
+
+  // One: every percentile is it
+  log.add(request(0, 7000));
+  log.summarize(&s);
+  TEST_ASSERT_EQUAL_UINT32(7000, s.phase[CLOUD_TTFB].p50);
+  TEST_ASSERT_EQUAL_UINT32(7000, s.phase[CLOUD_TTFB].p99);
+
+  // Ten, out of order: p50 the 5th, p90 the 9th, p99 the 10th
+  CloudTimingLog ten;
+  const uint32_t order[] = {4, 9, 1, 10, 7, 2, 8, 3, 6, 5};
+  for (uint32_t v : order) ten.add(request(0, v * 1000));
+  ten.summarize(&s);
+  TEST_ASSERT_EQUAL(10, s.phase[CLOUD_CONNECT].n);
+  TEST_ASSERT_EQUAL_UINT32(5000, s.phase[CLOUD_CONNECT].p50);
+  TEST_ASSERT_EQUAL_UINT32(9000, s.phase[CLOUD_CONNECT].p90);
+  TEST_ASSERT_EQUAL_UINT32(10000, s.phase[CLOUD_CONNECT].p99);
+  TEST_ASSERT_EQUAL_UINT32(10000, s.phase[CLOUD_CONNECT].max);
+
+  // Any count up to the ring, with repeats
+  for (int round = 0; round < 200; round++) {
+    CloudTimingLog any;
+    std::vector<uint32_t> v;
+    uint16_t n = 1 + next() % CLOUD_TIMING_RING;
+    for (uint16_t i = 0; i < n; i++) {
+      v.push_back(next() % (round % 2 ? 8 : 5000000));
+      any.add(request(i, v.back()));
+    }
+    any.summarize(&s);
+    TEST_ASSERT_EQUAL(n, s.requests);
+    assertRanks(v, s.phase[CLOUD_RECV]);
+  }
+}
+
+// ============================================
+// Ring
+// ============================================
+static void test_ring_keeps_the_last_requests() {
+  CloudTimingLog log;
+  const uint32_t N = 3 * CLOUD_TIMING_RING + 5;
+  std::vector<uint32_t> us;
+  for (uint32_t i = 0; i < N; i++) {
+    us.push_back(1000 + next() % 900000);
+    log.add(request(i, us.back(), i % 7 == 0 ? -1 : 200));
+  }
+
+  CloudTiming out[CLOUD_TIMING_RING + 4];
+  TEST_ASSERT_EQUAL(CLOUD_TIMING_RING, log.recent(out, CLOUD_TIMING_RING + 4));
+  for (uint16_t i = 0; i < CLOUD_TIMING_RING; i++) TEST_ASSERT_EQUAL_UINT32(N - 1 - i, out[i].atMs);
+  TEST_ASSERT_EQUAL(3, log.recent(out, 3));
+  TEST_ASSERT_EQUAL_UINT32(N - 3, out[2].atMs);
+
+  CloudTimingSummary s;
+  log.summarize(&s);
+  TEST_ASSERT_EQUAL(CLOUD_TIMING_RING, s.requests);
+  TEST_ASSERT_EQUAL_UINT32(N, s.total);
+  TEST_ASSERT_EQUAL_UINT32((N + 6) / 7, s.failed);
+  assertRanks(std::vector<uint32_t>(us.end() - CLOUD_TIMING_RING, us.end()), s.phase[CLOUD_TOTAL]);
+
+  // Not yet wrapped: only what was added
+  CloudTimingLog few;
+  for (uint32_t i = 0; i < 3; i++) few.add(request(i, 1));
+  TEST_ASSERT_EQUAL(3, few.recent(out, CLOUD_TIMING_RING));
+  TEST_ASSERT_EQUAL_UINT32(2, out[0].atMs);
+  TEST_ASSERT_EQUAL_UINT32(0, out[2].atMs);
+}
+
+// DNS failed: nothing after it was timed, and it counts in no later phase
+static void test_unreached_phases_are_left_out() {
+  CloudTimingLog log;
+  std::vector<uint32_t> connect, ttfb, total;
+  for (uint32_t i = 0; i < 20; i++) {
+    CloudTiming t = request(i, 0);
+    for (uint8_t p = 0; p < CLOUD_PHASES; p++) t.us[p] = 100 * i + p;
+    if (i % 4 == 0) {
+      t.code = i % 8 ? -1 : 0; // no status either way
+      t.reached = (1 << CLOUD_DNS) | (1 << CLOUD_TOTAL);
+    } else if (i % 4 == 1) {
+      t.code = -11; // timed out waiting for the response
+      t.reached &= ~((1 << CLOUD_TTFB) | (1 << CLOUD_RECV));
+    } else {
+      ttfb.push_back(t.us[CLOUD_TTFB]);
+    }
+    if (i % 4) connect.push_back(t.us[CLOUD_CONNECT]);
+    total.push_back(t.us[CLOUD_TOTAL]);
+    log.add(t);
+  }
+  CloudTimingSummary s;
+  log.summarize(&s);
+  TEST_ASSERT_EQUAL_UINT32(10, s.failed);
+  TEST_ASSERT_EQUAL(20, s.phase[CLOUD_DNS].n);
+  assertRanks(connect, s.phase[CLOUD_CONNECT]);
+  assertRanks(ttfb, s.phase[CLOUD_TTFB]);
+  assertRanks(total, s.phase[CLOUD_TOTAL]);
+}
+
+// ============================================
+// Send rate
+// ============================================
+static void test_send_rate_threshold() {
+  CloudTimingLog log;
+  std::vector<uint32_t> rates;
+  CloudTiming t = request(0, 0);
+
+  // Too small to tell, not timed, or no send phase: no sample
+  t.sentBytes = CLOUD_TIMING_RATE_MIN - 1;
+  t.us[CLOUD_SEND] = 1000;
+  log.add(t);
+  t.sentBytes = 90000;
+  t.us[CLOUD_SEND] = 0;
+  log.add(t);
+  t.us[CLOUD_SEND] = 1000;
+  t.reached &= ~(1 << CLOUD_SEND);
+  log.add(t);
+  CloudTimingSummary s;
+  log.summarize(&s);
+  TEST_ASSERT_EQUAL(0, s.sendRate.n);
+
+  // Exactly the threshold counts
+  t = request(0, 0);
+  t.sentBytes = CLOUD_TIMING_RATE_MIN;
+  t.us[CLOUD_SEND] = 2000000;
+  log.add(t);
+  rates.push_back(CLOUD_TIMING_RATE_MIN / 2);
+  for (int i = 0; i < 12; i++) {
+    t.sentBytes = CLOUD_TIMING_RATE_MIN + next() % 400000;
+    t.us[CLOUD_SEND] = 1 + next() % 3000000;
+    log.add(t);
+    rates.push_back((uint32_t)((uint64_t)t.sentBytes * 1000000 / t.us[CLOUD_SEND]));
+  }
+  log.summarize(&s);
+  assertRanks(rates, s.sendRate);
+  TEST_ASSERT_EQUAL(16, s.phase[CLOUD_DNS].n);
+  TEST_ASSERT_EQUAL(15, s.phase[CLOUD_SEND].n); // reached, if no rate from it
+
+  // 4 GB/s would not fit 32 bits computed naively
+  CloudTimingLog fast;
+  t.sentBytes = 4000000000u;
+  t.us[CLOUD_SEND] = 1000000;
+  fast.add(t);
+  fast.summarize(&s);
+  TEST_ASSERT_EQUAL_UINT32(4000000000u, s.sendRate.p50);
+}
+
+// ============================================
+// Serial lines
+// ============================================
+static void test_log_lines() {
+  CloudTiming t = request(0, 0);
+  t.us[CLOUD_DNS] = 1200;
+  t.us[CLOUD_CONNECT] = 812400;
+  t.us[CLOUD_SEND] = 340000;
+  t.us[CLOUD_TTFB] = 2210000;
+  t.us[CLOUD_RECV] = 11600;
+  t.us[CLOUD_TOTAL] = 3375300;
+  t.sentBytes = 94720;
+  t.recvBytes = 812;
+  char line[200];
+  formatCloudTiming(t, line, sizeof(line));
+  const std::string want = "upload 200: dns 1, connect 812, send 340 (272 KB/s), ttfb 2210, recv 12 ms; "
+                           "3375 ms total, 94720 B up, 812 B down";
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), line);
+
+  CloudTimingLog log;
+  log.add(t);
+  t.code = -1;
+  t.reached = (1 << CLOUD_DNS) | (1 << CLOUD_TOTAL);
+  log.add(t);
+  CloudTimingSummary s;
+  log.summarize(&s);
+  formatCloudSummary(s, line, sizeof(line));
+  const std::string summary = "last 2 of 2 (1 failed), p50/p90/p99 ms: dns 1/1/1 connect 812/812/812 "
+                              "send 340/340/340 ttfb 2210/2210/2210 recv 12/12/12 total 3375/3375/3375; "
+                              "upload p50 272 KB/s (n=1)";
+  TEST_ASSERT_EQUAL_STRING(summary.c_str(), line);
+
+  // Any buffer: a prefix of the whole line, never past the end
+  for (size_t size = 1; size <= summary.size() + 1; size++) {
+    std::vector<char> buf(size + 8, 'Z');
+    formatCloudSummary(s, buf.data(), size);
+    TEST_ASSERT_EQUAL_STRING(summary.substr(0, size - 1).c_str(), buf.data());
+    TEST_ASSERT_EQUAL('Z', buf[size]);
+  }
+  CloudTiming out[2];
+  TEST_ASSERT_EQUAL(2, log.recent(out, 2));
+  t = out[1]; // the one that got through
+  for (size_t size = 1; size <= want.size() + 1; size++) {
+    std::vector<char> buf(size + 8, 'Z');
+    formatCloudTiming(t, buf.data(), size);
+    TEST_ASSERT_EQUAL_STRING(want.substr(0, size - 1).c_str(), buf.data());
+    TEST_ASSERT_EQUAL('Z', buf[size]);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_nearest_rank_percentiles);
+  RUN_TEST(test_ring_keeps_the_last_requests);
+  RUN_TEST(test_unreached_phases_are_left_out);
+  RUN_TEST(test_send_rate_threshold);
+  RUN_TEST(test_log_lines);
+  return UNITY_END();
+}
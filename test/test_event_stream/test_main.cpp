@@ -0,0 +1,295 @@
+// ============================================
+// Live status event tests (pio test -e native -f test_event_stream -v)
+// Subscribers are driven through the HttpStream calls the server task
+// makes, publish() through loop()'s, interleaved by hand: a subscriber
+// falling a ring behind between writes and being resynced to a full
+// event, one whose slot is reused while it is partway through (or holds a
+// peek() of it) and is closed, waiting() for a fresh connection, and the
+// text/event-stream framing of what goes out.
+// ============================================
+
+#include "net/event_stream.h"
+#include <string>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static EventStream *events;
+
+// ============================================
+// Helpers
+// ============================================
+
+// The server task: whatever peek() offers, `chunk` bytes a write, until
+// there is nothing more for now
+static std::string drain(uint8_t client, size_t chunk = 1 << 16) {
+  std::string out;
+  const uint8_t *p;
+  size_t n;
+  while (!events->done(client) && (n = events->peek(client, &p)) > 0) {
+    if (n > chunk) n = chunk;
+    out.append((const char *)p, n);
+    events->consume(client, n);
+  }
+  return out;
+}
+
+static std::string fullForm(uint32_t id, const char *json) {
+  char buf[EVENTS_MSG_BYTES + 16];
+  snprintf(buf, sizeof(buf), "retry: %u\nid: %lu\ndata: %s\n\n", (unsigned)EVENTS_RETRY_MS,
+           (unsigned long)id, json);
+  return buf;
+}
+
+static std::string deltaForm(uint32_t id, const char *json) {
+  char buf[EVENTS_MSG_BYTES];
+  snprintf(buf, sizeof(buf), "id: %lu\ndata: %s\n\n", (unsigned long)id, json);
+  return buf;
+}
+
+// Event n: {"n":n} as the delta, {"n":n,"all":1} as the full form
+static char deltaJson[32], fullJson[32];
+static uint32_t published = 0;
+static void publishNext() {
+  published++;
+  snprintf(deltaJson, sizeof(deltaJson), "{\"n\":%lu}", (unsigned long)published);
+  snprintf(fullJson, sizeof(fullJson), "{\"n\":%lu,\"all\":1}", (unsigned long)published);
+  events->publish(deltaJson, fullJson);
+}
+static std::string deltaOf(uint32_t n) {
+  char json[32];
+  snprintf(json, sizeof(json), "{\"n\":%lu}", (unsigned long)n);
+  return deltaForm(n, json);
+}
+static std::string fullOf(uint32_t n) {
+  char json[32];
+  snprintf(json, sizeof(json), "{\"n\":%lu,\"all\":1}", (unsigned long)n);
+  return fullForm(n, json);
+}
+
+static EventStreamStats stats() {
+  EventStreamStats st;
+  events->getStats(&st);
+  return st;
+}
+
+void setUp() {
+  rng = 1;
+  published = 0;
+  events = new EventStream();
+}
+void tearDown() { delete events; }
+
+// ============================================
+// Connecting
+// ============================================
+static void test_first_event_is_full_then_deltas() {
+  publishNext(); // before anyone connected
+  TEST_ASSERT_FALSE(events->subscribed());
+  TEST_ASSERT_FALSE(events->waiting());
+
+  TEST_ASSERT_TRUE(events->open(2));
+  TEST_ASSERT_TRUE(events->subscribed());
+  TEST_ASSERT_TRUE(events->waiting()); // loop() publishes at once
+  TEST_ASSERT_EQUAL_STRING("", drain(2).c_str()); // nothing old replayed
+
+  publishNext();
+  TEST_ASSERT_FALSE(events->waiting()); // published, even if not yet written
+  publishNext();
+  publishNext();
+  std::string want = fullOf(2) + deltaOf(3) + deltaOf(4);
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), drain(2, 1 + next() % 7).c_str());
+  TEST_ASSERT_FALSE(events->done(2));
+  TEST_ASSERT_FALSE(events->waiting()); // caught up is not waiting
+
+  // Caught up: a keepalive is a comment
+  published++;
+  events->publish("", "{\"n\":5}");
+  TEST_ASSERT_EQUAL_STRING(": keepalive\n\n", drain(2).c_str());
+
+  // A second page joins: waiting again, gets its own full form
+  TEST_ASSERT_TRUE(events->open(4));
+  TEST_ASSERT_TRUE(events->waiting());
+  publishNext();
+  publishNext(); // 6, 7
+  TEST_ASSERT_FALSE(events->waiting());
+  TEST_ASSERT_EQUAL_STRING((deltaOf(6) + deltaOf(7)).c_str(), drain(2).c_str());
+  TEST_ASSERT_EQUAL_STRING((fullOf(6) + deltaOf(7)).c_str(), drain(4, 5).c_str());
+
+  EventStreamStats st = stats();
+  TEST_ASSERT_EQUAL(2, st.subscribers);
+  TEST_ASSERT_EQUAL_UINT32(2, st.connects);
+  TEST_ASSERT_EQUAL_UINT32(7, st.published);
+  TEST_ASSERT_EQUAL_UINT32(1, st.keepalives);
+  TEST_ASSERT_EQUAL_UINT32(8, st.events); // 2: 2-7, 4: 6-7
+  size_t bytes = want.size() + 13 + deltaOf(6).size() + deltaOf(7).size() // 2
+                 + fullOf(6).size() + deltaOf(7).size();                 // 4
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)bytes, st.bytes);
+  TEST_ASSERT_EQUAL(deltaOf(7).size(), st.lastDeltaLen);
+  TEST_ASSERT_EQUAL(fullOf(7).size(), st.lastFullLen);
+}
+
+static void test_subscriber_limit() {
+  TEST_ASSERT_FALSE(events->open(HTTP_MAX_CLIENTS)); // no such connection
+  TEST_ASSERT_TRUE(events->open(0));
+  TEST_ASSERT_FALSE(events->open(0)); // already open
+  for (uint8_t c = 1; c < EVENTS_MAX_CLIENTS; c++) TEST_ASSERT_TRUE(events->open(c));
+  TEST_ASSERT_FALSE(events->open(EVENTS_MAX_CLIENTS)); // another page: polls instead
+  events->close(0);
+  TEST_ASSERT_TRUE(events->open(EVENTS_MAX_CLIENTS));
+
+  EventStreamStats st = stats();
+  TEST_ASSERT_EQUAL(EVENTS_MAX_CLIENTS, st.subscribers);
+  TEST_ASSERT_EQUAL_UINT32(EVENTS_MAX_CLIENTS + 1, st.connects);
+  TEST_ASSERT_EQUAL_UINT32(2, st.refused);
+
+  for (uint8_t c = 0; c <= EVENTS_MAX_CLIENTS; c++) events->close(c);
+  TEST_ASSERT_FALSE(events->subscribed());
+  TEST_ASSERT_FALSE(events->waiting());
+}
+
+// ============================================
+// Falling behind
+// ============================================
+
+// Up to EVENTS_RING - 1 events behind: every one of them still comes, as
+// deltas. One more and it starts over from the newest full form.
+static void test_resync_after_a_ring_behind() {
+  TEST_ASSERT_TRUE(events->open(1));
+  TEST_ASSERT_TRUE(events->open(3));
+  publishNext();
+  drain(1);
+  drain(3);
+
+  // 1 waits for event 2; events 2 .. 2 + RING - 1 fit the ring
+  for (int i = 0; i < EVENTS_RING; i++) publishNext();
+  std::string want;
+  for (uint32_t n = 2; n <= published; n++) want += deltaOf(n);
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), drain(1, 1 + next() % 40).c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, stats().resyncs);
+
+  // 3 is now a ring behind: the next publish takes the slot event 2 had
+  publishNext();
+  TEST_ASSERT_EQUAL_UINT32(1, stats().resyncs);
+  TEST_ASSERT_FALSE(events->done(3));
+  publishNext();
+  publishNext();
+  uint32_t resyncedTo = published - 2;
+  want = fullOf(resyncedTo) + deltaOf(resyncedTo + 1) + deltaOf(resyncedTo + 2);
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), drain(3, 1 + next() % 40).c_str());
+  TEST_ASSERT_EQUAL_STRING((deltaOf(published - 2) + deltaOf(published - 1) + deltaOf(published)).c_str(),
+                           drain(1).c_str());
+
+  // Far behind: resynced once per ring lapped, never closed
+  events->close(1);
+  for (int i = 0; i < 10 * EVENTS_RING; i++) publishNext();
+  TEST_ASSERT_EQUAL_UINT32(10, stats().resyncs); // the one above, then every EVENTS_RING
+  want = fullOf(published - EVENTS_RING + 1);
+  for (uint32_t n = published - EVENTS_RING + 2; n <= published; n++) want += deltaOf(n);
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), drain(3).c_str());
+  TEST_ASSERT_FALSE(events->done(3));
+  TEST_ASSERT_EQUAL_UINT32(0, stats().dropped);
+}
+
+// Partway through an event when its slot is reused: the rest cannot be
+// sent, so the connection closes (the browser reconnects)
+static void test_slot_reused_mid_write_closes() {
+  TEST_ASSERT_TRUE(events->open(0));
+  TEST_ASSERT_TRUE(events->open(5));
+  publishNext();
+  const uint8_t *p;
+  size_t n = events->peek(0, &p);
+  TEST_ASSERT_EQUAL(fullOf(1).size(), n);
+  events->consume(0, 1); // one byte of it is out
+  for (int i = 1; i < EVENTS_RING; i++) publishNext();
+  TEST_ASSERT_FALSE(events->done(0)); // its slot still holds event 1
+  publishNext();
+  TEST_ASSERT_TRUE(events->done(0));
+  TEST_ASSERT_EQUAL(0, events->peek(0, &p));
+  events->consume(0, n - 1); // the write already under way: not an event
+  EventStreamStats st = stats();
+  TEST_ASSERT_EQUAL_UINT32(0, st.events);
+  TEST_ASSERT_EQUAL_UINT32(1, st.dropped);
+  TEST_ASSERT_EQUAL_UINT32(1, st.resyncs); // 5 had not started: resynced
+  TEST_ASSERT_FALSE(events->done(5));
+
+  // Still counted open until the server closes it; then a fresh start
+  TEST_ASSERT_EQUAL(2, st.subscribers);
+  TEST_ASSERT_FALSE(events->open(0));
+  events->close(0);
+  TEST_ASSERT_TRUE(events->open(0));
+  publishNext();
+  TEST_ASSERT_EQUAL_STRING(fullOf(published).c_str(), drain(0).c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, stats().dropped);
+}
+
+// The server task holds a peek() of the slot (writing it out) when
+// publish() takes it: whatever it sent may be torn, so consume() closes
+static void test_slot_reused_under_a_peek_closes() {
+  TEST_ASSERT_TRUE(events->open(2));
+  publishNext();
+  drain(2);
+  publishNext(); // 2 waits to write event 2 from its start
+  const uint8_t *p;
+  TEST_ASSERT_EQUAL(deltaOf(2).size(), events->peek(2, &p));
+  for (int i = 0; i < EVENTS_RING; i++) publishNext(); // laps event 2's slot
+  TEST_ASSERT_EQUAL_UINT32(1, stats().resyncs); // off was 0: moved on...
+  events->consume(2, deltaOf(2).size()); // ...but those bytes went out
+  TEST_ASSERT_TRUE(events->done(2));
+  TEST_ASSERT_EQUAL_UINT32(1, stats().dropped);
+  events->consume(2, 1); // counted once
+  TEST_ASSERT_EQUAL_UINT32(1, stats().dropped);
+  TEST_ASSERT_EQUAL(0, events->peek(2, &p));
+}
+
+// A peek() of an event that stays in the ring is not a reuse
+static void test_publish_while_writing_is_not_a_reuse() {
+  TEST_ASSERT_TRUE(events->open(1));
+  publishNext();
+  const uint8_t *p;
+  size_t n = events->peek(1, &p);
+  for (int i = 1; i < EVENTS_RING; i++) publishNext();
+  events->consume(1, n);
+  TEST_ASSERT_FALSE(events->done(1));
+  std::string want;
+  for (uint32_t e = 2; e <= published; e++) want += deltaOf(e);
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), drain(1).c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, stats().dropped);
+}
+
+// ============================================
+// Framing
+// ============================================
+static void test_oversized_event_becomes_a_comment() {
+  TEST_ASSERT_TRUE(events->open(0));
+  std::string big = "{\"log\":\"" + std::string(EVENTS_MSG_BYTES, 'x') + "\"}";
+  events->publish("{\"small\":1}", big.c_str());
+  TEST_ASSERT_EQUAL_STRING(": overflow\n\n", drain(0).c_str());
+  events->publish(big.c_str(), "{}");
+  TEST_ASSERT_EQUAL_STRING(": overflow\n\n", drain(0).c_str());
+
+  // Exactly fitting, with its NUL: kept whole. One byte more is not.
+  std::string fits = "{\"log\":\"" + std::string(EVENTS_MSG_BYTES - 1 - 24, 'y') + "\"}";
+  TEST_ASSERT_EQUAL(EVENTS_MSG_BYTES - 1, deltaForm(3, fits.c_str()).size());
+  events->publish(fits.c_str(), "{}");
+  TEST_ASSERT_EQUAL_STRING(deltaForm(3, fits.c_str()).c_str(), drain(0).c_str());
+  fits.insert(8, "y");
+  events->publish(fits.c_str(), "{}");
+  TEST_ASSERT_EQUAL_STRING(": overflow\n\n", drain(0).c_str());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_event_is_full_then_deltas);
+  RUN_TEST(test_subscriber_limit);
+  RUN_TEST(test_resync_after_a_ring_behind);
+  RUN_TEST(test_slot_reused_mid_write_closes);
+  RUN_TEST(test_slot_reused_under_a_peek_closes);
+  RUN_TEST(test_publish_while_writing_is_not_a_reuse);
+  RUN_TEST(test_oversized_event_becomes_a_comment);
+  return UNITY_END();
+}
@@ -0,0 +1,359 @@
+// ============================================
+// File download tests (pio test -e native -f test_file_stream -v)
+// Range headers, then FileStream over files in a temp directory, driven
+// the way the server task drives an HttpStream: the body against the file
+// for whole files and ranges, the block reads lined up on sectors, the
+// FILE_STREAM_MAX cap and prepared files that are never sent. And the
+// uploader's delete of a file being downloaded: left to the download,
+// which still sends the file whole and removes it when it closes.
+// ============================================
+
+#include "net/file_stream.h"
+#include "storage/file_pins.h"
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static char mount[64];
+static std::string queueDir;
+
+static std::string writeFile(const char *name, size_t size) {
+  std::string path = queueDir + "/" + name;
+  FILE *f = fopen(path.c_str(), "wb");
+  for (size_t i = 0; i < size; i++) fputc((int)(next() & 0xFF), f);
+  fclose(f);
+  return path;
+}
+
+static std::vector<uint8_t> readFile(const std::string &path) {
+  std::vector<uint8_t> out;
+  FILE *f = fopen(path.c_str(), "rb");
+  int c;
+  while (f && (c = fgetc(f)) != EOF) out.push_back((uint8_t)c);
+  if (f) fclose(f);
+  return out;
+}
+
+static bool exists(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+static int openFds() {
+  int n = 0;
+  DIR *d = opendir("/proc/self/fd");
+  while (readdir(d)) n++;
+  closedir(d);
+  return n;
+}
+
+// The server task's side: peek, then write some of it (`chunk` at most)
+static std::vector<uint8_t> drain(FileStream &fs, uint8_t client, size_t chunk,
+                                  std::vector<size_t> *peeks = nullptr) {
+  std::vector<uint8_t> out;
+  for (int guard = 0; !fs.done(client) && guard < 100000; guard++) {
+    const uint8_t *p;
+    size_t n = fs.peek(client, &p);
+    if (n == 0) continue;
+    if (peeks) peeks->push_back(n);
+    if (n > chunk) n = chunk;
+    out.insert(out.end(), p, p + n);
+    fs.consume(client, n);
+  }
+  return out;
+}
+
+static FileStreamStats stats(const FileStream &fs) {
+  FileStreamStats st;
+  fs.getStats(&st);
+  return st;
+}
+static FilePinStats stats(const FilePins &pins) {
+  FilePinStats st;
+  pins.getStats(&st);
+  return st;
+}
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+// ============================================
+// Range header
+// ============================================
+static void test_byte_ranges() {
+  struct Case {
+    const char *header;
+    uint32_t size;
+    int code;
+    uint32_t from, len;
+  };
+  const Case cases[] = {
+      {"bytes=0-99", 1000, 206, 0, 100},
+      {"bytes=100-", 1000, 206, 100, 900},       // open-ended
+      {"bytes=999-", 1000, 206, 999, 1},
+      {"bytes=-100", 1000, 206, 900, 100},       // suffix
+      {"bytes=-5000", 1000, 206, 0, 1000},       // suffix longer than the body
+      {"bytes=990-2000", 1000, 206, 990, 10},    // last clamped
+      {"bytes=7-7", 1000, 206, 7, 1},
+      {"  bytes=1-2", 1000, 206, 1, 2},
+      {"bytes=1000-", 1000, 416, 0, 0},          // first >= size
+      {"bytes=1000-1001", 1000, 416, 0, 0},
+      {"bytes=-0", 1000, 416, 0, 0},
+      {"bytes=0-", 0, 416, 0, 0},
+      {"bytes=-1", 0, 416, 0, 0},
+      {"bytes=0-1,5-9", 1000, 200, 0, 0},        // several: ignored
+      {"bytes=-1, 10-", 1000, 200, 0, 0},
+      {"bytes=5-2", 1000, 200, 0, 0},            // malformed: ignored
+      {"bytes=a-1", 1000, 200, 0, 0},
+      {"bytes= 1-2", 1000, 200, 0, 0},
+      {"bytes=+1-2", 1000, 200, 0, 0},
+      {"bytes=1-2x", 1000, 200, 0, 0},
+      {"bytes=-", 1000, 200, 0, 0},
+      {"bytes=4294967296-", 1000, 200, 0, 0},
+      {"items=0-1", 1000, 200, 0, 0},
+      {"", 1000, 200, 0, 0},
+  };
+  for (const Case &c : cases) {
+    uint32_t from = 0xDEAD, len = 0xBEEF;
+    int code = parseByteRange(c.header, c.size, &from, &len);
+    char what[64];
+    snprintf(what, sizeof(what), "\"%s\" of %lu", c.header, (unsigned long)c.size);
+    TEST_ASSERT_EQUAL_MESSAGE(c.code, code, what);
+    if (code == 206) {
+      TEST_ASSERT_EQUAL_MESSAGE(c.from, from, what);
+      TEST_ASSERT_EQUAL_MESSAGE(c.len, len, what);
+    }
+  }
+  uint32_t from, len;
+  TEST_ASSERT_EQUAL(200, parseByteRange(nullptr, 1000, &from, &len));
+}
+
+// ============================================
+// Downloads
+// ============================================
+static void test_whole_files_and_ranges() {
+  FilePins pins(mount);
+  FileStream fs(&pins);
+  const size_t SIZES[] = {0, 1, 511, 512, FILE_STREAM_BLOCK, 3 * FILE_STREAM_BLOCK + 123};
+  for (size_t size : SIZES) {
+    std::string path = writeFile("whole.jpg", size);
+    std::vector<uint8_t> want = readFile(path);
+    uint32_t got;
+    TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &got));
+    TEST_ASSERT_EQUAL_UINT32(size, got);
+    TEST_ASSERT_TRUE(fs.open(1));
+    std::vector<uint8_t> body = drain(fs, 1, 1000 + next() % 3000);
+    fs.close(1);
+    TEST_ASSERT_EQUAL(want.size(), body.size());
+    TEST_ASSERT_TRUE(body == want);
+  }
+
+  // Ranges: after the first read, every one starts on a sector
+  std::string path = writeFile("range.pdf", 5 * FILE_STREAM_BLOCK + 77);
+  std::vector<uint8_t> want = readFile(path);
+  const uint32_t FROM[] = {0, 1, 700, 512, FILE_STREAM_BLOCK - 1, (uint32_t)want.size() - 1};
+  for (uint32_t from : FROM) {
+    uint32_t room = (uint32_t)want.size() - from;
+    uint32_t len = room > 100 ? room - next() % 100 : room;
+    uint32_t size;
+    TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+    fs.range(from, len);
+    TEST_ASSERT_TRUE(fs.open(0));
+    std::vector<size_t> peeks;
+    std::vector<uint8_t> body = drain(fs, 0, SIZE_MAX, &peeks);
+    fs.close(0);
+    TEST_ASSERT_EQUAL(len, body.size());
+    TEST_ASSERT_EQUAL_MEMORY(want.data() + from, body.data(), len);
+    uint32_t at = from + (uint32_t)peeks[0];
+    TEST_ASSERT_TRUE(peeks[0] <= FILE_STREAM_BLOCK);
+    if (peeks.size() > 1) TEST_ASSERT_EQUAL(0, at % 512);
+  }
+
+  FileStreamStats st = stats(fs);
+  TEST_ASSERT_EQUAL(0, st.active);
+  TEST_ASSERT_EQUAL_UINT32(12, st.served);
+  TEST_ASSERT_EQUAL_UINT32(0, st.aborted);
+  TEST_ASSERT_EQUAL(0, stats(pins).pinned);
+}
+
+static void test_cap_and_files_never_sent() {
+  FilePins pins(mount);
+  FileStream fs(&pins);
+  std::string path = writeFile("busy.jpg", 20000);
+  int fds = openFds();
+  uint32_t size;
+
+  for (int i = 0; i < FILE_STREAM_MAX; i++) {
+    TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+    TEST_ASSERT_TRUE(fs.open((uint8_t)i));
+  }
+  // One more is turned away, its file closed
+  TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+  TEST_ASSERT_FALSE(fs.open(FILE_STREAM_MAX));
+  TEST_ASSERT_EQUAL_UINT32(1, stats(fs).busy);
+  TEST_ASSERT_EQUAL(fds + FILE_STREAM_MAX, openFds());
+
+  // Prepared, then answered otherwise (304, 416, HEAD, or refused by the
+  // server before the stream was asked): cancel() closes it...
+  TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+  TEST_ASSERT_EQUAL(fds + FILE_STREAM_MAX + 1, openFds());
+  fs.cancel();
+  TEST_ASSERT_EQUAL(fds + FILE_STREAM_MAX, openFds());
+  fs.cancel();
+  // ...and so does the next prepare()
+  TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+  TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+  TEST_ASSERT_EQUAL(fds + FILE_STREAM_MAX + 1, openFds());
+  fs.cancel();
+
+  // A client leaving early
+  fs.close(0);
+  TEST_ASSERT_EQUAL_UINT32(1, stats(fs).aborted);
+  for (int i = 1; i < FILE_STREAM_MAX; i++) fs.close((uint8_t)i);
+  TEST_ASSERT_EQUAL(fds, openFds());
+  TEST_ASSERT_EQUAL(0, stats(pins).pinned);
+
+  TEST_ASSERT_FALSE(fs.prepare((queueDir + "/nope.jpg").c_str(), &size));
+  TEST_ASSERT_EQUAL(0, stats(pins).pinned);
+}
+
+// ============================================
+// Deleting a file being downloaded
+// ============================================
+static void test_delete_waits_for_the_download() {
+  FilePins pins(mount);
+  FileStream fs(&pins);
+  std::string path = writeFile("uploaded.jpg", 4 * FILE_STREAM_BLOCK + 5);
+  std::string cardPath = path.substr(strlen(mount)); // as the SD library names it
+  std::vector<uint8_t> want = readFile(path);
+  uint32_t size;
+
+  TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+  TEST_ASSERT_TRUE(fs.open(2));
+  const uint8_t *p;
+  size_t n = fs.peek(2, &p);
+  std::vector<uint8_t> body(p, p + n);
+  fs.consume(2, n);
+
+  // The upload finished: its delete is deferred, and nobody else gets it
+  TEST_ASSERT_FALSE(pins.claim(cardPath.c_str()));
+  TEST_ASSERT_TRUE(pins.doomed(cardPath.c_str()));
+  TEST_ASSERT_TRUE(pins.doomed(path.c_str()));
+  TEST_ASSERT_FALSE(pins.claim(cardPath.c_str())); // the uploader retrying
+  TEST_ASSERT_EQUAL_UINT32(1, stats(pins).deferred);
+  TEST_ASSERT_FALSE(fs.prepare(path.c_str(), &size));
+  TEST_ASSERT_EQUAL_UINT32(1, stats(pins).refused);
+
+  // The download still gets the whole file, then removes it
+  std::vector<uint8_t> rest = drain(fs, 2, 3000);
+  body.insert(body.end(), rest.begin(), rest.end());
+  TEST_ASSERT_TRUE(body == want);
+  TEST_ASSERT_TRUE(exists(path));
+  fs.close(2);
+  TEST_ASSERT_FALSE(exists(path));
+  TEST_ASSERT_FALSE(pins.doomed(cardPath.c_str()));
+  TEST_ASSERT_EQUAL(0, stats(pins).pinned);
+  TEST_ASSERT_EQUAL_UINT32(1, stats(fs).served);
+
+  // Nothing open: the deleter removes it itself, and until deleted() no
+  // download can start on it
+  path = writeFile("idle.jpg", 100);
+  cardPath = path.substr(strlen(mount));
+  TEST_ASSERT_TRUE(pins.claim(cardPath.c_str()));
+  TEST_ASSERT_FALSE(fs.prepare(path.c_str(), &size));
+  unlink(path.c_str());
+  pins.deleted(cardPath.c_str());
+  TEST_ASSERT_FALSE(pins.doomed(cardPath.c_str()));
+  writeFile("idle.jpg", 100); // saved again under the same name
+  TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+  fs.cancel();
+
+  // Two readers: the last one out removes it
+  path = writeFile("twice.jpg", 3000);
+  TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+  TEST_ASSERT_TRUE(fs.open(0));
+  TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+  TEST_ASSERT_TRUE(fs.open(1));
+  TEST_ASSERT_FALSE(pins.claim(path.c_str()));
+  fs.close(0);
+  TEST_ASSERT_TRUE(exists(path));
+  fs.close(1);
+  TEST_ASSERT_FALSE(exists(path));
+
+  // A prepared file never sent is removed by cancel()
+  path = writeFile("head.jpg", 10);
+  TEST_ASSERT_TRUE(fs.prepare(path.c_str(), &size));
+  TEST_ASSERT_FALSE(pins.claim(path.c_str()));
+  fs.cancel();
+  TEST_ASSERT_FALSE(exists(path));
+  TEST_ASSERT_EQUAL(0, stats(pins).pinned);
+}
+
+static void test_pin_table_keeps_a_slot_for_the_deleter() {
+  FilePins pins(mount);
+  char path[32];
+  for (int i = 0; i < FILE_PINS_MAX - 1; i++) {
+    snprintf(path, sizeof(path), "/queue/%d.jpg", i);
+    TEST_ASSERT_TRUE(pins.pin(path));
+  }
+  TEST_ASSERT_TRUE(pins.pin("/queue/0.jpg")); // a second reader needs no slot
+  TEST_ASSERT_FALSE(pins.pin("/queue/new.jpg"));
+  TEST_ASSERT_TRUE(pins.claim("/queue/other.jpg"));
+  pins.deleted("/queue/other.jpg");
+
+  TEST_ASSERT_FALSE(pins.unpin("/queue/0.jpg"));
+  TEST_ASSERT_FALSE(pins.unpin("/queue/0.jpg"));
+  TEST_ASSERT_FALSE(pins.unpin("/queue/0.jpg")); // not pinned: nothing
+  TEST_ASSERT_TRUE(pins.pin("/queue/new.jpg"));
+  TEST_ASSERT_EQUAL(FILE_PINS_MAX - 1, stats(pins).pinned);
+
+  // Only a whole mount-point component is dropped
+  FilePins sd("/sd");
+  TEST_ASSERT_TRUE(sd.claim("/sd/queue/a.jpg"));
+  TEST_ASSERT_TRUE(sd.doomed("/queue/a.jpg"));
+  TEST_ASSERT_TRUE(sd.claim("/sdcard/b.jpg"));
+  TEST_ASSERT_TRUE(sd.doomed("/sdcard/b.jpg"));
+  TEST_ASSERT_FALSE(sd.doomed("card/b.jpg"));
+
+  char longPath[FILE_PIN_PATH + 8];
+  memset(longPath, 'x', sizeof(longPath) - 1);
+  longPath[sizeof(longPath) - 1] = 0;
+  FileStream fs(&pins);
+  uint32_t size;
+  TEST_ASSERT_FALSE(fs.prepare(longPath, &size));
+}
+
+int main() {
+  snprintf(mount, sizeof(mount), "/tmp/file_stream_XXXXXX");
+  if (!mkdtemp(mount)) return 1;
+  queueDir = std::string(mount) + "/queue";
+  mkdir(queueDir.c_str(), 0755);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_byte_ranges);
+  RUN_TEST(test_whole_files_and_ranges);
+  RUN_TEST(test_cap_and_files_never_sent);
+  RUN_TEST(test_delete_waits_for_the_download);
+  RUN_TEST(test_pin_table_keeps_a_slot_for_the_deleter);
+  int failures = UNITY_END();
+
+  DIR *d = opendir(queueDir.c_str());
+  while (struct dirent *e = d ? readdir(d) : nullptr) {
+    if (e->d_name[0] != '.') unlink((queueDir + "/" + e->d_name).c_str());
+  }
+  if (d) closedir(d);
+  rmdir(queueDir.c_str());
+  rmdir(mount);
+  return failures;
+}
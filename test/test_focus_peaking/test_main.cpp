@@ -0,0 +1,128 @@
+// ============================================
+// Focus peaking tests (pio test -e native -f test_focus_peaking)
+// The branch-free row kernels against the scalar per-pixel references on
+// random rows of every width, and peakBlock()'s streaming (blocks tinted
+// as they arrive, luma carried across them) against the references run
+// over the whole frame at once.
+// ============================================
+
+#include "imaging/focus_peaking.h"
+#include <cstring>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+// Text-like: mostly flat paper, sometimes a dark stroke
+static void fillRow(uint16_t *px, int n) {
+  uint16_t paper = (uint16_t)(next() & 0xFFFF);
+  for (int i = 0; i < n; i++) px[i] = next() % 4 ? paper : (uint16_t)(next() & 0xFFFF);
+}
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+static void test_luma_kernel_matches_reference() {
+  uint16_t px[PEAK_MAX_WIDTH];
+  uint8_t luma[PEAK_MAX_WIDTH], ref[PEAK_MAX_WIDTH];
+  for (int n = 0; n <= PEAK_MAX_WIDTH; n++) {
+    for (int swapped = 0; swapped < 2; swapped++) {
+      for (int i = 0; i < n; i++) px[i] = (uint16_t)(next() & 0xFFFF);
+      peakLumaRow(px, luma, n, swapped);
+      peakLumaRowRef(px, ref, n, swapped);
+      TEST_ASSERT_EQUAL_MEMORY(ref, luma, n);
+    }
+  }
+  // Full range: white is the brightest, within 0..255
+  px[0] = 0xFFFF;
+  px[1] = 0x0000;
+  peakLumaRow(px, luma, 2, false);
+  TEST_ASSERT_EQUAL_UINT8(254, luma[0]);
+  TEST_ASSERT_EQUAL_UINT8(0, luma[1]);
+}
+
+static void test_tint_kernel_matches_reference() {
+  uint16_t row[PEAK_MAX_WIDTH + 2], kernel[PEAK_MAX_WIDTH + 2], ref[PEAK_MAX_WIDTH + 2];
+  uint8_t luma[PEAK_MAX_WIDTH + 2], above[PEAK_MAX_WIDTH + 2];
+  const uint8_t thresholds[] = {0, 1, 16, 48, 255};
+  for (int n = 0; n <= PEAK_MAX_WIDTH; n++) {
+    for (uint8_t threshold : thresholds) {
+      fillRow(row + 1, n);
+      peakLumaRowRef(row + 1, luma + 1, n, false);
+      for (int i = 0; i < n; i++) above[i + 1] = (uint8_t)next();
+      // Guards either side: px[-1] / px[n] are never written
+      row[0] = row[n + 1] = 0xA5A5;
+      memcpy(kernel, row, sizeof(row));
+      memcpy(ref, row, sizeof(row));
+
+      int tk = peakTintRow(kernel + 1, luma + 1, above + 1, n, threshold, 0xF800);
+      int tr = peakTintRowRef(ref + 1, luma + 1, above + 1, n, threshold, 0xF800);
+      TEST_ASSERT_EQUAL(tr, tk);
+      TEST_ASSERT_EQUAL_MEMORY(ref, kernel, (n + 2) * sizeof(uint16_t));
+      TEST_ASSERT_EQUAL_HEX16(0xA5A5, kernel[0]);
+      TEST_ASSERT_EQUAL_HEX16(0xA5A5, kernel[n + 1]);
+    }
+  }
+}
+
+static void test_edge_columns_use_one_sided_difference() {
+  uint16_t px[3] = {0, 0, 0};
+  const uint8_t luma[3] = {0, 0, 100}, above[3] = {0, 0, 0};
+  // Right edge: |luma[2] - luma[1]| = 100; left edge |luma[1] - luma[0]| = 0
+  TEST_ASSERT_EQUAL(2, peakTintRow(px, luma, above, 3, 100, 0xF800));
+  TEST_ASSERT_EQUAL_HEX16(0, px[0]);
+  TEST_ASSERT_EQUAL_HEX16(0xF800, px[1]);
+  TEST_ASSERT_EQUAL_HEX16(0xF800, px[2]);
+
+  uint16_t one = 0;
+  const uint8_t l1 = 90, a1 = 10;
+  TEST_ASSERT_EQUAL(1, peakTintRow(&one, &l1, &a1, 1, 80, 0x07E0));
+  TEST_ASSERT_EQUAL_HEX16(0x07E0, one);
+}
+
+// Frame peaked in 16-row blocks, inside a letterboxed area, against the
+// references over the same area row by row
+static void test_blocks_match_whole_frame() {
+  const int W = PEAK_MAX_WIDTH, H = 64, BH = 16;
+  const int16_t AX = 3, AY = 5;
+  const uint16_t AW = 150, AH = 50;
+  static uint16_t frame[H][W], expect[H][W];
+  for (int y = 0; y < H; y++) fillRow(frame[y], W);
+
+  for (int swapped = 0; swapped < 2; swapped++) {
+    static uint16_t got[H][W];
+    memcpy(got, frame, sizeof(frame));
+    memcpy(expect, frame, sizeof(frame));
+
+    PeakingState s;
+    peakInit(&s, 40, 0xF800, swapped);
+    peakFrameStart(&s, AX, AY, AW, AH);
+    for (int y = 0; y < H; y += BH) peakBlock(&s, 0, y, W, BH, &got[y][0]);
+
+    uint16_t tint = swapped ? 0x00F8 : 0xF800;
+    uint8_t luma[PEAK_MAX_WIDTH], above[PEAK_MAX_WIDTH];
+    uint32_t tinted = 0;
+    for (int y = AY; y < AY + AH; y++) {
+      peakLumaRowRef(&expect[y][AX], luma, AW, swapped);
+      if (y == AY) memcpy(above, luma, AW);
+      tinted += peakTintRowRef(&expect[y][AX], luma, above, AW, 40, tint);
+      memcpy(above, luma, AW);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(expect, got, sizeof(got));
+    TEST_ASSERT_EQUAL_UINT32(tinted, s.tinted);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)AW * AH, s.pixels);
+    TEST_ASSERT_GREATER_THAN(0, tinted);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_luma_kernel_matches_reference);
+  RUN_TEST(test_tint_kernel_matches_reference);
+  RUN_TEST(test_edge_columns_use_one_sided_difference);
+  RUN_TEST(test_blocks_match_whole_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,276 @@
+// ============================================
+// Frame assembler tests (pio test -e native -f test_frame_assembler -v)
+// Resampler/decoder blocks assembled into StripRing buffers and flushed to
+// a recording fake panel (one transfer per committed buffer). Checks pixel
+// placement against the blocks, transfers and bytes per frame for the
+// full-frame and strip layouts, MCU rows wider than the panel, stalls on a
+// slow panel, and truncated decodes.
+// ============================================
+
+#include "display/frame_assembler.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <unity.h>
+
+// Panel and viewfinder geometry as in display.cpp: a 128x160 panel, the
+// content zone at row 16 whose first row is the separator line
+static const int PANEL_W = 128, PANEL_H = 160;
+static const int16_t CONTENT_Y = 16, TOP = 17, BOTTOM = 136;
+static const uint16_t SEPARATOR = 0x07FF, UNTOUCHED = 0xDEAD;
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static uint16_t pixel(uint32_t frame, int x, int y) { return (uint16_t)(frame * 2654435761u + y * 131 + x); }
+
+struct Panel {
+  StripRing *ring = nullptr;
+  uint16_t fb[PANEL_H][PANEL_W];
+  std::vector<StripInfo> log;
+  uint32_t tx = 0, bytes = 0, waits = 0;
+  bool lazy = false; // only drains when the assembler runs out of buffers
+};
+static Panel panel;
+
+// Take, draw and release everything committed (transfer done at once)
+static void drain() {
+  StripInfo s;
+  uint16_t *px;
+  while (panel.ring->take(&s, &px)) {
+    panel.log.push_back(s);
+    if (s.h) {
+      panel.tx++;
+      panel.bytes += (uint32_t)s.w * s.h * sizeof(uint16_t);
+      for (int row = 0; row < s.h; row++) memcpy(&panel.fb[s.y + row][s.x], px + row * s.w, s.w * sizeof(uint16_t));
+    }
+    panel.ring->release();
+  }
+}
+
+static void waitFree(void *arg) {
+  panel.waits++;
+  drain();
+}
+
+static void committed(void *arg) {
+  if (!panel.lazy) drain();
+}
+
+struct Layout {
+  StripRing ring;
+  FrameAssembler assembler;
+  std::vector<std::vector<uint16_t>> store;
+  Layout(uint8_t count, uint16_t rows) : store(count, std::vector<uint16_t>((size_t)PANEL_W * rows)) {
+    uint16_t *bufs[STRIP_RING_MAX];
+    for (uint8_t i = 0; i < count; i++) bufs[i] = store[i].data();
+    TEST_ASSERT_TRUE(ring.attach(bufs, count, PANEL_W, rows));
+    assembler.attach(&ring, waitFree, committed, nullptr);
+    panel = Panel();
+    panel.ring = &ring;
+    for (int y = 0; y < PANEL_H; y++)
+      for (int x = 0; x < PANEL_W; x++) panel.fb[y][x] = y == CONTENT_Y ? SEPARATOR : UNTOUCHED;
+  }
+};
+
+// The resampler's output: the whole box in full-width 4-row blocks,
+// starting on the separator row. `stopAt` cuts the frame short.
+static void resamplerFrame(FrameAssembler *a, uint32_t frame, int stopAt = PANEL_H) {
+  const int BH = 4;
+  uint16_t block[PANEL_W * BH];
+  a->beginFrame(frame, frame * 1000, TOP, BOTTOM, PANEL_W);
+  for (int y = CONTENT_Y; y < BOTTOM && y < stopAt; y += BH) {
+    for (int row = 0; row < BH; row++)
+      for (int x = 0; x < PANEL_W; x++) block[row * PANEL_W + x] = pixel(frame, x, y + row);
+    a->addBlock(0, (int16_t)y, PANEL_W, BH, block);
+  }
+  a->endFrame();
+}
+
+static void checkFrame(uint32_t frame) {
+  for (int x = 0; x < PANEL_W; x++) TEST_ASSERT_EQUAL_HEX16(SEPARATOR, panel.fb[CONTENT_Y][x]);
+  for (int y = TOP; y < BOTTOM; y++) {
+    for (int x = 0; x < PANEL_W; x++) {
+      if (panel.fb[y][x] != pixel(frame, x, y)) {
+        char msg[80];
+        snprintf(msg, sizeof(msg), "frame %u pixel (%d,%d)", (unsigned)frame, x, y);
+        TEST_FAIL_MESSAGE(msg);
+      }
+    }
+  }
+  for (int x = 0; x < PANEL_W; x++) TEST_ASSERT_EQUAL_HEX16(UNTOUCHED, panel.fb[BOTTOM][x]);
+}
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+// ============================================
+// Layouts
+// ============================================
+// Two 128x119 buffers: one transfer per frame
+static void test_full_frame_is_one_transfer() {
+  Layout l(2, BOTTOM - TOP);
+  const uint32_t FRAMES = 300;
+  for (uint32_t f = 1; f <= FRAMES; f++) {
+    size_t before = panel.log.size();
+    resamplerFrame(&l.assembler, f);
+    TEST_ASSERT_TRUE(l.assembler.ended());
+    TEST_ASSERT_EQUAL(1, (int)(panel.log.size() - before));
+    const StripInfo &s = panel.log.back();
+    TEST_ASSERT_TRUE(s.endOfFrame);
+    TEST_ASSERT_EQUAL_UINT32(f, s.frame);
+    TEST_ASSERT_EQUAL_UINT32(f * 1000, s.grabUs);
+    TEST_ASSERT_EQUAL_INT16(TOP, s.y);
+    checkFrame(f);
+  }
+  TEST_ASSERT_EQUAL_UINT32(FRAMES, panel.tx);
+  TEST_ASSERT_EQUAL_UINT32(FRAMES * PANEL_W * (BOTTOM - TOP) * 2, panel.bytes);
+  TEST_ASSERT_EQUAL_UINT32(0, panel.waits);
+  char line[100];
+  snprintf(line, sizeof(line), "full frame: %u tx, %u bytes per frame", (unsigned)(panel.tx / FRAMES),
+           (unsigned)(panel.bytes / FRAMES));
+  TEST_MESSAGE(line);
+}
+
+// Three 16-row strips: buffers fill to whole blocks, the last one short
+static void test_strips_are_contiguous() {
+  Layout l(3, 16);
+  const uint32_t FRAMES = 50;
+  for (uint32_t f = 1; f <= FRAMES; f++) {
+    size_t first = panel.log.size();
+    resamplerFrame(&l.assembler, f);
+    int16_t y = TOP;
+    for (size_t i = first; i < panel.log.size(); i++) {
+      const StripInfo &s = panel.log[i];
+      TEST_ASSERT_EQUAL_INT16(y, s.y);
+      TEST_ASSERT_LESS_OR_EQUAL(16, s.h);
+      TEST_ASSERT_GREATER_THAN(0, s.h);
+      TEST_ASSERT_EQUAL(i == panel.log.size() - 1, s.endOfFrame);
+      y += s.h;
+    }
+    TEST_ASSERT_EQUAL_INT16(BOTTOM, y);
+    checkFrame(f);
+  }
+  TEST_ASSERT_EQUAL_UINT32(8 * FRAMES, panel.tx);
+  char line[100];
+  snprintf(line, sizeof(line), "16-row strips: %u tx, %u bytes per frame", (unsigned)(panel.tx / FRAMES),
+           (unsigned)(panel.bytes / FRAMES));
+  TEST_MESSAGE(line);
+}
+
+// A panel that lags: the assembler waits for buffers instead of overwriting
+static void test_slow_panel_stalls_the_assembler() {
+  Layout l(3, 16);
+  panel.lazy = true;
+  for (uint32_t f = 1; f <= 20; f++) {
+    resamplerFrame(&l.assembler, f);
+    drain();
+    checkFrame(f);
+  }
+  TEST_ASSERT_GREATER_THAN(0, panel.waits);
+  TEST_ASSERT_EQUAL_UINT32(8 * 20, panel.tx);
+}
+
+// ============================================
+// Decoder blocks
+// ============================================
+// 24x16 MCUs across a 168-wide decode: the MCU straddling the panel edge
+// is clipped, columns past it are dropped, and a buffer is only committed
+// at the end of an MCU row
+static void test_mcu_rows_wider_than_panel() {
+  Layout l(3, 32);
+  const int DW = 168, MW = 24, MH = 16;
+  uint16_t block[MW * MH];
+  for (uint32_t f = 1; f <= 10; f++) {
+    size_t first = panel.log.size();
+    l.assembler.beginFrame(f, 0, TOP, BOTTOM, DW);
+    for (int y = CONTENT_Y; y < BOTTOM; y += MH) {
+      for (int x = 0; x < DW; x += MW) {
+        for (int row = 0; row < MH; row++)
+          for (int col = 0; col < MW; col++) block[row * MW + col] = pixel(f, x + col, y + row);
+        size_t before = panel.log.size();
+        l.assembler.addBlock((int16_t)x, (int16_t)y, MW, MH, block);
+        if (x + MW < DW) TEST_ASSERT_EQUAL(before, panel.log.size());
+      }
+    }
+    l.assembler.endFrame();
+    // 15 + 16 rows, then 32s: every buffer holds whole MCU rows
+    int16_t y = TOP;
+    for (size_t i = first; i < panel.log.size(); i++) {
+      TEST_ASSERT_EQUAL_INT16(y, panel.log[i].y);
+      TEST_ASSERT_EQUAL_UINT16(PANEL_W, panel.log[i].w);
+      y += panel.log[i].h;
+    }
+    TEST_ASSERT_EQUAL_INT16(BOTTOM, y);
+    checkFrame(f);
+  }
+}
+
+// A truncated decode still closes the frame with an (empty) end marker;
+// a part-filled buffer is dropped rather than shown
+static void test_truncated_decode_sends_end_marker() {
+  Layout l(3, 16);
+  resamplerFrame(&l.assembler, 1);
+  checkFrame(1);
+  size_t first = panel.log.size();
+  resamplerFrame(&l.assembler, 2, 70); // rows 17..69 decoded
+  TEST_ASSERT_TRUE(l.assembler.ended());
+  const StripInfo &end = panel.log.back();
+  TEST_ASSERT_TRUE(end.endOfFrame);
+  TEST_ASSERT_EQUAL_UINT16(0, end.h);
+  TEST_ASSERT_EQUAL_UINT32(2, end.frame);
+  int16_t shown = 0;
+  for (size_t i = first; i < panel.log.size(); i++) shown += panel.log[i].h;
+  TEST_ASSERT_EQUAL_INT16(15 + 16 + 16, shown);
+  // Rows that went out are frame 2, the rest still frame 1
+  TEST_ASSERT_EQUAL_HEX16(pixel(2, 5, TOP + shown - 1), panel.fb[TOP + shown - 1][5]);
+  TEST_ASSERT_EQUAL_HEX16(pixel(1, 5, TOP + shown), panel.fb[TOP + shown][5]);
+
+  // Nothing decoded at all: the marker alone; a second endFrame adds nothing
+  first = panel.log.size();
+  l.assembler.beginFrame(3, 0, TOP, BOTTOM, PANEL_W);
+  l.assembler.endFrame();
+  l.assembler.endFrame();
+  TEST_ASSERT_EQUAL(1, (int)(panel.log.size() - first));
+  TEST_ASSERT_TRUE(panel.log.back().endOfFrame);
+  TEST_ASSERT_EQUAL_UINT16(0, panel.log.back().h);
+
+  // Blocks after the end are ignored
+  uint16_t block[PANEL_W * 4] = {};
+  l.assembler.addBlock(0, TOP, PANEL_W, 4, block);
+  TEST_ASSERT_EQUAL(1, (int)(panel.log.size() - first));
+  TEST_ASSERT_EQUAL_UINT8(0, l.ring.inFlight());
+}
+
+// Any block height up to the buffer's (fixed within a frame, as the
+// decoder and resampler emit): placement never depends on the block grid
+static void test_block_heights() {
+  Layout l(3, 24);
+  uint16_t block[PANEL_W * 24];
+  for (uint32_t f = 1; f <= 48; f++) {
+    const int h = 1 + (f - 1) % 24;
+    l.assembler.beginFrame(f, 0, TOP, BOTTOM, PANEL_W);
+    for (int y = CONTENT_Y + (int)(next() % 2); y < BOTTOM;) {
+      for (int row = 0; row < h; row++)
+        for (int x = 0; x < PANEL_W; x++) block[row * PANEL_W + x] = pixel(f, x, y + row);
+      l.assembler.addBlock(0, (int16_t)y, PANEL_W, (uint16_t)h, block);
+      y += h;
+    }
+    l.assembler.endFrame();
+    checkFrame(f);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_full_frame_is_one_transfer);
+  RUN_TEST(test_strips_are_contiguous);
+  RUN_TEST(test_slow_panel_stalls_the_assembler);
+  RUN_TEST(test_mcu_rows_wider_than_panel);
+  RUN_TEST(test_truncated_decode_sends_end_marker);
+  RUN_TEST(test_block_heights);
+  return UNITY_END();
+}
@@ -0,0 +1,283 @@
+// ============================================
+// Capture quality gate tests (pio test -e native -f test_frame_quality -v)
+// The gate's two host-side stages: the JPEG marker scan on whole frames
+// (clean, truncated, corrupted) and the exposure / sharpness metrics on
+// 1/8-scale luma planes of a synthetic text page, sharp and blurred, dark
+// and blown, judged with the firmware's QUALITY_GATE_* limits. The cost of
+// each stage per UXGA frame is printed with -v.
+// ============================================
+
+#include "config.h"
+#include "imaging/frame_quality.h"
+#include "imaging/jpeg_scan.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <unity.h>
+
+static const FrameQualityLimits LIMITS = {QUALITY_GATE_MIN_MEAN,     QUALITY_GATE_MAX_MEAN,
+                                          QUALITY_GATE_MAX_CLIP_PCT, QUALITY_GATE_MIN_CONTRAST,
+                                          QUALITY_GATE_MIN_SHARPNESS, QUALITY_GATE_MIN_DENSITY_MBPP};
+
+// UXGA at 1/8 scale
+#define W 200
+#define H 150
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static double usSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+// ============================================
+// Luma planes
+// ============================================
+// A page of text lines at 1/8 scale: paper with short dark runs (words),
+// a darker desk border around it
+static std::vector<uint8_t> textPage(uint8_t paper = 200, uint8_t ink = 60) {
+  std::vector<uint8_t> p(W * H);
+  for (int y = 0; y < H; y++) {
+    for (int x = 0; x < W; x++) {
+      bool onPage = x >= 12 && x < W - 12 && y >= 8 && y < H - 8;
+      p[y * W + x] = onPage ? paper : 70;
+    }
+  }
+  for (int line = 14; line < H - 14; line += 5) {
+    for (int x = 20; x < W - 20;) {
+      int word = 3 + next() % 8;
+      for (int i = 0; i < word && x + i < W - 20; i++) {
+        p[line * W + x + i] = ink;
+        if (next() % 3 == 0) p[(line + 1) * W + x + i] = ink;
+      }
+      x += word + 2;
+    }
+  }
+  for (uint8_t &v : p) v = (uint8_t)(v + next() % 5); // sensor noise
+  return p;
+}
+
+// Defocus or shake: a box blur of `r` pixels either side
+static std::vector<uint8_t> blur(const std::vector<uint8_t> &p, int r) {
+  std::vector<uint8_t> out(p.size());
+  for (int y = 0; y < H; y++) {
+    for (int x = 0; x < W; x++) {
+      int sum = 0, n = 0;
+      for (int dy = -r; dy <= r; dy++) {
+        for (int dx = -r; dx <= r; dx++) {
+          int xx = x + dx < 0 ? 0 : x + dx >= W ? W - 1 : x + dx;
+          int yy = y + dy < 0 ? 0 : y + dy >= H ? H - 1 : y + dy;
+          sum += p[yy * W + xx];
+          n++;
+        }
+      }
+      out[y * W + x] = (uint8_t)(sum / n);
+    }
+  }
+  return out;
+}
+
+static std::vector<uint8_t> scale(const std::vector<uint8_t> &p, float gain, int offset) {
+  std::vector<uint8_t> out(p.size());
+  for (size_t i = 0; i < p.size(); i++) {
+    float v = p[i] * gain + offset;
+    out[i] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+  }
+  return out;
+}
+
+static const char *judge(const std::vector<uint8_t> &p, FrameQualityMetrics *m) {
+  computeFrameQuality(p.data(), W, H, m);
+  m->densityMbpp = QUALITY_GATE_MIN_DENSITY_MBPP; // size is judged separately
+  return checkFrameQuality(*m, LIMITS);
+}
+
+// ============================================
+// Metrics
+// ============================================
+static void test_histogram_stats() {
+  std::vector<uint8_t> p(100 * 10);
+  for (size_t i = 0; i < p.size(); i++) p[i] = (uint8_t)(i % 100 < 10 ? 0 : i % 100 < 90 ? 128 : 250);
+  FrameQualityMetrics m;
+  computeFrameQuality(p.data(), 100, 10, &m);
+  TEST_ASSERT_EQUAL_UINT8(0, m.p5);
+  TEST_ASSERT_EQUAL_UINT8(250, m.p95);
+  TEST_ASSERT_EQUAL_UINT8(10, m.darkPct);
+  TEST_ASSERT_EQUAL_UINT8(10, m.brightPct);
+  TEST_ASSERT_EQUAL_UINT8((0 * 10 + 128 * 80 + 250 * 10) / 100, m.meanLuma);
+
+  // Flat frame with sensor noise: the contrast floor keeps the noise from
+  // scoring as detail, and the frame goes out as low-contrast
+  memset(p.data(), 128, p.size());
+  for (size_t i = 0; i < p.size(); i += 7) p[i] = 131;
+  computeFrameQuality(p.data(), 100, 10, &m);
+  TEST_ASSERT_LESS_THAN(LIMITS.minSharpness * 2, m.sharpness);
+  TEST_ASSERT_EQUAL_STRING("low-contrast", checkFrameQuality(m, LIMITS));
+
+  // Too small to have an interior: all zero
+  computeFrameQuality(p.data(), 2, 2, &m);
+  TEST_ASSERT_EQUAL_UINT8(0, m.meanLuma);
+  TEST_ASSERT_EQUAL_UINT16(0, m.sharpness);
+}
+
+static void test_sharp_page_passes() {
+  FrameQualityMetrics m;
+  TEST_ASSERT_NULL(judge(textPage(), &m));
+  // Sharpness is contrast-normalised: a dimmer, flatter page scores alike
+  FrameQualityMetrics dim;
+  TEST_ASSERT_NULL(judge(textPage(150, 70), &dim));
+  TEST_ASSERT_UINT_WITHIN(m.sharpness / 3, m.sharpness, dim.sharpness);
+}
+
+static void test_blur_is_rejected() {
+  std::vector<uint8_t> sharp = textPage();
+  FrameQualityMetrics m;
+  TEST_ASSERT_EQUAL_STRING("blurred", judge(blur(sharp, 2), &m));
+  TEST_ASSERT_EQUAL_STRING("blurred", judge(blur(sharp, 4), &m));
+
+  // Fine blur the DC image misses is caught by the compressed size
+  TEST_ASSERT_NULL(judge(sharp, &m));
+  m.densityMbpp = jpegDensityMbpp(40000, 1600, 1200); // 167 mbpp
+  TEST_ASSERT_EQUAL_STRING("blurred", checkFrameQuality(m, LIMITS));
+  TEST_ASSERT_EQUAL_UINT16(1000, jpegDensityMbpp(240000, 1600, 1200));
+  TEST_ASSERT_EQUAL_UINT16(0, jpegDensityMbpp(1000, 0, 1200));
+}
+
+static void test_exposure_is_rejected() {
+  std::vector<uint8_t> page = textPage();
+  FrameQualityMetrics m;
+  TEST_ASSERT_EQUAL_STRING("underexposed", judge(scale(page, 0.15f, 0), &m));
+  TEST_ASSERT_EQUAL_STRING("overexposed", judge(scale(page, 2.5f, 40), &m));
+  TEST_ASSERT_EQUAL_STRING("low-contrast", judge(scale(page, 0.08f, 110), &m));
+}
+
+// ============================================
+// Marker scan
+// ============================================
+static void put16(std::vector<uint8_t> &j, uint16_t v) {
+  j.push_back(v >> 8);
+  j.push_back(v & 0xFF);
+}
+
+// Segment layout of an OV2640 frame: APP0, DQT, SOF0 (4:2:2), DHT, SOS,
+// entropy data with stuffing and restart markers, EOI
+static std::vector<uint8_t> frameJpeg(size_t entropyBytes) {
+  std::vector<uint8_t> j = {0xFF, 0xD8};
+  j.insert(j.end(), {0xFF, 0xE0});
+  put16(j, 16);
+  j.insert(j.end(), {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0});
+  j.insert(j.end(), {0xFF, 0xDB});
+  put16(j, 67);
+  j.push_back(0);
+  for (int i = 0; i < 64; i++) j.push_back(1 + i / 4);
+  j.insert(j.end(), {0xFF, 0xC0});
+  put16(j, 17);
+  j.push_back(8);
+  put16(j, 1200);
+  put16(j, 1600);
+  j.insert(j.end(), {3, 1, 0x21, 0, 2, 0x11, 1, 3, 0x11, 1});
+  j.insert(j.end(), {0xFF, 0xC4});
+  put16(j, 2 + 17 + 1);
+  j.push_back(0);
+  for (int i = 0; i < 16; i++) j.push_back(i == 0 ? 1 : 0);
+  j.push_back(0);
+  j.insert(j.end(), {0xFF, 0xDA});
+  put16(j, 12);
+  j.insert(j.end(), {3, 1, 0, 2, 0x11, 3, 0x11, 0, 63, 0});
+  size_t start = j.size();
+  while (j.size() - start < entropyBytes) {
+    uint8_t b = (uint8_t)next();
+    j.push_back(b);
+    if (b == 0xFF) j.push_back(0x00);
+    if ((j.size() - start) % 4096 == 0) j.insert(j.end(), {0xFF, (uint8_t)(0xD0 + (j.size() / 4096) % 8)});
+  }
+  j.insert(j.end(), {0xFF, 0xD9});
+  return j;
+}
+
+static void test_scan_reads_a_whole_frame() {
+  std::vector<uint8_t> j = frameJpeg(200000);
+  JpegInfo info;
+  TEST_ASSERT_EQUAL(JPEG_OK, jpegScanStructure(j.data(), j.size(), &info));
+  TEST_ASSERT_EQUAL_UINT16(1600, info.width);
+  TEST_ASSERT_EQUAL_UINT16(1200, info.height);
+  TEST_ASSERT_EQUAL_UINT8(3, info.components);
+  TEST_ASSERT_EQUAL_UINT8(2, info.hSamp);
+  TEST_ASSERT_EQUAL_UINT8(1, info.vSamp);
+  TEST_ASSERT_EQUAL(j.size() - 2, info.eoiOffset);
+  TEST_ASSERT_EQUAL(JPEG_OK, jpegReadHeader(j.data(), j.size(), nullptr));
+
+  // Trailing bytes after EOI (sensor padding) are ignored
+  j.insert(j.end(), 64, 0x00);
+  TEST_ASSERT_EQUAL(JPEG_OK, jpegScanStructure(j.data(), j.size(), nullptr));
+}
+
+static void test_scan_rejects_broken_frames() {
+  std::vector<uint8_t> j = frameJpeg(20000);
+  // Truncated anywhere in the entropy data, or right after the FF of EOI
+  TEST_ASSERT_EQUAL(JPEG_ERR_NO_EOI, jpegScanStructure(j.data(), j.size() - 2, nullptr));
+  TEST_ASSERT_EQUAL(JPEG_ERR_NO_EOI, jpegScanStructure(j.data(), j.size() - 1, nullptr));
+  TEST_ASSERT_EQUAL(JPEG_ERR_NO_EOI, jpegScanStructure(j.data(), j.size() / 2, nullptr));
+  // Cut inside the header
+  TEST_ASSERT_EQUAL(JPEG_ERR_BAD_SEGMENT, jpegScanStructure(j.data(), 30, nullptr));
+  TEST_ASSERT_EQUAL(JPEG_ERR_EMPTY, jpegScanStructure(j.data(), 3, nullptr));
+  TEST_ASSERT_EQUAL(JPEG_ERR_EMPTY, jpegScanStructure(nullptr, 0, nullptr));
+
+  std::vector<uint8_t> bad = j;
+  bad[0] = 0x00;
+  TEST_ASSERT_EQUAL(JPEG_ERR_NO_SOI, jpegScanStructure(bad.data(), bad.size(), nullptr));
+
+  // An unstuffed marker in the entropy data (a dropped DMA chunk)
+  bad = j;
+  bad[bad.size() / 2] = 0xFF;
+  bad[bad.size() / 2 + 1] = 0xC8;
+  TEST_ASSERT_EQUAL(JPEG_ERR_BAD_MARKER, jpegScanStructure(bad.data(), bad.size(), nullptr));
+
+  // SOS before any frame header
+  bad = {0xFF, 0xD8, 0xFF, 0xDA, 0x00, 0x02, 0xFF, 0xD9};
+  TEST_ASSERT_EQUAL(JPEG_ERR_NO_SOF, jpegScanStructure(bad.data(), bad.size(), nullptr));
+  // EOI straight after the header
+  bad = {0xFF, 0xD8, 0xFF, 0xD9, 0x00, 0x00};
+  TEST_ASSERT_EQUAL(JPEG_ERR_NO_SOS, jpegScanStructure(bad.data(), bad.size(), nullptr));
+}
+
+// ============================================
+// Cost
+// ============================================
+static void test_cost_per_frame() {
+  std::vector<uint8_t> j = frameJpeg(300000);
+  std::vector<uint8_t> page = textPage();
+  FrameQualityMetrics m;
+  const int RUNS = 200;
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) TEST_ASSERT_EQUAL(JPEG_OK, jpegScanStructure(j.data(), j.size(), nullptr));
+  double scanUs = usSince(t0) / RUNS;
+  t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) computeFrameQuality(page.data(), W, H, &m);
+  double metricUs = usSince(t0) / RUNS;
+
+  char line[120];
+  snprintf(line, sizeof(line), "host: marker scan %.1f us per 300 KB frame, metrics %.1f us per %dx%d plane",
+           scanUs, metricUs, W, H);
+  TEST_MESSAGE(line);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_histogram_stats);
+  RUN_TEST(test_sharp_page_passes);
+  RUN_TEST(test_blur_is_rejected);
+  RUN_TEST(test_exposure_is_rejected);
+  RUN_TEST(test_scan_reads_a_whole_frame);
+  RUN_TEST(test_scan_rejects_broken_frames);
+  RUN_TEST(test_cost_per_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,290 @@
+// ============================================
+// Frame ring tests (pio test -e native -f test_frame_ring -v)
+// FIFO order, the wrap at the end of the buffer, a full buffer and a full
+// slot table, then random traffic against a model that checks every frame
+// comes back byte for byte. Last, a burst session in simulated time: a
+// camera producing UXGA pages at BURST_INTERVAL_MS into a ring, drained by
+// an SD card with slow and stalling writes; pages per minute and drops are
+// printed with -v. (burst_session.cpp itself needs the camera driver, so
+// the simulation drives the ring with the session's policy.)
+// ============================================
+
+#include "capture/frame_ring.h"
+#include "config.h"
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static FrameRing ring;
+static std::vector<uint8_t> buffer;
+
+static void attach(size_t cap) {
+  buffer.assign(cap, 0);
+  ring.attach(buffer.data(), cap);
+}
+
+// Reserve, fill with a pattern from `seq` and commit; false when refused
+static bool push(uint32_t len, uint32_t seq) {
+  uint8_t *dst = ring.reserve(len);
+  if (!dst) return false;
+  TEST_ASSERT_TRUE(dst >= buffer.data() && dst + len <= buffer.data() + buffer.size());
+  for (uint32_t i = 0; i < len; i++) dst[i] = (uint8_t)(seq * 31 + i);
+  ring.commit(len, seq);
+  return true;
+}
+
+// Oldest frame has `len` bytes of `seq`'s pattern; popped
+static void popExpect(uint32_t len, uint32_t seq) {
+  FrameSlot s;
+  TEST_ASSERT_TRUE(ring.peek(&s));
+  TEST_ASSERT_EQUAL_UINT32(seq, s.seq);
+  TEST_ASSERT_EQUAL_UINT32(len, s.len);
+  const uint8_t *p = ring.data() + s.offset;
+  for (uint32_t i = 0; i < len; i++) {
+    if (p[i] != (uint8_t)(seq * 31 + i)) TEST_FAIL_MESSAGE("frame bytes overwritten");
+  }
+  ring.pop();
+}
+
+void setUp() {
+  rng = 1;
+  attach(1000);
+}
+void tearDown() {}
+
+// ============================================
+// Basics
+// ============================================
+static void test_fifo_order() {
+  TEST_ASSERT_TRUE(push(100, 1));
+  TEST_ASSERT_TRUE(push(200, 2));
+  TEST_ASSERT_TRUE(push(50, 3));
+  TEST_ASSERT_EQUAL(3, (int)ring.count());
+  TEST_ASSERT_EQUAL(350, (int)ring.usedBytes());
+
+  // peek() leaves the frame in place
+  FrameSlot s;
+  TEST_ASSERT_TRUE(ring.peek(&s));
+  TEST_ASSERT_TRUE(ring.peek(&s));
+  TEST_ASSERT_EQUAL(3, (int)ring.count());
+
+  popExpect(100, 1);
+  popExpect(200, 2);
+  popExpect(50, 3);
+  TEST_ASSERT_FALSE(ring.peek(&s));
+  ring.pop(); // harmless when empty
+  TEST_ASSERT_EQUAL(0, (int)ring.count());
+}
+
+static void test_refuses_bad_sizes_and_detached() {
+  TEST_ASSERT_NULL(ring.reserve(0));
+  TEST_ASSERT_NULL(ring.reserve(1001));
+  TEST_ASSERT_NOT_NULL(ring.reserve(1000));
+  ring.attach(nullptr, 0);
+  TEST_ASSERT_NULL(ring.reserve(10));
+}
+
+static void test_empty_ring_restarts_at_front() {
+  TEST_ASSERT_TRUE(push(600, 1));
+  popExpect(600, 1);
+  // Nothing left: a frame bigger than the space after the old head fits
+  TEST_ASSERT_EQUAL_PTR(buffer.data(), ring.reserve(900));
+}
+
+// A reserve that is never committed (frame dropped after the scan) leaves
+// the ring as it was
+static void test_uncommitted_reserve_is_forgotten() {
+  TEST_ASSERT_TRUE(push(300, 1));
+  uint8_t *a = ring.reserve(200);
+  TEST_ASSERT_NOT_NULL(a);
+  TEST_ASSERT_EQUAL_PTR(a, ring.reserve(200));
+  TEST_ASSERT_EQUAL(1, (int)ring.count());
+  TEST_ASSERT_TRUE(push(200, 2));
+  popExpect(300, 1);
+  popExpect(200, 2);
+}
+
+// ============================================
+// Wrap and full
+// ============================================
+static void test_wraps_past_the_end_gap() {
+  TEST_ASSERT_TRUE(push(300, 1));
+  TEST_ASSERT_TRUE(push(300, 2));
+  TEST_ASSERT_TRUE(push(300, 3)); // head at 900
+  popExpect(300, 1);              // [0, 300) free
+
+  // 200 does not fit in the last 100 bytes: wraps to the front
+  uint8_t *p = ring.reserve(200);
+  TEST_ASSERT_EQUAL_PTR(buffer.data(), p);
+  TEST_ASSERT_TRUE(push(200, 4));
+  // Wrapped: only [200, 300) is free now, the end gap is not reused
+  TEST_ASSERT_NULL(ring.reserve(101));
+  TEST_ASSERT_TRUE(push(100, 5));
+  TEST_ASSERT_NULL(ring.reserve(1));
+
+  popExpect(300, 2);
+  popExpect(300, 3);
+  popExpect(200, 4);
+  popExpect(100, 5);
+}
+
+static void test_full_buffer_refuses_without_damage() {
+  TEST_ASSERT_TRUE(push(400, 1));
+  TEST_ASSERT_TRUE(push(400, 2));
+  TEST_ASSERT_FALSE(push(300, 3)); // 200 left at the end, nothing at the front
+  TEST_ASSERT_TRUE(push(200, 3));
+  TEST_ASSERT_FALSE(push(1, 4));
+  TEST_ASSERT_EQUAL(1000, (int)ring.usedBytes());
+
+  // Room comes back as the writer pops
+  popExpect(400, 1);
+  TEST_ASSERT_TRUE(push(400, 4));
+  popExpect(400, 2);
+  popExpect(200, 3);
+  popExpect(400, 4);
+}
+
+static void test_slot_table_limit() {
+  for (uint32_t i = 1; i <= FRAME_RING_MAX_SLOTS; i++) TEST_ASSERT_TRUE(push(10, i));
+  TEST_ASSERT_NULL(ring.reserve(10)); // bytes to spare, but no slot
+  popExpect(10, 1);
+  TEST_ASSERT_TRUE(push(10, FRAME_RING_MAX_SLOTS + 1));
+  for (uint32_t i = 2; i <= FRAME_RING_MAX_SLOTS + 1; i++) popExpect(10, i);
+}
+
+// Random sizes, pushes and pops against a FIFO model: every frame that was
+// accepted comes back whole and in order, and a refusal only happens when
+// the ring is really out of slots or contiguous space
+static void test_random_traffic_against_model() {
+  attach(64 * 1024);
+  struct Frame {
+    uint32_t len, seq;
+  };
+  std::deque<Frame> model;
+  uint32_t seq = 0, refused = 0;
+  for (int step = 0; step < 200000; step++) {
+    if (next() % 100 < 55) {
+      uint32_t len = 1 + next() % (next() % 8 ? 4000 : 20000);
+      seq++;
+      if (push(len, seq)) {
+        model.push_back({len, seq});
+      } else {
+        refused++;
+        size_t used = 0;
+        for (const Frame &f : model) used += f.len;
+        TEST_ASSERT_FALSE(model.empty());
+        TEST_ASSERT_TRUE(model.size() == FRAME_RING_MAX_SLOTS || buffer.size() - used < 2 * len + 20000);
+      }
+    } else if (!model.empty()) {
+      popExpect(model.front().len, model.front().seq);
+      model.pop_front();
+    }
+    TEST_ASSERT_EQUAL(model.size(), ring.count());
+  }
+  TEST_ASSERT_GREATER_THAN(0, refused);
+  while (!model.empty()) {
+    popExpect(model.front().len, model.front().seq);
+    model.pop_front();
+  }
+}
+
+// ============================================
+// Burst session against a slow card
+// ============================================
+struct BurstRun {
+  uint32_t captured, written, dropped, maxPending;
+  uint32_t pagesPerMinute;
+};
+
+// `minutes` of cadence capture; each SD write takes `writeMs` plus a stall
+// of `stallMs` every `stallEvery` writes (FAT allocation, wear levelling)
+static BurstRun burst(size_t ringBytes, uint32_t minutes, uint32_t writeMs, uint32_t stallEvery,
+                      uint32_t stallMs) {
+  attach(ringBytes);
+  BurstRun r = {};
+  uint32_t now = 0, nextCapture = 0, writerBusyUntil = 0, seq = 0, writes = 0;
+  bool writing = false;
+  FrameSlot inFlight = {};
+  const uint32_t end = minutes * 60000;
+  while (now < end) {
+    // Writer: finishes the page in flight, then takes the oldest
+    if (writing && now >= writerBusyUntil) {
+      popExpect(inFlight.len, inFlight.seq);
+      r.written++;
+      writing = false;
+    }
+    if (!writing && ring.peek(&inFlight)) {
+      writes++;
+      writerBusyUntil = now + writeMs + (stallEvery && writes % stallEvery == 0 ? stallMs : 0);
+      writing = true;
+    }
+    // Camera: a UXGA page of 250-450 KB at the cadence
+    if (now >= nextCapture) {
+      uint32_t len = 250 * 1024 + next() % (200 * 1024);
+      if (push(len, ++seq)) {
+        r.captured++;
+      } else {
+        r.dropped++;
+      }
+      nextCapture += BURST_INTERVAL_MS;
+    }
+    if (ring.count() > r.maxPending) r.maxPending = ring.count();
+    now += 10;
+  }
+  r.pagesPerMinute = r.written / minutes;
+  return r;
+}
+
+static void report(const char *name, const BurstRun &r) {
+  char line[160];
+  snprintf(line, sizeof(line), "%-26s %lu captured, %lu written (%lu/min), %lu dropped, %lu pending max", name,
+           (unsigned long)r.captured, (unsigned long)r.written, (unsigned long)r.pagesPerMinute,
+           (unsigned long)r.dropped, (unsigned long)r.maxPending);
+  TEST_MESSAGE(line);
+}
+
+static void test_burst_against_slow_card() {
+  const uint32_t perMinute = 60000 / BURST_INTERVAL_MS;
+
+  // Card keeps up on average but stalls for 6 s every 20 pages: the ring
+  // absorbs the stalls, nothing is dropped, the writer holds the cadence
+  BurstRun r = burst(BURST_RING_MIN_BYTES * 4, 5, 900, 20, 6000);
+  report("4 MB ring, 6 s stalls", r);
+  TEST_ASSERT_EQUAL_UINT32(0, r.dropped);
+  TEST_ASSERT_UINT_WITHIN(2, perMinute, r.pagesPerMinute);
+
+  // The minimum ring only holds a few pages: the same stalls cost pages
+  r = burst(BURST_RING_MIN_BYTES, 5, 900, 20, 6000);
+  report("1 MB ring, 6 s stalls", r);
+  TEST_ASSERT_GREATER_THAN(0, r.dropped);
+
+  // A card slower than the cadence: the writer runs flat out, drops cap
+  // the backlog, and the ring never loses an accepted page
+  r = burst(BURST_RING_MIN_BYTES * 4, 5, 2000, 0, 0);
+  report("4 MB ring, 2 s writes", r);
+  TEST_ASSERT_UINT_WITHIN(1, 30, r.pagesPerMinute);
+  TEST_ASSERT_GREATER_THAN(0, r.dropped);
+  TEST_ASSERT_UINT_WITHIN(1, r.captured, r.written + ring.count());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_order);
+  RUN_TEST(test_refuses_bad_sizes_and_detached);
+  RUN_TEST(test_empty_ring_restarts_at_front);
+  RUN_TEST(test_uncommitted_reserve_is_forgotten);
+  RUN_TEST(test_wraps_past_the_end_gap);
+  RUN_TEST(test_full_buffer_refuses_without_damage);
+  RUN_TEST(test_slot_table_limit);
+  RUN_TEST(test_random_traffic_against_model);
+  RUN_TEST(test_burst_against_slow_card);
+  return UNITY_END();
+}
@@ -0,0 +1,327 @@
+// ============================================
+// Gallery tests (pio test -e native -f test_gallery -v)
+// The gallery opened through a scan index over a fake card whose directory
+// behaves like FAT's: a new file takes the first free slot, so once scans
+// have been uploaded and deleted, directory order is no longer queue
+// order. Checks the order and which scans survive the entry cap, the
+// thumbnail cache, and times opening a 500-scan queue.
+// ============================================
+
+#include "storage/scan_index.h"
+#include "ui/gallery.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+// ============================================
+// Fake card
+// ============================================
+struct Record {
+  ScanOp op;
+  uint32_t gen, key, size, crc, floor;
+  std::string name;
+};
+
+class FakeCard : public GalleryStore, public ScanJournal {
+public:
+  std::vector<std::string> slots;   // directory entries; "" = free
+  std::vector<uint32_t> thumbs;
+  std::vector<Record> journalRecords;
+  uint32_t listings = 0, thumbReads = 0;
+  bool unreadable = false;
+
+  void write(const std::string &name) {
+    for (auto &s : slots) {
+      if (s.empty()) {
+        s = name;
+        return;
+      }
+    }
+    slots.push_back(name);
+  }
+  void erase(const std::string &name) {
+    for (auto &s : slots)
+      if (s == name) s.clear();
+  }
+
+  bool list(void (*fn)(void *ctx, const char *name), void *ctx) override {
+    if (unreadable) return false;
+    listings++;
+    for (auto &s : slots)
+      if (!s.empty()) fn(ctx, s.c_str());
+    return true;
+  }
+  bool listThumbs(void (*fn)(void *ctx, uint32_t key), void *ctx) override {
+    for (uint32_t k : thumbs) fn(ctx, k);
+    return !thumbs.empty();
+  }
+  int32_t readThumb(uint32_t key, uint8_t *buf, size_t cap) override {
+    thumbReads++;
+    for (uint32_t k : thumbs) {
+      if (k == key) {
+        memcpy(buf, &key, sizeof(key));
+        return sizeof(key);
+      }
+    }
+    return -1;
+  }
+
+  bool replay(void (*fn)(void *ctx, const ScanRecord &r), void *ctx) override {
+    if (unreadable) return false;
+    for (const Record &rec : journalRecords) {
+      ScanRecord r = {rec.op, rec.gen, rec.key, rec.name.c_str(), rec.size, rec.crc, rec.floor};
+      fn(ctx, r);
+    }
+    return true;
+  }
+  bool append(const ScanRecord &r) override {
+    journalRecords.push_back({r.op, r.gen, r.key, r.size, r.crc, r.floor, r.name ? r.name : ""});
+    return true;
+  }
+  bool rewrite(bool (*next)(void *ctx, ScanRecord *r), void *ctx) override {
+    std::vector<Record> out;
+    ScanRecord r;
+    while (next(ctx, &r)) out.push_back({r.op, r.gen, r.key, r.size, r.crc, r.floor, r.name ? r.name : ""});
+    journalRecords.swap(out);
+    return true;
+  }
+};
+
+static FakeCard *card;
+static ScanIndex *index_;
+static std::vector<std::string> queued; // oldest first, as the firmware queued them
+static uint32_t serial = 0;
+
+// What the firmware does on a save, a sidecar and an upload
+static std::string queueScan(bool withThumb) {
+  char name[GALLERY_NAME_MAX];
+  snprintf(name, sizeof(name), "scan_%lu_%lu.jpg", (unsigned long)(next() % 100000),
+           (unsigned long)++serial);
+  card->write(name);
+  index_->add(name, 1000 + next() % 1000, next());
+  if (withThumb) {
+    card->thumbs.push_back(galleryKey(name));
+    index_->setThumb(name);
+  }
+  queued.push_back(name);
+  return name;
+}
+
+static void uploadScan(size_t i) {
+  card->erase(queued[i]);
+  index_->remove(queued[i].c_str());
+  queued.erase(queued.begin() + i);
+}
+
+static const uint16_t MAX_SCANS = 4096;
+static ScanEntry scanEntries[MAX_SCANS];
+static uint32_t scanKeys[MAX_SCANS];
+static GalleryEntry entries[GALLERY_MAX_ENTRIES];
+static uint16_t thumbPx[8 * GALLERY_THUMB_W * GALLERY_THUMB_H];
+static uint8_t fileBuf[GALLERY_FILE_MAX];
+
+// Decoded thumbnail: the key read from the sidecar, in every pixel
+static uint32_t decodes = 0;
+static bool decodeThumb(void *ctx, const uint8_t *jpg, size_t len, uint16_t *px) {
+  decodes++;
+  if (len != sizeof(uint32_t)) return false;
+  uint32_t key;
+  memcpy(&key, jpg, sizeof(key));
+  for (int i = 0; i < GALLERY_THUMB_W * GALLERY_THUMB_H; i++) px[i] = (uint16_t)key;
+  return true;
+}
+
+static void freshCard() {
+  delete index_;
+  delete card;
+  card = new FakeCard();
+  index_ = new ScanIndex();
+  TEST_ASSERT_TRUE(index_->attach(card, card, scanEntries, scanKeys, MAX_SCANS));
+  queued.clear();
+}
+
+void setUp() {
+  rng = 1;
+  serial = 0;
+  decodes = 0;
+  freshCard();
+}
+void tearDown() {}
+
+static void assertNewestFirst(const Gallery &g, size_t expect) {
+  TEST_ASSERT_EQUAL(expect, g.count());
+  for (uint16_t i = 0; i < g.count(); i++) {
+    TEST_ASSERT_EQUAL_STRING(queued[queued.size() - 1 - i].c_str(), g.entry(i).name);
+    TEST_ASSERT_EQUAL_UINT32(galleryKey(g.entry(i).name), g.entry(i).key);
+  }
+}
+
+// ============================================
+// Order
+// ============================================
+static void test_order_survives_slot_reuse() {
+  for (int i = 0; i < 60; i++) queueScan(i % 3 != 0);
+  // Upload the oldest 20 and a few from the middle, then queue more: the
+  // new files land in the freed slots at the front of the directory
+  for (int i = 0; i < 20; i++) uploadScan(0);
+  uploadScan(10);
+  uploadScan(15);
+  for (int i = 0; i < 30; i++) queueScan(true);
+  TEST_ASSERT_EQUAL_STRING(queued[queued.size() - 30].c_str(), card->slots[0].c_str());
+
+  Gallery g;
+  TEST_ASSERT_TRUE(g.attach(entries, GALLERY_MAX_ENTRIES, thumbPx, 8, fileBuf));
+  TEST_ASSERT_TRUE(g.open(*index_));
+  assertNewestFirst(g, queued.size());
+  TEST_ASSERT_EQUAL(0, g.stats().dropped);
+  uint16_t withThumb = 0;
+  for (uint16_t i = 0; i < g.count(); i++) {
+    bool has = false;
+    for (uint32_t k : card->thumbs) has |= k == g.entry(i).key;
+    TEST_ASSERT_EQUAL(has, g.entry(i).hasThumb);
+    withThumb += has;
+  }
+  TEST_ASSERT_EQUAL(withThumb, g.stats().withThumb);
+}
+
+// More scans than entries: the newest are kept, whatever slots they took
+static void test_cap_keeps_newest() {
+  const uint16_t cap = 50;
+  for (int i = 0; i < 100; i++) queueScan(false);
+  for (int i = 0; i < 40; i++) uploadScan(next() % queued.size());
+  for (int i = 0; i < 40; i++) queueScan(false);
+
+  Gallery g;
+  TEST_ASSERT_TRUE(g.attach(entries, cap, thumbPx, 8, fileBuf));
+  TEST_ASSERT_TRUE(g.open(*index_));
+  assertNewestFirst(g, cap);
+  TEST_ASSERT_EQUAL(queued.size() - cap, g.stats().dropped);
+
+  // Queue changes between opens show up in the next one
+  uploadScan(queued.size() - 1);
+  queueScan(false);
+  queueScan(false);
+  TEST_ASSERT_TRUE(g.open(*index_));
+  assertNewestFirst(g, cap);
+}
+
+// Files the journal never saw (older firmware) still open, after the
+// journalled ones
+static void test_unjournalled_files_and_errors() {
+  card->write("old_a.jpg");
+  card->write("old_b.jpg");
+  Gallery g;
+  TEST_ASSERT_TRUE(g.attach(entries, GALLERY_MAX_ENTRIES, thumbPx, 8, fileBuf));
+  TEST_ASSERT_TRUE(g.open(*index_));
+  TEST_ASSERT_EQUAL(2, g.count());
+  TEST_ASSERT_EQUAL_STRING("old_b.jpg", g.entry(0).name);
+  queueScan(false);
+  TEST_ASSERT_TRUE(g.open(*index_));
+  TEST_ASSERT_EQUAL(3, g.count());
+  TEST_ASSERT_EQUAL_STRING(queued.back().c_str(), g.entry(0).name);
+
+  freshCard();
+  card->unreadable = true;
+  TEST_ASSERT_FALSE(g.open(*index_));
+  TEST_ASSERT_EQUAL(0, g.count());
+  TEST_ASSERT_FALSE(g.attach(entries, 0, thumbPx, 8, fileBuf));
+  TEST_ASSERT_FALSE(g.attach(entries, 10, thumbPx, 8, nullptr));
+}
+
+// ============================================
+// Thumbnails
+// ============================================
+static void test_thumbnail_cache() {
+  for (int i = 0; i < 20; i++) queueScan(i != 5);
+  card->thumbs.push_back(0x12345678); // stray sidecar
+  Gallery g;
+  TEST_ASSERT_TRUE(g.attach(entries, GALLERY_MAX_ENTRIES, thumbPx, 4, fileBuf));
+  TEST_ASSERT_TRUE(g.open(*index_));
+
+  for (uint16_t i = 0; i < 4; i++) {
+    const uint16_t *px = g.thumb(i, *card, decodeThumb, nullptr);
+    TEST_ASSERT_NOT_NULL(px);
+    TEST_ASSERT_EQUAL_HEX16((uint16_t)g.entry(i).key, px[GALLERY_THUMB_W * GALLERY_THUMB_H - 1]);
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, decodes);
+  for (uint16_t i = 0; i < 4; i++) TEST_ASSERT_NOT_NULL(g.thumb(i, *card, decodeThumb, nullptr));
+  TEST_ASSERT_EQUAL_UINT32(4, decodes);
+  TEST_ASSERT_EQUAL_UINT32(4, g.stats().hits);
+
+  // A fifth evicts the least recently used (entry 0); entry 1 stays
+  g.thumb(1, *card, decodeThumb, nullptr);
+  g.thumb(4, *card, decodeThumb, nullptr);
+  TEST_ASSERT_EQUAL_UINT32(1, g.stats().evictions);
+  g.thumb(1, *card, decodeThumb, nullptr);
+  TEST_ASSERT_EQUAL_UINT32(5, decodes);
+  g.thumb(0, *card, decodeThumb, nullptr);
+  TEST_ASSERT_EQUAL_UINT32(6, decodes);
+
+  // No sidecar: never read
+  uint16_t none = (uint16_t)(queued.size() - 1 - 5);
+  TEST_ASSERT_FALSE(g.entry(none).hasThumb);
+  uint32_t reads = card->thumbReads;
+  TEST_ASSERT_NULL(g.thumb(none, *card, decodeThumb, nullptr));
+  TEST_ASSERT_EQUAL_UINT32(reads, card->thumbReads);
+
+  // A sidecar gone from the card fails once, then is not retried
+  card->thumbs.erase(card->thumbs.begin() + 10);
+  uint16_t gone = 0;
+  while (g.entry(gone).key != galleryKey(queued[11].c_str())) gone++;
+  TEST_ASSERT_NULL(g.thumb(gone, *card, decodeThumb, nullptr));
+  TEST_ASSERT_NULL(g.thumb(gone, *card, decodeThumb, nullptr));
+  TEST_ASSERT_EQUAL_UINT32(1, g.stats().failures);
+  TEST_ASSERT_NULL(g.thumb(g.count(), *card, decodeThumb, nullptr));
+}
+
+// ============================================
+// Cost
+// ============================================
+static void test_open_500_scans() {
+  for (int i = 0; i < 520; i++) queueScan(true);
+  for (int i = 0; i < 20; i++) uploadScan(next() % queued.size());
+  Gallery g;
+  TEST_ASSERT_TRUE(g.attach(entries, GALLERY_MAX_ENTRIES, thumbPx, 8, fileBuf));
+
+  // Rebooted: the first open replays the journal and lists the card once
+  ScanIndex *rebooted = new ScanIndex();
+  TEST_ASSERT_TRUE(rebooted->attach(card, card, scanEntries, scanKeys, MAX_SCANS));
+  delete index_;
+  index_ = rebooted;
+
+  auto t0 = std::chrono::steady_clock::now();
+  TEST_ASSERT_TRUE(g.open(*index_));
+  auto t1 = std::chrono::steady_clock::now();
+  const int OPENS = 200;
+  for (int i = 0; i < OPENS; i++) TEST_ASSERT_TRUE(g.open(*index_));
+  auto t2 = std::chrono::steady_clock::now();
+
+  assertNewestFirst(g, 500);
+  TEST_ASSERT_EQUAL_UINT32(1, card->listings);
+  TEST_ASSERT_EQUAL(500, g.stats().withThumb);
+  double first = std::chrono::duration<double, std::micro>(t1 - t0).count();
+  double later = std::chrono::duration<double, std::micro>(t2 - t1).count() / OPENS;
+  char line[120];
+  snprintf(line, sizeof(line), "500 scans: first open %.0f us (journal + 1 listing), then %.1f us, 0 listings",
+           first, later);
+  TEST_MESSAGE(line);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_order_survives_slot_reuse);
+  RUN_TEST(test_cap_keeps_newest);
+  RUN_TEST(test_unjournalled_files_and_errors);
+  RUN_TEST(test_thumbnail_cache);
+  RUN_TEST(test_open_500_scans);
+  return UNITY_END();
+}
@@ -0,0 +1,374 @@
+// ============================================
+// HTTP server tests (pio test -e native -f test_http_server -v)
+// The server on a loopback socket, driven the way the firmware drives it:
+// poll() for the server task's passes, dispatch() for loop(). Requests
+// split across reads, oversized and malformed ones, prefix routes, HEAD on
+// GET routes, the cap on connections held by streams, and stalled clients.
+// ============================================
+
+#include "net/http_server.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static HttpServer server;
+static uint16_t port;
+
+// ============================================
+// Routes
+// ============================================
+static const char *const COLLECT[] = {"X-Token"};
+
+static void handleEcho() {
+  String body = String(server.method() == HTTP_POST ? "POST " : "GET ");
+  std::string s = std::string(body.c_str()) + server.uri().c_str();
+  const char *names[] = {"a", "b", "c"};
+  for (const char *n : names) {
+    if (server.hasArg(n)) s += std::string(" ") + n + "=" + server.arg(n).c_str();
+  }
+  if (server.header("x-token").length()) s += std::string(" token=") + server.header("X-Token").c_str();
+  server.send(200, "text/plain", String(s.c_str()));
+}
+
+static void handleGet() { server.send(200, "text/plain", String("hello")); }
+static void handlePost() { server.send(200, "text/plain", String("posted")); }
+static void handleFiles() { server.send(200, "text/plain", server.uri()); }
+static const uint8_t PAGE[] = "<html>flash</html>";
+static void handleStatic() { server.sendStatic(200, "text/html", PAGE, sizeof(PAGE) - 1); }
+static void handleSilent() {}
+
+// Open-ended (a live view) or with a length (a file)
+class TestStream : public HttpStream {
+public:
+  const char *data = "";
+  size_t at[HTTP_MAX_CLIENTS] = {};
+  bool sized = false;
+  int opens = 0, closes = 0;
+
+  bool open(uint8_t client) override {
+    opens++;
+    at[client] = 0;
+    return true;
+  }
+  void close(uint8_t client) override { closes++; }
+  size_t peek(uint8_t client, const uint8_t **p) override {
+    *p = (const uint8_t *)data + at[client];
+    return strlen(data) - at[client];
+  }
+  void consume(uint8_t client, size_t n) override { at[client] += n; }
+  bool done(uint8_t client) override { return sized && at[client] == strlen(data); }
+};
+static TestStream live, file;
+
+static void handleLive() {
+  if (!server.sendStream("text/plain", &live)) server.send(503, "text/plain", String("full"));
+}
+static void handleFile() {
+  if (!server.sendStream(200, "application/octet-stream", (uint32_t)strlen(file.data), &file))
+    server.send(503, "text/plain", String("full"));
+}
+
+// ============================================
+// Client side
+// ============================================
+static void pump(int passes = 4) {
+  for (int i = 0; i < passes; i++) {
+    server.poll(1);
+    server.dispatch();
+  }
+}
+
+static int connectClient() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  TEST_ASSERT_EQUAL(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  pump(1); // accepted
+  return fd;
+}
+
+static void sendRaw(int fd, const std::string &s) {
+  TEST_ASSERT_EQUAL((long)s.size(), (long)::send(fd, s.data(), s.size(), MSG_NOSIGNAL));
+}
+
+// Everything up to the server closing the connection
+static std::string readAll(int fd, int maxPasses = 200) {
+  std::string out;
+  char buf[4096];
+  for (int i = 0; i < maxPasses; i++) {
+    pump(1);
+    for (;;) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n > 0) {
+        out.append(buf, n);
+        continue;
+      }
+      if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        close(fd);
+        return out;
+      }
+      break;
+    }
+  }
+  close(fd);
+  return out + "<open>";
+}
+
+// What has arrived so far, leaving the connection open
+static std::string readSome(int fd) {
+  std::string out;
+  char buf[4096];
+  for (int i = 0; i < 20; i++) {
+    pump(1);
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) out.append(buf, n);
+  }
+  return out;
+}
+
+static std::string request(const std::string &raw) {
+  int fd = connectClient();
+  sendRaw(fd, raw);
+  return readAll(fd);
+}
+
+static int status(const std::string &r) { return r.size() > 12 ? atoi(r.c_str() + 9) : 0; }
+static std::string body(const std::string &r) {
+  size_t at = r.find("\r\n\r\n");
+  return at == std::string::npos ? "" : r.substr(at + 4);
+}
+
+static HttpServerStats stats() {
+  HttpServerStats st;
+  server.getStats(&st);
+  return st;
+}
+
+void setUp() { rng = 1; }
+void tearDown() {
+  pump(2);
+  TEST_ASSERT_EQUAL(0, stats().active);
+}
+
+// ============================================
+// Requests
+// ============================================
+static void test_routes_args_and_headers() {
+  std::string r = request("GET /echo?a=1+2&b=%41%2f&c HTTP/1.1\r\nHost: x\r\nx-token:  abc\r\n\r\n");
+  TEST_ASSERT_EQUAL(200, status(r));
+  TEST_ASSERT_EQUAL_STRING("GET /echo a=1 2 b=A/ c= token=abc", body(r).c_str());
+  TEST_ASSERT_TRUE(r.find("Content-Length: 33\r\n") != std::string::npos);
+  TEST_ASSERT_TRUE(r.find("Connection: close\r\n") != std::string::npos);
+
+  r = request("POST /echo?a=q HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+              "Content-Length: 7\r\n\r\nb=2&c=3");
+  TEST_ASSERT_EQUAL_STRING("POST /echo a=q b=2 c=3", body(r).c_str());
+  // Only a form body becomes args
+  r = request("POST /echo HTTP/1.1\r\nContent-Type: text/plain\r\nContent-Length: 3\r\n\r\na=7");
+  TEST_ASSERT_EQUAL_STRING("POST /echo", body(r).c_str());
+
+  uint32_t missing = stats().notFound;
+  TEST_ASSERT_EQUAL(404, status(request("GET /nope HTTP/1.1\r\n\r\n")));
+  TEST_ASSERT_EQUAL(500, status(request("GET /silent HTTP/1.1\r\n\r\n")));
+  TEST_ASSERT_EQUAL(400, status(request("BREW /echo HTTP/1.1\r\n\r\n")));
+  TEST_ASSERT_EQUAL(400, status(request("GET\r\n\r\n")));
+  TEST_ASSERT_EQUAL_UINT32(missing + 1, stats().notFound);
+}
+
+// The same request cut at every byte, and at random places
+static void test_split_requests() {
+  const std::string raw = "POST /echo?a=1 HTTP/1.1\r\nX-Token: t\r\nContent-Type: "
+                          "application/x-www-form-urlencoded\r\nContent-Length: 3\r\n\r\nb=9";
+  for (size_t cut = 1; cut < raw.size(); cut++) {
+    int fd = connectClient();
+    sendRaw(fd, raw.substr(0, cut));
+    pump(2);
+    TEST_ASSERT_EQUAL(1, stats().active); // still reading, nothing answered
+    sendRaw(fd, raw.substr(cut));
+    std::string r = readAll(fd);
+    TEST_ASSERT_EQUAL_STRING("POST /echo a=1 b=9 token=t", body(r).c_str());
+  }
+  for (int i = 0; i < 20; i++) {
+    int fd = connectClient();
+    for (size_t at = 0; at < raw.size();) {
+      size_t n = 1 + next() % 6;
+      sendRaw(fd, raw.substr(at, n));
+      at += n;
+      pump(1);
+    }
+    TEST_ASSERT_EQUAL_STRING("POST /echo a=1 b=9 token=t", body(readAll(fd)).c_str());
+  }
+}
+
+static void test_oversized_requests() {
+  uint32_t rejected = stats().rejected;
+  // Headers that never end within HTTP_RX_BYTES
+  std::string big = "GET /echo HTTP/1.1\r\nX-Pad: " + std::string(HTTP_RX_BYTES, 'p');
+  int fd = connectClient();
+  sendRaw(fd, big.substr(0, HTTP_RX_BYTES + 1));
+  TEST_ASSERT_EQUAL(431, status(readAll(fd)));
+
+  // A body that would not fit: refused on the headers, before it is sent
+  std::string r = request("POST /echo HTTP/1.1\r\nContent-Length: " +
+                          std::to_string(HTTP_RX_BYTES) + "\r\n\r\n");
+  TEST_ASSERT_EQUAL(413, status(r));
+  r = request("POST /echo HTTP/1.1\r\nContent-Length: 4294967295\r\n\r\n");
+  TEST_ASSERT_EQUAL(413, status(r));
+  TEST_ASSERT_EQUAL_UINT32(rejected + 3, stats().rejected);
+
+  // Exactly what fits is fine, one byte more is not
+  std::string head = "POST /echo HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: ";
+  size_t room = HTTP_RX_BYTES - head.size() - 4 - 4; // 4 digits, blank line
+  std::string form = "a=" + std::string(room - 2, 'z');
+  r = request(head + std::to_string(room) + "\r\n\r\n" + form);
+  TEST_ASSERT_EQUAL(200, status(r));
+  TEST_ASSERT_EQUAL(room + 11, body(r).size()); // "POST /echo a=" + zs
+  r = request(head + std::to_string(room + 1) + "\r\n\r\n");
+  TEST_ASSERT_EQUAL(413, status(r));
+}
+
+static void test_content_length_must_be_a_number() {
+  const char *bad[] = {"abc", "12abc", "-1", "", " ", "+5", "0x10", "99999999999999999999"};
+  for (const char *v : bad) {
+    std::string r = request(std::string("POST /echo HTTP/1.1\r\nContent-Length: ") + v + "\r\n\r\n");
+    TEST_ASSERT_EQUAL(400, status(r));
+  }
+  std::string r = request("POST /echo HTTP/1.1\r\ncontent-length:\t 3 \r\nContent-Type: "
+                          "application/x-www-form-urlencoded\r\n\r\na=5");
+  TEST_ASSERT_EQUAL_STRING("POST /echo a=5", body(r).c_str());
+}
+
+static void test_prefix_routes_and_methods() {
+  std::string r = request("GET /files/a/b.jpg?x=1 HTTP/1.1\r\n\r\n");
+  TEST_ASSERT_EQUAL(200, status(r));
+  TEST_ASSERT_EQUAL_STRING("/files/a/b.jpg", body(r).c_str());
+  TEST_ASSERT_EQUAL_STRING("/files/", body(request("GET /files/ HTTP/1.1\r\n\r\n")).c_str());
+  TEST_ASSERT_EQUAL(404, status(request("GET /filesX HTTP/1.1\r\n\r\n")));
+  TEST_ASSERT_EQUAL(404, status(request("GET /files HTTP/1.1\r\n\r\n")));
+
+  // HEAD on a GET route: the GET's headers, no body
+  r = request("HEAD /get HTTP/1.1\r\n\r\n");
+  TEST_ASSERT_EQUAL(200, status(r));
+  TEST_ASSERT_TRUE(r.find("Content-Length: 5\r\n") != std::string::npos);
+  TEST_ASSERT_EQUAL_STRING("", body(r).c_str());
+  TEST_ASSERT_EQUAL_STRING("hello", body(request("GET /get HTTP/1.1\r\n\r\n")).c_str());
+  r = request("HEAD /static HTTP/1.1\r\n\r\n");
+  TEST_ASSERT_TRUE(r.find("Content-Length: 18\r\n") != std::string::npos);
+  TEST_ASSERT_EQUAL_STRING("", body(r).c_str());
+  TEST_ASSERT_EQUAL_STRING("<html>flash</html>", body(request("GET /static HTTP/1.1\r\n\r\n")).c_str());
+  // ...but not on a POST-only route, nor POST on a GET route
+  TEST_ASSERT_EQUAL(404, status(request("HEAD /post HTTP/1.1\r\n\r\n")));
+  TEST_ASSERT_EQUAL(404, status(request("POST /get HTTP/1.1\r\n\r\n")));
+  TEST_ASSERT_EQUAL_STRING("posted", body(request("POST /post HTTP/1.1\r\n\r\n")).c_str());
+
+  // HEAD on a sized stream: its length, and the stream never opened
+  file.data = "0123456789";
+  file.sized = true;
+  int opens = file.opens;
+  r = request("HEAD /file HTTP/1.1\r\n\r\n");
+  TEST_ASSERT_TRUE(r.find("Content-Length: 10\r\n") != std::string::npos);
+  TEST_ASSERT_EQUAL_STRING("", body(r).c_str());
+  TEST_ASSERT_EQUAL(opens, file.opens);
+  r = request("GET /file HTTP/1.1\r\n\r\n");
+  TEST_ASSERT_EQUAL_STRING("0123456789", body(r).c_str());
+  TEST_ASSERT_EQUAL(opens + 1, file.opens);
+  TEST_ASSERT_EQUAL(file.opens, file.closes);
+}
+
+// ============================================
+// Streams
+// ============================================
+static void test_streams_leave_request_slots() {
+  const int cap = HTTP_MAX_CLIENTS - HTTP_REQUEST_SLOTS;
+  live.data = "frame";
+  int fds[cap];
+  for (int i = 0; i < cap; i++) {
+    fds[i] = connectClient();
+    sendRaw(fds[i], "GET /live HTTP/1.1\r\n\r\n");
+    std::string r = readSome(fds[i]);
+    TEST_ASSERT_EQUAL(200, status(r));
+    TEST_ASSERT_EQUAL_STRING("frame", body(r).c_str());
+    TEST_ASSERT_TRUE(r.find("Content-Length") == std::string::npos);
+  }
+  TEST_ASSERT_EQUAL(cap, stats().streaming);
+
+  // One more stream is refused, sized or not; ordinary requests still run
+  uint32_t full = stats().streamsFull;
+  TEST_ASSERT_EQUAL(503, status(request("GET /live HTTP/1.1\r\n\r\n")));
+  TEST_ASSERT_EQUAL(503, status(request("GET /file HTTP/1.1\r\n\r\n")));
+  TEST_ASSERT_EQUAL_UINT32(full + 2, stats().streamsFull);
+  TEST_ASSERT_EQUAL(cap, live.opens);
+  int a = connectClient(), b = connectClient();
+  sendRaw(a, "GET /get HTTP/1.1\r\n\r\n");
+  sendRaw(b, "GET /get HTTP/1.1\r\n\r\n");
+  TEST_ASSERT_EQUAL_STRING("hello", body(readAll(a)).c_str());
+  TEST_ASSERT_EQUAL_STRING("hello", body(readAll(b)).c_str());
+
+  // A viewer leaving frees its slot for the next stream
+  close(fds[0]);
+  pump(3);
+  TEST_ASSERT_EQUAL(1, live.closes);
+  fds[0] = connectClient();
+  sendRaw(fds[0], "GET /live HTTP/1.1\r\n\r\n");
+  TEST_ASSERT_EQUAL(200, status(readSome(fds[0])));
+  for (int fd : fds) close(fd);
+  pump(3);
+  TEST_ASSERT_EQUAL(live.opens, live.closes);
+}
+
+// Last: moves to the simulated clock
+static void test_stalled_client_is_dropped() {
+  hostClockSet(1000);
+  int fd = connectClient();
+  sendRaw(fd, "GET /echo HTTP/1.1\r\n");
+  pump(2);
+  TEST_ASSERT_EQUAL(1, stats().active);
+  hostClockAdvance(HTTP_CLIENT_TIMEOUT_MS);
+  pump(2);
+  TEST_ASSERT_EQUAL(1, stats().active);
+  uint32_t timeouts = stats().timeouts;
+  hostClockAdvance(1);
+  pump(2);
+  TEST_ASSERT_EQUAL_UINT32(timeouts + 1, stats().timeouts);
+  TEST_ASSERT_EQUAL_STRING("", readAll(fd).c_str());
+}
+
+int main() {
+  server.on("/echo", handleEcho);
+  server.on("/get", HTTP_GET, handleGet);
+  server.on("/post", HTTP_POST, handlePost);
+  server.on("/files/*", handleFiles);
+  server.on("/static", HTTP_GET, handleStatic);
+  server.on("/silent", handleSilent);
+  server.on("/live", HTTP_GET, handleLive);
+  server.on("/file", HTTP_GET, handleFile);
+  server.collectHeaders(COLLECT, 1);
+  for (port = 18080 + getpid() % 1000; !server.begin(port); port++) {
+  }
+
+  UNITY_BEGIN();
+  RUN_TEST(test_routes_args_and_headers);
+  RUN_TEST(test_split_requests);
+  RUN_TEST(test_oversized_requests);
+  RUN_TEST(test_content_length_must_be_a_number);
+  RUN_TEST(test_prefix_routes_and_methods);
+  RUN_TEST(test_streams_leave_request_slots);
+  RUN_TEST(test_stalled_client_is_dropped);
+  return UNITY_END();
+}
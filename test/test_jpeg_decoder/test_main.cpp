@@ -0,0 +1,534 @@
+// ============================================
+// JPEG decoder tests (pio test -e native -f test_jpeg_decoder)
+// Images built by a small baseline encoder in this file (float FDCT,
+// flat canonical Huffman tables) and decoded at every scale, compared with
+// a float IDCT + colour conversion of the same coefficients. Then the
+// header checks: over-subscribed or random DHTs, scans referring to tables
+// this image never defined (the decoder keeps the previous frame's), and
+// truncated or corrupted entropy data.
+// ============================================
+
+#include "imaging/jpeg_decoder.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static const uint8_t ZZ[64] = {
+   0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+static JpegDecoder dec;
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+// ============================================
+// Test-side encoder
+// ============================================
+// DC: categories 0-11, all 4-bit codes. AC: EOB, ZRL and every run/size
+// with size 1-10, all 8-bit codes. Both complete and easy to emit.
+static uint8_t acSymbols[162];
+static uint8_t acCode[256];
+
+static void buildAcTable() {
+  int n = 0;
+  acSymbols[n++] = 0x00;
+  acSymbols[n++] = 0xF0;
+  for (int r = 0; r < 16; r++)
+    for (int s = 1; s <= 10; s++) acSymbols[n++] = (uint8_t)(r << 4 | s);
+  for (int i = 0; i < 162; i++) acCode[acSymbols[i]] = (uint8_t)i;
+}
+
+struct Image {
+  int w, h, comps, hs, vs;
+  std::vector<uint8_t> plane[3]; // source samples, chroma at subsampled size
+  std::vector<double> recon[3];  // float reconstruction (unclamped), padded to whole blocks
+  int pw[3], ph[3];              // plane size padded to whole MCUs
+  int cw[3], ch[3];              // plane size in samples
+};
+
+struct Options {
+  uint16_t restart = 0;
+  bool dqt = true, dht = true;
+  uint8_t quantTables = 2;       // tables defined (chroma uses table 1)
+  uint8_t acTables = 2;
+  const uint8_t *dhtCounts = nullptr; // replaces the DC table's counts
+};
+
+struct Writer {
+  std::vector<uint8_t> out;
+  uint32_t acc = 0;
+  int n = 0;
+  void u8(uint8_t v) { out.push_back(v); }
+  void u16(uint16_t v) { u8(v >> 8), u8(v & 0xFF); }
+  void bits(uint32_t code, int len) {
+    for (int i = len - 1; i >= 0; i--) {
+      acc = acc << 1 | ((code >> i) & 1);
+      if (++n == 8) {
+        u8((uint8_t)acc);
+        if ((uint8_t)acc == 0xFF) u8(0x00);
+        acc = n = 0;
+      }
+    }
+  }
+  void pad() {
+    while (n) bits(1, 1);
+  }
+};
+
+static uint8_t quant[2][64]; // zigzag order
+
+static int category(int v) {
+  int a = v < 0 ? -v : v, s = 0;
+  while (a) a >>= 1, s++;
+  return s;
+}
+
+static void putValue(Writer *w, int v, int s) {
+  if (s) w->bits((uint32_t)(v < 0 ? v + (1 << s) - 1 : v), s);
+}
+
+// FDCT + quantise one block of plane p at (bx, by); stores the float
+// reconstruction and emits the block
+static void encodeBlock(Image *im, int p, int bx, int by, int *pred, Writer *w) {
+  const uint8_t *q = quant[p ? 1 : 0];
+  double f[64];
+  for (int y = 0; y < 8; y++) {
+    for (int x = 0; x < 8; x++) {
+      int sx = bx + x < im->cw[p] ? bx + x : im->cw[p] - 1; // edge replicate
+      int sy = by + y < im->ch[p] ? by + y : im->ch[p] - 1;
+      f[y * 8 + x] = im->plane[p][sy * im->cw[p] + sx] - 128.0;
+    }
+  }
+  int zz[64];
+  for (int k = 0; k < 64; k++) {
+    int u = ZZ[k] % 8, v = ZZ[k] / 8;
+    double sum = 0;
+    for (int y = 0; y < 8; y++)
+      for (int x = 0; x < 8; x++)
+        sum += f[y * 8 + x] * cos((2 * x + 1) * u * M_PI / 16) * cos((2 * y + 1) * v * M_PI / 16);
+    double cu = u ? 1 : M_SQRT1_2, cv = v ? 1 : M_SQRT1_2;
+    zz[k] = (int)lround(0.25 * cu * cv * sum / q[k]);
+  }
+  for (int y = 0; y < 8; y++) {
+    for (int x = 0; x < 8; x++) {
+      double sum = 0;
+      for (int k = 0; k < 64; k++) {
+        int u = ZZ[k] % 8, v = ZZ[k] / 8;
+        double cu = u ? 1 : M_SQRT1_2, cv = v ? 1 : M_SQRT1_2;
+        sum += cu * cv * zz[k] * q[k] * cos((2 * x + 1) * u * M_PI / 16) * cos((2 * y + 1) * v * M_PI / 16);
+      }
+      im->recon[p][(by + y) * im->pw[p] + bx + x] = 0.25 * sum + 128;
+    }
+  }
+
+  int diff = zz[0] - *pred;
+  *pred = zz[0];
+  int s = category(diff);
+  w->bits((uint32_t)s, 4);
+  putValue(w, diff, s);
+  int run = 0;
+  for (int k = 1; k < 64; k++) {
+    if (!zz[k]) {
+      run++;
+      continue;
+    }
+    while (run > 15) w->bits(acCode[0xF0], 8), run -= 16;
+    s = category(zz[k]);
+    w->bits(acCode[run << 4 | s], 8);
+    putValue(w, zz[k], s);
+    run = 0;
+  }
+  if (run) w->bits(acCode[0x00], 8);
+}
+
+static void segment(Writer *w, uint8_t marker, const std::vector<uint8_t> &body) {
+  w->u8(0xFF), w->u8(marker);
+  w->u16((uint16_t)(body.size() + 2));
+  w->out.insert(w->out.end(), body.begin(), body.end());
+}
+
+static std::vector<uint8_t> encode(Image *im, const Options &o = Options()) {
+  Writer w;
+  w.u8(0xFF), w.u8(0xD8);
+  if (o.dqt) {
+    std::vector<uint8_t> b;
+    for (int t = 0; t < o.quantTables; t++) {
+      b.push_back((uint8_t)t);
+      b.insert(b.end(), quant[t], quant[t] + 64);
+    }
+    segment(&w, 0xDB, b);
+  }
+  std::vector<uint8_t> sof = {8, (uint8_t)(im->h >> 8), (uint8_t)im->h, (uint8_t)(im->w >> 8), (uint8_t)im->w,
+                              (uint8_t)im->comps};
+  for (int c = 0; c < im->comps; c++) {
+    sof.push_back((uint8_t)(c + 1));
+    sof.push_back(c ? 0x11 : (uint8_t)(im->hs << 4 | im->vs));
+    sof.push_back(c ? 1 : 0);
+  }
+  segment(&w, 0xC0, sof);
+  if (o.dht) {
+    std::vector<uint8_t> b = {0x00};
+    uint8_t counts[16] = {0, 0, 0, 12};
+    const uint8_t *dc = o.dhtCounts ? o.dhtCounts : counts;
+    int total = 0;
+    for (int i = 0; i < 16; i++) b.push_back(dc[i]), total += dc[i];
+    for (int i = 0; i < total; i++) b.push_back((uint8_t)(i % 12));
+    for (int t = 0; t < o.acTables; t++) {
+      b.push_back((uint8_t)(0x10 | t));
+      uint8_t ac[16] = {0, 0, 0, 0, 0, 0, 0, 162};
+      b.insert(b.end(), ac, ac + 16);
+      b.insert(b.end(), acSymbols, acSymbols + 162);
+    }
+    segment(&w, 0xC4, b);
+  }
+  if (o.restart) segment(&w, 0xDD, {(uint8_t)(o.restart >> 8), (uint8_t)o.restart});
+  std::vector<uint8_t> sos = {(uint8_t)im->comps};
+  for (int c = 0; c < im->comps; c++) {
+    sos.push_back((uint8_t)(c + 1));
+    sos.push_back(c ? 0x01 : 0x00); // chroma: AC table 1
+  }
+  sos.insert(sos.end(), {0, 63, 0});
+  segment(&w, 0xDA, sos);
+
+  const int mcuW = 8 * im->hs, mcuH = 8 * im->vs;
+  const int mcusX = (im->w + mcuW - 1) / mcuW, mcusY = (im->h + mcuH - 1) / mcuH;
+  int pred[3] = {0, 0, 0}, todo = o.restart, rst = 0;
+  for (int my = 0; my < mcusY; my++) {
+    for (int mx = 0; mx < mcusX; mx++) {
+      if (o.restart && todo == 0) {
+        w.pad();
+        w.u8(0xFF), w.u8((uint8_t)(0xD0 + (rst++ & 7)));
+        pred[0] = pred[1] = pred[2] = 0;
+        todo = o.restart;
+      }
+      todo--;
+      for (int by = 0; by < im->vs; by++)
+        for (int bx = 0; bx < im->hs; bx++) encodeBlock(im, 0, mx * mcuW + bx * 8, my * mcuH + by * 8, &pred[0], &w);
+      for (int c = 1; c < im->comps; c++) encodeBlock(im, c, mx * 8, my * 8, &pred[c], &w);
+    }
+  }
+  w.pad();
+  w.u8(0xFF), w.u8(0xD9);
+  return w.out;
+}
+
+// Smooth shading, hard edges and noise
+static Image makeImage(int w, int h, int comps, int hs, int vs) {
+  Image im;
+  im.w = w, im.h = h, im.comps = comps, im.hs = hs, im.vs = vs;
+  const int mcusX = (w + 8 * hs - 1) / (8 * hs), mcusY = (h + 8 * vs - 1) / (8 * vs);
+  for (int p = 0; p < comps; p++) {
+    int sh = p ? hs : 1, sv = p ? vs : 1;
+    im.cw[p] = (w + sh - 1) / sh;
+    im.ch[p] = (h + sv - 1) / sv;
+    im.pw[p] = mcusX * 8 * hs / sh;
+    im.ph[p] = mcusY * 8 * vs / sv;
+    im.plane[p].resize((size_t)im.cw[p] * im.ch[p]);
+    im.recon[p].assign((size_t)im.pw[p] * im.ph[p], 0);
+    for (int y = 0; y < im.ch[p]; y++) {
+      for (int x = 0; x < im.cw[p]; x++) {
+        int v = p ? 128 + (p == 1 ? 40 : -50) * x / im.cw[p] + 20 * y / im.ch[p]
+                  : 40 + 150 * x / im.cw[p] + ((x / 5 + y / 7) % 3 == 0 ? 50 : 0);
+        v += (int)(next() % 9) - 4;
+        im.plane[p][y * im.cw[p] + x] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+      }
+    }
+  }
+  return im;
+}
+
+static void defaultQuant() {
+  for (int k = 0; k < 64; k++) {
+    quant[0][k] = (uint8_t)(2 + k / 3);
+    quant[1][k] = (uint8_t)(3 + k / 2);
+  }
+}
+
+// ============================================
+// Decode and compare
+// ============================================
+struct Capture {
+  const Image *im;
+  uint8_t scale;
+  bool swap;
+  int blocks = 0;
+  double worst = 0, errSum = 0; // per channel, 8-bit units
+  long px = 0;
+  Capture(const Image *image, uint8_t s = 0, bool swapped = false) : im(image), scale(s), swap(swapped) {}
+};
+
+static double clampd(double v) { return v < 0 ? 0 : v > 255 ? 255 : v; }
+
+// Reconstructed sample; at 1/8 scale the decoder keeps only each block's
+// DC, i.e. the block mean
+static double sample(const Image *im, int p, int x, int y, uint8_t scale) {
+  const std::vector<double> &r = im->recon[p];
+  if (scale < 3) return (double)lround(clampd(r[y * im->pw[p] + x]));
+  double sum = 0;
+  for (int j = y & ~7; j < (y & ~7) + 8; j++)
+    for (int i = x & ~7; i < (x & ~7) + 8; i++) sum += r[j * im->pw[p] + i];
+  return (double)lround(clampd(sum / 64));
+}
+
+static bool capture(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *pixels) {
+  Capture *c = (Capture *)ctx;
+  const Image *im = c->im;
+  const int n = 1 << c->scale;
+  c->blocks++;
+  for (int j = 0; j < h; j++) {
+    for (int i = 0; i < w; i++) {
+      double ys = 0, cb = 0, cr = 0;
+      for (int dy = 0; dy < n; dy++) {
+        for (int dx = 0; dx < n; dx++) {
+          int sx = ((x + i) << c->scale) + dx, sy = ((y + j) << c->scale) + dy;
+          ys += sample(im, 0, sx, sy, c->scale);
+          if (im->comps == 3) {
+            int cx = sx / im->hs, cy = sy / im->vs;
+            cb += sample(im, 1, cx, cy, c->scale);
+            cr += sample(im, 2, cx, cy, c->scale);
+          }
+        }
+      }
+      ys /= n * n, cb = cb / (n * n) - 128, cr = cr / (n * n) - 128;
+      double r = ys, g = ys, b = ys;
+      if (im->comps == 3) {
+        r = clampd(ys + 1.402 * cr);
+        g = clampd(ys - 0.344136 * cb - 0.714136 * cr);
+        b = clampd(ys + 1.772 * cb);
+      }
+      uint16_t p = pixels[j * w + i];
+      if (c->swap) p = (uint16_t)(p >> 8 | p << 8);
+      double err[3] = {fabs((p >> 11) * 8 + 4 - r), fabs(((p >> 5) & 63) * 4 + 2 - g), fabs((p & 31) * 8 + 4 - b)};
+      for (double e : err) {
+        c->worst = e > c->worst ? e : c->worst;
+        c->errSum += e;
+      }
+      c->px++;
+    }
+  }
+  return true;
+}
+
+static JpegDecodeResult decode(const std::vector<uint8_t> &jpg, Capture *c, JpegDecodeStats *st = nullptr,
+                               JpegDecodeOptions opt = JpegDecodeOptions()) {
+  opt.scale = c->scale;
+  opt.swapBytes = c->swap;
+  return jpegDecode(&dec, jpg.data(), jpg.size(), opt, capture, c, st);
+}
+
+static void checkRoundTrip(int w, int h, int comps, int hs, int vs, uint16_t restart) {
+  Image im = makeImage(w, h, comps, hs, vs);
+  Options o;
+  o.restart = restart;
+  std::vector<uint8_t> jpg = encode(&im, o);
+  for (uint8_t s = 0; s <= 3; s++) {
+    Capture c(&im, s, s == 1);
+    JpegDecodeStats st;
+    char msg[80];
+    snprintf(msg, sizeof(msg), "%dx%d comps %d %dx%d scale %d", w, h, comps, hs, vs, s);
+    TEST_ASSERT_EQUAL_MESSAGE(JPEG_DEC_OK, decode(jpg, &c, &st), msg);
+    // Edge MCUs narrower than the scale step have no output pixels
+    const int mw = 8 * hs, mh = 8 * vs, mx = (w + mw - 1) / mw, my = (h + mh - 1) / mh;
+    const int fullX = ((w % mw ? w % mw : mw) >> s) ? mx : mx - 1;
+    const int fullY = ((h % mh ? h % mh : mh) >> s) ? my : my - 1;
+    TEST_ASSERT_EQUAL_MESSAGE(mx * my, st.mcus, msg);
+    TEST_ASSERT_EQUAL_MESSAGE(fullX * fullY, st.decoded, msg);
+    TEST_ASSERT_EQUAL_MESSAGE(mx * my - fullX * fullY, st.skipped, msg);
+    TEST_ASSERT_EQUAL_MESSAGE(fullX * fullY, c.blocks, msg);
+    // One 565 step plus fixed-point slack; the mean catches a bias
+    TEST_ASSERT_TRUE_MESSAGE(c.worst <= (comps == 3 ? 12 : 8), msg);
+    TEST_ASSERT_TRUE_MESSAGE(c.errSum / (3.0 * c.px) < 3.0, msg);
+  }
+}
+
+// ============================================
+// Round trips
+// ============================================
+static void test_gray_round_trip() {
+  checkRoundTrip(8, 8, 1, 1, 1, 0);
+  checkRoundTrip(37, 21, 1, 1, 1, 0);
+}
+
+static void test_colour_round_trip() {
+  checkRoundTrip(48, 16, 3, 2, 1, 0); // OV2640: 4:2:2
+  checkRoundTrip(50, 30, 3, 2, 1, 0);
+  checkRoundTrip(33, 40, 3, 2, 2, 0);
+  checkRoundTrip(20, 12, 3, 1, 1, 0);
+}
+
+static void test_restart_intervals() {
+  checkRoundTrip(64, 32, 3, 2, 1, 1);
+  checkRoundTrip(64, 32, 3, 2, 1, 3);
+  checkRoundTrip(37, 21, 1, 1, 1, 5);
+}
+
+// MCUs outside the clip are entropy-decoded only; below it, not at all
+static void test_clip_skips_and_stops() {
+  defaultQuant();
+  Image im = makeImage(64, 64, 3, 2, 1); // 4x8 MCUs of 16x8
+  std::vector<uint8_t> jpg = encode(&im);
+  Capture c(&im);
+  JpegDecodeStats st;
+  JpegDecodeOptions opt = {};
+  opt.clipX = 20, opt.clipY = 10, opt.clipW = 10, opt.clipH = 12; // cols 1, rows 1-2
+  TEST_ASSERT_EQUAL(JPEG_DEC_OK, decode(jpg, &c, &st, opt));
+  TEST_ASSERT_EQUAL(32, st.mcus);
+  TEST_ASSERT_EQUAL(2, st.decoded);
+  TEST_ASSERT_EQUAL(2, c.blocks);
+  TEST_ASSERT_EQUAL(4 * 5, st.notReached);
+  TEST_ASSERT_EQUAL(32 - 2 - 20, st.skipped);
+  TEST_ASSERT_TRUE(c.worst <= 12);
+}
+
+static bool refuse(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *pixels) {
+  return ++*(int *)ctx < 3;
+}
+
+static void test_sink_abort() {
+  defaultQuant();
+  Image im = makeImage(64, 16, 1, 1, 1);
+  std::vector<uint8_t> jpg = encode(&im);
+  int calls = 0;
+  JpegDecodeOptions opt = {};
+  TEST_ASSERT_EQUAL(JPEG_DEC_ABORTED, jpegDecode(&dec, jpg.data(), jpg.size(), opt, refuse, &calls, nullptr));
+  TEST_ASSERT_EQUAL(3, calls);
+}
+
+// ============================================
+// Header checks
+// ============================================
+// counts[0] = 162 claims 162 one-bit codes; the table fill used to run
+// past fast[256] before the over-subscription check
+static void test_oversubscribed_dht_is_rejected() {
+  defaultQuant();
+  Image im = makeImage(16, 8, 1, 1, 1);
+  Capture c(&im);
+  const uint8_t bad[][16] = {
+      {162},
+      {3},
+      {0, 5},
+      {0, 0, 0, 0, 0, 0, 128, 1},         // 7-bit space full, then one more
+      {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3},
+  };
+  for (const auto &counts : bad) {
+    Options o;
+    o.dhtCounts = counts;
+    std::vector<uint8_t> jpg = encode(&im, o);
+    TEST_ASSERT_EQUAL(JPEG_DEC_ERR_HEADER, decode(jpg, &c));
+  }
+  // Exactly complete is fine: one code of each length, two of 16 bits
+  const uint8_t full[16] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2};
+  Options o;
+  o.dhtCounts = full;
+  std::vector<uint8_t> jpg = encode(&im, o);
+  TEST_ASSERT_NOT_EQUAL(JPEG_DEC_ERR_HEADER, decode(jpg, &c));
+}
+
+// Random counts: rejected or decoded, never out of bounds (ASan)
+static void test_random_dht_counts() {
+  defaultQuant();
+  Image im = makeImage(16, 8, 1, 1, 1);
+  Capture c(&im);
+  int rejected = 0;
+  for (int round = 0; round < 2000; round++) {
+    uint8_t counts[16] = {};
+    int total = 0;
+    for (int i = 0; i < 16 && total < 256; i++) {
+      int n = next() % 4 == 0 ? (int)(next() % 256) : (int)(next() % (1 << (i < 8 ? i + 1 : 8)));
+      if (total + n > 256) n = 256 - total;
+      counts[i] = (uint8_t)n;
+      total += n;
+    }
+    Options o;
+    o.dhtCounts = counts;
+    std::vector<uint8_t> jpg = encode(&im, o);
+    if (decode(jpg, &c) == JPEG_DEC_ERR_HEADER) rejected++;
+  }
+  TEST_ASSERT_GREATER_THAN(0, rejected);
+}
+
+// Tables the scan refers to must be defined by this image, not left over
+// from the previous one
+static void test_missing_tables_are_rejected() {
+  defaultQuant();
+  Image im = makeImage(32, 16, 3, 2, 1);
+  Capture c(&im);
+  TEST_ASSERT_EQUAL(JPEG_DEC_OK, decode(encode(&im), &c)); // leaves tables behind
+
+  Options noDqt;
+  noDqt.dqt = false;
+  TEST_ASSERT_EQUAL(JPEG_DEC_ERR_HEADER, decode(encode(&im, noDqt), &c));
+  Options lumaQuantOnly;
+  lumaQuantOnly.quantTables = 1;
+  TEST_ASSERT_EQUAL(JPEG_DEC_ERR_HEADER, decode(encode(&im, lumaQuantOnly), &c));
+  Options noDht;
+  noDht.dht = false;
+  TEST_ASSERT_EQUAL(JPEG_DEC_ERR_HEADER, decode(encode(&im, noDht), &c));
+  Options lumaAcOnly;
+  lumaAcOnly.acTables = 1;
+  TEST_ASSERT_EQUAL(JPEG_DEC_ERR_HEADER, decode(encode(&im, lumaAcOnly), &c));
+
+  // Grayscale needs table 0 only
+  Image gray = makeImage(16, 8, 1, 1, 1);
+  Capture g(&gray);
+  TEST_ASSERT_EQUAL(JPEG_DEC_OK, decode(encode(&gray, lumaQuantOnly), &g));
+  TEST_ASSERT_EQUAL(JPEG_DEC_OK, decode(encode(&gray, lumaAcOnly), &g));
+}
+
+// ============================================
+// Entropy data
+// ============================================
+static void test_truncated_and_corrupt_data() {
+  defaultQuant();
+  Image im = makeImage(64, 32, 3, 2, 1);
+  std::vector<uint8_t> jpg = encode(&im);
+  Capture c(&im);
+  size_t header = 0;
+  while (!(jpg[header] == 0xFF && jpg[header + 1] == 0xDA)) header++;
+  header += 2 + (jpg[header + 2] << 8 | jpg[header + 3]);
+
+  // Cut anywhere in the scan: bad data, or fine if only the EOI went
+  for (size_t cut = header; cut < jpg.size(); cut += 7) {
+    std::vector<uint8_t> part(jpg.begin(), jpg.begin() + cut);
+    JpegDecodeResult r = decode(part, &c);
+    TEST_ASSERT_TRUE(r == JPEG_DEC_ERR_DATA || (r == JPEG_DEC_OK && cut + 8 > jpg.size()));
+  }
+  // Flipped bytes: any answer but a crash
+  int bad = 0;
+  for (int round = 0; round < 500; round++) {
+    std::vector<uint8_t> broken = jpg;
+    for (int i = 0; i < 3; i++) broken[header + next() % (jpg.size() - header - 2)] ^= (uint8_t)(1 + next() % 255);
+    JpegDecodeResult r = decode(broken, &c);
+    TEST_ASSERT_TRUE(r == JPEG_DEC_OK || r == JPEG_DEC_ERR_DATA);
+    bad += r == JPEG_DEC_ERR_DATA;
+  }
+  TEST_ASSERT_GREATER_THAN(0, bad);
+}
+
+int main() {
+  buildAcTable();
+  defaultQuant();
+  UNITY_BEGIN();
+  RUN_TEST(test_gray_round_trip);
+  RUN_TEST(test_colour_round_trip);
+  RUN_TEST(test_restart_intervals);
+  RUN_TEST(test_clip_skips_and_stops);
+  RUN_TEST(test_sink_abort);
+  RUN_TEST(test_oversubscribed_dht_is_rejected);
+  RUN_TEST(test_random_dht_counts);
+  RUN_TEST(test_missing_tables_are_rejected);
+  RUN_TEST(test_truncated_and_corrupt_data);
+  return UNITY_END();
+}
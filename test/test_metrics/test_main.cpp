@@ -0,0 +1,171 @@
+// ============================================
+// Metrics registry tests (pio test -e native -f test_metrics)
+// Metrics are static objects, as in the firmware; each test uses its own
+// so the registry needs no resetting between them.
+// ============================================
+
+#include "utils/metrics.h"
+#include <string>
+#include <thread>
+#include <unity.h>
+
+static MetricCounter carried("t_carry_total", "Counter past 2^32.");
+static MetricCounter raced("t_raced_total", "Counter added to from several threads.");
+static MetricHistogram racedHist("t_raced_us", "Histogram observed from several threads.", METRIC_LATENCY_US,
+                                 1e-6);
+
+static const uint32_t SIZE_BOUNDS[] = {10, 100, 1000};
+static MetricHistogram sizes("t_size_bytes", "Histogram with three bounds.", SIZE_BOUNDS, 1);
+
+static MetricCounter okRequests("t_requests_total", "Requests by result.", "result=\"ok\"");
+static MetricCounter failedRequests("t_requests_total", "Requests by result.", "result=\"failed\"");
+static MetricGauge tenths("t_fps", "Gauge kept in tenths.", nullptr, 0.1);
+static MetricGauge collected("t_collected", "Gauge set by a collector.", "region=\"internal\"");
+static const uint32_t MS_BOUNDS[] = {10, 100};
+static MetricHistogram latency("t_latency_seconds", "Labelled histogram scaled to seconds.", MS_BOUNDS, 1e-3,
+                               "caller=\"export\"");
+
+static int collections = 0;
+static void collect() {
+  collections++;
+  collected.set(123456);
+}
+
+static std::string render() {
+  size_t need = metricsRender(nullptr, 0);
+  std::string text(need + 1, '\0');
+  TEST_ASSERT_EQUAL_UINT(need, metricsRender(&text[0], text.size()));
+  text.resize(need);
+  return text;
+}
+
+static void assertLine(const std::string &text, const char *line) {
+  TEST_ASSERT_TRUE_MESSAGE(text.find(line) != std::string::npos, line);
+}
+
+static size_t occurrences(const std::string &text, const char *what) {
+  size_t n = 0;
+  for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1)) n++;
+  return n;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================
+// Counters
+// ============================================
+static void test_counter_carries_into_high_word() {
+  carried.add(0xFFFFFFF0u);
+  TEST_ASSERT_EQUAL_UINT64(0xFFFFFFF0ull, carried.value());
+  carried.add(0x20);
+  TEST_ASSERT_EQUAL_UINT64(0x100000010ull, carried.value());
+  carried.add(0xFFFFFFFFu);
+  TEST_ASSERT_EQUAL_UINT64(0x20000000Full, carried.value());
+  assertLine(render(), "t_carry_total 8589934607\n");
+}
+
+static void test_concurrent_adds_lose_nothing() {
+  const int threads = 4, adds = 200000;
+  std::thread t[threads];
+  for (int i = 0; i < threads; i++) {
+    t[i] = std::thread([] {
+      for (int n = 0; n < adds; n++) {
+        raced.add(0x10000); // carries every 65536 adds
+        racedHist.observe(n % 2 ? 300 : 3000000);
+      }
+    });
+  }
+  for (std::thread &th : t) th.join();
+
+  TEST_ASSERT_EQUAL_UINT64((uint64_t)threads * adds * 0x10000, raced.value());
+  uint32_t count = 0;
+  for (uint8_t i = 0; i <= racedHist.bucketCount; i++) count += racedHist.bucket(i);
+  TEST_ASSERT_EQUAL_UINT32(threads * adds, count);
+  TEST_ASSERT_EQUAL_UINT32(threads * adds / 2, racedHist.bucket(2));                   // le 500us
+  TEST_ASSERT_EQUAL_UINT32(threads * adds / 2, racedHist.bucket(racedHist.bucketCount)); // +Inf
+  TEST_ASSERT_EQUAL_UINT64((uint64_t)threads * adds / 2 * (300 + 3000000), racedHist.sum());
+}
+
+// ============================================
+// Histograms
+// ============================================
+static void test_histogram_buckets_are_exported_cumulative() {
+  const uint32_t observed[] = {0, 10, 11, 100, 999, 1000, 1001, 50000};
+  for (uint32_t v : observed) sizes.observe(v);
+
+  // Each bucket alone: a value equal to a bound belongs to that bound
+  TEST_ASSERT_EQUAL_UINT32(2, sizes.bucket(0));
+  TEST_ASSERT_EQUAL_UINT32(2, sizes.bucket(1));
+  TEST_ASSERT_EQUAL_UINT32(2, sizes.bucket(2));
+  TEST_ASSERT_EQUAL_UINT32(2, sizes.bucket(3));
+
+  std::string text = render();
+  assertLine(text, "t_size_bytes_bucket{le=\"10\"} 2\n");
+  assertLine(text, "t_size_bytes_bucket{le=\"100\"} 4\n");
+  assertLine(text, "t_size_bytes_bucket{le=\"1000\"} 6\n");
+  assertLine(text, "t_size_bytes_bucket{le=\"+Inf\"} 8\n");
+  assertLine(text, "t_size_bytes_count 8\n");
+  assertLine(text, "t_size_bytes_sum 53121\n");
+}
+
+// ============================================
+// Text format
+// ============================================
+static void test_text_format() {
+  TEST_ASSERT_TRUE(metricsOnCollect(collect));
+  okRequests.add(3);
+  failedRequests.add();
+  tenths.set(123);
+  latency.observe(5);
+  latency.observe(50);
+  latency.observe(5000);
+
+  int before = collections;
+  std::string text = render();
+  TEST_ASSERT_EQUAL(before + 2, collections); // once per render
+
+  // One HELP / TYPE per family, however many members
+  TEST_ASSERT_EQUAL_UINT(1, occurrences(text, "# TYPE t_requests_total counter\n"));
+  TEST_ASSERT_EQUAL_UINT(1, occurrences(text, "# HELP t_requests_total Requests by result.\n"));
+  TEST_ASSERT_EQUAL_UINT(1, occurrences(text, "# TYPE t_latency_seconds histogram\n"));
+  assertLine(text, "# TYPE t_fps gauge\n");
+  assertLine(text, "t_requests_total{result=\"ok\"} 3\n");
+  assertLine(text, "t_requests_total{result=\"failed\"} 1\n");
+  // Family members follow their TYPE line
+  size_t type = text.find("# TYPE t_requests_total");
+  TEST_ASSERT_TRUE(text.find("t_requests_total{result=\"ok\"}") > type);
+  TEST_ASSERT_TRUE(text.find("t_requests_total{result=\"failed\"}") > type);
+
+  assertLine(text, "t_fps 12.3\n");
+  assertLine(text, "t_collected{region=\"internal\"} 123456\n");
+
+  // Labels and le share the braces; bounds and sum scaled to seconds
+  assertLine(text, "t_latency_seconds_bucket{caller=\"export\",le=\"0.01\"} 1\n");
+  assertLine(text, "t_latency_seconds_bucket{caller=\"export\",le=\"0.1\"} 2\n");
+  assertLine(text, "t_latency_seconds_bucket{caller=\"export\",le=\"+Inf\"} 3\n");
+  assertLine(text, "t_latency_seconds_sum{caller=\"export\"} 5.055\n");
+  assertLine(text, "t_latency_seconds_count{caller=\"export\"} 3\n");
+
+  TEST_ASSERT_EQUAL('\n', text.back());
+}
+
+static void test_render_reports_length_when_cut_short() {
+  std::string whole = render();
+  char small[64];
+  memset(small, 'x', sizeof(small));
+  size_t need = metricsRender(small, sizeof(small));
+  TEST_ASSERT_EQUAL_UINT(whole.size(), need);
+  TEST_ASSERT_EQUAL_UINT(sizeof(small) - 1, strlen(small));
+  TEST_ASSERT_EQUAL_MEMORY(whole.data(), small, sizeof(small) - 1);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_counter_carries_into_high_word);
+  RUN_TEST(test_concurrent_adds_lose_nothing);
+  RUN_TEST(test_histogram_buckets_are_exported_cumulative);
+  RUN_TEST(test_text_format);
+  RUN_TEST(test_render_reports_length_when_cut_short);
+  return UNITY_END();
+}
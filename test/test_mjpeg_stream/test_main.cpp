@@ -0,0 +1,367 @@
+// ============================================
+// MJPEG fan-out tests (pio test -e native -f test_mjpeg_stream)
+// A fake camera with the driver's two frame buffers feeds the stream the
+// way the preview task does (offer(), then release()), and viewers are
+// driven through the HttpStream calls the server task makes. The clock is
+// simulated, so STREAM_LEND_MS and reclaim() timeouts are exact.
+// ============================================
+
+#include "net/mjpeg_stream.h"
+#include <esp_heap_caps.h>
+#include <string>
+#include <unity.h>
+
+// ============================================
+// Fake camera
+// ============================================
+struct FakeFrame {
+  uint8_t jpg[3000];
+  size_t len;
+  bool out;               // with the stream / grabber, not the driver
+};
+static FakeFrame buffers[2];
+static int returned;
+
+static void giveBack(void *token) {
+  FakeFrame *f = (FakeFrame *)token;
+  TEST_ASSERT_TRUE_MESSAGE(f->out, "frame given back twice");
+  f->out = false;
+  // The driver refills it at once: stale readers would see this
+  memset(f->jpg, 0xEE, sizeof(f->jpg));
+  returned++;
+}
+
+// Next free driver buffer filled with a recognisable frame, or nullptr
+static FakeFrame *grab(uint8_t seq, size_t len = 2000) {
+  for (FakeFrame &f : buffers) {
+    if (f.out) continue;
+    f.out = true;
+    f.len = len;
+    for (size_t i = 0; i < len; i++) f.jpg[i] = (uint8_t)(seq * 31 + i);
+    return &f;
+  }
+  return nullptr;
+}
+
+static MjpegStream *stream;
+
+// Preview task: grab, offer, release
+static FakeFrame *grabAndOffer(uint8_t seq, size_t len = 2000) {
+  FakeFrame *f = grab(seq, len);
+  TEST_ASSERT_NOT_NULL_MESSAGE(f, "camera has no free buffer");
+  stream->offer(f->jpg, f->len, f);
+  stream->release(f);
+  return f;
+}
+
+// ============================================
+// Viewers
+// ============================================
+// Server task writing up to `max` bytes to `client`; what it wrote
+static std::string write(uint8_t client, size_t max = SIZE_MAX, size_t chunk = 512) {
+  std::string out;
+  while (out.size() < max) {
+    const uint8_t *data;
+    size_t n = stream->peek(client, &data);
+    if (!n) break;
+    n = std::min(n, std::min(chunk, max - out.size()));
+    out.append((const char *)data, n);
+    stream->consume(client, n);
+  }
+  return out;
+}
+
+// The multipart part for frame `seq` as a viewer should receive it
+static std::string part(uint8_t seq, size_t len = 2000) {
+  char head[128];
+  snprintf(head, sizeof(head),
+           "--" MJPEG_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n", (unsigned)len);
+  std::string p = head;
+  for (size_t i = 0; i < len; i++) p += (char)(uint8_t)(seq * 31 + i);
+  return p + "\r\n";
+}
+
+static MjpegStreamStats stats() {
+  MjpegStreamStats s;
+  stream->getStats(&s);
+  return s;
+}
+
+static const MjpegViewerStats *viewer(const MjpegStreamStats &s, uint8_t slot) {
+  for (uint8_t i = 0; i < s.viewers; i++) {
+    if (s.viewer[i].slot == slot) return &s.viewer[i];
+  }
+  return nullptr;
+}
+
+void setUp() {
+  hostClockSet(100000);
+  memset(buffers, 0, sizeof(buffers));
+  returned = 0;
+  hostAllocFail = 0;
+  stream = new MjpegStream(giveBack);
+}
+
+void tearDown() {
+  for (uint8_t c = 0; c < HTTP_MAX_CLIENTS; c++) stream->close(c);
+  delete stream;
+}
+
+// ============================================
+// Fan-out
+// ============================================
+static void test_no_viewers_returns_frame_at_once() {
+  FakeFrame *f = grab(1);
+  stream->offer(f->jpg, f->len, f);
+  stream->release(f);
+  TEST_ASSERT_EQUAL(1, returned);
+  TEST_ASSERT_EQUAL_UINT32(0, stats().offered);
+  TEST_ASSERT_FALSE(stream->wanted());
+}
+
+static void test_one_buffer_fans_out_to_every_viewer() {
+  for (uint8_t c = 0; c < STREAM_MAX_CLIENTS; c++) TEST_ASSERT_TRUE(stream->open(c));
+  TEST_ASSERT_TRUE(stream->wanted());
+  grabAndOffer(1);
+  TEST_ASSERT_EQUAL(0, returned); // grabber done, viewers not yet
+
+  for (uint8_t c = 0; c < STREAM_MAX_CLIENTS; c++) {
+    TEST_ASSERT_TRUE(write(c) == part(1));
+    TEST_ASSERT_EQUAL(c + 1 == STREAM_MAX_CLIENTS ? 1 : 0, returned); // back with the last reader
+  }
+  MjpegStreamStats s = stats();
+  TEST_ASSERT_EQUAL_UINT32(1, s.offered);
+  TEST_ASSERT_EQUAL_UINT32(1, s.lent);
+  TEST_ASSERT_EQUAL_UINT32(0, s.spills);
+  TEST_ASSERT_EQUAL_UINT32(1, viewer(s, 0)->frames);
+
+  // Viewers finished before the grabber let go: returned by release()
+  FakeFrame *f = grab(2);
+  stream->offer(f->jpg, f->len, f);
+  for (uint8_t c = 0; c < STREAM_MAX_CLIENTS; c++) TEST_ASSERT_TRUE(write(c) == part(2));
+  TEST_ASSERT_EQUAL(1, returned);
+  stream->release(f);
+  TEST_ASSERT_EQUAL(2, returned);
+}
+
+static void test_open_is_capped_per_stream() {
+  for (uint8_t c = 0; c < STREAM_MAX_CLIENTS; c++) TEST_ASSERT_TRUE(stream->open(c));
+  TEST_ASSERT_FALSE(stream->open(STREAM_MAX_CLIENTS));
+  stream->close(1);
+  TEST_ASSERT_FALSE(stream->open(0)); // already open
+  TEST_ASSERT_TRUE(stream->open(STREAM_MAX_CLIENTS));
+  TEST_ASSERT_FALSE(stream->open(HTTP_MAX_CLIENTS));
+}
+
+// ============================================
+// Slow viewers
+// ============================================
+static void test_busy_viewer_skips_frames_and_one_buffer_stays_free() {
+  stream->open(0);
+  stream->open(1);
+  grabAndOffer(1);
+  TEST_ASSERT_TRUE(write(0) == part(1));
+  std::string slow = write(1, 700);
+
+  // The lent buffer is still out: the next frame is not lent to anyone,
+  // so the driver keeps the other buffer
+  FakeFrame *second = grabAndOffer(2);
+  TEST_ASSERT_FALSE(second->out);
+  MjpegStreamStats s = stats();
+  TEST_ASSERT_EQUAL_UINT32(2, s.offered);
+  TEST_ASSERT_EQUAL_UINT32(1, s.refused);
+  TEST_ASSERT_EQUAL_UINT32(1, viewer(s, 0)->dropped);
+  TEST_ASSERT_EQUAL_UINT32(1, viewer(s, 1)->dropped);
+
+  // The slow viewer's frame is untouched by the grab
+  slow += write(1);
+  TEST_ASSERT_TRUE(slow == part(1));
+  TEST_ASSERT_EQUAL(2, returned);
+
+  grabAndOffer(3);
+  TEST_ASSERT_TRUE(write(0) == part(3));
+  TEST_ASSERT_TRUE(write(1) == part(3));
+}
+
+// ============================================
+// Spill
+// ============================================
+static void test_slow_viewer_spills_to_copy_and_buffer_returns() {
+  stream->open(0);
+  stream->open(1);
+  grabAndOffer(1, 2500);
+  TEST_ASSERT_TRUE(write(0) == part(1, 2500));
+  std::string slow = write(1, 1000);
+
+  hostClockAdvance(STREAM_LEND_MS - 1);
+  slow += write(1, 100);
+  TEST_ASSERT_EQUAL(0, returned);
+  TEST_ASSERT_EQUAL_UINT32(0, stats().spills);
+
+  // Past STREAM_LEND_MS: the next peek copies it out and frees the camera
+  // buffer (which the driver scribbles over), mid-frame
+  hostClockAdvance(2);
+  slow += write(1, 100);
+  TEST_ASSERT_EQUAL(1, returned);
+  MjpegStreamStats s = stats();
+  TEST_ASSERT_EQUAL_UINT32(1, s.spills);
+  TEST_ASSERT_EQUAL_UINT8(1, s.copiesInUse);
+  TEST_ASSERT_GREATER_OR_EQUAL(STREAM_LEND_MS, s.lendMsMax);
+
+  // A new frame can be lent while the copy is read
+  grabAndOffer(2, 2500);
+  TEST_ASSERT_TRUE(write(0) == part(2, 2500));
+  TEST_ASSERT_EQUAL(2, returned);
+
+  slow += write(1);
+  TEST_ASSERT_TRUE(slow == part(1, 2500));
+  TEST_ASSERT_EQUAL_UINT8(0, stats().copiesInUse);
+}
+
+static void test_spill_moves_every_viewer_on_the_buffer() {
+  for (uint8_t c = 0; c < STREAM_MAX_CLIENTS; c++) stream->open(c);
+  grabAndOffer(1);
+  std::string at[STREAM_MAX_CLIENTS];
+  for (uint8_t c = 0; c < STREAM_MAX_CLIENTS; c++) at[c] = write(c, 300 * (c + 1));
+
+  hostClockAdvance(STREAM_LEND_MS + 1);
+  at[0] += write(0, 1);
+  TEST_ASSERT_EQUAL(1, returned);
+  MjpegStreamStats s = stats();
+  TEST_ASSERT_EQUAL_UINT32(1, s.spills);
+  TEST_ASSERT_EQUAL_UINT8(1, s.copiesInUse); // one copy shared by all three
+
+  for (uint8_t c = 0; c < STREAM_MAX_CLIENTS; c++) {
+    at[c] += write(c);
+    TEST_ASSERT_TRUE(at[c] == part(1));
+  }
+  TEST_ASSERT_EQUAL_UINT8(0, stats().copiesInUse);
+}
+
+static void test_failed_spill_keeps_buffer_until_viewer_is_done() {
+  stream->open(0);
+  grabAndOffer(1);
+  std::string slow = write(0, 500);
+
+  hostClockAdvance(STREAM_LEND_MS + 1);
+  hostAllocFail = 1;
+  slow += write(0, 500);
+  TEST_ASSERT_EQUAL(0, returned);
+  TEST_ASSERT_EQUAL_UINT32(1, stats().spillFailed);
+
+  // Not retried for this frame
+  hostClockAdvance(STREAM_LEND_MS);
+  slow += write(0, 500);
+  TEST_ASSERT_EQUAL_UINT32(1, stats().spillFailed);
+  TEST_ASSERT_EQUAL_UINT32(0, stats().spills);
+
+  slow += write(0);
+  TEST_ASSERT_TRUE(slow == part(1));
+  TEST_ASSERT_EQUAL(1, returned);
+
+  // The next frame spills normally
+  grabAndOffer(2);
+  slow = write(0, 500);
+  hostClockAdvance(STREAM_LEND_MS + 1);
+  slow += write(0);
+  TEST_ASSERT_TRUE(slow == part(2));
+  TEST_ASSERT_EQUAL_UINT32(1, stats().spills);
+}
+
+// ============================================
+// Close mid-frame
+// ============================================
+static void test_close_mid_frame_drops_its_reference() {
+  stream->open(0);
+  stream->open(1);
+  grabAndOffer(1);
+  write(0, 100);
+  write(1, 200);
+  stream->close(0);
+  TEST_ASSERT_EQUAL(0, returned);
+  stream->close(1);
+  TEST_ASSERT_EQUAL(1, returned);
+  TEST_ASSERT_FALSE(stream->wanted());
+
+  // The slot is clean for the next viewer
+  TEST_ASSERT_TRUE(stream->open(0));
+  grabAndOffer(2);
+  TEST_ASSERT_TRUE(write(0) == part(2));
+  TEST_ASSERT_EQUAL_UINT32(1, viewer(stats(), 0)->frames);
+}
+
+static void test_close_on_copy_frees_it() {
+  stream->open(0);
+  stream->open(1);
+  grabAndOffer(1);
+  write(0, 100);
+  write(1, 100);
+  hostClockAdvance(STREAM_LEND_MS + 1);
+  write(0, 100);
+  TEST_ASSERT_EQUAL_UINT8(1, stats().copiesInUse);
+  stream->close(0);
+  TEST_ASSERT_EQUAL_UINT8(1, stats().copiesInUse);
+  stream->close(1);
+  TEST_ASSERT_EQUAL_UINT8(0, stats().copiesInUse);
+  TEST_ASSERT_EQUAL(1, returned);
+}
+
+static void test_close_before_grabber_release() {
+  stream->open(0);
+  FakeFrame *f = grab(1);
+  stream->offer(f->jpg, f->len, f);
+  write(0, 100);
+  stream->close(0);
+  TEST_ASSERT_EQUAL(0, returned); // the grabber still has it
+  stream->release(f);
+  TEST_ASSERT_EQUAL(1, returned);
+}
+
+// ============================================
+// Reclaim
+// ============================================
+static void test_reclaim_waits_for_the_lent_buffer() {
+  TEST_ASSERT_TRUE(stream->reclaim(0)); // nothing out
+
+  stream->open(0);
+  grabAndOffer(1);
+  write(0, 100);
+  uint32_t start = millis();
+  TEST_ASSERT_FALSE(stream->reclaim(100));
+  TEST_ASSERT_GREATER_OR_EQUAL(100, millis() - start);
+  TEST_ASSERT_LESS_OR_EQUAL(110, millis() - start);
+
+  // Once the viewer moves to a copy (or leaves) it is back
+  write(0, 100);
+  TEST_ASSERT_EQUAL(1, returned);
+  start = millis();
+  TEST_ASSERT_TRUE(stream->reclaim(100));
+  TEST_ASSERT_EQUAL_UINT32(start, millis());
+}
+
+static void test_reclaim_times_out_on_unreleased_grab() {
+  stream->open(0);
+  FakeFrame *f = grab(1);
+  stream->offer(f->jpg, f->len, f);
+  TEST_ASSERT_TRUE(write(0) == part(1));
+  TEST_ASSERT_FALSE(stream->reclaim(20));
+  stream->release(f);
+  TEST_ASSERT_TRUE(stream->reclaim(20));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_no_viewers_returns_frame_at_once);
+  RUN_TEST(test_one_buffer_fans_out_to_every_viewer);
+  RUN_TEST(test_open_is_capped_per_stream);
+  RUN_TEST(test_busy_viewer_skips_frames_and_one_buffer_stays_free);
+  RUN_TEST(test_slow_viewer_spills_to_copy_and_buffer_returns);
+  RUN_TEST(test_spill_moves_every_viewer_on_the_buffer);
+  RUN_TEST(test_failed_spill_keeps_buffer_until_viewer_is_done);
+  RUN_TEST(test_close_mid_frame_drops_its_reference);
+  RUN_TEST(test_close_on_copy_frees_it);
+  RUN_TEST(test_close_before_grabber_release);
+  RUN_TEST(test_reclaim_waits_for_the_lent_buffer);
+  RUN_TEST(test_reclaim_times_out_on_unreleased_grab);
+  return UNITY_END();
+}
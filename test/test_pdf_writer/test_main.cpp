@@ -0,0 +1,418 @@
+// ============================================
+// PDF writer tests (pio test -e native -f test_pdf_writer)
+// Documents written into memory and read back the way a viewer does: from
+// the last startxref along the /Prev chain, newest object revision first,
+// then down the page tree from the catalog. Every page update must leave
+// such a complete file, across the 32-page /Pages group boundary, after a
+// failed page is aborted and retaken, and at each cut point
+// pdfLastCommitted() picks in a file truncated part way through a write.
+// ============================================
+
+#include "storage/pdf_writer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+// ============================================
+// Sink and source
+// ============================================
+struct MemFile {
+  std::string bytes;
+  long budget = -1; // bytes the card takes before it fails; -1: no limit
+};
+
+static size_t memSink(void *ctx, const uint8_t *data, size_t len) {
+  MemFile *f = (MemFile *)ctx;
+  size_t n = len;
+  if (f->budget >= 0 && (long)n > f->budget) n = (size_t)f->budget;
+  f->bytes.append((const char *)data, n);
+  if (f->budget >= 0) f->budget -= (long)n;
+  return n;
+}
+
+// The first `size` bytes of a file, as a card holds them after a cut
+struct MemPrefix {
+  const std::string *bytes;
+  size_t size;
+};
+
+static size_t memSource(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+  const MemPrefix *p = (const MemPrefix *)ctx;
+  if (offset > p->size) return 0;
+  size_t n = p->size - offset < len ? p->size - offset : len;
+  memcpy(buf, p->bytes->data() + offset, n);
+  return n;
+}
+
+// Baseline JPEG header (SOF0 + SOS) and `payload` bytes of entropy data
+static std::vector<uint8_t> jpeg(uint16_t w, uint16_t h, uint8_t components, size_t payload) {
+  std::vector<uint8_t> j = {0xFF, 0xD8, 0xFF, 0xC0, 0, (uint8_t)(8 + 3 * components), 8,
+                            (uint8_t)(h >> 8), (uint8_t)h, (uint8_t)(w >> 8), (uint8_t)w, components};
+  for (uint8_t c = 0; c < components; c++) j.insert(j.end(), {(uint8_t)(c + 1), 0x11, 0});
+  j.insert(j.end(), {0xFF, 0xDA, 0, 8, 1, 1, 0, 0, 63, 0});
+  for (size_t i = 0; i < payload; i++) j.push_back((uint8_t)next());
+  j.insert(j.end(), {0xFF, 0xD9});
+  return j;
+}
+
+// ============================================
+// Reader
+// ============================================
+struct ParsedPage {
+  std::string image;   // stream bytes
+  std::string imageDict;
+  unsigned mediaW, mediaH;
+};
+
+struct ParsedPdf {
+  bool ok;
+  std::string error;
+  std::vector<ParsedPage> pages;
+  unsigned rootKids;
+  unsigned updates;    // xref sections on the /Prev chain
+};
+
+struct Reader {
+  const std::string &s;
+  std::map<unsigned, size_t> offsets;
+  ParsedPdf out;
+
+  explicit Reader(const std::string &bytes) : s(bytes) { out.ok = true, out.rootKids = 0, out.updates = 0; }
+
+  bool fail(const std::string &why) {
+    if (out.ok) out.error = why;
+    out.ok = false;
+    return false;
+  }
+
+  // Number after `key` in `text`, or -1
+  static long num(const std::string &text, const char *key) {
+    size_t at = text.find(key);
+    return at == std::string::npos ? -1 : strtol(text.c_str() + at + strlen(key), nullptr, 10);
+  }
+
+  bool xrefChain() {
+    size_t sx = s.rfind("startxref\n");
+    if (sx == std::string::npos || s.compare(s.size() - 6, 6, "%%EOF\n") != 0) return fail("no trailer at end");
+    size_t xref = strtoul(s.c_str() + sx + 10, nullptr, 10);
+    for (int guard = 0; guard < 10000; guard++) {
+      out.updates++;
+      if (xref >= s.size() || s.compare(xref, 5, "xref\n") != 0) return fail("startxref/Prev not at an xref");
+      size_t p = xref + 5;
+      while (s.compare(p, 8, "trailer\n") != 0) {
+        unsigned first, count;
+        int used;
+        if (sscanf(s.c_str() + p, "%u %u\n%n", &first, &count, &used) != 2) return fail("bad subsection");
+        p += used;
+        for (unsigned i = 0; i < count; i++, p += 20) {
+          if (s[p + 17] != 'n' && s[p + 17] != 'f') return fail("bad xref entry");
+          if (s[p + 17] == 'n' && !offsets.count(first + i)) offsets[first + i] = strtoul(s.c_str() + p, nullptr, 10);
+        }
+      }
+      size_t end = s.find(">>", p);
+      std::string trailer = s.substr(p, end - p);
+      if (num(trailer, "/Root ") != 1) return fail("trailer /Root");
+      long prev = num(trailer, "/Prev ");
+      if (prev < 0) return true;
+      xref = (size_t)prev;
+    }
+    return fail("/Prev loop");
+  }
+
+  // Text of object n up to "stream" or "endobj"
+  bool object(unsigned n, std::string *dict, size_t *streamAt = nullptr) {
+    if (!offsets.count(n)) return fail("object " + std::to_string(n) + " missing from xref");
+    size_t at = offsets[n];
+    std::string head = std::to_string(n) + " 0 obj\n";
+    if (s.compare(at, head.size(), head) != 0) return fail("xref offset of " + std::to_string(n) + " is wrong");
+    at += head.size();
+    size_t endobj = s.find("endobj", at), stream = s.find(">>\nstream\n", at);
+    if (stream != std::string::npos && stream < endobj) {
+      *dict = s.substr(at, stream + 2 - at);
+      if (streamAt) *streamAt = stream + 10;
+    } else {
+      *dict = s.substr(at, endobj - at);
+      if (streamAt) *streamAt = 0;
+    }
+    return true;
+  }
+
+  bool stream(unsigned n, std::string *dict, std::string *data) {
+    size_t at;
+    if (!object(n, dict, &at) || !at) return fail("object " + std::to_string(n) + " has no stream");
+    long len = num(*dict, "/Length ");
+    if (dict->find("/Length " + std::to_string(len) + " 0 R") != std::string::npos) {
+      std::string lenObj;
+      if (!object((unsigned)len, &lenObj)) return false;
+      len = strtol(lenObj.c_str(), nullptr, 10);
+    }
+    if (len < 0 || at + len > s.size()) return fail("stream length");
+    *data = s.substr(at, len);
+    if (s.compare(at + len, 10, "\nendstream") != 0 && s.compare(at + len, 9, "endstream") != 0)
+      return fail("stream of " + std::to_string(n) + " does not end at its /Length");
+    return true;
+  }
+
+  static std::vector<unsigned> kids(const std::string &dict) {
+    std::vector<unsigned> k;
+    size_t a = dict.find("/Kids [");
+    if (a == std::string::npos) return k;
+    const char *p = dict.c_str() + a + 7;
+    unsigned n;
+    int used;
+    while (sscanf(p, "%u 0 R %n", &n, &used) == 1) {
+      k.push_back(n);
+      p += used;
+    }
+    return k;
+  }
+
+  bool node(unsigned n, unsigned parent, int depth) {
+    std::string dict;
+    if (!object(n, &dict)) return false;
+    if (parent && num(dict, "/Parent ") != (long)parent) return fail("wrong /Parent on " + std::to_string(n));
+    if (dict.find("/Type /Pages") != std::string::npos) {
+      if (depth > 2) return fail("tree too deep");
+      std::vector<unsigned> k = kids(dict);
+      if (depth == 0) out.rootKids = (unsigned)k.size();
+      size_t before = out.pages.size();
+      for (unsigned kid : k)
+        if (!node(kid, n, depth + 1)) return false;
+      if (num(dict, "/Count ") != (long)(out.pages.size() - before)) return fail("/Count of " + std::to_string(n));
+      return true;
+    }
+    if (dict.find("/Type /Page ") == std::string::npos) return fail("not a page: " + std::to_string(n));
+    ParsedPage pg;
+    if (sscanf(dict.c_str() + dict.find("/MediaBox"), "/MediaBox [0 0 %u %u]", &pg.mediaW, &pg.mediaH) != 2)
+      return fail("MediaBox");
+    std::string content, contentDict;
+    if (!stream((unsigned)num(dict, "/Contents "), &contentDict, &content)) return false;
+    if (content.find("/Im0 Do") == std::string::npos) return fail("content does not draw the image");
+    if (!stream((unsigned)num(dict, "/Im0 "), &pg.imageDict, &pg.image)) return false;
+    out.pages.push_back(pg);
+    return true;
+  }
+
+  ParsedPdf parse() {
+    if (s.compare(0, 9, "%PDF-1.4\n") != 0) {
+      fail("header");
+      return out;
+    }
+    std::string catalog;
+    if (xrefChain() && object(1, &catalog)) {
+      if (catalog.find("/Type /Catalog /Pages 2 0 R") == std::string::npos) fail("catalog");
+      else node(2, 0, 0);
+    }
+    return out;
+  }
+};
+
+static ParsedPdf parse(const std::string &bytes) { return Reader(bytes).parse(); }
+
+static void assertValid(const ParsedPdf &p, size_t pages) {
+  if (!p.ok) TEST_FAIL_MESSAGE(p.error.c_str());
+  TEST_ASSERT_EQUAL(pages, p.pages.size());
+}
+
+// ============================================
+// Tests
+// ============================================
+static PdfDoc doc;
+static MemFile file;
+
+void setUp() {
+  rng = 1;
+  file = MemFile();
+  TEST_ASSERT_TRUE(pdfBegin(&doc, memSink, &file, 200));
+}
+void tearDown() {}
+
+static void test_empty_document_is_valid() {
+  assertValid(parse(file.bytes), 0);
+  TEST_ASSERT_EQUAL_UINT32(file.bytes.size(), doc.committed);
+  bool pages = true;
+  MemPrefix all = {&file.bytes, file.bytes.size()};
+  TEST_ASSERT_EQUAL_UINT32(doc.committed, pdfLastCommitted(memSource, &all, all.size, &pages));
+  TEST_ASSERT_FALSE(pages);
+}
+
+static void test_jpeg_page_embeds_the_bytes() {
+  std::vector<uint8_t> gray = jpeg(1600, 1200, 1, 3000), rgb = jpeg(800, 600, 3, 2000);
+  TEST_ASSERT_TRUE(pdfAppendJpegPage(&doc, gray.data(), gray.size()));
+  TEST_ASSERT_TRUE(pdfAppendJpegPage(&doc, rgb.data(), rgb.size()));
+  ParsedPdf p = parse(file.bytes);
+  assertValid(p, 2);
+  TEST_ASSERT_TRUE(p.pages[0].image == std::string(gray.begin(), gray.end()));
+  TEST_ASSERT_TRUE(p.pages[1].image == std::string(rgb.begin(), rgb.end()));
+  TEST_ASSERT_TRUE(p.pages[0].imageDict.find("/DeviceGray") != std::string::npos);
+  TEST_ASSERT_TRUE(p.pages[1].imageDict.find("/DeviceRGB") != std::string::npos);
+  // 1600 px at 200 dpi is 8 in
+  TEST_ASSERT_EQUAL(576, p.pages[0].mediaW);
+  TEST_ASSERT_EQUAL(432, p.pages[0].mediaH);
+  TEST_ASSERT_EQUAL(3, p.updates);
+
+  // Not a JPEG, or a colour space PDF has no name for: refused, doc untouched
+  uint32_t before = doc.offset;
+  std::vector<uint8_t> cmyk = jpeg(100, 100, 4, 10);
+  TEST_ASSERT_FALSE(pdfAppendJpegPage(&doc, cmyk.data(), cmyk.size()));
+  TEST_ASSERT_FALSE(pdfAppendJpegPage(&doc, gray.data() + 2, gray.size() - 2));
+  TEST_ASSERT_EQUAL_UINT32(before, doc.offset);
+  TEST_ASSERT_FALSE(doc.failed);
+}
+
+static void test_streamed_ccitt_page() {
+  TEST_ASSERT_TRUE(pdfBeginCcittPage(&doc, 1728, 2200));
+  std::string data;
+  for (int i = 0; i < 40; i++) {
+    uint8_t chunk[97];
+    for (uint8_t &b : chunk) b = (uint8_t)next();
+    TEST_ASSERT_TRUE(pdfWriteImageData(&doc, chunk, sizeof(chunk)));
+    data.append((const char *)chunk, sizeof(chunk));
+  }
+  TEST_ASSERT_TRUE(pdfEndImagePage(&doc));
+  ParsedPdf p = parse(file.bytes);
+  assertValid(p, 1);
+  TEST_ASSERT_TRUE(p.pages[0].image == data);
+  TEST_ASSERT_TRUE(p.pages[0].imageDict.find("/CCITTFaxDecode /DecodeParms << /K -1 /Columns 1728 /Rows 2200 >>") !=
+                   std::string::npos);
+  // No image open: data and end are refused
+  TEST_ASSERT_FALSE(pdfWriteImageData(&doc, (const uint8_t *)"x", 1));
+  TEST_ASSERT_FALSE(pdfEndImagePage(&doc));
+}
+
+// Pages 1-70: the root lists one group per 32 pages, every update is a
+// complete file, and an update's cost does not grow with the page number
+static void test_group_boundaries() {
+  std::vector<uint32_t> commits = {doc.committed};
+  std::vector<std::vector<uint8_t>> images;
+  std::vector<size_t> overhead = {0};
+  for (int i = 1; i <= 70; i++) {
+    images.push_back(jpeg(320, 240, 3, 200 + next() % 300));
+    uint32_t before = doc.offset;
+    TEST_ASSERT_TRUE(pdfAppendJpegPage(&doc, images.back().data(), images.back().size()));
+    overhead.push_back(doc.offset - before - images.back().size());
+    commits.push_back(doc.committed);
+    TEST_ASSERT_EQUAL_UINT32(i, doc.pageCount);
+
+    if (i % 32 == 0 || i % 32 == 1 || i == 70) {
+      ParsedPdf p = parse(file.bytes);
+      assertValid(p, i);
+      TEST_ASSERT_EQUAL((i + 31) / 32, p.rootKids);
+      for (int k = 0; k < i; k++)
+        TEST_ASSERT_TRUE(p.pages[k].image == std::string(images[k].begin(), images[k].end()));
+    }
+  }
+  // Page 33 starts a group: its update lists one page where page 32's
+  // listed 32 (31 fewer "NNN 0 R "). A full group at page 64 costs what it
+  // did at page 32, give or take a digit per reference and the root's
+  // extra kid.
+  TEST_ASSERT_LESS_OR_EQUAL(overhead[32] - 31 * 6, overhead[33]);
+  TEST_ASSERT_LESS_OR_EQUAL(overhead[32] + 32 + 16, overhead[64]);
+
+  // Every earlier update is a complete document with its own page count
+  for (size_t n = 0; n < commits.size(); n++) assertValid(parse(file.bytes.substr(0, commits[n])), n);
+}
+
+// The card fails part way through a page: the doc goes back to its last
+// update, the caller cuts the file there, and a retake lands after it
+static void test_abort_then_retake() {
+  std::vector<uint8_t> a = jpeg(640, 480, 3, 5000), b = jpeg(640, 480, 3, 5000);
+  TEST_ASSERT_TRUE(pdfAppendJpegPage(&doc, a.data(), a.size()));
+  uint32_t good = doc.committed;
+
+  // Every place the write can stop: in the image header, data, xref, trailer
+  size_t pageBytes;
+  {
+    MemFile probe = file;
+    PdfDoc d = doc;
+    d.ctx = &probe;
+    TEST_ASSERT_TRUE(pdfAppendJpegPage(&d, b.data(), b.size()));
+    pageBytes = probe.bytes.size() - good;
+  }
+  for (size_t cut = 0; cut < pageBytes; cut += cut < 200 || cut > pageBytes - 600 ? 7 : 997) {
+    MemFile f = file;
+    PdfDoc d = doc;
+    d.ctx = &f;
+    f.budget = (long)cut;
+    TEST_ASSERT_FALSE(pdfAppendJpegPage(&d, b.data(), b.size()));
+    TEST_ASSERT_TRUE(d.failed);
+    TEST_ASSERT_EQUAL_UINT32(1, d.pageCount);
+
+    pdfAbortPage(&d);
+    TEST_ASSERT_FALSE(d.failed);
+    TEST_ASSERT_EQUAL_UINT32(good, d.offset);
+    f.bytes.resize(d.offset); // docAddPage() truncates the file here
+    f.budget = -1;
+    TEST_ASSERT_TRUE(pdfAppendJpegPage(&d, b.data(), b.size()));
+    ParsedPdf p = parse(f.bytes);
+    assertValid(p, 2);
+    TEST_ASSERT_TRUE(p.pages[1].image == std::string(b.begin(), b.end()));
+    TEST_ASSERT_EQUAL(3, p.updates);
+  }
+
+  // A streamed page abandoned while open (binarisation failed part way)
+  TEST_ASSERT_TRUE(pdfBeginCcittPage(&doc, 100, 100));
+  TEST_ASSERT_TRUE(pdfWriteImageData(&doc, (const uint8_t *)"partial", 7));
+  pdfAbortPage(&doc);
+  file.bytes.resize(doc.offset);
+  TEST_ASSERT_TRUE(pdfAppendJpegPage(&doc, b.data(), b.size()));
+  assertValid(parse(file.bytes), 2);
+}
+
+// A file cut at any byte (power lost mid-write) goes back to the newest
+// update wholly before the cut, including when a half-written image holds
+// bytes that look like a trailer
+static void test_cut_points_after_truncation() {
+  std::vector<uint32_t> commits = {doc.committed};
+  for (int i = 0; i < 40; i++) {
+    std::vector<uint8_t> j = jpeg(320, 240, 3, 100 + next() % 1200);
+    if (i == 20) {
+      // Fake trailers in the entropy data, after a run of text so the whole
+      // trailer window reads as one: one pointing at the header, one at
+      // nothing
+      std::string fake = std::string(200, 'A') + "startxref\n0\n%%EOF\nstartxref\n99999999\n%%EOF\n";
+      j.insert(j.end() - 2, fake.begin(), fake.end());
+    }
+    TEST_ASSERT_TRUE(pdfAppendJpegPage(&doc, j.data(), j.size()));
+    commits.push_back(doc.committed);
+  }
+
+  size_t k = 0;
+  for (uint32_t len = 0; len <= file.bytes.size(); len++) {
+    while (k + 1 < commits.size() && commits[k + 1] <= len) k++;
+    uint32_t want = commits[0] <= len ? commits[k] : 0;
+    MemPrefix cut = {&file.bytes, len};
+    bool pages = false;
+    uint32_t got = pdfLastCommitted(memSource, &cut, len, &pages);
+    if (got != want) {
+      char msg[96];
+      snprintf(msg, sizeof(msg), "cut at %lu: found %lu, want %lu", (unsigned long)len, (unsigned long)got,
+               (unsigned long)want);
+      TEST_FAIL_MESSAGE(msg);
+    }
+    if (want) TEST_ASSERT_EQUAL(k > 0, pages);
+    // Sample the recovered file as a reader would see it
+    if (want && len % 509 == 0) assertValid(parse(file.bytes.substr(0, got)), k);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_document_is_valid);
+  RUN_TEST(test_jpeg_page_embeds_the_bytes);
+  RUN_TEST(test_streamed_ccitt_page);
+  RUN_TEST(test_group_boundaries);
+  RUN_TEST(test_abort_then_retake);
+  RUN_TEST(test_cut_points_after_truncation);
+  return UNITY_END();
+}
@@ -0,0 +1,234 @@
+// ============================================
+// Preview governor tests (pio test -e native -f test_preview_governor)
+// The governor takes every time from its caller, so these drive it with a
+// simulated microsecond clock: a frame loop that sleeps exactly what
+// governorWaitUs() asks, and load reported at chosen instants.
+// ============================================
+
+#include "display/preview_governor.h"
+#include <unity.h>
+
+// PREVIEW_TARGET_FPS 15, PREVIEW_MIN_FPS 4, hold 500 ms, +1 fps per 250 ms
+static const GovernorConfig CFG = {15, 4, 500, 250};
+#define MS 1000u
+
+static PreviewGovernor g;
+static uint32_t now;
+
+// The preview task's loop for `us`: wait as told, else start a frame that
+// takes `frameUs` of work
+static uint32_t runFor(uint32_t us, uint32_t frameUs = 10 * MS) {
+  uint32_t started = 0;
+  uint32_t end = now + us;
+  while ((int32_t)(end - now) > 0) {
+    uint32_t wait = governorWaitUs(&g, now);
+    if (wait) {
+      now += wait;
+      continue;
+    }
+    governorFrameStarted(&g, now);
+    started++;
+    now += frameUs;
+  }
+  return started;
+}
+
+void setUp() {
+  now = 5000 * MS;
+  governorInit(&g, CFG);
+  governorRestart(&g, now);
+}
+void tearDown() {}
+
+// ============================================
+// Cut
+// ============================================
+static void test_busy_cuts_a_quarter_once_per_hold() {
+  governorBusy(&g, now);
+  TEST_ASSERT_EQUAL_UINT8(12, g.capFps); // 15 - 15/4
+
+  // More load inside the hold period: no further cut
+  for (int i = 0; i < 10; i++) {
+    now += 40 * MS;
+    governorBusy(&g, now);
+  }
+  TEST_ASSERT_EQUAL_UINT8(12, g.capFps);
+  TEST_ASSERT_EQUAL_UINT32(1, g.cuts);
+
+  now += 100 * MS; // 500 ms since the cut
+  governorBusy(&g, now);
+  TEST_ASSERT_EQUAL_UINT8(9, g.capFps);
+}
+
+static void test_cuts_stop_at_the_floor() {
+  const uint8_t steps[] = {12, 9, 7, 6, 5, 4, 4, 4};
+  for (uint8_t want : steps) {
+    governorBusy(&g, now);
+    TEST_ASSERT_EQUAL_UINT8(want, g.capFps);
+    now += 500 * MS;
+  }
+  TEST_ASSERT_EQUAL_UINT32(6, g.cuts);
+  TEST_ASSERT_EQUAL_UINT32(8, g.busyEvents);
+}
+
+// ============================================
+// Hold
+// ============================================
+static void test_hold_keeps_cutting_and_blocks_recovery() {
+  governorHold(&g, true, now);
+  TEST_ASSERT_EQUAL_UINT8(12, g.capFps);
+
+  // Held for 5 s with nothing else reported: down to the floor and kept there
+  runFor(5000 * MS);
+  TEST_ASSERT_EQUAL_UINT8(CFG.minFps, g.capFps);
+
+  // Quiet time counts from the release, not from the last cut
+  governorHold(&g, false, now);
+  runFor(CFG.busyHoldMs * MS - 20 * MS);
+  TEST_ASSERT_EQUAL_UINT8(CFG.minFps, g.capFps);
+  runFor(100 * MS);
+  TEST_ASSERT_GREATER_THAN(CFG.minFps, g.capFps);
+}
+
+static void test_repeated_hold_is_one_busy_event() {
+  governorHold(&g, true, now);
+  governorHold(&g, true, now + 10 * MS);
+  TEST_ASSERT_EQUAL_UINT32(1, g.busyEvents);
+  governorHold(&g, false, now + 20 * MS);
+  governorHold(&g, false, now + 30 * MS);
+  TEST_ASSERT_FALSE(g.held);
+}
+
+// ============================================
+// Recover
+// ============================================
+static void test_recovers_one_fps_per_step_after_quiet() {
+  governorBusy(&g, now);
+  while (g.capFps > CFG.minFps) {
+    now += 500 * MS;
+    governorBusy(&g, now);
+  }
+  uint32_t quietFrom = now;
+
+  runFor(CFG.busyHoldMs * MS - 10 * MS);
+  TEST_ASSERT_EQUAL_UINT8(CFG.minFps, g.capFps);
+
+  // Once quiet for the hold time, +1 at a time, at least recoverMs apart
+  // (steps land on the frame loop's wakeups, so a little later)
+  uint8_t fps = g.capFps;
+  uint32_t lastStep = quietFrom;
+  while (g.capFps < CFG.targetFps && now - quietFrom < 10000 * MS) {
+    runFor(5 * MS, 1 * MS);
+    if (g.capFps == fps) continue;
+    TEST_ASSERT_EQUAL_UINT8(fps + 1, g.capFps);
+    if (fps > CFG.minFps) TEST_ASSERT_GREATER_OR_EQUAL(CFG.recoverMs * MS, g.lastStepUs - lastStep);
+    else TEST_ASSERT_GREATER_OR_EQUAL(CFG.busyHoldMs * MS, g.lastStepUs - quietFrom);
+    fps = g.capFps;
+    lastStep = g.lastStepUs;
+  }
+  TEST_ASSERT_EQUAL_UINT8(CFG.targetFps, g.capFps);
+  // Hold plus a step per fps, with at most one frame period of lag on each
+  uint32_t steps = CFG.targetFps - CFG.minFps;
+  TEST_ASSERT_LESS_OR_EQUAL(CFG.busyHoldMs * MS + steps * (CFG.recoverMs * MS + 1000000 / CFG.minFps),
+                            lastStep - quietFrom);
+
+  // Never past the target
+  runFor(5000 * MS);
+  TEST_ASSERT_EQUAL_UINT8(CFG.targetFps, g.capFps);
+}
+
+static void test_load_during_recovery_cuts_again() {
+  governorBusy(&g, now);
+  now += 500 * MS;
+  governorBusy(&g, now);
+  TEST_ASSERT_EQUAL_UINT8(9, g.capFps);
+  runFor(1000 * MS); // quiet 500 ms, then two steps
+  TEST_ASSERT_EQUAL_UINT8(11, g.capFps);
+  governorBusy(&g, now);
+  TEST_ASSERT_EQUAL_UINT8(9, g.capFps); // 11 - 11/4
+}
+
+// ============================================
+// Pacing and the cadence reset
+// ============================================
+static void test_paced_rate_and_yield() {
+  runFor(1000 * MS); // settle into the cadence, fill a window
+  uint32_t frames = runFor(3000 * MS, 20 * MS);
+  TEST_ASSERT_UINT_WITHIN(1, 45, frames);
+  TEST_ASSERT_UINT_WITHIN(2, 150, g.fpsX10);
+  // 20 ms of work in each 66.7 ms period: the rest is handed back
+  TEST_ASSERT_UINT_WITHIN(3, 70, g.yieldPct);
+}
+
+static void test_cadence_absorbs_jitter() {
+  const uint32_t period = 1000000 / CFG.targetFps;
+  governorFrameStarted(&g, now);
+  uint32_t first = now;
+  // Each frame starts a little late: the schedule stays on the first frame's grid
+  for (uint32_t i = 1; i <= 30; i++) {
+    now = first + i * period + 3 * MS;
+    TEST_ASSERT_EQUAL_UINT32(0, governorWaitUs(&g, now));
+    governorFrameStarted(&g, now);
+  }
+  now += 1 * MS;
+  TEST_ASSERT_EQUAL_UINT32(first + 31 * period - now, governorWaitUs(&g, now));
+}
+
+static void test_late_frame_restarts_cadence_without_burst() {
+  const uint32_t period = 1000000 / CFG.targetFps;
+  governorFrameStarted(&g, now);
+  // Stalled for several periods (an SD write): one frame, then a full
+  // period, not a run of catch-up frames
+  now += 5 * period + 7 * MS;
+  TEST_ASSERT_EQUAL_UINT32(0, governorWaitUs(&g, now));
+  governorFrameStarted(&g, now);
+  now += 1 * MS;
+  TEST_ASSERT_EQUAL_UINT32(period - 1 * MS, governorWaitUs(&g, now));
+}
+
+static void test_raise_shortens_a_pending_wait() {
+  // A floor of 1 fps, so one period outlasts the quiet time before a step
+  governorInit(&g, {15, 1, 200, 100});
+  governorBusy(&g, now);
+  while (g.capFps > 1) {
+    now += 200 * MS;
+    governorBusy(&g, now);
+  }
+  governorFrameStarted(&g, now); // next frame due in 1 s
+  now += 300 * MS;
+  // Quiet for the hold: up to 2 fps, and the wait is one new period, not 700 ms
+  TEST_ASSERT_EQUAL_UINT32(500 * MS, governorWaitUs(&g, now));
+  TEST_ASSERT_EQUAL_UINT8(2, g.capFps);
+}
+
+static void test_restart_forgets_pacing() {
+  governorFrameStarted(&g, now);
+  TEST_ASSERT_GREATER_THAN(0, governorWaitUs(&g, now + 1 * MS));
+  governorRestart(&g, now + 1 * MS);
+  TEST_ASSERT_EQUAL_UINT32(0, governorWaitUs(&g, now + 1 * MS));
+}
+
+static void test_cadence_across_clock_wrap() {
+  now = 0xFFFFFFFFu - 2000 * MS;
+  governorRestart(&g, now);
+  uint32_t frames = runFor(4000 * MS);
+  TEST_ASSERT_UINT_WITHIN(1, 60, frames);
+  TEST_ASSERT_UINT_WITHIN(2, 150, g.fpsX10);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_busy_cuts_a_quarter_once_per_hold);
+  RUN_TEST(test_cuts_stop_at_the_floor);
+  RUN_TEST(test_hold_keeps_cutting_and_blocks_recovery);
+  RUN_TEST(test_repeated_hold_is_one_busy_event);
+  RUN_TEST(test_recovers_one_fps_per_step_after_quiet);
+  RUN_TEST(test_load_during_recovery_cuts_again);
+  RUN_TEST(test_paced_rate_and_yield);
+  RUN_TEST(test_cadence_absorbs_jitter);
+  RUN_TEST(test_late_frame_restarts_cadence_without_burst);
+  RUN_TEST(test_raise_shortens_a_pending_wait);
+  RUN_TEST(test_restart_forgets_pacing);
+  RUN_TEST(test_cadence_across_clock_wrap);
+  return UNITY_END();
+}
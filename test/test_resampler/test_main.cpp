@@ -0,0 +1,266 @@
+// ============================================
+// Resampler tests (pio test -e native -f test_resampler)
+// The expanded-pixel row kernels against the scalar per-channel
+// references, then whole frames streamed in as decoder MCU blocks: output
+// compared with the references run over the frame, plus the bars, the
+// crop window and the emitted block shapes.
+// ============================================
+
+#include "imaging/resampler.h"
+#include <cstring>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static uint32_t expandRef(uint16_t p) {
+  return ((uint32_t)((p >> 5) & 0x3F) << 21) | ((uint32_t)(p >> 11) << 11) | (p & 0x1F);
+}
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+// ============================================
+// Kernels
+// ============================================
+static void test_row_h_matches_reference() {
+  const int SRC = 64, N = 200;
+  uint16_t src[SRC], idx[N];
+  uint8_t wt[N];
+  uint32_t kernel[N], ref[N];
+  for (int round = 0; round < 50; round++) {
+    for (int i = 0; i < SRC; i++) src[i] = (uint16_t)next();
+    if (round == 0) src[0] = 0xFFFF, src[1] = 0xFFFF; // every channel at full scale
+    for (int i = 0; i < N; i++) {
+      idx[i] = (uint16_t)(next() % (SRC - 1));
+      wt[i] = (uint8_t)(i <= 32 ? i : next() % 33); // each weight, 0 and 32 included
+    }
+    for (int n = 0; n <= N; n += round % 2 ? 7 : 1) {
+      memset(kernel, 0xA5, sizeof(kernel));
+      memset(ref, 0xA5, sizeof(ref));
+      resampleRowH(src, idx, wt, kernel, n);
+      resampleRowHRef(src, idx, wt, ref, n);
+      TEST_ASSERT_EQUAL_MEMORY(ref, kernel, sizeof(kernel));
+    }
+  }
+}
+
+static void test_row_v_matches_reference() {
+  const int N = 160;
+  uint32_t a[N], b[N];
+  uint16_t kernel[N + 1], ref[N + 1];
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < N; i++) {
+      a[i] = expandRef((uint16_t)next());
+      b[i] = expandRef(i == 0 ? 0xFFFF : (uint16_t)next());
+    }
+    for (int w = 0; w <= 32; w++) {
+      for (int swap = 0; swap < 2; swap++) {
+        memset(kernel, 0xA5, sizeof(kernel));
+        memset(ref, 0xA5, sizeof(ref));
+        resampleRowV(a, b, (uint8_t)w, kernel, N, swap);
+        resampleRowVRef(a, b, (uint8_t)w, ref, N, swap);
+        TEST_ASSERT_EQUAL_MEMORY(ref, kernel, sizeof(kernel));
+      }
+    }
+  }
+  // Swapped output is the plain output byte-swapped
+  uint16_t plain[N];
+  resampleRowV(a, b, 11, plain, N, false);
+  resampleRowV(a, b, 11, kernel, N, true);
+  for (int i = 0; i < N; i++) TEST_ASSERT_EQUAL_HEX16((uint16_t)(plain[i] >> 8 | plain[i] << 8), kernel[i]);
+  // Weight 0 and 32 give the row itself
+  resampleRowV(a, b, 0, kernel, 1, false);
+  TEST_ASSERT_EQUAL_UINT32(a[0], expandRef(kernel[0]));
+  resampleRowV(a, b, 32, kernel, 1, false);
+  TEST_ASSERT_EQUAL_HEX16(0xFFFF, kernel[0]);
+}
+
+// ============================================
+// Streaming
+// ============================================
+#define SRC_W 320
+#define SRC_H 240
+#define MCU 16
+
+static uint16_t frame[SRC_H][SRC_W];
+
+struct Screen {
+  uint16_t px[SRC_H][SRC_W];
+  std::vector<int> blockY, blockH;
+  bool fail;
+};
+
+static bool collect(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *pixels) {
+  Screen *s = (Screen *)ctx;
+  s->blockY.push_back(y);
+  s->blockH.push_back(h);
+  for (uint16_t r = 0; r < h; r++) memcpy(&s->px[y + r][x], pixels + (uint32_t)r * w, sizeof(uint16_t) * w);
+  return !s->fail;
+}
+
+// Frame in 16x16 MCUs in raster order; with `clip`, only the blocks the
+// source rect needs, as the decoder is asked to do
+static bool stream(const ResampleConfig &cfg, Screen *screen, bool clip = false) {
+  std::vector<uint32_t> work((resampleWorkBytes(cfg) + 3) / 4, 0xA5A5A5A5u); // not zeroed on the device
+  ResampleState s;
+  TEST_ASSERT_TRUE(resampleInit(&s, cfg, work.data(), collect, screen));
+  uint16_t rx, ry, rw, rh;
+  resampleSourceRect(&s, &rx, &ry, &rw, &rh);
+
+  uint16_t block[MCU * MCU];
+  for (int y = 0; y < SRC_H; y += MCU) {
+    for (int x = 0; x < SRC_W; x += MCU) {
+      if (clip && (x + MCU <= rx || x >= rx + rw || y + MCU <= ry || y >= ry + rh)) continue;
+      for (int r = 0; r < MCU; r++) memcpy(block + r * MCU, &frame[y + r][x], sizeof(block) / MCU);
+      if (!resamplePushBlock(&s, (int16_t)x, (int16_t)y, MCU, MCU, block)) return false;
+    }
+  }
+  return resampleFinish(&s);
+}
+
+static ResampleConfig config(uint16_t dstW, uint16_t dstH, uint8_t fit, uint8_t blockRows) {
+  ResampleConfig c = {};
+  c.srcW = SRC_W;
+  c.srcH = SRC_H;
+  c.dstW = dstW;
+  c.dstH = dstH;
+  c.fit = fit;
+  c.bandRows = MCU;
+  c.blockRows = blockRows;
+  return c;
+}
+
+static void fillFrame() {
+  for (int y = 0; y < SRC_H; y++)
+    for (int x = 0; x < SRC_W; x++) frame[y][x] = (uint16_t)next();
+}
+
+// Half size, letterboxed: 2x2 averages between black bars, against the
+// references over the whole frame. A square box gets bars top and bottom,
+// a wide one bars either side.
+static void test_letterbox_half_matches_reference() {
+  fillFrame();
+  static uint16_t idx[SRC_W / 2];
+  static uint8_t wt[SRC_W / 2];
+  for (int i = 0; i < SRC_W / 2; i++) {
+    idx[i] = (uint16_t)(2 * i);
+    wt[i] = 16;
+  }
+  const uint16_t boxes[][2] = {{160, 160}, {200, 120}};
+  for (const auto &box : boxes) {
+    const int bw = box[0], bh = box[1], barX = (bw - 160) / 2, barY = (bh - 120) / 2;
+    for (int swap = 0; swap < 2; swap++) {
+      static Screen screen;
+      memset(screen.px, 0x5A, sizeof(screen.px));
+      screen.blockY.clear();
+      screen.blockH.clear();
+      screen.fail = false;
+      ResampleConfig cfg = config(bw, bh, RESAMPLE_FIT_LETTERBOX, 10);
+      cfg.dstX = 40;
+      cfg.dstY = 30;
+      cfg.swapOut = swap;
+      TEST_ASSERT_TRUE(stream(cfg, &screen));
+
+      uint32_t top[SRC_W / 2], bottom[SRC_W / 2];
+      uint16_t want[SRC_W / 2];
+      for (int j = 0; j < bh; j++) {
+        const uint16_t *got = &screen.px[30 + j][40];
+        int sy = 2 * (j - barY);
+        for (int i = 0; i < bw; i++) {
+          bool bar = j < barY || j >= barY + 120 || i < barX || i >= barX + 160;
+          if (bar) TEST_ASSERT_EQUAL_HEX16(0, got[i]);
+        }
+        if (j < barY || j >= barY + 120) continue;
+        resampleRowHRef(frame[sy], idx, wt, top, SRC_W / 2);
+        resampleRowHRef(frame[sy + 1], idx, wt, bottom, SRC_W / 2);
+        resampleRowVRef(top, bottom, 16, want, SRC_W / 2, swap);
+        TEST_ASSERT_EQUAL_MEMORY(want, got + barX, sizeof(want));
+      }
+      // Nothing drawn outside the box
+      TEST_ASSERT_EQUAL_HEX16(0x5A5A, screen.px[29][40]);
+      TEST_ASSERT_EQUAL_HEX16(0x5A5A, screen.px[30 + bh][40]);
+      TEST_ASSERT_EQUAL_HEX16(0x5A5A, screen.px[30][39]);
+      TEST_ASSERT_EQUAL_HEX16(0x5A5A, screen.px[30][40 + bw]);
+      TEST_ASSERT_EQUAL(bh / 10, (int)screen.blockY.size());
+    }
+  }
+}
+
+// Same size into a narrower box, cropped: the centre columns exactly, with
+// only the blocks inside the source rect decoded
+static void test_crop_at_full_scale_is_exact() {
+  fillFrame();
+  static Screen screen;
+  memset(screen.px, 0, sizeof(screen.px));
+  screen.fail = false;
+  ResampleConfig cfg = config(240, 240, RESAMPLE_FIT_CROP, 16);
+
+  std::vector<uint32_t> work((resampleWorkBytes(cfg) + 3) / 4);
+  ResampleState s;
+  TEST_ASSERT_TRUE(resampleInit(&s, cfg, work.data(), collect, &screen));
+  uint16_t rx, ry, rw, rh;
+  resampleSourceRect(&s, &rx, &ry, &rw, &rh);
+  TEST_ASSERT_EQUAL_UINT16(40, rx);
+  TEST_ASSERT_EQUAL_UINT16(0, ry);
+  TEST_ASSERT_GREATER_OR_EQUAL(240, rw);
+  TEST_ASSERT_LESS_OR_EQUAL(SRC_W, rx + rw);
+
+  TEST_ASSERT_TRUE(stream(cfg, &screen, true));
+  for (int y = 0; y < 240; y++) TEST_ASSERT_EQUAL_MEMORY(&frame[y][40], screen.px[y], 240 * sizeof(uint16_t));
+}
+
+// Full-width blocks of blockRows in order, only the last shorter
+static void test_blocks_are_full_width_in_order() {
+  fillFrame();
+  static Screen screen;
+  screen.blockY.clear();
+  screen.blockH.clear();
+  screen.fail = false;
+  TEST_ASSERT_TRUE(stream(config(160, 120, RESAMPLE_FIT_LETTERBOX, 7), &screen));
+  TEST_ASSERT_EQUAL(18, (int)screen.blockH.size()); // 17 x 7 + 1
+  for (size_t i = 0; i < screen.blockH.size(); i++) {
+    TEST_ASSERT_EQUAL((int)i * 7, screen.blockY[i]);
+    TEST_ASSERT_EQUAL(i + 1 < screen.blockH.size() ? 7 : 1, screen.blockH[i]);
+  }
+}
+
+static void test_emit_failure_stops_the_frame() {
+  fillFrame();
+  static Screen screen;
+  screen.blockY.clear();
+  screen.blockH.clear();
+  screen.fail = true;
+  TEST_ASSERT_FALSE(stream(config(160, 120, RESAMPLE_FIT_LETTERBOX, 8), &screen));
+  TEST_ASSERT_EQUAL(1, (int)screen.blockH.size());
+}
+
+static void test_init_rejects_bad_config() {
+  uint32_t work[64];
+  ResampleState s;
+  Screen *screen = nullptr;
+  ResampleConfig c = config(160, 120, RESAMPLE_FIT_CROP, 8);
+  c.srcW = 1;
+  TEST_ASSERT_FALSE(resampleInit(&s, c, work, collect, screen));
+  c = config(160, 120, RESAMPLE_FIT_CROP, 0);
+  TEST_ASSERT_FALSE(resampleInit(&s, c, work, collect, screen));
+  c = config(160, 120, RESAMPLE_FIT_CROP, 8);
+  TEST_ASSERT_FALSE(resampleInit(&s, c, nullptr, collect, screen));
+  TEST_ASSERT_FALSE(resampleInit(&s, c, work, nullptr, screen));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_row_h_matches_reference);
+  RUN_TEST(test_row_v_matches_reference);
+  RUN_TEST(test_letterbox_half_matches_reference);
+  RUN_TEST(test_crop_at_full_scale_is_exact);
+  RUN_TEST(test_blocks_are_full_width_in_order);
+  RUN_TEST(test_emit_failure_stops_the_frame);
+  RUN_TEST(test_init_rejects_bad_config);
+  return UNITY_END();
+}
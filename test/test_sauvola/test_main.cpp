@@ -0,0 +1,234 @@
+// ============================================
+// Sauvola tests (pio test -e native -f test_sauvola -v)
+// The streaming thresholder against a direct per-pixel reference: every
+// window summed from scratch, clamped at the borders, threshold in double.
+// The kernel works in float, so pixels within a hair of the threshold may
+// go either way; anything further off must match. Also the radius-row
+// delay, the emit count and a failing sink.
+// ============================================
+
+#include "imaging/sauvola.h"
+#include "config.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+// Uneven lighting, paper grain and dark strokes: what the bilevel path sees
+static std::vector<uint8_t> page(int w, int h) {
+  std::vector<uint8_t> p((size_t)w * h);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      int paper = 120 + 100 * x / (w + 1) - 40 * y / (h + 1);
+      p[(size_t)y * w + x] = (uint8_t)(paper + (int)(next() % 13) - 6);
+    }
+  }
+  for (int strokes = w * h / 150; strokes > 0; strokes--) {
+    int x0 = next() % w, y0 = next() % h, len = 2 + next() % 14;
+    bool vertical = next() & 1;
+    int ink = 20 + next() % 60;
+    for (int i = 0; i < len; i++) {
+      int x = vertical ? x0 : x0 + i, y = vertical ? y0 + i : y0;
+      if (x < w && y < h) p[(size_t)y * w + x] = (uint8_t)ink;
+    }
+  }
+  return p;
+}
+
+struct Output {
+  int width;
+  int failAt;      // emit returns false for this row (-1: never)
+  std::vector<std::vector<uint8_t>> rows;
+};
+
+static bool collect(void *ctx, const uint8_t *bits) {
+  Output *o = (Output *)ctx;
+  o->rows.emplace_back(bits, bits + (o->width + 7) / 8);
+  return (int)o->rows.size() - 1 != o->failAt;
+}
+
+static void run(const std::vector<uint8_t> &img, int w, int h, const SauvolaConfig &cfg, Output *out) {
+  std::vector<uint32_t> work((sauvolaWorkBytes(w, cfg.radius) + 3) / 4);
+  SauvolaState s;
+  out->width = w;
+  TEST_ASSERT_TRUE(sauvolaInit(&s, w, cfg, work.data(), collect, out));
+  for (int y = 0; y < h; y++) {
+    TEST_ASSERT_TRUE(sauvolaPushRow(&s, &img[(size_t)y * w]));
+    // Row y comes out once rows up to y + r are in
+    TEST_ASSERT_EQUAL(y + 1 > cfg.radius ? y + 1 - cfg.radius : 0, (int)out->rows.size());
+  }
+  TEST_ASSERT_TRUE(sauvolaFinish(&s));
+  TEST_ASSERT_EQUAL(h, (int)out->rows.size());
+  TEST_ASSERT_EQUAL_UINT32(h, s.rowsOut);
+}
+
+// Signed distance of pixel (x, y) below its Sauvola threshold
+static double reference(const std::vector<uint8_t> &img, int w, int h, const SauvolaConfig &cfg, int x, int y) {
+  const int r = cfg.radius;
+  int x0 = x - r < 0 ? 0 : x - r, x1 = x + r >= w ? w - 1 : x + r;
+  int y0 = y - r < 0 ? 0 : y - r, y1 = y + r >= h ? h - 1 : y + r;
+  double sum = 0, sq = 0;
+  for (int yy = y0; yy <= y1; yy++) {
+    for (int xx = x0; xx <= x1; xx++) {
+      double v = img[(size_t)yy * w + xx];
+      sum += v;
+      sq += v * v;
+    }
+  }
+  double n = (double)(x1 - x0 + 1) * (y1 - y0 + 1);
+  double m = sum / n, var = sq / n - m * m;
+  double k = cfg.k100 / 100.0;
+  double t = m * (1 + k * (std::sqrt(var > 0 ? var : 0) / cfg.range - 1));
+  return t - img[(size_t)y * w + x];
+}
+
+// Uniform noise: pixels at every distance from the threshold, so a window
+// one column or row off shows up
+static std::vector<uint8_t> noise(int w, int h) {
+  std::vector<uint8_t> p((size_t)w * h);
+  for (uint8_t &v : p) v = (uint8_t)next();
+  return p;
+}
+
+// Compare one page; returns how many pixels landed on the threshold's edge
+static int compare(const std::vector<uint8_t> &img, int w, int h, const SauvolaConfig &cfg) {
+  Output out;
+  out.failAt = -1;
+  run(img, w, h, cfg, &out);
+  int close = 0;
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      double d = reference(img, w, h, cfg, x, y);
+      bool ink = (out.rows[y][x >> 3] & (0x80 >> (x & 7))) != 0;
+      if (std::fabs(d) < 0.05) {
+        close++;
+        continue;
+      }
+      if (ink != (d > 0)) {
+        char msg[120];
+        snprintf(msg, sizeof(msg), "r=%d %dx%d pixel (%d,%d): %.3f below threshold, ink=%d", cfg.radius, w, h,
+                 x, y, d, ink);
+        TEST_FAIL_MESSAGE(msg);
+      }
+    }
+    // Padding bits stay clear
+    if (w & 7) TEST_ASSERT_EQUAL_HEX8(0, out.rows[y][w / 8] & (0xFF >> (w & 7)));
+  }
+  return close;
+}
+
+// ============================================
+// Against the reference
+// ============================================
+static void test_matches_reference_at_config_radius() {
+  const SauvolaConfig cfg = {BILEVEL_RADIUS, BILEVEL_K100, BILEVEL_RANGE};
+  int close = compare(page(203, 90), 203, 90, cfg);
+  TEST_ASSERT_LESS_THAN(203 * 90 / 1000, close);
+  close = compare(noise(203, 90), 203, 90, cfg);
+  TEST_ASSERT_LESS_THAN(203 * 90 / 1000, close);
+}
+
+static void test_matches_reference_across_radii_and_sizes() {
+  const uint8_t radii[] = {0, 1, 2, 5, 20};
+  const int sizes[][2] = {{1, 1}, {1, 30}, {30, 1}, {7, 3}, {9, 50}, {64, 41}};
+  for (uint8_t r : radii) {
+    for (const auto &sz : sizes) {
+      const SauvolaConfig cfg = {r, (uint8_t)(10 + next() % 50), (uint8_t)(64 + next() % 128)};
+      compare(page(sz[0], sz[1]), sz[0], sz[1], cfg);
+      compare(noise(sz[0], sz[1]), sz[0], sz[1], cfg);
+    }
+  }
+}
+
+// Flat paper of any brightness has no ink; a dark line on it does
+static void test_flat_paper_is_white() {
+  const int w = 40, h = 30;
+  const SauvolaConfig cfg = {BILEVEL_RADIUS, BILEVEL_K100, BILEVEL_RANGE};
+  const uint8_t levels[] = {0, 30, 128, 255};
+  for (uint8_t level : levels) {
+    std::vector<uint8_t> img((size_t)w * h, level);
+    Output out;
+    out.failAt = -1;
+    run(img, w, h, cfg, &out);
+    for (const auto &row : out.rows)
+      for (uint8_t b : row) TEST_ASSERT_EQUAL_HEX8(0, b);
+  }
+  std::vector<uint8_t> img((size_t)w * h, 200);
+  for (int x = 0; x < w; x++) img[15 * w + x] = 40;
+  Output out;
+  out.failAt = -1;
+  run(img, w, h, cfg, &out);
+  for (int y = 0; y < h; y++) TEST_ASSERT_EQUAL_HEX8(y == 15 ? 0xFF : 0x00, out.rows[y][0]);
+}
+
+// ============================================
+// Plumbing
+// ============================================
+static void test_emit_failure_propagates() {
+  const int w = 16, h = 20;
+  const SauvolaConfig cfg = {3, 34, 128};
+  std::vector<uint8_t> img = page(w, h);
+  std::vector<uint32_t> work((sauvolaWorkBytes(w, cfg.radius) + 3) / 4);
+  SauvolaState s;
+
+  // Refused while pushing
+  Output out;
+  out.width = w;
+  out.failAt = 2;
+  TEST_ASSERT_TRUE(sauvolaInit(&s, w, cfg, work.data(), collect, &out));
+  int y = 0;
+  while (y < h && sauvolaPushRow(&s, &img[(size_t)y * w])) y++;
+  TEST_ASSERT_EQUAL(2 + cfg.radius, y);
+
+  // Refused in the tail
+  out.rows.clear();
+  out.failAt = h - 2;
+  TEST_ASSERT_TRUE(sauvolaInit(&s, w, cfg, work.data(), collect, &out));
+  for (y = 0; y < h; y++) TEST_ASSERT_TRUE(sauvolaPushRow(&s, &img[(size_t)y * w]));
+  TEST_ASSERT_FALSE(sauvolaFinish(&s));
+  TEST_ASSERT_EQUAL(h - 1, (int)out.rows.size());
+
+  TEST_ASSERT_FALSE(sauvolaInit(&s, 0, cfg, work.data(), collect, &out));
+  TEST_ASSERT_FALSE(sauvolaInit(&s, w, cfg, nullptr, collect, &out));
+  const SauvolaConfig noRange = {3, 34, 0};
+  TEST_ASSERT_FALSE(sauvolaInit(&s, w, noRange, work.data(), collect, &out));
+}
+
+// A UXGA page at the configured radius: work buffer and time per page
+static void test_page_cost() {
+  const int w = 1600, h = 1200;
+  const SauvolaConfig cfg = {BILEVEL_RADIUS, BILEVEL_K100, BILEVEL_RANGE};
+  std::vector<uint8_t> img = page(w, h);
+  std::vector<uint32_t> work((sauvolaWorkBytes(w, cfg.radius) + 3) / 4);
+  SauvolaState s;
+  TEST_ASSERT_TRUE(sauvolaInit(&s, w, cfg, work.data(), nullptr, nullptr));
+  auto t0 = std::chrono::steady_clock::now();
+  for (int y = 0; y < h; y++) sauvolaPushRow(&s, &img[(size_t)y * w]);
+  sauvolaFinish(&s);
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  TEST_ASSERT_EQUAL_UINT32(h, s.rowsOut);
+  char line[120];
+  snprintf(line, sizeof(line), "1600x1200 r=%d: %u work bytes, %.1f ms", cfg.radius,
+           (unsigned)sauvolaWorkBytes(w, cfg.radius), ms);
+  TEST_MESSAGE(line);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_matches_reference_at_config_radius);
+  RUN_TEST(test_matches_reference_across_radii_and_sizes);
+  RUN_TEST(test_flat_paper_is_white);
+  RUN_TEST(test_emit_failure_propagates);
+  RUN_TEST(test_page_cost);
+  return UNITY_END();
+}
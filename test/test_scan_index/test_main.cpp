@@ -0,0 +1,512 @@
+// ============================================
+// Scan index tests (pio test -e native -f test_scan_index -v)
+// The index over a fake card and journal, the way the firmware keeps it:
+// files queued and uploaded, some before the first build (journal only),
+// some after. Desktop clients sync with changes() and are checked against
+// the listing: across a journal compaction, an index rebuilt from the
+// compacted journal, and the tombstone ring overflowing. Paging while
+// scans are added, and a queue of thousands of files timed.
+// ============================================
+
+#include "storage/scan_index.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+// ============================================
+// Fake card
+// ============================================
+struct Record {
+  ScanOp op;
+  uint32_t gen, key, size, crc, floor;
+  std::string name;
+};
+
+class FakeCard : public GalleryStore, public ScanJournal {
+public:
+  std::vector<std::string> files;   // queue directory
+  std::vector<Record> journalRecords;
+  uint32_t listings = 0, replays = 0, rewrites = 0;
+
+  void erase(const std::string &name) {
+    for (auto &f : files)
+      if (f == name) f.clear();
+  }
+
+  bool list(void (*fn)(void *ctx, const char *name), void *ctx) override {
+    listings++;
+    for (auto &f : files)
+      if (!f.empty()) fn(ctx, f.c_str());
+    return true;
+  }
+  bool listThumbs(void (*fn)(void *ctx, uint32_t key), void *ctx) override { return false; }
+  int32_t readThumb(uint32_t key, uint8_t *buf, size_t cap) override { return -1; }
+
+  bool replay(void (*fn)(void *ctx, const ScanRecord &r), void *ctx) override {
+    replays++;
+    for (const Record &rec : journalRecords) {
+      ScanRecord r = {rec.op, rec.gen, rec.key, rec.name.c_str(), rec.size, rec.crc, rec.floor};
+      fn(ctx, r);
+    }
+    return true;
+  }
+  bool append(const ScanRecord &r) override {
+    journalRecords.push_back({r.op, r.gen, r.key, r.size, r.crc, r.floor, r.name ? r.name : ""});
+    return true;
+  }
+  bool rewrite(bool (*next)(void *ctx, ScanRecord *r), void *ctx) override {
+    rewrites++;
+    std::vector<Record> out;
+    ScanRecord r;
+    while (next(ctx, &r)) out.push_back({r.op, r.gen, r.key, r.size, r.crc, r.floor, r.name ? r.name : ""});
+    journalRecords.swap(out);
+    return true;
+  }
+};
+
+static const uint16_t MAX_SCANS = SCAN_INDEX_MAX;
+static ScanEntry entriesA[MAX_SCANS], entriesB[MAX_SCANS];
+static uint32_t keysA[MAX_SCANS], keysB[MAX_SCANS];
+
+static FakeCard *card;
+static ScanIndex *index_;
+static std::vector<std::string> queued; // oldest first
+static uint32_t serial = 0;
+
+// What storage.cpp does on a save and an upload
+static std::string queueScan() {
+  char name[GALLERY_NAME_MAX];
+  snprintf(name, sizeof(name), "scan_%lu_%lu.jpg", (unsigned long)(next() % 100000),
+           (unsigned long)++serial);
+  card->files.push_back(name);
+  index_->add(name, 1000 + next() % 1000, next());
+  queued.push_back(name);
+  return name;
+}
+
+static void rewriteScan(const std::string &name) { index_->add(name.c_str(), 1000 + next() % 1000, next()); }
+
+static void uploadScan(size_t i) {
+  card->erase(queued[i]);
+  index_->remove(queued[i].c_str());
+  queued.erase(queued.begin() + i);
+}
+
+// Every entry, newest first
+static std::vector<ScanEntry> listing(ScanIndex &ix) {
+  std::vector<ScanEntry> out;
+  ScanEntry page[50];
+  uint32_t cursor = 0, nextCursor;
+  uint16_t total;
+  do {
+    int32_t n = ix.page(cursor, page, 50, &nextCursor, &total);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, n);
+    out.insert(out.end(), page, page + n);
+    cursor = nextCursor;
+  } while (cursor);
+  return out;
+}
+
+// ============================================
+// A syncing client
+// ============================================
+struct Client {
+  std::map<uint32_t, ScanEntry> files;
+  uint32_t gen = 0;
+};
+
+// One /api/sync round, `pageSize` changes at a time; true if told to start over
+static bool sync(ScanIndex &ix, Client &c, uint16_t pageSize = 37) {
+  static ScanChange buf[64];
+  uint32_t cursor = 0, nextCursor, generation, firstGen = 0;
+  bool reset, wasReset = false;
+  do {
+    int32_t n = ix.changes(c.gen, cursor, buf, pageSize, &reset, &nextCursor, &generation);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, n);
+    if (cursor == 0) {
+      wasReset = reset;
+      firstGen = generation;
+      if (reset) c.files.clear();
+    }
+    for (int32_t i = 0; i < n; i++) {
+      if (buf[i].removed) c.files.erase(buf[i].entry.key);
+      else c.files[buf[i].entry.key] = buf[i].entry;
+    }
+    cursor = nextCursor;
+  } while (cursor);
+  c.gen = firstGen;
+  return wasReset;
+}
+
+static void assertClientCurrent(ScanIndex &ix, const Client &c) {
+  std::vector<ScanEntry> all = listing(ix);
+  TEST_ASSERT_EQUAL(all.size(), c.files.size());
+  for (const ScanEntry &e : all) {
+    auto it = c.files.find(e.key);
+    TEST_ASSERT_TRUE(it != c.files.end());
+    TEST_ASSERT_EQUAL_STRING(e.name, it->second.name);
+    TEST_ASSERT_EQUAL_UINT32(e.gen, it->second.gen);
+    TEST_ASSERT_EQUAL_UINT32(e.size, it->second.size);
+    TEST_ASSERT_EQUAL_UINT32(e.crc, it->second.crc);
+  }
+}
+
+// The listing is the queue, newest first, whichever index it comes from
+static void assertListing(ScanIndex &ix) {
+  std::vector<ScanEntry> all = listing(ix);
+  TEST_ASSERT_EQUAL(queued.size(), all.size());
+  for (size_t i = 0; i < all.size(); i++) {
+    TEST_ASSERT_EQUAL_STRING(queued[queued.size() - 1 - i].c_str(), all[i].name);
+    if (i) TEST_ASSERT_LESS_THAN(all[i - 1].gen, all[i].gen);
+  }
+}
+
+static void sameAnswers(ScanIndex &a, ScanIndex &b) {
+  std::vector<ScanEntry> la = listing(a), lb = listing(b);
+  TEST_ASSERT_EQUAL(la.size(), lb.size());
+  for (size_t i = 0; i < la.size(); i++) {
+    TEST_ASSERT_EQUAL_STRING(la[i].name, lb[i].name);
+    TEST_ASSERT_EQUAL_UINT32(la[i].gen, lb[i].gen);
+    TEST_ASSERT_EQUAL_UINT32(la[i].crc, lb[i].crc);
+  }
+  ScanIndexStats sa, sb;
+  a.getStats(&sa);
+  b.getStats(&sb);
+  TEST_ASSERT_EQUAL_UINT32(sa.generation, sb.generation);
+  TEST_ASSERT_EQUAL_UINT32(sa.floor, sb.floor);
+}
+
+static ScanIndex *rebuilt() {
+  static ScanIndex *other = nullptr;
+  delete other;
+  other = new ScanIndex();
+  TEST_ASSERT_TRUE(other->attach(card, card, entriesB, keysB, MAX_SCANS));
+  return other;
+}
+
+static ScanIndexStats stats(ScanIndex &ix) {
+  ScanIndexStats st;
+  ix.getStats(&st);
+  return st;
+}
+
+void setUp() {
+  rng = 1;
+  serial = 0;
+  queued.clear();
+  card = new FakeCard();
+  index_ = new ScanIndex();
+  TEST_ASSERT_TRUE(index_->attach(card, card, entriesA, keysA, MAX_SCANS));
+}
+void tearDown() {
+  delete index_;
+  delete card;
+}
+
+// ============================================
+// Build and replay
+// ============================================
+static void test_replay_matches_what_was_kept_live() {
+  // Journal only: nothing asked for the index yet
+  for (int i = 0; i < 60; i++) queueScan();
+  for (int i = 0; i < 20; i++) uploadScan(next() % queued.size());
+  TEST_ASSERT_FALSE(stats(*index_).built);
+  TEST_ASSERT_EQUAL_UINT32(0, card->listings);
+
+  assertListing(*index_);
+  TEST_ASSERT_EQUAL_UINT32(1, card->listings);
+  TEST_ASSERT_EQUAL_UINT32(80, stats(*index_).generation);
+
+  // Kept current from here on, without the card being read again
+  for (int i = 0; i < 30; i++) queueScan();
+  for (int i = 0; i < 25; i++) uploadScan(next() % queued.size());
+  rewriteScan(queued[3]);
+  std::string moved = queued[3];
+  queued.erase(queued.begin() + 3);
+  queued.push_back(moved);
+  assertListing(*index_);
+  TEST_ASSERT_EQUAL_UINT32(1, card->listings);
+
+  // After a reboot the journal alone gives the same index
+  ScanIndex *again = rebuilt();
+  sameAnswers(*index_, *again);
+  assertListing(*again);
+  ScanEntry e;
+  TEST_ASSERT_TRUE(again->find(galleryKey(moved.c_str()), &e));
+  TEST_ASSERT_EQUAL_STRING(moved.c_str(), e.name);
+  TEST_ASSERT_FALSE(again->find(0x12345678, &e));
+}
+
+// Deleted behind the firmware's back, or queued by older firmware
+static void test_card_squared_with_journal() {
+  for (int i = 0; i < 10; i++) queueScan();
+  card->erase(queued[2]);
+  std::string gone = queued[2];
+  queued.erase(queued.begin() + 2);
+  card->files.push_back("IMG_0001.JPG");
+  queued.push_back("IMG_0001.JPG");
+
+  assertListing(*index_);
+  ScanIndexStats st = stats(*index_);
+  TEST_ASSERT_EQUAL_UINT32(1, st.ghosts);
+  TEST_ASSERT_EQUAL_UINT32(1, st.adopted);
+  TEST_ASSERT_EQUAL_UINT32(12, st.generation); // ghost removed, then adopted
+  ScanEntry e;
+  TEST_ASSERT_TRUE(index_->find(galleryKey("IMG_0001.JPG"), &e));
+  TEST_ASSERT_EQUAL_UINT32(0, e.size); // not known without reading it back
+
+  // What the pass found went into the journal, so the next boot agrees
+  sameAnswers(*index_, *rebuilt());
+  TEST_ASSERT_EQUAL_UINT32(0, stats(*rebuilt()).ghosts);
+
+  Client c;
+  c.gen = 9; // saw the first nine saves
+  TEST_ASSERT_FALSE(sync(*index_, c));
+  TEST_ASSERT_EQUAL(2, c.files.size()); // the tenth, the adopted file
+  TEST_ASSERT_EQUAL_UINT32(12, c.gen);
+}
+
+// ============================================
+// Sync: compaction and tombstones
+// ============================================
+static void test_changes_across_a_compaction() {
+  for (int i = 0; i < 200; i++) queueScan();
+  Client early, late;
+  TEST_ASSERT_TRUE(sync(*index_, early));
+  assertClientCurrent(*index_, early);
+  uint32_t compactions = stats(*index_).compactions;
+
+  // Uploads, saves, and a few documents written over and over until the
+  // journal is mostly history
+  for (int i = 0; i < 15; i++) uploadScan(next() % queued.size());
+  for (int i = 0; i < 15; i++) queueScan();
+  TEST_ASSERT_TRUE(sync(*index_, late));
+  for (int round = 0; stats(*index_).compactions == compactions; round++) {
+    TEST_ASSERT_LESS_THAN(2000, round);
+    rewriteScan(queued[next() % 5]);
+  }
+  for (int i = 0; i < 10; i++) uploadScan(next() % queued.size());
+  for (int i = 0; i < 10; i++) queueScan();
+  TEST_ASSERT_LESS_THAN(queued.size() + 40 + 64, card->journalRecords.size());
+
+  // Both clients catch up without starting over, pages of any size
+  Client early2 = early;
+  TEST_ASSERT_FALSE(sync(*index_, early));
+  assertClientCurrent(*index_, early);
+  TEST_ASSERT_FALSE(sync(*index_, early2, 1));
+  assertClientCurrent(*index_, early2);
+  TEST_ASSERT_FALSE(sync(*index_, late));
+  assertClientCurrent(*index_, late);
+
+  // ...and so would they from the compacted journal after a reboot
+  ScanIndex *again = rebuilt();
+  sameAnswers(*index_, *again);
+  Client fromEarly;
+  TEST_ASSERT_TRUE(sync(*again, fromEarly));
+  for (int i = 0; i < 5; i++) uploadScan(next() % queued.size());
+  queueScan();
+  Client stale = early;
+  // `again` knows nothing of these last changes: this index does
+  TEST_ASSERT_FALSE(sync(*index_, stale));
+  assertClientCurrent(*index_, stale);
+
+  // Nothing new: an empty answer at the same generation
+  uint32_t gen = stale.gen;
+  TEST_ASSERT_FALSE(sync(*index_, stale));
+  TEST_ASSERT_EQUAL_UINT32(gen, stale.gen);
+}
+
+static void test_tombstone_eviction_starts_clients_over() {
+  for (int i = 0; i < 400; i++) queueScan();
+  Client behind, justBefore, atFloor;
+  sync(*index_, behind);
+
+  // Uploads past what the ring holds; two clients sync along the way
+  std::vector<uint32_t> genAfter;
+  for (int i = 0; i < SCAN_TOMBSTONES + 44; i++) {
+    uploadScan(0);
+    genAfter.push_back(stats(*index_).generation);
+    if (i == 42) sync(*index_, justBefore);
+    if (i == 43) sync(*index_, atFloor);
+  }
+  ScanIndexStats st = stats(*index_);
+  TEST_ASSERT_EQUAL_UINT32(genAfter[43], st.floor);
+  TEST_ASSERT_EQUAL_UINT32(genAfter[42], justBefore.gen);
+
+  // Saw the newest removal forgotten: still answered with changes
+  TEST_ASSERT_FALSE(sync(*index_, atFloor));
+  assertClientCurrent(*index_, atFloor);
+  // Missed it: starts over, as does the client from before the uploads
+  TEST_ASSERT_TRUE(sync(*index_, justBefore));
+  assertClientCurrent(*index_, justBefore);
+  TEST_ASSERT_TRUE(sync(*index_, behind));
+  assertClientCurrent(*index_, behind);
+
+  // A generation from another card, newer than this one's
+  Client alien;
+  alien.gen = st.generation + 1;
+  alien.files[1] = ScanEntry();
+  TEST_ASSERT_TRUE(sync(*index_, alien));
+  assertClientCurrent(*index_, alien);
+
+  // The floor survives a reboot
+  sameAnswers(*index_, *rebuilt());
+}
+
+// ============================================
+// Paging
+// ============================================
+static void test_pages_stay_stable_while_scans_change() {
+  for (int i = 0; i < 100; i++) queueScan();
+  std::vector<ScanEntry> before = listing(*index_);
+
+  // New saves land above the first page; removals just drop out
+  std::vector<std::string> got;
+  std::vector<uint32_t> removedKeys;
+  ScanEntry page[7];
+  uint32_t cursor = 0, nextCursor;
+  uint16_t total;
+  do {
+    int32_t n = index_->page(cursor, page, 7, &nextCursor, &total);
+    TEST_ASSERT_GREATER_THAN(0, n);
+    for (int32_t i = 0; i < n; i++) got.push_back(page[i].name);
+    cursor = nextCursor;
+    if (!cursor) break;
+    for (int i = 0; i < 3; i++) queueScan();
+    removedKeys.push_back(galleryKey(queued[0].c_str()));
+    uploadScan(0); // oldest first, as the uploader goes
+  } while (cursor);
+
+  std::vector<std::string> expect;
+  for (const ScanEntry &e : before) {
+    bool removed = false;
+    for (uint32_t k : removedKeys) removed |= k == e.key;
+    if (!removed) expect.push_back(e.name);
+  }
+  // The uploader can reach the oldest before the pages do
+  TEST_ASSERT_EQUAL(expect.size(), got.size());
+  for (size_t i = 0; i < got.size(); i++) TEST_ASSERT_EQUAL_STRING(expect[i].c_str(), got[i].c_str());
+
+  // A file written over mid-listing moves above the cursor: not listed
+  // again further down, there at the top for the next listing
+  got.clear();
+  int32_t n = index_->page(0, page, 7, &cursor, &total);
+  TEST_ASSERT_EQUAL(7, n);
+  std::string rewritten = queued[0];
+  rewriteScan(rewritten);
+  queued.erase(queued.begin());
+  queued.push_back(rewritten);
+  while (cursor) {
+    n = index_->page(cursor, page, 7, &cursor, &total);
+    for (int32_t i = 0; i < n; i++) got.push_back(page[i].name);
+  }
+  TEST_ASSERT_EQUAL(queued.size() - 8, got.size());
+  for (const std::string &name : got) TEST_ASSERT_TRUE(name != rewritten);
+  assertListing(*index_);
+}
+
+// ============================================
+// Thousands of files
+// ============================================
+static void test_thousands_of_files() {
+  const int FILES = 4000, UPLOADED = 3000, OLD = 90;
+  // A long history: most of it uploaded, some from older firmware
+  for (int i = 0; i < FILES + UPLOADED - OLD; i++) {
+    queueScan();
+    if (i % 3 == 2 && (int)(serial - queued.size()) < UPLOADED) uploadScan(0);
+  }
+  while ((int)(serial - queued.size()) < UPLOADED) uploadScan(0);
+  for (int i = 0; i < OLD; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "IMG_%04d.JPG", i);
+    card->files.push_back(name);
+    queued.push_back(name);
+  }
+  TEST_ASSERT_EQUAL(FILES, queued.size());
+  size_t journalBefore = card->journalRecords.size();
+
+  using clock = std::chrono::steady_clock;
+  auto t0 = clock::now();
+  ScanEntry page[SCANS_PAGE_DEFAULT];
+  uint32_t nextCursor;
+  uint16_t total;
+  TEST_ASSERT_EQUAL(SCANS_PAGE_DEFAULT, index_->page(0, page, SCANS_PAGE_DEFAULT, &nextCursor, &total));
+  double buildMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+  TEST_ASSERT_EQUAL(FILES, total);
+  TEST_ASSERT_EQUAL_UINT32(OLD, stats(*index_).adopted);
+
+  // Pages, lookups, syncs and saves after that read nothing
+  const int ROUNDS = 2000;
+  t0 = clock::now();
+  uint32_t cursor = 0;
+  for (int i = 0; i < ROUNDS; i++) {
+    index_->page(cursor, page, SCANS_PAGE_DEFAULT, &nextCursor, &total);
+    cursor = nextCursor;
+  }
+  double pageUs = std::chrono::duration<double, std::micro>(clock::now() - t0).count() / ROUNDS;
+
+  t0 = clock::now();
+  ScanEntry e;
+  for (int i = 0; i < ROUNDS; i++) TEST_ASSERT_TRUE(index_->find(galleryKey(queued[next() % FILES].c_str()), &e));
+  double findUs = std::chrono::duration<double, std::micro>(clock::now() - t0).count() / ROUNDS;
+
+  Client c;
+  t0 = clock::now();
+  TEST_ASSERT_TRUE(sync(*index_, c, SYNC_PAGE_DEFAULT < 64 ? SYNC_PAGE_DEFAULT : 64));
+  double fullSyncMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+  assertClientCurrent(*index_, c);
+
+  t0 = clock::now();
+  for (int i = 0; i < ROUNDS / 2; i++) {
+    queueScan();
+    uploadScan(0);
+  }
+  double churnUs = std::chrono::duration<double, std::micro>(clock::now() - t0).count() / ROUNDS;
+  TEST_ASSERT_TRUE(sync(*index_, c)); // more uploads than tombstones
+  assertClientCurrent(*index_, c);
+  for (int i = 0; i < 100; i++) {
+    queueScan();
+    uploadScan(0);
+  }
+  t0 = clock::now();
+  TEST_ASSERT_FALSE(sync(*index_, c));
+  double deltaSyncUs = std::chrono::duration<double, std::micro>(clock::now() - t0).count();
+  assertClientCurrent(*index_, c);
+
+  TEST_ASSERT_EQUAL_UINT32(1, card->listings);
+  TEST_ASSERT_EQUAL_UINT32(1, card->replays);
+  TEST_ASSERT_EQUAL_UINT32(1, stats(*index_).builds);
+  TEST_ASSERT_LESS_THAN(3 * (FILES + SCAN_TOMBSTONES) + 64, card->journalRecords.size());
+
+  char line[120];
+  snprintf(line, sizeof(line), "%d files, %u-record journal: first page %.1f ms (1 listing), then %.1f us",
+           FILES, (unsigned)journalBefore, buildMs, pageUs);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "find %.2f us, save or upload %.1f us, full sync %.1f ms, 100-pair delta %.0f us",
+           findUs, churnUs, fullSyncMs, deltaSyncUs);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "journal %u records after %u compactions", (unsigned)card->journalRecords.size(),
+           (unsigned)stats(*index_).compactions);
+  TEST_MESSAGE(line);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_replay_matches_what_was_kept_live);
+  RUN_TEST(test_card_squared_with_journal);
+  RUN_TEST(test_changes_across_a_compaction);
+  RUN_TEST(test_tombstone_eviction_starts_clients_over);
+  RUN_TEST(test_pages_stay_stable_while_scans_change);
+  RUN_TEST(test_thousands_of_files);
+  return UNITY_END();
+}
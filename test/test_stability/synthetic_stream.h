@@ -0,0 +1,127 @@
+// ============================================
+// Synthetic Preview Streams - ResearchMate
+// What the stability detector sees of a scanning session: the 16x12 luma
+// grid and preview JPEG size per frame, rendered from a simple scene (dark
+// desk, bright page with a text texture, hand shake, sensor noise, exposure
+// steps) at the preview rate. Each frame is labelled with the page hold it
+// belongs to, so a replay can be scored against what a person would have
+// wanted shot.
+// ============================================
+
+#ifndef SYNTHETIC_STREAM_H
+#define SYNTHETIC_STREAM_H
+
+#include "imaging/stability_detector.h"
+#include <cmath>
+#include <vector>
+
+struct StreamFrame {
+  uint32_t ms;
+  uint8_t grid[STABILITY_GRID_CELLS];
+  uint32_t jpegLen;
+  int hold;               // page hold this frame is part of (1..), 0: none
+};
+
+struct Scene {
+  bool page = false;
+  float cx = 7.5f, cy = 5.5f;   // page centre, in grid cells (frame centre 7.5, 5.5)
+  float w = 10, h = 8;          // page size in cells
+  uint32_t text = 1;            // text layout (seed); 0: blank sheet
+  float gain = 1;               // exposure
+  bool covered = false;         // lens against something: flat dark
+};
+
+class StreamBuilder {
+public:
+  explicit StreamBuilder(uint32_t seed) : _rng(seed) {}
+
+  // Scene as it is for `ms`, with hand shake of `shake` cells
+  void hold(const Scene &s, uint32_t ms, float shake = 0.05f, bool wanted = false) {
+    int label = wanted ? ++_holds : 0;
+    for (uint32_t end = _ms + ms; _ms < end;) {
+      Scene j = s;
+      j.cx += shake * (rand01() * 2 - 1);
+      j.cy += shake * (rand01() * 2 - 1);
+      frame(j, label);
+    }
+  }
+
+  // Page (or its absence) moving from `a` to `b` over `ms`
+  void move(const Scene &a, const Scene &b, uint32_t ms) {
+    uint32_t start = _ms;
+    while (_ms < start + ms) {
+      float t = (float)(_ms - start) / ms;
+      Scene s = a;
+      s.cx = a.cx + (b.cx - a.cx) * t;
+      s.cy = a.cy + (b.cy - a.cy) * t;
+      frame(s, 0);
+    }
+  }
+
+  // A page held still to be scanned
+  void scan(const Scene &s, uint32_t ms) { hold(s, ms, 0.05f, true); }
+
+  std::vector<StreamFrame> frames;
+  int holds() const { return _holds; }
+
+private:
+  uint32_t _rng;
+  uint32_t _ms = 0;
+  int _holds = 0;
+
+  uint32_t next() {
+    _rng = _rng * 1664525u + 1013904223u;
+    return _rng >> 8;
+  }
+  float rand01() { return (next() & 0xFFFF) / 65535.0f; }
+
+  // Text darkness of a page cell: fixed by the layout, in page coordinates
+  static float textAt(uint32_t text, int px, int py) {
+    if (!text) return 0;
+    uint32_t h = (uint32_t)(px * 73856093) ^ (uint32_t)(py * 19349663) ^ (text * 83492791u);
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return (float)(h % 70); // 0 margin .. 70 dense print
+  }
+
+  static float overlap(float a0, float a1, float b0, float b1) {
+    float lo = a0 > b0 ? a0 : b0, hi = a1 < b1 ? a1 : b1;
+    return hi > lo ? hi - lo : 0;
+  }
+
+  // About 15 fps with scheduler jitter
+  void frame(const Scene &s, int label) {
+    StreamFrame f;
+    f.ms = _ms;
+    f.hold = label;
+    float detail = 0;
+    for (int y = 0; y < STABILITY_GRID_H; y++) {
+      for (int x = 0; x < STABILITY_GRID_W; x++) {
+        float desk = 55 + 10 * std::sin(x * 0.9f + y * 0.4f);
+        float v = desk;
+        if (s.covered) {
+          v = 12;
+        } else if (s.page) {
+          float x0 = s.cx - s.w / 2 + 0.5f, y0 = s.cy - s.h / 2 + 0.5f;
+          float cover = overlap(x, x + 1, x0, x0 + s.w) * overlap(y, y + 1, y0, y0 + s.h);
+          if (cover > 0) {
+            // Text sampled at the page cell under this grid cell's centre
+            float paper = 215 - textAt(s.text, (int)std::floor(x + 0.5f - x0), (int)std::floor(y + 0.5f - y0));
+            v = desk * (1 - cover) + paper * cover;
+            detail += cover * (215 - paper);
+          }
+        }
+        v = v * s.gain + (rand01() * 4 - 2);
+        f.grid[y * STABILITY_GRID_W + x] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+      }
+    }
+    // Preview JPEG size follows the detail in view, +-0.5%
+    float len = (3500 + 12 * detail) * (1 + (rand01() - 0.5f) * 0.01f);
+    f.jpegLen = (uint32_t)len;
+    frames.push_back(f);
+    _ms += 62 + next() % 10;
+  }
+};
+
+#endif // SYNTHETIC_STREAM_H
@@ -0,0 +1,188 @@
+// ============================================
+// Stability detector replay (pio test -e native -f test_stability -v)
+// Replays labelled preview streams through the detector with the
+// firmware's AUTO_* settings and scores the shots it fires: a shot inside
+// a page hold that has none yet is a hit, any other shot a false trigger,
+// a hold without a shot a miss. Precision, recall, shot latency and the
+// host CPU cost per frame are printed with -v.
+//
+// The streams are synthetic (synthetic_stream.h); a recording of real
+// grids replays the same way once it is turned into StreamFrames.
+// ============================================
+
+#include "config.h"
+#include "synthetic_stream.h"
+#include <chrono>
+#include <unity.h>
+
+static const StabilityConfig CFG = {AUTO_MAX_MOTION,    AUTO_REARM_DELTA,        AUTO_MAX_SIZE_DELTA_PCT,
+                                    AUTO_MIN_PAPER_PCT, AUTO_MAX_CENTRE_OFF_PCT, AUTO_MIN_CONTRAST,
+                                    AUTO_STABLE_MS,     AUTO_COOLDOWN_MS};
+
+struct ReplayScore {
+  int holds;
+  int hits;
+  int falseShots;
+  uint32_t latencyMsMax;  // hold start to its shot
+  double usPerFrame;
+};
+
+static ReplayScore replay(const StreamBuilder &b) {
+  ReplayScore r = {};
+  r.holds = b.holds();
+  std::vector<bool> shot(b.holds() + 1, false);
+  std::vector<uint32_t> holdStart(b.holds() + 1, 0);
+  StabilityDetector d;
+  stabilityInit(&d, CFG);
+
+  double us = 0;
+  for (const StreamFrame &f : b.frames) {
+    if (f.hold && !holdStart[f.hold]) holdStart[f.hold] = f.ms ? f.ms : 1;
+    auto t0 = std::chrono::steady_clock::now();
+    bool fire = stabilityUpdate(&d, f.grid, f.jpegLen, f.ms);
+    us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    if (!fire) continue;
+    if (f.hold && !shot[f.hold]) {
+      shot[f.hold] = true;
+      r.hits++;
+      uint32_t latency = f.ms - holdStart[f.hold];
+      if (latency > r.latencyMsMax) r.latencyMsMax = latency;
+    } else {
+      r.falseShots++;
+    }
+  }
+  r.usPerFrame = b.frames.empty() ? 0 : us / b.frames.size();
+  return r;
+}
+
+static ReplayScore total = {};
+
+static ReplayScore score(const char *name, const StreamBuilder &b) {
+  ReplayScore r = replay(b);
+  total.holds += r.holds;
+  total.hits += r.hits;
+  total.falseShots += r.falseShots;
+  if (r.latencyMsMax > total.latencyMsMax) total.latencyMsMax = r.latencyMsMax;
+  char line[160];
+  snprintf(line, sizeof(line), "%-14s %4u frames: %d/%d pages shot, %d false, latency max %lu ms, %.2f us/frame",
+           name, (unsigned)b.frames.size(), r.hits, r.holds, r.falseShots, (unsigned long)r.latencyMsMax,
+           r.usPerFrame);
+  TEST_MESSAGE(line);
+  return r;
+}
+
+// Page positions: centred, and off either side of the view
+static Scene page(uint32_t text, float cx = 7.5f) {
+  Scene s;
+  s.page = true;
+  s.text = text;
+  s.cx = cx;
+  return s;
+}
+static const float LEFT = -7, RIGHT = 22;
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================
+// Streams
+// ============================================
+// Bulk scanning: each page slides in, is held, and leaves
+static void test_bulk_pages_each_shot_once() {
+  StreamBuilder b(11);
+  Scene desk;
+  b.hold(desk, 800);
+  for (uint32_t p = 1; p <= 12; p++) {
+    b.move(page(p, RIGHT), page(p), 600);
+    b.scan(page(p), 1500);
+    b.move(page(p), page(p, LEFT), 600);
+    b.hold(desk, 400);
+  }
+  ReplayScore r = score("bulk", b);
+  TEST_ASSERT_EQUAL(12, r.hits);
+  TEST_ASSERT_EQUAL(0, r.falseShots);
+  TEST_ASSERT_LESS_OR_EQUAL(AUTO_STABLE_MS + 150, r.latencyMsMax);
+}
+
+// Pages swapped under the pen without the view ever emptying
+static void test_swapped_pages_rearm() {
+  StreamBuilder b(12);
+  b.move(page(1, RIGHT), page(1), 600);
+  b.scan(page(1), 1500);
+  for (uint32_t p = 2; p <= 6; p++) {
+    b.move(page(p, RIGHT), page(p), 500);
+    b.scan(page(p), 2500); // the cooldown may hold the shot back
+  }
+  ReplayScore r = score("swap", b);
+  TEST_ASSERT_EQUAL(6, r.hits);
+  TEST_ASSERT_EQUAL(0, r.falseShots);
+}
+
+// A page left under the pen, with auto-exposure steps: one shot only
+static void test_page_left_in_view_is_shot_once() {
+  StreamBuilder b(13);
+  b.move(page(7, RIGHT), page(7), 600);
+  b.scan(page(7), 1500);
+  for (int i = 0; i < 8; i++) {
+    b.hold(page(7), 1800);
+    Scene brighter = page(7);
+    brighter.gain = 1.06f;
+    b.hold(brighter, 150);
+  }
+  ReplayScore r = score("left in view", b);
+  TEST_ASSERT_EQUAL(1, r.hits);
+  TEST_ASSERT_EQUAL(0, r.falseShots);
+}
+
+// ============================================
+// Nothing worth a shot
+// ============================================
+static void test_no_shot_without_a_settled_page() {
+  StreamBuilder b(14);
+  Scene desk, covered, edge = page(8, 12.5f), low = page(10), card = page(11, 7.7f), shaky = page(9);
+  covered.covered = true;
+  // A big sheet mostly in view but well below centre; a small card centred
+  low.w = 14;
+  low.h = 9;
+  low.cy = 9.7f;
+  card.w = 7;
+  card.h = 5;
+  card.cy = 5.7f;
+  b.hold(desk, 3000);
+  b.hold(covered, 3000);
+  b.move(page(8, RIGHT), edge, 500);
+  b.hold(edge, 3000);
+  b.move(edge, page(8, RIGHT), 500);
+  b.hold(low, 3000);
+  b.hold(desk, 300);
+  b.hold(card, 3000);
+  // Pen hovering: the page sweeps back and forth at a few cells a second
+  for (int i = 0; i < 4; i++) {
+    b.move(page(9, 4.5f), page(9, 10.5f), 900);
+    b.move(page(9, 10.5f), page(9, 4.5f), 900);
+  }
+  b.hold(shaky, 3000, 0.6f); // held, but not steadily
+  ReplayScore r = score("no page", b);
+  TEST_ASSERT_EQUAL(0, r.falseShots);
+}
+
+static void test_overall_precision_and_recall() {
+  double precision = total.hits + total.falseShots ? (double)total.hits / (total.hits + total.falseShots) : 1;
+  double recall = total.holds ? (double)total.hits / total.holds : 1;
+  char line[120];
+  snprintf(line, sizeof(line), "overall: precision %.3f, recall %.3f (%d pages, %d shots, %d false)", precision,
+           recall, total.holds, total.hits + total.falseShots, total.falseShots);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(precision >= 0.95);
+  TEST_ASSERT_TRUE(recall >= 0.95);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bulk_pages_each_shot_once);
+  RUN_TEST(test_swapped_pages_rearm);
+  RUN_TEST(test_page_left_in_view_is_shot_once);
+  RUN_TEST(test_no_shot_without_a_settled_page);
+  RUN_TEST(test_overall_precision_and_recall);
+  return UNITY_END();
+}
@@ -0,0 +1,215 @@
+// ============================================
+// StatsD exporter tests (pio test -e native -f test_statsd)
+// A UDP socket on loopback plays the collector. The exporter's socket is
+// connected, so once the collector is closed the kernel's port-unreachable
+// reply turns the exporter's next send into ECONNREFUSED: the refused
+// datagram path, with no network needed. flush() is called directly (the
+// host never starts the exporter's task).
+// ============================================
+
+#include "net/statsd_exporter.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unity.h>
+#include <vector>
+
+static MetricCounter uploads("t_uploads_total", "Counter sent as deltas.", "result=\"ok\"");
+static MetricGauge heapFree("t_heap_free_bytes", "Gauge sent every flush.");
+static const uint32_t MS_BOUNDS[] = {10, 100};
+static MetricHistogram latency("t_latency_seconds", "Histogram sent as bucket deltas.", MS_BOUNDS, 1e-3);
+
+// Enough counters that one flush takes several datagrams
+#define BULK_COUNTERS 120
+static char bulkLabels[BULK_COUNTERS][16];
+static MetricCounter *bulk[BULK_COUNTERS];
+
+static StatsdExporter exporter;
+static uint16_t collectorPort;
+static int collector = -1;
+
+static void openCollector() {
+  collector = socket(AF_INET, SOCK_DGRAM, 0);
+  TEST_ASSERT_TRUE(collector >= 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(collectorPort);
+  TEST_ASSERT_EQUAL(0, bind(collector, (struct sockaddr *)&addr, sizeof(addr)));
+  socklen_t len = sizeof(addr);
+  getsockname(collector, (struct sockaddr *)&addr, &len);
+  collectorPort = ntohs(addr.sin_port);
+  struct timeval tv = {0, 200000};
+  setsockopt(collector, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+static void closeCollector() {
+  close(collector);
+  collector = -1;
+}
+
+// Datagrams that arrived since the last call
+static std::vector<std::string> receive() {
+  std::vector<std::string> out;
+  char buf[2048];
+  for (;;) {
+    ssize_t n = recv(collector, buf, sizeof(buf), out.empty() ? 0 : MSG_DONTWAIT);
+    if (n < 0) break;
+    out.push_back(std::string(buf, n));
+  }
+  return out;
+}
+
+static std::string joined(const std::vector<std::string> &packets) {
+  std::string all;
+  for (const std::string &p : packets) all += p;
+  return all;
+}
+
+static size_t lineCount(const std::string &text, const char *prefix) {
+  size_t n = 0;
+  for (size_t at = 0; at < text.size();) {
+    size_t end = text.find('\n', at);
+    if (text.compare(at, strlen(prefix), prefix) == 0) n++;
+    at = end == std::string::npos ? text.size() : end + 1;
+  }
+  return n;
+}
+
+static bool hasLine(const std::string &text, const std::string &line) {
+  return ("\n" + text).find("\n" + line + "\n") != std::string::npos;
+}
+
+static StatsdExporterStats stats() {
+  StatsdExporterStats s;
+  exporter.getStats(&s);
+  return s;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ============================================
+// Deltas
+// ============================================
+static void test_counter_sends_increase_since_last_flush() {
+  uploads.add(5);
+  heapFree.set(1000);
+  exporter.flush();
+  std::string text = joined(receive());
+  TEST_ASSERT_TRUE_MESSAGE(hasLine(text, "t_uploads_total:5|c|#pen:pen-1,result:ok"), text.c_str());
+  TEST_ASSERT_TRUE(hasLine(text, "t_heap_free_bytes:1000|g|#pen:pen-1"));
+
+  uploads.add(3);
+  exporter.flush();
+  text = joined(receive());
+  TEST_ASSERT_TRUE_MESSAGE(hasLine(text, "t_uploads_total:3|c|#pen:pen-1,result:ok"), text.c_str());
+
+  // Unchanged counters stay quiet; gauges go every time
+  exporter.flush();
+  text = joined(receive());
+  TEST_ASSERT_EQUAL_UINT(0, lineCount(text, "t_uploads_total:"));
+  TEST_ASSERT_TRUE(hasLine(text, "t_heap_free_bytes:1000|g|#pen:pen-1"));
+}
+
+static void test_histogram_sends_bucket_deltas() {
+  latency.observe(5);
+  latency.observe(50);
+  latency.observe(5000);
+  exporter.flush();
+  std::string text = joined(receive());
+  TEST_ASSERT_TRUE_MESSAGE(hasLine(text, "t_latency_seconds.bucket:1|c|#pen:pen-1,le:0.01"), text.c_str());
+  TEST_ASSERT_TRUE(hasLine(text, "t_latency_seconds.bucket:2|c|#pen:pen-1,le:0.1"));
+  TEST_ASSERT_TRUE(hasLine(text, "t_latency_seconds.count:3|c|#pen:pen-1"));
+  TEST_ASSERT_TRUE(hasLine(text, "t_latency_seconds.sum:5.055|c|#pen:pen-1"));
+
+  // Only the buckets at or above the new value moved
+  latency.observe(50);
+  exporter.flush();
+  text = joined(receive());
+  TEST_ASSERT_EQUAL_UINT(0, lineCount(text, "t_latency_seconds.bucket:1|c|#pen:pen-1,le:0.01"));
+  TEST_ASSERT_TRUE(hasLine(text, "t_latency_seconds.bucket:1|c|#pen:pen-1,le:0.1"));
+  TEST_ASSERT_TRUE(hasLine(text, "t_latency_seconds.count:1|c|#pen:pen-1"));
+  TEST_ASSERT_TRUE(hasLine(text, "t_latency_seconds.sum:0.05|c|#pen:pen-1"));
+}
+
+static void test_flush_splits_into_datagrams() {
+  StatsdExporterStats before = stats();
+  for (MetricCounter *c : bulk) c->add(1);
+  exporter.flush();
+  std::vector<std::string> packets = receive();
+  TEST_ASSERT_GREATER_OR_EQUAL(3, packets.size());
+  for (const std::string &p : packets) {
+    TEST_ASSERT_LESS_OR_EQUAL(STATSD_PACKET_BYTES, p.size());
+    TEST_ASSERT_EQUAL('\n', p.back()); // lines are never split
+  }
+  TEST_ASSERT_EQUAL_UINT(BULK_COUNTERS, lineCount(joined(packets), "t_bulk_total:1|c"));
+  StatsdExporterStats after = stats();
+  TEST_ASSERT_EQUAL_UINT32(packets.size(), after.packets - before.packets);
+  TEST_ASSERT_EQUAL_UINT32(0, after.dropped - before.dropped);
+}
+
+// ============================================
+// Refused datagrams
+// ============================================
+static void test_refused_datagram_is_resent_next_flush() {
+  closeCollector();
+  // Goes out (nobody is told it was lost) and draws the port-unreachable
+  exporter.flush();
+  usleep(10000);
+
+  StatsdExporterStats before = stats();
+  uploads.add(7);
+  exporter.flush();
+  StatsdExporterStats after = stats();
+  TEST_ASSERT_EQUAL_UINT32(1, after.dropped - before.dropped);
+  TEST_ASSERT_EQUAL(ECONNREFUSED, after.lastError);
+  TEST_ASSERT_EQUAL_UINT32(before.packets, after.packets);
+
+  openCollector();
+  uploads.add(2);
+  exporter.flush();
+  std::string text = joined(receive());
+  TEST_ASSERT_TRUE_MESSAGE(hasLine(text, "t_uploads_total:9|c|#pen:pen-1,result:ok"), text.c_str());
+}
+
+static void test_refused_mid_flush_keeps_what_went() {
+  closeCollector();
+  StatsdExporterStats before = stats();
+  for (MetricCounter *c : bulk) c->add(1);
+  // First datagram goes (lost with the collector), the next is refused and
+  // ends the flush: only the first one's totals count as sent
+  exporter.flush();
+  StatsdExporterStats after = stats();
+  TEST_ASSERT_EQUAL_UINT32(1, after.packets - before.packets);
+  TEST_ASSERT_EQUAL_UINT32(1, after.dropped - before.dropped);
+  uint32_t lost = after.lines - before.lines;
+  TEST_ASSERT_GREATER_THAN(0, lost);
+
+  openCollector();
+  exporter.flush();
+  std::string text = joined(receive());
+  // The registry lists the bulk counters first, so that datagram held
+  // nothing else
+  TEST_ASSERT_EQUAL_UINT(BULK_COUNTERS - lost, lineCount(text, "t_bulk_total:1|c"));
+}
+
+int main() {
+  for (int i = 0; i < BULK_COUNTERS; i++) {
+    snprintf(bulkLabels[i], sizeof(bulkLabels[i]), "i=\"%d\"", i);
+    bulk[i] = new MetricCounter("t_bulk_total", "Many counters.", bulkLabels[i]);
+  }
+  openCollector();
+  if (!exporter.begin("127.0.0.1", collectorPort, "pen-1")) return 1;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_counter_sends_increase_since_last_flush);
+  RUN_TEST(test_histogram_sends_bucket_deltas);
+  RUN_TEST(test_flush_splits_into_datagrams);
+  RUN_TEST(test_refused_datagram_is_resent_next_flush);
+  RUN_TEST(test_refused_mid_flush_keeps_what_went);
+  return UNITY_END();
+}
@@ -0,0 +1,445 @@
+// ============================================
+// Queue export tests (pio test -e native -f test_tar_export -v)
+// TarExport over a temp directory listed by a scan index, drained the way
+// the server task drains an HttpStream. The archive is read back with a
+// ustar parser (checksums, octal sizes, padding, the two zero blocks at
+// the end) and, where the host has one, by tar itself. Files gone before
+// they are reached, a file cut short after its header went out, a delete
+// while the export reads the file, and the throughput.
+// ============================================
+
+#include "net/tar_export.h"
+#include "storage/file_pins.h"
+#include "storage/scan_index.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+static char root[64];
+static std::string queueDir;
+
+// ============================================
+// The queue: files in the temp directory, journalled as storage.cpp does
+// ============================================
+struct Record {
+  ScanOp op;
+  uint32_t gen, key, size, crc, floor;
+  std::string name;
+};
+
+class DirCard : public GalleryStore, public ScanJournal {
+public:
+  std::vector<Record> journalRecords;
+
+  bool list(void (*fn)(void *ctx, const char *name), void *ctx) override {
+    DIR *d = opendir(queueDir.c_str());
+    if (!d) return false;
+    while (struct dirent *e = readdir(d)) {
+      if (e->d_type == DT_REG) fn(ctx, e->d_name);
+    }
+    closedir(d);
+    return true;
+  }
+  bool listThumbs(void (*fn)(void *ctx, uint32_t key), void *ctx) override { return false; }
+  int32_t readThumb(uint32_t key, uint8_t *buf, size_t cap) override { return -1; }
+
+  bool replay(void (*fn)(void *ctx, const ScanRecord &r), void *ctx) override {
+    for (const Record &rec : journalRecords) {
+      ScanRecord r = {rec.op, rec.gen, rec.key, rec.name.c_str(), rec.size, rec.crc, rec.floor};
+      fn(ctx, r);
+    }
+    return true;
+  }
+  bool append(const ScanRecord &r) override {
+    journalRecords.push_back({r.op, r.gen, r.key, r.size, r.crc, r.floor, r.name ? r.name : ""});
+    return true;
+  }
+  bool rewrite(bool (*next)(void *ctx, ScanRecord *r), void *ctx) override { return false; }
+};
+
+static const uint16_t MAX_SCANS = 1024;
+static ScanEntry scanEntries[MAX_SCANS];
+static uint32_t scanKeys[MAX_SCANS];
+static DirCard *card;
+static ScanIndex *index_;
+static std::vector<std::string> queued; // oldest first
+
+static std::string saveScan(const char *name, size_t size) {
+  std::string path = queueDir + "/" + name;
+  FILE *f = fopen(path.c_str(), "wb");
+  for (size_t i = 0; i < size; i++) fputc((int)(next() & 0xFF), f);
+  fclose(f);
+  index_->add(name, (uint32_t)size, 0);
+  queued.push_back(name);
+  return path;
+}
+
+static std::vector<uint8_t> readFile(const std::string &path) {
+  std::vector<uint8_t> out;
+  FILE *f = fopen(path.c_str(), "rb");
+  int c;
+  while (f && (c = fgetc(f)) != EOF) out.push_back((uint8_t)c);
+  if (f) fclose(f);
+  return out;
+}
+
+static void emptyDir(const std::string &dir) {
+  DIR *d = opendir(dir.c_str());
+  while (struct dirent *e = d ? readdir(d) : nullptr) {
+    if (e->d_name[0] != '.') unlink((dir + "/" + e->d_name).c_str());
+  }
+  if (d) closedir(d);
+}
+
+// ============================================
+// Draining and reading back
+// ============================================
+
+// The server task: peek, send part of it, until done(). `each` runs once
+// per step, for the test to act mid-export.
+template <typename F>
+static std::vector<uint8_t> drain(TarExport &tar, uint8_t client, size_t chunk, F each) {
+  std::vector<uint8_t> out;
+  for (int guard = 0; !tar.done(client) && guard < 1000000; guard++) {
+    each(out.size());
+    const uint8_t *p;
+    size_t n = tar.peek(client, &p);
+    if (n == 0) continue;
+    if (n > chunk) n = chunk;
+    out.insert(out.end(), p, p + n);
+    tar.consume(client, n);
+  }
+  return out;
+}
+static std::vector<uint8_t> drain(TarExport &tar, uint8_t client, size_t chunk) {
+  return drain(tar, client, chunk, [](size_t) {});
+}
+
+struct Member {
+  std::string name;
+  std::vector<uint8_t> data;
+  uint32_t mtime;
+};
+
+static uint32_t octal(const uint8_t *p, int n) {
+  uint32_t v = 0;
+  for (int i = 0; i < n && p[i] >= '0' && p[i] <= '7'; i++) v = v * 8 + (p[i] - '0');
+  return v;
+}
+
+// ustar, as POSIX defines it; false (with the members so far) when the
+// archive is malformed or ends early
+static bool parseTar(const std::vector<uint8_t> &tar, std::vector<Member> *out) {
+  static const uint8_t zero[TAR_BLOCK] = {};
+  if (tar.size() % TAR_BLOCK) return false;
+  size_t at = 0;
+  while (at + TAR_BLOCK <= tar.size()) {
+    const uint8_t *h = tar.data() + at;
+    if (memcmp(h, zero, TAR_BLOCK) == 0) {
+      // End: two zero blocks, and nothing after them
+      return at + 2 * TAR_BLOCK == tar.size() && memcmp(h + TAR_BLOCK, zero, TAR_BLOCK) == 0;
+    }
+    uint32_t sum = 0;
+    for (int i = 0; i < TAR_BLOCK; i++) sum += (i >= 148 && i < 156) ? ' ' : h[i];
+    if (octal(h + 148, 8) != sum || h[155] != ' ' || h[154] != 0) return false;
+    if (memcmp(h + 257, "ustar\0" "00", 8) != 0 || h[156] != '0') return false;
+    if (h[99] != 0 || h[135] != 0 || h[147] != 0) return false;
+    Member m;
+    m.name = std::string((const char *)h, strnlen((const char *)h, 100));
+    uint32_t size = octal(h + 124, 11);
+    m.mtime = octal(h + 136, 11);
+    at += TAR_BLOCK;
+    size_t padded = (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+    if (at + padded > tar.size()) return false;
+    m.data.assign(tar.begin() + at, tar.begin() + at + size);
+    for (size_t i = size; i < padded; i++) {
+      if (tar[at + i]) return false;
+    }
+    at += padded;
+    out->push_back(m);
+  }
+  return false;
+}
+
+static TarExportStats stats(const TarExport &tar) {
+  TarExportStats st;
+  tar.getStats(&st);
+  return st;
+}
+
+void setUp() {
+  rng = 1;
+  emptyDir(queueDir);
+  queued.clear();
+  card = new DirCard();
+  index_ = new ScanIndex();
+  TEST_ASSERT_TRUE(index_->attach(card, card, scanEntries, scanKeys, MAX_SCANS));
+}
+void tearDown() {
+  delete index_;
+  delete card;
+}
+
+// ============================================
+// Archives
+// ============================================
+static void test_archive_holds_the_queue_newest_first() {
+  FilePins pins(root);
+  TarExport tar(queueDir.c_str(), &pins);
+  const size_t SIZES[] = {0, 1, 511, 512, 513, FILE_STREAM_BLOCK, FILE_STREAM_BLOCK + 1, 100000};
+  char name[GALLERY_NAME_MAX];
+  for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++) {
+    snprintf(name, sizeof(name), "scan_%u_%u.%s", (unsigned)(next() % 100000), (unsigned)i,
+             i % 3 ? "jpg" : "pdf");
+    saveScan(name, SIZES[i]);
+  }
+  struct stat st;
+  stat((queueDir + "/" + queued[0]).c_str(), &st);
+
+  tar.prepare(index_);
+  TEST_ASSERT_TRUE(tar.open(3));
+  TEST_ASSERT_FALSE(tar.open(4)); // one export at a time
+  std::vector<uint8_t> archive = drain(tar, 3, 1 + next() % 5000);
+  tar.close(3);
+
+  std::vector<Member> members;
+  TEST_ASSERT_TRUE(parseTar(archive, &members));
+  TEST_ASSERT_EQUAL(queued.size(), members.size());
+  for (size_t i = 0; i < members.size(); i++) {
+    const std::string &q = queued[queued.size() - 1 - i];
+    TEST_ASSERT_EQUAL_STRING(("queue/" + q).c_str(), members[i].name.c_str());
+    TEST_ASSERT_TRUE(members[i].data == readFile(queueDir + "/" + q));
+  }
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)st.st_mtime, members.back().mtime);
+
+  TarExportStats s = stats(tar);
+  TEST_ASSERT_FALSE(s.active);
+  TEST_ASSERT_EQUAL_UINT32(1, s.exports);
+  TEST_ASSERT_EQUAL_UINT32(queued.size(), s.files);
+  TEST_ASSERT_EQUAL_UINT32(archive.size(), s.bytes);
+  FilePinStats ps;
+  pins.getStats(&ps);
+  TEST_ASSERT_EQUAL(0, ps.pinned);
+
+  // The host's own tar agrees, where there is one
+  if (system("tar --version > /dev/null 2>&1") != 0) {
+    TEST_MESSAGE("no tar on this host: checked by the parser only");
+    return;
+  }
+  std::string file = std::string(root) + "/export.tar", out = std::string(root) + "/out";
+  FILE *f = fopen(file.c_str(), "wb");
+  fwrite(archive.data(), 1, archive.size(), f);
+  fclose(f);
+  mkdir(out.c_str(), 0755);
+  TEST_ASSERT_EQUAL(0, system(("tar -xf " + file + " -C " + out + " 2>&1").c_str()));
+  for (const std::string &q : queued) {
+    TEST_ASSERT_TRUE(readFile(out + "/queue/" + q) == readFile(queueDir + "/" + q));
+    unlink((out + "/queue/" + q).c_str());
+  }
+  rmdir((out + "/queue").c_str());
+  rmdir(out.c_str());
+  unlink(file.c_str());
+}
+
+static void test_empty_queue_is_just_the_end_blocks() {
+  FilePins pins(root);
+  TarExport tar(queueDir.c_str(), &pins);
+  tar.prepare(index_);
+  TEST_ASSERT_TRUE(tar.open(0));
+  std::vector<uint8_t> archive = drain(tar, 0, 100);
+  tar.close(0);
+  TEST_ASSERT_EQUAL(2 * TAR_BLOCK, archive.size());
+  std::vector<Member> members;
+  TEST_ASSERT_TRUE(parseTar(archive, &members));
+  TEST_ASSERT_EQUAL(0, members.size());
+  TEST_ASSERT_EQUAL_UINT32(1, stats(tar).exports);
+
+  // No index: nothing to list from
+  TarExport unprepared(queueDir.c_str(), &pins);
+  TEST_ASSERT_FALSE(unprepared.open(0));
+}
+
+// Uploaded between the listing and the export reaching it: left out
+static void test_files_gone_when_reached_are_skipped() {
+  FilePins pins(root);
+  TarExport tar(queueDir.c_str(), &pins);
+  char name[GALLERY_NAME_MAX];
+  for (int i = 0; i < 3 * TAR_BATCH; i++) {
+    snprintf(name, sizeof(name), "scan_%d.jpg", i);
+    saveScan(name, 700 + next() % 3000);
+  }
+  std::vector<std::string> gone = {queued[0], queued[TAR_BATCH], queued[2 * TAR_BATCH - 1]};
+
+  tar.prepare(index_);
+  TEST_ASSERT_TRUE(tar.open(1));
+  bool removed = false;
+  std::vector<uint8_t> archive = drain(tar, 1, 4096, [&](size_t sent) {
+    // Once the first batch is listed, so the index still names them
+    if (!removed && sent > 0) {
+      for (const std::string &g : gone) unlink((queueDir + "/" + g).c_str());
+      removed = true;
+    }
+  });
+  tar.close(1);
+
+  std::vector<Member> members;
+  TEST_ASSERT_TRUE(parseTar(archive, &members));
+  TEST_ASSERT_EQUAL(queued.size() - gone.size(), members.size());
+  for (const Member &m : members) {
+    for (const std::string &g : gone) TEST_ASSERT_TRUE(m.name != "queue/" + g);
+    TEST_ASSERT_TRUE(m.data == readFile(queueDir + "/" + m.name.substr(6)));
+  }
+  TarExportStats s = stats(tar);
+  TEST_ASSERT_EQUAL_UINT32(gone.size(), s.skipped);
+  TEST_ASSERT_EQUAL_UINT32(1, s.exports);
+}
+
+// The header promised more than the file then had: the archive stops
+// there, short, and a reader says so
+static void test_file_cut_short_ends_the_archive() {
+  FilePins pins(root);
+  TarExport tar(queueDir.c_str(), &pins);
+  saveScan("older.jpg", 3000);
+  std::string path = saveScan("newest.jpg", 5 * FILE_STREAM_BLOCK);
+
+  tar.prepare(index_);
+  TEST_ASSERT_TRUE(tar.open(2));
+  bool cut = false;
+  std::vector<uint8_t> archive = drain(tar, 2, 1024, [&](size_t sent) {
+    if (!cut && sent >= TAR_BLOCK + 2048) {
+      TEST_ASSERT_EQUAL(0, truncate(path.c_str(), FILE_STREAM_BLOCK + 100));
+      cut = true;
+    }
+  });
+  TEST_ASSERT_TRUE(tar.done(2));
+  tar.close(2);
+
+  TEST_ASSERT_EQUAL(TAR_BLOCK + FILE_STREAM_BLOCK + 100, archive.size());
+  std::vector<Member> members;
+  TEST_ASSERT_FALSE(parseTar(archive, &members));
+  TarExportStats s = stats(tar);
+  TEST_ASSERT_EQUAL_UINT32(0, s.exports);
+  TEST_ASSERT_EQUAL_UINT32(1, s.aborted);
+  FilePinStats ps;
+  pins.getStats(&ps);
+  TEST_ASSERT_EQUAL(0, ps.pinned);
+
+  // The next export is not held up by it
+  tar.prepare(index_);
+  TEST_ASSERT_TRUE(tar.open(2));
+  tar.close(2); // client gone at once
+  TEST_ASSERT_EQUAL_UINT32(2, stats(tar).aborted);
+}
+
+// The uploader finishing a file the export is reading: the member is
+// still whole, and the file goes once the export is past it
+static void test_delete_during_export_waits() {
+  FilePins pins(root);
+  TarExport tar(queueDir.c_str(), &pins);
+  std::string older = saveScan("older.jpg", 2000);
+  std::string path = saveScan("uploaded.jpg", 3 * FILE_STREAM_BLOCK);
+  std::vector<uint8_t> want = readFile(path);
+  std::string cardPath = path.substr(strlen(root));
+
+  tar.prepare(index_);
+  TEST_ASSERT_TRUE(tar.open(0));
+  bool claimed = false, goneAfter = false;
+  std::vector<uint8_t> archive = drain(tar, 0, 2048, [&](size_t sent) {
+    if (!claimed && sent >= TAR_BLOCK + 4096) {
+      TEST_ASSERT_FALSE(pins.claim(cardPath.c_str()));
+      claimed = true;
+    }
+    // Past the member: removed by the export
+    if (sent > TAR_BLOCK + want.size() + TAR_BLOCK) goneAfter = access(path.c_str(), F_OK) != 0;
+  });
+  tar.close(0);
+  TEST_ASSERT_TRUE(claimed);
+  TEST_ASSERT_TRUE(goneAfter);
+
+  std::vector<Member> members;
+  TEST_ASSERT_TRUE(parseTar(archive, &members));
+  TEST_ASSERT_EQUAL(2, members.size());
+  TEST_ASSERT_TRUE(members[0].data == want);
+  TEST_ASSERT_TRUE(members[1].data == readFile(older));
+
+  // Doomed before the export reaches it: skipped
+  std::string next = saveScan("next.jpg", 100);
+  TEST_ASSERT_TRUE(pins.claim(next.c_str()));
+  tar.prepare(index_);
+  TEST_ASSERT_TRUE(tar.open(0));
+  archive = drain(tar, 0, 4096);
+  tar.close(0);
+  members.clear();
+  TEST_ASSERT_TRUE(parseTar(archive, &members));
+  TEST_ASSERT_EQUAL(1, members.size()); // older.jpg; uploaded.jpg is gone from the card
+  TEST_ASSERT_EQUAL_STRING("queue/older.jpg", members[0].name.c_str());
+  unlink(next.c_str());
+  pins.deleted(next.c_str());
+  TEST_ASSERT_EQUAL_UINT32(2, stats(tar).skipped);
+}
+
+// ============================================
+// Throughput
+// ============================================
+static void test_throughput() {
+  FilePins pins(root);
+  TarExport tar(queueDir.c_str(), &pins);
+  char name[GALLERY_NAME_MAX];
+  size_t total = 0;
+  for (int i = 0; i < 60; i++) {
+    snprintf(name, sizeof(name), "scan_%d.jpg", i);
+    size_t size = 150000 + next() % 250000;
+    saveScan(name, size);
+    total += size;
+  }
+
+  tar.prepare(index_);
+  TEST_ASSERT_TRUE(tar.open(0));
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<uint8_t> archive = drain(tar, 0, 1460); // one TCP segment a write
+  double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  tar.close(0);
+
+  std::vector<Member> members;
+  TEST_ASSERT_TRUE(parseTar(archive, &members));
+  TEST_ASSERT_EQUAL(60, members.size());
+  char line[120];
+  snprintf(line, sizeof(line), "60 files, %.1f MB: %.1f MB archive in %.0f ms, %.0f MB/s (host, page cache)",
+           total / 1e6, archive.size() / 1e6, s * 1000, archive.size() / 1e6 / s);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_OR_EQUAL(total + 60 * 2 * TAR_BLOCK + 2 * TAR_BLOCK, archive.size());
+}
+
+int main() {
+  snprintf(root, sizeof(root), "/tmp/tar_export_XXXXXX");
+  if (!mkdtemp(root)) return 1;
+  queueDir = std::string(root) + "/queue";
+  mkdir(queueDir.c_str(), 0755);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_archive_holds_the_queue_newest_first);
+  RUN_TEST(test_empty_queue_is_just_the_end_blocks);
+  RUN_TEST(test_files_gone_when_reached_are_skipped);
+  RUN_TEST(test_file_cut_short_ends_the_archive);
+  RUN_TEST(test_delete_during_export_waits);
+  RUN_TEST(test_throughput);
+  int failures = UNITY_END();
+
+  emptyDir(queueDir);
+  rmdir(queueDir.c_str());
+  rmdir(root);
+  return failures;
+}
@@ -0,0 +1,303 @@
+// ============================================
+// Tile view tests (pio test -e native -f test_tile_view -v)
+// Views of a synthetic image, whose pixel at each scale is a hash of its
+// coordinates, compared pixel for pixel against sampling that image
+// directly. The fake decoder emits grid-aligned MCU blocks over the clip,
+// as the JPEG decoder does, and counts what it reconstructs, so cache
+// reuse, LRU eviction and failed passes are measured, not assumed.
+// ============================================
+
+#include "display/tile_view.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unity.h>
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+// View as the review screen uses it
+static const uint16_t VW = 128, VH = 119;
+static const uint8_t ROWS = 4;
+
+static uint16_t pixelAt(uint8_t scale, int32_t x, int32_t y) {
+  uint32_t h = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ (scale * 83492791u);
+  return (uint16_t)(h ^ (h >> 16));
+}
+
+// ============================================
+// Fake decoder
+// ============================================
+struct Decoder {
+  uint16_t imgW, imgH;
+  uint8_t mcuW = 16, mcuH = 8;
+  uint32_t passes = 0;
+  uint64_t pixels = 0;      // reconstructed, all passes
+  int failAfter = -1;       // blocks emitted before a failing pass gives up
+  const char *error = nullptr;
+};
+
+static bool fakeDecode(void *ctx, uint8_t scale, int16_t clipX, int16_t clipY, uint16_t clipW,
+                       uint16_t clipH, TileBlockFn out, void *outCtx) {
+  Decoder *d = (Decoder *)ctx;
+  d->passes++;
+  const int32_t sw = tileScaled(d->imgW, scale), sh = tileScaled(d->imgH, scale);
+  if (clipX < 0 || clipY < 0 || !clipW || !clipH || clipX + clipW > sw || clipY + clipH > sh) {
+    d->error = "clip outside the scaled image";
+    return false;
+  }
+  static uint16_t block[32 * 32];
+  int emitted = 0;
+  for (int32_t by = clipY / d->mcuH * d->mcuH; by < clipY + clipH; by += d->mcuH) {
+    for (int32_t bx = clipX / d->mcuW * d->mcuW; bx < clipX + clipW; bx += d->mcuW) {
+      if (d->failAfter >= 0 && emitted == d->failAfter) return false;
+      uint16_t w = (uint16_t)(bx + d->mcuW > sw ? sw - bx : d->mcuW);
+      uint16_t h = (uint16_t)(by + d->mcuH > sh ? sh - by : d->mcuH);
+      for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++) block[y * w + x] = pixelAt(scale, bx + x, by + y);
+      d->pixels += (uint64_t)w * h;
+      emitted++;
+      if (!out(outCtx, (int16_t)bx, (int16_t)by, w, h, block)) return false;
+    }
+  }
+  return true;
+}
+
+// ============================================
+// Screen: collects the emitted blocks into one view
+// ============================================
+struct Screen {
+  uint16_t px[VW * VH];
+  int32_t nextRow = 0;
+  int blocks = 0, abortAt = -1;
+  const char *error = nullptr;
+};
+
+static bool collect(void *ctx, int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *bitmap) {
+  Screen *s = (Screen *)ctx;
+  if (x != 0 || w != VW || y != s->nextRow || h != (VH - y < ROWS ? VH - y : ROWS)) s->error = "block shape";
+  if (!s->error) memcpy(s->px + y * VW, bitmap, sizeof(uint16_t) * w * h);
+  s->nextRow += h;
+  return ++s->blocks != s->abortAt;
+}
+
+static bool matchesImage(const Screen &s, uint16_t imgW, uint16_t imgH, uint8_t scale, int32_t ox,
+                         int32_t oy) {
+  const int32_t sw = tileScaled(imgW, scale), sh = tileScaled(imgH, scale);
+  for (int32_t y = 0; y < VH; y++) {
+    for (int32_t x = 0; x < VW; x++) {
+      int32_t sx = ox + x, sy = oy + y;
+      uint16_t want = sx >= 0 && sy >= 0 && sx < sw && sy < sh ? pixelAt(scale, sx, sy) : 0;
+      if (s.px[y * VW + x] != want) return false;
+    }
+  }
+  return true;
+}
+
+static uint16_t pool[TILE_CACHE_MAX * TILE_SIZE * TILE_SIZE];
+static TileView view;
+static Decoder dec;
+static Screen screen;
+
+void setUp() {
+  rng = 1;
+  dec = Decoder();
+}
+void tearDown() {}
+
+static void begin(uint8_t tiles, uint16_t imgW, uint16_t imgH) {
+  TEST_ASSERT_TRUE(tileViewInit(&view, VW, VH, pool, tiles, fakeDecode, &dec));
+  dec.imgW = imgW;
+  dec.imgH = imgH;
+  tileViewSetImage(&view, imgW, imgH);
+}
+
+static bool show(uint8_t scale, int32_t ox, int32_t oy) {
+  static uint16_t rows[VW * ROWS];
+  screen = Screen();
+  memset(screen.px, 0xAB, sizeof(screen.px));
+  bool ok = tileViewRender(&view, scale, ox, oy, rows, ROWS, collect, &screen);
+  TEST_ASSERT_NULL(screen.error);
+  TEST_ASSERT_NULL(dec.error);
+  return ok;
+}
+
+// ============================================
+// Geometry
+// ============================================
+static void test_init_rejects_bad_setups() {
+  TEST_ASSERT_FALSE(tileViewInit(&view, VW, VH, nullptr, 32, fakeDecode, &dec));
+  TEST_ASSERT_FALSE(tileViewInit(&view, VW, VH, pool, 32, nullptr, &dec));
+  TEST_ASSERT_FALSE(tileViewInit(&view, VW, VH, pool, TILE_VIEW_MAX - 1, fakeDecode, &dec));
+  TEST_ASSERT_FALSE(tileViewInit(&view, 2 * TILE_SIZE + 1, VH, pool, 32, fakeDecode, &dec));
+  TEST_ASSERT_FALSE(tileViewInit(&view, VW, 0, pool, 32, fakeDecode, &dec));
+  TEST_ASSERT_TRUE(tileViewInit(&view, 2 * TILE_SIZE, 2 * TILE_SIZE, pool, 255, fakeDecode, &dec));
+  TEST_ASSERT_EQUAL(TILE_CACHE_MAX, view.slotCount);
+}
+
+static void test_origin_clamps_and_centres() {
+  begin(32, 1600, 1200);
+  int32_t ox, oy;
+  tileViewOrigin(&view, 0, 800, 600, &ox, &oy);
+  TEST_ASSERT_EQUAL(800 - VW / 2, ox);
+  TEST_ASSERT_EQUAL(600 - VH / 2, oy);
+  tileViewOrigin(&view, 1, 0, 100000, &ox, &oy);
+  TEST_ASSERT_EQUAL(0, ox);
+  TEST_ASSERT_EQUAL(600 - VH, oy);
+  // 1600x1200 at 1/16 would be 100x75: smaller than the view, centred
+  tileViewSetImage(&view, 100 << 3, 75 << 3);
+  tileViewOrigin(&view, 3, 0, 0, &ox, &oy);
+  TEST_ASSERT_EQUAL(-(VW - 100) / 2, ox);
+  TEST_ASSERT_EQUAL(-(VH - 75) / 2, oy);
+  TEST_ASSERT_EQUAL(200, tileScaled(1600, 3));
+  TEST_ASSERT_EQUAL(1, tileScaled(1, 3));
+  TEST_ASSERT_EQUAL(2, tileScaled(9, 3));
+}
+
+// ============================================
+// Views
+// ============================================
+static void test_random_views_match_image() {
+  const uint8_t mcu[][2] = {{16, 8}, {8, 8}, {16, 16}, {32, 32}, {8, 16}};
+  const uint16_t sizes[][2] = {{1600, 1200}, {1597, 1201}, {640, 480}, {300, 200}, {90, 60}};
+  uint32_t views = 0, hits = 0, lookups = 0;
+  uint64_t direct = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int image = 0; image < 20; image++) {
+    begin(image % 4 ? 32 : TILE_VIEW_MAX, sizes[image % 5][0], sizes[image % 5][1]);
+    dec.mcuW = mcu[image % 5][0];
+    dec.mcuH = mcu[image % 5][1];
+    for (int i = 0; i < 100; i++) {
+      uint8_t scale = next() % 4;
+      int32_t ox, oy;
+      if (next() % 8) {
+        tileViewOrigin(&view, scale, next() % dec.imgW, next() % dec.imgH, &ox, &oy);
+      } else {
+        ox = (int32_t)(next() % 400) - 200; // off the edges too
+        oy = (int32_t)(next() % 400) - 200;
+      }
+      TEST_ASSERT_TRUE(show(scale, ox, oy));
+      TEST_ASSERT_TRUE(matchesImage(screen, dec.imgW, dec.imgH, scale, ox, oy));
+      TEST_ASSERT_LESS_OR_EQUAL(TILE_VIEW_MAX, view.stats.lastNeeded);
+      TEST_ASSERT_LESS_OR_EQUAL(view.stats.lastNeeded, view.stats.lastHits);
+      direct += (uint64_t)tileScaled(dec.imgW, scale) * tileScaled(dec.imgH, scale);
+    }
+    views += view.stats.views;
+    hits += view.stats.hits;
+    lookups += view.stats.lookups;
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  TEST_ASSERT_EQUAL_UINT32(2000, views);
+  char line[120];
+  snprintf(line, sizeof(line), "2000 views: %u/%u tiles hit, %.1f Mpx decoded (%.1f whole), %.1f ms",
+           (unsigned)hits, (unsigned)lookups, dec.pixels / 1e6, direct / 1e6, ms);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(direct / 4, dec.pixels);
+}
+
+// A pan and the same pan back: the return trip decodes nothing
+static void test_panning_back_decodes_nothing() {
+  begin(32, 1600, 1200);
+  for (int x = 200; x <= 500; x += 50) TEST_ASSERT_TRUE(show(1, x, 100));
+  uint32_t passes = dec.passes;
+  uint64_t pixels = dec.pixels;
+  TEST_ASSERT_GREATER_THAN(0, passes);
+  // One pass per view at most, and never the whole 800x600 image
+  TEST_ASSERT_LESS_OR_EQUAL(7, passes);
+  TEST_ASSERT_LESS_THAN(800u * 600u / 4, pixels);
+
+  for (int x = 500; x >= 200; x -= 50) {
+    TEST_ASSERT_TRUE(show(1, x, 100));
+    TEST_ASSERT_TRUE(matchesImage(screen, 1600, 1200, 1, x, 100));
+    TEST_ASSERT_EQUAL(view.stats.lastNeeded, view.stats.lastHits);
+  }
+  TEST_ASSERT_EQUAL_UINT32(passes, dec.passes);
+  TEST_ASSERT_EQUAL_UINT64(pixels, dec.pixels);
+
+  char line[120];
+  snprintf(line, sizeof(line), "pan 7 views at 1:2: %u passes, %u px decoded; back: 0",
+           (unsigned)passes, (unsigned)pixels);
+  TEST_MESSAGE(line);
+}
+
+// The smallest cache still serves every view, evicting only tiles the
+// current view does not use
+static void test_minimum_cache_evicts_lru() {
+  begin(TILE_VIEW_MAX, 1600, 1200);
+  for (int i = 0; i < 20; i++) {
+    int32_t x = i % 2 ? 0 : 1000;
+    TEST_ASSERT_TRUE(show(0, x + 10, 500 + 10));
+    TEST_ASSERT_TRUE(matchesImage(screen, 1600, 1200, 0, x + 10, 510));
+    TEST_ASSERT_EQUAL(0, view.stats.lastHits); // 9 tiles each, none shared
+  }
+  TEST_ASSERT_EQUAL_UINT32(20, dec.passes);
+  TEST_ASSERT_GREATER_THAN(0, view.stats.evictions);
+
+  // Overlapping views keep the shared tiles
+  TEST_ASSERT_TRUE(show(0, 10 + TILE_SIZE, 510));
+  TEST_ASSERT_EQUAL(6, view.stats.lastHits);
+  TEST_ASSERT_TRUE(matchesImage(screen, 1600, 1200, 0, 10 + TILE_SIZE, 510));
+
+  // Room for two views: a third evicts the older one, not the last
+  begin(2 * TILE_VIEW_MAX, 1600, 1200);
+  const int32_t xs[] = {10, 410, 810};
+  for (int32_t x : xs) TEST_ASSERT_TRUE(show(0, x, 510));
+  TEST_ASSERT_TRUE(show(0, 410, 510));
+  TEST_ASSERT_EQUAL(TILE_VIEW_MAX, view.stats.lastHits);
+  TEST_ASSERT_TRUE(show(0, 10, 510));
+  TEST_ASSERT_EQUAL(0, view.stats.lastHits);
+}
+
+static void test_new_image_drops_tiles() {
+  begin(32, 1600, 1200);
+  TEST_ASSERT_TRUE(show(2, 50, 50));
+  TEST_ASSERT_TRUE(show(2, 50, 50));
+  TEST_ASSERT_EQUAL(view.stats.lastNeeded, view.stats.lastHits);
+  uint32_t passes = dec.passes;
+  dec.imgW = 1500;
+  tileViewSetImage(&view, 1500, 1200);
+  TEST_ASSERT_TRUE(show(2, 50, 50));
+  TEST_ASSERT_EQUAL(0, view.stats.lastHits);
+  TEST_ASSERT_EQUAL_UINT32(passes + 1, dec.passes);
+  // Scales never share tiles
+  TEST_ASSERT_TRUE(show(1, 50, 50));
+  TEST_ASSERT_EQUAL(0, view.stats.lastHits);
+}
+
+// A failed pass is shown as far as it got, but its tiles are never reused
+static void test_failed_decode_is_not_cached() {
+  begin(32, 1600, 1200);
+  dec.failAfter = 5;
+  TEST_ASSERT_FALSE(show(1, 100, 100));
+  TEST_ASSERT_FALSE(view.stats.lastOk);
+  TEST_ASSERT_EQUAL(VH, screen.nextRow); // still drawn
+  dec.failAfter = -1;
+  TEST_ASSERT_TRUE(show(1, 100, 100));
+  TEST_ASSERT_EQUAL(0, view.stats.lastHits);
+  TEST_ASSERT_TRUE(matchesImage(screen, 1600, 1200, 1, 100, 100));
+  TEST_ASSERT_TRUE(view.stats.lastOk);
+
+  // An aborted emit stops the rows but the decoded tiles are good
+  screen = Screen();
+  static uint16_t rows[VW * ROWS];
+  screen.abortAt = 3;
+  TEST_ASSERT_FALSE(tileViewRender(&view, 1, 300, 100, rows, ROWS, collect, &screen));
+  TEST_ASSERT_EQUAL(3, screen.blocks);
+  TEST_ASSERT_TRUE(show(1, 300, 100));
+  TEST_ASSERT_EQUAL(view.stats.lastNeeded, view.stats.lastHits);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_init_rejects_bad_setups);
+  RUN_TEST(test_origin_clamps_and_centres);
+  RUN_TEST(test_random_views_match_image);
+  RUN_TEST(test_panning_back_decodes_nothing);
+  RUN_TEST(test_minimum_cache_evicts_lru);
+  RUN_TEST(test_new_image_drops_tiles);
+  RUN_TEST(test_failed_decode_is_not_cached);
+  return UNITY_END();
+}
@@ -0,0 +1,302 @@
+// ============================================
+// UI widget tests (pio test -e native -f test_ui -v)
+// The status bars from display.cpp on a recording framebuffer backend
+// (6x8 cells, like the panel's size-1 font). After every flush the bars
+// must match a full redraw by freshly built widgets, nothing outside them
+// may change, and the pixels pushed per transition are compared with
+// redrawing the bars in full.
+// ============================================
+
+#include "ui/ui.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unity.h>
+
+static const int PANEL_W = 128, PANEL_H = 160, TOP_H = 16, BOT_H = 24, BOT_Y = PANEL_H - BOT_H;
+static const uint16_t BG_PANEL = 0x1082, BG_DARK = 0x0000, CYAN = 0x07FF, GREEN = 0x07E0, RED = 0xF800,
+                      GOLD = 0xFEA0, GRAY = 0x8410, WHITE = 0xFFFF, CONTENT = 0x5AEB;
+
+static uint32_t rng = 1;
+static uint32_t next() {
+  rng = rng * 1664525u + 1013904223u;
+  return rng >> 8;
+}
+
+void setUp() { rng = 1; }
+void tearDown() {}
+
+// ============================================
+// Recording backend
+// ============================================
+class Recorder : public UiBackend {
+public:
+  uint16_t fb[PANEL_H][PANEL_W];
+  uint32_t calls = 0, pixels = 0;
+
+  void clear(uint16_t color) {
+    for (auto &row : fb)
+      for (uint16_t &p : row) p = color;
+  }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    calls++;
+    for (int j = y; j < y + h; j++)
+      for (int i = x; i < x + w; i++) put(i, j, color);
+  }
+  void drawText(const char *s, int16_t x, int16_t y, uint16_t fg, uint16_t bg, const UiRect &clip) override {
+    calls++;
+    for (int c = 0; s[c]; c++) {
+      for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 6; col++) {
+          int px = x + c * 6 + col, py = y + row;
+          if (px < clip.x || px >= clip.x + clip.w || py < clip.y || py >= clip.y + clip.h) continue;
+          put(px, py, glyph(s[c], col, row) ? fg : bg);
+        }
+      }
+    }
+  }
+  int16_t textWidth(const char *s) override { return (int16_t)(6 * strlen(s)); }
+  int16_t fontHeight() override { return 8; }
+
+private:
+  // Any fixed pattern per character will do; column 5 is the gap
+  static bool glyph(char ch, int col, int row) {
+    return col < 5 && (((uint32_t)ch * 2654435761u) >> (col * 5 + row % 5)) & 1;
+  }
+  void put(int x, int y, uint16_t color) {
+    if (x < 0 || x >= PANEL_W || y < 0 || y >= PANEL_H) return;
+    fb[y][x] = color;
+    pixels++;
+  }
+};
+
+// ============================================
+// The bars, as display.cpp builds and feeds them
+// ============================================
+struct State {
+  bool wifi = false, paired = false, error = false;
+  std::string mode = "BOOTING", action, perf;
+  int queue = 0;
+};
+
+struct Bars {
+  UiFill topBg{{0, 0, PANEL_W, TOP_H}, BG_PANEL};
+  UiFill topLine{{0, TOP_H, PANEL_W, 1}, CYAN};
+  UiLabel wifi{{0, 0, 24, TOP_H}, UI_ALIGN_LEFT, BG_PANEL};
+  UiLabel mode{{24, 0, PANEL_W - 48, TOP_H}, UI_ALIGN_CENTER, BG_PANEL, 0};
+  UiLabel pair{{PANEL_W - 24, 0, 24, TOP_H}, UI_ALIGN_RIGHT, BG_PANEL};
+  UiLayer top;
+  UiFill botLine{{0, BOT_Y - 1, PANEL_W, 1}, CYAN};
+  UiFill botBg{{0, BOT_Y, PANEL_W, BOT_H}, BG_PANEL};
+  UiLabel action{{0, BOT_Y, PANEL_W - 40, BOT_H}, UI_ALIGN_LEFT, BG_PANEL};
+  UiLabel queue{{PANEL_W - 40, BOT_Y, 40, BOT_H}, UI_ALIGN_RIGHT, BG_PANEL};
+  UiLayer bottom;
+
+  Bars() {
+    top.add(&topBg), top.add(&topLine), top.add(&wifi), top.add(&mode), top.add(&pair);
+    bottom.add(&botLine), bottom.add(&botBg), bottom.add(&action), bottom.add(&queue);
+  }
+
+  // drawTopBar() + drawBottomPanel()
+  UiFlushStats draw(const State &s, UiBackend &b) {
+    wifi.set(s.wifi ? "W+" : "W-", s.wifi ? GREEN : RED);
+    if (!s.perf.empty()) mode.set(s.perf.c_str(), GOLD);
+    else mode.set(s.mode.c_str(), WHITE);
+    pair.set(s.paired ? "P+" : "P-", s.paired ? CYAN : GRAY);
+    UiFlushStats a = top.flush(b);
+
+    std::string text = s.action.empty() ? "Ready" : s.action;
+    if (text.size() > 13) text = text.substr(0, 12) + "~";
+    action.set(text.c_str(), s.error ? RED : GREEN);
+    char q[8];
+    snprintf(q, sizeof(q), "Q:%d", s.queue);
+    queue.set(q, s.queue > 0 ? GOLD : GRAY);
+    UiFlushStats c = bottom.flush(b);
+    UiFlushStats st = {(uint16_t)(a.rects + c.rects), a.pixels + c.pixels};
+    return st;
+  }
+};
+
+static Recorder panel, fresh;
+
+// Bars drawn from scratch over junk; returns the pixels that took
+static uint32_t fullRedraw(const State &s) {
+  fresh.clear(0xBEEF);
+  Bars bars;
+  return bars.draw(s, fresh).pixels;
+}
+
+static bool isBarRow(int y) { return y <= TOP_H || y >= BOT_Y - 1; }
+
+static void checkAgainstFull(const State &s, const char *when) {
+  fullRedraw(s);
+  char msg[120];
+  for (int y = 0; y < PANEL_H; y++) {
+    for (int x = 0; x < PANEL_W; x++) {
+      uint16_t want = isBarRow(y) ? fresh.fb[y][x] : CONTENT;
+      if (panel.fb[y][x] != want) {
+        snprintf(msg, sizeof(msg), "%s: pixel (%d,%d) is %04X, full redraw %04X", when, x, y, panel.fb[y][x], want);
+        TEST_FAIL_MESSAGE(msg);
+      }
+    }
+  }
+}
+
+static void startPanel() {
+  panel.clear(BG_DARK);
+  for (int y = 0; y < PANEL_H; y++)
+    for (int x = 0; x < PANEL_W; x++)
+      if (!isBarRow(y)) panel.fb[y][x] = CONTENT;
+}
+
+// ============================================
+// Tests
+// ============================================
+// The capture/upload/mode sequence from the commit that added the layer
+static void test_session_matches_full_redraw() {
+  startPanel();
+  Bars bars;
+  State s;
+  uint32_t retained = 0, full = 0;
+  int steps = 0;
+  auto step = [&](const char *what) {
+    retained += bars.draw(s, panel).pixels;
+    full += fullRedraw(s);
+    checkAgainstFull(s, what);
+    steps++;
+  };
+
+  step("boot");
+  s.wifi = true, step("wifi up");
+  s.paired = true, step("paired");
+  s.mode = "READY", s.action = "Camera Active", step("ready");
+  for (int page = 1; page <= 5; page++) {
+    s.mode = "CAPTURING", step("capturing");
+    s.action = "Captured p" + std::to_string(page), step("captured");
+    s.queue = page, step("queued");
+    s.mode = "UPLOADING", step("uploading");
+    s.action = "Uploaded " + std::to_string(page) + "/5", step("uploaded");
+    s.queue = page - 1 > 0 ? page - 1 : 0, step("dequeued");
+    s.mode = "READY", step("ready again");
+  }
+  s.error = true, s.action = "Upload failed: timeout", step("long error");
+  s.wifi = false, s.mode = "OFFLINE", step("offline");
+  s.perf = "15.0fps d12 p4", step("perf overlay");
+  s.perf.clear(), s.mode = "DOC 3p", step("document mode");
+
+  char line[120];
+  snprintf(line, sizeof(line), "%d transitions: %u px retained vs %u px full redraw (%.1fx)", steps,
+           (unsigned)retained, (unsigned)full, (double)full / retained);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(full / 4, retained);
+}
+
+static void test_unchanged_redraw_is_free() {
+  startPanel();
+  Bars bars;
+  State s;
+  s.mode = "READY", s.action = "Camera Active", s.queue = 2;
+  bars.draw(s, panel);
+  uint32_t before = panel.calls;
+  UiFlushStats st = bars.draw(s, panel);
+  TEST_ASSERT_EQUAL(0, st.rects);
+  TEST_ASSERT_EQUAL_UINT32(0, st.pixels);
+  TEST_ASSERT_EQUAL_UINT32(before, panel.calls);
+}
+
+// Preview frames and content fills overwrite the separator rows; a full
+// screen clear wipes everything
+static void test_invalidation_repaints() {
+  startPanel();
+  Bars bars;
+  State s;
+  s.mode = "PREVIEW", s.action = "Live";
+  bars.draw(s, panel);
+
+  for (int x = 0; x < PANEL_W; x++) panel.fb[TOP_H][x] = panel.fb[BOT_Y - 1][x] = 0x1234;
+  bars.topLine.invalidate();
+  bars.botLine.invalidate();
+  UiFlushStats st = bars.draw(s, panel);
+  checkAgainstFull(s, "separators");
+  // The lines alone: they overlap no label
+  TEST_ASSERT_EQUAL_UINT32(2 * PANEL_W, st.pixels);
+
+  startPanel();
+  bars.top.invalidate();
+  bars.bottom.invalidate();
+  bars.draw(s, panel);
+  checkAgainstFull(s, "clear screen");
+
+  // An opaque background repaint takes the labels on top with it
+  bars.botBg.setColor(BG_DARK);
+  bars.draw(s, panel);
+  bars.botBg.setColor(BG_PANEL);
+  bars.draw(s, panel);
+  checkAgainstFull(s, "background");
+}
+
+// Random label changes: texts growing, shrinking, sharing prefixes and
+// suffixes, overflowing their boxes, empty, and colour-only changes
+static void test_random_transitions_match_full_redraw() {
+  static const char *const words[] = {"", "A", "READY", "READ", "READY!", "CAPTURING", "UPLOADING 10/10",
+                                      "X", "Uploaded 9/10", "Uploaded 10/10", "Q", "a very long label text"};
+  startPanel();
+  Bars bars;
+  State s;
+  bars.draw(s, panel);
+  uint32_t retained = 0, full = 0;
+  for (int round = 0; round < 600; round++) {
+    switch (next() % 6) {
+    case 0: s.mode = words[next() % 12]; break;
+    case 1: s.action = words[next() % 12]; break;
+    case 2: s.error = !s.error; break;
+    case 3: s.queue = (int)(next() % 1200); break;
+    case 4: s.perf = next() % 2 ? words[next() % 12] : ""; break;
+    default: s.wifi = next() & 1, s.paired = next() & 1; break;
+    }
+    retained += bars.draw(s, panel).pixels;
+    full += fullRedraw(s);
+    char when[40];
+    snprintf(when, sizeof(when), "round %d", round);
+    checkAgainstFull(s, when);
+  }
+  TEST_ASSERT_LESS_THAN(full / 2, retained);
+}
+
+// Clipped text never leaves its box, even when a neighbour is narrower
+static void test_overflowing_text_stays_in_box() {
+  startPanel();
+  Bars bars;
+  State s;
+  s.mode = "ABCDEFGHIJKLMNOPQRSTUVW";
+  s.queue = 123456;
+  bars.draw(s, panel);
+  checkAgainstFull(s, "overflow");
+  // The neighbours still show their own text
+  Recorder alone;
+  alone.clear(0);
+  UiLabel wifi({0, 0, 24, TOP_H}, UI_ALIGN_LEFT, BG_PANEL);
+  wifi.set("W-", RED);
+  UiFlushStats st = {0, 0};
+  wifi.paint(alone, st);
+  for (int y = 0; y < TOP_H; y++)
+    for (int x = 0; x < 24; x++) TEST_ASSERT_EQUAL_HEX16(alone.fb[y][x], panel.fb[y][x]);
+}
+
+static void test_layer_capacity() {
+  UiLayer layer;
+  UiFill f({0, 0, 1, 1}, 0);
+  for (int i = 0; i < UiLayer::MAX_WIDGETS; i++) TEST_ASSERT_TRUE(layer.add(&f));
+  TEST_ASSERT_FALSE(layer.add(&f));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_session_matches_full_redraw);
+  RUN_TEST(test_unchanged_redraw_is_free);
+  RUN_TEST(test_invalidation_repaints);
+  RUN_TEST(test_random_transitions_match_full_redraw);
+  RUN_TEST(test_overflowing_text_stays_in_box);
+  RUN_TEST(test_layer_capacity);
+  return UNITY_END();
+}
@@ -0,0 +1,290 @@
+// ============================================
+// Web UI asset tests (pio test -e native -f test_web_assets -v)
+// The page tools/embed_web.py compiles in against web/index.html (gzip
+// header, CRC and length), handleRoot() served over a loopback socket with
+// its ETag revalidation, and a page load now against the page the old
+// handleRoot() built with String concatenation, per load: heap allocations,
+// bytes allocated and sent, handler time.
+// ============================================
+
+#include "net/http_server.h"
+#include "net/web_assets.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <esp_heap_caps.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unity.h>
+
+static HttpServer server;
+static uint16_t port;
+static std::string pageSource; // web/index.html
+
+static uint32_t crc32(const uint8_t *p, size_t n) {
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i = 0; i < n; i++) {
+    c ^= p[i];
+    for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+  }
+  return ~c;
+}
+
+static uint32_t le32(const uint8_t *p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// ============================================
+// Routes
+// ============================================
+static const char *const COLLECT[] = {"If-None-Match"};
+
+// As main.cpp's
+static void handleRoot() {
+  const WebAsset *page = findWebAsset("/");
+  if (!page) {
+    server.send(404, "text/plain", "Web UI not built in");
+    return;
+  }
+  server.sendHeader("ETag", page->etag);
+  server.sendHeader("Vary", "Accept-Encoding");
+  server.sendHeader("Cache-Control", "no-cache");
+  if (strstr(server.header("If-None-Match").c_str(), page->etag)) {
+    server.send(304, page->contentType, "");
+    return;
+  }
+  server.sendHeader("Content-Encoding", "gzip");
+  server.sendStatic(200, page->contentType, page->gz, page->gzLen);
+}
+
+// The old handleRoot(): the same markup, one String += per line, the buffer
+// growing to its exact new size each time (as Arduino's String does), and
+// then copied again by send()
+static void handleLegacyRoot() {
+  char *html = nullptr;
+  size_t len = 0;
+  for (size_t at = 0; at < pageSource.size();) {
+    size_t end = pageSource.find('\n', at);
+    end = end == std::string::npos ? pageSource.size() : end + 1;
+    html = (char *)heap_caps_realloc(html, len + (end - at) + 1, MALLOC_CAP_8BIT);
+    memcpy(html + len, pageSource.data() + at, end - at);
+    len += end - at;
+    html[len] = 0;
+    at = end;
+  }
+  server.send(200, "text/html", String(html));
+  heap_caps_free(html);
+}
+
+// ============================================
+// Client side
+// ============================================
+static void pump(int passes = 4) {
+  for (int i = 0; i < passes; i++) {
+    server.poll(1);
+    server.dispatch();
+  }
+}
+
+// The whole response, up to the server closing the connection
+static std::string request(const std::string &raw) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  TEST_ASSERT_EQUAL(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  TEST_ASSERT_EQUAL((long)raw.size(), (long)::send(fd, raw.data(), raw.size(), MSG_NOSIGNAL));
+
+  std::string out;
+  char buf[4096];
+  for (int i = 0; i < 200; i++) {
+    pump(1);
+    for (;;) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n > 0) {
+        out.append(buf, n);
+        continue;
+      }
+      if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        close(fd);
+        return out;
+      }
+      break;
+    }
+  }
+  close(fd);
+  return out + "<open>";
+}
+
+static int status(const std::string &r) { return r.size() > 12 ? atoi(r.c_str() + 9) : 0; }
+static std::string body(const std::string &r) {
+  size_t at = r.find("\r\n\r\n");
+  return at == std::string::npos ? "" : r.substr(at + 4);
+}
+static bool hasHeader(const std::string &r, const std::string &line) {
+  return r.find(line + "\r\n") < r.find("\r\n\r\n");
+}
+
+static HttpServerStats stats() {
+  HttpServerStats st;
+  server.getStats(&st);
+  return st;
+}
+
+void setUp() {}
+void tearDown() {
+  pump(2);
+  TEST_ASSERT_EQUAL(0, stats().active);
+}
+
+// ============================================
+// Embedded page
+// ============================================
+static void test_page_is_web_index_gzipped() {
+  TEST_ASSERT_TRUE_MESSAGE(pageSource.size() > 0, "web/index.html not found");
+  const WebAsset *page = findWebAsset("/");
+  TEST_ASSERT_NOT_NULL(page);
+  TEST_ASSERT_EQUAL_STRING("text/html", page->contentType);
+  TEST_ASSERT_NULL(findWebAsset("/index.html"));
+  TEST_ASSERT_NULL(findWebAsset("/nope"));
+
+  // RFC 1952: magic, deflate, no name or comment, mtime 0 (a stable build)
+  TEST_ASSERT_GREATER_THAN(18, page->gzLen);
+  TEST_ASSERT_EQUAL_HEX8(0x1f, page->gz[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x8b, page->gz[1]);
+  TEST_ASSERT_EQUAL_HEX8(8, page->gz[2]);
+  TEST_ASSERT_EQUAL_HEX8(0, page->gz[3] & 0x18);
+  TEST_ASSERT_EQUAL_UINT32(0, le32(page->gz + 4));
+  // Trailer: CRC-32 and length of what it inflates to
+  const uint8_t *raw = (const uint8_t *)pageSource.data();
+  TEST_ASSERT_EQUAL_HEX32(crc32(raw, pageSource.size()), le32(page->gz + page->gzLen - 8));
+  TEST_ASSERT_EQUAL_UINT32(pageSource.size(), le32(page->gz + page->gzLen - 4));
+  TEST_ASSERT_LESS_THAN(pageSource.size() / 2, page->gzLen);
+
+  // ETag: quoted, 16 hex digits
+  TEST_ASSERT_EQUAL(18, strlen(page->etag));
+  TEST_ASSERT_EQUAL('"', page->etag[0]);
+  TEST_ASSERT_EQUAL('"', page->etag[17]);
+  for (int i = 1; i < 17; i++) TEST_ASSERT_TRUE(strchr("0123456789abcdef", page->etag[i]) != nullptr);
+}
+
+// ============================================
+// handleRoot()
+// ============================================
+static void test_root_is_sent_from_flash_and_revalidated() {
+  const WebAsset *page = findWebAsset("/");
+  std::string etag = page->etag;
+
+  std::string r = request("GET / HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+  TEST_ASSERT_EQUAL(200, status(r));
+  TEST_ASSERT_TRUE(hasHeader(r, "Content-Encoding: gzip"));
+  TEST_ASSERT_TRUE(hasHeader(r, "ETag: " + etag));
+  TEST_ASSERT_TRUE(hasHeader(r, "Vary: Accept-Encoding"));
+  TEST_ASSERT_TRUE(hasHeader(r, "Cache-Control: no-cache"));
+  TEST_ASSERT_TRUE(hasHeader(r, "Content-Length: " + std::to_string(page->gzLen)));
+  std::string b = body(r);
+  TEST_ASSERT_EQUAL(page->gzLen, b.size());
+  TEST_ASSERT_EQUAL_MEMORY(page->gz, b.data(), page->gzLen);
+
+  // Gzip goes to clients that leave Accept-Encoding out too
+  r = request("GET / HTTP/1.1\r\n\r\n");
+  TEST_ASSERT_EQUAL(200, status(r));
+  TEST_ASSERT_TRUE(hasHeader(r, "Content-Encoding: gzip"));
+
+  // Revalidation: the current ETag (alone or in a list) is a 304 with no
+  // body, an old one gets the page
+  const std::string matches[] = {etag, "W/\"0123456789abcdef\", " + etag};
+  for (const std::string &m : matches) {
+    r = request("GET / HTTP/1.1\r\nIf-None-Match: " + m + "\r\n\r\n");
+    TEST_ASSERT_EQUAL(304, status(r));
+    TEST_ASSERT_TRUE(hasHeader(r, "ETag: " + etag));
+    TEST_ASSERT_FALSE(hasHeader(r, "Content-Encoding: gzip"));
+    TEST_ASSERT_EQUAL_STRING("", body(r).c_str());
+  }
+  r = request("GET / HTTP/1.1\r\nIf-None-Match: \"0123456789abcdef\"\r\n\r\n");
+  TEST_ASSERT_EQUAL(200, status(r));
+  TEST_ASSERT_EQUAL(page->gzLen, body(r).size());
+}
+
+// ============================================
+// Page load, before and after
+// ============================================
+struct LoadCost {
+  double allocs, allocBytes, sent, handlerUs;
+};
+
+static LoadCost measure(const std::string &raw, int loads) {
+  LoadCost cost = {};
+  for (int i = 0; i < loads; i++) {
+    uint32_t allocs = hostAllocs;
+    uint64_t bytes = hostAllocBytes;
+    std::string r = request(raw);
+    TEST_ASSERT_TRUE(status(r) == 200 || status(r) == 304);
+    cost.allocs += hostAllocs - allocs;
+    cost.allocBytes += (double)(hostAllocBytes - bytes);
+    cost.sent += r.size();
+    cost.handlerUs += stats().handlerUs;
+  }
+  cost.allocs /= loads;
+  cost.allocBytes /= loads;
+  cost.sent /= loads;
+  cost.handlerUs /= loads;
+  return cost;
+}
+
+static void report(const char *what, const LoadCost &c) {
+  char line[120];
+  snprintf(line, sizeof(line), "%s: %.0f heap allocs, %.1f KB allocated, %.1f KB sent, handler %.1f us",
+           what, c.allocs, c.allocBytes / 1024, c.sent / 1024, c.handlerUs);
+  TEST_MESSAGE(line);
+}
+
+static void test_page_load_before_and_after() {
+  const int LOADS = 200;
+  const WebAsset *page = findWebAsset("/");
+  size_t lines = 0;
+  for (char ch : pageSource) lines += ch == '\n';
+
+  LoadCost before = measure("GET /legacy HTTP/1.1\r\n\r\n", LOADS);
+  LoadCost after = measure("GET / HTTP/1.1\r\n\r\n", LOADS);
+  LoadCost reload = measure(std::string("GET / HTTP/1.1\r\nIf-None-Match: ") + page->etag + "\r\n\r\n", LOADS);
+  report("before (String page)", before);
+  report("after  (flash, gzip)", after);
+  report("reload (304)        ", reload);
+
+  // One allocation per line and the response copy, against none at all
+  TEST_ASSERT_EQUAL(lines + 1, (size_t)before.allocs);
+  TEST_ASSERT_GREATER_THAN(pageSource.size() * 2, before.allocBytes);
+  TEST_ASSERT_EQUAL(0, after.allocs);
+  TEST_ASSERT_EQUAL(0, reload.allocs);
+  TEST_ASSERT_LESS_THAN(before.sent / 2, after.sent);
+  TEST_ASSERT_LESS_THAN(400, reload.sent);
+}
+
+int main() {
+  FILE *f = fopen("web/index.html", "rb");
+  if (f) {
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) pageSource.append(buf, n);
+    fclose(f);
+  }
+
+  server.on("/", HTTP_GET, handleRoot);
+  server.on("/legacy", HTTP_GET, handleLegacyRoot);
+  server.collectHeaders(COLLECT, 1);
+  for (port = 19080 + getpid() % 1000; !server.begin(port); port++) {
+  }
+
+  UNITY_BEGIN();
+  RUN_TEST(test_page_is_web_index_gzipped);
+  RUN_TEST(test_root_is_sent_from_flash_and_revalidated);
+  RUN_TEST(test_page_load_before_and_after);
+  return UNITY_END();
+}
@@ -0,0 +1,96 @@
+"""Gzip the web UI in web/ into a C header compiled into the firmware.
+
+Runs before every PlatformIO build (extra_scripts = pre:tools/embed_web.py)
+and can be run by hand: python tools/embed_web.py
+
+Each file becomes a const byte array (flash, served as is with
+Content-Encoding: gzip) plus an ETag taken from its contents. The header is
+only rewritten when something changed, so an unchanged UI does not force a
+rebuild.
+"""
+
+import gzip
+import hashlib
+import os
+
+try:
+    Import("env")  # noqa: F821 (provided by PlatformIO / SCons)
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+WEB_DIR = os.path.join(PROJECT_DIR, "web")
+OUT_FILE = os.path.join(PROJECT_DIR, "src", "net", "web_assets_data.h")
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".json": "application/json",
+}
+
+
+def symbol_for(rel):
+    return "WEB_" + "".join(c.upper() if c.isalnum() else "_" for c in rel) + "_GZ"
+
+
+def url_for(rel):
+    url = "/" + rel.replace(os.sep, "/")
+    return "/" if url == "/index.html" else url
+
+
+def byte_rows(data, per_row=16):
+    for i in range(0, len(data), per_row):
+        yield "  " + ", ".join("0x%02x" % b for b in data[i:i + per_row]) + ","
+
+
+def build():
+    assets = []
+    for root, _, files in os.walk(WEB_DIR):
+        for name in sorted(files):
+            path = os.path.join(root, name)
+            rel = os.path.relpath(path, WEB_DIR)
+            ext = os.path.splitext(name)[1].lower()
+            if ext not in CONTENT_TYPES:
+                continue
+            with open(path, "rb") as f:
+                raw = f.read()
+            # mtime=0 keeps the output (and the ETag) stable across builds
+            gz = gzip.compress(raw, compresslevel=9, mtime=0)
+            etag = '"%s"' % hashlib.sha1(raw).hexdigest()[:16]
+            assets.append((rel, CONTENT_TYPES[ext], raw, gz, etag))
+    assets.sort(key=lambda a: url_for(a[0]))
+
+    lines = [
+        "// Generated by tools/embed_web.py from web/ - do not edit.",
+        "// Included once, by web_assets.cpp.",
+        "",
+    ]
+    for rel, _, raw, gz, _ in assets:
+        lines.append("// %s: %d bytes, %d gzipped" % (rel.replace(os.sep, "/"), len(raw), len(gz)))
+        lines.append("static const uint8_t %s[] = {" % symbol_for(rel))
+        lines.extend(byte_rows(gz))
+        lines.append("};")
+        lines.append("")
+    lines.append("static const WebAsset WEB_ASSETS[] = {")
+    for rel, ctype, _, _, etag in assets:
+        sym = symbol_for(rel)
+        lines.append('  {"%s", "%s", %s, sizeof(%s), "%s"},'
+                     % (url_for(rel), ctype, sym, sym, etag.replace('"', '\\"')))
+    lines.append("};")
+    text = "\n".join(lines) + "\n"
+
+    old = None
+    if os.path.exists(OUT_FILE):
+        with open(OUT_FILE) as f:
+            old = f.read()
+    if text != old:
+        with open(OUT_FILE, "w") as f:
+            f.write(text)
+    for rel, _, raw, gz, _ in assets:
+        print("[embed_web] %s: %d -> %d bytes" % (rel, len(raw), len(gz)))
+
+
+build()
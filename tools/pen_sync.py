@@ -0,0 +1,503 @@
+"""Pull new scans from a pen over the LAN, using its /api/sync changes feed.
+
+    python tools/pen_sync.py 192.168.1.42 ./scans        sync once
+    python tools/pen_sync.py --stand-in ./fake-queue     serve a folder the way a pen does
+    python tools/pen_sync.py --demo 1000                 stand-in + two syncs, with numbers
+
+The pen numbers every change to its upload queue (a generation). This client
+keeps the generation it last synced to in <dest>/.pen_sync.json and asks only
+for what came after it: one request per SYNC_PAGE changes, then one per new
+scan. Downloads run WORKERS at a time (the pen serves FILE_STREAM_MAX at
+once and answers 503 + Retry-After beyond that), files larger than CHUNK are
+split into Range requests spread over the workers, and a transfer cut short
+is resumed from its .part file: the chunks already in it are recorded in the
+state file as they land, so only the others are fetched again. Each file is checked against the CRC-32 the
+pen recorded when it wrote it (files queued by older firmware have none and
+are fetched whole).
+
+The stand-in serves a plain folder with the same endpoints, optionally slowed
+to the pen's SD card speed (--bps), so the client can be tried without a pen.
+Python 3 standard library only.
+"""
+
+import argparse
+import http.client
+import http.server
+import json
+import os
+import queue
+import random
+import shutil
+import socketserver
+import sys
+import tempfile
+import threading
+import time
+import urllib.parse
+import zlib
+
+SYNC_PAGE = 500           # the pen's SYNC_PAGE_MAX
+WORKERS = 2               # the pen's FILE_STREAM_MAX
+CHUNK = 1024 * 1024       # largest single Range request
+STATE_FILE = ".pen_sync.json"
+
+
+# ============================================
+# Client
+# ============================================
+class PenClient:
+    def __init__(self, host, port):
+        self.host = host
+        self.port = port
+        self.requests = 0
+        self.retries = 0
+        self.bytes = 0
+        self._lock = threading.Lock()
+
+    def get(self, path, headers=None):
+        """One request (the pen closes every connection): status, headers, body."""
+        while True:
+            conn = http.client.HTTPConnection(self.host, self.port, timeout=30)
+            try:
+                conn.request("GET", path, headers=headers or {})
+                resp = conn.getresponse()
+                body = resp.read()
+            finally:
+                conn.close()
+            with self._lock:
+                self.requests += 1
+                self.bytes += len(body)
+            if resp.status != 503:
+                return resp.status, resp, body
+            # Busy: every download slot taken, or the card is not ready
+            with self._lock:
+                self.retries += 1
+            time.sleep(float(resp.getheader("Retry-After", "1")) * random.uniform(0.5, 1.0))
+
+    def changes(self, since):
+        """Every change after `since`: (generation, reset, [change, ...])."""
+        generation, reset, out, cursor = None, False, [], 0
+        while True:
+            path = "/api/sync?since=%d&limit=%d" % (since, SYNC_PAGE)
+            if cursor:
+                path += "&cursor=%d" % cursor
+            status, _, body = self.get(path)
+            if status != 200:
+                raise RuntimeError("/api/sync: HTTP %d" % status)
+            page = json.loads(body)
+            if generation is None:
+                # Kept from the first page: anything later is asked for next time
+                generation = page["generation"]
+                reset = page["reset"]
+            out.extend(page["changes"])
+            cursor = int(page.get("next", 0))
+            if not cursor:
+                return generation, reset, out
+
+
+def load_state(dest):
+    try:
+        with open(os.path.join(dest, STATE_FILE)) as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return {"generation": 0, "files": {}, "parts": {}}
+
+
+def save_state(dest, state):
+    tmp = os.path.join(dest, STATE_FILE + ".tmp")
+    with open(tmp, "w") as f:
+        json.dump(state, f)
+    os.replace(tmp, os.path.join(dest, STATE_FILE))
+
+
+def crc32_file(path):
+    crc = 0
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 16), b""):
+            crc = zlib.crc32(block, crc)
+    return crc
+
+
+def download(client, scans, dest, workers, state):
+    """Fetch `scans` (change dicts) into dest; returns those that verified.
+    state["parts"] keeps the chunks each .part file already holds."""
+    jobs = queue.Queue()
+    pending = {}
+    parts = state.setdefault("parts", {})
+    wanted = {s["id"] for s in scans}
+    for sid in [sid for sid in parts if sid not in wanted]:
+        # Gone from the pen, or fetched some other way since
+        try:
+            os.remove(os.path.join(dest, parts[sid]["name"] + ".part"))
+        except OSError:
+            pass
+        del parts[sid]
+    for s in scans:
+        part = os.path.join(dest, s["name"] + ".part")
+        if "size" not in s:
+            # Queued by older firmware: no size or CRC, fetched whole
+            open(part, "wb").close()
+            pending[s["id"]] = [s, 1]
+            jobs.put((s, 0, None))
+            continue
+        # Resume: only chunks recorded as written count, and only for the
+        # same file (a scan re-saved under its name has another CRC)
+        known = parts.get(s["id"])
+        if not (known and known["name"] == s["name"] and known["size"] == s["size"]
+                and known["crc32"] == s.get("crc32") and os.path.exists(part)):
+            known = {"name": s["name"], "size": s["size"], "crc32": s.get("crc32"), "chunks": []}
+            parts[s["id"]] = known
+            with open(part, "wb") as f:
+                f.truncate(s["size"])
+        have = set(known["chunks"])
+        starts = [start for start in range(0, s["size"], CHUNK) if start not in have]
+        if not starts and s["size"]:
+            # All there: a run cut short between the last chunk and the check
+            pending[s["id"]] = [s, 0]
+            continue
+        starts = starts or [0]
+        pending[s["id"]] = [s, len(starts)]
+        for start in starts:
+            jobs.put((s, start, min(start + CHUNK, s["size"]) - 1))
+
+    done, failed, lock = [], [], threading.Lock()
+
+    def finish(s):
+        parts.pop(s["id"], None)
+        part = os.path.join(dest, s["name"] + ".part")
+        if "crc32" not in s or crc32_file(part) == int(s["crc32"], 16):
+            os.replace(part, os.path.join(dest, s["name"]))
+            done.append(s)
+        else:
+            os.remove(part)
+            failed.append(s)
+
+    def worker():
+        while True:
+            try:
+                s, first, last = jobs.get_nowait()
+            except queue.Empty:
+                return
+            headers = {}
+            if last is not None and (first > 0 or last < s["size"] - 1):
+                headers["Range"] = "bytes=%d-%d" % (first, last)
+            status, resp, body = client.get("/api/scans/" + s["id"], headers)
+            ok = status in (200, 206) and len(body) == int(resp.getheader("Content-Length", -1))
+            ok = ok and (last is None or len(body) == last - first + 1)
+            if ok:
+                fd = os.open(os.path.join(dest, s["name"] + ".part"), os.O_WRONLY)
+                try:
+                    os.pwrite(fd, body, first)
+                finally:
+                    os.close(fd)
+            with lock:
+                if not ok:
+                    if pending.pop(s["id"], None):
+                        failed.append(s)  # uploaded and removed meanwhile, most likely
+                    continue
+                if s["id"] in parts:
+                    # Kept for the next run even if another chunk failed
+                    parts[s["id"]]["chunks"].append(first)
+                    save_state(dest, state)
+                entry = pending.get(s["id"])
+                if entry is None:
+                    continue
+                entry[1] -= 1
+                if entry[1] == 0:
+                    del pending[s["id"]]
+                    finish(s)
+
+    for s, left in list(pending.values()):
+        if left == 0:
+            del pending[s["id"]]
+            finish(s)
+    threads = [threading.Thread(target=worker) for _ in range(workers)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return done, failed
+
+
+def sync(host, port, dest, workers=WORKERS, mirror=False, quiet=False):
+    os.makedirs(dest, exist_ok=True)
+    state = load_state(dest)
+    client = PenClient(host, port)
+    t0 = time.monotonic()
+    generation, reset, changes = client.changes(state["generation"])
+    t_list = time.monotonic() - t0
+
+    files = state["files"]
+    latest = {}
+    for c in changes:
+        latest[c["id"]] = c  # a scan added then removed ends up removed
+    if reset:
+        # A full listing: what it does not name is gone from the pen
+        for sid in [sid for sid in files if sid not in latest]:
+            latest[sid] = {"op": "del", "id": sid}
+    wanted, removed = [], 0
+    for sid, c in latest.items():
+        if c["op"] == "del":
+            if sid in files:
+                # Uploaded (or deleted) on the pen; the desktop copy stays
+                # unless mirroring
+                if mirror:
+                    try:
+                        os.remove(os.path.join(dest, files[sid]["name"]))
+                    except OSError:
+                        pass
+                removed += 1
+                del files[sid]
+            continue
+        known = files.get(sid)
+        if (known and known.get("crc32") == c.get("crc32") and known["name"] == c["name"]
+                and os.path.exists(os.path.join(dest, c["name"]))):
+            continue
+        wanted.append(c)
+
+    t1 = time.monotonic()
+    done, failed = download(client, wanted, dest, workers, state)
+    t_fetch = time.monotonic() - t1
+    for c in done:
+        files[c["id"]] = {"name": c["name"], "crc32": c.get("crc32")}
+    if not failed:
+        state["generation"] = generation
+    save_state(dest, state)
+
+    fetched = sum(os.path.getsize(os.path.join(dest, c["name"])) for c in done)
+    total = time.monotonic() - t0
+    report = {
+        "generation": generation,
+        "reset": reset,
+        "changes": len(changes),
+        "fetched": len(done),
+        "failed": len(failed),
+        "removed": removed,
+        "bytes": fetched,
+        "requests": client.requests,
+        "retries": client.retries,
+        "listSeconds": round(t_list, 3),
+        "fetchSeconds": round(t_fetch, 3),
+        "seconds": round(total, 3),
+        "MBps": round(fetched / 1e6 / t_fetch, 2) if t_fetch > 0 and fetched else 0,
+    }
+    if not quiet:
+        print(json.dumps(report))
+    return report
+
+
+# ============================================
+# Stand-in: a folder served like a pen's queue
+# ============================================
+class StandIn:
+    """Generations for a plain folder: rescanned on each /api/sync, changes
+    numbered as they are noticed. Tombstones are kept for every removal."""
+
+    def __init__(self, folder, bps):
+        self.folder = folder
+        self.bps = bps
+        self.gen = 0
+        self.live = {}      # id -> entry
+        self.log = []       # entries and removals, in generation order
+        self.downloads = 0
+        self.lock = threading.Lock()
+        self.card = threading.Lock()  # one SD card: reads take turns
+
+    @staticmethod
+    def key(name):
+        # galleryKey(): FNV-1a of the name without its extension
+        h = 2166136261
+        for b in os.path.splitext(name)[0].encode():
+            h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+        return "%08x" % h
+
+    def rescan(self):
+        names = {n for n in os.listdir(self.folder)
+                 if os.path.isfile(os.path.join(self.folder, n))}
+        by_name = {e["name"]: e for e in self.live.values()}
+        for name in sorted(names - by_name.keys(),
+                           key=lambda n: os.path.getmtime(os.path.join(self.folder, n))):
+            self.gen += 1
+            e = {"gen": self.gen, "op": "add", "id": self.key(name), "name": name,
+                 "size": os.path.getsize(os.path.join(self.folder, name)),
+                 "crc32": "%08x" % crc32_file(os.path.join(self.folder, name))}
+            self.live[e["id"]] = e
+            self.log.append(e)
+        for name in by_name.keys() - names:
+            e = by_name[name]
+            self.gen += 1
+            del self.live[e["id"]]
+            self.log.append({"gen": self.gen, "op": "del", "id": e["id"]})
+
+    def changes(self, since, cursor, limit):
+        with self.lock:
+            self.rescan()
+            reset = since == 0 or since > self.gen
+            after = max(since, cursor) if not reset else cursor
+            rows = [e for e in self.log if e["gen"] > after and (not reset or e["op"] == "add")
+                    and (e["op"] == "del" or self.live.get(e["id"]) is e)]
+            page = rows[:limit]
+            out = {"generation": self.gen, "reset": reset, "changes": page}
+            if len(rows) > limit:
+                out["next"] = str(page[-1]["gen"])
+            return out
+
+
+def make_handler(stand_in):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, *args):
+            pass
+
+        def reply(self, code, body=b"", ctype="application/json", extra=None):
+            self.send_response(code)
+            self.send_header("Content-Type", ctype)
+            self.send_header("Content-Length", str(len(body)))
+            self.send_header("Connection", "close")
+            for k, v in (extra or {}).items():
+                self.send_header(k, v)
+            self.end_headers()
+            self.wfile.write(body)
+            self.close_connection = True
+
+        def do_GET(self):
+            url = urllib.parse.urlparse(self.path)
+            args = dict(urllib.parse.parse_qsl(url.query))
+            if url.path == "/api/sync":
+                limit = max(1, min(int(args.get("limit", 200)), SYNC_PAGE))
+                body = stand_in.changes(int(args.get("since", 0)), int(args.get("cursor", 0)), limit)
+                return self.reply(200, json.dumps(body).encode())
+            if url.path.startswith("/api/scans/"):
+                return self.send_scan(url.path[len("/api/scans/"):])
+            self.reply(404, b"", "text/plain")
+
+        def send_scan(self, sid):
+            with stand_in.lock:
+                e = stand_in.live.get(sid)
+                busy = stand_in.downloads >= WORKERS
+                if e and not busy:
+                    stand_in.downloads += 1
+            if not e:
+                return self.reply(404, b"No such scan", "text/plain")
+            if busy:
+                return self.reply(503, b"Too many downloads", "text/plain", {"Retry-After": "1"})
+            try:
+                path = os.path.join(stand_in.folder, e["name"])
+                size = os.path.getsize(path)
+                first, last, code = 0, size - 1, 200
+                rng = self.headers.get("Range", "")
+                if rng.startswith("bytes=") and "," not in rng:
+                    a, _, b = rng[6:].partition("-")
+                    first = int(a) if a else max(0, size - int(b))
+                    last = min(int(b), size - 1) if a and b else size - 1
+                    code = 206
+                with open(path, "rb") as f:
+                    f.seek(first)
+                    left = last - first + 1
+                    self.send_response(code)
+                    self.send_header("Content-Type", "application/octet-stream")
+                    self.send_header("Content-Length", str(left))
+                    if code == 206:
+                        self.send_header("Content-Range", "bytes %d-%d/%d" % (first, last, size))
+                    self.send_header("Connection", "close")
+                    self.end_headers()
+                    while left > 0:
+                        with stand_in.card:
+                            block = f.read(min(8192, left))
+                            if stand_in.bps:
+                                # the card, not Wi-Fi, is the limit on a pen
+                                time.sleep(len(block) / stand_in.bps)
+                        if not block:
+                            break
+                        self.wfile.write(block)
+                        left -= len(block)
+                self.close_connection = True
+            finally:
+                with stand_in.lock:
+                    stand_in.downloads -= 1
+
+    return Handler
+
+
+class ThreadingServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def serve(folder, port, bps):
+    stand_in = StandIn(folder, bps)
+    server = ThreadingServer(("0.0.0.0", port), make_handler(stand_in))
+    return server, stand_in
+
+
+# ============================================
+# Demo: a backlog of fake scans, synced, then synced again after changes
+# ============================================
+def demo(count, size, bps, workers):
+    root = tempfile.mkdtemp(prefix="pen_sync_")
+    pen, dest = os.path.join(root, "queue"), os.path.join(root, "desktop")
+    os.makedirs(pen)
+    rnd = random.Random(1)
+    for i in range(count):
+        with open(os.path.join(pen, "scan_%d_%d.jpg" % (1000 + i, rnd.randint(1000, 9999))), "wb") as f:
+            f.write(rnd.randbytes(rnd.randint(size // 2, size * 3 // 2)))
+    server, _ = serve(pen, 0, bps)
+    port = server.server_address[1]
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    try:
+        print("backlog of %d scans, %.1f MB, card at %s" % (
+            count, sum(os.path.getsize(os.path.join(pen, n)) for n in os.listdir(pen)) / 1e6,
+            "%.1f MB/s" % (bps / 1e6) if bps else "full speed"))
+        first = sync("127.0.0.1", port, dest, workers, mirror=True, quiet=True)
+        print("first sync:  %(fetched)d scans, %(requests)d requests, %(MBps)s MB/s, %(seconds)ss" % first)
+
+        # Uploaded meanwhile: some old ones gone, a few new ones
+        names = sorted(os.listdir(pen))
+        for n in names[: count // 10]:
+            os.remove(os.path.join(pen, n))
+        for i in range(5):
+            with open(os.path.join(pen, "scan_%d_%d.jpg" % (900000 + i, i)), "wb") as f:
+                f.write(rnd.randbytes(size))
+        second = sync("127.0.0.1", port, dest, workers, mirror=True, quiet=True)
+        print("second sync: %(changes)d changes, %(fetched)d fetched, %(removed)d removed, "
+              "%(requests)d requests, %(seconds)ss" % second)
+        third = sync("127.0.0.1", port, dest, workers, mirror=True, quiet=True)
+        print("idle sync:   %(changes)d changes, %(requests)d request, %(seconds)ss" % third)
+        ok = sorted(n for n in os.listdir(dest) if n != STATE_FILE) == sorted(os.listdir(pen))
+        print("desktop matches pen:", ok)
+        return 0 if ok else 1
+    finally:
+        server.shutdown()
+        shutil.rmtree(root)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("host", nargs="?", help="pen address (host or host:port)")
+    ap.add_argument("dest", nargs="?", help="folder to sync into")
+    ap.add_argument("--workers", type=int, default=WORKERS)
+    ap.add_argument("--mirror", action="store_true", help="delete what the pen no longer has")
+    ap.add_argument("--stand-in", metavar="DIR", help="serve DIR like a pen's queue")
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--bps", type=float, default=0, help="stand-in read speed, bytes/s (0: unlimited)")
+    ap.add_argument("--demo", type=int, metavar="N", help="sync a stand-in backlog of N scans")
+    ap.add_argument("--size", type=int, default=150_000, help="demo: average scan size")
+    args = ap.parse_args()
+
+    if args.demo:
+        return demo(args.demo, args.size, args.bps, args.workers)
+    if args.stand_in:
+        server, _ = serve(args.stand_in, args.port, args.bps)
+        print("serving %s on :%d" % (args.stand_in, server.server_address[1]))
+        server.serve_forever()
+        return 0
+    if not args.host or not args.dest:
+        ap.error("host and dest are required")
+    host, _, port = args.host.partition(":")
+    report = sync(host, int(port or 8080), args.dest, args.workers, args.mirror)
+    return 1 if report["failed"] else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())